@@ -21,6 +21,7 @@
         'optimize': 'max',
       },
       'dependencies': [
+        'base_simd_ssse3',
         'base_static',
         'allocator/allocator.gyp:allocator_extension_thunks',
         '../testing/gtest.gyp:gtest_prod',
@@ -363,6 +364,52 @@
         '..',
       ],
     },
+    {
+      # The files of base which are built with SSSE3 enabled. Their code is
+      # only run once base::CPU has confirmed the processor supports it.
+      'target_name': 'base_simd_ssse3',
+      'type': 'static_library',
+      'variables': {
+        'optimize': 'max',
+      },
+      'toolsets': ['host', 'target'],
+      'sources': [
+        'utf_string_conversion_utils_ssse3.cc',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+      'conditions': [
+        ['target_arch=="ia32" or target_arch=="x64"', {
+          'cflags': [
+            '-mssse3',
+          ],
+          'xcode_settings': {
+            'GCC_ENABLE_SUPPLEMENTAL_SSE3_INSTRUCTIONS': 'YES',  # -mssse3
+          },
+        }],
+      ],
+    },
+    {
+      # The 64-bit build of base_simd_ssse3, for base_nacl_win64. MSVC needs
+      # no flag for SSSE3 intrinsics.
+      'target_name': 'base_simd_ssse3_win64',
+      'type': 'static_library',
+      'sources': [
+        'utf_string_conversion_utils_ssse3.cc',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+      'configurations': {
+        'Common_Base': {
+          'msvs_target_platform': 'x64',
+        },
+      },
+      'defines': [
+        'NACL_WIN64',
+      ],
+    },
     {
       # TODO(rvargas): Remove this when gyp finally supports a clean model.
       # See bug 36232.
@@ -435,6 +482,7 @@
         'cpu_unittest.cc',
         'debug/leak_tracker_unittest.cc',
         'debug/stack_trace_unittest.cc',
+        'debug/trace_event_binary_unittest.cc',
         'debug/trace_event_unittest.cc',
         'debug/trace_event_unittest.h',
         'debug/trace_event_win_unittest.cc',
@@ -462,11 +510,13 @@
         'ios/device_util_unittest.mm',
         'json/json_parser_unittest.cc',
         'json/json_reader_unittest.cc',
+        'json/json_string_scan_unittest.cc',
         'json/json_value_converter_unittest.cc',
         'json/json_value_serializer_unittest.cc',
         'json/json_writer_unittest.cc',
         'json/string_escape_unittest.cc',
         'lazy_instance_unittest.cc',
+        'lock_free_task_queue_unittest.cc',
         'logging_unittest.cc',
         'mac/bind_objc_block_unittest.mm',
         'mac/foundation_util_unittest.mm',
@@ -496,6 +546,7 @@
         'metrics/sample_vector_unittest.cc',
         'metrics/bucket_ranges_unittest.cc',
         'metrics/field_trial_unittest.cc',
+        'metrics/histogram_shared_memory_unittest.cc',
         'metrics/histogram_unittest.cc',
         'metrics/sparse_histogram_unittest.cc',
         'metrics/stats_table_unittest.cc',
@@ -866,6 +917,36 @@
   'conditions': [
     ['OS!="ios"', {
       'targets': [
+        {
+          'target_name': 'base_perftests',
+          'type': 'executable',
+          'dependencies': [
+            'base',
+            'test_support_base',
+            'test_support_perf',
+            '../testing/gtest.gyp:gtest',
+          ],
+          'sources': [
+            'debug/trace_event_perftest.cc',
+            'json/json_perftest.cc',
+            'message_loop_perftest.cc',
+            'metrics/histogram_perftest.cc',
+            'threading/sequenced_worker_pool_perftest.cc',
+            'utf_string_conversions_perftest.cc',
+          ],
+        },
+        {
+          # Converts binary traces written by TraceLog::FlushAsBinary() to
+          # JSON.
+          'target_name': 'trace_converter',
+          'type': 'executable',
+          'dependencies': [
+            'base',
+          ],
+          'sources': [
+            'debug/trace_converter_main.cc',
+          ],
+        },
         {
           'target_name': 'check_example',
           'type': 'executable',
@@ -887,6 +968,7 @@
             'base_target': 1,
           },
           'dependencies': [
+            'base_simd_ssse3_win64',
             'base_static_win64',
             'allocator/allocator.gyp:allocator_extension_thunks_win64',
             'third_party/dynamic_annotations/dynamic_annotations.gyp:dynamic_annotations_win64',
@@ -8,6 +8,16 @@
 #include <string>
 
 #include "base/base_export.h"
+#include "build/build_config.h"
+
+// Defined when SSE2 instructions may be used without asking the CPU. SSE2 is
+// part of x86-64, but 32-bit x86 builds only have it if the compiler was told
+// so.
+#if defined(ARCH_CPU_X86_64) || \
+    (defined(ARCH_CPU_X86) && (defined(__SSE2__) || \
+                               (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define ARCH_CPU_HAS_SSE2 1
+#endif
 
 namespace base {
 
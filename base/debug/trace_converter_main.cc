@@ -0,0 +1,93 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Converts a binary trace (see base/debug/trace_event_binary.h), as written by
+// --trace-startup-format=binary, into the JSON trace format that
+// about:tracing loads.
+//
+// Usage: trace_converter <binary trace file> <json output file>
+
+#include <stdio.h>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/debug/trace_event_binary.h"
+#include "base/debug/trace_event_impl.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+
+namespace {
+
+// Size of the reads from the binary trace.
+const size_t kReadSize = 256 * 1024;
+
+bool g_write_failed = false;
+
+void WriteToFile(FILE* file, const std::string& data) {
+  if (fwrite(data.data(), 1, data.size(), file) != data.size())
+    g_write_failed = true;
+}
+
+void AddFragment(base::debug::TraceResultBuffer* result_buffer,
+                 const std::string& fragment) {
+  result_buffer->AddFragment(fragment);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+  const CommandLine::StringVector& args =
+      CommandLine::ForCurrentProcess()->GetArgs();
+  if (args.size() != 2) {
+    fprintf(stderr, "Usage: %s <binary trace file> <json output file>\n",
+            argv[0]);
+    return 1;
+  }
+
+  FILE* input = file_util::OpenFile(FilePath(args[0]), "rb");
+  if (!input) {
+    fprintf(stderr, "Could not open %" PRFilePath "\n", args[0].c_str());
+    return 1;
+  }
+  FILE* output = file_util::OpenFile(FilePath(args[1]), "wb");
+  if (!output) {
+    fprintf(stderr, "Could not create %" PRFilePath "\n", args[1].c_str());
+    file_util::CloseFile(input);
+    return 1;
+  }
+
+  base::debug::TraceResultBuffer result_buffer;
+  result_buffer.SetOutputCallback(base::Bind(&WriteToFile, output));
+  result_buffer.Start();
+  base::debug::TraceBinaryReader reader(
+      base::Bind(&AddFragment, base::Unretained(&result_buffer)));
+
+  bool ok = true;
+  std::string buffer(kReadSize, '\0');
+  while (ok) {
+    size_t read = fread(&buffer[0], 1, buffer.size(), input);
+    if (read == 0)
+      break;
+    ok = reader.Append(base::StringPiece(buffer.data(), read));
+  }
+  ok = ok && !ferror(input) && reader.Finish();
+  result_buffer.Finish();
+
+  file_util::CloseFile(input);
+  file_util::CloseFile(output);
+
+  if (!ok) {
+    fprintf(stderr, "%" PRFilePath " is not a valid binary trace\n",
+            args[0].c_str());
+    return 1;
+  }
+  if (g_write_failed) {
+    fprintf(stderr, "Could not write %" PRFilePath "\n", args[1].c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,388 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string.h>
+
+#include "base/debug/trace_event.h"
+#include "base/logging.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+enum RecordType {
+  HEADER_RECORD = 1,
+  STRING_RECORD = 2,
+  EVENT_RECORD = 3,
+  JSON_RECORD = 4
+};
+
+const char kMagic[] = "CRTB";
+const size_t kMagicSize = 4;
+const uint32 kVersion = 1;
+
+// One byte of type and four of payload length.
+const size_t kRecordHeaderSize = sizeof(uint8) + sizeof(uint32);
+
+bool IsStringType(unsigned char type) {
+  return type == TRACE_VALUE_TYPE_STRING ||
+      type == TRACE_VALUE_TYPE_COPY_STRING;
+}
+
+// Reads fixed-size fields from a record payload.
+class PayloadReader {
+ public:
+  explicit PayloadReader(const StringPiece& payload) : data_(payload) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (data_.size() < sizeof(T))
+      return false;
+    memcpy(value, data_.data(), sizeof(T));
+    data_.remove_prefix(sizeof(T));
+    return true;
+  }
+
+  bool ReadBytes(size_t size, StringPiece* bytes) {
+    if (data_.size() < size)
+      return false;
+    *bytes = StringPiece(data_.data(), size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  StringPiece rest() const { return data_; }
+
+ private:
+  StringPiece data_;
+
+  DISALLOW_COPY_AND_ASSIGN(PayloadReader);
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceBinaryWriter
+//
+////////////////////////////////////////////////////////////////////////////////
+
+TraceBinaryWriter::TraceBinaryWriter(
+    int process_id,
+    const TraceLog::OutputCallback& output_callback)
+    : process_id_(process_id),
+      output_callback_(output_callback),
+      buffer_(new RefCountedString),
+      record_length_offset_(0),
+      wrote_header_(false),
+      next_string_id_(0) {
+}
+
+TraceBinaryWriter::~TraceBinaryWriter() {
+  DCHECK(buffer_->data().empty()) << "Flush() was not called";
+}
+
+void TraceBinaryWriter::AddEvent(const TraceEvent& event) {
+  // Strings go out in records of their own, so intern them before starting
+  // the event record.
+  InternMode mode = (event.flags() & TRACE_EVENT_FLAG_COPY) ?
+      INTERN_BY_VALUE : INTERN_BY_ADDRESS;
+  uint32 category_id = InternString(
+      TraceLog::GetCategoryName(event.category_enabled()), INTERN_BY_ADDRESS);
+  uint32 name_id = InternString(event.name(), mode);
+  uint32 arg_name_ids[kTraceMaxNumArgs];
+  int num_args = 0;
+  for (; num_args < kTraceMaxNumArgs && event.arg_name(num_args); ++num_args)
+    arg_name_ids[num_args] = InternString(event.arg_name(num_args), mode);
+
+  BeginRecord(EVENT_RECORD);
+  Append<uint32>(category_id);
+  Append<uint32>(name_id);
+  Append<int32>(event.thread_id());
+  Append<int64>(event.timestamp().ToInternalValue());
+  Append<uint8>(event.phase());
+  Append<uint8>(event.flags());
+  if (event.flags() & TRACE_EVENT_FLAG_HAS_ID)
+    Append<uint64>(event.id());
+  Append<uint8>(num_args);
+  for (int i = 0; i < num_args; ++i) {
+    Append<uint32>(arg_name_ids[i]);
+    Append<uint8>(event.arg_type(i));
+    TraceEvent::TraceValue value = event.arg_value(i);
+    if (IsStringType(event.arg_type(i))) {
+      if (!value.as_string) {
+        Append<uint32>(kuint32max);
+      } else {
+        uint32 length = static_cast<uint32>(strlen(value.as_string));
+        Append<uint32>(length);
+        AppendBytes(value.as_string, length);
+      }
+    } else {
+      Append<uint64>(value.as_uint);
+    }
+  }
+  EndRecord();
+}
+
+void TraceBinaryWriter::AddJSONFragment(const std::string& json_fragment) {
+  if (json_fragment.empty())
+    return;
+  BeginRecord(JSON_RECORD);
+  AppendBytes(json_fragment.data(), json_fragment.size());
+  EndRecord();
+}
+
+void TraceBinaryWriter::Flush() {
+  if (buffer_->data().empty())
+    return;
+  scoped_refptr<RefCountedString> chunk(buffer_);
+  buffer_ = new RefCountedString;
+  output_callback_.Run(chunk);
+}
+
+uint32 TraceBinaryWriter::InternString(const char* str, InternMode mode) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(str);
+  if (mode == INTERN_BY_ADDRESS) {
+    base::hash_map<uintptr_t, uint32>::const_iterator it =
+        ids_by_address_.find(address);
+    if (it != ids_by_address_.end())
+      return it->second;
+  } else {
+    base::hash_map<std::string, uint32>::const_iterator it =
+        ids_by_value_.find(str);
+    if (it != ids_by_value_.end())
+      return it->second;
+  }
+
+  if (!wrote_header_) {
+    wrote_header_ = true;
+    BeginRecord(HEADER_RECORD);
+    AppendBytes(kMagic, kMagicSize);
+    Append<uint32>(kVersion);
+    Append<int32>(process_id_);
+    EndRecord();
+  }
+
+  uint32 id = next_string_id_++;
+  BeginRecord(STRING_RECORD);
+  Append<uint32>(id);
+  AppendBytes(str, strlen(str));
+  EndRecord();
+
+  if (mode == INTERN_BY_ADDRESS)
+    ids_by_address_[address] = id;
+  else
+    ids_by_value_[str] = id;
+  return id;
+}
+
+void TraceBinaryWriter::BeginRecord(uint8 type) {
+  Append<uint8>(type);
+  record_length_offset_ = buffer_->data().size();
+  Append<uint32>(0);
+}
+
+void TraceBinaryWriter::EndRecord() {
+  std::string& data = buffer_->data();
+  uint32 length = static_cast<uint32>(
+      data.size() - record_length_offset_ - sizeof(uint32));
+  memcpy(&data[record_length_offset_], &length, sizeof(length));
+  if (data.size() >= kChunkSize)
+    Flush();
+}
+
+void TraceBinaryWriter::AppendBytes(const void* data, size_t size) {
+  buffer_->data().append(static_cast<const char*>(data), size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceBinaryReader
+//
+////////////////////////////////////////////////////////////////////////////////
+
+TraceBinaryReader::TraceBinaryReader(const FragmentCallback& fragment_callback)
+    : fragment_callback_(fragment_callback),
+      process_id_(0),
+      has_header_(false),
+      failed_(false) {
+}
+
+TraceBinaryReader::~TraceBinaryReader() {
+}
+
+// static
+bool TraceBinaryReader::IsBinaryTrace(const StringPiece& data) {
+  return data.size() >= kRecordHeaderSize + kMagicSize &&
+      static_cast<uint8>(data[0]) == HEADER_RECORD &&
+      memcmp(data.data() + kRecordHeaderSize, kMagic, kMagicSize) == 0;
+}
+
+bool TraceBinaryReader::Append(const StringPiece& data) {
+  if (failed_)
+    return false;
+
+  // Only copy the input when a record from the previous call is incomplete.
+  StringPiece input = data;
+  if (!pending_.empty()) {
+    pending_.append(data.data(), data.size());
+    input = pending_;
+  }
+
+  size_t consumed = 0;
+  while (input.size() - consumed >= kRecordHeaderSize) {
+    const char* record = input.data() + consumed;
+    uint32 length;
+    memcpy(&length, record + sizeof(uint8), sizeof(length));
+    if (input.size() - consumed - kRecordHeaderSize < length)
+      break;
+    if (!ParseRecord(static_cast<uint8>(record[0]),
+                     StringPiece(record + kRecordHeaderSize, length))) {
+      failed_ = true;
+      return false;
+    }
+    consumed += kRecordHeaderSize + length;
+  }
+
+  std::string rest(input.data() + consumed, input.size() - consumed);
+  pending_.swap(rest);
+
+  if (fragment_.size() >= TraceBinaryWriter::kChunkSize)
+    FlushFragment();
+  return true;
+}
+
+bool TraceBinaryReader::Finish() {
+  if (failed_)
+    return false;
+  FlushFragment();
+  return pending_.empty();
+}
+
+bool TraceBinaryReader::ParseRecord(uint8 type, const StringPiece& payload) {
+  PayloadReader reader(payload);
+  switch (type) {
+    case HEADER_RECORD: {
+      StringPiece magic;
+      uint32 version;
+      int32 process_id;
+      if (!reader.ReadBytes(kMagicSize, &magic) ||
+          magic != StringPiece(kMagic, kMagicSize) ||
+          !reader.Read(&version) || version != kVersion ||
+          !reader.Read(&process_id)) {
+        return false;
+      }
+      strings_.clear();
+      process_id_ = process_id;
+      has_header_ = true;
+      return true;
+    }
+    case STRING_RECORD: {
+      uint32 id;
+      if (!has_header_ || !reader.Read(&id) || id != strings_.size())
+        return false;
+      strings_.push_back(reader.rest().as_string());
+      return true;
+    }
+    case EVENT_RECORD:
+      return has_header_ && ParseEvent(payload);
+    case JSON_RECORD:
+      if (payload.empty())
+        return true;
+      if (!fragment_.empty())
+        fragment_ += ",";
+      payload.AppendToString(&fragment_);
+      return true;
+    default:
+      // Written by a newer version; skip it.
+      return true;
+  }
+}
+
+bool TraceBinaryReader::ParseEvent(const StringPiece& payload) {
+  PayloadReader reader(payload);
+  uint32 category_id;
+  uint32 name_id;
+  int32 thread_id;
+  int64 timestamp;
+  uint8 phase;
+  uint8 flags;
+  uint64 id = 0;
+  uint8 num_args;
+  if (!reader.Read(&category_id) || category_id >= strings_.size() ||
+      !reader.Read(&name_id) || name_id >= strings_.size() ||
+      !reader.Read(&thread_id) ||
+      !reader.Read(&timestamp) ||
+      !reader.Read(&phase) ||
+      !reader.Read(&flags) ||
+      ((flags & TRACE_EVENT_FLAG_HAS_ID) && !reader.Read(&id)) ||
+      !reader.Read(&num_args) || num_args > kTraceMaxNumArgs) {
+    return false;
+  }
+
+  const char* arg_names[kTraceMaxNumArgs];
+  unsigned char arg_types[kTraceMaxNumArgs];
+  TraceEvent::TraceValue arg_values[kTraceMaxNumArgs];
+  std::string arg_strings[kTraceMaxNumArgs];
+  for (int i = 0; i < num_args; ++i) {
+    uint32 arg_name_id;
+    uint8 arg_type;
+    if (!reader.Read(&arg_name_id) || arg_name_id >= strings_.size() ||
+        !reader.Read(&arg_type)) {
+      return false;
+    }
+    arg_names[i] = strings_[arg_name_id].c_str();
+    arg_types[i] = arg_type;
+    if (IsStringType(arg_type)) {
+      uint32 length;
+      if (!reader.Read(&length))
+        return false;
+      if (length == kuint32max) {
+        arg_values[i].as_string = NULL;
+      } else {
+        StringPiece value;
+        if (!reader.ReadBytes(length, &value))
+          return false;
+        value.CopyToString(&arg_strings[i]);
+        arg_values[i].as_string = arg_strings[i].c_str();
+      }
+    } else {
+      uint64 value;
+      if (!reader.Read(&value))
+        return false;
+      arg_values[i].as_uint = value;
+    }
+  }
+
+  if (!fragment_.empty())
+    fragment_ += ",";
+  TraceEvent::AppendFieldsAsJSON(strings_[category_id].c_str(),
+                                 process_id_,
+                                 thread_id,
+                                 timestamp,
+                                 static_cast<char>(phase),
+                                 strings_[name_id].c_str(),
+                                 num_args,
+                                 arg_names,
+                                 arg_types,
+                                 arg_values,
+                                 flags,
+                                 id,
+                                 &fragment_);
+  return true;
+}
+
+void TraceBinaryReader::FlushFragment() {
+  if (fragment_.empty())
+    return;
+  std::string fragment;
+  fragment.swap(fragment_);
+  fragment_callback_.Run(fragment);
+}
+
+}  // namespace debug
+}  // namespace base
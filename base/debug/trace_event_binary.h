@@ -0,0 +1,156 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A compact, streaming alternative to the JSON produced by TraceLog::Flush().
+//
+// A binary trace is a sequence of records. Every record is a one-byte type,
+// a uint32 payload length and the payload. All integers are in host byte
+// order; binary traces are meant to be converted on the machine (or at least
+// the architecture) that wrote them.
+//
+//   HEADER  "CRTB", uint32 version, int32 process id. Starts a new stream and
+//           forgets the strings of the previous one, so the output of several
+//           flushes or processes can simply be concatenated.
+//   STRING  uint32 id, then the characters of the string. Categories, event
+//           names and argument names are sent once per stream and referred
+//           to by id afterwards. Ids are assigned in order from 0.
+//   EVENT   uint32 category id, uint32 name id, int32 thread id,
+//           int64 timestamp, uint8 phase, uint8 flags, a uint64 id if the
+//           flags have TRACE_EVENT_FLAG_HAS_ID, uint8 argument count, then for
+//           every argument a uint32 name id, a uint8 type, and either a
+//           uint32 length followed by the characters of a string value
+//           (kuint32max for NULL) or the 8-byte value.
+//   JSON    Events that were already serialized as a JSON fragment, such as
+//           the data sent by child processes. Valid anywhere in the trace.
+//
+// Records of unknown types are skipped by the reader.
+
+#ifndef BASE_DEBUG_TRACE_EVENT_BINARY_H_
+#define BASE_DEBUG_TRACE_EVENT_BINARY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/debug/trace_event_impl.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/string_piece.h"
+
+namespace base {
+namespace debug {
+
+// Serializes TraceEvents into the binary trace format. Output is handed to
+// the callback in chunks of roughly kChunkSize bytes; records may span
+// chunks, and the chunks must be stored or sent in order.
+class BASE_EXPORT TraceBinaryWriter {
+ public:
+  // Approximate size of the chunks passed to the output callback.
+  static const size_t kChunkSize = 64 * 1024;
+
+  TraceBinaryWriter(int process_id,
+                    const TraceLog::OutputCallback& output_callback);
+  ~TraceBinaryWriter();
+
+  void AddEvent(const TraceEvent& event);
+
+  // Adds events which are already serialized as a JSON fragment (the format
+  // produced by TraceLog::Flush()).
+  void AddJSONFragment(const std::string& json_fragment);
+
+  // Passes everything written so far to the output callback. Must be called
+  // after the last event.
+  void Flush();
+
+ private:
+  enum InternMode {
+    // |str| lives as long as the process (a literal), so it can be looked up
+    // by address.
+    INTERN_BY_ADDRESS,
+    // |str| is a copy; look it up by contents.
+    INTERN_BY_VALUE
+  };
+
+  // Returns the id of |str|, writing a STRING record the first time it is
+  // seen.
+  uint32 InternString(const char* str, InternMode mode);
+
+  void BeginRecord(uint8 type);
+  void EndRecord();
+
+  void AppendBytes(const void* data, size_t size);
+  template <typename T>
+  void Append(T value) {
+    AppendBytes(&value, sizeof(value));
+  }
+
+  const int process_id_;
+  const TraceLog::OutputCallback output_callback_;
+
+  // Bytes not passed to |output_callback_| yet.
+  scoped_refptr<RefCountedString> buffer_;
+
+  // Offset of the length field of the record being written, in |buffer_|.
+  size_t record_length_offset_;
+
+  // The HEADER record is only written before the first STRING record, so a
+  // writer which only ever sees JSON fragments does not start a new stream.
+  bool wrote_header_;
+
+  base::hash_map<uintptr_t, uint32> ids_by_address_;
+  base::hash_map<std::string, uint32> ids_by_value_;
+  uint32 next_string_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBinaryWriter);
+};
+
+// Converts a binary trace back into the JSON fragments that TraceLog::Flush()
+// would have produced, so that the output of a TraceResultBuffer fed with
+// them is a JSON trace viewable in about:tracing.
+class BASE_EXPORT TraceBinaryReader {
+ public:
+  typedef base::Callback<void(const std::string&)> FragmentCallback;
+
+  explicit TraceBinaryReader(const FragmentCallback& fragment_callback);
+  ~TraceBinaryReader();
+
+  // Returns true if |data| starts like a binary trace, as opposed to JSON.
+  static bool IsBinaryTrace(const StringPiece& data);
+
+  // Consumes the next bytes of the trace. Records may be split across calls.
+  // Returns false, now and for every later call, if the trace is malformed.
+  bool Append(const StringPiece& data);
+
+  // Passes the remaining events to the fragment callback. Returns false if
+  // the trace was malformed or ends in the middle of a record.
+  bool Finish();
+
+ private:
+  bool ParseRecord(uint8 type, const StringPiece& payload);
+  bool ParseEvent(const StringPiece& payload);
+  void FlushFragment();
+
+  const FragmentCallback fragment_callback_;
+
+  // Bytes of an incomplete record from the previous Append().
+  std::string pending_;
+
+  // Strings of the current stream, by id.
+  std::vector<std::string> strings_;
+
+  int process_id_;
+  bool has_header_;
+  bool failed_;
+
+  // Events converted but not passed to |fragment_callback_| yet.
+  std::string fragment_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBinaryReader);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_TRACE_EVENT_BINARY_H_
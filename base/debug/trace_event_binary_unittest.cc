@@ -0,0 +1,251 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+void AppendChunk(std::string* out,
+                 const scoped_refptr<RefCountedString>& chunk) {
+  out->append(chunk->data());
+}
+
+void AppendFragment(std::vector<std::string>* fragments,
+                    const std::string& fragment) {
+  fragments->push_back(fragment);
+}
+
+std::string JoinFragments(const std::vector<std::string>& fragments) {
+  std::string joined;
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    if (i > 0)
+      joined += ",";
+    joined += fragments[i];
+  }
+  return joined;
+}
+
+// Converts |binary|, fed to the reader |step| bytes at a time, to JSON.
+bool ConvertToJSON(const std::string& binary, size_t step, std::string* json) {
+  std::vector<std::string> fragments;
+  TraceBinaryReader reader(Bind(&AppendFragment, &fragments));
+  for (size_t i = 0; i < binary.size(); i += step) {
+    if (!reader.Append(StringPiece(binary).substr(i, step)))
+      return false;
+  }
+  if (!reader.Finish())
+    return false;
+  *json = JoinFragments(fragments);
+  return true;
+}
+
+void RecordEvents() {
+  TRACE_EVENT_INSTANT2("cat", "ints", "a", -5, "b", 7u);
+  TRACE_EVENT_INSTANT2("cat", "misc", "double", 1.5, "bool", true);
+  TRACE_EVENT_INSTANT1("cat", "pointer", "p", reinterpret_cast<void*>(0xbeef));
+  TRACE_EVENT_INSTANT2("cat", "strings", "s", "quote\"d", "null",
+                       static_cast<const char*>(NULL));
+  TRACE_EVENT_COPY_INSTANT1("cat", std::string("copied").c_str(),
+                            std::string("arg").c_str(),
+                            std::string("value"));
+  TRACE_EVENT_COPY_INSTANT1("cat", std::string("copied").c_str(),
+                            std::string("arg").c_str(), 2);
+  TRACE_EVENT_ASYNC_BEGIN0("other cat", "async", 0x1234);
+  TRACE_EVENT_ASYNC_END0("other cat", "async", 0x1234);
+  TRACE_EVENT0("cat", "scoped");
+}
+
+}  // namespace
+
+class TraceBinaryTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    TraceLog::DeleteForTesting();
+    TraceLog::Resurrect();
+  }
+
+  // Records a few events of every kind and returns them.
+  std::vector<TraceEvent> RecordAndTakeEvents() {
+    TraceLog* trace_log = TraceLog::GetInstance();
+    trace_log->SetEnabled("*");
+    RecordEvents();
+    trace_log->SetDisabled();
+
+    std::vector<TraceEvent> events;
+    trace_log->MergeThreadBuffersForTesting();
+    size_t count = trace_log->GetEventsSize();
+    for (size_t i = 0; i < count; ++i)
+      events.push_back(trace_log->GetEventAt(i));
+    return events;
+  }
+
+ private:
+  // We want our singleton torn down after each test.
+  ShadowingAtExitManager at_exit_manager_;
+};
+
+// The converted binary trace matches the JSON written directly.
+TEST_F(TraceBinaryTest, ConvertsToSameJSON) {
+  std::vector<TraceEvent> events = RecordAndTakeEvents();
+  ASSERT_GT(events.size(), 9u);
+
+  std::string expected_json;
+  TraceEvent::AppendEventsAsJSON(events, 0, events.size(), &expected_json);
+
+  std::string binary;
+  TraceBinaryWriter writer(TraceLog::GetInstance()->process_id(),
+                           Bind(&AppendChunk, &binary));
+  for (size_t i = 0; i < events.size(); ++i)
+    writer.AddEvent(events[i]);
+  writer.Flush();
+  EXPECT_TRUE(TraceBinaryReader::IsBinaryTrace(binary));
+  EXPECT_FALSE(TraceBinaryReader::IsBinaryTrace(expected_json));
+
+  std::string json;
+  ASSERT_TRUE(ConvertToJSON(binary, binary.size(), &json));
+  EXPECT_EQ(expected_json, json);
+
+  // Records split across Append() calls are put back together.
+  ASSERT_TRUE(ConvertToJSON(binary, 1, &json));
+  EXPECT_EQ(expected_json, json);
+  ASSERT_TRUE(ConvertToJSON(binary, 7, &json));
+  EXPECT_EQ(expected_json, json);
+}
+
+// Strings are only written once per stream.
+TEST_F(TraceBinaryTest, InternsStrings) {
+  std::vector<TraceEvent> events = RecordAndTakeEvents();
+
+  std::string once;
+  TraceBinaryWriter writer1(1, Bind(&AppendChunk, &once));
+  writer1.AddEvent(events[0]);
+  writer1.Flush();
+
+  std::string twice;
+  TraceBinaryWriter writer2(1, Bind(&AppendChunk, &twice));
+  writer2.AddEvent(events[0]);
+  writer2.AddEvent(events[0]);
+  writer2.Flush();
+
+  // The second event only adds its own record, which does not contain the
+  // category or event name.
+  size_t event_size = twice.size() - once.size();
+  EXPECT_LT(event_size, once.size());
+  EXPECT_EQ(std::string::npos,
+            twice.substr(once.size()).find(events[0].name()));
+}
+
+// Streams can be concatenated, each with its own process id and strings, and
+// JSON fragments are passed through.
+TEST_F(TraceBinaryTest, ConcatenatedStreamsAndJSONFragments) {
+  std::vector<TraceEvent> events = RecordAndTakeEvents();
+
+  std::string binary;
+  {
+    TraceBinaryWriter writer(11, Bind(&AppendChunk, &binary));
+    writer.AddEvent(events[0]);
+    writer.Flush();
+  }
+  {
+    TraceBinaryWriter writer(0, Bind(&AppendChunk, &binary));
+    writer.AddJSONFragment("{\"name\":\"from child\"}");
+    writer.Flush();
+  }
+  {
+    TraceBinaryWriter writer(22, Bind(&AppendChunk, &binary));
+    writer.AddEvent(events[1]);
+    writer.Flush();
+  }
+
+  std::string json;
+  ASSERT_TRUE(ConvertToJSON(binary, binary.size(), &json));
+  scoped_ptr<Value> root(JSONReader::Read("[" + json + "]"));
+  ASSERT_TRUE(root.get());
+  ListValue* list = NULL;
+  ASSERT_TRUE(root->GetAsList(&list));
+  ASSERT_EQ(3u, list->GetSize());
+
+  DictionaryValue* dict = NULL;
+  int pid = 0;
+  std::string name;
+  ASSERT_TRUE(list->GetDictionary(0, &dict));
+  EXPECT_TRUE(dict->GetInteger("pid", &pid));
+  EXPECT_EQ(11, pid);
+  EXPECT_TRUE(dict->GetString("name", &name));
+  EXPECT_EQ(events[0].name(), name);
+
+  ASSERT_TRUE(list->GetDictionary(1, &dict));
+  EXPECT_TRUE(dict->GetString("name", &name));
+  EXPECT_EQ("from child", name);
+
+  ASSERT_TRUE(list->GetDictionary(2, &dict));
+  EXPECT_TRUE(dict->GetInteger("pid", &pid));
+  EXPECT_EQ(22, pid);
+  EXPECT_TRUE(dict->GetString("name", &name));
+  EXPECT_EQ(events[1].name(), name);
+}
+
+TEST_F(TraceBinaryTest, RejectsMalformedTraces) {
+  std::vector<TraceEvent> events = RecordAndTakeEvents();
+  std::string binary;
+  TraceBinaryWriter writer(1, Bind(&AppendChunk, &binary));
+  writer.AddEvent(events[0]);
+  writer.Flush();
+
+  std::string json;
+  // Truncated in the middle of a record.
+  EXPECT_FALSE(ConvertToJSON(binary.substr(0, binary.size() - 1), 16, &json));
+
+  // An event without the strings it refers to.
+  std::string event_only = binary;
+  event_only[0] = 0x7f;  // Turns the header into an unknown record.
+  EXPECT_FALSE(ConvertToJSON(event_only, event_only.size(), &json));
+}
+
+// TraceLog::FlushAsBinary() output converts to the events that were recorded.
+TEST_F(TraceBinaryTest, FlushAsBinary) {
+  TraceLog* trace_log = TraceLog::GetInstance();
+  trace_log->SetEnabled("*");
+  for (int i = 0; i < 5000; ++i)
+    TRACE_EVENT_INSTANT1("cat", "many", "i", i);
+  trace_log->SetDisabled();
+
+  std::string binary;
+  trace_log->FlushAsBinary(Bind(&AppendChunk, &binary));
+
+  std::string json;
+  ASSERT_TRUE(ConvertToJSON(binary, 4096, &json));
+  scoped_ptr<Value> root(JSONReader::Read("[" + json + "]"));
+  ASSERT_TRUE(root.get());
+  ListValue* list = NULL;
+  ASSERT_TRUE(root->GetAsList(&list));
+
+  int count = 0;
+  for (size_t i = 0; i < list->GetSize(); ++i) {
+    DictionaryValue* dict = NULL;
+    std::string name;
+    int value = -1;
+    if (list->GetDictionary(i, &dict) && dict->GetString("name", &name) &&
+        name == "many") {
+      EXPECT_TRUE(dict->GetInteger("args.i", &value));
+      EXPECT_EQ(count, value);
+      ++count;
+    }
+  }
+  EXPECT_EQ(5000, count);
+}
+
+}  // namespace debug
+}  // namespace base
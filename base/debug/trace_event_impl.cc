@@ -9,6 +9,7 @@
 #include "base/bind.h"
 #include "base/debug/leak_annotations.h"
 #include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/format_macros.h"
 #include "base/lazy_instance.h"
 #include "base/memory/singleton.h"
@@ -44,6 +45,10 @@ namespace debug {
 const size_t kTraceEventBufferSize = 500000;
 const size_t kTraceEventBatchSize = 1000;
 
+// Number of events in a TraceBufferChunk. A thread takes |lock_| once every
+// kTraceBufferChunkSize events.
+const int kTraceBufferChunkSize = 64;
+
 #define TRACE_EVENT_MAX_CATEGORIES 100
 
 namespace {
@@ -69,6 +74,21 @@ int g_category_index = 3; // skip initial 3 categories
 LazyInstance<ThreadLocalPointer<const char> >::Leaky
     g_current_thread_name = LAZY_INSTANCE_INITIALIZER;
 
+// Returns the number of events in [begin, end) named |name| in |category|.
+int CountMatchingEvents(const TraceEvent* begin,
+                        const TraceEvent* end,
+                        const unsigned char* category,
+                        const std::string& name) {
+  int count = 0;
+  for (const TraceEvent* event = begin; event != end; ++event) {
+    if (category == event->category_enabled() &&
+        strcmp(name.c_str(), event->name()) == 0) {
+      ++count;
+    }
+  }
+  return count;
+}
+
 }  // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -237,35 +257,62 @@ void TraceEvent::AppendEventsAsJSON(const std::vector<TraceEvent>& events,
 }
 
 void TraceEvent::AppendAsJSON(std::string* out) const {
-  int64 time_int64 = timestamp_.ToInternalValue();
-  int process_id = TraceLog::GetInstance()->process_id();
+  AppendFieldsAsJSON(TraceLog::GetCategoryName(category_enabled_),
+                     TraceLog::GetInstance()->process_id(),
+                     thread_id_,
+                     timestamp_.ToInternalValue(),
+                     phase_,
+                     name_,
+                     kTraceMaxNumArgs,
+                     arg_names_,
+                     arg_types_,
+                     arg_values_,
+                     flags_,
+                     id_,
+                     out);
+}
+
+// static
+void TraceEvent::AppendFieldsAsJSON(const char* category_name,
+                                    int process_id,
+                                    int thread_id,
+                                    int64 timestamp,
+                                    char phase,
+                                    const char* name,
+                                    int num_args,
+                                    const char* const* arg_names,
+                                    const unsigned char* arg_types,
+                                    const TraceValue* arg_values,
+                                    unsigned char flags,
+                                    unsigned long long id,
+                                    std::string* out) {
   // Category name checked at category creation time.
-  DCHECK(!strchr(name_, '"'));
+  DCHECK(!strchr(name, '"'));
   StringAppendF(out,
       "{\"cat\":\"%s\",\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64 ","
       "\"ph\":\"%c\",\"name\":\"%s\",\"args\":{",
-      TraceLog::GetCategoryName(category_enabled_),
+      category_name,
       process_id,
-      thread_id_,
-      time_int64,
-      phase_,
-      name_);
+      thread_id,
+      timestamp,
+      phase,
+      name);
 
   // Output argument names and values, stop at first NULL argument name.
-  for (int i = 0; i < kTraceMaxNumArgs && arg_names_[i]; ++i) {
+  for (int i = 0; i < num_args && arg_names[i]; ++i) {
     if (i > 0)
       *out += ",";
     *out += "\"";
-    *out += arg_names_[i];
+    *out += arg_names[i];
     *out += "\":";
-    AppendValueAsJSON(arg_types_[i], arg_values_[i], out);
+    AppendValueAsJSON(arg_types[i], arg_values[i], out);
   }
   *out += "}";
 
-  // If id_ is set, print it out as a hex string so we don't loose any
+  // If id is set, print it out as a hex string so we don't loose any
   // bits (it might be a 64-bit pointer).
-  if (flags_ & TRACE_EVENT_FLAG_HAS_ID)
-    StringAppendF(out, ",\"id\":\"%" PRIx64 "\"", static_cast<uint64>(id_));
+  if (flags & TRACE_EVENT_FLAG_HAS_ID)
+    StringAppendF(out, ",\"id\":\"%" PRIx64 "\"", static_cast<uint64>(id));
   *out += "}";
 }
 
@@ -318,6 +365,39 @@ void TraceResultBuffer::Finish() {
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceLog::TraceBufferChunk and TraceLog::ThreadLocalEventBuffer
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct TraceLog::TraceBufferChunk {
+  TraceBufferChunk() : size(0), merged(0) {}
+
+  TraceEvent events[kTraceBufferChunkSize];
+
+  // Number of events written so far. Only the owning thread writes events;
+  // it publishes each one with a release store so that Flush() can copy the
+  // events below |size| while the thread keeps writing above it.
+  subtle::Atomic32 size;
+
+  // Number of leading events already moved into |logged_events_|. Protected
+  // by |lock_|.
+  int merged;
+};
+
+struct TraceLog::ThreadLocalEventBuffer {
+  explicit ThreadLocalEventBuffer(TraceLog* trace_log)
+      : trace_log(trace_log),
+        chunk(NULL) {
+  }
+
+  TraceLog* trace_log;
+
+  // Only replaced under |lock_|, by the owning thread.
+  TraceBufferChunk* chunk;
+};
+
 TraceLog::NotificationHelper::NotificationHelper(TraceLog* trace_log)
     : trace_log_(trace_log),
       notification_(0) {
@@ -347,6 +427,12 @@ TraceLog* TraceLog::GetInstance() {
 
 TraceLog::TraceLog()
     : enabled_(false),
+      options_(RECORD_UNTIL_FULL),
+      continuous_buffer_size_(kTraceEventBufferSize * sizeof(TraceEvent)),
+      thread_buffer_slot_(&TraceLog::OnThreadExit),
+      num_chunks_(0),
+      max_chunks_(kTraceEventBufferSize / kTraceBufferChunkSize),
+      buffer_is_full_(0),
       dispatching_to_observer_list_(false),
       watch_category_(NULL) {
   // Trace is enabled or disabled on one thread while other threads are
@@ -360,6 +446,9 @@ TraceLog::TraceLog()
     ANNOTATE_BENIGN_RACE(&g_category_enabled[i],
                          "trace_event category enabled");
   }
+  // AddTraceEvent() only takes the lock to check the watch event if the
+  // category matches.
+  ANNOTATE_BENIGN_RACE(&watch_category_, "trace_event watch category");
 #if defined(OS_NACL)  // NaCl shouldn't expose the process id.
   SetProcessID(0);
 #else
@@ -368,6 +457,14 @@ TraceLog::TraceLog()
 }
 
 TraceLog::~TraceLog() {
+  // Threads that are still alive keep a dangling pointer in a slot that no
+  // longer exists, which is harmless.
+  thread_buffer_slot_.Free();
+  for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+    delete thread_buffers_[i]->chunk;
+    delete thread_buffers_[i];
+  }
+  STLDeleteElements(&retired_chunks_);
 }
 
 const unsigned char* TraceLog::GetCategoryEnabled(const char* name) {
@@ -476,6 +573,12 @@ void TraceLog::GetKnownCategories(std::vector<std::string>* categories) {
 
 void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
                           const std::vector<std::string>& excluded_categories) {
+  SetEnabled(included_categories, excluded_categories, RECORD_UNTIL_FULL);
+}
+
+void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
+                          const std::vector<std::string>& excluded_categories,
+                          Options options) {
   AutoLock lock(lock_);
   if (enabled_)
     return;
@@ -492,6 +595,13 @@ void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
   dispatching_to_observer_list_ = false;
 
   logged_events_.reserve(1024);
+  options_ = options;
+  if (options_ == RECORD_CONTINUOUSLY) {
+    max_chunks_ = std::max<size_t>(
+        continuous_buffer_size_ / sizeof(TraceBufferChunk), 1);
+  } else {
+    max_chunks_ = kTraceEventBufferSize / kTraceBufferChunkSize;
+  }
   enabled_ = true;
   included_categories_ = included_categories;
   excluded_categories_ = excluded_categories;
@@ -504,6 +614,10 @@ void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
 }
 
 void TraceLog::SetEnabled(const std::string& categories) {
+  SetEnabled(categories, RECORD_UNTIL_FULL);
+}
+
+void TraceLog::SetEnabled(const std::string& categories, Options options) {
   std::vector<std::string> included, excluded;
   // Tokenize list of categories, delimited by ','.
   StringTokenizer tokens(categories, ",");
@@ -521,7 +635,12 @@ void TraceLog::SetEnabled(const std::string& categories) {
     else
       excluded.push_back(category);
   }
-  SetEnabled(included, excluded);
+  SetEnabled(included, excluded, options);
+}
+
+void TraceLog::SetContinuousBufferSize(size_t size_in_bytes) {
+  AutoLock lock(lock_);
+  continuous_buffer_size_ = size_in_bytes;
 }
 
 void TraceLog::GetEnabledTraceCategories(
@@ -580,7 +699,8 @@ void TraceLog::RemoveEnabledStateObserver(
 }
 
 float TraceLog::GetBufferPercentFull() const {
-  return (float)((double)logged_events_.size()/(double)kTraceEventBufferSize);
+  return (float)((double)subtle::NoBarrier_Load(&num_chunks_) /
+                 (double)max_chunks_);
 }
 
 void TraceLog::SetNotificationCallback(
@@ -589,12 +709,54 @@ void TraceLog::SetNotificationCallback(
   notification_callback_ = cb;
 }
 
+void TraceLog::TakeLoggedEvents(std::vector<TraceEvent>* events) {
+  AutoLock lock(lock_);
+  CopyChunkEventsWhileLocked();
+  events->swap(logged_events_);
+  STLDeleteElements(&retired_chunks_);
+  ResetChunkCountWhileLocked();
+}
+
+void TraceLog::TakeLoggedEventsAndChunks(
+    std::vector<TraceEvent>* events,
+    std::deque<TraceBufferChunk*>* chunks) {
+  AutoLock lock(lock_);
+  events->swap(logged_events_);
+  chunks->swap(retired_chunks_);
+
+  // Threads keep filling their chunks, so copy out what they have so far.
+  for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+    TraceBufferChunk* chunk = thread_buffers_[i]->chunk;
+    if (!chunk)
+      continue;
+    int size = subtle::Acquire_Load(&chunk->size);
+    if (size == chunk->merged)
+      continue;
+    TraceBufferChunk* copy = new TraceBufferChunk;
+    std::copy(chunk->events + chunk->merged, chunk->events + size,
+              copy->events);
+    copy->size = size - chunk->merged;
+    chunks->push_back(copy);
+    chunk->merged = size;
+  }
+  ResetChunkCountWhileLocked();
+}
+
+void TraceLog::ResetChunkCountWhileLocked() {
+  lock_.AssertAcquired();
+  // Chunks that threads are still filling stay in use.
+  int chunks_in_use = 0;
+  for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+    if (thread_buffers_[i]->chunk)
+      ++chunks_in_use;
+  }
+  subtle::NoBarrier_Store(&num_chunks_, chunks_in_use);
+  subtle::NoBarrier_Store(&buffer_is_full_, 0);
+}
+
 void TraceLog::Flush(const TraceLog::OutputCallback& cb) {
   std::vector<TraceEvent> previous_logged_events;
-  {
-    AutoLock lock(lock_);
-    previous_logged_events.swap(logged_events_);
-  }  // release lock
+  TakeLoggedEvents(&previous_logged_events);
 
   for (size_t i = 0;
        i < previous_logged_events.size();
@@ -609,6 +771,26 @@ void TraceLog::Flush(const TraceLog::OutputCallback& cb) {
   }
 }
 
+void TraceLog::FlushAsBinary(const TraceLog::OutputCallback& cb) {
+  std::vector<TraceEvent> previous_logged_events;
+  std::deque<TraceBufferChunk*> chunks;
+  TakeLoggedEventsAndChunks(&previous_logged_events, &chunks);
+
+  // The viewer orders events by timestamp, so unlike Flush() this writes
+  // out one chunk at a time instead of gathering and sorting every event.
+  TraceBinaryWriter writer(process_id_, cb);
+  for (size_t i = 0; i < previous_logged_events.size(); ++i)
+    writer.AddEvent(previous_logged_events[i]);
+  while (!chunks.empty()) {
+    TraceBufferChunk* chunk = chunks.front();
+    chunks.pop_front();
+    for (int i = chunk->merged; i < chunk->size; ++i)
+      writer.AddEvent(chunk->events[i]);
+    delete chunk;
+  }
+  writer.Flush();
+}
+
 void TraceLog::AddTraceEvent(char phase,
                             const unsigned char* category_enabled,
                             const char* name,
@@ -625,60 +807,56 @@ void TraceLog::AddTraceEvent(char phase,
                num_args, arg_names, arg_types, arg_values);
 #endif
 
+  // Only the recording thread touches its current chunk, so recording an
+  // event does not take |lock_| unless the chunk is full.
+  if (*category_enabled != CATEGORY_ENABLED)
+    return;
+  if (subtle::NoBarrier_Load(&buffer_is_full_))
+    return;
+
   TimeTicks now = TimeTicks::NowFromSystemTraceTime() - time_offset_;
-  NotificationHelper notifier(this);
-  {
+  int thread_id = static_cast<int>(PlatformThread::CurrentId());
+
+  const char* new_name = PlatformThread::GetName();
+  // Check if the thread name has been set or changed since the previous
+  // call (if any), but don't bother if the new name is empty. Note this will
+  // not detect a thread name change within the same char* buffer address: we
+  // favor common case performance over corner case correctness.
+  if (new_name != g_current_thread_name.Get().Get() &&
+      new_name && *new_name) {
+    g_current_thread_name.Get().Set(new_name);
     AutoLock lock(lock_);
-    if (*category_enabled != CATEGORY_ENABLED)
-      return;
-    if (logged_events_.size() >= kTraceEventBufferSize)
-      return;
-
-    int thread_id = static_cast<int>(PlatformThread::CurrentId());
-
-    const char* new_name = PlatformThread::GetName();
-    // Check if the thread name has been set or changed since the previous
-    // call (if any), but don't bother if the new name is empty. Note this will
-    // not detect a thread name change within the same char* buffer address: we
-    // favor common case performance over corner case correctness.
-    if (new_name != g_current_thread_name.Get().Get() &&
-        new_name && *new_name) {
-      g_current_thread_name.Get().Set(new_name);
-      base::hash_map<int, std::string>::iterator existing_name =
-          thread_names_.find(thread_id);
-      if (existing_name == thread_names_.end()) {
-        // This is a new thread id, and a new name.
-        thread_names_[thread_id] = new_name;
-      } else {
-        // This is a thread id that we've seen before, but potentially with a
-        // new name.
-        std::vector<base::StringPiece> existing_names;
-        Tokenize(existing_name->second, ",", &existing_names);
-        bool found = std::find(existing_names.begin(),
-                               existing_names.end(),
-                               new_name) != existing_names.end();
-        if (!found) {
-          existing_name->second.push_back(',');
-          existing_name->second.append(new_name);
-        }
-      }
-    }
+    UpdateThreadNameWhileLocked(thread_id, new_name);
+  }
 
-    if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
-      id ^= process_id_hash_;
+  if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
+    id ^= process_id_hash_;
 
-    logged_events_.push_back(
+  NotificationHelper notifier(this);
+  ThreadLocalEventBuffer* buffer = GetThreadLocalEventBuffer();
+  TraceBufferChunk* chunk = buffer->chunk;
+  if (!chunk ||
+      subtle::NoBarrier_Load(&chunk->size) == kTraceBufferChunkSize) {
+    AutoLock lock(lock_);
+    chunk = ExchangeChunkWhileLocked(chunk, &notifier);
+    buffer->chunk = chunk;
+  }
+
+  if (chunk) {
+    subtle::Atomic32 index = subtle::NoBarrier_Load(&chunk->size);
+    chunk->events[index] =
         TraceEvent(thread_id,
                    now, phase, category_enabled, name, id,
                    num_args, arg_names, arg_types, arg_values,
-                   flags));
-
-    if (logged_events_.size() == kTraceEventBufferSize)
-      notifier.AddNotificationWhileLocked(TRACE_BUFFER_FULL);
+                   flags);
+    subtle::Release_Store(&chunk->size, index + 1);
+  }
 
+  if (watch_category_ == category_enabled) {
+    AutoLock lock(lock_);
     if (watch_category_ == category_enabled && watch_event_name_ == name)
       notifier.AddNotificationWhileLocked(EVENT_WATCH_NOTIFICATION);
-  }  // release lock
+  }
 
   notifier.SendNotificationIfAny();
 }
@@ -714,14 +892,30 @@ void TraceLog::SetWatchEvent(const std::string& category_name,
     AutoLock lock(lock_);
     watch_category_ = category;
     watch_event_name_ = event_name;
+    MergeThreadBuffersWhileLocked();
 
     // First, search existing events for watch event because we want to catch it
-    // even if it has already occurred.
-    for (size_t i = 0u; i < logged_events_.size(); ++i) {
-      if (category == logged_events_[i].category_enabled() &&
-          strcmp(event_name.c_str(), logged_events_[i].name()) == 0) {
-        ++notify_count;
-      }
+    // even if it has already occurred. In RECORD_CONTINUOUSLY mode they are
+    // still in the chunks.
+    if (!logged_events_.empty()) {
+      notify_count += CountMatchingEvents(
+          &logged_events_[0], &logged_events_[0] + logged_events_.size(),
+          category, event_name);
+    }
+    for (size_t i = 0; i < retired_chunks_.size(); ++i) {
+      const TraceBufferChunk* chunk = retired_chunks_[i];
+      notify_count += CountMatchingEvents(chunk->events + chunk->merged,
+                                          chunk->events + chunk->size,
+                                          category, event_name);
+    }
+    for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+      const TraceBufferChunk* chunk = thread_buffers_[i]->chunk;
+      if (!chunk)
+        continue;
+      int size = subtle::Acquire_Load(&chunk->size);
+      notify_count += CountMatchingEvents(chunk->events + chunk->merged,
+                                          chunk->events + size,
+                                          category, event_name);
     }
   }  // release lock
 
@@ -763,6 +957,132 @@ void TraceLog::AddThreadNameMetadataEvents() {
   }
 }
 
+void TraceLog::UpdateThreadNameWhileLocked(int thread_id,
+                                           const char* new_name) {
+  lock_.AssertAcquired();
+  base::hash_map<int, std::string>::iterator existing_name =
+      thread_names_.find(thread_id);
+  if (existing_name == thread_names_.end()) {
+    // This is a new thread id, and a new name.
+    thread_names_[thread_id] = new_name;
+  } else {
+    // This is a thread id that we've seen before, but potentially with a
+    // new name.
+    std::vector<base::StringPiece> existing_names;
+    Tokenize(existing_name->second, ",", &existing_names);
+    bool found = std::find(existing_names.begin(),
+                           existing_names.end(),
+                           new_name) != existing_names.end();
+    if (!found) {
+      existing_name->second.push_back(',');
+      existing_name->second.append(new_name);
+    }
+  }
+}
+
+TraceLog::ThreadLocalEventBuffer* TraceLog::GetThreadLocalEventBuffer() {
+  ThreadLocalEventBuffer* buffer =
+      static_cast<ThreadLocalEventBuffer*>(thread_buffer_slot_.Get());
+  if (!buffer) {
+    buffer = new ThreadLocalEventBuffer(this);
+    thread_buffer_slot_.Set(buffer);
+    AutoLock lock(lock_);
+    thread_buffers_.push_back(buffer);
+  }
+  return buffer;
+}
+
+TraceLog::TraceBufferChunk* TraceLog::ExchangeChunkWhileLocked(
+    TraceBufferChunk* full_chunk,
+    NotificationHelper* notifier) {
+  lock_.AssertAcquired();
+  if (full_chunk)
+    retired_chunks_.push_back(full_chunk);
+
+  size_t num_chunks = static_cast<size_t>(subtle::NoBarrier_Load(&num_chunks_));
+  if (num_chunks < max_chunks_) {
+    subtle::NoBarrier_Store(&num_chunks_,
+                            static_cast<subtle::Atomic32>(num_chunks + 1));
+    return new TraceBufferChunk;
+  }
+
+  if (options_ == RECORD_CONTINUOUSLY) {
+    // Overwrite the oldest events. If every chunk is being filled by some
+    // thread there is nothing to overwrite, so this event is dropped.
+    if (retired_chunks_.empty())
+      return NULL;
+    TraceBufferChunk* chunk = retired_chunks_.front();
+    retired_chunks_.pop_front();
+    chunk->size = 0;
+    chunk->merged = 0;
+    return chunk;
+  }
+
+  if (!subtle::NoBarrier_Load(&buffer_is_full_)) {
+    subtle::NoBarrier_Store(&buffer_is_full_, 1);
+    notifier->AddNotificationWhileLocked(TRACE_BUFFER_FULL);
+  }
+  return NULL;
+}
+
+void TraceLog::MergeThreadBuffersWhileLocked() {
+  // In RECORD_CONTINUOUSLY mode the chunks are the ring buffer, and will be
+  // overwritten; copies of their events would grow |logged_events_| past
+  // |max_chunks_|.
+  if (options_ != RECORD_CONTINUOUSLY)
+    CopyChunkEventsWhileLocked();
+}
+
+void TraceLog::CopyChunkEventsWhileLocked() {
+  lock_.AssertAcquired();
+  size_t first_new_event = logged_events_.size();
+  // Retired chunks stay in |retired_chunks_|, and count towards
+  // |num_chunks_|, until TakeLoggedEvents() deletes them.
+  for (size_t i = 0; i < retired_chunks_.size(); ++i) {
+    TraceBufferChunk* chunk = retired_chunks_[i];
+    logged_events_.insert(logged_events_.end(),
+                          chunk->events + chunk->merged,
+                          chunk->events + chunk->size);
+    chunk->merged = chunk->size;
+  }
+
+  for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+    TraceBufferChunk* chunk = thread_buffers_[i]->chunk;
+    if (!chunk)
+      continue;
+    int size = subtle::Acquire_Load(&chunk->size);
+    logged_events_.insert(logged_events_.end(),
+                          chunk->events + chunk->merged,
+                          chunk->events + size);
+    chunk->merged = size;
+  }
+
+  // Every thread's events are in order already; interleave them.
+  std::stable_sort(logged_events_.begin() + first_new_event,
+                   logged_events_.end(),
+                   TraceEvent::CompareTimestamps);
+}
+
+void TraceLog::MergeThreadBuffersForTesting() {
+  AutoLock lock(lock_);
+  MergeThreadBuffersWhileLocked();
+}
+
+// static
+void TraceLog::OnThreadExit(void* value) {
+  ThreadLocalEventBuffer* buffer = static_cast<ThreadLocalEventBuffer*>(value);
+  TraceLog* trace_log = buffer->trace_log;
+  AutoLock lock(trace_log->lock_);
+  // Keep the events of the exiting thread until the next Flush().
+  if (buffer->chunk)
+    trace_log->retired_chunks_.push_back(buffer->chunk);
+  trace_log->thread_buffers_.erase(
+      std::find(trace_log->thread_buffers_.begin(),
+                trace_log->thread_buffers_.end(),
+                buffer));
+  delete buffer;
+}
+
 void TraceLog::DeleteForTesting() {
   DeleteTraceLogForTesting::Delete();
 }
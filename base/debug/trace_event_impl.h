@@ -8,9 +8,11 @@
 
 #include "build/build_config.h"
 
+#include <deque>
 #include <string>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/callback.h"
 #include "base/hash_tables.h"
 #include "base/memory/ref_counted_memory.h"
@@ -18,6 +20,7 @@
 #include "base/string_util.h"
 #include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/timer.h"
 
 // Older style trace macros with explicit id and extra data
@@ -82,12 +85,33 @@ class BASE_EXPORT TraceEvent {
                                  std::string* out);
   void AppendAsJSON(std::string* out) const;
 
+  // Serializes an event given by its fields. AppendAsJSON() uses this, and so
+  // does the binary trace converter, which has no TraceEvent to work from.
+  // Arguments are output up to |num_args| or the first NULL name.
+  static void AppendFieldsAsJSON(const char* category_name,
+                                 int process_id,
+                                 int thread_id,
+                                 int64 timestamp,
+                                 char phase,
+                                 const char* name,
+                                 int num_args,
+                                 const char* const* arg_names,
+                                 const unsigned char* arg_types,
+                                 const TraceValue* arg_values,
+                                 unsigned char flags,
+                                 unsigned long long id,
+                                 std::string* out);
+
   static void AppendValueAsJSON(unsigned char type,
                                 TraceValue value,
                                 std::string* out);
 
   TimeTicks timestamp() const { return timestamp_; }
 
+  static bool CompareTimestamps(const TraceEvent& a, const TraceEvent& b) {
+    return a.timestamp_ < b.timestamp_;
+  }
+
   // Exposed for unittesting:
 
   const base::RefCountedString* parameter_copy_storage() const {
@@ -97,6 +121,16 @@ class BASE_EXPORT TraceEvent {
   const unsigned char* category_enabled() const { return category_enabled_; }
   const char* name() const { return name_; }
 
+  // Exposed for the binary trace writer:
+
+  int thread_id() const { return thread_id_; }
+  char phase() const { return phase_; }
+  unsigned char flags() const { return flags_; }
+  unsigned long long id() const { return id_; }
+  const char* arg_name(int index) const { return arg_names_[index]; }
+  unsigned char arg_type(int index) const { return arg_types_[index]; }
+  TraceValue arg_value(int index) const { return arg_values_[index]; }
+
  private:
   // Note: these are ordered by size (largest first) for optimal packing.
   TimeTicks timestamp_;
@@ -170,6 +204,17 @@ class BASE_EXPORT TraceLog {
     EVENT_WATCH_NOTIFICATION = 1 << 1
   };
 
+  // Options determine what happens to new events once the trace buffer is
+  // full.
+  enum Options {
+    // Drop new events and send a TRACE_BUFFER_FULL notification.
+    RECORD_UNTIL_FULL,
+    // Keep recording and drop the oldest events instead, so that the buffer
+    // always holds the most recent events. The buffer size is set with
+    // SetContinuousBufferSize().
+    RECORD_CONTINUOUSLY
+  };
+
   static TraceLog* GetInstance();
 
   // Get set of known categories. This can change as new code paths are reached.
@@ -186,6 +231,9 @@ class BASE_EXPORT TraceLog {
   // Wildcards * and ? are supported (see MatchPattern in string_util.h).
   void SetEnabled(const std::vector<std::string>& included_categories,
                   const std::vector<std::string>& excluded_categories);
+  void SetEnabled(const std::vector<std::string>& included_categories,
+                  const std::vector<std::string>& excluded_categories,
+                  Options options);
 
   // |categories| is a comma-delimited list of category wildcards.
   // A category can have an optional '-' prefix to make it an excluded category.
@@ -196,6 +244,11 @@ class BASE_EXPORT TraceLog {
   // Example: SetEnabled("test_MyTest*,test_OtherStuff");
   // Example: SetEnabled("-excluded_category1,-excluded_category2");
   void SetEnabled(const std::string& categories);
+  void SetEnabled(const std::string& categories, Options options);
+
+  // Sets the approximate amount of memory, in bytes, used for events in
+  // RECORD_CONTINUOUSLY mode. Takes effect the next time tracing is enabled.
+  void SetContinuousBufferSize(size_t size_in_bytes);
 
   // Retieves the categories set via a prior call to SetEnabled(). Only
   // meaningful if |IsEnabled()| is true.
@@ -249,6 +302,11 @@ class BASE_EXPORT TraceLog {
       OutputCallback;
   void Flush(const OutputCallback& cb);
 
+  // Like Flush(), but the chunks hold the binary trace format described in
+  // trace_event_binary.h, which is several times smaller than JSON and much
+  // cheaper to produce. Use TraceBinaryReader to convert it back to JSON.
+  void FlushAsBinary(const OutputCallback& cb);
+
   // Called by TRACE_EVENT* macros, don't call this directly.
   static const unsigned char* GetCategoryEnabled(const char* name);
   static const char* GetCategoryName(const unsigned char* category_enabled);
@@ -294,6 +352,11 @@ class BASE_EXPORT TraceLog {
   // Allows resurrecting our singleton instance post-AtExit processing.
   static void Resurrect();
 
+  // Gathers the events recorded so far by every thread, so that tests can
+  // inspect them with GetEventsSize() and GetEventAt(). Does nothing when
+  // recording continuously.
+  void MergeThreadBuffersForTesting();
+
   // Allow tests to inspect TraceEvents.
   size_t GetEventsSize() const { return logged_events_.size(); }
   const TraceEvent& GetEventAt(size_t index) const {
@@ -346,10 +409,51 @@ class BASE_EXPORT TraceLog {
     int notification_;
   };
 
+  // A fixed-size block of events written by a single thread. Defined in the
+  // .cc file.
+  struct TraceBufferChunk;
+
+  // The chunk that the current thread is filling. Defined in the .cc file.
+  struct ThreadLocalEventBuffer;
+
   TraceLog();
   ~TraceLog();
   const unsigned char* GetCategoryEnabledInternal(const char* name);
   void AddThreadNameMetadataEvents();
+  void UpdateThreadNameWhileLocked(int thread_id, const char* new_name);
+
+  // Returns the current thread's buffer, creating it if needed.
+  ThreadLocalEventBuffer* GetThreadLocalEventBuffer();
+
+  // Hands |full_chunk| (which may be NULL) over to the log and returns an
+  // empty chunk for the calling thread, or NULL if no more events can be
+  // recorded.
+  TraceBufferChunk* ExchangeChunkWhileLocked(TraceBufferChunk* full_chunk,
+                                             NotificationHelper* notifier);
+
+  // Moves the events that every thread has recorded so far into
+  // |logged_events_|, unless recording continuously, when they are left in
+  // the chunks until TakeLoggedEvents().
+  void MergeThreadBuffersWhileLocked();
+
+  // Copies the events not yet in |logged_events_| out of every chunk.
+  void CopyChunkEventsWhileLocked();
+
+  // Takes all recorded events out of the log, in order, for Flush().
+  void TakeLoggedEvents(std::vector<TraceEvent>* events);
+
+  // Takes all recorded events out of the log for FlushAsBinary(), without
+  // gathering them: |events| gets the events merged so far and |chunks| the
+  // rest, which the caller deletes.
+  void TakeLoggedEventsAndChunks(std::vector<TraceEvent>* events,
+                                 std::deque<TraceBufferChunk*>* chunks);
+
+  // Called when the events are taken: only the chunks that threads are still
+  // filling remain in use.
+  void ResetChunkCountWhileLocked();
+
+  // TLS destructor for |thread_buffer_slot_|.
+  static void OnThreadExit(void* buffer);
 
 #if defined(OS_ANDROID)
   void SendToATrace(char phase,
@@ -363,13 +467,38 @@ class BASE_EXPORT TraceLog {
   static void ApplyATraceEnabledFlag(unsigned char* category_enabled);
 #endif
 
-  // TODO(nduca): switch to per-thread trace buffers to reduce thread
-  // synchronization.
-  // This lock protects TraceLog member accesses from arbitrary threads.
+  // This lock protects TraceLog member accesses from arbitrary threads. It is
+  // not taken for every event: threads record into their own chunk and only
+  // lock when the chunk is full.
   Lock lock_;
   bool enabled_;
   NotificationCallback notification_callback_;
+
+  // Events gathered from the thread buffers, and metadata events.
   std::vector<TraceEvent> logged_events_;
+
+  Options options_;
+  size_t continuous_buffer_size_;
+
+  // Holds a ThreadLocalEventBuffer* for every thread that recorded an event.
+  ThreadLocalStorage::Slot thread_buffer_slot_;
+
+  // Every live ThreadLocalEventBuffer, so that Flush() can reach the chunks
+  // that are still being filled.
+  std::vector<ThreadLocalEventBuffer*> thread_buffers_;
+
+  // Full chunks, oldest first.
+  std::deque<TraceBufferChunk*> retired_chunks_;
+
+  // Number of chunks handed out since the last Flush(), bounded by
+  // |max_chunks_|. Written under |lock_|, read without it by
+  // GetBufferPercentFull().
+  subtle::Atomic32 num_chunks_;
+  size_t max_chunks_;
+
+  // Set once a RECORD_UNTIL_FULL trace runs out of chunks, so that threads
+  // stop taking |lock_| to ask for more.
+  subtle::Atomic32 buffer_is_full_;
   std::vector<std::string> included_categories_;
   std::vector<std::string> excluded_categories_;
   bool dispatching_to_observer_list_;
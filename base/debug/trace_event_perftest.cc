@@ -0,0 +1,146 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+// Number of events recorded by every thread in a run. Kept low enough that
+// eight threads do not fill a RECORD_UNTIL_FULL buffer.
+const int kEventsPerThread = 50000;
+
+// Records kEventsPerThread instant events with two arguments.
+class EventRecorder : public DelegateSimpleThread::Delegate {
+ public:
+  EventRecorder() {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kEventsPerThread; ++i)
+      TRACE_EVENT_INSTANT2("perf", "event", "iteration", i, "flag", true);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EventRecorder);
+};
+
+void DiscardTraceData(const scoped_refptr<RefCountedString>& events) {
+}
+
+// Number of events recorded before each flush benchmark.
+const int kFlushEvents = 200000;
+
+void CountBytes(size_t* total, const scoped_refptr<RefCountedString>& chunk) {
+  *total += chunk->data().size();
+}
+
+void AppendChunk(std::string* out,
+                 const scoped_refptr<RefCountedString>& chunk) {
+  out->append(chunk->data());
+}
+
+void DiscardFragment(const std::string& fragment) {
+}
+
+// Records kFlushEvents events with typical arguments on the current thread.
+void RecordEventsForFlush() {
+  TraceLog::GetInstance()->SetEnabled("perf");
+  for (int i = 0; i < kFlushEvents; ++i) {
+    TRACE_EVENT2("perf", "RenderWidget::DoDeferredUpdate",
+                 "frame", i, "url", "http://www.example.com/");
+  }
+  TraceLog::GetInstance()->SetDisabled();
+}
+
+// Flushes kFlushEvents events as JSON or binary and logs the time taken and
+// the size of the output.
+void RunFlushBenchmark(bool binary) {
+  RecordEventsForFlush();
+
+  size_t total_bytes = 0;
+  PerfTimer timer;
+  if (binary)
+    TraceLog::GetInstance()->FlushAsBinary(Bind(&CountBytes, &total_bytes));
+  else
+    TraceLog::GetInstance()->Flush(Bind(&CountBytes, &total_bytes));
+  TimeDelta elapsed = timer.Elapsed();
+
+  const char* format = binary ? "binary" : "json";
+  LogPerfResult(StringPrintf("TraceEvent_Flush_%s_time", format).c_str(),
+                elapsed.InMillisecondsF(), "ms");
+  LogPerfResult(StringPrintf("TraceEvent_Flush_%s_size", format).c_str(),
+                static_cast<double>(total_bytes), "bytes");
+}
+
+// Records events on |num_threads| threads with tracing enabled in |options|
+// mode, and logs the number of events recorded per second by each thread.
+void RunTraceBenchmark(TraceLog::Options options, int num_threads) {
+  TraceLog* trace_log = TraceLog::GetInstance();
+  trace_log->SetEnabled("perf", options);
+
+  EventRecorder recorder;
+  DelegateSimpleThreadPool pool("TracePerfRecorder", num_threads);
+  pool.AddWork(&recorder, num_threads);
+
+  PerfTimer timer;
+  pool.Start();
+  pool.JoinAll();
+  TimeDelta elapsed = timer.Elapsed();
+
+  trace_log->SetDisabled();
+  trace_log->Flush(Bind(&DiscardTraceData));
+
+  std::string name = StringPrintf(
+      "TraceEvent_%s_%dthreads",
+      options == TraceLog::RECORD_CONTINUOUSLY ? "continuous" : "untilfull",
+      num_threads);
+  LogPerfResult(name.c_str(), kEventsPerThread / elapsed.InSecondsF(),
+                "events/s/thread");
+}
+
+}  // namespace
+
+TEST(TraceEventPerfTest, RecordUntilFull) {
+  for (int threads = 1; threads <= 8; threads *= 2)
+    RunTraceBenchmark(TraceLog::RECORD_UNTIL_FULL, threads);
+}
+
+TEST(TraceEventPerfTest, RecordContinuously) {
+  for (int threads = 1; threads <= 8; threads *= 2)
+    RunTraceBenchmark(TraceLog::RECORD_CONTINUOUSLY, threads);
+}
+
+TEST(TraceEventPerfTest, FlushAsJSON) {
+  RunFlushBenchmark(false);
+}
+
+TEST(TraceEventPerfTest, FlushAsBinary) {
+  RunFlushBenchmark(true);
+}
+
+// Measures the offline conversion of a binary trace back to JSON.
+TEST(TraceEventPerfTest, ConvertBinaryToJSON) {
+  RecordEventsForFlush();
+  std::string binary;
+  TraceLog::GetInstance()->FlushAsBinary(Bind(&AppendChunk, &binary));
+
+  PerfTimer timer;
+  TraceBinaryReader reader(Bind(&DiscardFragment));
+  ASSERT_TRUE(reader.Append(binary));
+  ASSERT_TRUE(reader.Finish());
+  LogPerfResult("TraceEvent_ConvertBinaryToJSON_time",
+                timer.Elapsed().InMillisecondsF(), "ms");
+}
+
+}  // namespace debug
+}  // namespace base
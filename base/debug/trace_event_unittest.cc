@@ -4,6 +4,8 @@
 
 #include "base/debug/trace_event_unittest.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/command_line.h"
 #include "base/debug/trace_event.h"
@@ -986,6 +988,7 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
     TRACE_EVENT2("cat", "name2",
                  "arg1", TRACE_STR_COPY("argval"),
                  "arg2", TRACE_STR_COPY("argval"));
+    tracer->MergeThreadBuffersForTesting();
     size_t num_events = tracer->GetEventsSize();
     EXPECT_GT(num_events, 1u);
     const TraceEvent& event1 = tracer->GetEventAt(num_events - 2);
@@ -1010,6 +1013,7 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
     TRACE_EVENT2("cat", "name2",
                  "arg1", TRACE_STR_COPY(str1),
                  "arg2", TRACE_STR_COPY(str2));
+    tracer->MergeThreadBuffersForTesting();
     size_t num_events = tracer->GetEventsSize();
     EXPECT_GT(num_events, 1u);
     const TraceEvent& event1 = tracer->GetEventAt(num_events - 2);
@@ -1074,6 +1078,140 @@ TEST_F(TraceEventTestFixture, DataCapturedManyThreads) {
                                            num_threads, num_events);
 }
 
+// Test that events are gathered from threads that are still running, and
+// which have only partially filled their buffers.
+TEST_F(TraceEventTestFixture, DataCapturedFromRunningThreads) {
+  ManualTestSetUp();
+  BeginTrace();
+
+  const int num_threads = 4;
+  const int num_events = 1001;
+  Thread* threads[num_threads];
+  WaitableEvent* task_complete_events[num_threads];
+  for (int i = 0; i < num_threads; i++) {
+    threads[i] = new Thread(StringPrintf("Thread %d", i).c_str());
+    task_complete_events[i] = new WaitableEvent(false, false);
+    threads[i]->Start();
+    threads[i]->message_loop()->PostTask(
+        FROM_HERE, base::Bind(&TraceManyInstantEvents,
+                              i, num_events, task_complete_events[i]));
+  }
+
+  for (int i = 0; i < num_threads; i++) {
+    task_complete_events[i]->Wait();
+  }
+
+  EndTraceAndFlush();
+
+  for (int i = 0; i < num_threads; i++) {
+    threads[i]->Stop();
+    delete threads[i];
+    delete task_complete_events[i];
+  }
+
+  ValidateInstantEventPresentOnEveryThread(trace_parsed_,
+                                           num_threads, num_events);
+}
+
+// Test that continuous recording keeps the most recent events once the buffer
+// has wrapped around.
+TEST_F(TraceEventTestFixture, RecordContinuously) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetContinuousBufferSize(64 * 1024);
+  TraceLog::GetInstance()->SetEnabled("*", TraceLog::RECORD_CONTINUOUSLY);
+
+  const int num_events = 50000;
+  TraceManyInstantEvents(0, num_events, NULL);
+  EXPECT_LE(TraceLog::GetInstance()->GetBufferPercentFull(), 1.0f);
+
+  EndTraceAndFlush();
+
+  int first_event = num_events;
+  int last_event = -1;
+  size_t count = 0;
+  for (size_t i = 0; i < trace_parsed_.GetSize(); i++) {
+    DictionaryValue* dict = NULL;
+    if (!trace_parsed_.GetDictionary(i, &dict))
+      continue;
+    std::string name;
+    dict->GetString("name", &name);
+    if (name != "multi thread event")
+      continue;
+    int event = 0;
+    EXPECT_TRUE(dict->GetInteger("args.event", &event));
+    first_event = std::min(first_event, event);
+    last_event = std::max(last_event, event);
+    ++count;
+  }
+
+  EXPECT_GT(count, 0u);
+  EXPECT_LT(count, static_cast<size_t>(num_events));
+  EXPECT_GT(first_event, 0);
+  EXPECT_EQ(num_events - 1, last_event);
+  // The events that are kept are contiguous.
+  EXPECT_EQ(count, static_cast<size_t>(last_event - first_event + 1));
+}
+
+// Test that gathering the thread buffers in the middle of a continuous trace
+// leaves the full chunks for later events to overwrite.
+TEST_F(TraceEventTestFixture, RecordContinuouslyAfterMerge) {
+  ManualTestSetUp();
+  TraceLog* tracer = TraceLog::GetInstance();
+  tracer->SetContinuousBufferSize(64 * 1024);
+  tracer->SetEnabled("*", TraceLog::RECORD_CONTINUOUSLY);
+
+  TraceManyInstantEvents(0, 50000, NULL);
+  const float percent_full = tracer->GetBufferPercentFull();
+  tracer->MergeThreadBuffersForTesting();
+  EXPECT_EQ(percent_full, tracer->GetBufferPercentFull());
+  EXPECT_EQ(0u, tracer->GetEventsSize());
+
+  const int num_events = 1000;
+  for (int i = 0; i < num_events; i++)
+    TRACE_EVENT_INSTANT1("all", "event after merge", "event", i);
+
+  EndTraceAndFlush();
+
+  int last_event = -1;
+  for (size_t i = 0; i < trace_parsed_.GetSize(); i++) {
+    DictionaryValue* dict = NULL;
+    if (!trace_parsed_.GetDictionary(i, &dict))
+      continue;
+    std::string name;
+    dict->GetString("name", &name);
+    if (name != "event after merge")
+      continue;
+    int event = 0;
+    EXPECT_TRUE(dict->GetInteger("args.event", &event));
+    last_event = std::max(last_event, event);
+  }
+  EXPECT_EQ(num_events - 1, last_event);
+}
+
+// Test that a watch event set during a continuous trace finds the events in
+// the ring buffer without copying them out of it.
+TEST_F(TraceEventTestFixture, EventWatchNotificationRecordingContinuously) {
+  ManualTestSetUp();
+  TraceLog* tracer = TraceLog::GetInstance();
+  tracer->SetContinuousBufferSize(64 * 1024);
+  event_watch_notification_ = 0;
+  tracer->SetEnabled("*", TraceLog::RECORD_CONTINUOUSLY);
+
+  TraceManyInstantEvents(0, 50000, NULL);
+  TRACE_EVENT_INSTANT0("cat", "event");
+  TRACE_EVENT_INSTANT0("cat", "event");
+  const float percent_full = tracer->GetBufferPercentFull();
+  tracer->SetWatchEvent("cat", "event");
+  EXPECT_EQ(2, event_watch_notification_);
+  EXPECT_EQ(0u, tracer->GetEventsSize());
+
+  TraceManyInstantEvents(0, 50000, NULL);
+  tracer->SetWatchEvent("cat", "event");
+  EXPECT_EQ(0u, tracer->GetEventsSize());
+  EXPECT_EQ(percent_full, tracer->GetBufferPercentFull());
+  EndTraceAndFlush();
+}
+
 // Test that thread and process names show up in the trace
 TEST_F(TraceEventTestFixture, ThreadNames) {
   ManualTestSetUp();
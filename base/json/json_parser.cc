@@ -4,7 +4,10 @@
 
 #include "base/json/json_parser.h"
 
+#include <vector>
+
 #include "base/float_util.h"
+#include "base/json/json_string_scan.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/string_number_conversions.h"
@@ -25,6 +28,56 @@ const int kStackMaxDepth = 100;
 
 const int32 kExtendedASCIIStart = 0x80;
 
+// Owns the strings of a document parsed with JSON_BUILD_WITH_ARENA. Strings
+// are copied into large blocks which are all freed with the arena, rather
+// than being allocated one by one.
+class StringArena {
+ public:
+  StringArena() : next_(NULL), remaining_(0) {}
+
+  ~StringArena() {
+    for (size_t i = 0; i < blocks_.size(); ++i)
+      delete[] blocks_[i];
+  }
+
+  // Returns a copy of |str| which lives as long as the arena.
+  StringPiece Copy(const StringPiece& str) {
+    if (str.empty())
+      return StringPiece();
+
+    // Strings too big to share a block get one of their own, so that they do
+    // not waste the rest of the current one.
+    if (str.size() > kBlockSize / 4) {
+      char* block = new char[str.size()];
+      blocks_.push_back(block);
+      memcpy(block, str.data(), str.size());
+      return StringPiece(block, str.size());
+    }
+
+    if (str.size() > remaining_) {
+      next_ = new char[kBlockSize];
+      blocks_.push_back(next_);
+      remaining_ = kBlockSize;
+    }
+    char* copy = next_;
+    memcpy(copy, str.data(), str.size());
+    next_ += str.size();
+    remaining_ -= str.size();
+    return StringPiece(copy, str.size());
+  }
+
+ private:
+  static const size_t kBlockSize = 16 * 1024;
+
+  std::vector<char*> blocks_;
+
+  // The unused part of the last block.
+  char* next_;
+  size_t remaining_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringArena);
+};
+
 // This and the class below are used to own the JSON input string for when
 // string tokens are stored as StringPiece instead of std::string. This
 // optimization avoids about 2/3rds of string memory copies. The constructor
@@ -37,6 +90,12 @@ class DictionaryHiddenRootValue : public base::DictionaryValue {
     DictionaryValue::Swap(static_cast<DictionaryValue*>(root));
   }
 
+  // For roots whose strings live in |arena| instead of a copy of the input.
+  DictionaryHiddenRootValue(StringArena* arena, Value* root) : arena_(arena) {
+    DCHECK(root->IsType(Value::TYPE_DICTIONARY));
+    DictionaryValue::Swap(static_cast<DictionaryValue*>(root));
+  }
+
   virtual void Swap(DictionaryValue* other) OVERRIDE {
     DVLOG(1) << "Swap()ing a DictionaryValue inefficiently.";
 
@@ -49,6 +108,7 @@ class DictionaryHiddenRootValue : public base::DictionaryValue {
     // new contents, originally from |other|.
     Clear();
     json_.reset();
+    arena_.reset();
     DictionaryValue::Swap(copy.get());
   }
 
@@ -77,6 +137,7 @@ class DictionaryHiddenRootValue : public base::DictionaryValue {
 
  private:
   scoped_ptr<std::string> json_;
+  scoped_ptr<StringArena> arena_;
 
   DISALLOW_COPY_AND_ASSIGN(DictionaryHiddenRootValue);
 };
@@ -88,6 +149,11 @@ class ListHiddenRootValue : public base::ListValue {
     ListValue::Swap(static_cast<ListValue*>(root));
   }
 
+  ListHiddenRootValue(StringArena* arena, Value* root) : arena_(arena) {
+    DCHECK(root->IsType(Value::TYPE_LIST));
+    ListValue::Swap(static_cast<ListValue*>(root));
+  }
+
   virtual void Swap(ListValue* other) OVERRIDE {
     DVLOG(1) << "Swap()ing a ListValue inefficiently.";
 
@@ -100,6 +166,7 @@ class ListHiddenRootValue : public base::ListValue {
     // originally from |other|.
     Clear();
     json_.reset();
+    arena_.reset();
     ListValue::Swap(copy.get());
   }
 
@@ -124,6 +191,7 @@ class ListHiddenRootValue : public base::ListValue {
 
  private:
   scoped_ptr<std::string> json_;
+  scoped_ptr<StringArena> arena_;
 
   DISALLOW_COPY_AND_ASSIGN(ListHiddenRootValue);
 };
@@ -184,6 +252,98 @@ class StackMarker {
   DISALLOW_COPY_AND_ASSIGN(StackMarker);
 };
 
+// Builds a Value tree from the events of JSONParser::ParseWithHandler(), with
+// all strings in a StringArena that is handed to the hidden root.
+class ValueBuilder : public JSONReader::Handler {
+ public:
+  ValueBuilder() : arena_(new StringArena) {}
+  virtual ~ValueBuilder() {}
+
+  // Returns the document, owned by the caller. Must only be called after a
+  // successful parse.
+  Value* TakeRoot() {
+    DCHECK(root_.get());
+    DCHECK(containers_.empty());
+    if (root_->IsType(Value::TYPE_DICTIONARY))
+      return new DictionaryHiddenRootValue(arena_.release(), root_.get());
+    if (root_->IsType(Value::TYPE_LIST))
+      return new ListHiddenRootValue(arena_.release(), root_.get());
+    if (root_->IsType(Value::TYPE_STRING)) {
+      // Without a hidden root, the arena would go away with the builder.
+      return root_->DeepCopy();
+    }
+    return root_.release();
+  }
+
+  // JSONReader::Handler:
+  virtual bool OnNull() OVERRIDE {
+    return AddValue(Value::CreateNullValue());
+  }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return AddValue(new FundamentalValue(value));
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return AddValue(new FundamentalValue(value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return AddValue(new FundamentalValue(value));
+  }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    return AddValue(new JSONStringValue(arena_->Copy(value)));
+  }
+  virtual bool OnDictionaryBegin() OVERRIDE {
+    DictionaryValue* dict = new DictionaryValue;
+    AddValue(dict);
+    containers_.push_back(dict);
+    return true;
+  }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    key.CopyToString(&key_);
+    return true;
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE {
+    containers_.pop_back();
+    return true;
+  }
+  virtual bool OnListBegin() OVERRIDE {
+    ListValue* list = new ListValue;
+    AddValue(list);
+    containers_.push_back(list);
+    return true;
+  }
+  virtual bool OnListEnd() OVERRIDE {
+    containers_.pop_back();
+    return true;
+  }
+
+ private:
+  // Adds |value| to the innermost open container, or makes it the root.
+  bool AddValue(Value* value) {
+    if (containers_.empty()) {
+      DCHECK(!root_.get());
+      root_.reset(value);
+    } else if (containers_.back()->IsType(Value::TYPE_DICTIONARY)) {
+      static_cast<DictionaryValue*>(containers_.back())->
+          SetWithoutPathExpansion(key_, value);
+    } else {
+      static_cast<ListValue*>(containers_.back())->Append(value);
+    }
+    return true;
+  }
+
+  scoped_ptr<StringArena> arena_;
+  scoped_ptr<Value> root_;
+
+  // The dictionaries and lists which have begun but not ended, outermost
+  // first. Owned by |root_|.
+  std::vector<Value*> containers_;
+
+  // The key of the next value added to a dictionary.
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueBuilder);
+};
+
 }  // namespace
 
 JSONParser::JSONParser(int options)
@@ -204,34 +364,20 @@ JSONParser::~JSONParser() {
 }
 
 Value* JSONParser::Parse(const StringPiece& input) {
+  if ((options_ & JSON_BUILD_WITH_ARENA) &&
+      !(options_ & JSON_DETACHABLE_CHILDREN)) {
+    return ParseWithArena(input);
+  }
+
   scoped_ptr<std::string> input_copy;
   // If the children of a JSON root can be detached, then hidden roots cannot
   // be used, so do not bother copying the input because StringPiece will not
   // be used anywhere.
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
     input_copy.reset(new std::string(input.as_string()));
-    start_pos_ = input_copy->data();
+    StartInput(input_copy->data(), input_copy->length());
   } else {
-    start_pos_ = input.data();
-  }
-  pos_ = start_pos_;
-  end_pos_ = start_pos_ + input.length();
-  index_ = 0;
-  line_number_ = 1;
-  index_last_line_ = 0;
-
-  error_code_ = JSONReader::JSON_NO_ERROR;
-  error_line_ = 0;
-  error_column_ = 0;
-
-  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
-  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // ParseNextToken function mis-treating a Unicode BOM as an invalid
-  // character and returning NULL.
-  if (CanConsume(3) && static_cast<uint8>(*pos_) == 0xEF &&
-      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
-      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
-    NextNChars(3);
+    StartInput(input.data(), input.length());
   }
 
   // Parse the first and any nested tokens.
@@ -240,12 +386,8 @@ Value* JSONParser::Parse(const StringPiece& input) {
     return NULL;
 
   // Make sure the input stream is at an end.
-  if (GetNextToken() != T_END_OF_INPUT) {
-    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
-      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
-      return NULL;
-    }
-  }
+  if (!ConsumeEndOfInput())
+    return NULL;
 
   // Dictionaries and lists can contain JSONStringValues, so wrap them in a
   // hidden root.
@@ -266,6 +408,12 @@ Value* JSONParser::Parse(const StringPiece& input) {
   return root.release();
 }
 
+bool JSONParser::ParseWithHandler(const StringPiece& input,
+                                  JSONReader::Handler* handler) {
+  StartInput(input.data(), input.length());
+  return EmitNextToken(handler) && ConsumeEndOfInput();
+}
+
 JSONReader::JsonParseError JSONParser::error_code() const {
   return error_code_;
 }
@@ -314,6 +462,15 @@ void JSONParser::StringBuilder::AppendString(const std::string& str) {
   string_->append(str);
 }
 
+void JSONParser::StringBuilder::AppendRun(const char* run, size_t length) {
+  if (string_) {
+    string_->append(run, length);
+  } else {
+    DCHECK_EQ(pos_ + length_, run);
+    length_ += length;
+  }
+}
+
 void JSONParser::StringBuilder::Convert() {
   if (string_)
     return;
@@ -336,8 +493,54 @@ const std::string& JSONParser::StringBuilder::AsString() {
   return *string_;
 }
 
+StringPiece JSONParser::StringBuilder::GetPiece() const {
+  if (string_)
+    return StringPiece(*string_);
+  return StringPiece(pos_, length_);
+}
+
 // JSONParser private //////////////////////////////////////////////////////////
 
+void JSONParser::StartInput(const char* start, size_t length) {
+  start_pos_ = start;
+  pos_ = start_pos_;
+  end_pos_ = start_pos_ + length;
+  index_ = 0;
+  line_number_ = 1;
+  index_last_line_ = 0;
+
+  error_code_ = JSONReader::JSON_NO_ERROR;
+  error_line_ = 0;
+  error_column_ = 0;
+
+  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
+  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
+  // ParseNextToken function mis-treating a Unicode BOM as an invalid
+  // character and returning NULL.
+  if (CanConsume(3) && static_cast<uint8>(*pos_) == 0xEF &&
+      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
+      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
+    NextNChars(3);
+  }
+}
+
+bool JSONParser::ConsumeEndOfInput() {
+  if (GetNextToken() != T_END_OF_INPUT) {
+    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
+      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
+      return false;
+    }
+  }
+  return true;
+}
+
+Value* JSONParser::ParseWithArena(const StringPiece& input) {
+  ValueBuilder builder;
+  if (!ParseWithHandler(input, &builder))
+    return NULL;
+  return builder.TakeRoot();
+}
+
 inline bool JSONParser::CanConsume(int length) {
   return pos_ + length <= end_pos_;
 }
@@ -611,7 +814,17 @@ bool JSONParser::ConsumeStringRaw(StringBuilder* out) {
   int length = end_pos_ - start_pos_;
   int32 next_char = 0;
 
-  while (CanConsume(1)) {
+  while (index_ < length) {
+    // Plain ASCII is copied as it is, so take whole runs of it at once. Only
+    // quotes, escapes and multi-byte characters need decoding below.
+    size_t run = CountPlainJSONStringChars(start_pos_ + index_, end_pos_);
+    if (run) {
+      string.AppendRun(start_pos_ + index_, run);
+      index_ += run;
+      if (index_ == length)
+        break;
+    }
+
     pos_ = start_pos_ + index_;  // CBU8_NEXT is postcrement.
     CBU8_NEXT(start_pos_, index_, length, next_char);
     if (next_char < 0 || !IsValidCharacter(next_char)) {
@@ -801,6 +1014,24 @@ void JSONParser::DecodeUTF8(const int32& point, StringBuilder* dest) {
 }
 
 Value* JSONParser::ConsumeNumber() {
+  StringPiece num_string;
+  if (!ConsumeNumberRaw(&num_string))
+    return NULL;
+
+  int num_int;
+  if (StringToInt(num_string, &num_int))
+    return new FundamentalValue(num_int);
+
+  double num_double;
+  if (base::StringToDouble(num_string.as_string(), &num_double) &&
+      IsFinite(num_double)) {
+    return new FundamentalValue(num_double);
+  }
+
+  return NULL;
+}
+
+bool JSONParser::ConsumeNumberRaw(StringPiece* number) {
   const char* num_start = pos_;
   const int start_index = index_;
   int end_index = start_index;
@@ -810,7 +1041,7 @@ Value* JSONParser::ConsumeNumber() {
 
   if (!ReadInt(false)) {
     ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-    return NULL;
+    return false;
   }
   end_index = index_;
 
@@ -818,12 +1049,12 @@ Value* JSONParser::ConsumeNumber() {
   if (*pos_ == '.') {
     if (!CanConsume(1)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -835,7 +1066,7 @@ Value* JSONParser::ConsumeNumber() {
       NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -855,25 +1086,14 @@ Value* JSONParser::ConsumeNumber() {
       break;
     default:
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
   }
 
   pos_ = exit_pos;
   index_ = exit_index;
 
-  StringPiece num_string(num_start, end_index - start_index);
-
-  int num_int;
-  if (StringToInt(num_string, &num_int))
-    return new FundamentalValue(num_int);
-
-  double num_double;
-  if (base::StringToDouble(num_string.as_string(), &num_double) &&
-      IsFinite(num_double)) {
-    return new FundamentalValue(num_double);
-  }
-
-  return NULL;
+  number->set(num_start, end_index - start_index);
+  return true;
 }
 
 bool JSONParser::ReadInt(bool allow_leading_zeros) {
@@ -896,6 +1116,19 @@ bool JSONParser::ReadInt(bool allow_leading_zeros) {
 }
 
 Value* JSONParser::ConsumeLiteral() {
+  switch (ConsumeLiteralRaw()) {
+    case T_BOOL_TRUE:
+      return new FundamentalValue(true);
+    case T_BOOL_FALSE:
+      return new FundamentalValue(false);
+    case T_NULL:
+      return Value::CreateNullValue();
+    default:
+      return NULL;
+  }
+}
+
+JSONParser::Token JSONParser::ConsumeLiteralRaw() {
   switch (*pos_) {
     case 't': {
       const char* kTrueLiteral = "true";
@@ -903,10 +1136,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kTrueLen - 1) ||
           !StringsAreEqual(pos_, kTrueLiteral, kTrueLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return T_INVALID_TOKEN;
       }
       NextNChars(kTrueLen - 1);
-      return new FundamentalValue(true);
+      return T_BOOL_TRUE;
     }
     case 'f': {
       const char* kFalseLiteral = "false";
@@ -914,10 +1147,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kFalseLen - 1) ||
           !StringsAreEqual(pos_, kFalseLiteral, kFalseLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return T_INVALID_TOKEN;
       }
       NextNChars(kFalseLen - 1);
-      return new FundamentalValue(false);
+      return T_BOOL_FALSE;
     }
     case 'n': {
       const char* kNullLiteral = "null";
@@ -925,17 +1158,170 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kNullLen - 1) ||
           !StringsAreEqual(pos_, kNullLiteral, kNullLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return T_INVALID_TOKEN;
       }
       NextNChars(kNullLen - 1);
-      return Value::CreateNullValue();
+      return T_NULL;
     }
     default:
       ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
-      return NULL;
+      return T_INVALID_TOKEN;
   }
 }
 
+bool JSONParser::EmitNextToken(JSONReader::Handler* handler) {
+  return EmitToken(GetNextToken(), handler);
+}
+
+bool JSONParser::EmitToken(Token token, JSONReader::Handler* handler) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+      return EmitDictionary(handler);
+    case T_ARRAY_BEGIN:
+      return EmitList(handler);
+    case T_STRING: {
+      StringBuilder string;
+      if (!ConsumeStringRaw(&string))
+        return false;
+      return handler->OnString(string.GetPiece()) || ReportAborted();
+    }
+    case T_NUMBER: {
+      StringPiece num_string;
+      if (!ConsumeNumberRaw(&num_string))
+        return false;
+
+      int num_int;
+      if (StringToInt(num_string, &num_int))
+        return handler->OnInteger(num_int) || ReportAborted();
+
+      double num_double;
+      if (base::StringToDouble(num_string.as_string(), &num_double) &&
+          IsFinite(num_double)) {
+        return handler->OnDouble(num_double) || ReportAborted();
+      }
+      return false;
+    }
+    case T_BOOL_TRUE:
+    case T_BOOL_FALSE:
+    case T_NULL:
+      switch (ConsumeLiteralRaw()) {
+        case T_BOOL_TRUE:
+          return handler->OnBoolean(true) || ReportAborted();
+        case T_BOOL_FALSE:
+          return handler->OnBoolean(false) || ReportAborted();
+        case T_NULL:
+          return handler->OnNull() || ReportAborted();
+        default:
+          return false;
+      }
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
+  }
+}
+
+bool JSONParser::EmitDictionary(JSONReader::Handler* handler) {
+  if (*pos_ != '{') {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+    return false;
+  }
+
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  if (!handler->OnDictionaryBegin())
+    return ReportAborted();
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_OBJECT_END) {
+    if (token != T_STRING) {
+      ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+      return false;
+    }
+
+    StringBuilder key;
+    if (!ConsumeStringRaw(&key))
+      return false;
+    if (!handler->OnDictionaryKey(key.GetPiece()))
+      return ReportAborted();
+
+    NextChar();
+    token = GetNextToken();
+    if (token != T_OBJECT_PAIR_SEPARATOR) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    NextChar();
+    if (!EmitNextToken(handler))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_OBJECT_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_OBJECT_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 0);
+      return false;
+    }
+  }
+
+  return handler->OnDictionaryEnd() || ReportAborted();
+}
+
+bool JSONParser::EmitList(JSONReader::Handler* handler) {
+  if (*pos_ != '[') {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+    return false;
+  }
+
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  if (!handler->OnListBegin())
+    return ReportAborted();
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_ARRAY_END) {
+    if (!EmitToken(token, handler))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_ARRAY_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_ARRAY_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+  }
+
+  return handler->OnListEnd() || ReportAborted();
+}
+
+bool JSONParser::ReportAborted() {
+  ReportError(JSONReader::JSON_PARSE_ABORTED, 1);
+  return false;
+}
+
 // static
 bool JSONParser::StringsAreEqual(const char* one, const char* two, size_t len) {
   return strncmp(one, two, len) == 0;
@@ -57,6 +57,10 @@ class JSONParserTest;
 // of a token, such that the next iteration of the parser will be at the byte
 // immediately following the token, which would likely be the first byte of the
 // next token.
+//
+// The same tokenizer drives two kinds of Consume functions: the ones that
+// build Values, used by Parse(), and the Emit ones, which report the document
+// to a JSONReader::Handler instead, used by ParseWithHandler().
 class BASE_EXPORT_PRIVATE JSONParser {
  public:
   explicit JSONParser(int options);
@@ -66,6 +70,11 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // result as a Value owned by the caller.
   Value* Parse(const StringPiece& input);
 
+  // Parses the input string according to the set options, reporting its
+  // contents to |handler|. The input is not copied. Returns false on error.
+  bool ParseWithHandler(const StringPiece& input,
+                        JSONReader::Handler* handler);
+
   // Returns the error code.
   JSONReader::JsonParseError error_code() const;
 
@@ -116,6 +125,11 @@ class BASE_EXPORT_PRIVATE JSONParser {
     // Appends a string to the std::string. Must be Convert()ed to use.
     void AppendString(const std::string& str);
 
+    // Appends |length| characters in the basic ASCII plane, starting at
+    // |run|, which must be the input directly following the string built so
+    // far.
+    void AppendRun(const char* run, size_t length);
+
     // Converts the builder from its default StringPiece to a full std::string,
     // performing a copy. Once a builder is converted, it cannot be made a
     // StringPiece again.
@@ -131,6 +145,10 @@ class BASE_EXPORT_PRIVATE JSONParser {
     // Returns the builder as a std::string.
     const std::string& AsString();
 
+    // Returns the string built so far, whether or not it was converted. The
+    // piece is only valid as long as the builder and the input are.
+    StringPiece GetPiece() const;
+
    private:
     // The beginning of the input string.
     const char* pos_;
@@ -143,6 +161,18 @@ class BASE_EXPORT_PRIVATE JSONParser {
     std::string* string_;
   };
 
+  // Resets the parser state to the start of |input|, skipping a byte-order
+  // mark if there is one.
+  void StartInput(const char* start, size_t length);
+
+  // Checks that nothing but whitespace and comments follows the root token,
+  // reporting an error otherwise.
+  bool ConsumeEndOfInput();
+
+  // Parses |input| through an arena-backed ValueBuilder; the implementation
+  // of Parse() with JSON_BUILD_WITH_ARENA.
+  Value* ParseWithArena(const StringPiece& input);
+
   // Quick check that the stream has capacity to consume |length| more bytes.
   bool CanConsume(int length);
 
@@ -206,9 +236,28 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
 
+  // Assuming that the parser is wound to the start of a valid JSON number,
+  // this consumes it and places its text in |number|. Returns false with
+  // error information set if it is not a valid number.
+  bool ConsumeNumberRaw(StringPiece* number);
+
   // Consumes the literal values of |true|, |false|, and |null|, assuming the
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
+  // Consumes a literal like ConsumeLiteral(), returning its token, or
+  // T_INVALID_TOKEN with error information set.
+  Token ConsumeLiteralRaw();
+
+  // The counterparts of ParseNextToken(), ParseToken(), ConsumeDictionary()
+  // and ConsumeList() for ParseWithHandler(). They return false if there is
+  // an error or |handler| stops the parse.
+  bool EmitNextToken(JSONReader::Handler* handler);
+  bool EmitToken(Token token, JSONReader::Handler* handler);
+  bool EmitDictionary(JSONReader::Handler* handler);
+  bool EmitList(JSONReader::Handler* handler);
+
+  // Reports JSON_PARSE_ABORTED and returns false.
+  bool ReportAborted();
 
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
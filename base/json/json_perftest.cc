@@ -0,0 +1,260 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// The documents below are generated with the shape of the files Chrome parses
+// at startup, at the size they reach in long-lived profiles.
+
+// A bookmark bar of |num_folders| folders of |urls_per_folder| bookmarks.
+std::string MakeBookmarksJSON(int num_folders, int urls_per_folder) {
+  std::string json =
+      "{\n   \"checksum\": \"a3b0d5f1e4c2b7a9d8e6f0c1b2a3d4e5\",\n"
+      "   \"roots\": {\n      \"bookmark_bar\": {\n         \"children\": [ ";
+  int id = 4;
+  for (int folder = 0; folder < num_folders; ++folder) {
+    if (folder)
+      json += ", ";
+    json += "{\n            \"children\": [ ";
+    for (int url = 0; url < urls_per_folder; ++url) {
+      if (url)
+        json += ", ";
+      StringAppendF(&json,
+          "{\n               \"date_added\": \"129%014d\",\n"
+          "               \"id\": \"%d\",\n"
+          "               \"name\": \"Page %d \\u2014 Caf\\u00e9 "
+          "\\\"Example\\\" site\",\n"
+          "               \"type\": \"url\",\n"
+          "               \"url\": \"http://www.example%d.com/articles/%d/"
+          "index.html?ref=bookmark&session=%d\"\n            }",
+          id * 7919, id, id, folder, url, id * 31);
+      ++id;
+    }
+    StringAppendF(&json,
+        " ],\n            \"date_added\": \"12900000000000000\",\n"
+        "            \"date_modified\": \"12900000000000001\",\n"
+        "            \"id\": \"%d\",\n"
+        "            \"name\": \"Folder %d\",\n"
+        "            \"type\": \"folder\"\n         }", id++, folder);
+  }
+  json +=
+      " ],\n         \"date_added\": \"12900000000000000\",\n"
+      "         \"date_modified\": \"0\",\n         \"id\": \"1\",\n"
+      "         \"name\": \"Bookmarks Bar\",\n         \"type\": \"folder\"\n"
+      "      },\n      \"other\": {\n         \"children\": [  ],\n"
+      "         \"date_added\": \"12900000000000000\",\n"
+      "         \"date_modified\": \"0\",\n         \"id\": \"2\",\n"
+      "         \"name\": \"Other Bookmarks\",\n         \"type\": \"folder\"\n"
+      "      }\n   },\n   \"version\": 1\n}\n";
+  return json;
+}
+
+// An extension manifest with the usual keys and a long, escaped description.
+std::string MakeManifestJSON(int index) {
+  return StringPrintf(
+      "{\n  \"name\": \"Extension %d\",\n  \"version\": \"1.%d.3\",\n"
+      "  \"manifest_version\": 2,\n"
+      "  \"description\": \"Does useful things.\\nReally \\\"useful\\\" "
+      "things, with \xc3\xbcmlauts and \\u00e9scapes.\",\n"
+      "  \"icons\": {\"16\": \"icon16.png\", \"48\": \"icon48.png\", "
+      "\"128\": \"icon128.png\"},\n"
+      "  \"background\": {\"scripts\": [\"background.js\", \"util.js\"]},\n"
+      "  \"browser_action\": {\"default_icon\": \"icon19.png\", "
+      "\"default_title\": \"Extension %d\", \"default_popup\": "
+      "\"popup.html\"},\n"
+      "  \"permissions\": [\"tabs\", \"bookmarks\", \"storage\", "
+      "\"http://*/*\", \"https://*/*\"],\n"
+      "  \"content_scripts\": [{\"matches\": [\"http://*/*\", "
+      "\"https://*/*\"], \"js\": [\"content.js\"], \"css\": [\"content.css\"],"
+      " \"run_at\": \"document_end\", \"all_frames\": false}],\n"
+      "  \"options_page\": \"options.html\",\n"
+      "  \"update_url\": \"https://clients2.google.com/service/update2/crx\"\n"
+      "}\n", index, index, index);
+}
+
+// A Preferences file with |num_extensions| installed extensions and
+// |num_sites| content setting exceptions.
+std::string MakePreferencesJSON(int num_extensions, int num_sites) {
+  std::string json =
+      "{\n   \"browser\": {\n      \"last_known_google_url\": "
+      "\"https://www.google.com/\",\n      \"window_placement\": {\n"
+      "         \"bottom\": 1040, \"left\": 10, \"maximized\": true,\n"
+      "         \"right\": 1910, \"top\": 10,\n"
+      "         \"work_area_bottom\": 1050, \"work_area_left\": 0,\n"
+      "         \"work_area_right\": 1920, \"work_area_top\": 0\n      }\n"
+      "   },\n   \"extensions\": {\n      \"settings\": {\n";
+  for (int i = 0; i < num_extensions; ++i) {
+    StringAppendF(&json,
+        "%s         \"abcdefghijklmnopabcdefghijk%05d\": {\n"
+        "            \"active_permissions\": {\"api\": [\"tabs\", "
+        "\"bookmarks\", \"storage\"], \"explicit_host\": [\"http://*/*\"]},\n"
+        "            \"from_bookmark\": false,\n"
+        "            \"from_webstore\": true,\n"
+        "            \"install_time\": \"1297%012d\",\n"
+        "            \"location\": 1,\n"
+        "            \"manifest\": ",
+        i ? ",\n" : "", i, i * 104729);
+    json += MakeManifestJSON(i);
+    StringAppendF(&json,
+        ",\n            \"path\": \"abcdefghijklmnopabcdefghijk%05d/1.%d.3_0\",\n"
+        "            \"state\": 1,\n"
+        "            \"was_installed_by_default\": false\n         }",
+        i, i);
+  }
+  json +=
+      "\n      }\n   },\n   \"profile\": {\n      \"content_settings\": {\n"
+      "         \"pattern_pairs\": {\n";
+  for (int i = 0; i < num_sites; ++i) {
+    StringAppendF(&json,
+        "%s            \"[*.]site%d.example.com,*\": {\"cookies\": %d, "
+        "\"images\": 1, \"javascript\": 1, \"plugins\": %d}",
+        i ? ",\n" : "", i, i % 3, i % 2 + 1);
+  }
+  json +=
+      "\n         },\n         \"pref_version\": 1\n      },\n"
+      "      \"exited_cleanly\": true,\n      \"name\": \"First user\",\n"
+      "      \"zoom_level\": 0.0\n   }\n}\n";
+  return json;
+}
+
+// Counts events and does nothing else: the cost of the tokenizer alone.
+class CountingHandler : public JSONReader::Handler {
+ public:
+  CountingHandler() : num_events_(0) {}
+  virtual ~CountingHandler() {}
+
+  int num_events() const { return num_events_; }
+
+  virtual bool OnNull() OVERRIDE { return Count(); }
+  virtual bool OnBoolean(bool value) OVERRIDE { return Count(); }
+  virtual bool OnInteger(int value) OVERRIDE { return Count(); }
+  virtual bool OnDouble(double value) OVERRIDE { return Count(); }
+  virtual bool OnString(const StringPiece& value) OVERRIDE { return Count(); }
+  virtual bool OnDictionaryBegin() OVERRIDE { return Count(); }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    return Count();
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE { return Count(); }
+  virtual bool OnListBegin() OVERRIDE { return Count(); }
+  virtual bool OnListEnd() OVERRIDE { return Count(); }
+
+ private:
+  bool Count() {
+    ++num_events_;
+    return true;
+  }
+
+  int num_events_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingHandler);
+};
+
+// Parses roughly kBytesPerRun bytes of every document in every mode.
+const size_t kBytesPerRun = 64 * 1024 * 1024;
+
+enum ParseMode {
+  PARSE_VALUE,
+  PARSE_VALUE_DETACHABLE,
+  PARSE_VALUE_ARENA,
+  PARSE_HANDLER,
+};
+
+const char* const kModeNames[] = {
+  "value",
+  "detachable",
+  "arena",
+  "handler",
+};
+
+void RunParseBenchmark(const char* name, const std::string& json) {
+  // Every value and key is at least one heap allocation when a Value tree is
+  // built, and none with a handler.
+  CountingHandler counter;
+  ASSERT_TRUE(JSONReader().ReadWithHandler(json, &counter));
+  LogPerfResult(StringPrintf("JSON_Parse_%s_values", name).c_str(),
+                counter.num_events(), "values");
+
+  int iterations = std::max<int>(1, kBytesPerRun / json.size());
+  for (int mode = PARSE_VALUE; mode <= PARSE_HANDLER; ++mode) {
+    PerfTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      if (mode == PARSE_HANDLER) {
+        CountingHandler handler;
+        JSONReader reader;
+        ASSERT_TRUE(reader.ReadWithHandler(json, &handler));
+      } else {
+        int options = JSON_PARSE_RFC;
+        if (mode == PARSE_VALUE_DETACHABLE)
+          options = JSON_DETACHABLE_CHILDREN;
+        else if (mode == PARSE_VALUE_ARENA)
+          options = JSON_BUILD_WITH_ARENA;
+        scoped_ptr<Value> root(JSONReader::Read(json, options));
+        ASSERT_TRUE(root.get());
+      }
+    }
+    double seconds = timer.Elapsed().InSecondsF();
+    LogPerfResult(StringPrintf("JSON_Parse_%s_%s_time", name,
+                               kModeNames[mode]).c_str(),
+                  seconds * 1000 / iterations, "ms");
+    LogPerfResult(StringPrintf("JSON_Parse_%s_%s_throughput", name,
+                               kModeNames[mode]).c_str(),
+                  json.size() * iterations / seconds / (1024 * 1024), "MB/s");
+  }
+}
+
+void RunWriteBenchmark(const char* name, const std::string& json) {
+  scoped_ptr<Value> root(JSONReader::Read(json));
+  ASSERT_TRUE(root.get());
+
+  std::string output;
+  JSONWriter::Write(root.get(), &output);
+  int iterations = std::max<int>(1, kBytesPerRun / output.size());
+
+  PerfTimer timer;
+  for (int i = 0; i < iterations; ++i) {
+    output.clear();
+    JSONWriter::Write(root.get(), &output);
+  }
+  double seconds = timer.Elapsed().InSecondsF();
+  LogPerfResult(StringPrintf("JSON_Write_%s_throughput", name).c_str(),
+                output.size() * iterations / seconds / (1024 * 1024), "MB/s");
+}
+
+}  // namespace
+
+TEST(JSONPerfTest, ParseBookmarks) {
+  RunParseBenchmark("Bookmarks", MakeBookmarksJSON(50, 100));
+}
+
+TEST(JSONPerfTest, ParsePreferences) {
+  RunParseBenchmark("Preferences", MakePreferencesJSON(40, 2000));
+}
+
+TEST(JSONPerfTest, ParseManifest) {
+  RunParseBenchmark("manifest", MakeManifestJSON(1));
+}
+
+TEST(JSONPerfTest, WriteBookmarks) {
+  RunWriteBenchmark("Bookmarks", MakeBookmarksJSON(50, 100));
+}
+
+TEST(JSONPerfTest, WritePreferences) {
+  RunWriteBenchmark("Preferences", MakePreferencesJSON(40, 2000));
+}
+
+}  // namespace base
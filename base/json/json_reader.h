@@ -58,6 +58,13 @@ enum JSONParserOptions {
   // if the child is Remove()d from root, it would result in use-after-free
   // unless it is DeepCopy()ed or this option is used.
   JSON_DETACHABLE_CHILDREN = 1 << 1,
+
+  // Builds the Value tree from the events of the streaming parser (see
+  // JSONReader::Handler), copying strings into a few large blocks owned by
+  // the root instead of copying the whole input. Like the default, children
+  // cannot outlive the root; this option is ignored if
+  // JSON_DETACHABLE_CHILDREN is set.
+  JSON_BUILD_WITH_ARENA = 1 << 2,
 };
 
 class BASE_EXPORT JSONReader {
@@ -73,6 +80,36 @@ class BASE_EXPORT JSONReader {
     JSON_UNEXPECTED_DATA_AFTER_ROOT,
     JSON_UNSUPPORTED_ENCODING,
     JSON_UNQUOTED_DICTIONARY_KEY,
+    JSON_PARSE_ABORTED,
+  };
+
+  // Receives the contents of a JSON document from ReadWithHandler(), in
+  // document order, as it is parsed. No Value is created, so this is the
+  // cheapest way to read a document which is only needed once, or only in
+  // part. Every method returns true to continue parsing, or false to stop,
+  // in which case ReadWithHandler() fails with JSON_PARSE_ABORTED.
+  //
+  // Strings and keys are only valid during the call; they are not copied
+  // unless they contain escape sequences.
+  class BASE_EXPORT Handler {
+   public:
+    virtual bool OnNull() = 0;
+    virtual bool OnBoolean(bool value) = 0;
+    virtual bool OnInteger(int value) = 0;
+    virtual bool OnDouble(double value) = 0;
+    virtual bool OnString(const StringPiece& value) = 0;
+
+    // Dictionaries are reported as OnDictionaryBegin(), then OnDictionaryKey()
+    // followed by the events of the value for every entry, then
+    // OnDictionaryEnd(). Lists are reported likewise, without the keys.
+    virtual bool OnDictionaryBegin() = 0;
+    virtual bool OnDictionaryKey(const StringPiece& key) = 0;
+    virtual bool OnDictionaryEnd() = 0;
+    virtual bool OnListBegin() = 0;
+    virtual bool OnListEnd() = 0;
+
+   protected:
+    virtual ~Handler() {}
   };
 
   // String versions of parse error codes.
@@ -84,6 +121,7 @@ class BASE_EXPORT JSONReader {
   static const char* kUnexpectedDataAfterRoot;
   static const char* kUnsupportedEncoding;
   static const char* kUnquotedDictionaryKey;
+  static const char* kParseAborted;
 
   // Constructs a reader with the default options, JSON_PARSE_RFC.
   JSONReader();
@@ -118,7 +156,13 @@ class BASE_EXPORT JSONReader {
   // Parses an input string into a Value that is owned by the caller.
   Value* ReadToValue(const std::string& json);
 
-  // Returns the error code if the last call to ReadToValue() failed.
+  // Parses |json|, reporting its contents to |handler| instead of building a
+  // Value. Returns false if the input is not properly formed or |handler|
+  // stopped the parse. |handler| may have received some events either way.
+  bool ReadWithHandler(const StringPiece& json, Handler* handler);
+
+  // Returns the error code if the last call to ReadToValue() or
+  // ReadWithHandler() failed.
   // Returns JSON_NO_ERROR otherwise.
   JsonParseError error_code() const;
 
@@ -9,6 +9,7 @@
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/path_service.h"
+#include "base/string_number_conversions.h"
 #include "base/string_piece.h"
 #include "base/utf_string_conversions.h"
 #include "base/values.h"
@@ -17,6 +18,56 @@
 
 namespace base {
 
+namespace {
+
+// Records the events it receives as a compact string, and stops the parse
+// after |max_events| of them.
+class RecordingHandler : public JSONReader::Handler {
+ public:
+  explicit RecordingHandler(int max_events)
+      : max_events_(max_events), num_events_(0) {}
+  virtual ~RecordingHandler() {}
+
+  const std::string& events() const { return events_; }
+
+  virtual bool OnNull() OVERRIDE { return Record("null"); }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Record(value ? "true" : "false");
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Record("int:" + IntToString(value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Record("double:" + DoubleToString(value));
+  }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    return Record("'" + value.as_string() + "'");
+  }
+  virtual bool OnDictionaryBegin() OVERRIDE { return Record("{"); }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    return Record(key.as_string() + ":");
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE { return Record("}"); }
+  virtual bool OnListBegin() OVERRIDE { return Record("["); }
+  virtual bool OnListEnd() OVERRIDE { return Record("]"); }
+
+ private:
+  bool Record(const std::string& event) {
+    if (!events_.empty())
+      events_ += " ";
+    events_ += event;
+    return ++num_events_ < max_events_;
+  }
+
+  const int max_events_;
+  int num_events_;
+  std::string events_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingHandler);
+};
+
+}  // namespace
+
 TEST(JSONReaderTest, Reading) {
   // some whitespace checking
   scoped_ptr<Value> root;
@@ -645,4 +696,117 @@ TEST(JSONReaderTest, IllegalTrailingNull) {
   EXPECT_EQ(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, reader.error_code());
 }
 
+TEST(JSONReaderTest, ReadWithHandler) {
+  RecordingHandler handler(1000);
+  JSONReader reader;
+  EXPECT_TRUE(reader.ReadWithHandler(
+      "{\"a\": [1, -2.5, true, false, null], \"b\\n\": {\"c\": \"d\\u00e9\"},"
+      " \"e\": []} // comment", &handler));
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+  EXPECT_EQ("{ a: [ int:1 double:-2.5 true false null ] b\n: { c: 'd\xc3\xa9' }"
+            " e: [ ] }", handler.events());
+
+  RecordingHandler scalar_handler(1000);
+  EXPECT_TRUE(reader.ReadWithHandler("\xef\xbb\xbf \"root\" ",
+                                     &scalar_handler));
+  EXPECT_EQ("'root'", scalar_handler.events());
+}
+
+TEST(JSONReaderTest, ReadWithHandlerAborts) {
+  RecordingHandler handler(3);
+  JSONReader reader;
+  EXPECT_FALSE(reader.ReadWithHandler("[1, 2, 3, 4]", &handler));
+  EXPECT_EQ(JSONReader::JSON_PARSE_ABORTED, reader.error_code());
+  EXPECT_EQ("[ int:1 int:2", handler.events());
+}
+
+// ReadWithHandler() reports the same errors as ReadToValue().
+TEST(JSONReaderTest, ReadWithHandlerErrors) {
+  const char* invalid_json[] = {
+      "",
+      "/* test *",
+      "{\"foo\"",
+      "{\"foo\":",
+      "  [",
+      "\"\\u123g\"",
+      "{\n\"eh:\n}",
+      "[1,]",
+      "{foo: 1}",
+      "[1] 2",
+      "\"\\q\"",
+      "01",
+      "tru",
+  };
+
+  for (size_t i = 0; i < arraysize(invalid_json); ++i) {
+    JSONReader value_reader;
+    EXPECT_FALSE(value_reader.ReadToValue(invalid_json[i]));
+
+    RecordingHandler handler(1000);
+    JSONReader handler_reader;
+    EXPECT_FALSE(handler_reader.ReadWithHandler(invalid_json[i], &handler));
+    EXPECT_EQ(value_reader.error_code(), handler_reader.error_code())
+        << invalid_json[i];
+    EXPECT_EQ(value_reader.GetErrorMessage(),
+              handler_reader.GetErrorMessage()) << invalid_json[i];
+  }
+}
+
+// Documents built with JSON_BUILD_WITH_ARENA are the same as the ones built
+// directly.
+TEST(JSONReaderTest, BuildWithArena) {
+  const char* json[] = {
+      "null",
+      "42",
+      "\"root\"",
+      "\"esc\\\"aped\"",
+      "[]",
+      "{}",
+      "[1, 2.5, \"a\", [\"b\", {\"c\": false}], {}]",
+      "{\"k\\u00e9y\": \"v\\u00e1lue\", \"n\": {\"m\": [null, true]},"
+      " \"dup\": 1, \"dup\": 2}",
+  };
+
+  for (size_t i = 0; i < arraysize(json); ++i) {
+    scoped_ptr<Value> expected(JSONReader::Read(json[i]));
+    ASSERT_TRUE(expected.get()) << json[i];
+    scoped_ptr<Value> actual(JSONReader::Read(json[i], JSON_BUILD_WITH_ARENA));
+    ASSERT_TRUE(actual.get()) << json[i];
+    EXPECT_TRUE(expected->Equals(actual.get())) << json[i];
+  }
+
+  int error_code = JSONReader::JSON_NO_ERROR;
+  EXPECT_FALSE(JSONReader::ReadAndReturnError("[1, ", JSON_BUILD_WITH_ARENA,
+                                              &error_code, NULL));
+  EXPECT_EQ(JSONReader::JSON_UNEXPECTED_TOKEN, error_code);
+}
+
+// Children removed from an arena-built root outlive it.
+TEST(JSONReaderTest, BuildWithArenaRemoveChildren) {
+  Value* string_value = NULL;
+  Value* list_value = NULL;
+  {
+    std::string long_string(100000, 'x');
+    scoped_ptr<Value> root(JSONReader::Read(
+        "{\"s\": \"" + long_string + "\", \"l\": [\"a\", \"b\"]}",
+        JSON_BUILD_WITH_ARENA));
+    ASSERT_TRUE(root.get());
+    DictionaryValue* root_dict = NULL;
+    ASSERT_TRUE(root->GetAsDictionary(&root_dict));
+    EXPECT_TRUE(root_dict->Remove("s", &string_value));
+    EXPECT_TRUE(root_dict->Remove("l", &list_value));
+  }
+
+  std::string s;
+  EXPECT_TRUE(string_value->GetAsString(&s));
+  EXPECT_EQ(std::string(100000, 'x'), s);
+  ListValue* list = NULL;
+  ASSERT_TRUE(list_value->GetAsList(&list));
+  EXPECT_TRUE(list->GetString(1, &s));
+  EXPECT_EQ("b", s);
+
+  delete string_value;
+  delete list_value;
+}
+
 }  // namespace base
@@ -0,0 +1,90 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_string_scan.h"
+
+#include "base/cpu.h"
+
+#if defined(ARCH_CPU_HAS_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace base {
+namespace internal {
+
+namespace {
+
+inline bool IsPlainJSONStringChar(unsigned char c) {
+  return c < 0x80 && c != '"' && c != '\\';
+}
+
+inline bool IsUnescapedJSONChar(unsigned char c) {
+  return c >= 0x20 && c < 0x7F && c != '"' && c != '\\' && c != '<' &&
+      c != '>';
+}
+
+// Returns the number of bytes from |begin| for which |Predicate| holds. The
+// scalar path, used for the tail of the input and to locate the first
+// special byte of a block the SSE2 loop stopped at.
+template <bool (*Predicate)(unsigned char)>
+inline size_t CountScalar(const char* begin, const char* end) {
+  const char* p = begin;
+  while (p < end && Predicate(static_cast<unsigned char>(*p)))
+    ++p;
+  return p - begin;
+}
+
+}  // namespace
+
+size_t CountPlainJSONStringChars(const char* begin, const char* end) {
+  const char* p = begin;
+#if defined(ARCH_CPU_HAS_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    // Non-ASCII bytes have their top bit set already.
+    __m128i special = _mm_or_si128(
+        chunk,
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                     _mm_cmpeq_epi8(chunk, backslash)));
+    if (_mm_movemask_epi8(special))
+      break;
+    p += 16;
+  }
+#endif
+  return (p - begin) + CountScalar<IsPlainJSONStringChar>(p, end);
+}
+
+size_t CountUnescapedJSONChars(const char* begin, const char* end) {
+  const char* p = begin;
+#if defined(ARCH_CPU_HAS_SSE2)
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i del = _mm_set1_epi8(0x7F);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i less = _mm_set1_epi8('<');
+  const __m128i greater = _mm_set1_epi8('>');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    // The comparison is signed, so it catches both control characters and
+    // non-ASCII bytes.
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmplt_epi8(chunk, space),
+                     _mm_cmpeq_epi8(chunk, del)),
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                         _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, less),
+                         _mm_cmpeq_epi8(chunk, greater))));
+    if (_mm_movemask_epi8(special))
+      break;
+    p += 16;
+  }
+#endif
+  return (p - begin) + CountScalar<IsUnescapedJSONChar>(p, end);
+}
+
+}  // namespace internal
+}  // namespace base
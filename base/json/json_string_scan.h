@@ -0,0 +1,35 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Scanners for the runs of characters inside JSON strings which need no work
+// from the parser or the escaper. Long runs of plain ASCII are the common
+// case, so these check 16 bytes at a time with SSE2 where it is available at
+// compile time, and fall back to a byte-at-a-time loop elsewhere.
+
+#ifndef BASE_JSON_JSON_STRING_SCAN_H_
+#define BASE_JSON_JSON_STRING_SCAN_H_
+
+#include <stddef.h>
+
+#include "base/base_export.h"
+
+namespace base {
+namespace internal {
+
+// Returns the number of bytes at the start of [begin, end) which are ASCII
+// and are neither '"' nor '\\': the characters the parser copies from a JSON
+// string literal as they are.
+BASE_EXPORT_PRIVATE size_t CountPlainJSONStringChars(const char* begin,
+                                                     const char* end);
+
+// Returns the number of bytes at the start of [begin, end) which
+// JsonDoubleQuote() copies without escaping: printable ASCII other than '"',
+// '\\', '<' and '>'.
+BASE_EXPORT_PRIVATE size_t CountUnescapedJSONChars(const char* begin,
+                                                   const char* end);
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_JSON_JSON_STRING_SCAN_H_
@@ -0,0 +1,89 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_string_scan.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+size_t CountPlainReference(const std::string& str, size_t start) {
+  size_t i = start;
+  while (i < str.size()) {
+    unsigned char c = str[i];
+    if (c >= 0x80 || c == '"' || c == '\\')
+      break;
+    ++i;
+  }
+  return i - start;
+}
+
+size_t CountUnescapedReference(const std::string& str, size_t start) {
+  size_t i = start;
+  while (i < str.size()) {
+    unsigned char c = str[i];
+    if (c < 0x20 || c > 0x7E || c == '"' || c == '\\' || c == '<' || c == '>')
+      break;
+    ++i;
+  }
+  return i - start;
+}
+
+}  // namespace
+
+TEST(JSONStringScanTest, Simple) {
+  std::string plain("Hello, world");
+  const char* begin = plain.data();
+  const char* end = begin + plain.size();
+  EXPECT_EQ(plain.size(), CountPlainJSONStringChars(begin, end));
+  EXPECT_EQ(plain.size(), CountUnescapedJSONChars(begin, end));
+  EXPECT_EQ(0u, CountPlainJSONStringChars(begin, begin));
+  EXPECT_EQ(0u, CountUnescapedJSONChars(begin, begin));
+
+  std::string quoted("abc\"def");
+  begin = quoted.data();
+  end = begin + quoted.size();
+  EXPECT_EQ(3u, CountPlainJSONStringChars(begin, end));
+  EXPECT_EQ(3u, CountUnescapedJSONChars(begin, end));
+
+  // Control characters are copied by the parser but escaped by the writer.
+  std::string control("0123456789abcdefghij\nklm");
+  begin = control.data();
+  end = begin + control.size();
+  EXPECT_EQ(control.size(), CountPlainJSONStringChars(begin, end));
+  EXPECT_EQ(20u, CountUnescapedJSONChars(begin, end));
+}
+
+// Every special character is found at every offset of a block, whatever the
+// alignment of the input and the length of the tail.
+TEST(JSONStringScanTest, MatchesReference) {
+  const char kSpecial[] = { '"', '\\', '<', '>', '\n', '\x1f', '\x7f',
+                            '\x80', '\xc3', '\xff', ' ', '~' };
+  for (size_t special = 0; special < arraysize(kSpecial); ++special) {
+    for (size_t length = 0; length < 70; ++length) {
+      for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t pos = 0; pos <= length; ++pos) {
+          std::string str(offset + length, 'a');
+          if (pos < length)
+            str[offset + pos] = kSpecial[special];
+          const char* begin = str.data() + offset;
+          const char* end = str.data() + str.size();
+          EXPECT_EQ(CountPlainReference(str, offset),
+                    CountPlainJSONStringChars(begin, end));
+          EXPECT_EQ(CountUnescapedReference(str, offset),
+                    CountUnescapedJSONChars(begin, end));
+        }
+      }
+    }
+  }
+}
+
+}  // namespace internal
+}  // namespace base
@@ -6,6 +6,7 @@
 
 #include <string>
 
+#include "base/json/json_string_scan.h"
 #include "base/stringprintf.h"
 #include "base/string_util.h"
 
@@ -49,6 +50,30 @@ static bool JsonSingleEscapeChar(const CHAR c, std::string* dst) {
   return true;
 }
 
+// Appends the characters from |begin| which need no escaping to |dst|, and
+// returns the first one which does, or |end|.
+static const char* AppendUnescapedRun(const char* begin,
+                                      const char* end,
+                                      std::string* dst) {
+  size_t run = internal::CountUnescapedJSONChars(begin, end);
+  dst->append(begin, run);
+  return begin + run;
+}
+
+// UTF-16 strings are rare here, so they are scanned one character at a time.
+static const char16* AppendUnescapedRun(const char16* begin,
+                                        const char16* end,
+                                        std::string* dst) {
+  const char16* it = begin;
+  for (; it != end; ++it) {
+    char16 c = *it;
+    if (c < 32 || c > 126 || c == '"' || c == '\\' || c == '<' || c == '>')
+      break;
+    dst->push_back(static_cast<char>(c));
+  }
+  return it;
+}
+
 template <class STR>
 void JsonDoubleQuoteT(const STR& str,
                       bool put_in_quotes,
@@ -56,15 +81,27 @@ void JsonDoubleQuoteT(const STR& str,
   if (put_in_quotes)
     dst->push_back('"');
 
-  for (typename STR::const_iterator it = str.begin(); it != str.end(); ++it) {
+  const typename STR::value_type* const end = str.data() + str.size();
+  for (const typename STR::value_type* it = str.data(); it != end; ++it) {
+    it = AppendUnescapedRun(it, end, dst);
+    if (it == end)
+      break;
+
     typename ToUnsigned<typename STR::value_type>::Unsigned c = *it;
     if (!JsonSingleEscapeChar(c, dst)) {
       if (c < 32 || c > 126 || c == '<' || c == '>') {
         // 1. Escaping <, > to prevent script execution.
         // 2. Technically, we could also pass through c > 126 as UTF8, but this
         //    is also optional.  It would also be a pain to implement here.
+        // The same as StringAppendF(dst, "\\u%04X", c), without the cost of
+        // formatting.
+        static const char kHexDigits[] = "0123456789ABCDEF";
         unsigned int as_uint = static_cast<unsigned int>(c);
-        base::StringAppendF(dst, "\\u%04X", as_uint);
+        dst->append("\\u");
+        dst->push_back(kHexDigits[(as_uint >> 12) & 0xF]);
+        dst->push_back(kHexDigits[(as_uint >> 8) & 0xF]);
+        dst->push_back(kHexDigits[(as_uint >> 4) & 0xF]);
+        dst->push_back(kHexDigits[as_uint & 0xF]);
       } else {
         unsigned char ascii = static_cast<unsigned char>(*it);
         dst->push_back(ascii);
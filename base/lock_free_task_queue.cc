@@ -0,0 +1,230 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/lock_free_task_queue.h"
+
+#include <vector>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/manual_constructor.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace base {
+
+struct LockFreeTaskQueue::Node {
+  Node() : next(0) {}
+
+  // Constructed in Push() and destroyed once the task has been handed to the
+  // consumer, so that pooled nodes do not keep closures alive.
+  ManualConstructor<PendingTask> task;
+
+  // Node*, written by the producer which links the following node.
+  subtle::AtomicWord next;
+};
+
+namespace {
+
+typedef LockFreeTaskQueue::Node Node;
+
+// Number of nodes moved between a thread cache and the shared depot at once.
+const int kNodeBatchSize = 64;
+
+// Upper bound on the number of batches kept in the shared depot.  Nodes freed
+// beyond that are returned to the heap.
+const size_t kMaxDepotBatches = 64;
+
+// Pool of free queue nodes.  Every thread owns a small cache of nodes; the
+// posting threads allocate from their cache while the consuming threads free
+// into theirs.  Caches that grow too large spill a batch into the shared
+// depot, and empty caches refill from it, so |lock_| is taken at most once
+// every kNodeBatchSize allocations.
+class NodePool {
+ public:
+  NodePool() : tls_(&NodePool::OnThreadExit) {}
+
+  Node* Allocate() {
+    ThreadCache* cache = GetThreadCache();
+    if (!cache->head) {
+      AutoLock lock(lock_);
+      if (depot_.empty())
+        return new Node;
+      cache->head = depot_.back();
+      cache->size = kNodeBatchSize;
+      depot_.pop_back();
+    }
+    Node* node = cache->head;
+    cache->head = reinterpret_cast<Node*>(node->next);
+    --cache->size;
+    return node;
+  }
+
+  void Free(Node* node) {
+    ThreadCache* cache = GetThreadCache();
+    node->next = reinterpret_cast<subtle::AtomicWord>(cache->head);
+    cache->head = node;
+    if (++cache->size < 2 * kNodeBatchSize)
+      return;
+
+    // Detach the kNodeBatchSize oldest nodes and hand them to the depot.
+    Node* last = cache->head;
+    for (int i = 1; i < kNodeBatchSize; ++i)
+      last = reinterpret_cast<Node*>(last->next);
+    Node* batch = reinterpret_cast<Node*>(last->next);
+    last->next = 0;
+    cache->size = kNodeBatchSize;
+    {
+      AutoLock lock(lock_);
+      if (depot_.size() < kMaxDepotBatches) {
+        depot_.push_back(batch);
+        return;
+      }
+    }
+    DeleteChain(batch);
+  }
+
+ private:
+  struct ThreadCache {
+    ThreadCache() : head(NULL), size(0) {}
+    Node* head;
+    int size;
+  };
+
+  static void DeleteChain(Node* node) {
+    while (node) {
+      Node* next = reinterpret_cast<Node*>(node->next);
+      delete node;
+      node = next;
+    }
+  }
+
+  static void OnThreadExit(void* value);
+
+  ThreadCache* GetThreadCache() {
+    ThreadCache* cache = static_cast<ThreadCache*>(tls_.Get());
+    if (!cache) {
+      cache = new ThreadCache;
+      tls_.Set(cache);
+    }
+    return cache;
+  }
+
+  ThreadLocalStorage::Slot tls_;
+
+  // Protects |depot_|.
+  Lock lock_;
+
+  // Chains of exactly kNodeBatchSize free nodes.
+  std::vector<Node*> depot_;
+
+  DISALLOW_COPY_AND_ASSIGN(NodePool);
+};
+
+LazyInstance<NodePool>::Leaky g_node_pool = LAZY_INSTANCE_INITIALIZER;
+
+// static
+void NodePool::OnThreadExit(void* value) {
+  ThreadCache* cache = static_cast<ThreadCache*>(value);
+  DeleteChain(cache->head);
+  delete cache;
+}
+
+}  // namespace
+
+LockFreeTaskQueue::LockFreeTaskQueue()
+    : head_(0),
+      tail_(NULL),
+      stub_(new Node),
+      wakeup_pending_(0) {
+  head_ = reinterpret_cast<subtle::AtomicWord>(stub_);
+  tail_ = stub_;
+}
+
+LockFreeTaskQueue::~LockFreeTaskQueue() {
+  // Tasks still queued at this point were posted to a MessageLoop that is gone;
+  // delete them without running them.
+  while (Node* node = PopNode()) {
+    node->task.Destroy();
+    delete node;
+  }
+  delete stub_;
+}
+
+bool LockFreeTaskQueue::Push(const PendingTask& pending_task) {
+  Node* node = g_node_pool.Get().Allocate();
+  node->task.Init(pending_task);
+  PushNode(node);
+
+  // Only the first producer after a drain wakes up the consumer.  The flag is
+  // checked after the node is linked, so a consumer that clears it afterwards
+  // is guaranteed to observe the node when it drains.
+  return subtle::Acquire_CompareAndSwap(&wakeup_pending_, 0, 1) == 0;
+}
+
+bool LockFreeTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
+  // Re-arm the wake-up before looking at the list, so that a node which is
+  // not reachable yet makes its producer schedule another DoWork().
+  subtle::Release_Store(&wakeup_pending_, 0);
+  subtle::MemoryBarrier();
+
+  bool did_work = false;
+  while (Node* node = PopNode()) {
+    work_queue->push(*node->task);
+    node->task.Destroy();
+    g_node_pool.Get().Free(node);
+    did_work = true;
+  }
+  return did_work;
+}
+
+bool LockFreeTaskQueue::IsEmpty() const {
+  Node* tail = tail_;
+  Node* next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  return tail == stub_ && !next;
+}
+
+void LockFreeTaskQueue::PushNode(Node* node) {
+  subtle::NoBarrier_Store(&node->next, 0);
+  // Make the task contents visible before the node can be reached through
+  // |head_| by the next producer.
+  subtle::MemoryBarrier();
+  Node* prev = reinterpret_cast<Node*>(subtle::NoBarrier_AtomicExchange(
+      &head_, reinterpret_cast<subtle::AtomicWord>(node)));
+  // Between the exchange above and this store the list is momentarily broken
+  // at |prev|; the consumer treats that as "empty" and the wake-up protocol in
+  // Push() makes sure it comes back.
+  subtle::Release_Store(&prev->next, reinterpret_cast<subtle::AtomicWord>(node));
+}
+
+LockFreeTaskQueue::Node* LockFreeTaskQueue::PopNode() {
+  Node* tail = tail_;
+  Node* next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  if (tail == stub_) {
+    if (!next)
+      return NULL;
+    tail_ = next;
+    tail = next;
+    next = reinterpret_cast<Node*>(subtle::Acquire_Load(&next->next));
+  }
+  if (next) {
+    tail_ = next;
+    return tail;
+  }
+
+  // |tail| is the last reachable node.  It can only be handed out once another
+  // node follows it, so re-insert the stub behind it.
+  Node* head = reinterpret_cast<Node*>(subtle::Acquire_Load(&head_));
+  if (tail != head)
+    return NULL;  // A producer is in the middle of linking a node.
+  PushNode(stub_);
+  next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  if (next) {
+    tail_ = next;
+    return tail;
+  }
+  return NULL;
+}
+
+}  // namespace base
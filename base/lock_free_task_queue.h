@@ -0,0 +1,84 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_LOCK_FREE_TASK_QUEUE_H_
+#define BASE_LOCK_FREE_TASK_QUEUE_H_
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/pending_task.h"
+
+namespace base {
+
+// An intrusive multi-producer, single-consumer queue of PendingTasks that
+// never takes a lock on the posting path.  It is used by MessageLoop as an
+// alternative to the lock-protected |incoming_queue_| (see
+// MessageLoop::EnableLockFreeIncomingQueue).
+//
+// Push() may be called on any thread.  ReloadWorkQueue() and IsEmpty() may only
+// be called on the single consuming thread.
+//
+// Queue nodes are recycled through a process-wide pool with per-thread caches,
+// so a steady stream of PostTask calls does not hit the heap for every task.
+//
+// The queue is reference counted so that a producer which is still finishing
+// its Push() keeps the queue alive even if the consuming MessageLoop runs the
+// task and is destroyed in the meantime.
+class BASE_EXPORT LockFreeTaskQueue
+    : public RefCountedThreadSafe<LockFreeTaskQueue> {
+ public:
+  LockFreeTaskQueue();
+
+  // Appends a copy of |pending_task| to the queue.  Returns true if the
+  // consumer has to be woken up (i.e. this is the first task pushed since the
+  // consumer last drained the queue); the caller is then responsible for
+  // calling MessagePump::ScheduleWork().
+  bool Push(const PendingTask& pending_task);
+
+  // Moves every task that is currently reachable into |work_queue|, in FIFO
+  // order, and re-arms the wake-up signal returned by Push().  Returns true if
+  // any task was moved.
+  bool ReloadWorkQueue(TaskQueue* work_queue);
+
+  // Returns true if no task is reachable from the consumer side.  A Push()
+  // that is in progress on another thread may not be visible yet.
+  bool IsEmpty() const;
+
+  // Queue node holding one task.  Only named here so that the node pool in the
+  // implementation file can refer to it.
+  struct Node;
+
+ private:
+  friend class RefCountedThreadSafe<LockFreeTaskQueue>;
+
+  ~LockFreeTaskQueue();
+
+  // Links |node| at the head of the queue.
+  void PushNode(Node* node);
+
+  // Unlinks the oldest reachable node, or returns NULL if none is reachable.
+  Node* PopNode();
+
+  // The most recently pushed node.  Swapped atomically by producers.
+  subtle::AtomicWord head_;
+
+  // The oldest node.  Only touched by the consumer.
+  Node* tail_;
+
+  // Placeholder node which keeps the list non-empty, so that producers never
+  // need to touch |tail_|.
+  Node* stub_;
+
+  // Non-zero once a producer has claimed the responsibility of waking up the
+  // consumer.  Cleared by the consumer right before it drains the queue.
+  subtle::Atomic32 wakeup_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockFreeTaskQueue);
+};
+
+}  // namespace base
+
+#endif  // BASE_LOCK_FREE_TASK_QUEUE_H_
@@ -0,0 +1,161 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/lock_free_task_queue.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/message_loop.h"
+#include "base/threading/simple_thread.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void RecordValue(std::vector<int>* values, int value) {
+  values->push_back(value);
+}
+
+PendingTask MakeTask(std::vector<int>* values, int value) {
+  return PendingTask(FROM_HERE, Bind(&RecordValue, values, value));
+}
+
+// Pushes |count| tasks that record |id| * |count| + i, in increasing order.
+class Pusher : public DelegateSimpleThread::Delegate {
+ public:
+  Pusher(LockFreeTaskQueue* queue, std::vector<int>* values, int id, int count)
+      : queue_(queue),
+        values_(values),
+        id_(id),
+        count_(count) {
+  }
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < count_; ++i)
+      queue_->Push(MakeTask(values_, id_ * count_ + i));
+  }
+
+ private:
+  LockFreeTaskQueue* queue_;
+  std::vector<int>* values_;
+  const int id_;
+  const int count_;
+};
+
+void HoldData(scoped_refptr<RefCountedData<int> > data) {
+}
+
+void RunAll(TaskQueue* work_queue) {
+  while (!work_queue->empty()) {
+    work_queue->front().task.Run();
+    work_queue->pop();
+  }
+}
+
+}  // namespace
+
+TEST(LockFreeTaskQueueTest, FifoOrder) {
+  scoped_refptr<LockFreeTaskQueue> queue(new LockFreeTaskQueue);
+  std::vector<int> values;
+  EXPECT_TRUE(queue->IsEmpty());
+
+  for (int i = 0; i < 300; ++i)
+    queue->Push(MakeTask(&values, i));
+  EXPECT_FALSE(queue->IsEmpty());
+
+  TaskQueue work_queue;
+  EXPECT_TRUE(queue->ReloadWorkQueue(&work_queue));
+  EXPECT_TRUE(queue->IsEmpty());
+  EXPECT_FALSE(queue->ReloadWorkQueue(&work_queue));
+  RunAll(&work_queue);
+
+  ASSERT_EQ(300u, values.size());
+  for (int i = 0; i < 300; ++i)
+    EXPECT_EQ(i, values[i]);
+}
+
+TEST(LockFreeTaskQueueTest, WakeUpOncePerDrain) {
+  scoped_refptr<LockFreeTaskQueue> queue(new LockFreeTaskQueue);
+  std::vector<int> values;
+
+  EXPECT_TRUE(queue->Push(MakeTask(&values, 0)));
+  EXPECT_FALSE(queue->Push(MakeTask(&values, 1)));
+
+  TaskQueue work_queue;
+  queue->ReloadWorkQueue(&work_queue);
+  EXPECT_EQ(2u, work_queue.size());
+
+  // Draining re-arms the wake-up, even when nothing was pushed in between.
+  EXPECT_TRUE(queue->Push(MakeTask(&values, 2)));
+  queue->ReloadWorkQueue(&work_queue);
+  queue->ReloadWorkQueue(&work_queue);
+  EXPECT_TRUE(queue->Push(MakeTask(&values, 3)));
+}
+
+TEST(LockFreeTaskQueueTest, DeletesTasksOnDestruction) {
+  scoped_refptr<LockFreeTaskQueue> queue(new LockFreeTaskQueue);
+  scoped_refptr<RefCountedData<int> > data(new RefCountedData<int>);
+  queue->Push(PendingTask(FROM_HERE, Bind(&HoldData, data)));
+  queue->Push(PendingTask(FROM_HERE, Bind(&HoldData, data)));
+  EXPECT_FALSE(data->HasOneRef());
+
+  queue = NULL;
+  EXPECT_TRUE(data->HasOneRef());
+}
+
+TEST(LockFreeTaskQueueTest, MultipleProducers) {
+  const int kProducers = 8;
+  const int kTasksPerProducer = 5000;
+
+  scoped_refptr<LockFreeTaskQueue> queue(new LockFreeTaskQueue);
+  std::vector<int> values;
+  std::vector<Pusher*> pushers;
+  DelegateSimpleThreadPool pool("LockFreeTaskQueueTest", kProducers);
+  for (int i = 0; i < kProducers; ++i) {
+    pushers.push_back(new Pusher(queue, &values, i, kTasksPerProducer));
+    pool.AddWork(pushers.back());
+  }
+  pool.Start();
+
+  TaskQueue work_queue;
+  while (values.size() < static_cast<size_t>(kProducers * kTasksPerProducer)) {
+    queue->ReloadWorkQueue(&work_queue);
+    RunAll(&work_queue);
+  }
+  pool.JoinAll();
+  EXPECT_TRUE(queue->IsEmpty());
+
+  // Tasks from a single producer must come out in the order they were pushed.
+  std::vector<int> last_seen(kProducers, -1);
+  for (size_t i = 0; i < values.size(); ++i) {
+    int producer = values[i] / kTasksPerProducer;
+    EXPECT_LT(last_seen[producer], values[i]);
+    last_seen[producer] = values[i];
+  }
+  for (int i = 0; i < kProducers; ++i)
+    delete pushers[i];
+}
+
+TEST(LockFreeTaskQueueTest, MessageLoopIntegration) {
+  MessageLoop::EnableLockFreeIncomingQueue(true);
+  Thread thread("LockFreeTaskQueueTest");
+  ASSERT_TRUE(thread.Start());
+  MessageLoop::EnableLockFreeIncomingQueue(false);
+
+  std::vector<int> values;
+  for (int i = 0; i < 100; ++i) {
+    thread.message_loop()->PostTask(FROM_HERE,
+                                    Bind(&RecordValue, &values, i));
+  }
+  thread.Stop();
+
+  ASSERT_EQ(100u, values.size());
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, values[i]);
+}
+
+}  // namespace base
@@ -11,6 +11,7 @@
 #include "base/debug/alias.h"
 #include "base/debug/trace_event.h"
 #include "base/lazy_instance.h"
+#include "base/lock_free_task_queue.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop_proxy_impl.h"
@@ -89,6 +90,8 @@ const base::LinearHistogram::DescriptionPair event_descriptions_[] = {
 
 bool enable_histogrammer_ = false;
 
+bool enable_lock_free_incoming_queue_ = false;
+
 MessageLoop::MessagePumpFactory* message_pump_for_ui_factory_ = NULL;
 
 // Create a process-wide unique ID to represent this task in trace events. This
@@ -149,6 +152,9 @@ MessageLoop::MessageLoop(Type type)
   DCHECK(!current()) << "should only have one message loop per thread";
   lazy_tls_ptr.Pointer()->Set(this);
 
+  if (enable_lock_free_incoming_queue_)
+    lock_free_incoming_queue_ = new base::LockFreeTaskQueue();
+
   message_loop_proxy_ = new base::MessageLoopProxyImpl();
   thread_task_runner_handle_.reset(
       new base::ThreadTaskRunnerHandle(message_loop_proxy_));
@@ -250,6 +256,11 @@ void MessageLoop::EnableHistogrammer(bool enable) {
   enable_histogrammer_ = enable;
 }
 
+// static
+void MessageLoop::EnableLockFreeIncomingQueue(bool enable) {
+  enable_lock_free_incoming_queue_ = enable;
+}
+
 // static
 void MessageLoop::InitMessagePumpForUIFactory(MessagePumpFactory* factory) {
   DCHECK(!message_pump_for_ui_factory_);
@@ -376,6 +387,10 @@ void MessageLoop::RemoveTaskObserver(TaskObserver* task_observer) {
 
 void MessageLoop::AssertIdle() const {
   // We only check |incoming_queue_|, since we don't want to lock |work_queue_|.
+  if (lock_free_incoming_queue_) {
+    DCHECK(lock_free_incoming_queue_->IsEmpty());
+    return;
+  }
   base::AutoLock lock(incoming_queue_lock_);
   DCHECK(incoming_queue_.empty());
 }
@@ -507,6 +522,11 @@ void MessageLoop::ReloadWorkQueue() {
   if (!work_queue_.empty())
     return;  // Wait till we *really* need to lock and load.
 
+  if (lock_free_incoming_queue_) {
+    lock_free_incoming_queue_->ReloadWorkQueue(&work_queue_);
+    return;
+  }
+
   // Acquire all we can from the inter-thread queue with one lock acquisition.
   {
     base::AutoLock lock(incoming_queue_lock_);
@@ -590,6 +610,11 @@ void MessageLoop::AddToIncomingQueue(PendingTask* pending_task) {
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
+  if (lock_free_incoming_queue_) {
+    AddToLockFreeIncomingQueue(pending_task);
+    return;
+  }
+
   scoped_refptr<base::MessagePump> pump;
   {
     base::AutoLock locked(incoming_queue_lock_);
@@ -618,6 +643,25 @@ void MessageLoop::AddToIncomingQueue(PendingTask* pending_task) {
   pump->ScheduleWork();
 }
 
+// Possibly called on a background thread!
+void MessageLoop::AddToLockFreeIncomingQueue(PendingTask* pending_task) {
+  // Take references up front: once the task is linked into the queue it may
+  // run and destroy this message loop before we are done here.
+  scoped_refptr<base::LockFreeTaskQueue> queue = lock_free_incoming_queue_;
+  scoped_refptr<base::MessagePump> pump = pump_;
+
+  pending_task->sequence_num =
+      base::subtle::NoBarrier_AtomicIncrement(&next_sequence_num_, 1) - 1;
+
+  TRACE_EVENT_FLOW_BEGIN0("task", "MessageLoop::PostTask",
+      TRACE_ID_MANGLE(GetTaskTraceID(*pending_task, this)));
+
+  bool needs_wakeup = queue->Push(*pending_task);
+  pending_task->task.Reset();
+  if (needs_wakeup)
+    pump->ScheduleWork();
+}
+
 //------------------------------------------------------------------------------
 // Method and data for histogramming events and actions taken by each instance
 // on each thread.
@@ -8,6 +8,7 @@
 #include <queue>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/callback_forward.h"
@@ -43,6 +44,7 @@
 
 namespace base {
 class Histogram;
+class LockFreeTaskQueue;
 class RunLoop;
 class ThreadTaskRunnerHandle;
 #if defined(OS_ANDROID)
@@ -119,6 +121,11 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
 
   static void EnableHistogrammer(bool enable_histogrammer);
 
+  // Makes MessageLoops constructed after this call use a lock-free
+  // multi-producer queue (base::LockFreeTaskQueue) for tasks posted from other
+  // threads, instead of |incoming_queue_| and |incoming_queue_lock_|.
+  static void EnableLockFreeIncomingQueue(bool enable);
+
   typedef base::MessagePump* (MessagePumpFactory)();
   // Using the given base::MessagePumpForUIFactory to override the default
   // MessagePump implementation for 'TYPE_UI'.
@@ -435,6 +442,10 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   // beyond this function call.
   void AddToIncomingQueue(base::PendingTask* pending_task);
 
+  // Implementation of AddToIncomingQueue() used when
+  // |lock_free_incoming_queue_| is in use.
+  void AddToLockFreeIncomingQueue(base::PendingTask* pending_task);
+
   // Load tasks from the incoming_queue_ into work_queue_ if the latter is
   // empty.  The former requires a lock to access, while the latter is directly
   // accessible on this thread.
@@ -501,6 +512,10 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   // Protect access to incoming_queue_.
   mutable base::Lock incoming_queue_lock_;
 
+  // Replaces |incoming_queue_| when the lock-free incoming queue was enabled
+  // at construction time.  NULL otherwise.
+  scoped_refptr<base::LockFreeTaskQueue> lock_free_incoming_queue_;
+
   base::RunLoop* run_loop_;
 
 #if defined(OS_WIN)
@@ -511,8 +526,9 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
 #endif
 
   // The next sequence number to use for delayed tasks. Updating this counter is
-  // protected by incoming_queue_lock_.
-  int next_sequence_num_;
+  // protected by incoming_queue_lock_, or done atomically when
+  // |lock_free_incoming_queue_| is in use.
+  base::subtle::Atomic32 next_sequence_num_;
 
   ObserverList<TaskObserver> task_observers_;
 
@@ -0,0 +1,107 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/bind.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Total number of tasks posted in every run, split evenly among producers.
+const int kTasksPerRun = 320000;
+
+// Counts the tasks run on the consumer thread and signals |done| once the
+// expected number of tasks has run.
+class TaskCounter {
+ public:
+  TaskCounter(int expected, base::WaitableEvent* done)
+      : expected_(expected),
+        count_(0),
+        done_(done) {
+  }
+
+  void Increment() {
+    if (++count_ == expected_)
+      done_->Signal();
+  }
+
+ private:
+  const int expected_;
+  int count_;
+  base::WaitableEvent* done_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskCounter);
+};
+
+// Posts |count| tasks to |loop| from whatever thread runs it.
+class Producer : public base::DelegateSimpleThread::Delegate {
+ public:
+  Producer(MessageLoop* loop, int count, TaskCounter* counter)
+      : loop_(loop),
+        count_(count),
+        counter_(counter) {
+  }
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < count_; ++i) {
+      loop_->PostTask(FROM_HERE, base::Bind(&TaskCounter::Increment,
+                                            base::Unretained(counter_)));
+    }
+  }
+
+ private:
+  MessageLoop* loop_;
+  const int count_;
+  TaskCounter* counter_;
+
+  DISALLOW_COPY_AND_ASSIGN(Producer);
+};
+
+// Posts kTasksPerRun tasks from |num_producers| threads to one consumer thread
+// and logs the number of tasks posted and run per second.
+void RunPostTaskBenchmark(bool lock_free, int num_producers) {
+  MessageLoop::EnableLockFreeIncomingQueue(lock_free);
+  base::Thread consumer("PostTaskPerfConsumer");
+  ASSERT_TRUE(consumer.Start());
+  MessageLoop::EnableLockFreeIncomingQueue(false);
+
+  base::WaitableEvent done(false, false);
+  int tasks_per_producer = kTasksPerRun / num_producers;
+  TaskCounter counter(tasks_per_producer * num_producers, &done);
+  Producer producer(consumer.message_loop(), tasks_per_producer, &counter);
+
+  base::DelegateSimpleThreadPool pool("PostTaskPerfProducer", num_producers);
+  pool.AddWork(&producer, num_producers);
+
+  PerfTimer timer;
+  pool.Start();
+  pool.JoinAll();
+  done.Wait();
+  base::TimeDelta elapsed = timer.Elapsed();
+
+  std::string name = base::StringPrintf("MessageLoop_PostTask_%s_%dproducers",
+                                        lock_free ? "lockfree" : "locked",
+                                        num_producers);
+  LogPerfResult(name.c_str(),
+                tasks_per_producer * num_producers / elapsed.InSecondsF(),
+                "tasks/s");
+  consumer.Stop();
+}
+
+}  // namespace
+
+TEST(MessageLoopPerfTest, PostTaskLocked) {
+  for (int producers = 1; producers <= 16; producers *= 2)
+    RunPostTaskBenchmark(false, producers);
+}
+
+TEST(MessageLoopPerfTest, PostTaskLockFree) {
+  for (int producers = 1; producers <= 16; producers *= 2)
+    RunPostTaskBenchmark(true, producers);
+}
@@ -17,6 +17,7 @@
 #include "base/compiler_specific.h"
 #include "base/debug/alias.h"
 #include "base/logging.h"
+#include "base/metrics/histogram_shared_memory.h"
 #include "base/metrics/sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
 #include "base/pickle.h"
@@ -211,40 +212,27 @@ bool Histogram::DeserializeHistogramInfo(const string& histogram_info) {
   }
 
   DCHECK(pickle_flags & kIPCSerializationSourceFlag);
-  // Since these fields may have come from an untrusted renderer, do additional
-  // checks above and beyond those in Histogram::Initialize()
-  if (declared_max <= 0 || declared_min <= 0 || declared_max < declared_min ||
-      INT_MAX / sizeof(Count) <= bucket_count || bucket_count < 2) {
+  // Checked here as well, before it is narrowed to a size_t.
+  if (INT_MAX / sizeof(Count) <= bucket_count) {
     DLOG(ERROR) << "Values error decoding Histogram: " << histogram_name;
     return false;
   }
 
-  Flags flags = static_cast<Flags>(pickle_flags & ~kIPCSerializationSourceFlag);
-
-  Histogram* render_histogram(NULL);
-
-  if (histogram_type == HISTOGRAM) {
-    render_histogram = Histogram::FactoryGet(
-        histogram_name, declared_min, declared_max, bucket_count, flags);
-  } else if (histogram_type == LINEAR_HISTOGRAM) {
-    render_histogram = LinearHistogram::FactoryGet(
-        histogram_name, declared_min, declared_max, bucket_count, flags);
-  } else if (histogram_type == BOOLEAN_HISTOGRAM) {
-    render_histogram = BooleanHistogram::FactoryGet(histogram_name, flags);
-  } else if (histogram_type == CUSTOM_HISTOGRAM) {
-    vector<Sample> sample_ranges(bucket_count);
+  vector<Sample> sample_ranges;
+  if (histogram_type == CUSTOM_HISTOGRAM) {
+    sample_ranges.resize(bucket_count);
     if (!CustomHistogram::DeserializeRanges(&iter, &sample_ranges)) {
       DLOG(ERROR) << "Pickle error decoding ranges: " << histogram_name;
       return false;
     }
-    render_histogram =
-        CustomHistogram::FactoryGet(histogram_name, sample_ranges, flags);
-  } else {
-    DLOG(ERROR) << "Error Deserializing Histogram Unknown histogram_type: "
-                << histogram_type;
-    return false;
   }
 
+  Histogram* render_histogram = FactoryGetFromChildArguments(
+      histogram_name, histogram_type, declared_min, declared_max,
+      static_cast<size_t>(bucket_count), pickle_flags, sample_ranges);
+  if (!render_histogram)
+    return false;
+
   DCHECK_EQ(render_histogram->declared_min(), declared_min);
   DCHECK_EQ(render_histogram->declared_max(), declared_max);
   DCHECK_EQ(render_histogram->bucket_count(), bucket_count);
@@ -260,10 +248,50 @@ bool Histogram::DeserializeHistogramInfo(const string& histogram_info) {
     return true;
   }
 
+  Flags flags = static_cast<Flags>(pickle_flags & ~kIPCSerializationSourceFlag);
   DCHECK_EQ(flags & render_histogram->flags(), flags);
   return render_histogram->AddSamplesFromPickle(&iter);
 }
 
+// static
+Histogram* Histogram::FactoryGetFromChildArguments(
+    const string& name,
+    int histogram_type,
+    Sample declared_min,
+    Sample declared_max,
+    size_t bucket_count,
+    int32 flags,
+    const vector<Sample>& custom_ranges) {
+  // Since these fields may have come from an untrusted renderer, do additional
+  // checks above and beyond those in Histogram::Initialize()
+  if (declared_max <= 0 || declared_min <= 0 || declared_max < declared_min ||
+      INT_MAX / sizeof(Count) <= bucket_count || bucket_count < 2) {
+    DLOG(ERROR) << "Values error decoding Histogram: " << name;
+    return NULL;
+  }
+
+  flags &= ~kIPCSerializationSourceFlag;
+
+  if (histogram_type == HISTOGRAM) {
+    return Histogram::FactoryGet(
+        name, declared_min, declared_max, bucket_count, flags);
+  } else if (histogram_type == LINEAR_HISTOGRAM) {
+    return LinearHistogram::FactoryGet(
+        name, declared_min, declared_max, bucket_count, flags);
+  } else if (histogram_type == BOOLEAN_HISTOGRAM) {
+    return BooleanHistogram::FactoryGet(name, flags);
+  } else if (histogram_type == CUSTOM_HISTOGRAM) {
+    if (!CustomHistogram::ValidateCustomRanges(custom_ranges)) {
+      DLOG(ERROR) << "Ranges error decoding Histogram: " << name;
+      return NULL;
+    }
+    return CustomHistogram::FactoryGet(name, custom_ranges, flags);
+  }
+  DLOG(ERROR) << "Error Deserializing Histogram Unknown histogram_type: "
+              << histogram_type;
+  return NULL;
+}
+
 // static
 const int Histogram::kCommonRaceBasedCountMismatch = 5;
 
@@ -384,7 +412,8 @@ Histogram::Histogram(const string& name,
     bucket_ranges_(ranges),
     declared_min_(minimum),
     declared_max_(maximum),
-    bucket_count_(bucket_count) {
+    bucket_count_(bucket_count),
+    shared_memory_(NULL) {
   if (ranges)
     samples_.reset(new SampleVector(ranges));
 }
@@ -397,6 +426,24 @@ Histogram::~Histogram() {
   }
 }
 
+void Histogram::MoveSamplesToSharedMemory() {
+  DCHECK(!shared_memory_);
+  HistogramSharedMemory* shared_memory =
+      HistogramSharedMemory::GetForCurrentProcess();
+  if (!shared_memory || !samples_)
+    return;
+  uint32 record = 0;
+  scoped_ptr<SampleVector> shared_samples = shared_memory->AllocateSamples(
+      histogram_name(), declared_min_, declared_max_, bucket_count_,
+      bucket_ranges_, &record);
+  if (!shared_samples)
+    return;
+  shared_samples->Add(*samples_);
+  samples_ = shared_samples.Pass();
+  shared_memory_ = shared_memory;
+  shared_memory->Publish(record, GetHistogramType(), flags());
+}
+
 bool Histogram::SerializeRanges(Pickle* pickle) const {
   return true;
 }
@@ -347,6 +347,7 @@ class Lock;
 //------------------------------------------------------------------------------
 
 class BucketRanges;
+class HistogramSharedMemory;
 class SampleVector;
 
 class BooleanHistogram;
@@ -433,6 +434,19 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // browser process.
   static bool DeserializeHistogramInfo(const std::string& histogram_info);
 
+  // Gets or creates the histogram of |histogram_type| with the given
+  // construction arguments, which came from a child process and are checked
+  // first. |custom_ranges| is only used for CUSTOM_HISTOGRAM. Returns NULL if
+  // the arguments are bad.
+  static Histogram* FactoryGetFromChildArguments(
+      const std::string& name,
+      int histogram_type,
+      Sample declared_min,
+      Sample declared_max,
+      size_t bucket_count,
+      int32 flags,
+      const std::vector<Sample>& custom_ranges);
+
   // This constant if for FindCorruption. Since snapshots of histograms are
   // taken asynchronously relative to sampling, and our counting code currently
   // does not prevent race conditions, it is pretty likely that we'll catch a
@@ -458,6 +472,10 @@ class BASE_EXPORT Histogram : public HistogramBase {
   virtual size_t bucket_count() const;
   const BucketRanges* bucket_ranges() const { return bucket_ranges_; }
 
+  // Whether the samples are kept in the HistogramSharedMemory segment of this
+  // process, where the browser reads them, rather than on the heap.
+  bool samples_in_shared_memory() const { return shared_memory_ != NULL; }
+
   // This function validates histogram construction arguments. It returns false
   // if some of the arguments are totally bad.
   // Note. Currently it allow some bad input, e.g. 0 as minimum, but silently
@@ -521,6 +539,12 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // Implementation of SnapshotSamples function.
   scoped_ptr<SampleVector> SnapshotSampleVector() const;
 
+  // Moves the samples into a record of the HistogramSharedMemory segment of
+  // this process, if there is one with room left, and makes the record
+  // visible to the browser. Called when the histogram is registered, before
+  // any other thread can see it, so that duplicates never take a record.
+  void MoveSamplesToSharedMemory();
+
   //----------------------------------------------------------------------------
   // Helpers for emitting Ascii graphic.  Each method appends data to output.
 
@@ -568,6 +592,9 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // sample.
   scoped_ptr<SampleVector> samples_;
 
+  // The segment |samples_| are kept in, if they are in shared memory.
+  HistogramSharedMemory* shared_memory_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
@@ -686,6 +713,10 @@ class BASE_EXPORT CustomHistogram : public Histogram {
   // correctly sized before this call.  Return true on success.
   static bool DeserializeRanges(PickleIterator* iter,
                                 std::vector<Sample>* ranges);
+
+  // Returns whether FactoryGet() accepts |custom_ranges|.
+  static bool ValidateCustomRanges(const std::vector<Sample>& custom_ranges);
+
  protected:
   CustomHistogram(const std::string& name,
                   const BucketRanges* ranges);
@@ -695,7 +726,6 @@ class BASE_EXPORT CustomHistogram : public Histogram {
   virtual double GetBucketSize(Count current, size_t i) const OVERRIDE;
 
  private:
-  static bool ValidateCustomRanges(const std::vector<Sample>& custom_ranges);
   static BucketRanges* CreateBucketRangesFromCustomRanges(
       const std::vector<Sample>& custom_ranges);
 
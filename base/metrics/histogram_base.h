@@ -7,6 +7,7 @@
 
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
@@ -38,6 +39,7 @@ class BASE_EXPORT HistogramBase {
  public:
   typedef int Sample;  // Used for samples.
   typedef int Count;   // Used to count samples.
+  typedef subtle::Atomic32 AtomicCount;  // Used to count samples in buckets.
 
   static const Sample kSampleType_MAX;  // INT_MAX
 
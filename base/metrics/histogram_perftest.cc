@@ -0,0 +1,193 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_flattener.h"
+#include "base/metrics/histogram_shared_memory.h"
+#include "base/metrics/histogram_snapshot_manager.h"
+#include "base/metrics/sample_vector.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Number of samples recorded by every thread in a run.
+const int kSamplesPerThread = 1000000;
+
+// Number of histograms registered before the lookup benchmarks, about what a
+// browser process has after startup.
+const int kRegisteredHistograms = 1000;
+
+std::string HistogramName(int index) {
+  return StringPrintf("Perf.Histogram%d", index);
+}
+
+// Records kSamplesPerThread samples, either into one shared histogram as a
+// UMA_HISTOGRAM_* macro does once it has cached the histogram, or into
+// histograms looked up by name every time as code with computed names does.
+class SampleRecorder : public DelegateSimpleThread::Delegate {
+ public:
+  explicit SampleRecorder(Histogram* histogram) : histogram_(histogram) {}
+
+  virtual void Run() OVERRIDE {
+    if (histogram_) {
+      for (int i = 0; i < kSamplesPerThread; ++i)
+        histogram_->Add(i & 63);
+      return;
+    }
+    std::vector<std::string> names;
+    for (int i = 0; i < 64; ++i)
+      names.push_back(HistogramName(i * 13));
+    for (int i = 0; i < kSamplesPerThread; ++i) {
+      Histogram::FactoryGet(names[i & 63], 1, 64, 8,
+                            Histogram::kNoFlags)->Add(i & 63);
+    }
+  }
+
+ private:
+  Histogram* histogram_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleRecorder);
+};
+
+// Records samples on |num_threads| threads, and logs the number of samples
+// recorded per second by each thread.
+void RunRecordBenchmark(const char* name, Histogram* histogram,
+                        int num_threads) {
+  SampleRecorder recorder(histogram);
+  DelegateSimpleThreadPool pool("HistogramPerfRecorder", num_threads);
+  pool.AddWork(&recorder, num_threads);
+
+  PerfTimer timer;
+  pool.Start();
+  pool.JoinAll();
+  TimeDelta elapsed = timer.Elapsed();
+
+  LogPerfResult(StringPrintf("Histogram_%s_%dthreads", name,
+                             num_threads).c_str(),
+                kSamplesPerThread / elapsed.InSecondsF(), "samples/s/thread");
+}
+
+// Number of histograms of a child process in the snapshot benchmarks, and the
+// number of snapshots taken.
+const int kChildHistograms = 500;
+const int kSnapshots = 200;
+
+// Serializes the deltas as ChildHistogramMessageFilter does.
+class PicklingFlattener : public HistogramFlattener {
+ public:
+  PicklingFlattener() : bytes_(0) {}
+
+  size_t bytes() const { return bytes_; }
+
+  virtual void RecordDelta(const Histogram& histogram,
+                           const HistogramSamples& snapshot) OVERRIDE {
+    bytes_ += Histogram::SerializeHistogramInfo(histogram, snapshot).size();
+  }
+  virtual void InconsistencyDetected(
+      Histogram::Inconsistencies problem) OVERRIDE {}
+  virtual void UniqueInconsistencyDetected(
+      Histogram::Inconsistencies problem) OVERRIDE {}
+  virtual void InconsistencyDetectedInLoggedCount(int amount) OVERRIDE {}
+
+ private:
+  size_t bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(PicklingFlattener);
+};
+
+void LogSnapshotTime(const char* name, const PerfTimer& timer) {
+  LogPerfResult(StringPrintf("Histogram_Snapshot_%s", name).c_str(),
+                timer.Elapsed().InMillisecondsF() / kSnapshots, "ms");
+}
+
+}  // namespace
+
+TEST(HistogramPerfTest, AddToCachedHistogram) {
+  StatisticsRecorder::Initialize();
+  Histogram* histogram = Histogram::FactoryGet(
+      "Perf.Cached", 1, 64, 8, Histogram::kNoFlags);
+  for (int threads = 1; threads <= 8; threads *= 2)
+    RunRecordBenchmark("cached", histogram, threads);
+
+  // Every sample must have been counted.
+  EXPECT_EQ(15 * kSamplesPerThread,
+            histogram->SnapshotSamples()->TotalCount());
+}
+
+TEST(HistogramPerfTest, FindAndAdd) {
+  StatisticsRecorder::Initialize();
+  for (int i = 0; i < kRegisteredHistograms; ++i) {
+    Histogram::FactoryGet(HistogramName(i), 1, 64, 8,
+                          Histogram::kNoFlags);
+  }
+  for (int threads = 1; threads <= 8; threads *= 2)
+    RunRecordBenchmark("lookup", NULL, threads);
+}
+
+// What it costs to collect the histograms of a child process, which records a
+// few samples into every histogram between snapshots. Pickling is the child's
+// part only: the IPC and the browser's deserialization come on top of it.
+TEST(HistogramPerfTest, SnapshotChildHistograms) {
+  StatisticsRecorder::Initialize();
+  std::vector<Histogram*> pickled;
+  for (int i = 0; i < kChildHistograms; ++i) {
+    pickled.push_back(Histogram::FactoryGet(
+        StringPrintf("Perf.Pickled%d", i), 1, 10000, 50,
+        Histogram::kNoFlags));
+  }
+  PicklingFlattener flattener;
+  HistogramSnapshotManager snapshot_manager(&flattener);
+  {
+    PerfTimer timer;
+    for (int snapshot = 0; snapshot < kSnapshots; ++snapshot) {
+      for (size_t i = 0; i < pickled.size(); ++i)
+        pickled[i]->Add(snapshot * 7 + i);
+      snapshot_manager.PrepareDeltas(Histogram::kIPCSerializationSourceFlag,
+                                     false);
+    }
+    LogSnapshotTime("pickle", timer);
+  }
+  LogPerfResult("Histogram_Snapshot_pickle_bytes",
+                flattener.bytes() / kSnapshots, "bytes");
+
+  // The records are written as the child would write them, without
+  // registering the histograms in this process, where the browser's are.
+  scoped_ptr<HistogramSharedMemory> segment(
+      HistogramSharedMemory::Create(1024 * 1024));
+  ASSERT_TRUE(segment.get());
+  ScopedVector<SampleVector> shared;
+  for (size_t i = 0; i < pickled.size(); ++i) {
+    uint32 record = 0;
+    scoped_ptr<SampleVector> samples = segment->AllocateSamples(
+        StringPrintf("Perf.Shared%d", static_cast<int>(i)), 1, 10000, 50,
+        pickled[i]->bucket_ranges(), &record);
+    ASSERT_TRUE(samples.get());
+    segment->Publish(record, HISTOGRAM, Histogram::kNoFlags);
+    shared.push_back(samples.release());
+  }
+  {
+    PerfTimer timer;
+    for (int snapshot = 0; snapshot < kSnapshots; ++snapshot) {
+      for (size_t i = 0; i < shared.size(); ++i)
+        shared[i]->Accumulate(snapshot * 7 + i, 1);
+      segment->MergeDeltas();
+    }
+    LogSnapshotTime("shared_memory", timer);
+  }
+  EXPECT_EQ(kSnapshots, StatisticsRecorder::FindHistogram("Perf.Shared0")->
+      SnapshotSamples()->TotalCount());
+}
+
+}  // namespace base
@@ -19,7 +19,35 @@ class SampleCountIterator;
 // HistogramSamples is a container storing all samples of a histogram.
 class BASE_EXPORT HistogramSamples {
  public:
+  // The sum and the redundant count of the samples. They are kept apart from
+  // the rest of the object so that they can live in shared memory next to the
+  // bucket counts of a SampleVector (see histogram_shared_memory.h).
+  struct Metadata {
+    Metadata() : sum(0), redundant_count(0) {}
+
+    // Samples are recorded from any thread without a lock, so |sum| is
+    // updated atomically where the CPU has 64-bit atomic operations.
+    // Elsewhere, it may lose concurrent updates.
+#if defined(ARCH_CPU_64_BITS)
+    subtle::Atomic64 sum;
+#else
+    int64 sum;
+#endif
+
+    // |redundant_count| helps identify memory corruption. It redundantly
+    // stores the total number of samples accumulated in the histogram. We can
+    // compare this count to the sum of the counts (TotalCount() function), and
+    // detect problems. Note, depending on the implementation of different
+    // histogram types, there might be races during histogram accumulation and
+    // snapshotting that we choose to accept. In this case, the tallies might
+    // mismatch even when no memory corruption has happened.
+    HistogramBase::AtomicCount redundant_count;
+  };
+
   HistogramSamples();
+  // Keeps the sum and the redundant count in |meta|, which must outlive this
+  // object.
+  explicit HistogramSamples(Metadata* meta);
   virtual ~HistogramSamples();
 
   virtual void Accumulate(HistogramBase::Sample value,
@@ -38,8 +66,10 @@ class BASE_EXPORT HistogramSamples {
   virtual bool Serialize(Pickle* pickle) const;
 
   // Accessor fuctions.
-  int64 sum() const { return sum_; }
-  HistogramBase::Count redundant_count() const { return redundant_count_; }
+  int64 sum() const;
+  HistogramBase::Count redundant_count() const {
+    return subtle::NoBarrier_Load(&meta_->redundant_count);
+  }
 
  protected:
   // Based on |op| type, add or subtract sample counts data from the iterator.
@@ -50,16 +80,12 @@ class BASE_EXPORT HistogramSamples {
   void IncreaseRedundantCount(HistogramBase::Count diff);
 
  private:
-  int64 sum_;
-
-  // |redundant_count_| helps identify memory corruption. It redundantly stores
-  // the total number of samples accumulated in the histogram. We can compare
-  // this count to the sum of the counts (TotalCount() function), and detect
-  // problems. Note, depending on the implementation of different histogram
-  // types, there might be races during histogram accumulation and snapshotting
-  // that we choose to accept. In this case, the tallies might mismatch even
-  // when no memory corruption has happened.
-  HistogramBase::Count redundant_count_;
+  Metadata local_meta_;
+
+  // Points to |local_meta_| unless the metadata is kept elsewhere.
+  Metadata* meta_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramSamples);
 };
 
 class BASE_EXPORT SampleCountIterator {
@@ -0,0 +1,346 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/histogram_shared_memory.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/sample_vector.h"
+#include "base/stl_util.h"
+
+using std::string;
+using std::vector;
+
+namespace base {
+
+typedef HistogramBase::AtomicCount AtomicCount;
+typedef HistogramBase::Count Count;
+typedef HistogramBase::Sample Sample;
+typedef HistogramSamples::Metadata Metadata;
+
+namespace {
+
+const uint32 kSegmentMagic = 0x48495354;  // "HIST"
+
+// Records longer than this are not allocated; their histograms keep their
+// samples on the heap.
+const size_t kMaxNameLength = 1024;
+
+// The states of a record.
+const subtle::Atomic32 kRecordAllocated = 0;
+const subtle::Atomic32 kRecordPublished = 1;
+
+// The segment starts with this header, which is followed by the records.
+struct SegmentHeader {
+  uint32 magic;
+
+  // The number of bytes of the segment in use, including this header.
+  subtle::Atomic32 used;
+};
+
+// Records, and everything in them, are 8 byte aligned.
+size_t Align(size_t size) {
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// A record starts with this header, which is followed by the metadata, the
+// bucket_count + 1 ranges, the bucket_count counts and the name.
+struct RecordHeader {
+  subtle::Atomic32 state;
+
+  // The size of the whole record. Written last when the record is allocated,
+  // so that the browser never sees the rest of the header half written.
+  subtle::Atomic32 size;
+
+  // Written when the record is published.
+  int32 type;
+  int32 flags;
+
+  int32 minimum;
+  int32 maximum;
+  uint32 bucket_count;
+  uint32 name_length;
+};
+
+// Where the parts of a record are, as offsets from its start.
+struct RecordLayout {
+  size_t meta;
+  size_t ranges;
+  size_t counts;
+  size_t name;
+  size_t size;
+};
+
+bool ComputeRecordLayout(size_t bucket_count,
+                         size_t name_length,
+                         RecordLayout* layout) {
+  if (bucket_count < 2 || bucket_count > Histogram::kBucketCount_MAX ||
+      name_length == 0 || name_length > kMaxNameLength) {
+    return false;
+  }
+  layout->meta = Align(sizeof(RecordHeader));
+  layout->ranges = layout->meta + Align(sizeof(Metadata));
+  layout->counts = layout->ranges + Align((bucket_count + 1) * sizeof(Sample));
+  layout->name = layout->counts + Align(bucket_count * sizeof(AtomicCount));
+  layout->size = layout->name + Align(name_length);
+  return true;
+}
+
+int64 LoadSum(const Metadata* meta) {
+#if defined(ARCH_CPU_64_BITS)
+  return subtle::NoBarrier_Load(&meta->sum);
+#else
+  return meta->sum;
+#endif
+}
+
+// The segment of this process. Set on the IO thread of a child, and read by
+// every thread creating a histogram.
+subtle::AtomicWord g_current_segment = 0;
+
+}  // namespace
+
+// What MergeDeltas() keeps for each record it has seen.
+struct HistogramSharedMemory::MergedRecord {
+  MergedRecord() : histogram(NULL), bucket_count(0) {}
+
+  // The histogram of this process the record is merged into, or NULL if the
+  // record is bad.
+  Histogram* histogram;
+
+  // Copied when the record is first seen; the child may change the header
+  // afterwards.
+  size_t bucket_count;
+  RecordLayout layout;
+
+  // The samples merged so far.
+  scoped_ptr<SampleVector> logged;
+};
+
+// static
+HistogramSharedMemory* HistogramSharedMemory::Create(size_t size) {
+  if (size < sizeof(SegmentHeader) || size > kint32max)
+    return NULL;
+  scoped_ptr<SharedMemory> memory(new SharedMemory());
+  if (!memory->CreateAndMapAnonymous(size))
+    return NULL;
+
+  // Fresh shared memory is zeroed, which is what unused records need.
+  SegmentHeader* header = static_cast<SegmentHeader*>(memory->memory());
+  header->magic = kSegmentMagic;
+  subtle::Release_Store(&header->used, sizeof(SegmentHeader));
+  return new HistogramSharedMemory(memory.release(), size);
+}
+
+// static
+HistogramSharedMemory* HistogramSharedMemory::Attach(SharedMemoryHandle handle,
+                                                     size_t size) {
+  scoped_ptr<SharedMemory> memory(new SharedMemory(handle, false));
+  if (size < sizeof(SegmentHeader) || size > kint32max || !memory->Map(size))
+    return NULL;
+  SegmentHeader* header = static_cast<SegmentHeader*>(memory->memory());
+  if (header->magic != kSegmentMagic)
+    return NULL;
+  return new HistogramSharedMemory(memory.release(), size);
+}
+
+HistogramSharedMemory::HistogramSharedMemory(SharedMemory* memory, size_t size)
+    : memory_(memory),
+      size_(size) {
+}
+
+HistogramSharedMemory::~HistogramSharedMemory() {
+  STLDeleteValues(&merged_records_);
+}
+
+// static
+void HistogramSharedMemory::SetForCurrentProcess(
+    HistogramSharedMemory* segment) {
+  subtle::Release_Store(&g_current_segment,
+                        reinterpret_cast<subtle::AtomicWord>(segment));
+}
+
+// static
+HistogramSharedMemory* HistogramSharedMemory::GetForCurrentProcess() {
+  return reinterpret_cast<HistogramSharedMemory*>(
+      subtle::Acquire_Load(&g_current_segment));
+}
+
+bool HistogramSharedMemory::ShareToProcess(ProcessHandle process,
+                                           SharedMemoryHandle* new_handle) {
+  return memory_->ShareToProcess(process, new_handle);
+}
+
+uint32 HistogramSharedMemory::Allocate(uint32 size) {
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(base());
+  while (true) {
+    subtle::Atomic32 used = subtle::NoBarrier_Load(&header->used);
+    if (size > size_ - used)
+      return 0;
+    if (subtle::NoBarrier_CompareAndSwap(&header->used, used, used + size) ==
+        used) {
+      return used;
+    }
+  }
+}
+
+scoped_ptr<SampleVector> HistogramSharedMemory::AllocateSamples(
+    const string& name,
+    Sample minimum,
+    Sample maximum,
+    size_t bucket_count,
+    const BucketRanges* ranges,
+    uint32* record) {
+  DCHECK_EQ(bucket_count + 1, ranges->size());
+  RecordLayout layout;
+  uint32 offset = 0;
+  if (ComputeRecordLayout(bucket_count, name.size(), &layout))
+    offset = Allocate(layout.size);
+  if (!offset)
+    return scoped_ptr<SampleVector>();
+
+  char* start = base() + offset;
+  RecordHeader* header = reinterpret_cast<RecordHeader*>(start);
+  header->minimum = minimum;
+  header->maximum = maximum;
+  header->bucket_count = bucket_count;
+  header->name_length = name.size();
+  Sample* record_ranges = reinterpret_cast<Sample*>(start + layout.ranges);
+  for (size_t i = 0; i < ranges->size(); ++i)
+    record_ranges[i] = ranges->range(i);
+  memcpy(start + layout.name, name.data(), name.size());
+  subtle::Release_Store(&header->size, layout.size);
+
+  *record = offset;
+  return scoped_ptr<SampleVector>(new SampleVector(
+      ranges,
+      reinterpret_cast<AtomicCount*>(start + layout.counts),
+      reinterpret_cast<Metadata*>(start + layout.meta)));
+}
+
+void HistogramSharedMemory::Publish(uint32 record,
+                                    HistogramType type,
+                                    int32 flags) {
+  RecordHeader* header = reinterpret_cast<RecordHeader*>(base() + record);
+  DCHECK_EQ(kRecordAllocated, subtle::NoBarrier_Load(&header->state));
+  header->type = type;
+  header->flags = flags;
+  subtle::Release_Store(&header->state, kRecordPublished);
+}
+
+void HistogramSharedMemory::MergeDeltas() {
+  SegmentHeader* segment = reinterpret_cast<SegmentHeader*>(base());
+  size_t used = static_cast<uint32>(subtle::Acquire_Load(&segment->used));
+  used = std::min(used, size_);
+
+  size_t offset = sizeof(SegmentHeader);
+  if (used < offset) {
+    DLOG(ERROR) << "Bad histogram segment size " << used;
+    return;
+  }
+  while (used - offset >= sizeof(RecordHeader)) {
+    RecordHeader* header = reinterpret_cast<RecordHeader*>(base() + offset);
+    size_t size = static_cast<uint32>(subtle::Acquire_Load(&header->size));
+    // A record which is still being written ends the walk until next time, as
+    // does a bad size.
+    if (size < sizeof(RecordHeader) || size != Align(size) ||
+        size > used - offset) {
+      break;
+    }
+
+    MergedRecord* record = NULL;
+    MergedRecordMap::iterator it = merged_records_.find(offset);
+    if (it != merged_records_.end()) {
+      record = it->second;
+    } else if (subtle::Acquire_Load(&header->state) == kRecordPublished) {
+      record = CreateMergedRecord(offset, size);
+      merged_records_[offset] = record;
+    }
+    if (record && record->histogram)
+      MergeRecord(offset, record);
+    offset += size;
+  }
+}
+
+HistogramSharedMemory::MergedRecord* HistogramSharedMemory::CreateMergedRecord(
+    uint32 offset,
+    size_t size) {
+  const char* start = base() + offset;
+  const RecordHeader* header = reinterpret_cast<const RecordHeader*>(start);
+  scoped_ptr<MergedRecord> record(new MergedRecord);
+
+  // The child can change the header at any time, so it is read once.
+  int32 type = header->type;
+  int32 flags = header->flags;
+  Sample minimum = header->minimum;
+  Sample maximum = header->maximum;
+  size_t bucket_count = header->bucket_count;
+  size_t name_length = header->name_length;
+  if (!ComputeRecordLayout(bucket_count, name_length, &record->layout) ||
+      record->layout.size != size) {
+    DLOG(ERROR) << "Bad histogram record at " << offset;
+    return record.release();
+  }
+  record->bucket_count = bucket_count;
+
+  string name(start + record->layout.name, name_length);
+  const Sample* record_ranges =
+      reinterpret_cast<const Sample*>(start + record->layout.ranges);
+  vector<Sample> ranges(record_ranges, record_ranges + bucket_count + 1);
+
+  // Like the pickled ranges of a CustomHistogram, the custom ranges leave out
+  // the final kSampleType_MAX.
+  vector<Sample> custom_ranges(ranges.begin(), ranges.end() - 1);
+  Histogram* histogram = Histogram::FactoryGetFromChildArguments(
+      name, type, minimum, maximum, bucket_count, flags, custom_ranges);
+  if (!histogram)
+    return record.release();
+
+  // Counts recorded against other ranges would land in the wrong buckets.
+  const BucketRanges* bucket_ranges = histogram->bucket_ranges();
+  if (bucket_ranges->size() != ranges.size())
+    return record.release();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (bucket_ranges->range(i) != ranges[i]) {
+      DLOG(ERROR) << "Ranges mismatch in histogram record: " << name;
+      return record.release();
+    }
+  }
+
+  record->histogram = histogram;
+  record->logged.reset(new SampleVector(bucket_ranges));
+  return record.release();
+}
+
+void HistogramSharedMemory::MergeRecord(uint32 offset, MergedRecord* record) {
+  const char* start = base() + offset;
+  const AtomicCount* record_counts =
+      reinterpret_cast<const AtomicCount*>(start + record->layout.counts);
+  const Metadata* record_meta =
+      reinterpret_cast<const Metadata*>(start + record->layout.meta);
+
+  // Snapshot the record, then take away what was merged before.
+  vector<AtomicCount> counts(record->bucket_count);
+  for (size_t i = 0; i < counts.size(); ++i)
+    counts[i] = subtle::NoBarrier_Load(&record_counts[i]);
+  Metadata meta;
+  meta.sum = LoadSum(record_meta);
+  meta.redundant_count = subtle::NoBarrier_Load(&record_meta->redundant_count);
+
+  SampleVector delta(record->histogram->bucket_ranges(), &counts[0], &meta);
+  delta.Subtract(*record->logged);
+  if (delta.TotalCount() == 0 && delta.redundant_count() == 0)
+    return;
+  record->histogram->AddSamples(delta);
+  record->logged->Add(delta);
+}
+
+}  // namespace base
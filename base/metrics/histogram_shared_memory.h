@@ -0,0 +1,125 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// HistogramSharedMemory is a segment of shared memory in which a child process
+// records the samples of its histograms, so that the browser can read them
+// when it takes a snapshot, without the child serializing them and sending
+// them over IPC.
+//
+// The browser creates a segment for each child and shares it with the child,
+// which makes it the segment of the process with SetForCurrentProcess(). From
+// then on, every histogram the child registers with the StatisticsRecorder
+// gets a record in the segment which holds its bucket counts, sum and
+// redundant count, along with what the browser needs to create the same
+// histogram: its name, type, flags and ranges. Histograms registered before
+// the segment was attached, or after it filled up, keep their samples on the
+// heap and are sent over IPC as before.
+//
+// The browser calls MergeDeltas() when it takes a snapshot, which adds what
+// was recorded since the previous call into the browser's histograms of the
+// same names. A child can write anything into the segment, so everything the
+// browser reads from it is checked first, and a bad record only ever costs
+// the histogram it describes.
+
+#ifndef BASE_METRICS_HISTOGRAM_SHARED_MEMORY_H_
+#define BASE_METRICS_HISTOGRAM_SHARED_MEMORY_H_
+
+#include <map>
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram_base.h"
+#include "base/process.h"
+#include "base/shared_memory.h"
+
+namespace base {
+
+class BucketRanges;
+class Histogram;
+class SampleVector;
+
+class BASE_EXPORT HistogramSharedMemory {
+ public:
+  // Creates and maps a new, empty segment of |size| bytes, in the browser.
+  // Returns NULL on failure.
+  static HistogramSharedMemory* Create(size_t size);
+
+  // Maps the segment of |size| bytes the browser shared as |handle|, in the
+  // child. Returns NULL if it can't be mapped or isn't a segment.
+  static HistogramSharedMemory* Attach(SharedMemoryHandle handle, size_t size);
+
+  ~HistogramSharedMemory();
+
+  // Makes |segment| the segment the histograms of this process are created
+  // in, or stops using one if it is NULL. The segment must outlive the
+  // histograms created in it, which are leaked, so the segment is in practice
+  // leaked as well.
+  static void SetForCurrentProcess(HistogramSharedMemory* segment);
+  static HistogramSharedMemory* GetForCurrentProcess();
+
+  // Shares the segment with |process|, which then attaches to it with
+  // Attach(). Returns false on failure.
+  bool ShareToProcess(ProcessHandle process, SharedMemoryHandle* new_handle);
+
+  size_t size() const { return size_; }
+
+  // Child side.
+
+  // Allocates a record for the samples of a histogram with the given
+  // construction arguments, and returns a SampleVector which keeps its
+  // samples in it. Sets |*record| to the record, for Publish(). Returns NULL
+  // when the segment is full. Can be called from any thread.
+  scoped_ptr<SampleVector> AllocateSamples(const std::string& name,
+                                           HistogramBase::Sample minimum,
+                                           HistogramBase::Sample maximum,
+                                           size_t bucket_count,
+                                           const BucketRanges* ranges,
+                                           uint32* record);
+
+  // Makes |record| visible to the browser, as a histogram of type |type| with
+  // |flags|.
+  void Publish(uint32 record, HistogramType type, int32 flags);
+
+  // Browser side.
+
+  // Adds the samples recorded in the segment since the last call to the
+  // histograms of this process with the same names, creating them if needed.
+  // Must not be called concurrently with itself.
+  void MergeDeltas();
+
+ private:
+  struct MergedRecord;
+  typedef std::map<uint32, MergedRecord*> MergedRecordMap;
+
+  HistogramSharedMemory(SharedMemory* memory, size_t size);
+
+  char* base() const { return static_cast<char*>(memory_->memory()); }
+
+  // Reserves |size| bytes in the segment and returns their offset, or 0 if
+  // there isn't room left.
+  uint32 Allocate(uint32 size);
+
+  // Checks the published record at |offset| and creates the histogram it
+  // describes. Returns NULL if the record is bad.
+  MergedRecord* CreateMergedRecord(uint32 offset, size_t size);
+
+  // Adds what was recorded in the record at |offset| since the last merge to
+  // its histogram.
+  void MergeRecord(uint32 offset, MergedRecord* record);
+
+  scoped_ptr<SharedMemory> memory_;
+  size_t size_;
+
+  // The records MergeDeltas() has seen, by offset. Bad records are kept, with
+  // no histogram, so they are only checked once.
+  MergedRecordMap merged_records_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramSharedMemory);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_HISTOGRAM_SHARED_MEMORY_H_
@@ -0,0 +1,286 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_shared_memory.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/process_util.h"
+#include "base/shared_memory.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const size_t kSegmentSize = 64 * 1024;
+
+}  // namespace
+
+// Both sides live in this process, so each has its own StatisticsRecorder: the
+// child histograms are registered with one, and merged into the histograms of
+// the other.
+class HistogramSharedMemoryTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    browser_segment_.reset(HistogramSharedMemory::Create(kSegmentSize));
+    ASSERT_TRUE(browser_segment_.get());
+    SharedMemoryHandle handle;
+    ASSERT_TRUE(browser_segment_->ShareToProcess(GetCurrentProcessHandle(),
+                                                 &handle));
+    child_segment_.reset(HistogramSharedMemory::Attach(handle, kSegmentSize));
+    ASSERT_TRUE(child_segment_.get());
+
+    InitializeStatisticsRecorder();
+    HistogramSharedMemory::SetForCurrentProcess(child_segment_.get());
+  }
+
+  virtual void TearDown() {
+    HistogramSharedMemory::SetForCurrentProcess(NULL);
+    UninitializeStatisticsRecorder();
+  }
+
+  void InitializeStatisticsRecorder() {
+    statistics_recorder_ = new StatisticsRecorder();
+  }
+
+  void UninitializeStatisticsRecorder() {
+    delete statistics_recorder_;
+    statistics_recorder_ = NULL;
+  }
+
+  // Leaves the child histograms and starts the browser ones.
+  void SwitchToBrowser() {
+    HistogramSharedMemory::SetForCurrentProcess(NULL);
+    UninitializeStatisticsRecorder();
+    InitializeStatisticsRecorder();
+  }
+
+  // Returns a mapping of the segment of its own, to corrupt it with.
+  SharedMemory* MapSegment() {
+    SharedMemoryHandle handle;
+    EXPECT_TRUE(browser_segment_->ShareToProcess(GetCurrentProcessHandle(),
+                                                 &handle));
+    SharedMemory* memory = new SharedMemory(handle, false);
+    EXPECT_TRUE(memory->Map(kSegmentSize));
+    return memory;
+  }
+
+  scoped_ptr<HistogramSharedMemory> browser_segment_;
+  scoped_ptr<HistogramSharedMemory> child_segment_;
+  StatisticsRecorder* statistics_recorder_;
+};
+
+TEST_F(HistogramSharedMemoryTest, MergesEveryType) {
+  Histogram* histogram =
+      Histogram::FactoryGet("Test.Exponential", 1, 1000, 10,
+                            Histogram::kUmaTargetedHistogramFlag);
+  Histogram* linear =
+      LinearHistogram::FactoryGet("Test.Linear", 1, 100, 20,
+                                  Histogram::kNoFlags);
+  Histogram* boolean =
+      BooleanHistogram::FactoryGet("Test.Boolean", Histogram::kNoFlags);
+  std::vector<HistogramBase::Sample> custom_ranges;
+  custom_ranges.push_back(5);
+  custom_ranges.push_back(50);
+  custom_ranges.push_back(500);
+  Histogram* custom =
+      CustomHistogram::FactoryGet("Test.Custom", custom_ranges,
+                                  Histogram::kNoFlags);
+  EXPECT_TRUE(histogram->samples_in_shared_memory());
+  EXPECT_TRUE(linear->samples_in_shared_memory());
+  EXPECT_TRUE(boolean->samples_in_shared_memory());
+  EXPECT_TRUE(custom->samples_in_shared_memory());
+
+  histogram->Add(3);
+  histogram->Add(300);
+  linear->Add(42);
+  boolean->AddBoolean(true);
+  custom->Add(70);
+  custom->Add(70);
+
+  SwitchToBrowser();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Exponential"));
+  browser_segment_->MergeDeltas();
+
+  Histogram* merged = StatisticsRecorder::FindHistogram("Test.Exponential");
+  ASSERT_TRUE(merged);
+  EXPECT_NE(histogram, merged);
+  EXPECT_FALSE(merged->samples_in_shared_memory());
+  EXPECT_EQ(HISTOGRAM, merged->GetHistogramType());
+  EXPECT_TRUE(merged->flags() & Histogram::kUmaTargetedHistogramFlag);
+  scoped_ptr<HistogramSamples> samples = merged->SnapshotSamples();
+  EXPECT_EQ(2, samples->TotalCount());
+  EXPECT_EQ(2, samples->redundant_count());
+  EXPECT_EQ(303, samples->sum());
+  EXPECT_EQ(1, samples->GetCount(300));
+
+  merged = StatisticsRecorder::FindHistogram("Test.Linear");
+  ASSERT_TRUE(merged);
+  EXPECT_EQ(LINEAR_HISTOGRAM, merged->GetHistogramType());
+  EXPECT_EQ(1, merged->SnapshotSamples()->GetCount(42));
+
+  merged = StatisticsRecorder::FindHistogram("Test.Boolean");
+  ASSERT_TRUE(merged);
+  EXPECT_EQ(BOOLEAN_HISTOGRAM, merged->GetHistogramType());
+  EXPECT_EQ(1, merged->SnapshotSamples()->GetCount(1));
+
+  merged = StatisticsRecorder::FindHistogram("Test.Custom");
+  ASSERT_TRUE(merged);
+  EXPECT_EQ(CUSTOM_HISTOGRAM, merged->GetHistogramType());
+  EXPECT_EQ(2, merged->SnapshotSamples()->GetCount(70));
+}
+
+TEST_F(HistogramSharedMemoryTest, MergesOnlyDeltas) {
+  Histogram* histogram =
+      Histogram::FactoryGet("Test.Deltas", 1, 1000, 10, Histogram::kNoFlags);
+  histogram->Add(10);
+
+  SwitchToBrowser();
+  browser_segment_->MergeDeltas();
+  Histogram* merged = StatisticsRecorder::FindHistogram("Test.Deltas");
+  ASSERT_TRUE(merged);
+  EXPECT_EQ(1, merged->SnapshotSamples()->TotalCount());
+
+  // Nothing new.
+  browser_segment_->MergeDeltas();
+  EXPECT_EQ(1, merged->SnapshotSamples()->TotalCount());
+
+  // The child keeps recording after the browser has read the record.
+  histogram->Add(10);
+  histogram->Add(500);
+  browser_segment_->MergeDeltas();
+  scoped_ptr<HistogramSamples> samples = merged->SnapshotSamples();
+  EXPECT_EQ(3, samples->TotalCount());
+  EXPECT_EQ(520, samples->sum());
+  EXPECT_EQ(2, samples->GetCount(10));
+}
+
+TEST_F(HistogramSharedMemoryTest, FallsBackToHeapWhenFull) {
+  // Too many buckets for the segment.
+  Histogram* large =
+      LinearHistogram::FactoryGet("Test.Large", 1, 10000, 10000,
+                                  Histogram::kNoFlags);
+  EXPECT_FALSE(large->samples_in_shared_memory());
+  large->Add(5);
+  EXPECT_EQ(1, large->SnapshotSamples()->GetCount(5));
+
+  Histogram* small =
+      Histogram::FactoryGet("Test.Small", 1, 1000, 10, Histogram::kNoFlags);
+  EXPECT_TRUE(small->samples_in_shared_memory());
+}
+
+TEST_F(HistogramSharedMemoryTest, OnlyRegisteredHistogramsTakeRecords) {
+  scoped_ptr<SharedMemory> memory(MapSegment());
+  // The bytes in use are the second field of the segment header.
+  const int32* used =
+      reinterpret_cast<const int32*>(static_cast<char*>(memory->memory())) + 1;
+  const int32 used_before = *used;
+
+  UninitializeStatisticsRecorder();
+  Histogram* unregistered =
+      Histogram::FactoryGet("Test.Unregistered", 1, 1000, 10,
+                            Histogram::kNoFlags);
+  EXPECT_FALSE(unregistered->samples_in_shared_memory());
+  unregistered->Add(1);
+  EXPECT_EQ(used_before, *used);
+
+  InitializeStatisticsRecorder();
+  Histogram* registered =
+      Histogram::FactoryGet("Test.Registered", 1, 1000, 10,
+                            Histogram::kNoFlags);
+  EXPECT_TRUE(registered->samples_in_shared_memory());
+  EXPECT_LT(used_before, *used);
+
+  SwitchToBrowser();
+  browser_segment_->MergeDeltas();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Unregistered"));
+  EXPECT_TRUE(StatisticsRecorder::FindHistogram("Test.Registered"));
+}
+
+TEST_F(HistogramSharedMemoryTest, SkipsBadRecords) {
+  // The first record is corrupted below, and the second is good.
+  Histogram* corrupted =
+      Histogram::FactoryGet("Test.Corrupted", 1, 1000, 10, Histogram::kNoFlags);
+  corrupted->Add(1);
+  Histogram* good =
+      Histogram::FactoryGet("Test.Good", 1, 1000, 10, Histogram::kNoFlags);
+  good->Add(1);
+
+  // Claim far more buckets than the record holds. The first record starts
+  // right after the 8 byte segment header, and its bucket count is the seventh
+  // field of the record header.
+  scoped_ptr<SharedMemory> memory(MapSegment());
+  uint32* bucket_count =
+      reinterpret_cast<uint32*>(static_cast<char*>(memory->memory()) + 8) + 6;
+  ASSERT_EQ(10u, *bucket_count);
+  *bucket_count = 5000;
+
+  SwitchToBrowser();
+  browser_segment_->MergeDeltas();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Corrupted"));
+  Histogram* merged = StatisticsRecorder::FindHistogram("Test.Good");
+  ASSERT_TRUE(merged);
+  EXPECT_EQ(1, merged->SnapshotSamples()->TotalCount());
+}
+
+TEST_F(HistogramSharedMemoryTest, SkipsBadSizes) {
+  Histogram* histogram =
+      Histogram::FactoryGet("Test.Sizes", 1, 1000, 10, Histogram::kNoFlags);
+  histogram->Add(1);
+  SwitchToBrowser();
+
+  // The bytes in use are the second field of the segment header, and the
+  // size of the first record, right after it, is the second field of the
+  // record header.
+  scoped_ptr<SharedMemory> memory(MapSegment());
+  int32* used = reinterpret_cast<int32*>(memory->memory()) + 1;
+  int32* record_size =
+      reinterpret_cast<int32*>(static_cast<char*>(memory->memory()) + 8) + 1;
+  const int32 good_used = *used;
+  const int32 good_record_size = *record_size;
+
+  // Less than the segment header.
+  *used = 4;
+  browser_segment_->MergeDeltas();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Sizes"));
+
+  // Past the end of the segment.
+  *used = good_used;
+  *record_size = kint32max & ~7;
+  browser_segment_->MergeDeltas();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Sizes"));
+
+  // Past the bytes in use.
+  *record_size = good_used;
+  browser_segment_->MergeDeltas();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Sizes"));
+
+  // Too small to hold the record header.
+  *record_size = 0;
+  browser_segment_->MergeDeltas();
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Test.Sizes"));
+
+  // Nothing bad was remembered about the record, which merges once it is
+  // whole.
+  *record_size = good_record_size;
+  browser_segment_->MergeDeltas();
+  Histogram* merged = StatisticsRecorder::FindHistogram("Test.Sizes");
+  ASSERT_TRUE(merged);
+  EXPECT_EQ(1, merged->SnapshotSamples()->TotalCount());
+}
+
+TEST_F(HistogramSharedMemoryTest, AttachRejectsOtherMemory) {
+  SharedMemory memory;
+  ASSERT_TRUE(memory.CreateAndMapAnonymous(kSegmentSize));
+  SharedMemoryHandle handle;
+  ASSERT_TRUE(memory.ShareToProcess(GetCurrentProcessHandle(), &handle));
+  scoped_ptr<HistogramSharedMemory> segment(
+      HistogramSharedMemory::Attach(handle, kSegmentSize));
+  EXPECT_FALSE(segment.get());
+}
+
+}  // namespace base
@@ -33,6 +33,9 @@ void HistogramSnapshotManager::PrepareDeltas(Histogram::Flags flag_to_set,
        histograms.end() != it;
        ++it) {
     (*it)->SetFlags(flag_to_set);
+    // The browser reads the samples kept in shared memory itself.
+    if ((*it)->samples_in_shared_memory())
+      continue;
     if (record_only_uma &&
         0 == ((*it)->flags() & Histogram::kUmaTargetedHistogramFlag))
       continue;
@@ -3,7 +3,8 @@
 // found in the LICENSE file.
 
 // SampleVector implements HistogramSamples interface. It is used by all
-// Histogram based classes to store samples.
+// Histogram based classes to store samples. Buckets are updated with atomic
+// increments, so samples may be accumulated from any thread without a lock.
 
 #ifndef BASE_METRICS_SAMPLE_VECTOR_H_
 #define BASE_METRICS_SAMPLE_VECTOR_H_
@@ -23,6 +24,12 @@ class BucketRanges;
 class BASE_EXPORT_PRIVATE SampleVector : public HistogramSamples {
  public:
   explicit SampleVector(const BucketRanges* bucket_ranges);
+  // Keeps the bucket counts in |counts|, which must have room for
+  // |bucket_ranges->size() - 1| of them, and the sum and the redundant count
+  // in |meta|. Both must outlive this object.
+  SampleVector(const BucketRanges* bucket_ranges,
+               HistogramBase::AtomicCount* counts,
+               Metadata* meta);
   virtual ~SampleVector();
 
   // HistogramSamples implementation:
@@ -46,7 +53,11 @@ class BASE_EXPORT_PRIVATE SampleVector : public HistogramSamples {
  private:
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptSampleCounts);
 
-  std::vector<HistogramBase::Count> counts_;
+  std::vector<HistogramBase::AtomicCount> local_counts_;
+
+  // Points into |local_counts_| unless the counts are kept elsewhere.
+  HistogramBase::AtomicCount* counts_;
+  size_t counts_size_;
 
   // Shares the same BucketRanges with Histogram object.
   const BucketRanges* const bucket_ranges_;
@@ -56,7 +67,10 @@ class BASE_EXPORT_PRIVATE SampleVector : public HistogramSamples {
 
 class BASE_EXPORT_PRIVATE SampleVectorIterator : public SampleCountIterator {
  public:
-  SampleVectorIterator(const std::vector<HistogramBase::Count>* counts,
+  SampleVectorIterator(const std::vector<HistogramBase::AtomicCount>* counts,
+                       const BucketRanges* bucket_ranges);
+  SampleVectorIterator(const HistogramBase::AtomicCount* counts,
+                       size_t counts_size,
                        const BucketRanges* bucket_ranges);
   virtual ~SampleVectorIterator();
 
@@ -73,7 +87,8 @@ class BASE_EXPORT_PRIVATE SampleVectorIterator : public SampleCountIterator {
  private:
   void SkipEmptyBuckets();
 
-  const std::vector<HistogramBase::Count>* counts_;
+  const HistogramBase::AtomicCount* counts_;
+  size_t counts_size_;
   const BucketRanges* bucket_ranges_;
 
   size_t index_;
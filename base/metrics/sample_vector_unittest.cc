@@ -8,6 +8,7 @@
 #include "base/metrics/bucket_ranges.h"
 #include "base/metrics/histogram.h"
 #include "base/metrics/sample_vector.h"
+#include "base/threading/simple_thread.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using std::vector;
@@ -15,6 +16,26 @@ using std::vector;
 namespace base {
 namespace {
 
+// Accumulates kIterations samples of every value in [1, 10) into |samples|.
+class SampleAccumulator : public DelegateSimpleThread::Delegate {
+ public:
+  static const int kIterations = 10000;
+
+  explicit SampleAccumulator(SampleVector* samples) : samples_(samples) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kIterations; ++i) {
+      for (int value = 1; value < 10; ++value)
+        samples_->Accumulate(value, 1);
+    }
+  }
+
+ private:
+  SampleVector* samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleAccumulator);
+};
+
 TEST(SampleVectorTest, AccumulateTest) {
   // Custom buckets: [1, 5) [5, 10)
   BucketRanges ranges(3);
@@ -42,6 +63,32 @@ TEST(SampleVectorTest, AccumulateTest) {
   EXPECT_EQ(samples.TotalCount(), samples.redundant_count());
 }
 
+TEST(SampleVectorTest, AccumulateFromManyThreads) {
+  // Custom buckets: [1, 5) [5, 10)
+  BucketRanges ranges(3);
+  ranges.set_range(0, 1);
+  ranges.set_range(1, 5);
+  ranges.set_range(2, 10);
+  SampleVector samples(&ranges);
+
+  const int kThreads = 4;
+  SampleAccumulator accumulator(&samples);
+  DelegateSimpleThreadPool pool("SampleAccumulator", kThreads);
+  pool.AddWork(&accumulator, kThreads);
+  pool.Start();
+  pool.JoinAll();
+
+  // No increment of a bucket is lost.
+  const int kPerValue = kThreads * SampleAccumulator::kIterations;
+  EXPECT_EQ(4 * kPerValue, samples.GetCountAtIndex(0));
+  EXPECT_EQ(5 * kPerValue, samples.GetCountAtIndex(1));
+  EXPECT_EQ(9 * kPerValue, samples.redundant_count());
+  EXPECT_EQ(samples.TotalCount(), samples.redundant_count());
+#if defined(ARCH_CPU_64_BITS)
+  EXPECT_EQ(45 * kPerValue, samples.sum());
+#endif
+}
+
 TEST(SampleVectorTest, AddSubtractTest) {
   // Custom buckets: [0, 1) [1, 2) [2, 3) [3, INT_MAX)
   BucketRanges ranges(5);
@@ -4,10 +4,14 @@
 
 #include "base/metrics/statistics_recorder.h"
 
+#include <algorithm>
+
 #include "base/debug/leak_annotations.h"
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
+#include "base/stl_util.h"
 #include "base/stringprintf.h"
 #include "base/synchronization/lock.h"
 
@@ -22,6 +26,100 @@ base::LazyInstance<base::StatisticsRecorder>::Leaky g_statistics_recorder_ =
 
 namespace base {
 
+// An open addressing hash table of histograms by name, which is only changed
+// with |lock_| held but is read without it. A histogram is stored in its slot
+// with a release store, and a table which has grown is published the same way
+// once it holds every histogram. Replaced tables are kept for as long as the
+// index, since readers may still be probing them.
+class StatisticsRecorder::HistogramIndex {
+ public:
+  HistogramIndex() : size_(0), table_(0) {
+    Publish(new Table(kInitialCapacity));
+  }
+
+  ~HistogramIndex() {
+    STLDeleteElements(&tables_);
+  }
+
+  Histogram* Find(const std::string& name) const {
+    const Table* table =
+        reinterpret_cast<const Table*>(subtle::Acquire_Load(&table_));
+    size_t mask = table->capacity - 1;
+    // Tables are never more than half full, so this finds an empty slot.
+    for (size_t i = Hash(name) & mask; ; i = (i + 1) & mask) {
+      Histogram* histogram = reinterpret_cast<Histogram*>(
+          subtle::Acquire_Load(&table->slots[i]));
+      if (!histogram)
+        return NULL;
+      if (histogram->histogram_name() == name)
+        return histogram;
+    }
+  }
+
+  // Adds |histogram|, which must not be in the index yet. Requires |lock_|.
+  void Insert(Histogram* histogram) {
+    Table* table = tables_.back();
+    if ((size_ + 1) * 2 > table->capacity) {
+      Table* grown = new Table(table->capacity * 2);
+      for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->slots[i])
+          InsertInto(grown, reinterpret_cast<Histogram*>(table->slots[i]));
+      }
+      Publish(grown);
+      table = grown;
+    }
+    InsertInto(table, histogram);
+    ++size_;
+  }
+
+  // Removes every histogram. Requires |lock_|.
+  void Clear() {
+    size_ = 0;
+    Publish(new Table(kInitialCapacity));
+  }
+
+ private:
+  // Enough for the histograms a renderer registers.
+  static const size_t kInitialCapacity = 256;
+
+  struct Table {
+    // |capacity| must be a power of two.
+    explicit Table(size_t capacity)
+        : capacity(capacity),
+          slots(new subtle::AtomicWord[capacity]) {
+      std::fill(slots.get(), slots.get() + capacity, 0);
+    }
+
+    const size_t capacity;
+    scoped_array<subtle::AtomicWord> slots;
+  };
+
+  // Makes |table| the one readers use.
+  void Publish(Table* table) {
+    tables_.push_back(table);
+    subtle::Release_Store(&table_, reinterpret_cast<subtle::AtomicWord>(table));
+  }
+
+  static void InsertInto(Table* table, Histogram* histogram) {
+    size_t mask = table->capacity - 1;
+    size_t i = Hash(histogram->histogram_name()) & mask;
+    while (table->slots[i])
+      i = (i + 1) & mask;
+    subtle::Release_Store(&table->slots[i],
+                          reinterpret_cast<subtle::AtomicWord>(histogram));
+  }
+
+  size_t size_;
+
+  // The Table* readers use.
+  subtle::AtomicWord table_;
+
+  // Every table this index has used, the current one last.
+  std::vector<Table*> tables_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramIndex);
+};
+
 // Collect the number of histograms created.
 static uint32 number_of_histograms_ = 0;
 // Collect the number of vectors saved because of caching ranges.
@@ -67,7 +165,12 @@ Histogram* StatisticsRecorder::RegisterOrDeleteDuplicate(Histogram* histogram) {
       const string& name = histogram->histogram_name();
       HistogramMap::iterator it = histograms_->find(name);
       if (histograms_->end() == it) {
+        // Only registered histograms are reported, so this is when their
+        // samples move to where the browser reads them. Nothing else can see
+        // |histogram| until it is in the index.
+        histogram->MoveSamplesToSharedMemory();
         (*histograms_)[name] = histogram;
+        reinterpret_cast<HistogramIndex*>(index_)->Insert(histogram);
         ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
         ++number_of_histograms_;
         histogram_to_return = histogram;
@@ -256,16 +359,13 @@ void StatisticsRecorder::GetBucketRanges(
 
 // static
 Histogram* StatisticsRecorder::FindHistogram(const std::string& name) {
-  if (lock_ == NULL)
-    return NULL;
-  base::AutoLock auto_lock(*lock_);
-  if (histograms_ == NULL)
+  // Histograms are looked up far more often than they are registered, so this
+  // does not take |lock_|.
+  const HistogramIndex* index =
+      reinterpret_cast<const HistogramIndex*>(subtle::Acquire_Load(&index_));
+  if (index == NULL)
     return NULL;
-
-  HistogramMap::iterator it = histograms_->find(name);
-  if (histograms_->end() == it)
-    return NULL;
-  return it->second;
+  return index->Find(name);
 }
 
 // private static
@@ -302,6 +402,12 @@ StatisticsRecorder::StatisticsRecorder() {
   base::AutoLock auto_lock(*lock_);
   histograms_ = new HistogramMap;
   ranges_ = new RangesMap;
+  if (!index_) {
+    // Leaked for the same reason as |lock_|: FindHistogram() may be probing
+    // it while the recorder is destroyed.
+    subtle::Release_Store(
+        &index_, reinterpret_cast<subtle::AtomicWord>(new HistogramIndex));
+  }
 }
 
 StatisticsRecorder::~StatisticsRecorder() {
@@ -321,6 +427,7 @@ StatisticsRecorder::~StatisticsRecorder() {
     base::AutoLock auto_lock(*lock_);
     histograms_deleter.reset(histograms_);
     ranges_deleter.reset(ranges_);
+    reinterpret_cast<HistogramIndex*>(index_)->Clear();
     histograms_ = NULL;
     ranges_ = NULL;
   }
@@ -335,6 +442,8 @@ StatisticsRecorder::RangesMap* StatisticsRecorder::ranges_ = NULL;
 // static
 base::Lock* StatisticsRecorder::lock_ = NULL;
 // static
+subtle::AtomicWord StatisticsRecorder::index_ = 0;
+// static
 bool StatisticsRecorder::dump_on_exit_ = false;
 
 }  // namespace base
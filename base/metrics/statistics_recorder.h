@@ -15,6 +15,7 @@
 #include <string>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
@@ -67,7 +68,8 @@ class BASE_EXPORT StatisticsRecorder {
   static void GetBucketRanges(std::vector<const BucketRanges*>* output);
 
   // Find a histogram by name. It matches the exact name. This method is thread
-  // safe.  It returns NULL if a matching histogram is not found.
+  // safe, and does not take a lock.  It returns NULL if a matching histogram is
+  // not found.
   static Histogram* FindHistogram(const std::string& name);
 
   static bool dump_on_exit() { return dump_on_exit_; }
@@ -81,6 +83,8 @@ class BASE_EXPORT StatisticsRecorder {
   static void GetSnapshot(const std::string& query, Histograms* snapshot);
 
  private:
+  class HistogramIndex;
+
   // We keep all registered histograms in a map, from name to histogram.
   typedef std::map<std::string, Histogram*> HistogramMap;
 
@@ -90,6 +94,7 @@ class BASE_EXPORT StatisticsRecorder {
   typedef std::map<uint32, std::list<const BucketRanges*>*> RangesMap;
 
   friend struct DefaultLazyInstanceTraits<StatisticsRecorder>;
+  friend class HistogramSharedMemoryTest;
   friend class HistogramTest;
   friend class StatisticsRecorderTest;
 
@@ -105,6 +110,12 @@ class BASE_EXPORT StatisticsRecorder {
   // Lock protects access to above maps.
   static base::Lock* lock_;
 
+  // The HistogramIndex* FindHistogram() looks histograms up in without taking
+  // |lock_|. It holds the same histograms as |histograms_|, and is only
+  // changed with |lock_| held. Like |lock_|, it is leaked so that it outlives
+  // any FindHistogram() call.
+  static subtle::AtomicWord index_;
+
   // Dump all known histograms to log.
   static bool dump_on_exit_;
 
@@ -7,6 +7,9 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
 #include "base/metrics/statistics_recorder.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -253,4 +256,67 @@ TEST_F(StatisticsRecorderTest, BucketRangesSharing) {
   EXPECT_FALSE(bucket_ranges1->Equals(bucket_ranges3));
 }
 
+TEST_F(StatisticsRecorderTest, FindHistogramAfterIndexGrows) {
+  // Enough histograms for the index to grow several times.
+  std::vector<Histogram*> histograms;
+  for (int i = 0; i < 2000; ++i) {
+    histograms.push_back(Histogram::FactoryGet(
+        StringPrintf("Histogram%d", i), 1, 64, 8, Histogram::kNoFlags));
+  }
+  for (int i = 0; i < 2000; ++i) {
+    EXPECT_EQ(histograms[i],
+              StatisticsRecorder::FindHistogram(
+                  StringPrintf("Histogram%d", i)));
+  }
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Histogram2000"));
+}
+
+namespace {
+
+// Looks |histogram| up by name, without a lock, until |done| is signaled.
+class HistogramFinder : public DelegateSimpleThread::Delegate {
+ public:
+  HistogramFinder(Histogram* histogram, WaitableEvent* done)
+      : histogram_(histogram),
+        done_(done),
+        misses_(0) {}
+
+  virtual void Run() OVERRIDE {
+    const std::string& name = histogram_->histogram_name();
+    while (!done_->IsSignaled()) {
+      if (StatisticsRecorder::FindHistogram(name) != histogram_)
+        ++misses_;
+    }
+  }
+
+  int misses() const { return misses_; }
+
+ private:
+  Histogram* histogram_;
+  WaitableEvent* done_;
+  int misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramFinder);
+};
+
+}  // namespace
+
+TEST_F(StatisticsRecorderTest, FindHistogramWhileRegistering) {
+  Histogram* histogram = Histogram::FactoryGet(
+      "FoundHistogram", 1, 64, 8, Histogram::kNoFlags);
+  WaitableEvent done(true, false);
+  HistogramFinder finder(histogram, &done);
+  DelegateSimpleThread thread(&finder, "HistogramFinder");
+  thread.Start();
+
+  // Lookups must keep finding the histogram while the index grows.
+  for (int i = 0; i < 2000; ++i) {
+    Histogram::FactoryGet(StringPrintf("Histogram%d", i), 1, 64, 8,
+                          Histogram::kNoFlags);
+  }
+  done.Signal();
+  thread.Join();
+  EXPECT_EQ(0, finder.misses());
+}
+
 }  // namespace base
@@ -95,14 +95,11 @@ bool PickleIterator::ReadFloat(float* result) {
 }
 
 bool PickleIterator::ReadString(std::string* result) {
-  int len;
-  if (!ReadInt(&len))
-    return false;
-  const char* read_from = GetReadPointerAndAdvance(len);
-  if (!read_from)
+  base::StringPiece piece;
+  if (!ReadStringPiece(&piece))
     return false;
 
-  result->assign(read_from, len);
+  piece.CopyToString(result);
   return true;
 }
 
@@ -119,14 +116,11 @@ bool PickleIterator::ReadWString(std::wstring* result) {
 }
 
 bool PickleIterator::ReadString16(string16* result) {
-  int len;
-  if (!ReadInt(&len))
-    return false;
-  const char* read_from = GetReadPointerAndAdvance(len, sizeof(char16));
-  if (!read_from)
+  base::StringPiece16 piece;
+  if (!ReadStringPiece16(&piece))
     return false;
 
-  result->assign(reinterpret_cast<const char16*>(read_from), len);
+  result->assign(piece.data(), piece.size());
   return true;
 }
 
@@ -148,6 +142,31 @@ bool PickleIterator::ReadBytes(const char** data, int length) {
   return true;
 }
 
+bool PickleIterator::ReadStringPiece(base::StringPiece* result) {
+  int len;
+  if (!ReadInt(&len))
+    return false;
+  const char* read_from = GetReadPointerAndAdvance(len);
+  if (!read_from)
+    return false;
+
+  result->set(read_from, len);
+  return true;
+}
+
+bool PickleIterator::ReadStringPiece16(base::StringPiece16* result) {
+  int len;
+  if (!ReadInt(&len))
+    return false;
+  const char* read_from = GetReadPointerAndAdvance(len, sizeof(char16));
+  if (!read_from)
+    return false;
+
+  *result = base::StringPiece16(reinterpret_cast<const char16*>(read_from),
+                                len);
+  return true;
+}
+
 // Payload is uint32 aligned.
 
 Pickle::Pickle()
@@ -228,10 +247,7 @@ Pickle& Pickle::operator=(const Pickle& other) {
 }
 
 bool Pickle::WriteString(const std::string& value) {
-  if (!WriteInt(static_cast<int>(value.size())))
-    return false;
-
-  return WriteBytes(value.data(), static_cast<int>(value.size()));
+  return WriteStringPiece(value);
 }
 
 bool Pickle::WriteWString(const std::wstring& value) {
@@ -243,15 +259,30 @@ bool Pickle::WriteWString(const std::wstring& value) {
 }
 
 bool Pickle::WriteString16(const string16& value) {
-  if (!WriteInt(static_cast<int>(value.size())))
+  return WriteStringPiece16(value);
+}
+
+bool Pickle::WriteStringPiece(const base::StringPiece& value) {
+  if (!Reserve(sizeof(int) + AlignInt(value.size(), sizeof(uint32))) ||
+      !WriteInt(static_cast<int>(value.size())))
     return false;
 
-  return WriteBytes(value.data(),
-                    static_cast<int>(value.size()) * sizeof(char16));
+  return WriteBytes(value.data(), static_cast<int>(value.size()));
+}
+
+bool Pickle::WriteStringPiece16(const base::StringPiece16& value) {
+  size_t num_bytes = value.size() * sizeof(char16);
+  if (!Reserve(sizeof(int) + AlignInt(num_bytes, sizeof(uint32))) ||
+      !WriteInt(static_cast<int>(value.size())))
+    return false;
+
+  return WriteBytes(value.data(), static_cast<int>(num_bytes));
 }
 
 bool Pickle::WriteData(const char* data, int length) {
-  return length >= 0 && WriteInt(length) && WriteBytes(data, length);
+  return length >= 0 &&
+      Reserve(sizeof(int) + AlignInt(length, sizeof(uint32))) &&
+      WriteInt(length) && WriteBytes(data, length);
 }
 
 bool Pickle::WriteBytes(const void* data, int data_len) {
@@ -267,6 +298,45 @@ bool Pickle::WriteBytes(const void* data, int data_len) {
   return true;
 }
 
+bool Pickle::WriteDataSegments(
+    const std::vector<base::StringPiece>& segments) {
+  DCHECK_NE(kCapacityReadOnly, capacity_) << "oops: pickle is readonly";
+
+  size_t length = 0;
+  for (size_t i = 0; i < segments.size(); ++i)
+    length += segments[i].size();
+  if (length > static_cast<size_t>(kint32max))
+    return false;
+
+  if (!Reserve(sizeof(int) + AlignInt(length, sizeof(uint32))) ||
+      !WriteInt(static_cast<int>(length)))
+    return false;
+
+  char* dest = BeginWrite(length);
+  if (!dest)
+    return false;
+
+  char* segment_dest = dest;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    memcpy(segment_dest, segments[i].data(), segments[i].size());
+    segment_dest += segments[i].size();
+  }
+
+  EndWrite(dest, static_cast<int>(length));
+  return true;
+}
+
+bool Pickle::Reserve(size_t additional_payload) {
+  DCHECK_NE(kCapacityReadOnly, capacity_) << "oops: pickle is readonly";
+
+  size_t needed_size = header_size_ +
+      AlignInt(header_->payload_size, sizeof(uint32)) + additional_payload;
+  if (needed_size < additional_payload)
+    return false;  // Overflow.
+  return needed_size <= capacity_ ||
+      Resize(std::max(capacity_ * 2, needed_size));
+}
+
 char* Pickle::BeginWriteData(int length) {
   DCHECK_EQ(variable_buffer_offset_, 0U) <<
     "There can only be one variable buffer in a Pickle";
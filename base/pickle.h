@@ -6,6 +6,7 @@
 #define BASE_PICKLE_H__
 
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
@@ -13,6 +14,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
 #include "base/string16.h"
+#include "base/string_piece.h"
 
 class Pickle;
 
@@ -41,6 +43,13 @@ class BASE_EXPORT PickleIterator {
   bool ReadData(const char** data, int* length) WARN_UNUSED_RESULT;
   bool ReadBytes(const char** data, int length) WARN_UNUSED_RESULT;
 
+  // Versions of ReadString() and ReadString16() that do not copy: |result|
+  // points into the Pickle's buffer, so it is only valid while the Pickle is
+  // alive and not written to. Since strings and "data" blobs are pickled the
+  // same way, these can also be used in place of ReadData().
+  bool ReadStringPiece(base::StringPiece* result) WARN_UNUSED_RESULT;
+  bool ReadStringPiece16(base::StringPiece16* result) WARN_UNUSED_RESULT;
+
   // Safer version of ReadInt() checks for the result not being negative.
   // Use it for reading the object sizes.
   bool ReadLength(int* result) WARN_UNUSED_RESULT {
@@ -228,6 +237,10 @@ class BASE_EXPORT Pickle {
   bool WriteString(const std::string& value);
   bool WriteWString(const std::wstring& value);
   bool WriteString16(const string16& value);
+  // Same as WriteString() and WriteString16(), for callers which do not have
+  // the string in a std::string or string16.
+  bool WriteStringPiece(const base::StringPiece& value);
+  bool WriteStringPiece16(const base::StringPiece16& value);
   // "Data" is a blob with a length. When you read it out you will be given the
   // length. See also WriteBytes.
   bool WriteData(const char* data, int length);
@@ -236,6 +249,18 @@ class BASE_EXPORT Pickle {
   // known size. See also WriteData.
   bool WriteBytes(const void* data, int data_len);
 
+  // Writes the concatenation of |segments| as a single "data" blob, copying
+  // each segment straight into the Pickle instead of into a temporary buffer
+  // first. Use ReadData or ReadStringPiece to get the data.
+  bool WriteDataSegments(const std::vector<base::StringPiece>& segments);
+
+  // Makes sure that |additional_payload| more bytes can be written without
+  // reallocating the Pickle's buffer. Callers which know roughly how much
+  // they are going to write should call this first: growing a large Pickle
+  // one write at a time reallocates (and copies) it several times. Each
+  // write may add up to three bytes of padding, which should be counted.
+  bool Reserve(size_t additional_payload);
+
   // Same as WriteData, but allows the caller to write directly into the
   // Pickle. This saves a copy in cases where the data is not already
   // available in a buffer. The caller should take care to not write more
@@ -343,6 +368,7 @@ class BASE_EXPORT Pickle {
   size_t variable_buffer_offset_;  // IF non-zero, then offset to a buffer.
 
   FRIEND_TEST_ALL_PREFIXES(PickleTest, Resize);
+  FRIEND_TEST_ALL_PREFIXES(PickleTest, Reserve);
   FRIEND_TEST_ALL_PREFIXES(PickleTest, FindNext);
   FRIEND_TEST_ALL_PREFIXES(PickleTest, FindNextWithIncompleteHeader);
 };
@@ -8,6 +8,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/string16.h"
+#include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace {
@@ -340,3 +341,97 @@ TEST(PickleTest, ReadBytes) {
   memcpy(&outdata, outdata_char, sizeof(outdata));
   EXPECT_EQ(data, outdata);
 }
+
+TEST(PickleTest, ReadStringPiece) {
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteString(teststr));
+  EXPECT_TRUE(pickle.WriteStringPiece(base::StringPiece("piece")));
+  EXPECT_TRUE(pickle.WriteString16(ASCIIToUTF16("wide")));
+  EXPECT_TRUE(pickle.WriteData(testdata, testdatalen));
+
+  PickleIterator iter(pickle);
+  base::StringPiece piece;
+  EXPECT_TRUE(iter.ReadStringPiece(&piece));
+  EXPECT_EQ(teststr, piece.as_string());
+  // The result points into the pickle instead of being a copy.
+  const char* payload = static_cast<const char*>(pickle.data());
+  EXPECT_GE(piece.data(), payload);
+  EXPECT_LT(piece.data(), payload + pickle.size());
+
+  EXPECT_TRUE(iter.ReadStringPiece(&piece));
+  EXPECT_EQ("piece", piece);
+
+  base::StringPiece16 piece16;
+  EXPECT_TRUE(iter.ReadStringPiece16(&piece16));
+  EXPECT_EQ(ASCIIToUTF16("wide"), piece16.as_string());
+
+  // Data blobs can be read as string pieces too.
+  EXPECT_TRUE(iter.ReadStringPiece(&piece));
+  EXPECT_EQ(std::string(testdata, testdatalen), piece.as_string());
+
+  EXPECT_FALSE(iter.ReadStringPiece(&piece));
+}
+
+TEST(PickleTest, ReadStringPieceEvilLengths) {
+  Pickle negative_len;
+  EXPECT_TRUE(negative_len.WriteInt(-1));
+  PickleIterator iter(negative_len);
+  base::StringPiece piece;
+  EXPECT_FALSE(iter.ReadStringPiece(&piece));
+
+  // (1<<31) * sizeof(char16) == 0, so this is particularly evil.
+  Pickle bad_len;
+  EXPECT_TRUE(bad_len.WriteInt(1 << 31));
+  iter = PickleIterator(bad_len);
+  base::StringPiece16 piece16;
+  EXPECT_FALSE(iter.ReadStringPiece16(&piece16));
+}
+
+TEST(PickleTest, WriteDataSegments) {
+  std::vector<base::StringPiece> segments;
+  segments.push_back(base::StringPiece("abc"));
+  segments.push_back(base::StringPiece());
+  segments.push_back(base::StringPiece(testdata, testdatalen));
+
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteDataSegments(segments));
+  EXPECT_TRUE(pickle.WriteDataSegments(std::vector<base::StringPiece>()));
+  EXPECT_TRUE(pickle.WriteInt(testint));
+
+  PickleIterator iter(pickle);
+  const char* outdata;
+  int outdatalen;
+  EXPECT_TRUE(pickle.ReadData(&iter, &outdata, &outdatalen));
+  EXPECT_EQ("abc" + std::string(testdata, testdatalen),
+            std::string(outdata, outdatalen));
+  EXPECT_TRUE(pickle.ReadData(&iter, &outdata, &outdatalen));
+  EXPECT_EQ(0, outdatalen);
+  int outint;
+  EXPECT_TRUE(pickle.ReadInt(&iter, &outint));
+  EXPECT_EQ(testint, outint);
+}
+
+TEST(PickleTest, Reserve) {
+  Pickle pickle;
+  const size_t kPayload = 10 * Pickle::kPayloadUnit;
+  EXPECT_TRUE(pickle.Reserve(kPayload));
+  size_t capacity = pickle.capacity();
+  EXPECT_GE(capacity, kPayload);
+
+  // Writes which fit in the reserved space do not grow the buffer.
+  std::string str(kPayload - 2 * sizeof(int), 'x');
+  EXPECT_TRUE(pickle.WriteInt(testint));
+  EXPECT_TRUE(pickle.WriteString(str));
+  EXPECT_EQ(capacity, pickle.capacity());
+
+  // Reserving space which is already there does nothing either.
+  EXPECT_TRUE(pickle.Reserve(0));
+  EXPECT_EQ(capacity, pickle.capacity());
+
+  PickleIterator iter(pickle);
+  int outint;
+  std::string outstr;
+  EXPECT_TRUE(pickle.ReadInt(&iter, &outint));
+  EXPECT_TRUE(pickle.ReadString(&iter, &outstr));
+  EXPECT_EQ(str, outstr);
+}
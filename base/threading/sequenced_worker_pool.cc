@@ -4,6 +4,7 @@
 
 #include "base/threading/sequenced_worker_pool.h"
 
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
@@ -15,8 +16,10 @@
 #include "base/compiler_specific.h"
 #include "base/critical_closure.h"
 #include "base/debug/trace_event.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/linked_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop_proxy.h"
 #include "base/metrics/histogram.h"
 #include "base/stl_util.h"
@@ -25,6 +28,7 @@
 #include "base/synchronization/lock.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/simple_thread.h"
+#include "base/threading/thread_local.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/time.h"
 #include "base/tracked_objects.h"
@@ -213,6 +217,81 @@ uint64 GetTaskTraceID(const SequencedTask& task,
          static_cast<uint64>(reinterpret_cast<intptr_t>(pool));
 }
 
+// WorkDeque ------------------------------------------------------------------
+// The runnable work owned by one worker thread in WORK_STEALING mode. The
+// owner takes work from the front and the other workers steal from the back.
+//
+// An entry with a nonzero |sequence_token_id| does not carry a task; it
+// stands for "run the next task of that sequence" (see SequenceShard).
+class WorkDeque {
+ public:
+  WorkDeque() : size_(0) {}
+
+  void Push(const SequencedTask& item) {
+    AutoLock lock(lock_);
+    items_.push_back(item);
+    subtle::NoBarrier_Store(&size_, static_cast<subtle::Atomic32>(
+        items_.size()));
+  }
+
+  // Called by the owning worker.
+  bool PopFront(SequencedTask* item) {
+    return Pop(true, item);
+  }
+
+  // Called by the other workers.
+  bool StealBack(SequencedTask* item) {
+    return Pop(false, item);
+  }
+
+  // Lets workers skip empty deques without taking their lock. The result may
+  // be stale unless the caller issued a memory barrier after the last change
+  // it needs to observe.
+  bool LooksEmpty() const {
+    return subtle::NoBarrier_Load(&size_) == 0;
+  }
+
+ private:
+  bool Pop(bool front, SequencedTask* item) {
+    if (LooksEmpty())
+      return false;
+    AutoLock lock(lock_);
+    if (items_.empty())
+      return false;
+    // The closure is only released by |items_| here; |item| still holds a
+    // reference, so no task is destroyed under |lock_|.
+    if (front) {
+      *item = items_.front();
+      items_.pop_front();
+    } else {
+      *item = items_.back();
+      items_.pop_back();
+    }
+    subtle::NoBarrier_Store(&size_, static_cast<subtle::Atomic32>(
+        items_.size()));
+    return true;
+  }
+
+  Lock lock_;
+  std::deque<SequencedTask> items_;
+  volatile subtle::Atomic32 size_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkDeque);
+};
+
+// Number of SequenceShards in a WORK_STEALING pool.
+const int kNumSequenceShards = 16;
+
+// SequenceShard --------------------------------------------------------------
+// The pending tasks of the sequences whose token ID maps to this shard, in
+// WORK_STEALING mode. A sequence has an entry in |sequences| exactly while one
+// WorkDeque entry for it is queued or one of its tasks is running. That single
+// entry is what keeps two tasks of a sequence from running at the same time.
+struct SequenceShard {
+  Lock lock;
+  std::map<int, std::deque<SequencedTask> > sequences;
+};
+
 }  // namespace
 
 // Worker ---------------------------------------------------------------------
@@ -229,6 +308,10 @@ class SequencedWorkerPool::Worker : public SimpleThread {
   // SimpleThread implementation. This actually runs the background thread.
   virtual void Run() OVERRIDE;
 
+  // Returns the Worker running on the current thread, or NULL if the current
+  // thread is not a worker of any pool.
+  static Worker* GetForCurrentThread();
+
   void set_running_sequence(SequenceToken token) {
     running_sequence_ = token;
   }
@@ -237,9 +320,21 @@ class SequencedWorkerPool::Worker : public SimpleThread {
     return running_sequence_;
   }
 
+  SequencedWorkerPool* worker_pool() const {
+    return worker_pool_.get();
+  }
+
+  int thread_number() const {
+    return thread_number_;
+  }
+
  private:
   scoped_refptr<SequencedWorkerPool> worker_pool_;
   SequenceToken running_sequence_;
+  const int thread_number_;
+
+  // Lets GetForCurrentThread() find the Worker of the calling thread.
+  static LazyInstance<ThreadLocalPointer<Worker> >::Leaky lazy_tls_ptr_;
 
   DISALLOW_COPY_AND_ASSIGN(Worker);
 };
@@ -252,6 +347,7 @@ class SequencedWorkerPool::Inner {
   // by it).
   Inner(SequencedWorkerPool* worker_pool, size_t max_threads,
         const std::string& thread_name_prefix,
+        SchedulingMode scheduling_mode,
         TestingObserver* observer);
 
   ~Inner();
@@ -296,6 +392,13 @@ class SequencedWorkerPool::Inner {
   // are idle.  Must be called under lock.
   bool IsIdle() const;
 
+  // Adds |this_worker| to |threads_|. Must be called under lock.
+  void LockedRegisterWorker(Worker* this_worker);
+
+  // Runs |task| on |this_worker|, outside the lock, with the bookkeeping that
+  // tracking and IsRunningSequenceOnCurrentThread() need.
+  void RunTaskOnWorker(Worker* this_worker, SequencedTask* task);
+
   // Called from within the lock, this converts the given token name into a
   // token ID, creating a new one if necessary.
   int LockedGetNamedTokenID(const std::string& name);
@@ -360,6 +463,50 @@ class SequencedWorkerPool::Inner {
   // called inside the lock.
   bool CanShutdown() const;
 
+  // WORK_STEALING mode ------------------------------------------------------
+
+  // Posts an immediate task without taking |lock_|. Returns false if the pool
+  // is shutting down and the task was not accepted.
+  bool PostStealableTask(SequencedTask* task);
+
+  // Makes |task| runnable: appends it to its sequence's FIFO if it has a
+  // sequence token (queuing the sequence if it was idle), and to a WorkDeque
+  // otherwise.
+  void EnqueueRunnableTask(const SequencedTask& task);
+
+  // Returns the deque that work queued from the current thread goes to: the
+  // worker's own deque on a worker thread, and a round-robin pick otherwise.
+  WorkDeque* ChooseDequeForCurrentThread();
+
+  // Takes the next entry from the deque of |this_worker|, or steals one from
+  // another deque.
+  bool FindStealableWork(Worker* this_worker, SequencedTask* item);
+
+  // Returns true if any deque holds work.
+  bool HasStealableWork() const;
+
+  // Runs the task described by |item| (resolving sequence entries), or
+  // discards it if the pool is shutting down and the task may be skipped.
+  void RunOrDiscardStealableWork(Worker* this_worker,
+                                 const SequencedTask& item);
+
+  // Called after work was queued: wakes up a waiting worker, or starts a new
+  // one if that helps.
+  void WakeUpWorkerForStealableWork();
+
+  // Moves the delayed tasks in |pending_tasks_| that are due to the deques.
+  // Returns GET_WORK_FOUND if a task was moved, and otherwise the status and
+  // |wait_time| that the caller should wait with. Must be called under lock.
+  GetWorkStatus LockedEnqueueDueDelayedTasks(TimeDelta* wait_time);
+
+  // Marks the end of a stealable task, signaling shutdown or idleness waiters
+  // as needed. |blocked_shutdown| tells whether the task was counted in
+  // |stealable_running_blocking_count_|.
+  void DidFinishStealableTask(bool blocked_shutdown);
+
+  // Worker loop used instead of the one in ThreadLoop().
+  void WorkStealingThreadLoop(Worker* this_worker);
+
   SequencedWorkerPool* const worker_pool_;
 
   // The last sequence number used. Managed by GetSequenceToken, since this
@@ -428,7 +575,9 @@ class SequencedWorkerPool::Inner {
   std::set<int> current_sequences_;
 
   // An ID for each posted task to distinguish the task from others in traces.
-  int trace_id_;
+  // Taken atomically, as tasks posted in WORK_STEALING mode don't hold
+  // |lock_|, and shared by both modes so that no two tasks get the same ID.
+  volatile subtle::Atomic32 trace_id_;
 
   // Set when Shutdown is called and no further tasks should be
   // allowed, though we may still be running existing tasks.
@@ -436,25 +585,69 @@ class SequencedWorkerPool::Inner {
 
   TestingObserver* const testing_observer_;
 
+  const SchedulingMode scheduling_mode_;
+
+  // The state below is only used in WORK_STEALING mode. There, immediate
+  // tasks never enter |pending_tasks_|; they live in |deques_| and
+  // |sequence_shards_|, which have their own locks. |lock_| is still used
+  // for delayed tasks, thread creation, and for waiting/waking workers.
+
+  // One deque per potential worker, indexed by thread number - 1.
+  ScopedVector<WorkDeque> deques_;
+
+  SequenceShard sequence_shards_[kNumSequenceShards];
+
+  // Atomic mirrors of the counters above, readable without |lock_|.
+  // |stealable_shutdown_called_| is set under |lock_| by Shutdown().
+  volatile subtle::Atomic32 stealable_shutdown_called_;
+  volatile subtle::Atomic32 stealable_waiting_thread_count_;
+  volatile subtle::Atomic32 stealable_started_thread_count_;
+
+  // BLOCK_SHUTDOWN tasks that have been posted but not started.
+  volatile subtle::Atomic32 stealable_blocking_pending_count_;
+
+  // Running tasks that are not CONTINUE_ON_SHUTDOWN.
+  volatile subtle::Atomic32 stealable_running_blocking_count_;
+
+  // Tasks that have been posted but not yet run or discarded, including
+  // delayed tasks. Drives IsIdle().
+  volatile subtle::Atomic32 stealable_outstanding_count_;
+
+  // Round-robin cursor for work queued from non-worker threads.
+  volatile subtle::Atomic32 next_deque_;
+
   DISALLOW_COPY_AND_ASSIGN(Inner);
 };
 
 // Worker definitions ---------------------------------------------------------
 
+// static
+LazyInstance<ThreadLocalPointer<SequencedWorkerPool::Worker> >::Leaky
+    SequencedWorkerPool::Worker::lazy_tls_ptr_ = LAZY_INSTANCE_INITIALIZER;
+
 SequencedWorkerPool::Worker::Worker(
     const scoped_refptr<SequencedWorkerPool>& worker_pool,
     int thread_number,
     const std::string& prefix)
     : SimpleThread(
           prefix + StringPrintf("Worker%d", thread_number).c_str()),
-      worker_pool_(worker_pool) {
+      worker_pool_(worker_pool),
+      thread_number_(thread_number) {
   Start();
 }
 
 SequencedWorkerPool::Worker::~Worker() {
 }
 
+// static
+SequencedWorkerPool::Worker*
+SequencedWorkerPool::Worker::GetForCurrentThread() {
+  return lazy_tls_ptr_.Get().Get();
+}
+
 void SequencedWorkerPool::Worker::Run() {
+  lazy_tls_ptr_.Get().Set(this);
+
   // Just jump back to the Inner object to run the thread, since it has all the
   // tracking information and queues. It might be more natural to implement
   // using DelegateSimpleThread and have Inner implement the Delegate to avoid
@@ -471,6 +664,7 @@ SequencedWorkerPool::Inner::Inner(
     SequencedWorkerPool* worker_pool,
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode,
     TestingObserver* observer)
     : worker_pool_(worker_pool),
       last_sequence_number_(0),
@@ -487,7 +681,20 @@ SequencedWorkerPool::Inner::Inner(
       blocking_shutdown_pending_task_count_(0),
       trace_id_(0),
       shutdown_called_(false),
-      testing_observer_(observer) {}
+      testing_observer_(observer),
+      scheduling_mode_(scheduling_mode),
+      stealable_shutdown_called_(0),
+      stealable_waiting_thread_count_(0),
+      stealable_started_thread_count_(0),
+      stealable_blocking_pending_count_(0),
+      stealable_running_blocking_count_(0),
+      stealable_outstanding_count_(0),
+      next_deque_(0) {
+  if (scheduling_mode_ == WORK_STEALING) {
+    for (size_t i = 0; i < max_threads_; ++i)
+      deques_.push_back(new WorkDeque);
+  }
+}
 
 SequencedWorkerPool::Inner::~Inner() {
   // You must call Shutdown() before destroying the pool.
@@ -533,14 +740,26 @@ bool SequencedWorkerPool::Inner::PostTask(
       base::MakeCriticalClosure(task) : task;
   sequenced.time_to_run = TimeTicks::Now() + delay;
 
+  if (scheduling_mode_ == WORK_STEALING && delay == TimeDelta()) {
+    if (optional_token_name) {
+      sequenced.sequence_token_id =
+          GetNamedSequenceToken(*optional_token_name).id_;
+    }
+    return PostStealableTask(&sequenced);
+  }
+
   int create_thread_id = 0;
   {
     AutoLock lock(lock_);
     if (shutdown_called_)
       return false;
 
+    // In WORK_STEALING mode only delayed tasks get here.
+    if (scheduling_mode_ == WORK_STEALING)
+      subtle::NoBarrier_AtomicIncrement(&stealable_outstanding_count_, 1);
+
     // The trace_id is used for identifying the task in about:tracing.
-    sequenced.trace_id = trace_id_++;
+    sequenced.trace_id = subtle::NoBarrier_AtomicIncrement(&trace_id_, 1);
 
     TRACE_EVENT_FLOW_BEGIN0("task", "SequencedWorkerPool::PostTask",
         TRACE_ID_MANGLE(GetTaskTraceID(sequenced, static_cast<void*>(this))));
@@ -603,6 +822,12 @@ void SequencedWorkerPool::Inner::Shutdown() {
     if (shutdown_called_)
       return;
     shutdown_called_ = true;
+    // Posting and running stealable tasks does not take |lock_|. They update
+    // their counters before checking this flag, and CanShutdown() reads the
+    // counters after it is set, so every task is either seen by CanShutdown()
+    // or sees the flag.
+    subtle::Release_Store(&stealable_shutdown_called_, 1);
+    subtle::MemoryBarrier();
 
     // Tickle the threads. This will wake up a waiting one so it will know that
     // it can exit, which in turn will wake up any other waiting ones.
@@ -632,14 +857,14 @@ void SequencedWorkerPool::Inner::Shutdown() {
 }
 
 void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
+  if (scheduling_mode_ == WORK_STEALING) {
+    WorkStealingThreadLoop(this_worker);
+    return;
+  }
+
   {
     AutoLock lock(lock_);
-    DCHECK(thread_being_created_);
-    thread_being_created_ = false;
-    std::pair<ThreadMap::iterator, bool> result =
-        threads_.insert(
-            std::make_pair(this_worker->tid(), make_linked_ptr(this_worker)));
-    DCHECK(result.second);
+    LockedRegisterWorker(this_worker);
 
     while (true) {
 #if defined(OS_MACOSX)
@@ -672,22 +897,7 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
           if (new_thread_id)
             FinishStartingAdditionalThread(new_thread_id);
 
-          this_worker->set_running_sequence(
-              SequenceToken(task.sequence_token_id));
-
-          tracked_objects::TrackedTime start_time =
-              tracked_objects::ThreadData::NowForStartOfRun(task.birth_tally);
-
-          task.task.Run();
-
-          tracked_objects::ThreadData::TallyRunOnNamedThreadIfTracking(task,
-              start_time, tracked_objects::ThreadData::NowForEndOfRun());
-
-          this_worker->set_running_sequence(SequenceToken());
-
-          // Make sure our task is erased outside the lock for the same reason
-          // we do this with delete_these_oustide_lock.
-          task.task = Closure();
+          RunTaskOnWorker(this_worker, &task);
         }
         DidRunWorkerTask(task);  // Must be done inside the lock.
       } else {
@@ -729,9 +939,42 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
 
 bool SequencedWorkerPool::Inner::IsIdle() const {
   lock_.AssertAcquired();
+  if (scheduling_mode_ == WORK_STEALING) {
+    return subtle::Acquire_Load(&stealable_outstanding_count_) == 0 &&
+        waiting_thread_count_ == threads_.size();
+  }
   return pending_tasks_.empty() && waiting_thread_count_ == threads_.size();
 }
 
+void SequencedWorkerPool::Inner::LockedRegisterWorker(Worker* this_worker) {
+  lock_.AssertAcquired();
+  DCHECK(thread_being_created_);
+  thread_being_created_ = false;
+  std::pair<ThreadMap::iterator, bool> result =
+      threads_.insert(
+          std::make_pair(this_worker->tid(), make_linked_ptr(this_worker)));
+  DCHECK(result.second);
+}
+
+void SequencedWorkerPool::Inner::RunTaskOnWorker(Worker* this_worker,
+                                                 SequencedTask* task) {
+  this_worker->set_running_sequence(SequenceToken(task->sequence_token_id));
+
+  tracked_objects::TrackedTime start_time =
+      tracked_objects::ThreadData::NowForStartOfRun(task->birth_tally);
+
+  task->task.Run();
+
+  tracked_objects::ThreadData::TallyRunOnNamedThreadIfTracking(*task,
+      start_time, tracked_objects::ThreadData::NowForEndOfRun());
+
+  this_worker->set_running_sequence(SequenceToken());
+
+  // Make sure our task is erased outside the lock for the same reason
+  // we do this with delete_these_oustide_lock.
+  task->task = Closure();
+}
+
 int SequencedWorkerPool::Inner::LockedGetNamedTokenID(
     const std::string& name) {
   lock_.AssertAcquired();
@@ -931,15 +1174,29 @@ int SequencedWorkerPool::Inner::PrepareToStartAdditionalThreadIfHelpful() {
       !thread_being_created_ &&
       threads_.size() < max_threads_ &&
       waiting_thread_count_ == 0) {
-    // We could use an additional thread if there's work to be done.
-    for (PendingTaskSet::const_iterator i = pending_tasks_.begin();
-         i != pending_tasks_.end(); ++i) {
-      if (IsSequenceTokenRunnable(i->sequence_token_id)) {
-        // Found a runnable task, mark the thread as being started.
-        thread_being_created_ = true;
-        return static_cast<int>(threads_.size() + 1);
+    // We could use an additional thread if there's work to be done. In
+    // WORK_STEALING mode, |pending_tasks_| only holds delayed tasks, which
+    // still need a thread to wait for them.
+    bool helpful = false;
+    if (scheduling_mode_ == WORK_STEALING) {
+      helpful = HasStealableWork() || !pending_tasks_.empty();
+    } else {
+      for (PendingTaskSet::const_iterator i = pending_tasks_.begin();
+           i != pending_tasks_.end(); ++i) {
+        if (IsSequenceTokenRunnable(i->sequence_token_id)) {
+          helpful = true;
+          break;
+        }
       }
     }
+    if (helpful) {
+      // Found a runnable task, mark the thread as being started.
+      thread_being_created_ = true;
+      subtle::NoBarrier_Store(&stealable_started_thread_count_,
+                              static_cast<subtle::Atomic32>(
+                                  threads_.size() + 1));
+      return static_cast<int>(threads_.size() + 1);
+    }
   }
   return 0;
 }
@@ -964,11 +1221,291 @@ void SequencedWorkerPool::Inner::SignalHasWork() {
 bool SequencedWorkerPool::Inner::CanShutdown() const {
   lock_.AssertAcquired();
   // See PrepareToStartAdditionalThreadIfHelpful for how thread creation works.
+  if (scheduling_mode_ == WORK_STEALING) {
+    return !thread_being_created_ &&
+        subtle::Acquire_Load(&stealable_running_blocking_count_) == 0 &&
+        subtle::Acquire_Load(&stealable_blocking_pending_count_) == 0;
+  }
   return !thread_being_created_ &&
          blocking_shutdown_thread_count_ == 0 &&
          blocking_shutdown_pending_task_count_ == 0;
 }
 
+bool SequencedWorkerPool::Inner::PostStealableTask(SequencedTask* task) {
+  // Count the task before checking for shutdown; see Shutdown().
+  bool blocks_shutdown = task->shutdown_behavior == BLOCK_SHUTDOWN;
+  if (blocks_shutdown)
+    subtle::Barrier_AtomicIncrement(&stealable_blocking_pending_count_, 1);
+  if (subtle::Acquire_Load(&stealable_shutdown_called_)) {
+    if (blocks_shutdown) {
+      subtle::Barrier_AtomicIncrement(&stealable_blocking_pending_count_, -1);
+      AutoLock lock(lock_);
+      if (CanShutdown())
+        can_shutdown_cv_.Signal();
+    }
+    return false;
+  }
+
+  // The trace_id is used for identifying the task in about:tracing.
+  task->trace_id = subtle::NoBarrier_AtomicIncrement(&trace_id_, 1);
+  TRACE_EVENT_FLOW_BEGIN0("task", "SequencedWorkerPool::PostTask",
+      TRACE_ID_MANGLE(GetTaskTraceID(*task, static_cast<void*>(this))));
+
+  subtle::NoBarrier_AtomicIncrement(&stealable_outstanding_count_, 1);
+  EnqueueRunnableTask(*task);
+  WakeUpWorkerForStealableWork();
+  return true;
+}
+
+void SequencedWorkerPool::Inner::EnqueueRunnableTask(
+    const SequencedTask& task) {
+  if (!task.sequence_token_id) {
+    ChooseDequeForCurrentThread()->Push(task);
+    return;
+  }
+
+  SequenceShard* shard =
+      &sequence_shards_[task.sequence_token_id % kNumSequenceShards];
+  {
+    AutoLock lock(shard->lock);
+    std::map<int, std::deque<SequencedTask> >::iterator found =
+        shard->sequences.find(task.sequence_token_id);
+    if (found != shard->sequences.end()) {
+      // The sequence is already queued or running; whoever runs it will get
+      // to this task.
+      found->second.push_back(task);
+      return;
+    }
+    shard->sequences[task.sequence_token_id].push_back(task);
+  }
+
+  SequencedTask sequence_entry;
+  sequence_entry.sequence_token_id = task.sequence_token_id;
+  ChooseDequeForCurrentThread()->Push(sequence_entry);
+}
+
+WorkDeque* SequencedWorkerPool::Inner::ChooseDequeForCurrentThread() {
+  Worker* worker = Worker::GetForCurrentThread();
+  if (worker && worker->worker_pool() == worker_pool_)
+    return deques_[worker->thread_number() - 1];
+  uint32 index = static_cast<uint32>(
+      subtle::NoBarrier_AtomicIncrement(&next_deque_, 1));
+  return deques_[index % deques_.size()];
+}
+
+bool SequencedWorkerPool::Inner::FindStealableWork(Worker* this_worker,
+                                                   SequencedTask* item) {
+  size_t own_index = this_worker->thread_number() - 1;
+  if (deques_[own_index]->PopFront(item))
+    return true;
+  for (size_t i = 1; i < deques_.size(); ++i) {
+    if (deques_[(own_index + i) % deques_.size()]->StealBack(item))
+      return true;
+  }
+  return false;
+}
+
+bool SequencedWorkerPool::Inner::HasStealableWork() const {
+  for (size_t i = 0; i < deques_.size(); ++i) {
+    if (!deques_[i]->LooksEmpty())
+      return true;
+  }
+  return false;
+}
+
+void SequencedWorkerPool::Inner::RunOrDiscardStealableWork(
+    Worker* this_worker,
+    const SequencedTask& item) {
+  SequencedTask task;
+  SequenceShard* shard = NULL;
+  if (item.sequence_token_id) {
+    // We own the sequence until we are done with its front task.
+    shard = &sequence_shards_[item.sequence_token_id % kNumSequenceShards];
+    AutoLock lock(shard->lock);
+    std::deque<SequencedTask>& queue =
+        shard->sequences[item.sequence_token_id];
+    DCHECK(!queue.empty());
+    task = queue.front();
+    queue.pop_front();
+  } else {
+    task = item;
+  }
+
+  // Count the task as running before it stops being pending, and before
+  // checking for shutdown; see Shutdown().
+  bool blocks_shutdown = task.shutdown_behavior != CONTINUE_ON_SHUTDOWN;
+  if (blocks_shutdown)
+    subtle::Barrier_AtomicIncrement(&stealable_running_blocking_count_, 1);
+  if (task.shutdown_behavior == BLOCK_SHUTDOWN)
+    subtle::Barrier_AtomicIncrement(&stealable_blocking_pending_count_, -1);
+
+  if (subtle::Acquire_Load(&stealable_shutdown_called_) &&
+      task.shutdown_behavior != BLOCK_SHUTDOWN) {
+    // Same as the deletion in GetWork(), but we hold no lock here.
+    task.task = Closure();
+  } else {
+    TRACE_EVENT_FLOW_END0("task", "SequencedWorkerPool::PostTask",
+        TRACE_ID_MANGLE(GetTaskTraceID(task, static_cast<void*>(this))));
+    TRACE_EVENT2("task", "SequencedWorkerPool::ThreadLoop",
+                 "src_file", task.posted_from.file_name(),
+                 "src_func", task.posted_from.function_name());
+    RunTaskOnWorker(this_worker, &task);
+  }
+
+  if (shard) {
+    bool sequence_has_more_tasks = false;
+    {
+      AutoLock lock(shard->lock);
+      std::map<int, std::deque<SequencedTask> >::iterator found =
+          shard->sequences.find(item.sequence_token_id);
+      DCHECK(found != shard->sequences.end());
+      if (found->second.empty())
+        shard->sequences.erase(found);
+      else
+        sequence_has_more_tasks = true;
+    }
+    // Queue the sequence at the back of our own deque, so that other work
+    // gets a turn before its next task.
+    if (sequence_has_more_tasks)
+      deques_[this_worker->thread_number() - 1]->Push(item);
+  }
+
+  DidFinishStealableTask(blocks_shutdown);
+}
+
+void SequencedWorkerPool::Inner::WakeUpWorkerForStealableWork() {
+  // Pairs with the barrier in WorkStealingThreadLoop() between announcing a
+  // waiting worker and looking at the deques one last time: either that
+  // worker sees the work we just queued, or we see it waiting.
+  subtle::MemoryBarrier();
+  if (subtle::NoBarrier_Load(&stealable_waiting_thread_count_) == 0 &&
+      static_cast<size_t>(
+          subtle::NoBarrier_Load(&stealable_started_thread_count_)) >=
+          max_threads_) {
+    // Every worker is busy and will look for more work when it is done.
+    return;
+  }
+
+  int create_thread_id = 0;
+  {
+    AutoLock lock(lock_);
+    create_thread_id = PrepareToStartAdditionalThreadIfHelpful();
+  }
+  if (create_thread_id)
+    FinishStartingAdditionalThread(create_thread_id);
+  else
+    SignalHasWork();
+}
+
+SequencedWorkerPool::Inner::GetWorkStatus
+SequencedWorkerPool::Inner::LockedEnqueueDueDelayedTasks(TimeDelta* wait_time) {
+  lock_.AssertAcquired();
+  GetWorkStatus status = GET_WORK_NOT_FOUND;
+  const TimeTicks current_time = TimeTicks::Now();
+  while (!pending_tasks_.empty()) {
+    PendingTaskSet::iterator i = pending_tasks_.begin();
+    if (i->time_to_run > current_time) {
+      if (status != GET_WORK_FOUND) {
+        *wait_time = i->time_to_run - current_time;
+        status = GET_WORK_WAIT;
+      }
+      break;
+    }
+    EnqueueRunnableTask(*i);
+    pending_tasks_.erase(i);
+    status = GET_WORK_FOUND;
+  }
+  return status;
+}
+
+void SequencedWorkerPool::Inner::DidFinishStealableTask(bool blocked_shutdown) {
+  if (blocked_shutdown)
+    subtle::Barrier_AtomicIncrement(&stealable_running_blocking_count_, -1);
+  subtle::Barrier_AtomicIncrement(&stealable_outstanding_count_, -1);
+
+  if (subtle::Acquire_Load(&stealable_shutdown_called_)) {
+    AutoLock lock(lock_);
+    if (CanShutdown())
+      can_shutdown_cv_.Signal();
+  }
+}
+
+void SequencedWorkerPool::Inner::WorkStealingThreadLoop(Worker* this_worker) {
+  {
+    AutoLock lock(lock_);
+    LockedRegisterWorker(this_worker);
+  }
+
+  while (true) {
+#if defined(OS_MACOSX)
+    base::mac::ScopedNSAutoreleasePool autorelease_pool;
+#endif
+
+    SequencedTask item;
+    if (FindStealableWork(this_worker, &item)) {
+      // Only one thread is created at a time, so posts that happened while
+      // this one was being created may still want another thread. See the
+      // corresponding code in ThreadLoop().
+      if (static_cast<size_t>(
+              subtle::NoBarrier_Load(&stealable_started_thread_count_)) <
+              max_threads_ &&
+          HasStealableWork()) {
+        int new_thread_id = 0;
+        {
+          AutoLock lock(lock_);
+          new_thread_id = PrepareToStartAdditionalThreadIfHelpful();
+        }
+        if (new_thread_id)
+          FinishStartingAdditionalThread(new_thread_id);
+      }
+      RunOrDiscardStealableWork(this_worker, item);
+      continue;
+    }
+
+    AutoLock lock(lock_);
+    TimeDelta wait_time;
+    GetWorkStatus status = LockedEnqueueDueDelayedTasks(&wait_time);
+    if (status == GET_WORK_FOUND)
+      continue;
+
+    // Same exit condition as in ThreadLoop().
+    if (shutdown_called_ &&
+        subtle::Acquire_Load(&stealable_blocking_pending_count_) == 0)
+      break;
+
+    waiting_thread_count_++;
+    subtle::Barrier_AtomicIncrement(&stealable_waiting_thread_count_, 1);
+    // Work posted before the increment above may not have seen it, so look
+    // at the deques once more before sleeping. See
+    // WakeUpWorkerForStealableWork().
+    if (!HasStealableWork()) {
+      // This is the only time that IsIdle() can go to true.
+      if (IsIdle())
+        is_idle_cv_.Signal();
+
+      switch (status) {
+        case GET_WORK_NOT_FOUND:
+          has_work_cv_.Wait();
+          break;
+        case GET_WORK_WAIT:
+          has_work_cv_.TimedWait(wait_time);
+          break;
+        default:
+          NOTREACHED();
+      }
+    }
+    subtle::Barrier_AtomicIncrement(&stealable_waiting_thread_count_, -1);
+    waiting_thread_count_--;
+  }
+
+  // We noticed we should exit. Wake up the next worker so it knows it should
+  // exit as well (because the Shutdown() code only signals once).
+  SignalHasWork();
+
+  // Possibly unblock shutdown.
+  can_shutdown_cv_.Signal();
+}
+
 // SequencedWorkerPool --------------------------------------------------------
 
 SequencedWorkerPool::SequencedWorkerPool(
@@ -976,16 +1513,29 @@ SequencedWorkerPool::SequencedWorkerPool(
     const std::string& thread_name_prefix)
     : constructor_message_loop_(MessageLoopProxy::current()),
       inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
-                       max_threads, thread_name_prefix, NULL)) {
+                       max_threads, thread_name_prefix, CENTRAL_QUEUE,
+                       NULL)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    TestingObserver* observer)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
+                       max_threads, thread_name_prefix, CENTRAL_QUEUE,
+                       observer)) {
 }
 
 SequencedWorkerPool::SequencedWorkerPool(
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode,
     TestingObserver* observer)
     : constructor_message_loop_(MessageLoopProxy::current()),
       inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
-                       max_threads, thread_name_prefix, observer)) {
+                       max_threads, thread_name_prefix, scheduling_mode,
+                       observer)) {
 }
 
 SequencedWorkerPool::~SequencedWorkerPool() {}
@@ -134,6 +134,21 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
     int id_;
   };
 
+  // Selects how the pool hands out tasks to its worker threads.
+  enum SchedulingMode {
+    // All pending tasks are kept in a single time-ordered set guarded by one
+    // lock, which every post and every worker goes through.
+    CENTRAL_QUEUE,
+
+    // Every worker thread owns a deque of runnable work, and workers which run
+    // out of work steal from the others. Tasks posted with a sequence token
+    // are kept in a per-token FIFO which is scheduled on at most one worker at
+    // a time, so sequence ordering and the shutdown behaviors are the same as
+    // with CENTRAL_QUEUE. Delayed tasks stay in the central set until they
+    // are due.
+    WORK_STEALING,
+  };
+
   // Allows tests to perform certain actions.
   class TestingObserver {
    public:
@@ -158,6 +173,12 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
                       const std::string& thread_name_prefix,
                       TestingObserver* observer);
 
+  // Like above, but with the given |scheduling_mode|. |observer| may be NULL.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      SchedulingMode scheduling_mode,
+                      TestingObserver* observer);
+
   // Returns a unique token that can be used to sequence tasks posted to
   // PostSequencedWorkerTask(). Valid tokens are alwys nonzero.
   SequenceToken GetSequenceToken();
@@ -0,0 +1,125 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/sequenced_worker_pool_owner.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Number of tasks posted from the test thread in every run.
+const int kRootTasks = 4000;
+
+// Number of unsequenced tasks every root task posts from its worker thread.
+const int kChildrenPerRoot = 15;
+
+// Every kSequencedRootInterval-th root task is posted to one of
+// kNumSequences sequences instead of as an unsequenced task.
+const int kSequencedRootInterval = 4;
+const int kNumSequences = 8;
+
+// Amount of busy work done by every task, so that tasks are short but not
+// empty.
+const int kSpinIterations = 200;
+
+const int kTotalTasks = kRootTasks * (1 + kChildrenPerRoot);
+
+// Counts finished tasks and signals |done| after the last one.
+class Completion {
+ public:
+  Completion(int expected, WaitableEvent* done)
+      : remaining_(expected),
+        done_(done) {
+  }
+
+  void TaskDone() {
+    if (subtle::Barrier_AtomicIncrement(&remaining_, -1) == 0)
+      done_->Signal();
+  }
+
+ private:
+  volatile subtle::Atomic32 remaining_;
+  WaitableEvent* done_;
+
+  DISALLOW_COPY_AND_ASSIGN(Completion);
+};
+
+void Spin() {
+  volatile int sink = 0;
+  for (int i = 0; i < kSpinIterations; ++i)
+    sink += i;
+}
+
+void ChildTask(Completion* completion) {
+  Spin();
+  completion->TaskDone();
+}
+
+void RootTask(SequencedWorkerPool* pool, Completion* completion) {
+  Spin();
+  for (int i = 0; i < kChildrenPerRoot; ++i)
+    pool->PostWorkerTask(FROM_HERE,
+                         Bind(&ChildTask, Unretained(completion)));
+  completion->TaskDone();
+}
+
+// Runs the mixed sequenced/unsequenced load on a pool of |num_workers|
+// threads and logs the number of tasks run per second.
+void RunPoolBenchmark(SequencedWorkerPool::SchedulingMode mode,
+                      size_t num_workers) {
+  MessageLoop message_loop;
+  SequencedWorkerPoolOwner pool_owner(num_workers, "PerfTest", mode);
+  SequencedWorkerPool* pool = pool_owner.pool();
+
+  SequencedWorkerPool::SequenceToken tokens[kNumSequences];
+  for (int i = 0; i < kNumSequences; ++i)
+    tokens[i] = pool->GetSequenceToken();
+
+  WaitableEvent done(false, false);
+  Completion completion(kTotalTasks, &done);
+
+  PerfTimer timer;
+  for (int i = 0; i < kRootTasks; ++i) {
+    Closure task = Bind(&RootTask, Unretained(pool), Unretained(&completion));
+    if (i % kSequencedRootInterval == 0) {
+      pool->PostSequencedWorkerTask(tokens[(i / kSequencedRootInterval) %
+                                           kNumSequences],
+                                    FROM_HERE, task);
+    } else {
+      pool->PostWorkerTask(FROM_HERE, task);
+    }
+  }
+  done.Wait();
+  TimeDelta elapsed = timer.Elapsed();
+
+  std::string name = StringPrintf(
+      "SequencedWorkerPool_%s_%dworkers",
+      mode == SequencedWorkerPool::WORK_STEALING ? "stealing" : "central",
+      static_cast<int>(num_workers));
+  LogPerfResult(name.c_str(), kTotalTasks / elapsed.InSecondsF(), "tasks/s");
+
+  pool->Shutdown();
+}
+
+}  // namespace
+
+TEST(SequencedWorkerPoolPerfTest, CentralQueue) {
+  for (size_t workers = 1; workers <= 32; workers *= 2)
+    RunPoolBenchmark(SequencedWorkerPool::CENTRAL_QUEUE, workers);
+}
+
+TEST(SequencedWorkerPoolPerfTest, WorkStealing) {
+  for (size_t workers = 1; workers <= 32; workers *= 2)
+    RunPoolBenchmark(SequencedWorkerPool::WORK_STEALING, workers);
+}
+
+}  // namespace base
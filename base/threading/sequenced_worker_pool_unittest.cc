@@ -151,10 +151,12 @@ class TestTracker : public base::RefCountedThreadSafe<TestTracker> {
   size_t started_events_;
 };
 
-class SequencedWorkerPoolTest : public testing::Test {
+// Runs every test against both scheduling modes.
+class SequencedWorkerPoolTest
+    : public testing::TestWithParam<SequencedWorkerPool::SchedulingMode> {
  public:
   SequencedWorkerPoolTest()
-      : pool_owner_(kNumWorkerThreads, "test"),
+      : pool_owner_(kNumWorkerThreads, "test", GetParam()),
         tracker_(new TestTracker) {
   }
 
@@ -234,7 +236,7 @@ void EnsureTasksToCompleteCountAndUnblock(scoped_refptr<TestTracker> tracker,
 }
 
 // Tests that same-named tokens have the same ID.
-TEST_F(SequencedWorkerPoolTest, NamedTokens) {
+TEST_P(SequencedWorkerPoolTest, NamedTokens) {
   const std::string name1("hello");
   SequencedWorkerPool::SequenceToken token1 =
       pool()->GetNamedSequenceToken(name1);
@@ -262,7 +264,7 @@ TEST_F(SequencedWorkerPoolTest, NamedTokens) {
 
 // Tests that posting a bunch of tasks (many more than the number of worker
 // threads) runs them all.
-TEST_F(SequencedWorkerPoolTest, LotsOfTasks) {
+TEST_P(SequencedWorkerPoolTest, LotsOfTasks) {
   pool()->PostWorkerTask(FROM_HERE,
                          base::Bind(&TestTracker::SlowTask, tracker(), 0));
 
@@ -280,9 +282,9 @@ TEST_F(SequencedWorkerPoolTest, LotsOfTasks) {
 // worker threads) to two pools simultaneously runs them all twice.
 // This test is meant to shake out any concurrency issues between
 // pools (like histograms).
-TEST_F(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
-  SequencedWorkerPoolOwner pool1(kNumWorkerThreads, "test1");
-  SequencedWorkerPoolOwner pool2(kNumWorkerThreads, "test2");
+TEST_P(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
+  SequencedWorkerPoolOwner pool1(kNumWorkerThreads, "test1", GetParam());
+  SequencedWorkerPoolOwner pool2(kNumWorkerThreads, "test2", GetParam());
 
   base::Closure slow_task = base::Bind(&TestTracker::SlowTask, tracker(), 0);
   pool1.pool()->PostWorkerTask(FROM_HERE, slow_task);
@@ -306,7 +308,7 @@ TEST_F(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
 
 // Test that tasks with the same sequence token are executed in order but don't
 // affect other tasks.
-TEST_F(SequencedWorkerPoolTest, Sequence) {
+TEST_P(SequencedWorkerPoolTest, Sequence) {
   // Fill all the worker threads except one.
   const size_t kNumBackgroundTasks = kNumWorkerThreads - 1;
   ThreadBlocker background_blocker;
@@ -366,7 +368,7 @@ TEST_F(SequencedWorkerPoolTest, Sequence) {
 }
 
 // Tests that any tasks posted after Shutdown are ignored.
-TEST_F(SequencedWorkerPoolTest, IgnoresAfterShutdown) {
+TEST_P(SequencedWorkerPoolTest, IgnoresAfterShutdown) {
   // Start tasks to take all the threads and block them.
   EnsureAllWorkersCreated();
   ThreadBlocker blocker;
@@ -416,7 +418,7 @@ TEST_F(SequencedWorkerPoolTest, IgnoresAfterShutdown) {
 
 // Tests that unrun tasks are discarded properly according to their shutdown
 // mode.
-TEST_F(SequencedWorkerPoolTest, DiscardOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, DiscardOnShutdown) {
   // Start tasks to take all the threads and block them.
   EnsureAllWorkersCreated();
   ThreadBlocker blocker;
@@ -462,7 +464,7 @@ TEST_F(SequencedWorkerPoolTest, DiscardOnShutdown) {
 }
 
 // Tests that CONTINUE_ON_SHUTDOWN tasks don't block shutdown.
-TEST_F(SequencedWorkerPoolTest, ContinueOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, ContinueOnShutdown) {
   scoped_refptr<TaskRunner> runner(pool()->GetTaskRunnerWithShutdownBehavior(
       SequencedWorkerPool::CONTINUE_ON_SHUTDOWN));
   scoped_refptr<SequencedTaskRunner> sequenced_runner(
@@ -510,7 +512,7 @@ TEST_F(SequencedWorkerPoolTest, ContinueOnShutdown) {
 
 // Tests that SKIP_ON_SHUTDOWN tasks that have been started block Shutdown
 // until they stop, but tasks not yet started do not.
-TEST_F(SequencedWorkerPoolTest, SkipOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, SkipOnShutdown) {
   // Start tasks to take all the threads and block them.
   EnsureAllWorkersCreated();
   ThreadBlocker blocker;
@@ -563,7 +565,7 @@ TEST_F(SequencedWorkerPoolTest, SkipOnShutdown) {
 // Ensure all worker threads are created, and then trigger a spurious
 // work signal. This shouldn't cause any other work signals to be
 // triggered. This is a regression test for http://crbug.com/117469.
-TEST_F(SequencedWorkerPoolTest, SpuriousWorkSignal) {
+TEST_P(SequencedWorkerPoolTest, SpuriousWorkSignal) {
   EnsureAllWorkersCreated();
   int old_has_work_call_count = has_work_call_count();
   pool()->SignalHasWorkForTesting();
@@ -588,13 +590,13 @@ void IsRunningOnCurrentThreadTask(
 }
 
 // Verify correctness of the IsRunningSequenceOnCurrentThread method.
-TEST_F(SequencedWorkerPoolTest, IsRunningOnCurrentThread) {
+TEST_P(SequencedWorkerPoolTest, IsRunningOnCurrentThread) {
   SequencedWorkerPool::SequenceToken token1 = pool()->GetSequenceToken();
   SequencedWorkerPool::SequenceToken token2 = pool()->GetSequenceToken();
   SequencedWorkerPool::SequenceToken unsequenced_token;
 
   scoped_refptr<SequencedWorkerPool> unused_pool =
-      new SequencedWorkerPool(2, "unused_pool");
+      new SequencedWorkerPool(2, "unused_pool", GetParam(), NULL);
   EXPECT_TRUE(token1.Equals(unused_pool->GetSequenceToken()));
   EXPECT_TRUE(token2.Equals(unused_pool->GetSequenceToken()));
 
@@ -624,6 +626,15 @@ TEST_F(SequencedWorkerPoolTest, IsRunningOnCurrentThread) {
   unused_pool->Shutdown();
 }
 
+INSTANTIATE_TEST_CASE_P(
+    CentralQueue, SequencedWorkerPoolTest,
+    testing::Values(SequencedWorkerPool::CENTRAL_QUEUE));
+
+INSTANTIATE_TEST_CASE_P(
+    WorkStealing, SequencedWorkerPoolTest,
+    testing::Values(SequencedWorkerPool::WORK_STEALING));
+
+template <SequencedWorkerPool::SchedulingMode scheduling_mode>
 class SequencedWorkerPoolTaskRunnerTestDelegate {
  public:
   SequencedWorkerPoolTaskRunnerTestDelegate() {}
@@ -632,7 +643,8 @@ class SequencedWorkerPoolTaskRunnerTestDelegate {
 
   void StartTaskRunner() {
     pool_owner_.reset(
-        new SequencedWorkerPoolOwner(10, "SequencedWorkerPoolTaskRunnerTest"));
+        new SequencedWorkerPoolOwner(10, "SequencedWorkerPoolTaskRunnerTest",
+                                     scheduling_mode));
   }
 
   scoped_refptr<SequencedWorkerPool> GetTaskRunner() {
@@ -657,10 +669,22 @@ class SequencedWorkerPoolTaskRunnerTestDelegate {
   scoped_ptr<SequencedWorkerPoolOwner> pool_owner_;
 };
 
+typedef SequencedWorkerPoolTaskRunnerTestDelegate<
+    SequencedWorkerPool::CENTRAL_QUEUE>
+    CentralQueueTaskRunnerTestDelegate;
+typedef SequencedWorkerPoolTaskRunnerTestDelegate<
+    SequencedWorkerPool::WORK_STEALING>
+    WorkStealingTaskRunnerTestDelegate;
+
 INSTANTIATE_TYPED_TEST_CASE_P(
     SequencedWorkerPool, TaskRunnerTest,
-    SequencedWorkerPoolTaskRunnerTestDelegate);
+    CentralQueueTaskRunnerTestDelegate);
 
+INSTANTIATE_TYPED_TEST_CASE_P(
+    WorkStealingSequencedWorkerPool, TaskRunnerTest,
+    WorkStealingTaskRunnerTestDelegate);
+
+template <SequencedWorkerPool::SchedulingMode scheduling_mode>
 class SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate {
  public:
   SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate() {}
@@ -670,7 +694,8 @@ class SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate {
 
   void StartTaskRunner() {
     pool_owner_.reset(
-        new SequencedWorkerPoolOwner(10, "SequencedWorkerPoolTaskRunnerTest"));
+        new SequencedWorkerPoolOwner(10, "SequencedWorkerPoolTaskRunnerTest",
+                                     scheduling_mode));
     task_runner_ = pool_owner_->pool()->GetTaskRunnerWithShutdownBehavior(
         SequencedWorkerPool::BLOCK_SHUTDOWN);
   }
@@ -698,10 +723,22 @@ class SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate {
   scoped_refptr<TaskRunner> task_runner_;
 };
 
+typedef SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate<
+    SequencedWorkerPool::CENTRAL_QUEUE>
+    CentralQueueShutdownBehaviorTestDelegate;
+typedef SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate<
+    SequencedWorkerPool::WORK_STEALING>
+    WorkStealingShutdownBehaviorTestDelegate;
+
 INSTANTIATE_TYPED_TEST_CASE_P(
     SequencedWorkerPoolTaskRunner, TaskRunnerTest,
-    SequencedWorkerPoolTaskRunnerWithShutdownBehaviorTestDelegate);
+    CentralQueueShutdownBehaviorTestDelegate);
 
+INSTANTIATE_TYPED_TEST_CASE_P(
+    WorkStealingSequencedWorkerPoolTaskRunner, TaskRunnerTest,
+    WorkStealingShutdownBehaviorTestDelegate);
+
+template <SequencedWorkerPool::SchedulingMode scheduling_mode>
 class SequencedWorkerPoolSequencedTaskRunnerTestDelegate {
  public:
   SequencedWorkerPoolSequencedTaskRunnerTestDelegate() {}
@@ -711,7 +748,7 @@ class SequencedWorkerPoolSequencedTaskRunnerTestDelegate {
 
   void StartTaskRunner() {
     pool_owner_.reset(new SequencedWorkerPoolOwner(
-        10, "SequencedWorkerPoolSequencedTaskRunnerTest"));
+        10, "SequencedWorkerPoolSequencedTaskRunnerTest", scheduling_mode));
     task_runner_ = pool_owner_->pool()->GetSequencedTaskRunner(
         pool_owner_->pool()->GetSequenceToken());
   }
@@ -739,13 +776,29 @@ class SequencedWorkerPoolSequencedTaskRunnerTestDelegate {
   scoped_refptr<SequencedTaskRunner> task_runner_;
 };
 
+typedef SequencedWorkerPoolSequencedTaskRunnerTestDelegate<
+    SequencedWorkerPool::CENTRAL_QUEUE>
+    CentralQueueSequencedTaskRunnerTestDelegate;
+typedef SequencedWorkerPoolSequencedTaskRunnerTestDelegate<
+    SequencedWorkerPool::WORK_STEALING>
+    WorkStealingSequencedTaskRunnerTestDelegate;
+
 INSTANTIATE_TYPED_TEST_CASE_P(
     SequencedWorkerPoolSequencedTaskRunner, TaskRunnerTest,
-    SequencedWorkerPoolSequencedTaskRunnerTestDelegate);
+    CentralQueueSequencedTaskRunnerTestDelegate);
 
 INSTANTIATE_TYPED_TEST_CASE_P(
     SequencedWorkerPoolSequencedTaskRunner, SequencedTaskRunnerTest,
-    SequencedWorkerPoolSequencedTaskRunnerTestDelegate);
+    CentralQueueSequencedTaskRunnerTestDelegate);
+
+INSTANTIATE_TYPED_TEST_CASE_P(
+    WorkStealingSequencedWorkerPoolSequencedTaskRunner, TaskRunnerTest,
+    WorkStealingSequencedTaskRunnerTestDelegate);
+
+INSTANTIATE_TYPED_TEST_CASE_P(
+    WorkStealingSequencedWorkerPoolSequencedTaskRunner,
+    SequencedTaskRunnerTest,
+    WorkStealingSequencedTaskRunnerTestDelegate);
 
 }  // namespace
 
@@ -4,10 +4,46 @@
 
 #include "base/utf_string_conversion_utils.h"
 
+#include "base/cpu.h"
 #include "base/third_party/icu/icu_utf.h"
+#include "build/build_config.h"
+
+// SSSE3 is not part of any build's baseline, so the kernels which need it are
+// picked at runtime. NaCl builds have no base::CPU.
+#if defined(ARCH_CPU_X86_FAMILY) && !defined(OS_NACL)
+#define UTF_CONVERSION_DISPATCH_SSSE3 1
+#include "base/lazy_instance.h"
+#endif
+
+#if defined(ARCH_CPU_HAS_SSE2)
+#include <emmintrin.h>
+#endif
 
 namespace base {
 
+#if defined(UTF_CONVERSION_DISPATCH_SSSE3)
+// Defined in utf_string_conversion_utils_ssse3.cc, the only file built with
+// SSSE3 enabled.
+size_t ConvertLeadingTwoByteUTF16_SSSE3(const char16* src,
+                                        size_t src_len,
+                                        char* dest,
+                                        size_t* dest_len);
+
+namespace {
+
+// Asking the CPU is a cpuid instruction and some string copies, so it is done
+// once.
+struct CPUFeatures {
+  CPUFeatures() : has_ssse3(CPU().has_ssse3()) {}
+
+  bool has_ssse3;
+};
+
+LazyInstance<CPUFeatures>::Leaky g_cpu_features = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+#endif  // defined(UTF_CONVERSION_DISPATCH_SSSE3)
+
 // ReadUnicodeCharacter --------------------------------------------------------
 
 bool ReadUnicodeCharacter(const char* src,
@@ -102,6 +138,62 @@ size_t WriteUnicodeCharacter(uint32 code_point, string16* output) {
   return CBU16_MAX_LENGTH;
 }
 
+// Bulk conversion -------------------------------------------------------------
+
+size_t ConvertLeadingASCII(const char* src, size_t src_len, char16* dest) {
+  size_t i = 0;
+#if defined(ARCH_CPU_HAS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; src_len - i >= 16; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    // Non-ASCII bytes have their top bit set.
+    if (_mm_movemask_epi8(chunk))
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_unpacklo_epi8(chunk, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8),
+                     _mm_unpackhi_epi8(chunk, zero));
+  }
+#endif
+  for (; i < src_len && static_cast<unsigned char>(src[i]) < 0x80; ++i)
+    dest[i] = src[i];
+  return i;
+}
+
+size_t ConvertLeadingASCII(const char16* src, size_t src_len, char* dest) {
+  size_t i = 0;
+#if defined(ARCH_CPU_HAS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i non_ascii_bits = _mm_set1_epi16(static_cast<short>(0xFF80));
+  for (; src_len - i >= 16; i += 16) {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i high =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+    __m128i non_ascii =
+        _mm_and_si128(_mm_or_si128(low, high), non_ascii_bits);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(non_ascii, zero)) != 0xFFFF)
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_packus_epi16(low, high));
+  }
+#endif
+  for (; i < src_len && src[i] < 0x80; ++i)
+    dest[i] = static_cast<char>(src[i]);
+  return i;
+}
+
+size_t ConvertLeadingTwoByteUTF16(const char16* src,
+                                  size_t src_len,
+                                  char* dest,
+                                  size_t* dest_len) {
+#if defined(UTF_CONVERSION_DISPATCH_SSSE3)
+  if (g_cpu_features.Get().has_ssse3)
+    return ConvertLeadingTwoByteUTF16_SSSE3(src, src_len, dest, dest_len);
+#endif
+  *dest_len = 0;
+  return 0;
+}
+
 // Generalized Unicode converter -----------------------------------------------
 
 template<typename CHAR>
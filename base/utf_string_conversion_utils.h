@@ -78,6 +78,31 @@ inline size_t WriteUnicodeCharacter(uint32 code_point, std::wstring* output) {
 }
 #endif  // defined(WCHAR_T_IS_UTF32)
 
+// Bulk conversion -------------------------------------------------------------
+
+// Copies the ASCII characters at the start of |src| to |dest|, stopping at the
+// first non-ASCII character, and returns the number of characters copied.
+// |dest| must have room for |src_len| characters. These work on 16 characters
+// at a time with SSE2 where the build targets it.
+BASE_EXPORT size_t ConvertLeadingASCII(const char* src,
+                                       size_t src_len,
+                                       char16* dest);
+BASE_EXPORT size_t ConvertLeadingASCII(const char16* src,
+                                       size_t src_len,
+                                       char* dest);
+
+// Converts UTF-16 to UTF-8 in blocks of 8 code units, as long as every unit of
+// a block is below U+0800 (ASCII, Latin, Greek, Cyrillic, Hebrew, Arabic...),
+// which needs no validation. Stops before the first block which contains any
+// other unit, and returns the number of code units consumed, which may be
+// zero. |*dest_len| is set to the number of bytes written. |dest| must have
+// room for 3 bytes per unit of |src|. This needs SSSE3, and consumes nothing
+// when the CPU does not have it.
+BASE_EXPORT size_t ConvertLeadingTwoByteUTF16(const char16* src,
+                                              size_t src_len,
+                                              char* dest,
+                                              size_t* dest_len);
+
 // Generalized Unicode converter -----------------------------------------------
 
 // Guesses the length of the output in UTF-8 in bytes, clears that output
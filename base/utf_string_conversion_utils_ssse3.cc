@@ -0,0 +1,128 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The kernels in this file are built with SSSE3 enabled, and must only be
+// called once base::CPU has confirmed the processor supports it. See
+// ConvertLeadingTwoByteUTF16() in utf_string_conversion_utils.cc.
+
+#include "base/basictypes.h"
+#include "base/string16.h"
+#include "build/build_config.h"
+
+// Builds for other architectures, and host builds made without SSSE3, get a
+// kernel which never converts anything.
+#if defined(ARCH_CPU_X86_FAMILY) && \
+    (defined(__SSSE3__) || defined(COMPILER_MSVC))
+#define UTF_CONVERSION_USE_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+namespace base {
+
+#if defined(UTF_CONVERSION_USE_SSSE3)
+
+namespace {
+
+// Shuffles which gather the UTF-8 of four code units below U+0800 held as
+// lead byte | trail byte << 8, keeping only the lead byte of the ASCII ones.
+// Indexed by a mask with bit i set when unit i is ASCII. 0x80 selects a zero.
+const uint8 kCompactShuffles[16][8] = {
+  { 0, 1, 2, 3, 4, 5, 6, 7 },
+  { 0, 2, 3, 4, 5, 6, 7, 0x80 },
+  { 0, 1, 2, 4, 5, 6, 7, 0x80 },
+  { 0, 2, 4, 5, 6, 7, 0x80, 0x80 },
+  { 0, 1, 2, 3, 4, 6, 7, 0x80 },
+  { 0, 2, 3, 4, 6, 7, 0x80, 0x80 },
+  { 0, 1, 2, 4, 6, 7, 0x80, 0x80 },
+  { 0, 2, 4, 6, 7, 0x80, 0x80, 0x80 },
+  { 0, 1, 2, 3, 4, 5, 6, 0x80 },
+  { 0, 2, 3, 4, 5, 6, 0x80, 0x80 },
+  { 0, 1, 2, 4, 5, 6, 0x80, 0x80 },
+  { 0, 2, 4, 5, 6, 0x80, 0x80, 0x80 },
+  { 0, 1, 2, 3, 4, 6, 0x80, 0x80 },
+  { 0, 2, 3, 4, 6, 0x80, 0x80, 0x80 },
+  { 0, 1, 2, 4, 6, 0x80, 0x80, 0x80 },
+  { 0, 2, 4, 6, 0x80, 0x80, 0x80, 0x80 },
+};
+
+// The number of bytes kCompactShuffles[mask] keeps.
+const uint8 kCompactLengths[16] = {
+  8, 7, 7, 6, 7, 6, 6, 5, 7, 6, 6, 5, 6, 5, 5, 4,
+};
+
+__m128i LoadShuffle(int mask) {
+  return _mm_loadl_epi64(
+      reinterpret_cast<const __m128i*>(kCompactShuffles[mask]));
+}
+
+}  // namespace
+
+size_t ConvertLeadingTwoByteUTF16_SSSE3(const char16* src,
+                                        size_t src_len,
+                                        char* dest,
+                                        size_t* dest_len) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i non_ascii_bits = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i three_byte_bits = _mm_set1_epi16(static_cast<short>(0xF800));
+  const __m128i lead_marker = _mm_set1_epi16(0xC0);
+  const __m128i trail_bits = _mm_set1_epi16(0x3F);
+  const __m128i trail_marker = _mm_set1_epi16(0x80);
+  const __m128i high_half = _mm_set1_epi8(8);
+
+  size_t i = 0;
+  size_t written = 0;
+  for (; src_len - i >= 8; i += 8) {
+    __m128i units =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_and_si128(units, three_byte_bits), zero)) != 0xFFFF) {
+      break;
+    }
+
+    // Every unit as a two byte sequence: 110xxxxx 10xxxxxx.
+    __m128i lead = _mm_or_si128(_mm_srli_epi16(units, 6), lead_marker);
+    __m128i trail = _mm_slli_epi16(
+        _mm_or_si128(_mm_and_si128(units, trail_bits), trail_marker), 8);
+    __m128i two_byte = _mm_or_si128(lead, trail);
+
+    // ASCII units are kept as they are, and lose their zero high byte in the
+    // shuffle.
+    __m128i ascii =
+        _mm_cmpeq_epi16(_mm_and_si128(units, non_ascii_bits), zero);
+    __m128i bytes = _mm_or_si128(_mm_and_si128(ascii, units),
+                                 _mm_andnot_si128(ascii, two_byte));
+    int ascii_mask = _mm_movemask_epi8(_mm_packs_epi16(ascii, zero));
+    int low_mask = ascii_mask & 0xF;
+    int high_mask = ascii_mask >> 4;
+
+    // Each half of the block is compacted on its own, then the two are stored
+    // back to back. The stores write up to 16 bytes, which the 24 bytes the
+    // caller guarantees for 8 units leave room for.
+    __m128i shuffle = _mm_unpacklo_epi64(
+        LoadShuffle(low_mask),
+        _mm_add_epi8(LoadShuffle(high_mask), high_half));
+    bytes = _mm_shuffle_epi8(bytes, shuffle);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + written), bytes);
+    written += kCompactLengths[low_mask];
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + written),
+                     _mm_srli_si128(bytes, 8));
+    written += kCompactLengths[high_mask];
+  }
+  *dest_len = written;
+  return i;
+}
+
+#else  // defined(UTF_CONVERSION_USE_SSSE3)
+
+size_t ConvertLeadingTwoByteUTF16_SSSE3(const char16* src,
+                                        size_t src_len,
+                                        char* dest,
+                                        size_t* dest_len) {
+  *dest_len = 0;
+  return 0;
+}
+
+#endif  // defined(UTF_CONVERSION_USE_SSSE3)
+
+}  // namespace base
@@ -6,6 +6,7 @@
 
 #include "base/string_piece.h"
 #include "base/string_util.h"
+#include "base/third_party/icu/icu_utf.h"
 #include "base/utf_string_conversion_utils.h"
 
 using base::PrepareForUTF8Output;
@@ -41,13 +42,97 @@ bool ConvertUnicode(const SRC_CHAR* src,
   return success;
 }
 
+// UTF-8 <-> UTF-16 converters -------------------------------------------------
+
+// These are the conversions the browser does the most, so rather than go
+// through ConvertUnicode() one code point at a time, they copy runs of ASCII
+// (and, from UTF-16, of other characters below U+0800) with the bulk
+// converters, and decode the rest into an output buffer sized up front for
+// the worst case.
+
+bool ConvertUTF8ToUTF16(const char* src, size_t src_len, string16* output) {
+  // No UTF-8 sequence, valid or not, converts to more code units than it has
+  // bytes.
+  output->resize(src_len);
+  if (src_len == 0)
+    return true;
+
+  bool success = true;
+  char16* dest = &(*output)[0];
+  int32 src_len32 = static_cast<int32>(src_len);
+  size_t i = 0;
+  size_t written = 0;
+  while (i < src_len) {
+    size_t ascii = base::ConvertLeadingASCII(src + i, src_len - i,
+                                             dest + written);
+    i += ascii;
+    written += ascii;
+    while (i < src_len && static_cast<unsigned char>(src[i]) >= 0x80) {
+      int32 char_index = static_cast<int32>(i);
+      uint32 code_point;
+      if (!ReadUnicodeCharacter(src, src_len32, &char_index, &code_point)) {
+        code_point = 0xFFFD;
+        success = false;
+      }
+      CBU16_APPEND_UNSAFE(dest, written, code_point);
+      i = char_index + 1;
+    }
+  }
+  output->resize(written);
+  return success;
+}
+
+bool ConvertUTF16ToUTF8(const char16* src, size_t src_len,
+                        std::string* output) {
+  // Most strings are ASCII, so convert that much before sizing the output for
+  // the rest, which is at most three bytes per code unit.
+  output->resize(src_len);
+  if (src_len == 0)
+    return true;
+  size_t i = base::ConvertLeadingASCII(src, src_len, &(*output)[0]);
+  if (i == src_len)
+    return true;
+  output->resize(i + (src_len - i) * 3);
+
+  bool success = true;
+  char* dest = &(*output)[0];
+  int32 src_len32 = static_cast<int32>(src_len);
+  size_t written = i;
+  while (i < src_len) {
+    size_t block_written;
+    i += base::ConvertLeadingTwoByteUTF16(src + i, src_len - i,
+                                          dest + written, &block_written);
+    written += block_written;
+    while (i < src_len && src[i] >= 0x80) {
+      int32 char_index = static_cast<int32>(i);
+      uint32 code_point;
+      if (!ReadUnicodeCharacter(src, src_len32, &char_index, &code_point)) {
+        code_point = 0xFFFD;
+        success = false;
+      }
+      CBU8_APPEND_UNSAFE(dest, written, code_point);
+      i = char_index + 1;
+    }
+    size_t ascii = base::ConvertLeadingASCII(src + i, src_len - i,
+                                             dest + written);
+    i += ascii;
+    written += ascii;
+  }
+  output->resize(written);
+  return success;
+}
+
 }  // namespace
 
 // UTF-8 <-> Wide --------------------------------------------------------------
 
 bool WideToUTF8(const wchar_t* src, size_t src_len, std::string* output) {
+#if defined(WCHAR_T_IS_UTF16)
+  return ConvertUTF16ToUTF8(src, src_len, output);
+#else
   PrepareForUTF8Output(src, src_len, output);
   return ConvertUnicode(src, src_len, output);
+#endif
 }
 
 std::string WideToUTF8(const std::wstring& wide) {
@@ -59,8 +144,12 @@ std::string WideToUTF8(const std::wstring& wide) {
 }
 
 bool UTF8ToWide(const char* src, size_t src_len, std::wstring* output) {
+#if defined(WCHAR_T_IS_UTF16)
+  return ConvertUTF8ToUTF16(src, src_len, output);
+#else
   PrepareForUTF16Or32Output(src, src_len, output);
   return ConvertUnicode(src, src_len, output);
+#endif
 }
 
 std::wstring UTF8ToWide(const base::StringPiece& utf8) {
@@ -129,8 +218,7 @@ std::wstring UTF16ToWide(const string16& utf16) {
 #if defined(WCHAR_T_IS_UTF32)
 
 bool UTF8ToUTF16(const char* src, size_t src_len, string16* output) {
-  PrepareForUTF16Or32Output(src, src_len, output);
-  return ConvertUnicode(src, src_len, output);
+  return ConvertUTF8ToUTF16(src, src_len, output);
 }
 
 string16 UTF8ToUTF16(const base::StringPiece& utf8) {
@@ -142,8 +230,7 @@ string16 UTF8ToUTF16(const base::StringPiece& utf8) {
 }
 
 bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output) {
-  PrepareForUTF8Output(src, src_len, output);
-  return ConvertUnicode(src, src_len, output);
+  return ConvertUTF16ToUTF8(src, src_len, output);
 }
 
 std::string UTF16ToUTF8(const string16& utf16) {
@@ -0,0 +1,167 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversion_utils.h"
+#include "base/utf_string_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Phrases in several scripts, as UTF-8, which the corpora are built from.
+const char kEnglish[] = "Search the world's information, including webpages, "
+    "images, videos and more. ";
+const char kURL[] = "http://www.example.com/search?q=utf+conversion&hl=en"
+    "&source=hp ";
+const char kFrench[] = "Caf\xc3\xa9 cr\xc3\xa8me br\xc3\xbbl\xc3\xa9""e "
+    "\xc3\xa0 la fran\xc3\xa7""aise. ";
+const char kRussian[] = "\xd0\x9f\xd0\xbe\xd0\xb8\xd1\x81\xd0\xba "
+    "\xd1\x81\xd1\x82\xd1\x80\xd0\xb0\xd0\xbd\xd0\xb8\xd1\x86 \xd0\xbd\xd0\xb0 "
+    "\xd1\x80\xd1\x83\xd1\x81\xd1\x81\xd0\xba\xd0\xbe\xd0\xbc. ";
+const char kChinese[] = "\xe7\xbd\x91\xe9\xa1\xb5 \xe5\x9b\xbe\xe7\x89\x87 "
+    "\xe8\xb5\x84\xe8\xae\xaf\xe6\x9b\xb4\xe5\xa4\x9a \xc2\xbb ";
+const char kEmoji[] = "\xf0\x9f\x98\x80\xf0\x9f\x91\x8d ";
+
+// Concatenates |phrases| until the result is at least |size| bytes.
+std::string MakeCorpus(const char* const* phrases, size_t num_phrases,
+                       size_t size) {
+  std::string corpus;
+  for (size_t i = 0; corpus.size() < size; ++i)
+    corpus += phrases[i % num_phrases];
+  return corpus;
+}
+
+// The code point at a time conversion the bulk converters replaced, as a
+// reference.
+template<typename SRC_CHAR, typename DEST_STRING>
+void ConvertOneByOne(const SRC_CHAR* src, size_t src_len,
+                     DEST_STRING* output) {
+  output->clear();
+  int32 src_len32 = static_cast<int32>(src_len);
+  for (int32 i = 0; i < src_len32; i++) {
+    uint32 code_point;
+    if (!ReadUnicodeCharacter(src, src_len32, &i, &code_point))
+      code_point = 0xFFFD;
+    WriteUnicodeCharacter(code_point, output);
+  }
+}
+
+// Every benchmark converts roughly kBytesPerRun bytes of UTF-8.
+const size_t kBytesPerRun = 64 * 1024 * 1024;
+
+void LogThroughput(const char* name, const char* direction,
+                   const char* converter, size_t piece_size, size_t bytes,
+                   const PerfTimer& timer) {
+  LogPerfResult(StringPrintf("UTF_%s_%s_%s_%d", direction, name, converter,
+                             static_cast<int>(piece_size)).c_str(),
+                bytes / timer.Elapsed().InSecondsF() / (1024 * 1024), "MB/s");
+}
+
+void RunConversionBenchmark(const char* name, const std::string& corpus,
+                            size_t piece_size) {
+  ASSERT_LE(piece_size, corpus.size());
+  // Cut the pieces on character boundaries.
+  std::vector<std::string> utf8_pieces;
+  std::vector<string16> utf16_pieces;
+  size_t utf8_bytes = 0;
+  for (size_t begin = 0; begin + piece_size <= corpus.size();) {
+    size_t end = begin + piece_size;
+    while (end < corpus.size() && (corpus[end] & 0xC0) == 0x80)
+      ++end;
+    utf8_pieces.push_back(corpus.substr(begin, end - begin));
+    utf16_pieces.push_back(UTF8ToUTF16(utf8_pieces.back()));
+    utf8_bytes += end - begin;
+    begin = end;
+  }
+  int iterations = std::max<int>(1, kBytesPerRun / utf8_bytes);
+
+  string16 utf16;
+  std::string utf8;
+  {
+    PerfTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < utf8_pieces.size(); ++j)
+        UTF8ToUTF16(utf8_pieces[j].data(), utf8_pieces[j].size(), &utf16);
+    }
+    LogThroughput(name, "UTF8ToUTF16", "bulk", piece_size,
+                  utf8_bytes * iterations, timer);
+  }
+  {
+    PerfTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < utf8_pieces.size(); ++j)
+        ConvertOneByOne(utf8_pieces[j].data(), utf8_pieces[j].size(), &utf16);
+    }
+    LogThroughput(name, "UTF8ToUTF16", "reference", piece_size,
+                  utf8_bytes * iterations, timer);
+  }
+  {
+    PerfTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < utf16_pieces.size(); ++j)
+        UTF16ToUTF8(utf16_pieces[j].data(), utf16_pieces[j].size(), &utf8);
+    }
+    LogThroughput(name, "UTF16ToUTF8", "bulk", piece_size,
+                  utf8_bytes * iterations, timer);
+  }
+  {
+    PerfTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < utf16_pieces.size(); ++j) {
+        ConvertOneByOne(utf16_pieces[j].data(), utf16_pieces[j].size(),
+                        &utf8);
+      }
+    }
+    LogThroughput(name, "UTF16ToUTF8", "reference", piece_size,
+                  utf8_bytes * iterations, timer);
+  }
+}
+
+// Runs the benchmark on strings the size of a title or URL, and on strings
+// the size of a page's text.
+void RunCorpusBenchmarks(const char* name, const char* const* phrases,
+                         size_t num_phrases) {
+  std::string corpus = MakeCorpus(phrases, num_phrases, 1024 * 1024);
+  RunConversionBenchmark(name, corpus, 64);
+  RunConversionBenchmark(name, corpus, 64 * 1024);
+}
+
+}  // namespace
+
+TEST(UTFStringConversionsPerfTest, ASCII) {
+  const char* const kPhrases[] = { kEnglish, kURL };
+  RunCorpusBenchmarks("ascii", kPhrases, arraysize(kPhrases));
+}
+
+TEST(UTFStringConversionsPerfTest, Latin) {
+  const char* const kPhrases[] = { kFrench };
+  RunCorpusBenchmarks("latin", kPhrases, arraysize(kPhrases));
+}
+
+TEST(UTFStringConversionsPerfTest, Cyrillic) {
+  const char* const kPhrases[] = { kRussian };
+  RunCorpusBenchmarks("cyrillic", kPhrases, arraysize(kPhrases));
+}
+
+TEST(UTFStringConversionsPerfTest, CJK) {
+  const char* const kPhrases[] = { kChinese };
+  RunCorpusBenchmarks("cjk", kPhrases, arraysize(kPhrases));
+}
+
+// What a history or bookmarks database of a multilingual user looks like.
+TEST(UTFStringConversionsPerfTest, MixedScripts) {
+  const char* const kPhrases[] = {
+    kEnglish, kURL, kFrench, kRussian, kURL, kChinese, kEmoji,
+  };
+  RunCorpusBenchmarks("mixed", kPhrases, arraysize(kPhrases));
+}
+
+}  // namespace base
@@ -6,6 +6,7 @@
 #include "base/logging.h"
 #include "base/string_piece.h"
 #include "base/string_util.h"
+#include "base/utf_string_conversion_utils.h"
 #include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -40,6 +41,51 @@ const wchar_t* const kConvertRoundtripCases[] = {
 #endif
 };
 
+// Pieces the strings of the bulk conversion tests below are made of: ASCII
+// runs, one to four byte characters, and invalid sequences.
+const char* const kConversionPieces[] = {
+  "a",
+  "Google Video ",
+  "abcdefghijklmnopqrstuvwxyz",
+  "\xc3\xa9",                // U+00E9
+  "\xd0\x9f\xd0\xbe\xd0\xb8",  // U+041F U+043E U+0438
+  "\xdf\xbf",                // U+07FF
+  "\xe0\xa0\x80",            // U+0800
+  "\xe4\xb8\xad\xe6\x96\x87",  // U+4E2D U+6587
+  "\xf0\x9f\x98\x80",        // U+1F600
+  "\xff",                    // Invalid byte.
+  "\xc3",                    // Truncated sequence.
+  "\xed\xa0\x80",            // Encoded surrogate.
+};
+
+// Builds a pseudo-random string from kConversionPieces.
+std::string MakeConversionString(uint32* seed, size_t num_pieces) {
+  std::string result;
+  for (size_t i = 0; i < num_pieces; ++i) {
+    *seed = *seed * 1103515245 + 12345;
+    result += kConversionPieces[(*seed >> 16) % arraysize(kConversionPieces)];
+  }
+  return result;
+}
+
+// The per code point conversion the bulk converters must agree with.
+template<typename SRC_CHAR, typename DEST_STRING>
+bool ConvertOneByOne(const SRC_CHAR* src, size_t src_len,
+                     DEST_STRING* output) {
+  bool success = true;
+  output->clear();
+  int32 src_len32 = static_cast<int32>(src_len);
+  for (int32 i = 0; i < src_len32; i++) {
+    uint32 code_point;
+    if (!ReadUnicodeCharacter(src, src_len32, &i, &code_point)) {
+      code_point = 0xFFFD;
+      success = false;
+    }
+    WriteUnicodeCharacter(code_point, output);
+  }
+  return success;
+}
+
 }  // namespace
 
 TEST(UTFStringConversionsTest, ConvertUTF8AndWide) {
@@ -208,4 +254,56 @@ TEST(UTFStringConversionsTest, ConvertMultiString) {
   EXPECT_EQ(expected, converted);
 }
 
+TEST(UTFStringConversionsTest, BulkConversionsMatchOneByOne) {
+  uint32 seed = 1;
+  for (size_t num_pieces = 0; num_pieces < 40; ++num_pieces) {
+    for (int repeat = 0; repeat < 20; ++repeat) {
+      std::string utf8 = MakeConversionString(&seed, num_pieces);
+
+      string16 expected_utf16;
+      bool expected_valid =
+          ConvertOneByOne(utf8.data(), utf8.length(), &expected_utf16);
+      string16 utf16;
+      EXPECT_EQ(expected_valid,
+                UTF8ToUTF16(utf8.data(), utf8.length(), &utf16)) << utf8;
+      EXPECT_EQ(expected_utf16, utf16) << utf8;
+
+      // Lone surrogates make invalid UTF-16.
+      if (repeat % 4 == 0 && !utf16.empty())
+        utf16[utf16.length() / 2] = 0xD800;
+      std::string expected_utf8;
+      expected_valid =
+          ConvertOneByOne(utf16.data(), utf16.length(), &expected_utf8);
+      std::string converted;
+      EXPECT_EQ(expected_valid,
+                UTF16ToUTF8(utf16.data(), utf16.length(), &converted)) << utf8;
+      EXPECT_EQ(expected_utf8, converted) << utf8;
+    }
+  }
+}
+
+TEST(UTFStringConversionsTest, ConvertLeadingASCII) {
+  std::string ascii = "The quick brown fox jumps over the lazy dog, twice.";
+  for (size_t length = 0; length <= ascii.length(); ++length) {
+    for (size_t stop = 0; stop <= length; ++stop) {
+      std::string utf8 = ascii.substr(0, length);
+      string16 utf16(ASCIIToUTF16(utf8));
+      if (stop < length) {
+        utf8[stop] = '\xc3';
+        utf16[stop] = 0x100;
+      }
+
+      string16 widened(length, 0);
+      EXPECT_EQ(stop, ConvertLeadingASCII(utf8.data(), length,
+                                          length ? &widened[0] : NULL));
+      EXPECT_EQ(utf16.substr(0, stop), widened.substr(0, stop));
+
+      std::string narrowed(length, '\0');
+      EXPECT_EQ(stop, ConvertLeadingASCII(utf16.data(), length,
+                                          length ? &narrowed[0] : NULL));
+      EXPECT_EQ(utf8.substr(0, stop), narrowed.substr(0, stop));
+    }
+  }
+}
+
 }  // base
@@ -267,6 +267,7 @@
           'type': 'none',
           'dependencies': [
             'chromium_builder_qa', # needed for pyauto
+            '../base/base.gyp:base_perftests',
             '../chrome/chrome.gyp:performance_browser_tests',
             '../chrome/chrome.gyp:performance_ui_tests',
             '../chrome/chrome.gyp:sync_performance_tests',
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/bind.h"
 #include "base/command_line.h"
 #include "base/i18n/break_iterator.h"
 #include "base/logging.h"
@@ -40,10 +41,23 @@
 #include "net/base/net_util.h"
 #include "net/base/registry_controlled_domains/registry_controlled_domain.h"
 
+using history::HistoryScoringJob;
 using history::InMemoryURLIndex;
 using history::ScoredHistoryMatch;
 using history::ScoredHistoryMatches;
 
+namespace {
+
+// Below this many candidates, scoring them takes less time than handing them
+// to other threads.
+const size_t kMinCandidatesToScoreInParallel = 100;
+
+// The number of pieces the candidates are split into, and so the number of
+// threads of the blocking pool scoring them at most.
+const size_t kScoringTaskCount = 4;
+
+}  // namespace
+
 bool HistoryQuickProvider::disabled_ = false;
 
 HistoryQuickProvider::HistoryQuickProvider(
@@ -52,7 +66,9 @@ HistoryQuickProvider::HistoryQuickProvider(
     : HistoryProvider(listener, profile,
           AutocompleteProvider::TYPE_HISTORY_QUICK),
       languages_(profile_->GetPrefs()->GetString(prefs::kAcceptLanguages)),
-      reorder_for_inlining_(false) {
+      reorder_for_inlining_(false),
+      score_in_parallel_(CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableParallelHistoryQuickScoring)) {
   enum InliningOption {
     INLINING_PROHIBITED = 0,
     INLINING_ALLOWED = 1,
@@ -119,6 +135,8 @@ HistoryQuickProvider::HistoryQuickProvider(
 void HistoryQuickProvider::Start(const AutocompleteInput& input,
                                  bool minimal_changes) {
   matches_.clear();
+  CancelScoring();
+  done_ = true;
   if (disabled_)
     return;
 
@@ -138,19 +156,42 @@ void HistoryQuickProvider::Start(const AutocompleteInput& input,
   // autocomplete behavior here.
   if (GetIndex()) {
     base::TimeTicks start_time = base::TimeTicks::Now();
-    DoAutocomplete();
-    if (input.text().length() < 6) {
-      base::TimeTicks end_time = base::TimeTicks::Now();
-      std::string name = "HistoryQuickProvider.QueryIndexTime." +
-          base::IntToString(input.text().length());
-      base::Histogram* counter = base::Histogram::FactoryGet(
-          name, 1, 1000, 50, base::Histogram::kUmaTargetedHistogramFlag);
-      counter->Add(static_cast<int>((end_time - start_time).InMilliseconds()));
+    string16 term_string = autocomplete_input_.text();
+    if (score_in_parallel_) {
+      scoped_refptr<HistoryScoringJob> scoring_job(
+          GetIndex()->ScoringJobForTerms(term_string));
+      if (scoring_job.get() &&
+          input.matches_requested() == AutocompleteInput::ALL_MATCHES &&
+          scoring_job->candidate_count() >= kMinCandidatesToScoreInParallel) {
+        // Typing the next character starts a new search, which cancels this
+        // one.
+        scoring_job_ = scoring_job;
+        done_ = false;
+        scoring_job_->Start(
+            content::BrowserThread::GetBlockingPool(), kScoringTaskCount,
+            base::Bind(&HistoryQuickProvider::OnScoringDone,
+                       base::Unretained(this), start_time));
+        return;
+      }
+      ScoredHistoryMatches matches;
+      if (scoring_job.get()) {
+        matches = scoring_job->Score();
+        GetIndex()->RecordScoredItemCount(matches.size());
+      }
+      DoAutocomplete(matches);
+    } else {
+      DoAutocomplete(GetIndex()->HistoryItemsForTerms(term_string));
     }
+    RecordQueryIndexTime(start_time);
     UpdateStarredStateOfMatches();
   }
 }
 
+void HistoryQuickProvider::Stop(bool clear_cached_results) {
+  CancelScoring();
+  done_ = true;
+}
+
 void HistoryQuickProvider::DeleteMatch(const AutocompleteMatch& match) {
   DCHECK(match.deletable);
   DCHECK(match.destination_url.is_valid());
@@ -159,12 +200,12 @@ void HistoryQuickProvider::DeleteMatch(const AutocompleteMatch& match) {
   DeleteMatchFromMatches(match);
 }
 
-HistoryQuickProvider::~HistoryQuickProvider() {}
+HistoryQuickProvider::~HistoryQuickProvider() {
+  // The scoring callback doesn't hold a reference to this provider.
+  CancelScoring();
+}
 
-void HistoryQuickProvider::DoAutocomplete() {
-  // Get the matching URLs from the DB.
-  string16 term_string = autocomplete_input_.text();
-  ScoredHistoryMatches matches = GetIndex()->HistoryItemsForTerms(term_string);
+void HistoryQuickProvider::DoAutocomplete(ScoredHistoryMatches matches) {
   if (matches.empty())
     return;
 
@@ -302,6 +343,36 @@ void HistoryQuickProvider::DoAutocomplete() {
   }
 }
 
+void HistoryQuickProvider::OnScoringDone(base::TimeTicks start_time,
+                                         const ScoredHistoryMatches& matches) {
+  scoring_job_ = NULL;
+  if (GetIndex())
+    GetIndex()->RecordScoredItemCount(matches.size());
+  DoAutocomplete(matches);
+  RecordQueryIndexTime(start_time);
+  UpdateStarredStateOfMatches();
+  done_ = true;
+  listener_->OnProviderUpdate(true);
+}
+
+void HistoryQuickProvider::RecordQueryIndexTime(base::TimeTicks start_time) {
+  if (autocomplete_input_.text().length() < 6) {
+    base::TimeTicks end_time = base::TimeTicks::Now();
+    std::string name = "HistoryQuickProvider.QueryIndexTime." +
+        base::IntToString(autocomplete_input_.text().length());
+    base::Histogram* counter = base::Histogram::FactoryGet(
+        name, 1, 1000, 50, base::Histogram::kUmaTargetedHistogramFlag);
+    counter->Add(static_cast<int>((end_time - start_time).InMilliseconds()));
+  }
+}
+
+void HistoryQuickProvider::CancelScoring() {
+  if (scoring_job_.get()) {
+    scoring_job_->Cancel();
+    scoring_job_ = NULL;
+  }
+}
+
 AutocompleteMatch HistoryQuickProvider::QuickMatchToACMatch(
     const ScoredHistoryMatch& history_match,
     int score) {
@@ -9,9 +9,12 @@
 
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
+#include "base/time.h"
 #include "chrome/browser/autocomplete/autocomplete_input.h"
 #include "chrome/browser/autocomplete/autocomplete_match.h"
 #include "chrome/browser/autocomplete/history_provider.h"
+#include "chrome/browser/history/history_scoring_job.h"
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/history/in_memory_url_index.h"
 
@@ -25,16 +28,19 @@ struct ScoredHistoryMatch;
 // This class is an autocomplete provider (a pseudo-internal component of
 // the history system) which quickly (and synchronously) provides matching
 // results from recently or frequently visited sites in the profile's
-// history.
+// history. With --enable-parallel-history-quick-scoring, a search with many
+// candidates is instead scored on the blocking pool, and its results arrive
+// asynchronously.
 class HistoryQuickProvider : public HistoryProvider {
  public:
   HistoryQuickProvider(AutocompleteProviderListener* listener,
                        Profile* profile);
 
-  // AutocompleteProvider. |minimal_changes| is ignored since there is no asynch
-  // completion performed.
+  // AutocompleteProvider. |minimal_changes| is ignored, since the scoring of
+  // the previous input, if still running, is of no use to the new one.
   virtual void Start(const AutocompleteInput& input,
                      bool minimal_changes) OVERRIDE;
+  virtual void Stop(bool clear_cached_results) OVERRIDE;
 
   virtual void DeleteMatch(const AutocompleteMatch& match) OVERRIDE;
 
@@ -52,8 +58,19 @@ class HistoryQuickProvider : public HistoryProvider {
 
   virtual ~HistoryQuickProvider();
 
-  // Performs the autocomplete matching and scoring.
-  void DoAutocomplete();
+  // Turns the scored history items in |matches| into autocomplete matches.
+  void DoAutocomplete(history::ScoredHistoryMatches matches);
+
+  // Called with the results of |scoring_job_|, which was started at
+  // |start_time|.
+  void OnScoringDone(base::TimeTicks start_time,
+                     const history::ScoredHistoryMatches& matches);
+
+  // Records how long it took to query the index, for short inputs.
+  void RecordQueryIndexTime(base::TimeTicks start_time);
+
+  // Cancels |scoring_job_|, if any.
+  void CancelScoring();
 
   // Creates an AutocompleteMatch from |history_match|, assigning it
   // the score |score|.
@@ -97,6 +114,12 @@ class HistoryQuickProvider : public HistoryProvider {
   // and make the best behavior the default.)
   bool reorder_for_inlining_;
 
+  // True if searches with many candidates are scored on the blocking pool.
+  bool score_in_parallel_;
+
+  // The scoring of the current input, while it runs on the blocking pool.
+  scoped_refptr<history::HistoryScoringJob> scoring_job_;
+
   // Only used for testing.
   scoped_ptr<history::InMemoryURLIndex> index_for_testing_;
 
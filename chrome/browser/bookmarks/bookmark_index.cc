@@ -8,14 +8,17 @@
 #include <iterator>
 #include <list>
 
+#include "base/command_line.h"
 #include "base/i18n/case_conversion.h"
 #include "base/string16.h"
 #include "chrome/browser/bookmarks/bookmark_model.h"
+#include "chrome/browser/bookmarks/bookmark_ngram_index.h"
 #include "chrome/browser/bookmarks/bookmark_utils.h"
 #include "chrome/browser/history/history_database.h"
 #include "chrome/browser/history/history_service_factory.h"
 #include "chrome/browser/history/query_parser.h"
 #include "chrome/browser/profiles/profile.h"
+#include "chrome/common/chrome_switches.h"
 #include "ui/base/l10n/l10n_util.h"
 
 // Used when finding the set of bookmarks that match a query. Each match
@@ -54,12 +57,19 @@ BookmarkIndex::NodeSet::const_iterator BookmarkIndex::Match::nodes_end() const {
 
 BookmarkIndex::BookmarkIndex(content::BrowserContext* browser_context)
     : browser_context_(browser_context) {
+  if (CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableBookmarkNGramIndex))
+    ngram_index_.reset(new BookmarkNGramIndex);
 }
 
 BookmarkIndex::~BookmarkIndex() {
 }
 
 void BookmarkIndex::Add(const BookmarkNode* node) {
+  if (ngram_index_.get()) {
+    ngram_index_->Add(node);
+    return;
+  }
   if (!node->is_url())
     return;
   std::vector<string16> terms = ExtractQueryWords(node->GetTitle());
@@ -68,6 +78,10 @@ void BookmarkIndex::Add(const BookmarkNode* node) {
 }
 
 void BookmarkIndex::Remove(const BookmarkNode* node) {
+  if (ngram_index_.get()) {
+    ngram_index_->Remove(node);
+    return;
+  }
   if (!node->is_url())
     return;
 
@@ -80,6 +94,12 @@ void BookmarkIndex::GetBookmarksWithTitlesMatching(
     const string16& query,
     size_t max_count,
     std::vector<bookmark_utils::TitleMatch>* results) {
+  if (ngram_index_.get()) {
+    ngram_index_->GetBookmarksWithTitlesMatching(query, max_count,
+                                                 GetURLDatabase(), results);
+    return;
+  }
+
   std::vector<string16> terms = ExtractQueryWords(query);
   if (terms.empty())
     return;
@@ -110,15 +130,18 @@ void BookmarkIndex::GetBookmarksWithTitlesMatching(
     AddMatchToResults(i->first, &parser, query_nodes.get(), results);
 }
 
-void BookmarkIndex::SortMatches(const Matches& matches,
-                                NodeTypedCountPairs* node_typed_counts) const {
+history::URLDatabase* BookmarkIndex::GetURLDatabase() const {
   HistoryService* const history_service = browser_context_ ?
       HistoryServiceFactory::GetForProfile(
           Profile::FromBrowserContext(browser_context_),
           Profile::EXPLICIT_ACCESS) : NULL;
 
-  history::URLDatabase* url_db = history_service ?
-      history_service->InMemoryDatabase() : NULL;
+  return history_service ? history_service->InMemoryDatabase() : NULL;
+}
+
+void BookmarkIndex::SortMatches(const Matches& matches,
+                                NodeTypedCountPairs* node_typed_counts) const {
+  history::URLDatabase* url_db = GetURLDatabase();
 
   for (Matches::const_iterator i = matches.begin(); i != matches.end(); ++i)
     ExtractBookmarkNodePairs(url_db, *i, node_typed_counts);
@@ -10,8 +10,10 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/string16.h"
 
+class BookmarkNGramIndex;
 class BookmarkNode;
 class QueryNode;
 class QueryParser;
@@ -35,6 +37,9 @@ class URLDatabase;
 // BookmarkIndex maintains the index (index_) as a map of sets. The map (type
 // Index) maps from a lower case string to the set (type NodeSet) of
 // BookmarkNodes that contain that string in their title.
+//
+// With the --enable-bookmark-ngram-index switch, a BookmarkNGramIndex is kept
+// instead, and matches words anywhere in the title words.
 class BookmarkIndex {
  public:
   explicit BookmarkIndex(content::BrowserContext* browser_context);
@@ -64,6 +69,10 @@ class BookmarkIndex {
   typedef std::pair<const BookmarkNode*, int> NodeTypedCountPair;
   typedef std::vector<NodeTypedCountPair> NodeTypedCountPairs;
 
+  // Returns the in-memory database of the history service, which has the typed
+  // counts of URLs, or NULL if there is none.
+  history::URLDatabase* GetURLDatabase() const;
+
   // Extracts |matches.nodes| into NodeTypedCountPairs, sorts the pairs in
   // decreasing order of typed count, and then de-dupes the matches.
   void SortMatches(const Matches& matches,
@@ -129,6 +138,9 @@ class BookmarkIndex {
 
   Index index_;
 
+  // Used in place of |index_| if non-NULL.
+  scoped_ptr<BookmarkNGramIndex> ngram_index_;
+
   content::BrowserContext* browser_context_;
 
   DISALLOW_COPY_AND_ASSIGN(BookmarkIndex);
@@ -0,0 +1,194 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/bookmarks/bookmark_index.h"
+#include "chrome/browser/bookmarks/bookmark_model.h"
+#include "chrome/browser/bookmarks/bookmark_ngram_index.h"
+#include "chrome/browser/bookmarks/bookmark_utils.h"
+#include "chrome/browser/history/in_memory_database.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Many more bookmarks than most users have, so the differences show.
+const int kBookmarkCount = 50000;
+
+// How many times each query is run.
+const int kQueryRepeatCount = 20;
+
+// As many results as the bookmark provider asks for.
+const size_t kMaxMatches = 3;
+
+// The vocabulary of the synthetic titles.
+const char* const kSyllables[] = {
+  "ba", "ko", "ri", "tem", "lo", "sa", "ven", "di", "mar", "nu", "pe", "ga",
+  "zo", "fli", "ter", "ca", "mon", "ex", "ple", "ad", "ro", "ti", "sun", "que",
+};
+
+// The kinds of queries typed, by name.
+struct Query {
+  const char* name;
+  const char* text;
+};
+
+const Query kQueries[] = {
+  { "Short", "ba" },
+  { "Prefix", "kori" },
+  { "MidWord", "emlo" },
+  { "TwoWords", "sa ven" },
+  { "Phrase", "\"bako ri\"" },
+};
+
+// A linear congruential generator, so the bookmarks are the same on every run.
+class Random {
+ public:
+  Random() : state_(42) {}
+  int Next(int limit) {
+    state_ = state_ * 1103515245 + 12345;
+    return static_cast<int>((state_ >> 16) % limit);
+  }
+  // Leans towards small values, like the popularity of words.
+  int NextSkewed(int limit) {
+    return std::min(Next(limit), Next(limit));
+  }
+
+ private:
+  uint32 state_;
+};
+
+std::string MakeWord(int index) {
+  std::string word;
+  const int kSyllableCount = arraysize(kSyllables);
+  do {
+    word += kSyllables[index % kSyllableCount];
+    index /= kSyllableCount;
+  } while (index);
+  return word;
+}
+
+// Makes the bookmarks, and the history rows giving the typed counts of some of
+// their URLs.
+void MakeBookmarks(ScopedVector<BookmarkNode>* nodes,
+                   std::vector<history::URLRow>* rows) {
+  Random random;
+  for (int i = 0; i < kBookmarkCount; ++i) {
+    GURL url(base::StringPrintf("http://www.site%d.com/page%d.html",
+                                random.NextSkewed(5000), i));
+    std::string title;
+    for (int words = 2 + random.Next(5); words; --words) {
+      if (!title.empty())
+        title += ' ';
+      title += MakeWord(random.NextSkewed(5000));
+    }
+    BookmarkNode* node = new BookmarkNode(url);
+    node->SetTitle(UTF8ToUTF16(title));
+    nodes->push_back(node);
+
+    if (random.Next(3) == 0) {
+      history::URLRow row(url);
+      row.set_typed_count(1 + random.Next(20));
+      rows->push_back(row);
+    }
+  }
+}
+
+// Runs each of the queries against |index|, logging the average time taken by
+// each kind.
+template <class Index>
+void RunQueries(Index* index, const char* name) {
+  for (size_t i = 0; i < arraysize(kQueries); ++i) {
+    string16 query = ASCIIToUTF16(kQueries[i].text);
+    size_t matches = 0;
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (int j = 0; j < kQueryRepeatCount; ++j) {
+      std::vector<bookmark_utils::TitleMatch> results;
+      index->GetBookmarksWithTitlesMatching(query, kMaxMatches, &results);
+      matches += results.size();
+    }
+    base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+    LogPerfResult(base::StringPrintf("Bookmark_Query%s_%s",
+                                     kQueries[i].name, name).c_str(),
+                  elapsed.InMillisecondsF() / kQueryRepeatCount, "ms");
+    LogPerfResult(base::StringPrintf("Bookmark_Matches%s_%s",
+                                     kQueries[i].name, name).c_str(),
+                  matches / kQueryRepeatCount, "matches");
+  }
+}
+
+// Gives BookmarkNGramIndex the signature of BookmarkIndex for RunQueries().
+class NGramIndexWithURLDatabase {
+ public:
+  NGramIndexWithURLDatabase(BookmarkNGramIndex* index,
+                            history::URLDatabase* url_db)
+      : index_(index),
+        url_db_(url_db) {
+  }
+
+  void GetBookmarksWithTitlesMatching(
+      const string16& query,
+      size_t max_count,
+      std::vector<bookmark_utils::TitleMatch>* results) {
+    index_->GetBookmarksWithTitlesMatching(query, max_count, url_db_, results);
+  }
+
+ private:
+  BookmarkNGramIndex* index_;
+  history::URLDatabase* url_db_;
+};
+
+}  // namespace
+
+// Compares the word index of BookmarkIndex with BookmarkNGramIndex, which also
+// finds words in the middle of title words, for the time taken to index a
+// large number of bookmarks and to answer each kind of query.
+TEST(BookmarkIndexPerfTest, WordIndexAgainstNGramIndex) {
+  ScopedVector<BookmarkNode> nodes;
+  std::vector<history::URLRow> rows;
+  MakeBookmarks(&nodes, &rows);
+
+  BookmarkIndex word_index(NULL);
+  {
+    PerfTimeLogger timer("Bookmark_Index_words");
+    for (size_t i = 0; i < nodes.size(); ++i)
+      word_index.Add(nodes[i]);
+  }
+  RunQueries(&word_index, "words");
+
+  BookmarkNGramIndex ngram_index;
+  {
+    PerfTimeLogger timer("Bookmark_Index_ngrams");
+    for (size_t i = 0; i < nodes.size(); ++i)
+      ngram_index.Add(nodes[i]);
+  }
+  LogPerfResult("Bookmark_Keys_ngrams", ngram_index.key_count(), "keys");
+  LogPerfResult("Bookmark_Postings_ngrams", ngram_index.GetPostingCount(),
+                "postings");
+  NGramIndexWithURLDatabase ngrams(&ngram_index, NULL);
+  RunQueries(&ngrams, "ngrams");
+
+  // The cost of ranking the matches by their typed counts.
+  history::InMemoryDatabase url_db;
+  ASSERT_TRUE(url_db.InitFromScratch());
+  for (size_t i = 0; i < rows.size(); ++i)
+    url_db.AddURL(rows[i]);
+  NGramIndexWithURLDatabase ranked_ngrams(&ngram_index, &url_db);
+  RunQueries(&ranked_ngrams, "ngrams_typed");
+
+  {
+    PerfTimeLogger timer("Bookmark_Remove_ngrams");
+    for (size_t i = 0; i < nodes.size(); ++i)
+      ngram_index.Remove(nodes[i]);
+  }
+  EXPECT_EQ(0U, ngram_index.key_count());
+}
@@ -0,0 +1,353 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/bookmarks/bookmark_journal.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "base/values.h"
+#include "chrome/browser/bookmarks/bookmark_codec.h"
+#include "chrome/browser/bookmarks/bookmark_model.h"
+#include "googleurl/src/gurl.h"
+
+using base::Time;
+
+namespace {
+
+// Keys of the header.
+const char kJournalVersionKey[] = "journal";
+const char kSnapshotSizeKey[] = "size";
+
+// Current version of the journal.
+const int kCurrentJournalVersion = 1;
+
+// Keys of the records.
+const char kOpKey[] = "op";
+const char kParentKey[] = "parent";
+const char kIndexKey[] = "index";
+const char kNodeKey[] = "node";
+
+// Possible values for kOpKey.
+const char kOpNode[] = "node";
+const char kOpRemove[] = "remove";
+const char kOpOrder[] = "order";
+
+typedef std::map<int64, BookmarkNode*> IDToNodeMap;
+
+std::string ToLine(const Value& value) {
+  std::string line;
+  base::JSONWriter::Write(&value, &line);
+  line.push_back('\n');
+  return line;
+}
+
+std::string TimeToString(const Time& time) {
+  return base::Int64ToString(time.ToInternalValue());
+}
+
+bool GetID(const DictionaryValue& value, const char* key, int64* id) {
+  std::string id_string;
+  return value.GetString(key, &id_string) &&
+      base::StringToInt64(id_string, id);
+}
+
+Time GetTime(const DictionaryValue& value, const char* key) {
+  std::string time_string;
+  int64 internal_time = 0;
+  if (value.GetString(key, &time_string))
+    base::StringToInt64(time_string, &internal_time);
+  return Time::FromInternalValue(internal_time);
+}
+
+void AddToMap(BookmarkNode* node, IDToNodeMap* nodes) {
+  (*nodes)[node->id()] = node;
+  for (int i = 0; i < node->child_count(); ++i)
+    AddToMap(node->GetChild(i), nodes);
+}
+
+void RemoveFromMap(BookmarkNode* node, IDToNodeMap* nodes) {
+  nodes->erase(node->id());
+  for (int i = 0; i < node->child_count(); ++i)
+    RemoveFromMap(node->GetChild(i), nodes);
+}
+
+BookmarkNode* FindNode(const IDToNodeMap& nodes, int64 id) {
+  IDToNodeMap::const_iterator i = nodes.find(id);
+  return i == nodes.end() ? NULL : i->second;
+}
+
+// The permanent nodes are neither moved nor removed, nor are their titles
+// changed.
+bool IsPermanentNode(const BookmarkNode* node) {
+  return node->type() != BookmarkNode::URL &&
+      node->type() != BookmarkNode::FOLDER;
+}
+
+// Applies a record of a node having been added, moved or changed. Nothing is
+// changed unless the record can be applied.
+bool ApplyNode(const DictionaryValue& record,
+               IDToNodeMap* nodes,
+               int64* max_id) {
+  int64 parent_id;
+  int index;
+  const DictionaryValue* value;
+  int64 id;
+  std::string type;
+  if (!GetID(record, kParentKey, &parent_id) ||
+      !record.GetInteger(kIndexKey, &index) ||
+      !record.GetDictionary(kNodeKey, &value) ||
+      !GetID(*value, BookmarkCodec::kIdKey, &id) ||
+      !value->GetString(BookmarkCodec::kTypeKey, &type) ||
+      (type != BookmarkCodec::kTypeURL && type != BookmarkCodec::kTypeFolder)) {
+    return false;
+  }
+  bool is_url = type == BookmarkCodec::kTypeURL;
+
+  GURL url;
+  if (is_url) {
+    std::string url_string;
+    if (!value->GetString(BookmarkCodec::kURLKey, &url_string))
+      return false;
+    url = GURL(url_string);
+    if (!url.is_valid())
+      return false;
+  }
+
+  BookmarkNode* node = FindNode(*nodes, id);
+  if (node && node->is_url() != is_url)
+    return false;
+
+  if (!node || !IsPermanentNode(node)) {
+    BookmarkNode* parent = FindNode(*nodes, parent_id);
+    if (!parent || !parent->is_folder() || (node && parent->HasAncestor(node)))
+      return false;
+
+    if (node) {
+      node->parent()->Remove(node);
+    } else {
+      node = new BookmarkNode(id, url);
+      node->set_type(is_url ? BookmarkNode::URL : BookmarkNode::FOLDER);
+      (*nodes)[id] = node;
+      *max_id = std::max(*max_id, id + 1);
+    }
+    parent->Add(node, std::max(0, std::min(index, parent->child_count())));
+
+    // The titles of the permanent nodes are localized rather than stored.
+    string16 title;
+    value->GetString(BookmarkCodec::kNameKey, &title);
+    node->SetTitle(title);
+    if (is_url)
+      node->set_url(url);
+  }
+
+  node->set_date_added(GetTime(*value, BookmarkCodec::kDateAddedKey));
+  if (!is_url) {
+    node->set_date_folder_modified(
+        GetTime(*value, BookmarkCodec::kDateModifiedKey));
+  }
+  std::string meta_info;
+  value->GetString(BookmarkCodec::kMetaInfo, &meta_info);
+  node->set_meta_info_str(meta_info);
+  return true;
+}
+
+// Applies a record of a node having been removed.
+bool ApplyRemove(const DictionaryValue& record, IDToNodeMap* nodes) {
+  int64 id;
+  if (!GetID(record, BookmarkCodec::kIdKey, &id))
+    return false;
+  BookmarkNode* node = FindNode(*nodes, id);
+  if (!node || IsPermanentNode(node))
+    return false;
+
+  RemoveFromMap(node, nodes);
+  delete node->parent()->Remove(node);
+  return true;
+}
+
+// Applies a record of the children of a folder having been reordered. The
+// children must be those the folder has.
+bool ApplyChildOrder(const DictionaryValue& record, IDToNodeMap* nodes) {
+  int64 id;
+  const ListValue* child_ids;
+  if (!GetID(record, BookmarkCodec::kIdKey, &id) ||
+      !record.GetList(BookmarkCodec::kChildrenKey, &child_ids)) {
+    return false;
+  }
+  BookmarkNode* parent = FindNode(*nodes, id);
+  if (!parent || static_cast<int>(child_ids->GetSize()) !=
+      parent->child_count()) {
+    return false;
+  }
+
+  std::vector<BookmarkNode*> children;
+  std::set<BookmarkNode*> seen;
+  for (size_t i = 0; i < child_ids->GetSize(); ++i) {
+    std::string id_string;
+    int64 child_id;
+    if (!child_ids->GetString(i, &id_string) ||
+        !base::StringToInt64(id_string, &child_id)) {
+      return false;
+    }
+    BookmarkNode* child = FindNode(*nodes, child_id);
+    if (!child || child->parent() != parent || !seen.insert(child).second)
+      return false;
+    children.push_back(child);
+  }
+
+  for (size_t i = 0; i < children.size(); ++i)
+    parent->Remove(children[i]);
+  for (size_t i = 0; i < children.size(); ++i)
+    parent->Add(children[i], static_cast<int>(i));
+  return true;
+}
+
+bool ApplyRecord(const std::string& line, IDToNodeMap* nodes, int64* max_id) {
+  scoped_ptr<Value> value(base::JSONReader::Read(line));
+  if (!value.get() || !value->IsType(Value::TYPE_DICTIONARY))
+    return false;
+  const DictionaryValue* record = static_cast<const DictionaryValue*>(
+      value.get());
+
+  std::string op;
+  if (!record->GetString(kOpKey, &op))
+    return false;
+  if (op == kOpNode)
+    return ApplyNode(*record, nodes, max_id);
+  if (op == kOpRemove)
+    return ApplyRemove(*record, nodes);
+  if (op == kOpOrder)
+    return ApplyChildOrder(*record, nodes);
+  return false;
+}
+
+// Returns true if |line| is the header of a journal following the bookmarks
+// file with the given checksum and size.
+bool IsHeaderFor(const std::string& line,
+                 const std::string& snapshot_checksum,
+                 int64 snapshot_size) {
+  scoped_ptr<Value> value(base::JSONReader::Read(line));
+  if (!value.get() || !value->IsType(Value::TYPE_DICTIONARY))
+    return false;
+  const DictionaryValue* header = static_cast<const DictionaryValue*>(
+      value.get());
+
+  int version;
+  std::string checksum;
+  int64 size;
+  return header->GetInteger(kJournalVersionKey, &version) &&
+      version == kCurrentJournalVersion &&
+      header->GetString(BookmarkCodec::kChecksumKey, &checksum) &&
+      checksum == snapshot_checksum &&
+      GetID(*header, kSnapshotSizeKey, &size) &&
+      size == snapshot_size;
+}
+
+}  // namespace
+
+namespace bookmark_journal {
+
+std::string EncodeHeader(const std::string& snapshot_checksum,
+                         int64 snapshot_size) {
+  DictionaryValue header;
+  header.SetInteger(kJournalVersionKey, kCurrentJournalVersion);
+  header.SetString(BookmarkCodec::kChecksumKey, snapshot_checksum);
+  header.SetString(kSnapshotSizeKey, base::Int64ToString(snapshot_size));
+  return ToLine(header);
+}
+
+std::string EncodeNode(const BookmarkNode* node) {
+  DCHECK(node->parent());
+  DictionaryValue* value = new DictionaryValue();
+  value->SetString(BookmarkCodec::kIdKey, base::Int64ToString(node->id()));
+  value->SetString(BookmarkCodec::kNameKey, node->GetTitle());
+  value->SetString(BookmarkCodec::kDateAddedKey,
+                   TimeToString(node->date_added()));
+  if (node->is_url()) {
+    value->SetString(BookmarkCodec::kTypeKey, BookmarkCodec::kTypeURL);
+    value->SetString(BookmarkCodec::kURLKey,
+                     node->url().possibly_invalid_spec());
+  } else {
+    value->SetString(BookmarkCodec::kTypeKey, BookmarkCodec::kTypeFolder);
+    value->SetString(BookmarkCodec::kDateModifiedKey,
+                     TimeToString(node->date_folder_modified()));
+  }
+  if (!node->meta_info_str().empty())
+    value->SetString(BookmarkCodec::kMetaInfo, node->meta_info_str());
+
+  DictionaryValue record;
+  record.SetString(kOpKey, kOpNode);
+  record.SetString(kParentKey, base::Int64ToString(node->parent()->id()));
+  record.SetInteger(kIndexKey, node->parent()->GetIndexOf(node));
+  record.Set(kNodeKey, value);
+  return ToLine(record);
+}
+
+std::string EncodeRemove(const BookmarkNode* node) {
+  DictionaryValue record;
+  record.SetString(kOpKey, kOpRemove);
+  record.SetString(BookmarkCodec::kIdKey, base::Int64ToString(node->id()));
+  return ToLine(record);
+}
+
+std::string EncodeChildOrder(const BookmarkNode* parent) {
+  ListValue* child_ids = new ListValue();
+  for (int i = 0; i < parent->child_count(); ++i) {
+    child_ids->Append(
+        new base::StringValue(base::Int64ToString(parent->GetChild(i)->id())));
+  }
+
+  DictionaryValue record;
+  record.SetString(kOpKey, kOpOrder);
+  record.SetString(BookmarkCodec::kIdKey, base::Int64ToString(parent->id()));
+  record.Set(BookmarkCodec::kChildrenKey, child_ids);
+  return ToLine(record);
+}
+
+bool Replay(const std::string& journal,
+            const std::string& snapshot_checksum,
+            int64 snapshot_size,
+            BookmarkNode* bb_node,
+            BookmarkNode* other_folder_node,
+            BookmarkNode* mobile_folder_node,
+            int64* max_id,
+            int* record_count,
+            bool* complete) {
+  *record_count = 0;
+  *complete = false;
+  size_t line_end = journal.find('\n');
+  if (line_end == std::string::npos ||
+      !IsHeaderFor(journal.substr(0, line_end), snapshot_checksum,
+                   snapshot_size)) {
+    return false;
+  }
+
+  IDToNodeMap nodes;
+  AddToMap(bb_node, &nodes);
+  AddToMap(other_folder_node, &nodes);
+  AddToMap(mobile_folder_node, &nodes);
+
+  // A line without its newline was cut short.
+  size_t line_start = line_end + 1;
+  for (; (line_end = journal.find('\n', line_start)) != std::string::npos;
+       line_start = line_end + 1) {
+    if (!ApplyRecord(journal.substr(line_start, line_end - line_start),
+                     &nodes, max_id)) {
+      return true;
+    }
+    ++*record_count;
+  }
+  *complete = line_start == journal.size();
+  return true;
+}
+
+}  // namespace bookmark_journal
@@ -0,0 +1,63 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_BOOKMARKS_BOOKMARK_JOURNAL_H_
+#define CHROME_BROWSER_BOOKMARKS_BOOKMARK_JOURNAL_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+
+class BookmarkNode;
+
+// The bookmark journal records the changes made to the bookmarks since the
+// bookmarks file was last written, so that an edit appends a line rather than
+// rewriting the whole file. BookmarkStorage keeps it when the
+// --enable-bookmark-journal switch is given, and folds it back into the
+// bookmarks file once it grows.
+//
+// Each line of the journal is a JSON object. The first is a header naming the
+// bookmarks file the journal follows, by its checksum and size, so that a
+// journal left behind by a crash after the file was rewritten isn't replayed
+// on the wrong file. Each of the others records the state of a node after a
+// change, the removal of a node or the order of the children of a folder, so
+// that replaying a record twice does no harm.
+namespace bookmark_journal {
+
+// Returns the header of a journal following the bookmarks file with the given
+// checksum and size.
+std::string EncodeHeader(const std::string& snapshot_checksum,
+                         int64 snapshot_size);
+
+// Returns the record of |node| having been added, moved or changed. The
+// children of a folder are not included.
+std::string EncodeNode(const BookmarkNode* node);
+
+// Returns the record of |node| having been removed, along with its children.
+std::string EncodeRemove(const BookmarkNode* node);
+
+// Returns the record of the children of |parent| having been reordered.
+std::string EncodeChildOrder(const BookmarkNode* parent);
+
+// Replays |journal| on the nodes decoded from the bookmarks file with the
+// given checksum and size. Returns false, leaving the nodes as they are, if
+// the journal doesn't follow that file. Otherwise the records are applied up
+// to the first one which can't be read or applied, such as one cut short by a
+// crash, |max_id| is raised above the ids of the nodes added, |record_count|
+// is set to the number of records applied, and |complete| to whether that was
+// the whole journal. Records appended after one which wasn't applied would be
+// lost, so an incomplete journal must not be appended to.
+bool Replay(const std::string& journal,
+            const std::string& snapshot_checksum,
+            int64 snapshot_size,
+            BookmarkNode* bb_node,
+            BookmarkNode* other_folder_node,
+            BookmarkNode* mobile_folder_node,
+            int64* max_id,
+            int* record_count,
+            bool* complete);
+
+}  // namespace bookmark_journal
+
+#endif  // CHROME_BROWSER_BOOKMARKS_BOOKMARK_JOURNAL_H_
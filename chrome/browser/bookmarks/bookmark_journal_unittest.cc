@@ -0,0 +1,217 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/json/json_string_value_serializer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "base/values.h"
+#include "chrome/browser/bookmarks/bookmark_codec.h"
+#include "chrome/browser/bookmarks/bookmark_journal.h"
+#include "chrome/browser/bookmarks/bookmark_model.h"
+#include "chrome/browser/bookmarks/bookmark_model_test_utils.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+BookmarkNode* AsMutable(const BookmarkNode* node) {
+  return const_cast<BookmarkNode*>(node);
+}
+
+}  // namespace
+
+// The tests make changes to a model, journaling them as BookmarkStorage does,
+// and check that replaying the journal on the model as it was before gives the
+// model as it is after.
+class BookmarkJournalTest : public testing::Test {
+ protected:
+  BookmarkJournalTest()
+      : model_(NULL),
+        snapshot_size_(0),
+        loaded_max_id_(0),
+        complete_(false) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    const BookmarkNode* bookmark_bar = model_.bookmark_bar_node();
+    folder_ = model_.AddFolder(bookmark_bar, 0, ASCIIToUTF16("folder"));
+    model_.AddURL(folder_, 0, ASCIIToUTF16("a"), GURL("http://a.com/"));
+    model_.AddURL(folder_, 1, ASCIIToUTF16("b"), GURL("http://b.com/"));
+    model_.AddURL(bookmark_bar, 1, ASCIIToUTF16("c"), GURL("http://c.com/"));
+    model_.AddURL(model_.other_node(), 0, ASCIIToUTF16("d"),
+                  GURL("http://d.com/"));
+    TakeSnapshot();
+  }
+
+  // Saves the model as the bookmarks file, and starts a journal following it.
+  void TakeSnapshot() {
+    BookmarkCodec codec;
+    snapshot_.reset(codec.Encode(&model_));
+    std::string data;
+    JSONStringValueSerializer serializer(&data);
+    serializer.set_pretty_print(true);
+    ASSERT_TRUE(serializer.Serialize(*snapshot_));
+    snapshot_checksum_ = codec.stored_checksum();
+    snapshot_size_ = data.size();
+    journal_ = bookmark_journal::EncodeHeader(snapshot_checksum_,
+                                              snapshot_size_);
+  }
+
+  // Change the model, journaling the nodes changed as BookmarkModel reports
+  // them to BookmarkStorage.
+  const BookmarkNode* AddURL(const BookmarkNode* parent,
+                             int index,
+                             const std::string& title,
+                             const GURL& url) {
+    const BookmarkNode* node =
+        model_.AddURL(parent, index, ASCIIToUTF16(title), url);
+    journal_ += bookmark_journal::EncodeNode(parent);
+    journal_ += bookmark_journal::EncodeNode(node);
+    return node;
+  }
+  void Move(const BookmarkNode* node, const BookmarkNode* parent, int index) {
+    model_.Move(node, parent, index);
+    journal_ += bookmark_journal::EncodeNode(parent);
+    journal_ += bookmark_journal::EncodeNode(node);
+  }
+  void Remove(const BookmarkNode* parent, int index) {
+    journal_ += bookmark_journal::EncodeRemove(parent->GetChild(index));
+    model_.Remove(parent, index);
+  }
+  void NodeChanged(const BookmarkNode* node) {
+    journal_ += bookmark_journal::EncodeNode(node);
+  }
+
+  // Loads the bookmarks file into |model| and replays |journal| on it,
+  // returning whether it was replayed. |complete_| is set to whether all of
+  // the journal was.
+  bool Load(const std::string& journal,
+            BookmarkModel* model,
+            int* record_count) {
+    BookmarkCodec codec;
+    EXPECT_TRUE(codec.Decode(AsMutable(model->bookmark_bar_node()),
+                             AsMutable(model->other_node()),
+                             AsMutable(model->mobile_node()), &loaded_max_id_,
+                             *snapshot_));
+    EXPECT_FALSE(codec.ids_reassigned());
+    return bookmark_journal::Replay(
+        journal, snapshot_checksum_, snapshot_size_,
+        AsMutable(model->bookmark_bar_node()), AsMutable(model->other_node()),
+        AsMutable(model->mobile_node()), &loaded_max_id_, record_count,
+        &complete_);
+  }
+
+  // Checks that replaying the journal gives the model.
+  void ExpectReplayGivesModel(int expected_record_count,
+                              bool expected_complete) {
+    BookmarkModel loaded_model(NULL);
+    int record_count = 0;
+    ASSERT_TRUE(Load(journal_, &loaded_model, &record_count));
+    EXPECT_EQ(expected_record_count, record_count);
+    EXPECT_EQ(expected_complete, complete_);
+    BookmarkModelTestUtils::AssertModelsEqual(&model_, &loaded_model, true);
+  }
+
+  BookmarkModel model_;
+  const BookmarkNode* folder_;
+  scoped_ptr<Value> snapshot_;
+  std::string snapshot_checksum_;
+  int64 snapshot_size_;
+  std::string journal_;
+
+  // The id above those of the nodes loaded by Load().
+  int64 loaded_max_id_;
+
+  // Whether Load() replayed all of the journal.
+  bool complete_;
+};
+
+TEST_F(BookmarkJournalTest, EmptyJournal) {
+  ExpectReplayGivesModel(0, true);
+}
+
+TEST_F(BookmarkJournalTest, AddAndChange) {
+  AddURL(folder_, 1, "e", GURL("http://e.com/"));
+  const BookmarkNode* folder = model_.AddFolder(model_.mobile_node(), 0,
+                                                ASCIIToUTF16("f"));
+  NodeChanged(folder);
+  const BookmarkNode* node = AddURL(folder, 0, "g", GURL("http://g.com/"));
+
+  model_.SetTitle(node, ASCIIToUTF16("g2"));
+  NodeChanged(node);
+  model_.SetURL(node, GURL("http://g2.com/"));
+  NodeChanged(node);
+  model_.SetNodeMetaInfo(node, "key", "value");
+  NodeChanged(node);
+  model_.SetDateFolderModified(model_.other_node(),
+                               base::Time::FromInternalValue(1234));
+  NodeChanged(model_.other_node());
+
+  ExpectReplayGivesModel(9, true);
+  EXPECT_GT(loaded_max_id_, node->id());
+}
+
+TEST_F(BookmarkJournalTest, MoveRemoveAndReorder) {
+  Move(folder_->GetChild(1), model_.other_node(), 0);
+  Move(model_.bookmark_bar_node()->GetChild(1), folder_, 0);
+  Move(folder_, model_.mobile_node(), 0);
+  model_.SortChildren(model_.other_node());
+  journal_ += bookmark_journal::EncodeChildOrder(model_.other_node());
+  Remove(folder_, 1);
+  Remove(model_.mobile_node(), 0);
+
+  ExpectReplayGivesModel(9, true);
+}
+
+TEST_F(BookmarkJournalTest, RecordsAreIdempotent) {
+  const BookmarkNode* node = folder_->GetChild(0);
+  Move(node, model_.other_node(), 1);
+  NodeChanged(node);
+  NodeChanged(node);
+
+  ExpectReplayGivesModel(4, true);
+}
+
+TEST_F(BookmarkJournalTest, StopsAtTornRecord) {
+  AddURL(folder_, 0, "e", GURL("http://e.com/"));
+  std::string record = bookmark_journal::EncodeNode(folder_->GetChild(2));
+  journal_ += record.substr(0, record.size() / 2);
+
+  ExpectReplayGivesModel(2, false);
+}
+
+TEST_F(BookmarkJournalTest, StopsAtRecordWhichDoesNotApply) {
+  Remove(folder_, 0);
+  // The permanent nodes can't be removed, so the records from there on are
+  // not replayed.
+  journal_ += bookmark_journal::EncodeRemove(model_.bookmark_bar_node());
+  journal_ += bookmark_journal::EncodeRemove(folder_->GetChild(0));
+
+  BookmarkModel loaded_model(NULL);
+  int record_count = 0;
+  ASSERT_TRUE(Load(journal_, &loaded_model, &record_count));
+  EXPECT_EQ(1, record_count);
+  EXPECT_FALSE(complete_);
+  BookmarkModelTestUtils::AssertModelsEqual(&model_, &loaded_model, true);
+}
+
+TEST_F(BookmarkJournalTest, IgnoredUnlessItFollowsTheFile) {
+  AddURL(folder_, 0, "e", GURL("http://e.com/"));
+  std::string journal = journal_;
+
+  // A journal left by a crash after the bookmarks file was rewritten.
+  TakeSnapshot();
+  BookmarkModel loaded_model(NULL);
+  int record_count = 0;
+  EXPECT_FALSE(Load(journal, &loaded_model, &record_count));
+  EXPECT_EQ(0, record_count);
+  BookmarkModelTestUtils::AssertModelsEqual(&model_, &loaded_model, true);
+
+  // A journal without a header.
+  BookmarkModel loaded_model2(NULL);
+  EXPECT_FALSE(Load(std::string(), &loaded_model2, &record_count));
+}
@@ -327,7 +327,7 @@ void BookmarkModel::Move(const BookmarkNode* node,
   mutable_new_parent->Add(AsMutable(node), index);
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(node);
 
   FOR_EACH_OBSERVER(BookmarkModelObserver, observers_,
                     BookmarkNodeMoved(this, old_parent, old_index,
@@ -355,9 +355,6 @@ void BookmarkModel::Copy(const BookmarkNode* node,
   // CloneBookmarkNode will use BookmarkModel methods to do the job, so we
   // don't need to send notifications here.
   bookmark_utils::CloneBookmarkNode(this, elements, new_parent, index);
-
-  if (store_.get())
-    store_->ScheduleSave();
 }
 
 const gfx::Image& BookmarkModel::GetFavicon(const BookmarkNode* node) {
@@ -390,7 +387,7 @@ void BookmarkModel::SetTitle(const BookmarkNode* node, const string16& title) {
   index_->Add(node);
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(node);
 
   FOR_EACH_OBSERVER(BookmarkModelObserver, observers_,
                     BookmarkNodeChanged(this, node));
@@ -431,7 +428,7 @@ void BookmarkModel::SetURL(const BookmarkNode* node, const GURL& url) {
   }
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(node);
 
   FOR_EACH_OBSERVER(BookmarkModelObserver, observers_,
                     BookmarkNodeChanged(this, node));
@@ -441,13 +438,13 @@ void BookmarkModel::SetNodeMetaInfo(const BookmarkNode* node,
                                     const std::string& key,
                                     const std::string& value) {
   if (AsMutable(node)->SetMetaInfo(key, value) && store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(node);
 }
 
 void BookmarkModel::DeleteNodeMetaInfo(const BookmarkNode* node,
                                        const std::string& key) {
   if (AsMutable(node)->DeleteMetaInfo(key) && store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(node);
 }
 
 void BookmarkModel::SetDateAdded(const BookmarkNode* node,
@@ -469,11 +466,10 @@ void BookmarkModel::SetDateAdded(const BookmarkNode* node,
 
   // Syncing might result in dates newer than the folder's last modified date.
   if (date_added > node->parent()->date_folder_modified()) {
-    // Will trigger store_->ScheduleSave().
     SetDateFolderModified(node->parent(), date_added);
-  } else if (store_.get()) {
-    store_->ScheduleSave();
   }
+  if (store_.get())
+    store_->NodeChanged(node);
 }
 
 void BookmarkModel::GetNodesByURL(const GURL& url,
@@ -613,7 +609,7 @@ void BookmarkModel::SortChildren(const BookmarkNode* parent) {
             SortComparator(collator.get()));
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->ChildrenReordered(parent);
 
   FOR_EACH_OBSERVER(BookmarkModelObserver, observers_,
                     BookmarkNodeChildrenReordered(this, parent));
@@ -625,7 +621,7 @@ void BookmarkModel::SetDateFolderModified(const BookmarkNode* parent,
   AsMutable(parent)->set_date_folder_modified(time);
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(parent);
 }
 
 void BookmarkModel::ResetDateFolderModified(const BookmarkNode* node) {
@@ -782,7 +778,7 @@ void BookmarkModel::RemoveAndDeleteNode(BookmarkNode* delete_me) {
   }
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->NodeRemoved(node.get());
 
   FOR_EACH_OBSERVER(BookmarkModelObserver, observers_,
                     BookmarkNodeRemoved(this, parent, index, node.get()));
@@ -808,7 +804,7 @@ BookmarkNode* BookmarkModel::AddNode(BookmarkNode* parent,
   parent->Add(node, index);
 
   if (store_.get())
-    store_->ScheduleSave();
+    store_->NodeChanged(node);
 
   FOR_EACH_OBSERVER(BookmarkModelObserver, observers_,
                     BookmarkNodeAdded(this, parent, index));
@@ -0,0 +1,281 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/bookmarks/bookmark_ngram_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "base/i18n/case_conversion.h"
+#include "base/memory/scoped_vector.h"
+#include "chrome/browser/bookmarks/bookmark_model.h"
+#include "chrome/browser/bookmarks/bookmark_utils.h"
+#include "chrome/browser/history/url_database.h"
+
+namespace {
+
+// The length of the n-grams. Query words shorter than this are looked for by
+// the start of the title words.
+const size_t kNGramLength = 3;
+
+// Set in the keys made from the start of a word, which are shorter than an
+// n-gram.
+const uint64 kWordStartFlag = GG_UINT64_C(1) << 48;
+
+// Returns the key for the |length| characters of |word| from |pos|.
+uint64 MakeKey(const string16& word, size_t pos, size_t length) {
+  uint64 key = 0;
+  for (size_t i = 0; i < length; ++i)
+    key |= static_cast<uint64>(word[pos + i]) << (16 * (kNGramLength - 1 - i));
+  return length < kNGramLength ? key | kWordStartFlag : key;
+}
+
+// Appends the keys of |word| to |keys|.
+void AppendWordKeys(const string16& word, std::vector<uint64>* keys) {
+  for (size_t length = 1; length < kNGramLength && length <= word.size();
+       ++length)
+    keys->push_back(MakeKey(word, 0, length));
+  for (size_t i = 0; i + kNGramLength <= word.size(); ++i)
+    keys->push_back(MakeKey(word, i, kNGramLength));
+}
+
+// Returns true if the query word |term| matches the title word |word|, adding
+// the positions it was found at, offset by |word_position|, to
+// |match_positions|. Short words must match a word as they do in
+// QueryParser, longer ones may be anywhere in it.
+bool MatchWord(const string16& term,
+               const string16& word,
+               size_t word_position,
+               Snippet::MatchPositions* match_positions) {
+  if (term.size() < kNGramLength) {
+    bool matches = QueryParser::IsWordLongEnoughForPrefixSearch(term) ?
+        word.compare(0, term.size(), term) == 0 : word == term;
+    if (matches) {
+      match_positions->push_back(
+          Snippet::MatchPosition(word_position, word_position + term.size()));
+    }
+    return matches;
+  }
+
+  bool matched = false;
+  for (size_t pos = word.find(term); pos != string16::npos;
+       pos = word.find(term, pos + 1)) {
+    match_positions->push_back(
+        Snippet::MatchPosition(word_position + pos,
+                               word_position + pos + term.size()));
+    matched = true;
+  }
+  return matched;
+}
+
+// Used to rank the matches by how often their URLs were typed, keeping the
+// order they were found in otherwise.
+typedef std::pair<int, size_t> TypedCountAndIndex;
+
+bool TypedCountAndIndexSortFunc(const TypedCountAndIndex& a,
+                                const TypedCountAndIndex& b) {
+  return a.first != b.first ? a.first > b.first : a.second < b.second;
+}
+
+}  // namespace
+
+BookmarkNGramIndex::BookmarkNGramIndex() {
+}
+
+BookmarkNGramIndex::~BookmarkNGramIndex() {
+}
+
+void BookmarkNGramIndex::Add(const BookmarkNode* node) {
+  if (!node->is_url())
+    return;
+
+  std::vector<Key> keys;
+  GetTitleKeys(node->GetTitle(), &keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    NodeVector& nodes = index_[keys[i]];
+    NodeVector::iterator pos =
+        std::lower_bound(nodes.begin(), nodes.end(), node);
+    if (pos == nodes.end() || *pos != node)
+      nodes.insert(pos, node);
+  }
+}
+
+void BookmarkNGramIndex::Remove(const BookmarkNode* node) {
+  if (!node->is_url())
+    return;
+
+  std::vector<Key> keys;
+  GetTitleKeys(node->GetTitle(), &keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    Index::iterator found = index_.find(keys[i]);
+    if (found == index_.end())
+      continue;
+    NodeVector& nodes = found->second;
+    NodeVector::iterator pos =
+        std::lower_bound(nodes.begin(), nodes.end(), node);
+    if (pos != nodes.end() && *pos == node)
+      nodes.erase(pos);
+    if (nodes.empty())
+      index_.erase(found);
+  }
+}
+
+void BookmarkNGramIndex::GetBookmarksWithTitlesMatching(
+    const string16& query,
+    size_t max_count,
+    history::URLDatabase* url_db,
+    std::vector<bookmark_utils::TitleMatch>* results) {
+  ScopedVector<QueryNode> query_nodes;
+  parser_.ParseQueryNodes(query, &query_nodes.get());
+
+  // The words outside quotes may be anywhere in a title word. The quoted
+  // phrases are checked with the QueryParser, but their words narrow down the
+  // nodes to check as well.
+  std::vector<string16> terms;
+  std::vector<string16> all_terms;
+  std::vector<QueryNode*> phrases;
+  for (size_t i = 0; i < query_nodes.size(); ++i) {
+    query_nodes[i]->AppendWords(&all_terms);
+    if (query_nodes[i]->IsWord())
+      query_nodes[i]->AppendWords(&terms);
+    else
+      phrases.push_back(query_nodes[i]);
+  }
+  if (all_terms.empty())
+    return;
+
+  // Start from the nodes for the term with the fewest, as that bounds the
+  // work of intersecting the others.
+  std::vector<NodeVector> term_nodes(all_terms.size());
+  for (size_t i = 0; i < all_terms.size(); ++i) {
+    GetCandidates(all_terms[i], &term_nodes[i]);
+    if (term_nodes[i].empty())
+      return;
+    if (term_nodes[i].size() < term_nodes[0].size())
+      term_nodes[i].swap(term_nodes[0]);
+  }
+  NodeVector candidates;
+  candidates.swap(term_nodes[0]);
+  for (size_t i = 1; i < term_nodes.size() && !candidates.empty(); ++i) {
+    NodeVector intersection;
+    std::set_intersection(candidates.begin(), candidates.end(),
+                          term_nodes[i].begin(), term_nodes[i].end(),
+                          std::back_inserter(intersection));
+    candidates.swap(intersection);
+  }
+
+  std::vector<bookmark_utils::TitleMatch> matches;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    bookmark_utils::TitleMatch match;
+    if (MatchTitle(candidates[i]->GetTitle(), terms, phrases,
+                   &match.match_positions)) {
+      match.node = candidates[i];
+      matches.push_back(match);
+    }
+  }
+
+  // The highest typed counts are put first, so that the best matches are
+  // always included.
+  std::vector<TypedCountAndIndex> ranks;
+  for (size_t i = 0; i < matches.size(); ++i) {
+    history::URLRow url;
+    if (url_db)
+      url_db->GetRowForURL(matches[i].node->url(), &url);
+    ranks.push_back(TypedCountAndIndex(url.typed_count(), i));
+  }
+  size_t result_count = std::min(max_count, ranks.size());
+  std::partial_sort(ranks.begin(), ranks.begin() + result_count, ranks.end(),
+                    &TypedCountAndIndexSortFunc);
+  for (size_t i = 0; i < result_count; ++i)
+    results->push_back(matches[ranks[i].second]);
+}
+
+size_t BookmarkNGramIndex::GetPostingCount() const {
+  size_t count = 0;
+  for (Index::const_iterator i = index_.begin(); i != index_.end(); ++i)
+    count += i->second.size();
+  return count;
+}
+
+void BookmarkNGramIndex::GetTitleKeys(const string16& title,
+                                      std::vector<Key>* keys) {
+  std::vector<QueryWord> words;
+  parser_.ExtractQueryWords(base::i18n::ToLower(title), &words);
+  for (size_t i = 0; i < words.size(); ++i)
+    AppendWordKeys(words[i].word, keys);
+  std::sort(keys->begin(), keys->end());
+  keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+}
+
+void BookmarkNGramIndex::GetCandidates(const string16& term,
+                                       NodeVector* nodes) const {
+  std::vector<Key> keys;
+  if (term.size() < kNGramLength)
+    keys.push_back(MakeKey(term, 0, term.size()));
+  else
+    AppendWordKeys(term, &keys);
+
+  // As for the terms, start from the shortest vector.
+  std::vector<const NodeVector*> key_nodes;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    // The start of the term needn't be the start of a word.
+    if (term.size() >= kNGramLength && (keys[i] & kWordStartFlag))
+      continue;
+    Index::const_iterator found = index_.find(keys[i]);
+    if (found == index_.end())
+      return;
+    key_nodes.push_back(&found->second);
+    if (key_nodes.back()->size() < key_nodes.front()->size())
+      std::swap(key_nodes.front(), key_nodes.back());
+  }
+  if (key_nodes.empty())
+    return;
+
+  *nodes = *key_nodes[0];
+  for (size_t i = 1; i < key_nodes.size() && !nodes->empty(); ++i) {
+    NodeVector intersection;
+    std::set_intersection(nodes->begin(), nodes->end(),
+                          key_nodes[i]->begin(), key_nodes[i]->end(),
+                          std::back_inserter(intersection));
+    nodes->swap(intersection);
+  }
+}
+
+bool BookmarkNGramIndex::MatchTitle(
+    const string16& title,
+    const std::vector<string16>& terms,
+    const std::vector<QueryNode*>& phrases,
+    Snippet::MatchPositions* match_positions) {
+  string16 lower_title = base::i18n::ToLower(title);
+  std::vector<QueryWord> words;
+  parser_.ExtractQueryWords(lower_title, &words);
+
+  Snippet::MatchPositions matches;
+  for (size_t i = 0; i < terms.size(); ++i) {
+    bool matched = false;
+    for (size_t j = 0; j < words.size(); ++j) {
+      if (MatchWord(terms[i], words[j].word, words[j].position, &matches))
+        matched = true;
+    }
+    if (!matched)
+      return false;
+  }
+  if (!phrases.empty()) {
+    Snippet::MatchPositions phrase_matches;
+    if (!parser_.DoesQueryMatch(title, phrases, &phrase_matches))
+      return false;
+    matches.insert(matches.end(), phrase_matches.begin(),
+                   phrase_matches.end());
+  }
+
+  if (lower_title.length() != title.length()) {
+    // As in QueryParser::DoesQueryMatch(), the positions in the lower case
+    // title wouldn't line up with the title.
+    return true;
+  }
+  QueryParser::SortAndCoalesceMatchPositions(&matches);
+  match_positions->swap(matches);
+  return true;
+}
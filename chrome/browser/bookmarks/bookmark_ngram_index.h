@@ -0,0 +1,97 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_BOOKMARKS_BOOKMARK_NGRAM_INDEX_H_
+#define CHROME_BROWSER_BOOKMARKS_BOOKMARK_NGRAM_INDEX_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/string16.h"
+#include "chrome/browser/history/query_parser.h"
+
+class BookmarkNode;
+
+namespace bookmark_utils {
+struct TitleMatch;
+}
+
+namespace history {
+class URLDatabase;
+}
+
+// BookmarkNGramIndex is an index of the titles of bookmarks which, unlike the
+// word index of BookmarkIndex, also finds query words in the middle of the
+// words of a title. BookmarkIndex uses it in place of its own index when the
+// --enable-bookmark-ngram-index switch is given.
+//
+// The words of each title, lower cased and split as QueryParser splits them,
+// are broken into their overlapping three character n-grams, and their first
+// one and two characters are kept as well. Each of these keys maps to a vector
+// of the nodes whose titles have it, sorted by address, so that the nodes
+// having several keys are found by merging vectors.
+//
+// A query word of three characters or more is looked for by its n-grams, and
+// a shorter one by the start of the title words. The nodes found are checked
+// against their titles, as the n-grams of a word may be in different places,
+// then ranked by how often their URLs were typed.
+//
+// Quoted phrases in the query match as they do for BookmarkIndex.
+class BookmarkNGramIndex {
+ public:
+  BookmarkNGramIndex();
+  ~BookmarkNGramIndex();
+
+  // Invoked when a bookmark has been added to the model.
+  void Add(const BookmarkNode* node);
+
+  // Invoked when a bookmark has been removed from the model.
+  void Remove(const BookmarkNode* node);
+
+  // Returns up to |max_count| of the bookmarks with titles containing the
+  // words of |query|, most typed first. |url_db| gives the typed counts, and
+  // may be NULL.
+  void GetBookmarksWithTitlesMatching(
+      const string16& query,
+      size_t max_count,
+      history::URLDatabase* url_db,
+      std::vector<bookmark_utils::TitleMatch>* results);
+
+  // Returns the number of distinct keys in the index.
+  size_t key_count() const { return index_.size(); }
+
+  // Returns the number of node entries in the index.
+  size_t GetPostingCount() const;
+
+ private:
+  // A key packs up to three UTF-16 characters, and a flag telling an n-gram
+  // from the start of a word.
+  typedef uint64 Key;
+  typedef std::vector<const BookmarkNode*> NodeVector;
+  typedef base::hash_map<Key, NodeVector> Index;
+
+  // Returns the distinct keys of the words of |title|.
+  void GetTitleKeys(const string16& title, std::vector<Key>* keys);
+
+  // Sets |nodes| to those whose titles have every key of |term|, which is a
+  // word of a query.
+  void GetCandidates(const string16& term, NodeVector* nodes) const;
+
+  // Returns true if every one of |terms| is in |title|, and |title| matches
+  // |phrases|. If it does, the positions of the matches are added to
+  // |match_positions|.
+  bool MatchTitle(const string16& title,
+                  const std::vector<string16>& terms,
+                  const std::vector<QueryNode*>& phrases,
+                  Snippet::MatchPositions* match_positions);
+
+  Index index_;
+
+  QueryParser parser_;
+
+  DISALLOW_COPY_AND_ASSIGN(BookmarkNGramIndex);
+};
+
+#endif  // CHROME_BROWSER_BOOKMARKS_BOOKMARK_NGRAM_INDEX_H_
@@ -0,0 +1,172 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_vector.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/bookmarks/bookmark_model.h"
+#include "chrome/browser/bookmarks/bookmark_ngram_index.h"
+#include "chrome/browser/bookmarks/bookmark_utils.h"
+#include "chrome/browser/history/in_memory_database.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+class BookmarkNGramIndexTest : public testing::Test {
+ protected:
+  // Adds a bookmark with the given title, returning it.
+  const BookmarkNode* AddBookmark(const std::string& title,
+                                  const std::string& url) {
+    BookmarkNode* node = new BookmarkNode(GURL(url));
+    node->SetTitle(UTF8ToUTF16(title));
+    nodes_.push_back(node);
+    index_.Add(node);
+    return node;
+  }
+
+  // Returns the titles of the bookmarks matching |query|, in order.
+  std::vector<std::string> Query(const std::string& query,
+                                 history::URLDatabase* url_db) {
+    std::vector<bookmark_utils::TitleMatch> matches;
+    index_.GetBookmarksWithTitlesMatching(UTF8ToUTF16(query), 100, url_db,
+                                          &matches);
+    std::vector<std::string> titles;
+    for (size_t i = 0; i < matches.size(); ++i)
+      titles.push_back(UTF16ToUTF8(matches[i].node->GetTitle()));
+    return titles;
+  }
+
+  std::vector<std::string> Query(const std::string& query) {
+    return Query(query, NULL);
+  }
+
+  // Returns the match positions of the single bookmark matching |query|, as
+  // a string of the form "0,3:5,7".
+  std::string MatchPositions(const std::string& query) {
+    std::vector<bookmark_utils::TitleMatch> matches;
+    index_.GetBookmarksWithTitlesMatching(UTF8ToUTF16(query), 100, NULL,
+                                          &matches);
+    EXPECT_EQ(1U, matches.size());
+    if (matches.empty())
+      return std::string();
+    std::string positions;
+    for (size_t i = 0; i < matches[0].match_positions.size(); ++i) {
+      if (i)
+        positions += ":";
+      positions += base::StringPrintf(
+          "%d,%d", static_cast<int>(matches[0].match_positions[i].first),
+          static_cast<int>(matches[0].match_positions[i].second));
+    }
+    return positions;
+  }
+
+  static std::vector<std::string> Titles(const char* title1,
+                                         const char* title2 = NULL) {
+    std::vector<std::string> titles(1, title1);
+    if (title2)
+      titles.push_back(title2);
+    return titles;
+  }
+
+  ScopedVector<BookmarkNode> nodes_;
+  BookmarkNGramIndex index_;
+};
+
+TEST_F(BookmarkNGramIndexTest, Matches) {
+  AddBookmark("Bookmarks Manager", "http://a.com/");
+  AddBookmark("Facebook", "http://b.com/");
+  AddBookmark("My Notebook", "http://c.com/");
+  AddBookmark("ab cd", "http://d.com/");
+
+  // Words are found anywhere in the title words, in any case.
+  EXPECT_EQ(Titles("Bookmarks Manager"), Query("MARKS"));
+  EXPECT_EQ(3U, Query("book").size());
+  EXPECT_EQ(Titles("Facebook"), Query("cebo"));
+  EXPECT_EQ(Titles("Bookmarks Manager"), Query("kma"));
+  EXPECT_EQ(Titles("My Notebook"), Query("note book"));
+  EXPECT_TRUE(Query("facebooks").empty());
+  EXPECT_TRUE(Query("").empty());
+
+  // Every n-gram being in a title isn't enough.
+  AddBookmark("abcd bcde", "http://e.com/");
+  EXPECT_TRUE(Query("abcde").empty());
+
+  // Short words must match a whole word.
+  EXPECT_EQ(Titles("ab cd"), Query("ab"));
+  EXPECT_EQ(Titles("My Notebook"), Query("my"));
+  EXPECT_TRUE(Query("a").empty());
+  EXPECT_TRUE(Query("bo").empty());
+
+  // Quoted words must match exactly.
+  EXPECT_EQ(Titles("Facebook"), Query("\"facebook\""));
+  EXPECT_TRUE(Query("\"book\"").empty());
+  EXPECT_EQ(Titles("My Notebook"), Query("\"my notebook\""));
+  EXPECT_TRUE(Query("\"notebook my\"").empty());
+}
+
+TEST_F(BookmarkNGramIndexTest, MatchPositions) {
+  AddBookmark("Bookmarks Manager", "http://a.com/");
+  AddBookmark("ab cd", "http://b.com/");
+
+  EXPECT_EQ("4,9", MatchPositions("marks"));
+  EXPECT_EQ("4,9:10,13", MatchPositions("marks man"));
+  EXPECT_EQ("0,9", MatchPositions("book kmarks"));
+  EXPECT_EQ("3,5", MatchPositions("cd"));
+  EXPECT_EQ("0,5", MatchPositions("\"ab cd\""));
+}
+
+TEST_F(BookmarkNGramIndexTest, Remove) {
+  const BookmarkNode* node = AddBookmark("Bookmarks", "http://a.com/");
+  AddBookmark("Facebook", "http://b.com/");
+  size_t key_count = index_.key_count();
+
+  index_.Remove(node);
+  EXPECT_EQ(Titles("Facebook"), Query("book"));
+  EXPECT_TRUE(Query("marks").empty());
+  EXPECT_GT(key_count, index_.key_count());
+
+  index_.Remove(nodes_[1]);
+  EXPECT_TRUE(Query("book").empty());
+  EXPECT_EQ(0U, index_.key_count());
+  EXPECT_EQ(0U, index_.GetPostingCount());
+}
+
+TEST_F(BookmarkNGramIndexTest, SortedByTypedCount) {
+  history::InMemoryDatabase url_db;
+  ASSERT_TRUE(url_db.InitFromScratch());
+
+  struct {
+    const char* url;
+    const char* title;
+    int typed_count;
+  } data[] = {
+    { "http://www.google.com/", "Google", 100 },
+    { "http://maps.google.com/", "Google Maps", 40 },
+    { "http://docs.google.com/", "Google Docs", 50 },
+    { "http://reader.google.com/", "Google Reader", 80 },
+  };
+  for (size_t i = 0; i < arraysize(data); ++i) {
+    history::URLRow row((GURL(data[i].url)));
+    row.set_typed_count(data[i].typed_count);
+    url_db.AddURL(row);
+    AddBookmark(data[i].title, data[i].url);
+  }
+
+  std::vector<std::string> titles = Query("oogl", &url_db);
+  ASSERT_EQ(4U, titles.size());
+  EXPECT_EQ("Google", titles[0]);
+  EXPECT_EQ("Google Reader", titles[1]);
+  EXPECT_EQ("Google Docs", titles[2]);
+  EXPECT_EQ("Google Maps", titles[3]);
+
+  // The most typed are kept.
+  std::vector<bookmark_utils::TitleMatch> matches;
+  index_.GetBookmarksWithTitlesMatching(ASCIIToUTF16("google"), 2, &url_db,
+                                        &matches);
+  ASSERT_EQ(2U, matches.size());
+  EXPECT_EQ("Google", UTF16ToUTF8(matches[0].node->GetTitle()));
+  EXPECT_EQ("Google Reader", UTF16ToUTF8(matches[1].node->GetTitle()));
+}
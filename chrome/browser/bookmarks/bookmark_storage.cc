@@ -5,16 +5,21 @@
 #include "chrome/browser/bookmarks/bookmark_storage.h"
 
 #include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/command_line.h"
 #include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/json/json_file_value_serializer.h"
 #include "base/json/json_string_value_serializer.h"
 #include "base/metrics/histogram.h"
+#include "base/task_runner_util.h"
 #include "base/time.h"
 #include "chrome/browser/bookmarks/bookmark_codec.h"
+#include "chrome/browser/bookmarks/bookmark_journal.h"
 #include "chrome/browser/bookmarks/bookmark_model.h"
 #include "chrome/common/chrome_constants.h"
+#include "chrome/common/chrome_switches.h"
 #include "content/public/browser/browser_context.h"
 #include "content/public/browser/browser_thread.h"
 
@@ -26,9 +31,18 @@ namespace {
 // Extension used for backup files (copy of main file created during startup).
 const FilePath::CharType kBackupExtension[] = FILE_PATH_LITERAL("bak");
 
+// Extension of the journal of changes made since the bookmarks file was
+// written.
+const FilePath::CharType kJournalExtension[] = FILE_PATH_LITERAL("journal");
+
 // How often we save.
 const int kSaveDelayMS = 2500;
 
+// The journal is folded into the bookmarks file once it has this many
+// records, or once it is larger than the file and this size.
+const int kMaxJournalRecords = 1000;
+const int64 kMinJournalCompactionSize = 64 * 1024;
+
 void BackupCallback(const FilePath& path) {
   FilePath backup_path = path.ReplaceExtension(kBackupExtension);
   file_util::CopyFile(path, backup_path);
@@ -46,7 +60,42 @@ void AddBookmarksToIndex(BookmarkLoadDetails* details,
   }
 }
 
+// Replays the journal at |path| on the nodes decoded by |codec|, unless the
+// bookmarks file was changed by something other than us.
+void ReplayJournal(const FilePath& path,
+                   const BookmarkCodec& codec,
+                   BookmarkLoadDetails* details) {
+  std::string journal;
+  if (!file_util::ReadFileToString(path, &journal))
+    return;
+  details->set_journal_size(journal.size());
+  if (codec.computed_checksum() != codec.stored_checksum() ||
+      codec.ids_reassigned()) {
+    return;
+  }
+
+  TimeTicks start_time = TimeTicks::Now();
+  int64 max_node_id = details->max_id();
+  int record_count = 0;
+  bool complete = false;
+  if (!bookmark_journal::Replay(journal, codec.stored_checksum(),
+                                details->snapshot_size(), details->bb_node(),
+                                details->other_folder_node(),
+                                details->mobile_folder_node(), &max_node_id,
+                                &record_count, &complete)) {
+    return;
+  }
+  details->set_max_id(max_node_id);
+  details->set_journal_replayed(true);
+  details->set_journal_record_count(record_count);
+  details->set_journal_complete(complete);
+  UMA_HISTOGRAM_TIMES("Bookmarks.JournalReplayTime",
+                      TimeTicks::Now() - start_time);
+  UMA_HISTOGRAM_COUNTS_10000("Bookmarks.JournalRecordCount", record_count);
+}
+
 void LoadCallback(const FilePath& path,
+                  const FilePath& journal_path,
                   BookmarkStorage* storage,
                   BookmarkLoadDetails* details) {
   bool bookmark_file_exists = file_util::PathExists(path);
@@ -70,6 +119,11 @@ void LoadCallback(const FilePath& path,
       UMA_HISTOGRAM_TIMES("Bookmarks.DecodeTime",
                           TimeTicks::Now() - start_time);
 
+      int64 snapshot_size = 0;
+      file_util::GetFileSize(path, &snapshot_size);
+      details->set_snapshot_size(snapshot_size);
+      ReplayJournal(journal_path, codec, details);
+
       start_time = TimeTicks::Now();
       AddBookmarksToIndex(details, details->bb_node());
       AddBookmarksToIndex(details, details->other_folder_node());
@@ -84,6 +138,24 @@ void LoadCallback(const FilePath& path,
       base::Bind(&BookmarkStorage::OnLoadFinished, storage));
 }
 
+bool AppendToJournal(const FilePath& path, const std::string& records) {
+  if (file_util::AppendToFile(path, records.data(), records.size()) !=
+      static_cast<int>(records.size())) {
+    LOG(WARNING) << "Failed to append to the bookmark journal";
+    return false;
+  }
+  return true;
+}
+
+bool StartJournal(const FilePath& path, const std::string& header) {
+  if (file_util::WriteFile(path, header.data(), header.size()) !=
+      static_cast<int>(header.size())) {
+    LOG(WARNING) << "Failed to write the bookmark journal";
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 // BookmarkLoadDetails ---------------------------------------------------------
@@ -99,7 +171,12 @@ BookmarkLoadDetails::BookmarkLoadDetails(
       mobile_folder_node_(mobile_folder_node),
       index_(index),
       max_id_(max_id),
-      ids_reassigned_(false) {
+      ids_reassigned_(false),
+      snapshot_size_(0),
+      journal_size_(0),
+      journal_replayed_(false),
+      journal_record_count_(0),
+      journal_complete_(false) {
 }
 
 BookmarkLoadDetails::~BookmarkLoadDetails() {
@@ -113,7 +190,16 @@ BookmarkStorage::BookmarkStorage(
     base::SequencedTaskRunner* sequenced_task_runner)
     : model_(model),
       writer_(context->GetPath().Append(chrome::kBookmarksFileName),
-              sequenced_task_runner) {
+              sequenced_task_runner),
+      journal_enabled_(CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableBookmarkJournal)),
+      journal_path_(writer_.path().ReplaceExtension(kJournalExtension)),
+      journal_valid_(false),
+      needs_compaction_(false),
+      snapshot_size_(0),
+      journal_size_(0),
+      journal_record_count_(0),
+      pending_record_count_(0) {
   sequenced_task_runner_ = sequenced_task_runner;
   writer_.set_commit_interval(base::TimeDelta::FromMilliseconds(kSaveDelayMS));
   sequenced_task_runner_->PostTask(FROM_HERE,
@@ -131,12 +217,42 @@ void BookmarkStorage::LoadBookmarks(BookmarkLoadDetails* details) {
   details_.reset(details);
   sequenced_task_runner_->PostTask(
       FROM_HERE,
-      base::Bind(&LoadCallback, writer_.path(), make_scoped_refptr(this),
-                 details_.get()));
+      base::Bind(&LoadCallback, writer_.path(), journal_path_,
+                 make_scoped_refptr(this), details_.get()));
 }
 
 void BookmarkStorage::ScheduleSave() {
-  writer_.ScheduleWrite(this);
+  if (!journal_enabled_) {
+    writer_.ScheduleWrite(this);
+    return;
+  }
+  needs_compaction_ = true;
+  ScheduleJournalWrite();
+}
+
+void BookmarkStorage::NodeChanged(const BookmarkNode* node) {
+  // Only the meta info of the root is saved, and it seldom changes.
+  if (!journal_enabled_ || !node->parent()) {
+    ScheduleSave();
+    return;
+  }
+  AppendRecord(bookmark_journal::EncodeNode(node));
+}
+
+void BookmarkStorage::NodeRemoved(const BookmarkNode* node) {
+  if (!journal_enabled_) {
+    ScheduleSave();
+    return;
+  }
+  AppendRecord(bookmark_journal::EncodeRemove(node));
+}
+
+void BookmarkStorage::ChildrenReordered(const BookmarkNode* parent) {
+  if (!journal_enabled_) {
+    ScheduleSave();
+    return;
+  }
+  AppendRecord(bookmark_journal::EncodeChildOrder(parent));
 }
 
 void BookmarkStorage::BookmarkModelDeleted() {
@@ -144,22 +260,48 @@ void BookmarkStorage::BookmarkModelDeleted() {
   // the model is gone.
   if (writer_.HasPendingWrite())
     SaveNow();
+  if (journal_timer_.IsRunning()) {
+    journal_timer_.Stop();
+    WriteJournal();
+  }
   model_ = NULL;
 }
 
 bool BookmarkStorage::SerializeData(std::string* output) {
   BookmarkCodec codec;
-  scoped_ptr<Value> value(codec.Encode(model_));
-  JSONStringValueSerializer serializer(output);
-  serializer.set_pretty_print(true);
-  return serializer.Serialize(*(value.get()));
+  return Serialize(&codec, output);
 }
 
 void BookmarkStorage::OnLoadFinished() {
   if (!model_)
     return;
 
+  bool journal_found = details_->journal_size() > 0;
+  // Records appended after one which couldn't be replayed would be lost.
+  journal_valid_ =
+      details_->journal_replayed() && details_->journal_complete();
+  bool journal_incomplete =
+      details_->journal_replayed() && !details_->journal_complete();
+  snapshot_size_ = details_->snapshot_size();
+  journal_size_ = details_->journal_size();
+  journal_record_count_ = details_->journal_record_count();
+
   model_->DoneLoading(details_.release());
+
+  if (!journal_enabled_ && journal_found) {
+    // Fold the journal kept while it was enabled into the bookmarks file.
+    // The journal is only deleted once the file has been written, as the
+    // writes are sequenced.
+    SaveNow();
+    sequenced_task_runner_->PostTask(
+        FROM_HERE,
+        base::Bind(base::IgnoreResult(&file_util::Delete), journal_path_,
+                   false));
+  } else if (journal_enabled_ && journal_incomplete) {
+    // Save the records which were replayed in a new bookmarks file.
+    needs_compaction_ = true;
+    ScheduleJournalWrite();
+  }
 }
 
 bool BookmarkStorage::SaveNow() {
@@ -176,3 +318,90 @@ bool BookmarkStorage::SaveNow() {
   writer_.WriteNow(data);
   return true;
 }
+
+bool BookmarkStorage::Serialize(BookmarkCodec* codec, std::string* output) {
+  scoped_ptr<Value> value(codec->Encode(model_));
+  JSONStringValueSerializer serializer(output);
+  serializer.set_pretty_print(true);
+  return serializer.Serialize(*(value.get()));
+}
+
+void BookmarkStorage::AppendRecord(const std::string& record) {
+  if (journal_valid_) {
+    pending_records_ += record;
+    ++pending_record_count_;
+  } else {
+    needs_compaction_ = true;
+  }
+  ScheduleJournalWrite();
+}
+
+void BookmarkStorage::ScheduleJournalWrite() {
+  if (!journal_timer_.IsRunning()) {
+    journal_timer_.Start(FROM_HERE,
+                         base::TimeDelta::FromMilliseconds(kSaveDelayMS),
+                         this, &BookmarkStorage::WriteJournal);
+  }
+}
+
+void BookmarkStorage::WriteJournal() {
+  if (!model_ || !model_->IsLoaded()) {
+    NOTREACHED();
+    return;
+  }
+
+  int64 journal_size = journal_size_ + pending_records_.size();
+  if (needs_compaction_ ||
+      journal_record_count_ + pending_record_count_ > kMaxJournalRecords ||
+      journal_size > std::max(snapshot_size_, kMinJournalCompactionSize)) {
+    CompactJournal();
+    return;
+  }
+  if (pending_records_.empty())
+    return;
+
+  base::PostTaskAndReplyWithResult(
+      sequenced_task_runner_.get(), FROM_HERE,
+      base::Bind(&AppendToJournal, journal_path_, pending_records_),
+      base::Bind(&BookmarkStorage::OnJournalWritten, this));
+  journal_size_ = journal_size;
+  journal_record_count_ += pending_record_count_;
+  pending_records_.clear();
+  pending_record_count_ = 0;
+}
+
+void BookmarkStorage::CompactJournal() {
+  BookmarkCodec codec;
+  std::string data;
+  if (!Serialize(&codec, &data))
+    return;
+  writer_.WriteNow(data);
+
+  // If we crash before the new journal is written, the old one no longer
+  // follows the bookmarks file and isn't replayed.
+  std::string header =
+      bookmark_journal::EncodeHeader(codec.stored_checksum(), data.size());
+  base::PostTaskAndReplyWithResult(
+      sequenced_task_runner_.get(), FROM_HERE,
+      base::Bind(&StartJournal, journal_path_, header),
+      base::Bind(&BookmarkStorage::OnJournalWritten, this));
+
+  snapshot_size_ = data.size();
+  journal_size_ = header.size();
+  journal_record_count_ = 0;
+  journal_valid_ = true;
+  needs_compaction_ = false;
+  pending_records_.clear();
+  pending_record_count_ = 0;
+}
+
+void BookmarkStorage::OnJournalWritten(bool success) {
+  if (success || !model_)
+    return;
+  // The records counted as appended may not be in the journal, and those
+  // appended after them would be lost, so fall back to writing the whole
+  // bookmarks file.
+  journal_valid_ = false;
+  needs_compaction_ = true;
+  ScheduleJournalWrite();
+}
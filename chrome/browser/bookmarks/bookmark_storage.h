@@ -8,9 +8,12 @@
 #include "base/files/important_file_writer.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/timer.h"
 #include "chrome/browser/bookmarks/bookmark_index.h"
 
+class BookmarkCodec;
 class BookmarkModel;
+class BookmarkNode;
 class BookmarkPermanentNode;
 
 namespace base {
@@ -83,6 +86,24 @@ class BookmarkLoadDetails {
   void set_ids_reassigned(bool value) { ids_reassigned_ = value; }
   bool ids_reassigned() const { return ids_reassigned_; }
 
+  // Size of the bookmarks file.
+  void set_snapshot_size(int64 value) { snapshot_size_ = value; }
+  int64 snapshot_size() const { return snapshot_size_; }
+
+  // Size of the journal of changes made since the bookmarks file was written,
+  // or 0 if there is none. See bookmark_journal.h.
+  void set_journal_size(int64 value) { journal_size_ = value; }
+  int64 journal_size() const { return journal_size_; }
+
+  // Whether the journal followed the bookmarks file and was replayed, how
+  // many of its records were, and whether that was all of it.
+  void set_journal_replayed(bool value) { journal_replayed_ = value; }
+  bool journal_replayed() const { return journal_replayed_; }
+  void set_journal_record_count(int value) { journal_record_count_ = value; }
+  int journal_record_count() const { return journal_record_count_; }
+  void set_journal_complete(bool value) { journal_complete_ = value; }
+  bool journal_complete() const { return journal_complete_; }
+
  private:
   scoped_ptr<BookmarkPermanentNode> bb_node_;
   scoped_ptr<BookmarkPermanentNode> other_folder_node_;
@@ -93,6 +114,11 @@ class BookmarkLoadDetails {
   std::string computed_checksum_;
   std::string stored_checksum_;
   bool ids_reassigned_;
+  int64 snapshot_size_;
+  int64 journal_size_;
+  bool journal_replayed_;
+  int journal_record_count_;
+  bool journal_complete_;
 
   DISALLOW_COPY_AND_ASSIGN(BookmarkLoadDetails);
 };
@@ -102,6 +128,11 @@ class BookmarkLoadDetails {
 // as notifying the BookmarkStorage every time the model changes.
 //
 // Internally BookmarkStorage uses BookmarkCodec to do the actual read/write.
+//
+// With the --enable-bookmark-journal switch, a change is appended to a journal
+// next to the bookmarks file instead of the whole file being rewritten. The
+// journal is folded back into the file once it has grown, and is replayed
+// when the bookmarks are loaded. See bookmark_journal.h.
 class BookmarkStorage : public base::ImportantFileWriter::DataSerializer,
                         public base::RefCountedThreadSafe<BookmarkStorage> {
  public:
@@ -117,6 +148,17 @@ class BookmarkStorage : public base::ImportantFileWriter::DataSerializer,
   // Schedules saving the bookmark bar model to disk.
   void ScheduleSave();
 
+  // Notifications of the changes to the model, which are journaled if the
+  // journal is enabled, and otherwise schedule a save. |node| has been added,
+  // moved or changed.
+  void NodeChanged(const BookmarkNode* node);
+
+  // |node| is about to be deleted, having been removed from the model.
+  void NodeRemoved(const BookmarkNode* node);
+
+  // The children of |parent| have been reordered.
+  void ChildrenReordered(const BookmarkNode* parent);
+
   // Notification the bookmark bar model is going to be deleted. If there is
   // a pending save, it is saved immediately.
   void BookmarkModelDeleted();
@@ -136,6 +178,28 @@ class BookmarkStorage : public base::ImportantFileWriter::DataSerializer,
   // Returns true on successful serialization.
   bool SaveNow();
 
+  // Serializes the model with |codec|, which then has its checksum.
+  bool Serialize(BookmarkCodec* codec, std::string* output);
+
+  // Adds |record| to those to be appended to the journal, or, if the journal
+  // doesn't follow the bookmarks file, schedules rewriting the file.
+  void AppendRecord(const std::string& record);
+
+  // Starts the timer to write the journal, if it isn't running.
+  void ScheduleJournalWrite();
+
+  // Appends the pending records to the journal, or rewrites the bookmarks file
+  // and starts a new journal if that is needed or the journal has grown.
+  void WriteJournal();
+
+  // Rewrites the bookmarks file and starts a new journal following it.
+  void CompactJournal();
+
+  // Callback from backend after writing to the journal. If the write failed,
+  // the journal no longer holds the changes, and the bookmarks file is
+  // rewritten.
+  void OnJournalWritten(bool success);
+
   // The model. The model is NULL once BookmarkModelDeleted has been invoked.
   BookmarkModel* model_;
 
@@ -148,6 +212,32 @@ class BookmarkStorage : public base::ImportantFileWriter::DataSerializer,
   // Sequenced task runner where file I/O operations will be performed at.
   scoped_refptr<base::SequencedTaskRunner> sequenced_task_runner_;
 
+  // Whether changes are journaled, rather than the bookmarks file rewritten.
+  const bool journal_enabled_;
+
+  // Path of the journal.
+  const FilePath journal_path_;
+
+  // Whether the journal on disk follows the bookmarks file, so that records
+  // may be appended to it.
+  bool journal_valid_;
+
+  // Whether the bookmarks file is to be rewritten on the next journal write.
+  bool needs_compaction_;
+
+  // Sizes of the bookmarks file and of the journal, and the number of records
+  // in the journal.
+  int64 snapshot_size_;
+  int64 journal_size_;
+  int journal_record_count_;
+
+  // The records not yet appended to the journal.
+  std::string pending_records_;
+  int pending_record_count_;
+
+  // Runs WriteJournal() once changes have been made.
+  base::OneShotTimer<BookmarkStorage> journal_timer_;
+
   DISALLOW_COPY_AND_ASSIGN(BookmarkStorage);
 };
 
@@ -0,0 +1,149 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/json/json_file_value_serializer.h"
+#include "base/json/json_string_value_serializer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "base/values.h"
+#include "chrome/browser/bookmarks/bookmark_codec.h"
+#include "chrome/browser/bookmarks/bookmark_journal.h"
+#include "chrome/browser/bookmarks/bookmark_model.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// The shape of a large bookmark tree.
+const int kFolderCount = 200;
+const int kBookmarksPerFolder = 100;
+
+// The number of edits journaled, which is as many as the journal holds before
+// it is folded into the bookmarks file.
+const int kEditCount = 1000;
+
+BookmarkNode* AsMutable(const BookmarkNode* node) {
+  return const_cast<BookmarkNode*>(node);
+}
+
+void PopulateModel(BookmarkModel* model) {
+  for (int i = 0; i < kFolderCount; ++i) {
+    const BookmarkNode* folder = model->AddFolder(
+        i % 2 ? model->other_node() : model->bookmark_bar_node(), 0,
+        ASCIIToUTF16(base::StringPrintf("Folder %d", i)));
+    for (int j = 0; j < kBookmarksPerFolder; ++j) {
+      model->AddURL(folder, j,
+                    ASCIIToUTF16(base::StringPrintf("Page %d of site %d", j,
+                                                    i)),
+                    GURL(base::StringPrintf(
+                        "http://www.site%d.com/a/longer/path/page%d.html", i,
+                        j)));
+    }
+  }
+}
+
+// Writes the bookmarks file as BookmarkStorage does, returning its size.
+int64 WriteSnapshot(BookmarkModel* model,
+                    const FilePath& path,
+                    std::string* checksum) {
+  BookmarkCodec codec;
+  scoped_ptr<Value> value(codec.Encode(model));
+  std::string data;
+  JSONStringValueSerializer serializer(&data);
+  serializer.set_pretty_print(true);
+  EXPECT_TRUE(serializer.Serialize(*value));
+  EXPECT_EQ(static_cast<int>(data.size()),
+            file_util::WriteFile(path, data.data(), data.size()));
+  *checksum = codec.stored_checksum();
+  return data.size();
+}
+
+// Loads the bookmarks as BookmarkStorage does, replaying the journal at
+// |journal_path| if it is non-empty, and logs the time taken.
+void Load(const FilePath& path,
+          const FilePath& journal_path,
+          const char* name) {
+  BookmarkModel model(NULL);
+  PerfTimeLogger timer(base::StringPrintf("Bookmarks_Load_%s", name).c_str());
+  JSONFileValueSerializer serializer(path);
+  scoped_ptr<Value> root(serializer.Deserialize(NULL, NULL));
+  ASSERT_TRUE(root.get());
+  BookmarkCodec codec;
+  int64 max_id = 0;
+  ASSERT_TRUE(codec.Decode(AsMutable(model.bookmark_bar_node()),
+                           AsMutable(model.other_node()),
+                           AsMutable(model.mobile_node()), &max_id, *root));
+  if (!journal_path.empty()) {
+    int64 snapshot_size = 0;
+    ASSERT_TRUE(file_util::GetFileSize(path, &snapshot_size));
+    std::string journal;
+    ASSERT_TRUE(file_util::ReadFileToString(journal_path, &journal));
+    int record_count = 0;
+    bool complete = false;
+    ASSERT_TRUE(bookmark_journal::Replay(
+        journal, codec.stored_checksum(), snapshot_size,
+        AsMutable(model.bookmark_bar_node()), AsMutable(model.other_node()),
+        AsMutable(model.mobile_node()), &max_id, &record_count, &complete));
+    EXPECT_EQ(kEditCount, record_count);
+    EXPECT_TRUE(complete);
+  }
+  timer.Done();
+}
+
+}  // namespace
+
+// Compares the bytes written for an edit of a large bookmark tree when the
+// bookmarks file is rewritten and when the edit is journaled, and the time
+// taken to load the bookmarks file alone and with a full journal.
+TEST(BookmarkStoragePerfTest, JournalAgainstSnapshot) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("Bookmarks");
+  FilePath journal_path = temp_dir.path().AppendASCII("Bookmarks.journal");
+
+  BookmarkModel model(NULL);
+  PopulateModel(&model);
+
+  std::string checksum;
+  int64 snapshot_size;
+  {
+    PerfTimeLogger timer("Bookmarks_Write_snapshot");
+    snapshot_size = WriteSnapshot(&model, path, &checksum);
+  }
+  LogPerfResult("Bookmarks_WriteBytesPerEdit_snapshot", snapshot_size,
+                "bytes");
+
+  // Retitle bookmarks spread over the tree, journaling each edit.
+  std::string journal = bookmark_journal::EncodeHeader(checksum,
+                                                       snapshot_size);
+  size_t header_size = journal.size();
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < kEditCount; ++i) {
+    const BookmarkNode* folder = model.bookmark_bar_node()->GetChild(
+        i % model.bookmark_bar_node()->child_count());
+    const BookmarkNode* node = folder->GetChild(i % folder->child_count());
+    model.SetTitle(node, ASCIIToUTF16(base::StringPrintf("Edit %d", i)));
+    journal += bookmark_journal::EncodeNode(node);
+  }
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+  LogPerfResult("Bookmarks_Write_journal",
+                elapsed.InMillisecondsF() / kEditCount, "ms");
+  LogPerfResult("Bookmarks_WriteBytesPerEdit_journal",
+                (journal.size() - header_size) / kEditCount, "bytes");
+  ASSERT_EQ(static_cast<int>(journal.size()),
+            file_util::WriteFile(journal_path, journal.data(),
+                                 journal.size()));
+
+  Load(path, FilePath(), "snapshot");
+  Load(path, journal_path, "snapshot_journal");
+}
@@ -0,0 +1,671 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/compact_url_index.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/hash.h"
+#include "base/logging.h"
+#include "chrome/browser/history/varint.h"
+#include "googleurl/src/gurl.h"
+
+namespace history {
+
+namespace {
+
+const uint32 kIndexMagic = 0x48515049;  // "HQPI"
+
+// Bump this when the layout changes. Files of other versions are ignored, and
+// the index is rebuilt from the history database.
+const uint32 kIndexVersion = 1;
+
+// The arrays of an index, in the order they are laid out.
+enum Section {
+  kWordsSection,
+  kWordOffsetsSection,
+  kCharsSection,
+  kCharOffsetsSection,
+  kCharPostingsSection,
+  kHistoryOffsetsSection,
+  kHistoryPostingsSection,
+  kHistoryIDsSection,
+  kRowsSection,
+  kURLSpecsSection,
+  kTitlesSection,
+  kWordStartsSection,
+  kSectionCount
+};
+
+struct SectionEntry {
+  uint32 offset;  // From the start of the index.
+  uint32 size;    // In bytes.
+};
+
+// An index starts with this header, which is followed by the sections.
+struct IndexHeader {
+  uint32 magic;
+
+  // base::Hash() of everything after the checksum, up to the end of the index.
+  uint32 checksum;
+
+  uint32 version;
+  uint32 word_count;
+  uint32 char_count;
+  uint32 row_count;
+  SectionEntry sections[kSectionCount];
+};
+
+// Where the bytes covered by the checksum start.
+const size_t kChecksummedOffset = offsetof(IndexHeader, version);
+
+// Sections, and so everything in them, are 8 byte aligned.
+size_t Align(size_t size) {
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// Appends the ascending |ids| to |out| as deltas from their predecessors.
+template<typename ID>
+void AppendPostings(const std::vector<ID>& ids, std::vector<uint8>* out) {
+  uint64 previous = 0;
+  for (typename std::vector<ID>::const_iterator it = ids.begin();
+       it != ids.end(); ++it) {
+    uint64 id = static_cast<uint64>(*it);
+    DCHECK(it == ids.begin() || id > previous);
+    AppendVarint(id - previous, out);
+    previous = id;
+  }
+}
+
+// Decodes the posting list from |begin| up to |end| into |ids|.
+template<typename ID>
+void DecodePostings(const uint8* begin,
+                    const uint8* end,
+                    std::vector<ID>* ids) {
+  ids->clear();
+  uint64 id = 0;
+  while (begin < end) {
+    id += ReadVarint(&begin, end);
+    ids->push_back(static_cast<ID>(id));
+  }
+}
+
+// Appends |size| bytes at |data| to |buffer| as |section|.
+void AppendSection(Section section,
+                   const void* data,
+                   size_t size,
+                   IndexHeader* header,
+                   std::string* buffer) {
+  buffer->resize(Align(buffer->size()), '\0');
+  header->sections[section].offset = buffer->size();
+  header->sections[section].size = size;
+  if (size)
+    buffer->append(static_cast<const char*>(data), size);
+}
+
+template<typename T>
+void AppendVectorSection(Section section,
+                         const std::vector<T>& values,
+                         IndexHeader* header,
+                         std::string* buffer) {
+  AppendSection(section, values.empty() ? NULL : &values[0],
+                values.size() * sizeof(T), header, buffer);
+}
+
+// Returns true if the |count| + 1 |offsets| ascend from 0 to |limit|.
+bool OffsetsAreValid(const uint32* offsets, size_t count, size_t limit) {
+  if (offsets[0] != 0 || offsets[count] != limit)
+    return false;
+  for (size_t i = 0; i < count; ++i) {
+    if (offsets[i] > offsets[i + 1])
+      return false;
+  }
+  return true;
+}
+
+// Returns true if |ids| ascend strictly, as the IDs of a posting list do.
+template <typename ID>
+bool IDsAscend(const std::vector<ID>& ids) {
+  for (size_t i = 1; i < ids.size(); ++i) {
+    if (ids[i - 1] >= ids[i])
+      return false;
+  }
+  return true;
+}
+
+// Returns true if |offset| + |length| is no more than |limit|.
+bool RangeIsValid(uint32 offset, uint32 length, size_t limit) {
+  return static_cast<uint64>(offset) + length <= limit;
+}
+
+}  // namespace
+
+// The fixed size part of an item. Its strings and word starts are held in
+// other sections, at the given offsets, in elements.
+struct CompactURLIndex::RowRecord {
+  int64 last_visit;
+  int32 visit_count;
+  int32 typed_count;
+  uint32 url_spec_offset;
+  uint32 url_spec_length;
+  uint32 title_offset;
+  uint32 title_length;
+  uint32 word_starts_offset;
+  uint32 url_word_starts_count;
+  uint32 title_word_starts_count;
+  uint32 unused;
+};
+
+COMPILE_ASSERT(sizeof(IndexHeader) % 8 == 0, index_header_is_not_aligned);
+
+// CompactURLIndex::Builder ----------------------------------------------------
+
+CompactURLIndex::Builder::Row::Row()
+    : visit_count(0),
+      typed_count(0),
+      last_visit(0) {
+}
+
+CompactURLIndex::Builder::Row::~Row() {}
+
+CompactURLIndex::Builder::Builder() {}
+
+CompactURLIndex::Builder::~Builder() {}
+
+void CompactURLIndex::Builder::AddRow(const URLRow& row,
+                                      const RowWordStarts& word_starts) {
+  Row& new_row = rows_[row.id()];
+  new_row.url_spec = row.url().spec();
+  new_row.title = row.title();
+  new_row.visit_count = row.visit_count();
+  new_row.typed_count = row.typed_count();
+  new_row.last_visit = row.last_visit().ToInternalValue();
+  new_row.word_starts = word_starts;
+}
+
+void CompactURLIndex::Builder::AddWord(const string16& word,
+                                       HistoryID history_id) {
+  word_history_ids_[word].push_back(history_id);
+}
+
+void CompactURLIndex::Builder::AddIndex(const CompactURLIndex& index,
+                                        const HistoryIDSet& excluded_ids) {
+  HistoryIDVector history_ids;
+  for (WordID word_id = 0; word_id < index.word_count(); ++word_id) {
+    index.GetHistoryIDs(word_id, &history_ids);
+    HistoryIDVector* word_history_ids = NULL;
+    for (HistoryIDVector::const_iterator it = history_ids.begin();
+         it != history_ids.end(); ++it) {
+      if (excluded_ids.find(*it) != excluded_ids.end())
+        continue;
+      if (!word_history_ids)
+        word_history_ids = &word_history_ids_[index.GetWord(word_id)];
+      word_history_ids->push_back(*it);
+    }
+  }
+
+  // The rows are copied as they are, which spares parsing their URLs.
+  for (size_t i = 0; i < index.row_count(); ++i) {
+    HistoryID history_id = index.history_id_at(i);
+    if (excluded_ids.find(history_id) != excluded_ids.end())
+      continue;
+    const RowRecord& record = index.rows_[i];
+    Row& row = rows_[history_id];
+    row.url_spec = index.url_spec_at(i).as_string();
+    row.title.assign(index.titles_ + record.title_offset, record.title_length);
+    row.visit_count = record.visit_count;
+    row.typed_count = record.typed_count;
+    row.last_visit = record.last_visit;
+    row.word_starts = index.GetWordStartsAt(i);
+  }
+}
+
+scoped_refptr<CompactURLIndex> CompactURLIndex::Builder::Build() {
+  // The words, and the items each occurs in. Words are visited in ascending
+  // order, so each character collects its words in ascending order too.
+  string16 words;
+  std::vector<uint32> word_offsets(1, 0);
+  std::vector<uint32> history_offsets(1, 0);
+  std::vector<uint8> history_postings;
+  std::map<char16, WordIDVector> char_word_ids;
+  word_offsets.reserve(word_history_ids_.size() + 1);
+  history_offsets.reserve(word_history_ids_.size() + 1);
+  for (std::map<string16, HistoryIDVector>::iterator it =
+           word_history_ids_.begin(); it != word_history_ids_.end(); ++it) {
+    const string16& word = it->first;
+    WordID word_id = word_offsets.size() - 1;
+    words.append(word);
+    word_offsets.push_back(words.length());
+
+    HistoryIDVector& history_ids = it->second;
+    std::sort(history_ids.begin(), history_ids.end());
+    history_ids.erase(std::unique(history_ids.begin(), history_ids.end()),
+                      history_ids.end());
+    AppendPostings(history_ids, &history_postings);
+    history_offsets.push_back(history_postings.size());
+
+    Char16Set chars = Char16SetFromString16(word);
+    for (Char16Set::const_iterator c = chars.begin(); c != chars.end(); ++c)
+      char_word_ids[*c].push_back(word_id);
+  }
+
+  Char16Vector chars;
+  std::vector<uint32> char_offsets(1, 0);
+  std::vector<uint8> char_postings;
+  for (std::map<char16, WordIDVector>::const_iterator it =
+           char_word_ids.begin(); it != char_word_ids.end(); ++it) {
+    chars.push_back(it->first);
+    AppendPostings(it->second, &char_postings);
+    char_offsets.push_back(char_postings.size());
+  }
+
+  std::vector<int64> history_ids;
+  std::vector<RowRecord> records;
+  std::string url_specs;
+  string16 titles;
+  std::vector<uint32> word_starts;
+  history_ids.reserve(rows_.size());
+  records.reserve(rows_.size());
+  for (std::map<HistoryID, Row>::const_iterator it = rows_.begin();
+       it != rows_.end(); ++it) {
+    const Row& row = it->second;
+    RowRecord record;
+    memset(&record, 0, sizeof(record));
+    record.last_visit = row.last_visit;
+    record.visit_count = row.visit_count;
+    record.typed_count = row.typed_count;
+    record.url_spec_offset = url_specs.size();
+    record.url_spec_length = row.url_spec.size();
+    url_specs.append(row.url_spec);
+    record.title_offset = titles.size();
+    record.title_length = row.title.size();
+    titles.append(row.title);
+    record.word_starts_offset = word_starts.size();
+    record.url_word_starts_count = row.word_starts.url_word_starts_.size();
+    record.title_word_starts_count = row.word_starts.title_word_starts_.size();
+    word_starts.insert(word_starts.end(),
+                       row.word_starts.url_word_starts_.begin(),
+                       row.word_starts.url_word_starts_.end());
+    word_starts.insert(word_starts.end(),
+                       row.word_starts.title_word_starts_.begin(),
+                       row.word_starts.title_word_starts_.end());
+    history_ids.push_back(it->first);
+    records.push_back(record);
+  }
+
+  IndexHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kIndexMagic;
+  header.version = kIndexVersion;
+  header.word_count = word_offsets.size() - 1;
+  header.char_count = chars.size();
+  header.row_count = records.size();
+
+  scoped_refptr<CompactURLIndex> index(new CompactURLIndex);
+  std::string& buffer = index->buffer_;
+  buffer.reserve(sizeof(header) + 8 * kSectionCount +
+                 words.size() * sizeof(char16) +
+                 (word_offsets.size() + char_offsets.size() +
+                  history_offsets.size() + word_starts.size()) *
+                     sizeof(uint32) +
+                 chars.size() * sizeof(char16) + char_postings.size() +
+                 history_postings.size() + history_ids.size() * sizeof(int64) +
+                 records.size() * sizeof(RowRecord) + url_specs.size() +
+                 titles.size() * sizeof(char16));
+  buffer.resize(sizeof(header), '\0');
+  AppendSection(kWordsSection, words.data(), words.size() * sizeof(char16),
+                &header, &buffer);
+  AppendVectorSection(kWordOffsetsSection, word_offsets, &header, &buffer);
+  AppendVectorSection(kCharsSection, chars, &header, &buffer);
+  AppendVectorSection(kCharOffsetsSection, char_offsets, &header, &buffer);
+  AppendVectorSection(kCharPostingsSection, char_postings, &header, &buffer);
+  AppendVectorSection(kHistoryOffsetsSection, history_offsets, &header,
+                      &buffer);
+  AppendVectorSection(kHistoryPostingsSection, history_postings, &header,
+                      &buffer);
+  AppendVectorSection(kHistoryIDsSection, history_ids, &header, &buffer);
+  AppendVectorSection(kRowsSection, records, &header, &buffer);
+  AppendSection(kURLSpecsSection, url_specs.data(), url_specs.size(), &header,
+                &buffer);
+  AppendSection(kTitlesSection, titles.data(), titles.size() * sizeof(char16),
+                &header, &buffer);
+  AppendVectorSection(kWordStartsSection, word_starts, &header, &buffer);
+  buffer.resize(Align(buffer.size()), '\0');
+  memcpy(&buffer[0], &header, sizeof(header));
+  header.checksum = base::Hash(buffer.data() + kChecksummedOffset,
+                               buffer.size() - kChecksummedOffset);
+  memcpy(&buffer[0], &header, sizeof(header));
+
+  word_history_ids_.clear();
+  rows_.clear();
+
+  bool valid = index->Init(reinterpret_cast<const uint8*>(buffer.data()),
+                           buffer.size(), false);
+  DCHECK(valid);
+  return index;
+}
+
+// CompactURLIndex -------------------------------------------------------------
+
+CompactURLIndex::CompactURLIndex()
+    : data_(NULL),
+      size_(0),
+      word_count_(0),
+      char_count_(0),
+      row_count_(0),
+      words_(NULL),
+      word_offsets_(NULL),
+      chars_(NULL),
+      char_offsets_(NULL),
+      char_postings_(NULL),
+      history_offsets_(NULL),
+      history_postings_(NULL),
+      history_ids_(NULL),
+      rows_(NULL),
+      url_specs_(NULL),
+      titles_(NULL),
+      word_starts_(NULL) {
+}
+
+CompactURLIndex::~CompactURLIndex() {}
+
+// static
+scoped_refptr<CompactURLIndex> CompactURLIndex::CreateFromFile(
+    const FilePath& file_path) {
+  scoped_ptr<file_util::MemoryMappedFile> file(
+      new file_util::MemoryMappedFile);
+  if (!file->Initialize(file_path))
+    return NULL;
+  scoped_refptr<CompactURLIndex> index(new CompactURLIndex);
+  if (!index->Init(file->data(), file->length(), true))
+    return NULL;
+  index->file_.swap(file);
+  return index;
+}
+
+bool CompactURLIndex::WriteToFile(const FilePath& file_path) const {
+  if (!is_mapped())
+    return base::ImportantFileWriter::WriteFileAtomically(file_path, buffer_);
+  return base::ImportantFileWriter::WriteFileAtomically(
+      file_path, std::string(reinterpret_cast<const char*>(data_), size_));
+}
+
+bool CompactURLIndex::Init(const uint8* data,
+                           size_t size,
+                           bool verify_checksum) {
+  COMPILE_ASSERT(sizeof(RowRecord) == 48, row_record_is_not_packed);
+  IndexHeader header;
+  if (size < sizeof(header) || size > kuint32max)
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != kIndexMagic || header.version != kIndexVersion)
+    return false;
+  if (verify_checksum &&
+      base::Hash(reinterpret_cast<const char*>(data) + kChecksummedOffset,
+                 size - kChecksummedOffset) != header.checksum) {
+    DLOG(WARNING) << "Bad checksum in the HistoryQuickProvider index.";
+    return false;
+  }
+
+  // Every section must lie within the index and hold whole elements.
+  const size_t kElementSizes[kSectionCount] = {
+    sizeof(char16), sizeof(uint32), sizeof(char16), sizeof(uint32),
+    sizeof(uint8), sizeof(uint32), sizeof(uint8), sizeof(int64),
+    sizeof(RowRecord), sizeof(char), sizeof(char16), sizeof(uint32),
+  };
+  size_t counts[kSectionCount];
+  for (int i = 0; i < kSectionCount; ++i) {
+    const SectionEntry& section = header.sections[i];
+    if (section.offset < sizeof(header) || section.offset % 8 != 0 ||
+        !RangeIsValid(section.offset, section.size, size) ||
+        section.size % kElementSizes[i] != 0) {
+      return false;
+    }
+    counts[i] = section.size / kElementSizes[i];
+  }
+  if (counts[kWordOffsetsSection] != header.word_count + 1 ||
+      counts[kHistoryOffsetsSection] != header.word_count + 1 ||
+      counts[kCharsSection] != header.char_count ||
+      counts[kCharOffsetsSection] != header.char_count + 1 ||
+      counts[kHistoryIDsSection] != header.row_count ||
+      counts[kRowsSection] != header.row_count) {
+    return false;
+  }
+
+  data_ = data;
+  size_ = size;
+  word_count_ = header.word_count;
+  char_count_ = header.char_count;
+  row_count_ = header.row_count;
+#define SECTION(type, section) \
+    reinterpret_cast<const type*>(data + header.sections[section].offset)
+  words_ = SECTION(char16, kWordsSection);
+  word_offsets_ = SECTION(uint32, kWordOffsetsSection);
+  chars_ = SECTION(char16, kCharsSection);
+  char_offsets_ = SECTION(uint32, kCharOffsetsSection);
+  char_postings_ = SECTION(uint8, kCharPostingsSection);
+  history_offsets_ = SECTION(uint32, kHistoryOffsetsSection);
+  history_postings_ = SECTION(uint8, kHistoryPostingsSection);
+  history_ids_ = SECTION(int64, kHistoryIDsSection);
+  rows_ = SECTION(RowRecord, kRowsSection);
+  url_specs_ = SECTION(char, kURLSpecsSection);
+  titles_ = SECTION(char16, kTitlesSection);
+  word_starts_ = SECTION(uint32, kWordStartsSection);
+#undef SECTION
+
+  // Check everything the accessors rely on, so that they never read outside
+  // the index.
+  if (!OffsetsAreValid(word_offsets_, word_count_, counts[kWordsSection]) ||
+      !OffsetsAreValid(char_offsets_, char_count_,
+                       counts[kCharPostingsSection]) ||
+      !OffsetsAreValid(history_offsets_, word_count_,
+                       counts[kHistoryPostingsSection])) {
+    return false;
+  }
+  for (size_t i = 1; i < char_count_; ++i) {
+    if (chars_[i - 1] >= chars_[i])
+      return false;
+  }
+  // An entry which wrapped around when it was decoded breaks the order.
+  WordIDVector word_ids;
+  for (size_t i = 0; i < char_count_; ++i) {
+    DecodePostings(char_postings_ + char_offsets_[i],
+                   char_postings_ + char_offsets_[i + 1], &word_ids);
+    if (!IDsAscend(word_ids) ||
+        (!word_ids.empty() && word_ids.back() >= word_count_))
+      return false;
+  }
+  HistoryIDVector history_ids;
+  for (size_t i = 0; i < word_count_; ++i) {
+    DecodePostings(history_postings_ + history_offsets_[i],
+                   history_postings_ + history_offsets_[i + 1], &history_ids);
+    if (!IDsAscend(history_ids))
+      return false;
+  }
+  for (size_t i = 0; i < row_count_; ++i) {
+    if (i > 0 && history_ids_[i - 1] >= history_ids_[i])
+      return false;
+    const RowRecord& record = rows_[i];
+    if (!RangeIsValid(record.url_spec_offset, record.url_spec_length,
+                      counts[kURLSpecsSection]) ||
+        !RangeIsValid(record.title_offset, record.title_length,
+                      counts[kTitlesSection]) ||
+        static_cast<uint64>(record.word_starts_offset) +
+            record.url_word_starts_count + record.title_word_starts_count >
+            counts[kWordStartsSection]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+string16 CompactURLIndex::GetWord(WordID word_id) const {
+  DCHECK_LT(word_id, word_count());
+  return string16(words_ + word_offsets_[word_id],
+                  word_offsets_[word_id + 1] - word_offsets_[word_id]);
+}
+
+bool CompactURLIndex::WordContains(WordID word_id,
+                                   const string16& term) const {
+  DCHECK_LT(word_id, word_count());
+  const char16* begin = words_ + word_offsets_[word_id];
+  const char16* end = words_ + word_offsets_[word_id + 1];
+  return std::search(begin, end, term.begin(), term.end()) != end;
+}
+
+void CompactURLIndex::GetWordIDsForChars(const Char16Set& chars,
+                                         WordIDVector* word_ids) const {
+  word_ids->clear();
+  if (chars.empty())
+    return;
+
+  // Intersect the shortest posting lists first, as they narrow the set the
+  // quickest.
+  std::vector<std::pair<uint32, size_t> > postings;
+  for (Char16Set::const_iterator c = chars.begin(); c != chars.end(); ++c) {
+    const char16* pos = std::lower_bound(chars_, chars_ + char_count_, *c);
+    if (pos == chars_ + char_count_ || *pos != *c)
+      return;  // No word has this character.
+    size_t i = pos - chars_;
+    postings.push_back(std::make_pair(char_offsets_[i + 1] - char_offsets_[i],
+                                      i));
+  }
+  std::sort(postings.begin(), postings.end());
+
+  WordIDVector char_word_ids;
+  for (size_t i = 0; i < postings.size(); ++i) {
+    size_t char_index = postings[i].second;
+    DecodePostings(char_postings_ + char_offsets_[char_index],
+                   char_postings_ + char_offsets_[char_index + 1],
+                   &char_word_ids);
+    if (i == 0) {
+      word_ids->swap(char_word_ids);
+    } else {
+      WordIDVector intersection;
+      std::set_intersection(word_ids->begin(), word_ids->end(),
+                            char_word_ids.begin(), char_word_ids.end(),
+                            std::back_inserter(intersection));
+      word_ids->swap(intersection);
+    }
+    if (word_ids->empty())
+      return;
+  }
+}
+
+void CompactURLIndex::GetHistoryIDs(WordID word_id,
+                                    HistoryIDVector* history_ids) const {
+  DCHECK_LT(word_id, word_count());
+  DecodePostings(history_postings_ + history_offsets_[word_id],
+                 history_postings_ + history_offsets_[word_id + 1],
+                 history_ids);
+}
+
+void CompactURLIndex::AddHistoryIDsForWords(const WordIDVector& word_ids,
+                                            const HistoryIDSet& excluded_ids,
+                                            HistoryIDSet* history_ids) const {
+  // Gather everything in a vector first; inserting the sorted result into the
+  // set is then little more than appending to it.
+  HistoryIDVector all_ids;
+  HistoryIDVector word_history_ids;
+  for (WordIDVector::const_iterator it = word_ids.begin();
+       it != word_ids.end(); ++it) {
+    GetHistoryIDs(*it, &word_history_ids);
+    all_ids.insert(all_ids.end(), word_history_ids.begin(),
+                   word_history_ids.end());
+  }
+  std::sort(all_ids.begin(), all_ids.end());
+  all_ids.erase(std::unique(all_ids.begin(), all_ids.end()), all_ids.end());
+  for (HistoryIDVector::const_iterator it = all_ids.begin();
+       it != all_ids.end(); ++it) {
+    if (excluded_ids.empty() || excluded_ids.find(*it) == excluded_ids.end())
+      history_ids->insert(history_ids->end(), *it);
+  }
+}
+
+bool CompactURLIndex::HasRow(HistoryID history_id) const {
+  return FindRow(history_id) != row_count();
+}
+
+bool CompactURLIndex::GetRow(HistoryID history_id, URLRow* row) const {
+  size_t index = FindRow(history_id);
+  if (index == row_count())
+    return false;
+  *row = GetRowAt(index);
+  return true;
+}
+
+bool CompactURLIndex::GetWordStarts(HistoryID history_id,
+                                    RowWordStarts* word_starts) const {
+  size_t index = FindRow(history_id);
+  if (index == row_count())
+    return false;
+  *word_starts = GetWordStartsAt(index);
+  return true;
+}
+
+bool CompactURLIndex::GetRowFactors(HistoryID history_id,
+                                    int* typed_count,
+                                    int* visit_count,
+                                    base::Time* last_visit) const {
+  size_t index = FindRow(history_id);
+  if (index == row_count())
+    return false;
+  const RowRecord& record = rows_[index];
+  *typed_count = record.typed_count;
+  *visit_count = record.visit_count;
+  *last_visit = base::Time::FromInternalValue(record.last_visit);
+  return true;
+}
+
+HistoryID CompactURLIndex::history_id_at(size_t index) const {
+  DCHECK_LT(index, row_count());
+  return history_ids_[index];
+}
+
+base::StringPiece CompactURLIndex::url_spec_at(size_t index) const {
+  DCHECK_LT(index, row_count());
+  const RowRecord& record = rows_[index];
+  return base::StringPiece(url_specs_ + record.url_spec_offset,
+                           record.url_spec_length);
+}
+
+URLRow CompactURLIndex::GetRowAt(size_t index) const {
+  DCHECK_LT(index, row_count());
+  const RowRecord& record = rows_[index];
+  URLRow row(GURL(url_spec_at(index).as_string()), history_ids_[index]);
+  row.set_title(string16(titles_ + record.title_offset, record.title_length));
+  row.set_visit_count(record.visit_count);
+  row.set_typed_count(record.typed_count);
+  row.set_last_visit(base::Time::FromInternalValue(record.last_visit));
+  return row;
+}
+
+RowWordStarts CompactURLIndex::GetWordStartsAt(size_t index) const {
+  DCHECK_LT(index, row_count());
+  const RowRecord& record = rows_[index];
+  const uint32* url_starts = word_starts_ + record.word_starts_offset;
+  const uint32* title_starts = url_starts + record.url_word_starts_count;
+  RowWordStarts word_starts;
+  word_starts.url_word_starts_.assign(url_starts, title_starts);
+  word_starts.title_word_starts_.assign(
+      title_starts, title_starts + record.title_word_starts_count);
+  return word_starts;
+}
+
+size_t CompactURLIndex::FindRow(HistoryID history_id) const {
+  const int64* end = history_ids_ + row_count_;
+  const int64* pos = std::lower_bound(history_ids_, end, history_id);
+  if (pos == end || *pos != history_id)
+    return row_count();
+  return pos - history_ids_;
+}
+
+}  // namespace history
@@ -0,0 +1,219 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_COMPACT_URL_INDEX_H_
+#define CHROME_BROWSER_HISTORY_COMPACT_URL_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string16.h"
+#include "base/string_piece.h"
+#include "base/time.h"
+#include "chrome/browser/history/in_memory_url_index_types.h"
+
+class FilePath;
+
+namespace file_util {
+class MemoryMappedFile;
+}
+
+namespace history {
+
+// An immutable form of the word, character and history item indexes kept by
+// URLIndexPrivateData, laid out in a handful of flat arrays rather than in
+// maps of sets:
+//
+//  - The words are sorted and packed back to back into a single array, so
+//    that a WordID is the position of a word in sorted order.
+//  - The characters are a sorted array, each with a posting list of the
+//    WordIDs of the words containing it.
+//  - Each word has a posting list of the HistoryIDs of the items it occurs
+//    in.
+//  - The items are sorted by HistoryID, each with a fixed size record which
+//    points into arrays of URLs, titles and word starts.
+//
+// Posting lists hold ascending IDs as variable length encoded deltas, which
+// for typical histories takes one or two bytes per entry instead of the
+// forty or so of a std::set node.
+//
+// All the arrays live in a single block of memory, which is also the format
+// of the index on disk: a header with a version and a checksum, then the
+// arrays. An index saved with WriteToFile() is memory mapped by
+// CreateFromFile() and searched where it lies, without being deserialized.
+//
+// Being immutable, a CompactURLIndex may be shared by several
+// URLIndexPrivateData objects and read on any thread.
+class CompactURLIndex : public base::RefCountedThreadSafe<CompactURLIndex> {
+ public:
+  // Collects the contents of an index, in any order, then builds it.
+  class Builder {
+   public:
+    Builder();
+    ~Builder();
+
+    // Adds the history item |row| with the word starts of its URL and title.
+    void AddRow(const URLRow& row, const RowWordStarts& word_starts);
+
+    // Records that |word| occurs in the item with |history_id|.
+    void AddWord(const string16& word, HistoryID history_id);
+
+    // Adds the items and words of |index|, except for the items in
+    // |excluded_ids|.
+    void AddIndex(const CompactURLIndex& index,
+                  const HistoryIDSet& excluded_ids);
+
+    // Builds the index from everything added so far, and empties the builder.
+    scoped_refptr<CompactURLIndex> Build();
+
+   private:
+    struct Row {
+      Row();
+      ~Row();
+
+      std::string url_spec;
+      string16 title;
+      int visit_count;
+      int typed_count;
+      int64 last_visit;
+      RowWordStarts word_starts;
+    };
+
+    std::map<string16, HistoryIDVector> word_history_ids_;
+    std::map<HistoryID, Row> rows_;
+
+    DISALLOW_COPY_AND_ASSIGN(Builder);
+  };
+
+  // Maps the index written to |file_path| by WriteToFile(). Returns NULL if
+  // the file can't be mapped, or doesn't hold a valid index of the current
+  // version. Windows can't replace a file while it is mapped, so the file
+  // must not be written again for as long as the index lives.
+  static scoped_refptr<CompactURLIndex> CreateFromFile(
+      const FilePath& file_path);
+
+  // Writes the index to |file_path|, replacing whatever was there at once.
+  // Returns true on success.
+  bool WriteToFile(const FilePath& file_path) const;
+
+  size_t word_count() const { return word_count_; }
+  size_t row_count() const { return row_count_; }
+
+  // Returns true if the index is mapped from a file.
+  bool is_mapped() const { return file_.get() != NULL; }
+
+  // Returns the |word_id|th word.
+  string16 GetWord(WordID word_id) const;
+
+  // Returns true if the |word_id|th word contains |term|.
+  bool WordContains(WordID word_id, const string16& term) const;
+
+  // Sets |word_ids| to the ascending IDs of the words containing every
+  // character in |chars|.
+  void GetWordIDsForChars(const Char16Set& chars,
+                          WordIDVector* word_ids) const;
+
+  // Sets |history_ids| to the ascending IDs of the items the |word_id|th word
+  // occurs in.
+  void GetHistoryIDs(WordID word_id, HistoryIDVector* history_ids) const;
+
+  // Adds the IDs of the items any of |word_ids| occur in to |history_ids|,
+  // except for those in |excluded_ids|.
+  void AddHistoryIDsForWords(const WordIDVector& word_ids,
+                             const HistoryIDSet& excluded_ids,
+                             HistoryIDSet* history_ids) const;
+
+  // Returns true if the index holds the item with |history_id|.
+  bool HasRow(HistoryID history_id) const;
+
+  // Sets |row| or |word_starts| to those of the item with |history_id|.
+  // Returns false if there is no such item.
+  bool GetRow(HistoryID history_id, URLRow* row) const;
+  bool GetWordStarts(HistoryID history_id, RowWordStarts* word_starts) const;
+
+  // Gets what the candidates of a search are ranked by before they are
+  // scored, for the item with |history_id|, without building its URLRow.
+  // Returns false if there is no such item.
+  bool GetRowFactors(HistoryID history_id,
+                     int* typed_count,
+                     int* visit_count,
+                     base::Time* last_visit) const;
+
+  // Accessors for the |index|th item, in ascending HistoryID order.
+  HistoryID history_id_at(size_t index) const;
+  base::StringPiece url_spec_at(size_t index) const;
+  URLRow GetRowAt(size_t index) const;
+  RowWordStarts GetWordStartsAt(size_t index) const;
+
+  // Returns the number of bytes of the index, whether they are on the heap or
+  // mapped from a file.
+  size_t size() const { return size_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<CompactURLIndex>;
+  struct RowRecord;
+
+  CompactURLIndex();
+  ~CompactURLIndex();
+
+  // Points the arrays at the index in |data|, checking that it is valid.
+  // |data| must outlive the index. The checksum, which covers every byte, is
+  // only worth verifying for an index read from disk. Returns false if the
+  // index isn't valid.
+  bool Init(const uint8* data, size_t size, bool verify_checksum);
+
+  // Returns the position of the item with |history_id|, or row_count() if
+  // there is none.
+  size_t FindRow(HistoryID history_id) const;
+
+  // Holds the index when it was built rather than mapped.
+  std::string buffer_;
+
+  // Holds the index when it was mapped from a file.
+  scoped_ptr<file_util::MemoryMappedFile> file_;
+
+  const uint8* data_;
+  size_t size_;
+
+  size_t word_count_;
+  size_t char_count_;
+  size_t row_count_;
+
+  // The arrays, all pointing into |data_|.
+
+  // All the words, back to back, in ascending order. The |i|th word starts at
+  // word_offsets_[i] and ends at word_offsets_[i + 1].
+  const char16* words_;
+  const uint32* word_offsets_;
+
+  // The distinct characters of all the words, in ascending order. The posting
+  // list of the |i|th is in char_postings_, from char_offsets_[i] up to
+  // char_offsets_[i + 1].
+  const char16* chars_;
+  const uint32* char_offsets_;
+  const uint8* char_postings_;
+
+  // The posting list of the |i|th word is in history_postings_, from
+  // history_offsets_[i] up to history_offsets_[i + 1].
+  const uint32* history_offsets_;
+  const uint8* history_postings_;
+
+  // The items, in ascending HistoryID order, and what their records point
+  // into.
+  const int64* history_ids_;
+  const RowRecord* rows_;
+  const char* url_specs_;
+  const char16* titles_;
+  const uint32* word_starts_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompactURLIndex);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_COMPACT_URL_INDEX_H_
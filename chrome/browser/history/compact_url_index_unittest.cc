@@ -0,0 +1,258 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/string16.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/compact_url_index.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+class CompactURLIndexTest : public testing::Test {
+ protected:
+  // Adds a row to |builder_|, along with the words of |words|, which are
+  // separated by spaces.
+  void AddRow(HistoryID history_id, const char* url, const char* words) {
+    URLRow row(GURL(url), history_id);
+    RowWordStarts word_starts;
+    word_starts.url_word_starts_.push_back(0);
+    builder_.AddRow(row, word_starts);
+    String16Vector row_words =
+        String16VectorFromString16(ASCIIToUTF16(words), false, NULL);
+    for (size_t i = 0; i < row_words.size(); ++i)
+      builder_.AddWord(row_words[i], history_id);
+  }
+
+  string16 Word(const CompactURLIndex& index, const char* chars) {
+    Char16Set char_set = Char16SetFromString16(ASCIIToUTF16(chars));
+    WordIDVector word_ids;
+    index.GetWordIDsForChars(char_set, &word_ids);
+    return word_ids.size() == 1 ? index.GetWord(word_ids[0]) : string16();
+  }
+
+  CompactURLIndex::Builder builder_;
+};
+
+TEST_F(CompactURLIndexTest, Empty) {
+  scoped_refptr<CompactURLIndex> index(builder_.Build());
+  EXPECT_EQ(0U, index->word_count());
+  EXPECT_EQ(0U, index->row_count());
+  EXPECT_FALSE(index->HasRow(1));
+  WordIDVector word_ids;
+  index->GetWordIDsForChars(Char16SetFromString16(ASCIIToUTF16("a")),
+                            &word_ids);
+  EXPECT_TRUE(word_ids.empty());
+}
+
+TEST_F(CompactURLIndexTest, Words) {
+  AddRow(3, "http://www.google.com/", "http www google com");
+  AddRow(1, "http://mail.google.com/", "http mail google com");
+  scoped_refptr<CompactURLIndex> index(builder_.Build());
+
+  // The words are sorted and unique.
+  ASSERT_EQ(5U, index->word_count());
+  EXPECT_EQ(ASCIIToUTF16("com"), index->GetWord(0));
+  EXPECT_EQ(ASCIIToUTF16("google"), index->GetWord(1));
+  EXPECT_EQ(ASCIIToUTF16("http"), index->GetWord(2));
+  EXPECT_EQ(ASCIIToUTF16("mail"), index->GetWord(3));
+  EXPECT_EQ(ASCIIToUTF16("www"), index->GetWord(4));
+
+  EXPECT_TRUE(index->WordContains(1, ASCIIToUTF16("oog")));
+  EXPECT_TRUE(index->WordContains(1, ASCIIToUTF16("google")));
+  EXPECT_FALSE(index->WordContains(1, ASCIIToUTF16("googles")));
+  EXPECT_FALSE(index->WordContains(0, ASCIIToUTF16("http")));
+
+  EXPECT_EQ(ASCIIToUTF16("mail"), Word(*index, "ai"));
+  EXPECT_EQ(ASCIIToUTF16("www"), Word(*index, "w"));
+  EXPECT_EQ(ASCIIToUTF16("google"), Word(*index, "gle"));
+
+  WordIDVector word_ids;
+  index->GetWordIDsForChars(Char16SetFromString16(ASCIIToUTF16("o")),
+                            &word_ids);
+  ASSERT_EQ(2U, word_ids.size());
+  EXPECT_EQ(0U, word_ids[0]);
+  EXPECT_EQ(1U, word_ids[1]);
+
+  // A character no word has.
+  index->GetWordIDsForChars(Char16SetFromString16(ASCIIToUTF16("oz")),
+                            &word_ids);
+  EXPECT_TRUE(word_ids.empty());
+}
+
+TEST_F(CompactURLIndexTest, HistoryIDs) {
+  // Large and far apart IDs take several bytes to encode.
+  const HistoryID kIDs[] = { 1, 127, 128, 300, 16384, 5000000000LL };
+  for (size_t i = 0; i < arraysize(kIDs); ++i)
+    AddRow(kIDs[i], "http://example.com/", "example com");
+  AddRow(2, "http://other.org/", "other org");
+  // Adding the same word twice to an item is harmless.
+  builder_.AddWord(ASCIIToUTF16("other"), 2);
+  scoped_refptr<CompactURLIndex> index(builder_.Build());
+
+  HistoryIDVector history_ids;
+  index->GetHistoryIDs(1, &history_ids);  // "example"
+  ASSERT_EQ(arraysize(kIDs), history_ids.size());
+  for (size_t i = 0; i < arraysize(kIDs); ++i)
+    EXPECT_EQ(kIDs[i], history_ids[i]);
+  index->GetHistoryIDs(3, &history_ids);  // "other"
+  ASSERT_EQ(1U, history_ids.size());
+  EXPECT_EQ(2, history_ids[0]);
+
+  // Every item with "com" or "org", but 300.
+  WordIDVector word_ids;
+  word_ids.push_back(0);
+  word_ids.push_back(2);
+  HistoryIDSet excluded_ids;
+  excluded_ids.insert(300);
+  HistoryIDSet result;
+  index->AddHistoryIDsForWords(word_ids, excluded_ids, &result);
+  EXPECT_EQ(arraysize(kIDs), result.size());
+  EXPECT_EQ(1U, result.count(2));
+  EXPECT_EQ(0U, result.count(300));
+}
+
+TEST_F(CompactURLIndexTest, Rows) {
+  URLRow row(GURL("http://b.com/"), 20);
+  row.set_title(ASCIIToUTF16("Bee"));
+  row.set_visit_count(3);
+  row.set_typed_count(2);
+  row.set_last_visit(base::Time::FromInternalValue(123456789));
+  RowWordStarts word_starts;
+  word_starts.url_word_starts_.push_back(0);
+  word_starts.url_word_starts_.push_back(7);
+  word_starts.title_word_starts_.push_back(0);
+  builder_.AddRow(row, word_starts);
+  AddRow(10, "http://a.com/", "a com");
+  scoped_refptr<CompactURLIndex> index(builder_.Build());
+  EXPECT_FALSE(index->is_mapped());
+
+  ASSERT_EQ(2U, index->row_count());
+  EXPECT_EQ(10, index->history_id_at(0));
+  EXPECT_EQ(20, index->history_id_at(1));
+  EXPECT_EQ("http://a.com/", index->url_spec_at(0).as_string());
+
+  URLRow found_row;
+  ASSERT_TRUE(index->GetRow(20, &found_row));
+  EXPECT_EQ(20, found_row.id());
+  EXPECT_EQ(GURL("http://b.com/"), found_row.url());
+  EXPECT_EQ(ASCIIToUTF16("Bee"), found_row.title());
+  EXPECT_EQ(3, found_row.visit_count());
+  EXPECT_EQ(2, found_row.typed_count());
+  EXPECT_EQ(123456789, found_row.last_visit().ToInternalValue());
+
+  int typed_count = 0;
+  int visit_count = 0;
+  base::Time last_visit;
+  ASSERT_TRUE(index->GetRowFactors(20, &typed_count, &visit_count,
+                                   &last_visit));
+  EXPECT_EQ(2, typed_count);
+  EXPECT_EQ(3, visit_count);
+  EXPECT_EQ(123456789, last_visit.ToInternalValue());
+
+  RowWordStarts found_word_starts;
+  ASSERT_TRUE(index->GetWordStarts(20, &found_word_starts));
+  EXPECT_EQ(word_starts.url_word_starts_, found_word_starts.url_word_starts_);
+  EXPECT_EQ(word_starts.title_word_starts_,
+            found_word_starts.title_word_starts_);
+  EXPECT_TRUE(index->HasRow(10));
+  EXPECT_FALSE(index->HasRow(15));
+  EXPECT_FALSE(index->GetRow(15, &found_row));
+  EXPECT_FALSE(index->GetWordStarts(30, &found_word_starts));
+  EXPECT_GT(index->size(), 0U);
+
+  // The builder is left empty.
+  EXPECT_EQ(0U, builder_.Build()->row_count());
+}
+
+TEST_F(CompactURLIndexTest, AddIndex) {
+  AddRow(1, "http://a.com/", "a com");
+  AddRow(2, "http://b.org/", "b org");
+  AddRow(3, "http://c.com/", "c com");
+  scoped_refptr<CompactURLIndex> old_index(builder_.Build());
+
+  HistoryIDSet excluded_ids;
+  excluded_ids.insert(2);
+  builder_.AddIndex(*old_index, excluded_ids);
+  AddRow(4, "http://d.net/", "d net");
+  scoped_refptr<CompactURLIndex> index(builder_.Build());
+
+  ASSERT_EQ(3U, index->row_count());
+  EXPECT_EQ(1, index->history_id_at(0));
+  EXPECT_EQ(3, index->history_id_at(1));
+  EXPECT_EQ(4, index->history_id_at(2));
+  EXPECT_EQ("http://c.com/", index->url_spec_at(1).as_string());
+  // The words only the excluded item had are gone.
+  EXPECT_EQ(string16(), Word(*index, "b"));
+  EXPECT_EQ(ASCIIToUTF16("net"), Word(*index, "n"));
+  HistoryIDVector history_ids;
+  index->GetHistoryIDs(2, &history_ids);  // "com"
+  ASSERT_EQ(2U, history_ids.size());
+  EXPECT_EQ(1, history_ids[0]);
+  EXPECT_EQ(3, history_ids[1]);
+}
+
+TEST_F(CompactURLIndexTest, File) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.path().AppendASCII("index");
+  EXPECT_FALSE(CompactURLIndex::CreateFromFile(file_path));
+
+  AddRow(3, "http://www.google.com/", "http www google com");
+  AddRow(1, "http://mail.google.com/", "http mail google com");
+  scoped_refptr<CompactURLIndex> built_index(builder_.Build());
+  ASSERT_TRUE(built_index->WriteToFile(file_path));
+
+  scoped_refptr<CompactURLIndex> index(
+      CompactURLIndex::CreateFromFile(file_path));
+  ASSERT_TRUE(index);
+  EXPECT_TRUE(index->is_mapped());
+  EXPECT_EQ(built_index->size(), index->size());
+  ASSERT_EQ(5U, index->word_count());
+  EXPECT_EQ(ASCIIToUTF16("mail"), Word(*index, "ai"));
+  HistoryIDVector history_ids;
+  index->GetHistoryIDs(1, &history_ids);  // "google"
+  ASSERT_EQ(2U, history_ids.size());
+  URLRow row;
+  ASSERT_TRUE(index->GetRow(3, &row));
+  EXPECT_EQ(GURL("http://www.google.com/"), row.url());
+
+  // A mapped index can be saved to another file.
+  FilePath other_path = temp_dir.path().AppendASCII("other_index");
+  ASSERT_TRUE(index->WriteToFile(other_path));
+  index = CompactURLIndex::CreateFromFile(other_path);
+  ASSERT_TRUE(index);
+  EXPECT_EQ(2U, index->row_count());
+}
+
+TEST_F(CompactURLIndexTest, CorruptFile) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.path().AppendASCII("index");
+  AddRow(1, "http://a.com/", "a com");
+  ASSERT_TRUE(builder_.Build()->WriteToFile(file_path));
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(file_path, &contents));
+
+  // A flipped bit anywhere is caught, whether by the checks of the layout or
+  // by the checksum.
+  for (size_t i = 0; i < contents.size(); i += 7) {
+    std::string corrupt = contents;
+    corrupt[i] ^= 0x10;
+    ASSERT_EQ(static_cast<int>(corrupt.size()),
+              file_util::WriteFile(file_path, corrupt.data(), corrupt.size()));
+    EXPECT_FALSE(CompactURLIndex::CreateFromFile(file_path)) << i;
+  }
+
+  // So is a truncated file.
+  ASSERT_EQ(16, file_util::WriteFile(file_path, contents.data(), 16));
+  EXPECT_FALSE(CompactURLIndex::CreateFromFile(file_path));
+}
+
+}  // namespace history
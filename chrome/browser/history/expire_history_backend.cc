@@ -13,6 +13,8 @@
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
+#include "base/metrics/histogram.h"
+#include "base/stl_util.h"
 #include "chrome/browser/api/bookmarks/bookmark_service.h"
 #include "chrome/browser/history/archived_database.h"
 #include "chrome/browser/history/history_database.h"
@@ -24,6 +26,7 @@
 
 using base::Time;
 using base::TimeDelta;
+using base::TimeTicks;
 
 namespace history {
 
@@ -145,8 +148,51 @@ const int kIndexExpirationDelayMin = 2;
 // the history index files.
 const int kStoreHistoryIndexesForMonths = 3;
 
+// The most visits expired in one chunk of a chunked expiration. Chunks are
+// expired until the step's time is up, so this only needs to be small enough
+// that one chunk doesn't take much longer than a step.
+const int kNumExpirePerChunk = 64;
+
+// How long a step of a chunked expiration runs for, and the delay before the
+// next, when other tasks have run on the history thread in the last
+// kExpirationBusyPeriodMs. Queries, pages being added and the like then wait
+// for at most one short step.
+const int kExpirationBusyPeriodMs = 1000;
+const int kBusyExpirationStepMs = 10;
+const int kBusyExpirationStepDelayMs = 40;
+
+// How long a step of a chunked expiration runs for when the history thread is
+// otherwise idle. The next step is posted with no delay.
+const int kIdleExpirationStepMs = 100;
+
 }  // namespace
 
+ExpirationProgress::ExpirationProgress()
+    : visits_expired(0),
+      step_count(0),
+      complete(false) {
+}
+
+struct ExpireHistoryBackend::ChunkedExpiration {
+  ChunkedExpiration() : restricted(false), next_visit(0) {}
+
+  // When there are no URLs to restrict the expiration to, the visits to expire
+  // are those from |begin_time| to |end_time|. |begin_time| is moved on past
+  // each chunk.
+  bool restricted;
+  base::Time begin_time;
+  base::Time end_time;
+
+  // Otherwise, the visits to the URLs in the time range are found up front,
+  // and are expired from |next_visit| on.
+  VisitVector visits;
+  size_t next_visit;
+
+  ExpirationProgressCallback callback;
+  ExpirationProgress progress;
+  TimeTicks start_time;
+};
+
 struct ExpireHistoryBackend::DeleteDependencies {
   // The time range affected. These can be is_null() to be unbounded in one
   // or both directions.
@@ -182,10 +228,16 @@ ExpireHistoryBackend::ExpireHistoryBackend(
       thumb_db_(NULL),
       text_db_(NULL),
       ALLOW_THIS_IN_INITIALIZER_LIST(weak_factory_(this)),
-      bookmark_service_(bookmark_service) {
+      bookmark_service_(bookmark_service),
+      expiration_chunk_size_(kNumExpirePerChunk),
+      in_expiration_step_(false) {
 }
 
 ExpireHistoryBackend::~ExpireHistoryBackend() {
+  if (!chunked_expirations_.empty()) {
+    MessageLoop::current()->RemoveTaskObserver(this);
+    STLDeleteElements(&chunked_expirations_);
+  }
 }
 
 void ExpireHistoryBackend::SetDatabases(HistoryDatabase* main_db,
@@ -271,6 +323,49 @@ void ExpireHistoryBackend::ExpireHistoryBetween(
   ExpireVisits(visits);
 }
 
+void ExpireHistoryBackend::ExpireHistoryBetweenInChunks(
+    const std::set<GURL>& restrict_urls,
+    Time begin_time,
+    Time end_time,
+    const ExpirationProgressCallback& callback) {
+  scoped_ptr<ChunkedExpiration> expiration(new ChunkedExpiration);
+  expiration->begin_time = begin_time;
+  expiration->end_time = end_time;
+  expiration->callback = callback;
+  expiration->start_time = TimeTicks::Now();
+
+  if (main_db_) {
+    // There may be stuff in the text database manager's temporary cache.
+    if (text_db_)
+      text_db_->DeleteFromUncommitted(restrict_urls, begin_time, end_time);
+
+    // The visits to a few URLs are cheap to find all at once. They are checked
+    // again as each chunk is expired, as they may be gone by then.
+    if (!restrict_urls.empty()) {
+      expiration->restricted = true;
+      for (std::set<GURL>::const_iterator url = restrict_urls.begin();
+           url != restrict_urls.end(); ++url) {
+        URLID url_id = main_db_->GetRowForURL(*url, NULL);
+        VisitVector visits;
+        if (!url_id || !main_db_->GetVisitsForURL(url_id, &visits))
+          continue;
+        for (VisitVector::const_iterator visit = visits.begin();
+             visit != visits.end(); ++visit) {
+          if (visit->visit_time >= begin_time &&
+              (end_time.is_null() || visit->visit_time < end_time))
+            expiration->visits.push_back(*visit);
+        }
+      }
+    }
+  }
+
+  if (chunked_expirations_.empty()) {
+    MessageLoop::current()->AddTaskObserver(this);
+    ScheduleExpirationStep();
+  }
+  chunked_expirations_.push_back(expiration.release());
+}
+
 void ExpireHistoryBackend::ExpireHistoryForTimes(
     const std::vector<base::Time>& times) {
   // |times| must be in reverse chronological order and have no
@@ -637,6 +732,103 @@ void ExpireHistoryBackend::DoArchiveIteration() {
   ScheduleArchive();
 }
 
+void ExpireHistoryBackend::ScheduleExpirationStep() {
+  TimeDelta delay;
+  if (IsMessageLoopBusy())
+    delay = TimeDelta::FromMilliseconds(kBusyExpirationStepDelayMs);
+
+  MessageLoop::current()->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&ExpireHistoryBackend::DoExpirationStep,
+                 weak_factory_.GetWeakPtr()),
+      delay);
+}
+
+void ExpireHistoryBackend::DoExpirationStep() {
+  DCHECK(!chunked_expirations_.empty()) << "no expiration to do a step of";
+  in_expiration_step_ = true;
+
+  ChunkedExpiration* expiration = chunked_expirations_.front();
+  TimeTicks deadline = TimeTicks::Now() + TimeDelta::FromMilliseconds(
+      IsMessageLoopBusy() ? kBusyExpirationStepMs : kIdleExpirationStepMs);
+  bool more_to_expire;
+  do {
+    // The databases may have been closed since the expiration was requested,
+    // in which case there is nothing more we can do.
+    more_to_expire = main_db_ && ExpireChunk(expiration);
+  } while (more_to_expire && TimeTicks::Now() < deadline);
+
+  expiration->progress.step_count++;
+  expiration->progress.complete = !more_to_expire;
+  ExpirationProgressCallback callback = expiration->callback;
+  ExpirationProgress progress = expiration->progress;
+
+  if (progress.complete) {
+    UMA_HISTOGRAM_LONG_TIMES("History.ChunkedExpirationTime",
+                             TimeTicks::Now() - expiration->start_time);
+    UMA_HISTOGRAM_COUNTS("History.ChunkedExpirationSteps",
+                         progress.step_count);
+    UMA_HISTOGRAM_COUNTS("History.ChunkedExpirationVisits",
+                         progress.visits_expired);
+    chunked_expirations_.pop_front();
+    delete expiration;
+  }
+  if (chunked_expirations_.empty()) {
+    // Nothing is watching for the end of this task any more.
+    MessageLoop::current()->RemoveTaskObserver(this);
+    in_expiration_step_ = false;
+  } else {
+    ScheduleExpirationStep();
+  }
+
+  callback.Run(progress);
+}
+
+bool ExpireHistoryBackend::ExpireChunk(ChunkedExpiration* expiration) {
+  VisitVector visits;
+  bool more_to_expire;
+  if (expiration->restricted) {
+    size_t end = std::min(expiration->visits.size(),
+                          expiration->next_visit + expiration_chunk_size_);
+    for (size_t i = expiration->next_visit; i < end; ++i) {
+      VisitRow visit;
+      if (main_db_->GetRowForVisit(expiration->visits[i].visit_id, &visit))
+        visits.push_back(visit);
+    }
+    expiration->next_visit = end;
+    more_to_expire = end < expiration->visits.size();
+  } else {
+    main_db_->GetAllVisitsInRange(expiration->begin_time,
+                                  expiration->end_time,
+                                  expiration_chunk_size_, &visits);
+    more_to_expire = static_cast<int>(visits.size()) == expiration_chunk_size_;
+    // The visits are in time order, and about to be deleted, so the next chunk
+    // can start from the time of the last of them.
+    if (!visits.empty())
+      expiration->begin_time = visits.back().visit_time;
+  }
+
+  ExpireVisits(visits);
+  expiration->progress.visits_expired += static_cast<int>(visits.size());
+  return more_to_expire;
+}
+
+bool ExpireHistoryBackend::IsMessageLoopBusy() const {
+  return !last_busy_time_.is_null() &&
+      TimeTicks::Now() - last_busy_time_ <
+          TimeDelta::FromMilliseconds(kExpirationBusyPeriodMs);
+}
+
+void ExpireHistoryBackend::WillProcessTask(TimeTicks time_posted) {
+}
+
+void ExpireHistoryBackend::DidProcessTask(TimeTicks time_posted) {
+  if (in_expiration_step_)
+    in_expiration_step_ = false;
+  else
+    last_busy_time_ = TimeTicks::Now();
+}
+
 bool ExpireHistoryBackend::ArchiveSomeOldHistory(
     base::Time end_time,
     const ExpiringVisitsReader* reader,
@@ -740,6 +932,16 @@ void ExpireHistoryBackend::DoExpireHistoryIndexFiles() {
     if (file_id < cutoff_id)
       file_util::Delete(file, false);
   }
+
+  // A single text index is expired from the start of the same month.
+  int cutoff_index_month = exploded.year * 12 + exploded.month - 1 -
+      kStoreHistoryIndexesForMonths;
+  Time::Exploded cutoff_exploded;
+  memset(&cutoff_exploded, 0, sizeof(cutoff_exploded));
+  cutoff_exploded.year = cutoff_index_month / 12;
+  cutoff_exploded.month = cutoff_index_month % 12 + 1;
+  cutoff_exploded.day_of_month = 1;
+  text_db_->DeleteIndexedDataBefore(Time::FromLocalExploded(cutoff_exploded));
 }
 
 BookmarkService* ExpireHistoryBackend::GetBookmarkService() {
@@ -5,14 +5,18 @@
 #ifndef CHROME_BROWSER_HISTORY_EXPIRE_HISTORY_BACKEND_H_
 #define CHROME_BROWSER_HISTORY_EXPIRE_HISTORY_BACKEND_H_
 
+#include <deque>
 #include <queue>
 #include <set>
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
+#include "base/message_loop.h"
 #include "base/time.h"
 #include "chrome/browser/history/history_types.h"
 
@@ -52,21 +56,45 @@ class ExpiringVisitsReader {
 
 typedef std::vector<const ExpiringVisitsReader*> ExpiringVisitsReaders;
 
+// The progress of an expiration done a chunk at a time, as reported after each
+// of its steps.
+struct ExpirationProgress {
+  ExpirationProgress();
+
+  // The number of visits expired so far.
+  int visits_expired;
+
+  // The number of steps run so far.
+  int step_count;
+
+  // True once every visit to expire is gone.
+  bool complete;
+};
+
 // Helper component to HistoryBackend that manages expiration and deleting of
 // history, as well as moving data from the main database to the archived
 // database as it gets old.
 //
 // It will automatically start periodically archiving old history once you call
 // StartArchivingOldStuff().
-class ExpireHistoryBackend {
+//
+// Large deletions may instead be done a chunk at a time with
+// ExpireHistoryBetweenInChunks(). Each step of those runs as its own task, so
+// that the requests made of the history thread in the meantime are not held up
+// behind the whole deletion. To tell how busy the thread is, this watches the
+// other tasks it runs while there are chunked expirations to do.
+class ExpireHistoryBackend : public MessageLoop::TaskObserver {
  public:
+  typedef base::Callback<void(const ExpirationProgress&)>
+      ExpirationProgressCallback;
+
   // The delegate pointer must be non-NULL. We will NOT take ownership of it.
   // BookmarkService may be NULL. The BookmarkService is used when expiring
   // URLs so that we don't remove any URLs or favicons that are bookmarked
   // (visits are removed though).
   ExpireHistoryBackend(BroadcastNotificationDelegate* delegate,
                        BookmarkService* bookmark_service);
-  ~ExpireHistoryBackend();
+  virtual ~ExpireHistoryBackend();
 
   // Completes initialization by setting the databases that this class will use.
   void SetDatabases(HistoryDatabase* main_db,
@@ -89,6 +117,19 @@ class ExpireHistoryBackend {
   void ExpireHistoryBetween(const std::set<GURL>& restrict_urls,
                             base::Time begin_time, base::Time end_time);
 
+  // As ExpireHistoryBetween(), but the visits are expired a chunk at a time, in
+  // steps posted to the current message loop. When other tasks have run on the
+  // loop recently, steps are kept short and spaced out; otherwise they run for
+  // longer and follow each other at once. |callback| is run after each step,
+  // which is when the caller should commit, and for the last time once
+  // complete. Visits added to the range before then may be expired as well.
+  //
+  // Expirations requested while others are in progress are done in turn.
+  void ExpireHistoryBetweenInChunks(const std::set<GURL>& restrict_urls,
+                                    base::Time begin_time,
+                                    base::Time end_time,
+                                    const ExpirationProgressCallback& callback);
+
   // Removes all visits to all URLs with the given times, updating the
   // URLs accordingly.  |times| must be in reverse chronological order
   // and not contain any duplicates.
@@ -111,13 +152,21 @@ class ExpireHistoryBackend {
     return base::Time::Now() - expiration_threshold_;
   }
 
+  // MessageLoop::TaskObserver implementation.
+  virtual void WillProcessTask(base::TimeTicks time_posted) OVERRIDE;
+  virtual void DidProcessTask(base::TimeTicks time_posted) OVERRIDE;
+
  private:
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, DeleteFaviconsIfPossible);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ArchiveSomeOldHistory);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ExpiringVisitsReader);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ArchiveSomeOldHistoryWithSource);
+  FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ExpireHistoryBetweenInChunks);
+  FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest,
+                           ExpireHistoryBetweenInChunksRestricted);
   friend class ::TestingProfile;
 
+  struct ChunkedExpiration;
   struct DeleteDependencies;
 
   // Deletes the visit-related stuff for all the visits in the given list, and
@@ -228,6 +277,21 @@ class ExpireHistoryBackend {
                              const ExpiringVisitsReader* reader,
                              int max_visits);
 
+  // Posts the next step of the chunked expirations, after a delay if the
+  // message loop is busy.
+  void ScheduleExpirationStep();
+
+  // Expires chunks of the first of the chunked expirations until the step's
+  // time is up or it is complete, then reports its progress.
+  void DoExpirationStep();
+
+  // Expires the next chunk of the visits of |expiration|. Returns false once
+  // there are no more.
+  bool ExpireChunk(ChunkedExpiration* expiration);
+
+  // Returns true if tasks other than the expiration steps have run recently.
+  bool IsMessageLoopBusy() const;
+
   // Tries to detect possible bad history or inconsistencies in the database
   // and deletes items. For example, URLs with no visits.
   void ParanoidExpireHistory();
@@ -292,6 +356,19 @@ class ExpireHistoryBackend {
   // loaded.
   BookmarkService* bookmark_service_;
 
+  // The chunked expirations still to do, in the order they were requested.
+  // These are owned by this object.
+  std::deque<ChunkedExpiration*> chunked_expirations_;
+
+  // The most visits expired in one chunk.
+  int expiration_chunk_size_;
+
+  // Set while an expiration step runs, so that it isn't counted as other work.
+  bool in_expiration_step_;
+
+  // When a task other than an expiration step last ran.
+  base::TimeTicks last_busy_time_;
+
   DISALLOW_COPY_AND_ASSIGN(ExpireHistoryBackend);
 };
 
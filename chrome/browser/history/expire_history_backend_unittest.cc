@@ -3,15 +3,20 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <map>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/basictypes.h"
+#include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
 #include "base/path_service.h"
 #include "base/stl_util.h"
 #include "base/string16.h"
@@ -50,6 +55,47 @@ static const FilePath::CharType kThumbnailFile[] =
 // to work. It also eliminates a bunch of ugly "history::".
 namespace history {
 
+// ExpirationRecorder ----------------------------------------------------------
+
+// Records the progress of chunked expirations, and quits the message loop once
+// the given number of them are complete.
+class ExpirationRecorder {
+ public:
+  explicit ExpirationRecorder(size_t expected_count)
+      : expected_count_(expected_count) {
+  }
+
+  // Returns the callback for the chunked expiration with the given ID.
+  ExpireHistoryBackend::ExpirationProgressCallback GetCallback(int id) {
+    return base::Bind(&ExpirationRecorder::OnProgress, base::Unretained(this),
+                      id);
+  }
+
+  // The IDs of the complete expirations, in the order they completed.
+  const std::vector<int>& completed() const { return completed_; }
+
+  // The last progress reported by the expiration with the given ID.
+  const ExpirationProgress& progress(int id) { return progress_[id]; }
+
+ private:
+  void OnProgress(int id, const ExpirationProgress& progress) {
+    EXPECT_FALSE(progress_[id].complete);
+    EXPECT_EQ(progress_[id].step_count + 1, progress.step_count);
+    progress_[id] = progress;
+    if (!progress.complete)
+      return;
+    completed_.push_back(id);
+    if (completed_.size() == expected_count_)
+      MessageLoop::current()->Quit();
+  }
+
+  size_t expected_count_;
+  std::vector<int> completed_;
+  std::map<int, ExpirationProgress> progress_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExpirationRecorder);
+};
+
 // ExpireHistoryTest -----------------------------------------------------------
 
 class ExpireHistoryTest : public testing::Test,
@@ -789,6 +835,82 @@ TEST_F(ExpireHistoryTest, FlushRecentURLsUnstarredRestricted) {
   // EXPECT_TRUE(HasThumbnail(url_row2.id()));
 }
 
+// Expires the same visits as FlushRecentURLsUnstarred, one visit per chunk.
+TEST_F(ExpireHistoryTest, ExpireHistoryBetweenInChunks) {
+  URLID url_ids[3];
+  Time visit_times[4];
+  AddExampleData(url_ids, visit_times);
+
+  URLRow url_row1, url_row2;
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[1], &url_row1));
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[2], &url_row2));
+
+  expirer_.expiration_chunk_size_ = 1;
+  ExpirationRecorder recorder(1);
+  expirer_.ExpireHistoryBetweenInChunks(std::set<GURL>(), visit_times[2],
+                                        Time(), recorder.GetCallback(0));
+
+  // Nothing is expired until the message loop runs the steps.
+  VisitVector visits;
+  main_db_->GetVisitsForURL(url_ids[1], &visits);
+  EXPECT_EQ(2U, visits.size());
+
+  MessageLoop::current()->Run();
+  EXPECT_EQ(2, recorder.progress(0).visits_expired);
+
+  // Verify that the middle URL had its last visit deleted only, and that its
+  // visit time and visit counts were updated.
+  visits.clear();
+  main_db_->GetVisitsForURL(url_ids[1], &visits);
+  EXPECT_EQ(1U, visits.size());
+  URLRow temp_row;
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[1], &temp_row));
+  EXPECT_TRUE(visit_times[1] == temp_row.last_visit());
+  EXPECT_EQ(1, temp_row.visit_count());
+  EXPECT_EQ(0, temp_row.typed_count());
+
+  // Verify that the last URL was deleted, and the first not touched.
+  EnsureURLInfoGone(url_row2);
+  EXPECT_TRUE(main_db_->GetURLRow(url_ids[0], &temp_row));
+}
+
+// Chunked expirations restricted to URLs are done in the order requested, and
+// only expire the visits to those URLs.
+TEST_F(ExpireHistoryTest, ExpireHistoryBetweenInChunksRestricted) {
+  URLID url_ids[3];
+  Time visit_times[4];
+  AddExampleData(url_ids, visit_times);
+
+  URLRow url_row0, url_row1;
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[0], &url_row0));
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[1], &url_row1));
+
+  expirer_.expiration_chunk_size_ = 1;
+  ExpirationRecorder recorder(2);
+  std::set<GURL> restrict_urls;
+  restrict_urls.insert(url_row1.url());
+  expirer_.ExpireHistoryBetweenInChunks(restrict_urls, Time(), Time(),
+                                        recorder.GetCallback(0));
+  restrict_urls.clear();
+  restrict_urls.insert(url_row0.url());
+  expirer_.ExpireHistoryBetweenInChunks(restrict_urls, visit_times[1], Time(),
+                                        recorder.GetCallback(1));
+  MessageLoop::current()->Run();
+
+  ASSERT_EQ(2U, recorder.completed().size());
+  EXPECT_EQ(0, recorder.completed()[0]);
+  EXPECT_EQ(1, recorder.completed()[1]);
+  EXPECT_EQ(2, recorder.progress(0).visits_expired);
+  EXPECT_EQ(0, recorder.progress(1).visits_expired);
+
+  // Both visits of the middle URL are gone, and so is the URL. The first URL
+  // was visited before the second expiration's range.
+  EnsureURLInfoGone(url_row1);
+  URLRow temp_row;
+  EXPECT_TRUE(main_db_->GetURLRow(url_ids[0], &temp_row));
+  EXPECT_TRUE(main_db_->GetURLRow(url_ids[2], &temp_row));
+}
+
 // Expire a starred URL, it shouldn't get deleted
 TEST_F(ExpireHistoryTest, FlushRecentURLsStarred) {
   URLID url_ids[3];
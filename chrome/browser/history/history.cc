@@ -32,6 +32,7 @@
 #include "base/location.h"
 #include "base/memory/ref_counted.h"
 #include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
 #include "base/path_service.h"
 #include "base/sequenced_task_runner.h"
 #include "base/string_util.h"
@@ -80,6 +81,11 @@ namespace {
 
 static const char* kHistoryThreadName = "Chrome_HistoryThread";
 
+// The longest an added page waits to be sent to the history thread with the
+// pages added after it, and the most pages sent at once.
+const int kAddPageBatchDelayMs = 100;
+const size_t kMaxAddPageBatchSize = 64;
+
 std::string DeleteDirectiveToString(
     const sync_pb::HistoryDeleteDirectiveSpecifics& delete_directive) {
   scoped_ptr<base::DictionaryValue> value(
@@ -101,6 +107,23 @@ void DerefDownloadId(
   callback.Run(*id);
 }
 
+// Runs |callback| unless it has been canceled.
+void RunIfNotCanceled(
+    const CancelableTaskTracker::IsCanceledCallback& is_canceled,
+    const base::Closure& callback) {
+  if (!is_canceled.Run())
+    callback.Run();
+}
+
+// Posts |callback| to |task_runner|, where it runs unless it has been canceled.
+void PostReplyIfNotCanceled(
+    const CancelableTaskTracker::IsCanceledCallback& is_canceled,
+    base::TaskRunner* task_runner,
+    const base::Closure& callback) {
+  task_runner->PostTask(FROM_HERE,
+                        base::Bind(&RunIfNotCanceled, is_canceled, callback));
+}
+
 void RunWithFaviconResults(
     const FaviconService::FaviconResultsCallback& callback,
     const HistoryBackend::FaviconResults* results) {
@@ -197,7 +220,8 @@ HistoryService::HistoryService()
       current_backend_id_(-1),
       bookmark_service_(NULL),
       no_db_(false),
-      needs_top_sites_migration_(false) {
+      needs_top_sites_migration_(false),
+      max_add_page_batch_size_(kMaxAddPageBatchSize) {
 }
 
 HistoryService::HistoryService(Profile* profile)
@@ -208,7 +232,8 @@ HistoryService::HistoryService(Profile* profile)
       current_backend_id_(-1),
       bookmark_service_(NULL),
       no_db_(false),
-      needs_top_sites_migration_(false) {
+      needs_top_sites_migration_(false),
+      max_add_page_batch_size_(kMaxAddPageBatchSize) {
   DCHECK(profile_);
   registrar_.Add(this, chrome::NOTIFICATION_HISTORY_URLS_DELETED,
                  content::Source<Profile>(profile_));
@@ -485,7 +510,15 @@ void HistoryService::AddPage(const history::HistoryAddPageArgs& add_page_args) {
     }
   }
 
-  ScheduleAndForget(PRIORITY_NORMAL, &HistoryBackend::AddPage, add_page_args);
+  LoadBackendIfNecessary();
+  pending_add_pages_.push_back(add_page_args);
+  if (pending_add_pages_.size() >= max_add_page_batch_size_) {
+    SendPendingAddPages();
+  } else if (!add_page_batch_timer_.IsRunning()) {
+    add_page_batch_timer_.Start(
+        FROM_HERE, base::TimeDelta::FromMilliseconds(kAddPageBatchDelayMs),
+        this, &HistoryService::SendPendingAddPages);
+  }
 }
 
 void HistoryService::AddPageNoVisitForBookmark(const GURL& url,
@@ -598,7 +631,7 @@ CancelableTaskTracker::TaskId HistoryService::GetFavicons(
   HistoryBackend::FaviconResults* results =
       new HistoryBackend::FaviconResults();
   return tracker->PostTaskAndReply(
-      thread_->message_loop_proxy(),
+      GetBackendLoop(),
       FROM_HERE,
       base::Bind(&HistoryBackend::GetFavicons,
                  history_backend_.get(), icon_urls, icon_types,
@@ -619,7 +652,7 @@ CancelableTaskTracker::TaskId HistoryService::GetFaviconsForURL(
   HistoryBackend::FaviconResults* results =
       new HistoryBackend::FaviconResults();
   return tracker->PostTaskAndReply(
-      thread_->message_loop_proxy(),
+      GetBackendLoop(),
       FROM_HERE,
       base::Bind(&HistoryBackend::GetFaviconsForURL,
                  history_backend_.get(), page_url, icon_types,
@@ -639,7 +672,7 @@ CancelableTaskTracker::TaskId HistoryService::GetFaviconForID(
   HistoryBackend::FaviconResults* results =
       new HistoryBackend::FaviconResults();
   return tracker->PostTaskAndReply(
-      thread_->message_loop_proxy(),
+      GetBackendLoop(),
       FROM_HERE,
       base::Bind(&HistoryBackend::GetFaviconForID,
                  history_backend_.get(), favicon_id,
@@ -661,7 +694,7 @@ CancelableTaskTracker::TaskId HistoryService::UpdateFaviconMappingsAndFetch(
   HistoryBackend::FaviconResults* results =
       new HistoryBackend::FaviconResults();
   return tracker->PostTaskAndReply(
-      thread_->message_loop_proxy(),
+      GetBackendLoop(),
       FROM_HERE,
       base::Bind(&HistoryBackend::UpdateFaviconMappingsAndFetch,
                  history_backend_.get(), page_url, icon_urls, icon_types,
@@ -743,7 +776,7 @@ void HistoryService::CreateDownload(
   LoadBackendIfNecessary();
   int64* db_handle = new int64(
       history::DownloadDatabase::kUninitializedHandle);
-  thread_->message_loop_proxy()->PostTaskAndReply(
+  GetBackendLoop()->PostTaskAndReply(
       FROM_HERE,
       base::Bind(&HistoryBackend::CreateDownload,
                  history_backend_.get(),
@@ -757,7 +790,7 @@ void HistoryService::GetNextDownloadId(const DownloadNextIdCallback& callback) {
   DCHECK(thread_checker_.CalledOnValidThread());
   LoadBackendIfNecessary();
   int* id = new int(history::DownloadDatabase::kUninitializedHandle);
-  thread_->message_loop_proxy()->PostTaskAndReply(
+  GetBackendLoop()->PostTaskAndReply(
       FROM_HERE,
       base::Bind(&HistoryBackend::GetNextDownloadId,
                  history_backend_.get(),
@@ -779,7 +812,7 @@ void HistoryService::QueryDownloads(
   // base::Passed(&scoped_rows) nullifies |scoped_rows|, and compilers do not
   // guarantee that the first Bind's arguments are evaluated before the second
   // Bind's arguments.
-  thread_->message_loop_proxy()->PostTaskAndReply(
+  GetBackendLoop()->PostTaskAndReply(
       FROM_HERE,
       base::Bind(&HistoryBackend::QueryDownloads, history_backend_.get(), rows),
       base::Bind(callback, base::Passed(&scoped_rows)));
@@ -961,7 +994,27 @@ void HistoryService::ScheduleTask(SchedulePriority priority,
   CHECK(thread_);
   CHECK(thread_->message_loop());
   // TODO(brettw): Do prioritization.
-  thread_->message_loop()->PostTask(FROM_HERE, task);
+  GetBackendLoop()->PostTask(FROM_HERE, task);
+}
+
+void HistoryService::SendPendingAddPages() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  add_page_batch_timer_.Stop();
+  if (pending_add_pages_.empty() || !thread_)
+    return;
+  LoadBackendIfNecessary();
+  std::vector<history::HistoryAddPageArgs> add_pages;
+  add_pages.swap(pending_add_pages_);
+  thread_->message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&HistoryBackend::AddPages, history_backend_.get(),
+                 add_pages));
+}
+
+scoped_refptr<base::MessageLoopProxy> HistoryService::GetBackendLoop() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  SendPendingAddPages();
+  return thread_->message_loop_proxy();
 }
 
 // static
@@ -1098,12 +1151,15 @@ void HistoryService::ExpireHistoryBetween(
   DCHECK(thread_);
   DCHECK(thread_checker_.CalledOnValidThread());
   DCHECK(history_backend_.get());
-  tracker->PostTaskAndReply(
-      thread_->message_loop_proxy(),
-      FROM_HERE,
-      base::Bind(&HistoryBackend::ExpireHistoryBetween,
-                 history_backend_, restrict_urls, begin_time, end_time),
-      callback);
+  // The history is expired in steps on the history thread, so the backend
+  // sends the reply once the last is done.
+  CancelableTaskTracker::IsCanceledCallback is_canceled;
+  tracker->NewTrackedTaskId(&is_canceled);
+  ScheduleAndForget(PRIORITY_UI,
+                    &HistoryBackend::ExpireHistoryBetweenInChunks,
+                    restrict_urls, begin_time, end_time,
+                    base::Bind(&PostReplyIfNotCanceled, is_canceled,
+                               base::MessageLoopProxy::current(), callback));
 }
 
 void HistoryService::BroadcastNotificationsHelper(
@@ -1292,7 +1348,7 @@ void HistoryService::ProcessDeleteDirective(
   if (!backend_task.is_null()) {
     LoadBackendIfNecessary();
     DCHECK(thread_);
-    if (thread_->message_loop_proxy()->PostTaskAndReply(
+    if (GetBackendLoop()->PostTaskAndReply(
             FROM_HERE,
             backend_task,
             done_callback)) {
@@ -20,6 +20,7 @@
 #include "base/string16.h"
 #include "base/time.h"
 #include "base/threading/thread_checker.h"
+#include "base/timer.h"
 #include "chrome/browser/common/cancelable_request.h"
 #include "chrome/browser/favicon/favicon_service.h"
 #include "chrome/browser/history/history_types.h"
@@ -48,6 +49,7 @@ class Profile;
 struct HistoryURLProviderParams;
 
 namespace base {
+class MessageLoopProxy;
 class Thread;
 }
 
@@ -227,7 +229,9 @@ class HistoryService : public CancelableRequestProvider,
                base::Time time,
                history::VisitSource visit_source);
 
-  // All AddPage variants end up here.
+  // All AddPage variants end up here. Pages added in quick succession, such as
+  // by a redirect chain or a session restore, are sent to the history thread
+  // together, at most a fraction of a second later.
   void AddPage(const history::HistoryAddPageArgs& add_page_args);
 
   // Adds an entry for the specified url without creating a visit. This should
@@ -443,9 +447,10 @@ class HistoryService : public CancelableRequestProvider,
   // Removes all visits in the selected time range (including the start time),
   // updating the URLs accordingly. This deletes the associated data, including
   // the full text index. This function also deletes the associated favicons,
-  // if they are no longer referenced. |callback| runs when the expiration is
-  // complete. You may use null Time values to do an unbounded delete in
-  // either direction.
+  // if they are no longer referenced. The history thread does this a chunk at
+  // a time, so that other requests aren't held up behind a large deletion.
+  // |callback| runs when the expiration is complete. You may use null Time
+  // values to do an unbounded delete in either direction.
   // If |restrict_urls| is not empty, only visits to the URLs in this set are
   // removed.
   void ExpireHistoryBetween(const std::set<GURL>& restrict_urls,
@@ -627,6 +632,12 @@ class HistoryService : public CancelableRequestProvider,
   void ProcessDeleteDirectiveForTest(
       const sync_pb::HistoryDeleteDirectiveSpecifics& delete_directive);
 
+  // Sets the most pages AddPage() sends to the backend at once. 1 sends each
+  // page as it is added.
+  void set_max_add_page_batch_size_for_testing(size_t max_batch_size) {
+    max_add_page_batch_size_ = max_batch_size;
+  }
+
   // syncer::SyncableService implementation.
   virtual syncer::SyncMergeResult MergeDataAndStartSyncing(
       syncer::ModelType type,
@@ -860,6 +871,16 @@ class HistoryService : public CancelableRequestProvider,
   // specified priority. The task will have ownership taken.
   void ScheduleTask(SchedulePriority priority, const base::Closure& task);
 
+  // Sends the pages added since the last batch to the backend. Called before
+  // anything else is sent, so that the backend sees requests in the order
+  // they were made.
+  void SendPendingAddPages();
+
+  // Sends the pending pages, then returns the history thread's loop. Every
+  // task for the backend is posted through this, so none overtakes a page
+  // added before it.
+  scoped_refptr<base::MessageLoopProxy> GetBackendLoop();
+
   // Delete local history according to the given directive (from
   // sync).
   void ProcessDeleteDirective(
@@ -1117,6 +1138,12 @@ class HistoryService : public CancelableRequestProvider,
 
   ObserverList<history::VisitDatabaseObserver> visit_database_observers_;
 
+  // The pages added but not yet sent to the backend, and the timer which
+  // sends them once the oldest has waited long enough. See AddPage().
+  std::vector<history::HistoryAddPageArgs> pending_add_pages_;
+  base::OneShotTimer<HistoryService> add_page_batch_timer_;
+  size_t max_add_page_batch_size_;
+
   DISALLOW_COPY_AND_ASSIGN(HistoryService);
 };
 
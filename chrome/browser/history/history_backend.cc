@@ -13,6 +13,7 @@
 
 #include "base/basictypes.h"
 #include "base/bind.h"
+#include "base/command_line.h"
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
 #include "base/memory/scoped_ptr.h"
@@ -34,6 +35,7 @@
 #include "chrome/browser/history/visit_filter.h"
 #include "chrome/common/chrome_constants.h"
 #include "chrome/common/chrome_notification_types.h"
+#include "chrome/common/chrome_switches.h"
 #include "chrome/common/url_constants.h"
 #include "googleurl/src/gurl.h"
 #include "grit/chromium_strings.h"
@@ -640,6 +642,12 @@ void HistoryBackend::AddPage(const HistoryAddPageArgs& request) {
   ScheduleCommit();
 }
 
+void HistoryBackend::AddPages(const std::vector<HistoryAddPageArgs>& requests) {
+  for (std::vector<HistoryAddPageArgs>::const_iterator i = requests.begin();
+       i != requests.end(); ++i)
+    AddPage(*i);
+}
+
 void HistoryBackend::InitImpl(const std::string& languages) {
   DCHECK(!db_.get()) << "Initializing HistoryBackend twice";
   // In the rare case where the db fails to initialize a dialog may get shown
@@ -707,6 +715,9 @@ void HistoryBackend::InitImpl(const std::string& languages) {
   // HistoryDatabase for migration.
   text_database_.reset(new TextDatabaseManager(history_dir_,
                                                db_.get(), db_.get()));
+  text_database_->set_use_text_index(
+      CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableHistoryTextIndex));
   if (!text_database_->Init(history_publisher_.get())) {
     LOG(WARNING) << "Text database initialization failed, running without it.";
     text_database_.reset();
@@ -2717,6 +2728,38 @@ void HistoryBackend::ExpireHistoryBetween(
     db_->GetStartDate(&first_recorded_time_);
 }
 
+void HistoryBackend::ExpireHistoryBetweenInChunks(
+    const std::set<GURL>& restrict_urls,
+    Time begin_time,
+    Time end_time,
+    const base::Closure& callback) {
+  if (!db_.get() ||
+      (begin_time.is_null() && end_time.is_null() && restrict_urls.empty())) {
+    ExpireHistoryBetween(restrict_urls, begin_time, end_time);
+    callback.Run();
+    return;
+  }
+
+  // The expirer belongs to us, so won't run the callback once we're gone.
+  expirer_.ExpireHistoryBetweenInChunks(
+      restrict_urls, begin_time, end_time,
+      base::Bind(&HistoryBackend::OnExpirationProgress, base::Unretained(this),
+                 callback));
+}
+
+void HistoryBackend::OnExpirationProgress(const base::Closure& callback,
+                                          const ExpirationProgress& progress) {
+  // Commit after each step. This keeps the transactions small, and if the user
+  // is deleting something for privacy reasons, we want to get it on disk ASAP.
+  Commit();
+
+  if (!progress.complete)
+    return;
+  if (db_.get())
+    db_->GetStartDate(&first_recorded_time_);
+  callback.Run();
+}
+
 void HistoryBackend::ExpireHistoryForTimes(
     const std::vector<base::Time>& times) {
   // Put the times in reverse chronological order and remove
@@ -146,6 +146,11 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
 
   // |request.time| must be unique with high probability.
   void AddPage(const HistoryAddPageArgs& request);
+
+  // Adds each of |requests| in order, as AddPage() does. HistoryService sends
+  // the pages added in quick succession together this way; like everything
+  // else, they are written in the long-running transaction.
+  void AddPages(const std::vector<HistoryAddPageArgs>& requests);
   virtual void SetPageTitle(const GURL& url, const string16& title);
   void AddPageNoVisitForBookmark(const GURL& url, const string16& title);
 
@@ -443,6 +448,15 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
       base::Time begin_time,
       base::Time end_time);
 
+  // Calls ExpireHistoryBackend::ExpireHistoryBetweenInChunks, committing after
+  // each step, and runs |callback| once the history is all gone. Deleting all
+  // history is done at once, as in ExpireHistoryBetween.
+  void ExpireHistoryBetweenInChunks(
+      const std::set<GURL>& restrict_urls,
+      base::Time begin_time,
+      base::Time end_time,
+      const base::Closure& callback);
+
   // Calls ExpireHistoryBackend::ExpireHistoryForTimes and commits the change.
   void ExpireHistoryForTimes(const std::vector<base::Time>& times);
 
@@ -631,6 +645,11 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   // to write something to disk.
   void Commit();
 
+  // Commits a step of a chunked expiration of history, and runs |callback|
+  // after the last.
+  void OnExpirationProgress(const base::Closure& callback,
+                            const ExpirationProgress& progress);
+
   // Schedules a commit to happen in the future. We do this so that many
   // operations over a period of time will be batched together. If there is
   // already a commit scheduled for the future, this will do nothing.
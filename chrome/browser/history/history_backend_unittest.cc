@@ -1036,6 +1036,51 @@ TEST_F(HistoryBackendTest, AddPageArgsSource) {
   EXPECT_EQ(history::SOURCE_SYNCED, visit_sources.begin()->second);
 }
 
+// Tests that a batch of pages is added in order, as if each page had been
+// added on its own.
+TEST_F(HistoryBackendTest, AddPages) {
+  ASSERT_TRUE(backend_.get());
+
+  GURL url_a("http://www.google.com/a");
+  GURL url_b("http://www.google.com/b");
+  base::Time now = base::Time::Now();
+  std::vector<HistoryAddPageArgs> requests;
+  requests.push_back(HistoryAddPageArgs(
+      url_a, now, reinterpret_cast<void*>(1), 1, GURL(),
+      history::RedirectList(), content::PAGE_TRANSITION_TYPED,
+      history::SOURCE_BROWSED, false));
+  requests.push_back(HistoryAddPageArgs(
+      url_b, now + base::TimeDelta::FromSeconds(1),
+      reinterpret_cast<void*>(1), 2, url_a,
+      history::RedirectList(), content::PAGE_TRANSITION_LINK,
+      history::SOURCE_BROWSED, false));
+  requests.push_back(HistoryAddPageArgs(
+      url_a, now + base::TimeDelta::FromSeconds(2),
+      reinterpret_cast<void*>(1), 3, url_b,
+      history::RedirectList(), content::PAGE_TRANSITION_LINK,
+      history::SOURCE_BROWSED, false));
+  backend_->AddPages(requests);
+
+  URLRow row_a;
+  URLID id_a = backend_->db()->GetRowForURL(url_a, &row_a);
+  ASSERT_TRUE(id_a);
+  EXPECT_EQ(2, row_a.visit_count());
+  EXPECT_EQ(1, row_a.typed_count());
+  VisitVector visits_a;
+  ASSERT_TRUE(backend_->db()->GetVisitsForURL(id_a, &visits_a));
+  ASSERT_EQ(2U, visits_a.size());
+
+  // Each page refers to the visit of the page before it.
+  URLRow row_b;
+  URLID id_b = backend_->db()->GetRowForURL(url_b, &row_b);
+  ASSERT_TRUE(id_b);
+  VisitVector visits_b;
+  ASSERT_TRUE(backend_->db()->GetVisitsForURL(id_b, &visits_b));
+  ASSERT_EQ(1U, visits_b.size());
+  EXPECT_EQ(visits_a[0].visit_id, visits_b[0].referring_visit);
+  EXPECT_EQ(visits_b[0].visit_id, visits_a[1].referring_visit);
+}
+
 TEST_F(HistoryBackendTest, AddVisitsSource) {
   ASSERT_TRUE(backend_.get());
 
@@ -0,0 +1,489 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/timer.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/common/cancelable_request.h"
+#include "chrome/browser/history/history.h"
+#include "chrome/browser/history/history_backend.h"
+#include "chrome/browser/history/history_database.h"
+#include "chrome/browser/history/history_types.h"
+#include "chrome/common/cancelable_task_tracker.h"
+#include "content/public/common/page_transition_types.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+// The shape of the navigation trace: a session restore, then browsing.
+const int kRestoredTabCount = 100;
+const int kBrowsingStepCount = 2000;
+const int kHostCount = 300;
+
+// The shape of the history deleted by the expiration test: a million visits
+// spread over three months, and a visit in the last hour to some of the URLs
+// which is kept.
+const int kExpiredURLCount = 10000;
+const int kExpiredVisitsPerURL = 100;
+const int kExpiredDays = 90;
+const int kKeptURLCount = 1000;
+
+// How often a query is sent while history is being expired, if the last one
+// has been answered.
+const int kQueryIntervalMs = 20;
+
+// One step of the trace: the pages added in a burst, such as by restoring a
+// session or by a page with frames, after which their titles are set as they
+// finish loading.
+struct TraceStep {
+  std::vector<HistoryAddPageArgs> pages;
+};
+
+// Returns the |index|th page of the |host|th site.
+GURL TraceURL(int host, int index) {
+  return GURL(base::StringPrintf("http://www.site%d.com/page/%d.html", host,
+                                 index));
+}
+
+HistoryAddPageArgs TracePage(const GURL& url,
+                             base::Time time,
+                             int page_id,
+                             const GURL& referrer,
+                             const RedirectList& redirects,
+                             content::PageTransition transition) {
+  return HistoryAddPageArgs(url, time, reinterpret_cast<void*>(1), page_id,
+                            referrer, redirects, transition, SOURCE_BROWSED,
+                            false);
+}
+
+// Builds a trace shaped like a real one: a burst of restored tabs, then
+// mostly link clicks within a site, with some typed navigations, server
+// redirect chains and pages with frames. It is the same on every run.
+void BuildTrace(std::vector<TraceStep>* trace) {
+  base::Time time = base::Time::Now() - base::TimeDelta::FromDays(1);
+  int page_id = 0;
+  uint32 seed = 1;
+
+  TraceStep restore;
+  for (int i = 0; i < kRestoredTabCount; ++i) {
+    time += base::TimeDelta::FromMilliseconds(1);
+    restore.pages.push_back(TracePage(TraceURL(i % kHostCount, i), time,
+                                      ++page_id, GURL(), RedirectList(),
+                                      content::PAGE_TRANSITION_RELOAD));
+  }
+  trace->push_back(restore);
+
+  GURL referrer;
+  for (int i = 0; i < kBrowsingStepCount; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int kind = (seed >> 16) % 20;
+    int host = (seed >> 8) % kHostCount;
+    time += base::TimeDelta::FromSeconds(5);
+
+    TraceStep step;
+    GURL url(TraceURL(host, i));
+    if (kind < 2) {
+      // Typed into the omnibox.
+      step.pages.push_back(TracePage(url, time, ++page_id, GURL(),
+                                     RedirectList(),
+                                     content::PAGE_TRANSITION_TYPED));
+    } else if (kind < 5) {
+      // A link through a chain of server redirects.
+      RedirectList redirects;
+      for (int j = 0; j < 2 + kind % 3; ++j)
+        redirects.push_back(TraceURL(host, i * 10 + j));
+      redirects.push_back(url);
+      step.pages.push_back(TracePage(url, time, ++page_id, referrer,
+                                     redirects,
+                                     content::PAGE_TRANSITION_LINK));
+    } else if (kind < 7) {
+      // A page with a few frames the user clicked in.
+      step.pages.push_back(TracePage(url, time, ++page_id, referrer,
+                                     RedirectList(),
+                                     content::PAGE_TRANSITION_LINK));
+      for (int j = 0; j < 4; ++j) {
+        step.pages.push_back(TracePage(
+            TraceURL(host, i * 10 + j), time + base::TimeDelta::FromSeconds(1),
+            ++page_id, url, RedirectList(),
+            content::PAGE_TRANSITION_MANUAL_SUBFRAME));
+      }
+    } else {
+      step.pages.push_back(TracePage(url, time, ++page_id, referrer,
+                                     RedirectList(),
+                                     content::PAGE_TRANSITION_LINK));
+    }
+    referrer = url;
+    trace->push_back(step);
+  }
+}
+
+// Quits the main message loop once the tasks sent to the history thread
+// before it have run.
+class QuittingHistoryDBTask : public HistoryDBTask {
+ public:
+  QuittingHistoryDBTask() {}
+
+  virtual bool RunOnDBThread(HistoryBackend* backend,
+                             HistoryDatabase* db) OVERRIDE {
+    return true;
+  }
+
+  virtual void DoneRunOnMainThread() OVERRIDE {
+    MessageLoop::current()->Quit();
+  }
+
+ private:
+  virtual ~QuittingHistoryDBTask() {}
+
+  DISALLOW_COPY_AND_ASSIGN(QuittingHistoryDBTask);
+};
+
+// Times the tasks run by the history thread, which it is installed on by
+// running on it.
+class HistoryThreadTimer : public HistoryDBTask,
+                           public MessageLoop::TaskObserver {
+ public:
+  HistoryThreadTimer() : observing_(false), task_count_(0) {}
+
+  // Starts timing the tasks run after this one when it is first run, and
+  // stops when it is run again.
+  virtual bool RunOnDBThread(HistoryBackend* backend,
+                             HistoryDatabase* db) OVERRIDE {
+    observing_ = !observing_;
+    if (observing_) {
+      MessageLoop::current()->AddTaskObserver(this);
+    } else {
+      MessageLoop::current()->RemoveTaskObserver(this);
+    }
+    task_start_ = base::TimeTicks();
+    return true;
+  }
+
+  virtual void DoneRunOnMainThread() OVERRIDE {
+    MessageLoop::current()->Quit();
+  }
+
+  virtual void WillProcessTask(base::TimeTicks time_posted) OVERRIDE {
+    task_start_ = base::TimeTicks::HighResNow();
+  }
+
+  virtual void DidProcessTask(base::TimeTicks time_posted) OVERRIDE {
+    if (task_start_.is_null())
+      return;  // The task which started the timing.
+    busy_time_ += base::TimeTicks::HighResNow() - task_start_;
+    ++task_count_;
+  }
+
+  base::TimeDelta busy_time() const { return busy_time_; }
+  int task_count() const { return task_count_; }
+
+ private:
+  virtual ~HistoryThreadTimer() {}
+
+  bool observing_;
+  base::TimeTicks task_start_;
+  base::TimeDelta busy_time_;
+  int task_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistoryThreadTimer);
+};
+
+// Fills the history database with the visits for the expiration test.
+class PopulateHistoryTask : public HistoryDBTask {
+ public:
+  explicit PopulateHistoryTask(base::Time now) : now_(now) {}
+
+  virtual bool RunOnDBThread(HistoryBackend* backend,
+                             HistoryDatabase* db) OVERRIDE {
+    base::Time start = now_ - base::TimeDelta::FromDays(kExpiredDays + 1);
+    base::TimeDelta spacing = base::TimeDelta::FromDays(kExpiredDays) /
+        (kExpiredURLCount * kExpiredVisitsPerURL);
+    for (int i = 0; i < kExpiredURLCount; ++i) {
+      // The visits to the URLs are interleaved, so that every chunk of the
+      // expiration is of visits to many URLs.
+      bool kept = i < kKeptURLCount;
+      base::Time recent_time = now_ - base::TimeDelta::FromSeconds(i + 1);
+      base::Time last_expired_time = start +
+          spacing * ((kExpiredVisitsPerURL - 1) * kExpiredURLCount + i);
+      URLRow row(TraceURL(i % kHostCount, i));
+      row.set_visit_count(kExpiredVisitsPerURL + (kept ? 1 : 0));
+      row.set_last_visit(kept ? recent_time : last_expired_time);
+      row.set_title(ASCIIToUTF16(row.url().host()));
+      URLID url_id = db->AddURL(row);
+
+      for (int j = 0; j <= kExpiredVisitsPerURL; ++j) {
+        VisitRow visit;
+        visit.url_id = url_id;
+        visit.transition = content::PAGE_TRANSITION_LINK;
+        if (j < kExpiredVisitsPerURL)
+          visit.visit_time = start + spacing * (j * kExpiredURLCount + i);
+        else if (kept)
+          visit.visit_time = recent_time;
+        else
+          break;
+        db->AddVisit(&visit, SOURCE_BROWSED);
+      }
+    }
+
+    // Commit the visits now, rather than as part of the first change made by
+    // the test.
+    db->CommitTransaction();
+    db->BeginTransaction();
+    return true;
+  }
+
+  virtual void DoneRunOnMainThread() OVERRIDE {
+    MessageLoop::current()->Quit();
+  }
+
+ private:
+  virtual ~PopulateHistoryTask() {}
+
+  base::Time now_;
+
+  DISALLOW_COPY_AND_ASSIGN(PopulateHistoryTask);
+};
+
+// Expires the history before a time in a single call on the history thread,
+// as HistoryService::ExpireHistoryBetween() used to, and runs |callback| once
+// done.
+class BlockingExpireTask : public HistoryDBTask {
+ public:
+  BlockingExpireTask(base::Time end_time, const base::Closure& callback)
+      : end_time_(end_time),
+        callback_(callback) {
+  }
+
+  virtual bool RunOnDBThread(HistoryBackend* backend,
+                             HistoryDatabase* db) OVERRIDE {
+    backend->ExpireHistoryBetween(std::set<GURL>(), base::Time(), end_time_);
+    return true;
+  }
+
+  virtual void DoneRunOnMainThread() OVERRIDE {
+    callback_.Run();
+  }
+
+ private:
+  virtual ~BlockingExpireTask() {}
+
+  base::Time end_time_;
+  base::Closure callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockingExpireTask);
+};
+
+class HistoryPerfTest : public testing::Test {
+ protected:
+  HistoryPerfTest()
+      : querying_service_(NULL),
+        query_pending_(false),
+        expiring_(false) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    BuildTrace(&trace_);
+  }
+
+  // Replays the trace into a new history, sending at most |max_batch_size|
+  // added pages to the history thread at once, and logs how busy the history
+  // thread was kept under |name|.
+  void Replay(const std::string& name, size_t max_batch_size) {
+    FilePath history_dir(temp_dir_.path().AppendASCII(name));
+    ASSERT_TRUE(file_util::CreateDirectory(history_dir));
+    scoped_ptr<HistoryService> history_service(new HistoryService);
+    ASSERT_TRUE(history_service->Init(history_dir, NULL));
+    history_service->set_max_add_page_batch_size_for_testing(max_batch_size);
+    BlockUntilHistoryRuns(history_service.get(), new QuittingHistoryDBTask);
+
+    scoped_refptr<HistoryThreadTimer> timer(new HistoryThreadTimer);
+    BlockUntilHistoryRuns(history_service.get(), timer);
+
+    PerfTimer replay_timer;
+    size_t page_count = 0;
+    for (size_t i = 0; i < trace_.size(); ++i) {
+      const std::vector<HistoryAddPageArgs>& pages = trace_[i].pages;
+      for (size_t j = 0; j < pages.size(); ++j)
+        history_service->AddPage(pages[j]);
+      for (size_t j = 0; j < pages.size(); ++j) {
+        history_service->SetPageTitle(pages[j].url,
+                                      ASCIIToUTF16(pages[j].url.host()));
+      }
+      page_count += pages.size();
+    }
+    BlockUntilHistoryRuns(history_service.get(), timer);
+    base::TimeDelta replay_time = replay_timer.Elapsed();
+
+    LogPerfResult(base::StringPrintf("History_replay_%s_time", name.c_str())
+                      .c_str(),
+                  replay_time.InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("History_replay_%s_thread_busy_time",
+                                     name.c_str()).c_str(),
+                  timer->busy_time().InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("History_replay_%s_thread_tasks",
+                                     name.c_str()).c_str(),
+                  timer->task_count(), "tasks");
+    LogPerfResult(base::StringPrintf("History_replay_%s_pages_per_second",
+                                     name.c_str()).c_str(),
+                  page_count / timer->busy_time().InSecondsF(), "pages/s");
+
+    history_service->SetOnBackendDestroyTask(MessageLoop::QuitClosure());
+    history_service->Cleanup();
+    history_service.reset();
+    MessageLoop::current()->Run();
+  }
+
+  // Deletes a million visits from a new history, a chunk at a time if
+  // |chunked| or else in one go, while sending the queries the history page
+  // would, and logs the time taken by the queries under |name|.
+  void ExpireWhileQuerying(const std::string& name, bool chunked) {
+    FilePath history_dir(temp_dir_.path().AppendASCII(name));
+    ASSERT_TRUE(file_util::CreateDirectory(history_dir));
+    scoped_ptr<HistoryService> history_service(new HistoryService);
+    ASSERT_TRUE(history_service->Init(history_dir, NULL));
+    base::Time now = base::Time::Now();
+    BlockUntilHistoryRuns(history_service.get(),
+                          new PopulateHistoryTask(now));
+
+    querying_service_ = history_service.get();
+    query_pending_ = false;
+    query_times_.clear();
+    expiring_ = true;
+    base::RepeatingTimer<HistoryPerfTest> query_timer;
+    query_timer.Start(FROM_HERE,
+                      base::TimeDelta::FromMilliseconds(kQueryIntervalMs),
+                      this, &HistoryPerfTest::SendQuery);
+
+    expire_start_ = base::TimeTicks::HighResNow();
+    base::Time end_time = now - base::TimeDelta::FromHours(1);
+    base::Closure done = base::Bind(&HistoryPerfTest::OnExpired,
+                                    base::Unretained(this));
+    if (chunked) {
+      history_service->ExpireHistoryBetween(std::set<GURL>(), base::Time(),
+                                            end_time, done, &tracker_);
+    } else {
+      history_service->ScheduleDBTask(new BlockingExpireTask(end_time, done),
+                                      &consumer_);
+    }
+    MessageLoop::current()->Run();
+    query_timer.Stop();
+    querying_service_ = NULL;
+
+    ASSERT_FALSE(query_times_.empty());
+    std::sort(query_times_.begin(), query_times_.end());
+    double total = 0;
+    for (size_t i = 0; i < query_times_.size(); ++i)
+      total += query_times_[i];
+    LogPerfResult(base::StringPrintf("History_expire_%s_time", name.c_str())
+                      .c_str(),
+                  expire_time_.InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("History_expire_%s_queries",
+                                     name.c_str()).c_str(),
+                  query_times_.size(), "queries");
+    LogPerfResult(base::StringPrintf("History_expire_%s_query_mean_time",
+                                     name.c_str()).c_str(),
+                  total / query_times_.size(), "ms");
+    LogPerfResult(base::StringPrintf("History_expire_%s_query_95th_time",
+                                     name.c_str()).c_str(),
+                  query_times_[query_times_.size() * 95 / 100], "ms");
+    LogPerfResult(base::StringPrintf("History_expire_%s_query_max_time",
+                                     name.c_str()).c_str(),
+                  query_times_.back(), "ms");
+
+    history_service->SetOnBackendDestroyTask(MessageLoop::QuitClosure());
+    history_service->Cleanup();
+    history_service.reset();
+    MessageLoop::current()->Run();
+  }
+
+  // Sends the query for the first page of the history page, unless the last
+  // is still waiting for an answer.
+  void SendQuery() {
+    if (query_pending_ || !expiring_)
+      return;
+    query_pending_ = true;
+    query_start_ = base::TimeTicks::HighResNow();
+    QueryOptions options;
+    options.max_count = 100;
+    querying_service_->QueryHistory(
+        string16(), options, &consumer_,
+        base::Bind(&HistoryPerfTest::OnQueryDone, base::Unretained(this)));
+  }
+
+  void OnQueryDone(HistoryService::Handle handle, QueryResults* results) {
+    query_times_.push_back(
+        (base::TimeTicks::HighResNow() - query_start_).InMillisecondsF());
+    query_pending_ = false;
+    if (!expiring_)
+      MessageLoop::current()->Quit();
+  }
+
+  void OnExpired() {
+    expire_time_ = base::TimeTicks::HighResNow() - expire_start_;
+    expiring_ = false;
+    if (!query_pending_)
+      MessageLoop::current()->Quit();
+  }
+
+  // Runs |task| on the history thread after everything sent to it so far,
+  // and waits for it. |task| must quit the message loop when it is done.
+  void BlockUntilHistoryRuns(HistoryService* history_service,
+                             HistoryDBTask* task) {
+    history_service->ScheduleDBTask(task, &consumer_);
+    MessageLoop::current()->Run();
+  }
+
+  base::ScopedTempDir temp_dir_;
+  MessageLoopForUI message_loop_;
+  CancelableRequestConsumer consumer_;
+  CancelableTaskTracker tracker_;
+  std::vector<TraceStep> trace_;
+
+  // The state of ExpireWhileQuerying().
+  HistoryService* querying_service_;
+  bool query_pending_;
+  base::TimeTicks query_start_;
+  std::vector<double> query_times_;
+  bool expiring_;
+  base::TimeTicks expire_start_;
+  base::TimeDelta expire_time_;
+};
+
+}  // namespace
+
+// Replays a session restore and a couple of thousand navigations, first with
+// each added page sent to the history thread on its own, then with the pages
+// added together sent together. Every page is followed by setting its title,
+// which sends the pending pages, so only bursts of pages are batched.
+TEST_F(HistoryPerfTest, ReplayNavigationTrace) {
+  Replay("unbatched", 1);
+  Replay("batched", 64);
+}
+
+// Deletes a million visits, three months of heavy browsing, while querying the
+// history every few milliseconds, first in one go, then a chunk at a time. The
+// time taken by the queries is the delay the user sees on the history page, or
+// in anything else waiting on the history thread.
+TEST_F(HistoryPerfTest, ExpireWhileQuerying) {
+  ExpireWhileQuerying("blocking", false);
+  ExpireWhileQuerying("chunked", true);
+}
+
+}  // namespace history
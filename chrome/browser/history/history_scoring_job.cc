@@ -0,0 +1,164 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/history_scoring_job.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/message_loop_proxy.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "chrome/browser/history/url_index_private_data.h"
+
+namespace history {
+
+HistoryScoringJob::Candidate::Candidate(const URLRow* row,
+                                        const RowWordStarts* word_starts)
+    : row(row),
+      word_starts(word_starts) {
+}
+
+HistoryScoringJob::HistoryScoringJob(const string16& lower_string,
+                                     const String16Vector& lower_terms,
+                                     base::Time now,
+                                     BookmarkService* bookmark_service,
+                                     size_t max_matches,
+                                     const URLIndexPrivateData* index_data)
+    : lower_string_(lower_string),
+      lower_terms_(lower_terms),
+      now_(now),
+      bookmark_service_(bookmark_service),
+      max_matches_(max_matches),
+      index_data_(index_data),
+      pending_pieces_(0) {
+}
+
+HistoryScoringJob::~HistoryScoringJob() {}
+
+void HistoryScoringJob::AddCandidate(const URLRow* row,
+                                     const RowWordStarts* word_starts) {
+  DCHECK(!origin_loop_);
+  candidates_.push_back(Candidate(row, word_starts));
+}
+
+void HistoryScoringJob::AddCandidateCopy(const URLRow& row,
+                                         const RowWordStarts& word_starts) {
+  copied_rows_.push_back(row);
+  copied_word_starts_.push_back(word_starts);
+  AddCandidate(&copied_rows_.back(), &copied_word_starts_.back());
+}
+
+ScoredHistoryMatches HistoryScoringJob::Score() {
+  ScoredHistoryMatches matches;
+  ScoreCandidates(0, candidates_.size(), &matches);
+  return matches;
+}
+
+void HistoryScoringJob::Start(base::SequencedWorkerPool* pool,
+                              size_t task_count,
+                              const ScoringCallback& callback) {
+  DCHECK(!origin_loop_);
+  DCHECK_GT(task_count, 0U);
+  origin_loop_ = base::MessageLoopProxy::current();
+  callback_ = callback;
+
+  // The field trials must be read here rather than on the pool.
+  ScoredHistoryMatch::Init();
+
+  size_t piece_count =
+      std::max<size_t>(1, std::min(task_count, candidates_.size()));
+  piece_matches_.resize(piece_count);
+  pending_pieces_ = piece_count;
+  for (size_t piece = 0; piece < piece_count; ++piece) {
+    size_t begin = candidates_.size() * piece / piece_count;
+    size_t end = candidates_.size() * (piece + 1) / piece_count;
+    // The results are of no use after shutdown has started, so there is no
+    // need to block it.
+    if (!pool->PostWorkerTaskWithShutdownBehavior(
+            FROM_HERE,
+            base::Bind(&HistoryScoringJob::ScorePiece, this, piece, begin,
+                       end),
+            base::SequencedWorkerPool::SKIP_ON_SHUTDOWN)) {
+      ScoreCandidates(begin, end, &piece_matches_[piece]);
+      --pending_pieces_;
+    }
+  }
+  if (!pending_pieces_) {
+    ++pending_pieces_;
+    OnPieceScored();
+  }
+}
+
+void HistoryScoringJob::Cancel() {
+  DCHECK(!origin_loop_ || origin_loop_->BelongsToCurrentThread());
+  canceled_.Set();
+  callback_.Reset();
+}
+
+// static
+bool HistoryScoringJob::MatchGreater(const ScoredHistoryMatch& m1,
+                                     const ScoredHistoryMatch& m2) {
+  if (ScoredHistoryMatch::MatchScoreGreater(m1, m2))
+    return true;
+  if (ScoredHistoryMatch::MatchScoreGreater(m2, m1))
+    return false;
+  return m1.url_info.id() < m2.url_info.id();
+}
+
+bool HistoryScoringJob::ScoreCandidates(size_t begin,
+                                        size_t end,
+                                        ScoredHistoryMatches* matches) const {
+  for (size_t i = begin; i < end; ++i) {
+    if (canceled_.IsSet())
+      return false;
+    const Candidate& candidate = candidates_[i];
+    ScoredHistoryMatch match(*candidate.row, lower_string_, lower_terms_,
+                             *candidate.word_starts, now_, bookmark_service_);
+    if (match.raw_score > 0)
+      matches->push_back(match);
+  }
+  TrimMatches(matches);
+  return true;
+}
+
+void HistoryScoringJob::ScorePiece(size_t piece, size_t begin, size_t end) {
+  if (!ScoreCandidates(begin, end, &piece_matches_[piece]))
+    return;  // Nobody is waiting for the results any more.
+  origin_loop_->PostTask(FROM_HERE,
+                         base::Bind(&HistoryScoringJob::OnPieceScored, this));
+}
+
+void HistoryScoringJob::OnPieceScored() {
+  DCHECK(origin_loop_->BelongsToCurrentThread());
+  DCHECK_GT(pending_pieces_, 0U);
+  if (--pending_pieces_ || canceled_.IsSet())
+    return;
+
+  ScoredHistoryMatches matches;
+  for (size_t i = 0; i < piece_matches_.size(); ++i) {
+    matches.insert(matches.end(), piece_matches_[i].begin(),
+                   piece_matches_[i].end());
+  }
+  piece_matches_.clear();
+  TrimMatches(&matches);
+
+  ScoringCallback callback(callback_);
+  callback_.Reset();
+  callback.Run(matches);
+}
+
+void HistoryScoringJob::TrimMatches(ScoredHistoryMatches* matches) const {
+  if (matches->size() > max_matches_) {
+    std::partial_sort(matches->begin(), matches->begin() + max_matches_,
+                      matches->end(), &HistoryScoringJob::MatchGreater);
+    matches->resize(max_matches_);
+  } else {
+    std::sort(matches->begin(), matches->end(),
+              &HistoryScoringJob::MatchGreater);
+  }
+}
+
+}  // namespace history
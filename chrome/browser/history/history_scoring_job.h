@@ -0,0 +1,155 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_HISTORY_SCORING_JOB_H_
+#define CHROME_BROWSER_HISTORY_HISTORY_SCORING_JOB_H_
+
+#include <deque>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/string16.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/time.h"
+#include "chrome/browser/history/history_types.h"
+#include "chrome/browser/history/in_memory_url_index_types.h"
+#include "chrome/browser/history/scored_history_match.h"
+
+class BookmarkService;
+
+namespace base {
+class MessageLoopProxy;
+class SequencedWorkerPool;
+}
+
+namespace history {
+
+class URLIndexPrivateData;
+
+// Scores the candidates of one HistoryQuickProvider search, either on the
+// calling thread or split across the threads of a SequencedWorkerPool.
+//
+// The candidates are mostly rows of the index, which the job points to rather
+// than copies. The job holds a reference to the index data, and
+// InMemoryURLIndex copies that data before updating it while a job holds it,
+// so the rows don't change while they are scored. Each piece of the candidates
+// keeps its best matches, which are then merged. Matches are
+// ranked by ScoredHistoryMatch::MatchScoreGreater(), with ties broken by
+// HistoryID, so the result is the same however the candidates are split, and
+// the same as that of Score().
+//
+// A job started on a pool may be cancelled, such as when the user types the
+// next character; pieces not yet scored are then skipped, and the callback is
+// not run.
+class HistoryScoringJob : public base::RefCountedThreadSafe<HistoryScoringJob> {
+ public:
+  typedef base::Callback<void(const ScoredHistoryMatches&)> ScoringCallback;
+
+  // |lower_string| and |lower_terms| are the search string and its terms, as
+  // passed to ScoredHistoryMatch. At most |max_matches| are returned.
+  // |bookmark_service|, which may be NULL, is used to boost the score of
+  // bookmarked items. Its IsBookmarked() takes a lock, so it may be called on
+  // any thread; as on the main thread, it doesn't wait for bookmarks to load.
+  // |index_data|, which may be NULL, holds the rows passed to AddCandidate(),
+  // and is kept alive until the job is destroyed.
+  HistoryScoringJob(const string16& lower_string,
+                    const String16Vector& lower_terms,
+                    base::Time now,
+                    BookmarkService* bookmark_service,
+                    size_t max_matches,
+                    const URLIndexPrivateData* index_data);
+
+  // Adds a candidate held by |index_data|, which must not change it until the
+  // job is destroyed. Must be called before the candidates are scored.
+  void AddCandidate(const URLRow* row, const RowWordStarts* word_starts);
+
+  // Adds a copy of a candidate which isn't held by |index_data|, such as one
+  // read from a compact index. Must be called before the candidates are
+  // scored.
+  void AddCandidateCopy(const URLRow& row, const RowWordStarts& word_starts);
+
+  size_t candidate_count() const { return candidates_.size(); }
+
+  // Scores every candidate on the calling thread, and returns those which
+  // match, best first.
+  ScoredHistoryMatches Score();
+
+  // Scores the candidates on |pool|, in |task_count| pieces, then runs
+  // |callback| on the calling thread with what Score() would have returned,
+  // unless the job is cancelled first. May only be called once.
+  void Start(base::SequencedWorkerPool* pool,
+             size_t task_count,
+             const ScoringCallback& callback);
+
+  // Stops a started job. Pieces being scored stop at their next candidate.
+  // Must be called on the thread which called Start().
+  void Cancel();
+
+  // Returns true if |m1| ranks before |m2| in the results.
+  static bool MatchGreater(const ScoredHistoryMatch& m1,
+                           const ScoredHistoryMatch& m2);
+
+ private:
+  friend class base::RefCountedThreadSafe<HistoryScoringJob>;
+
+  struct Candidate {
+    Candidate(const URLRow* row, const RowWordStarts* word_starts);
+
+    const URLRow* row;
+    const RowWordStarts* word_starts;
+  };
+
+  ~HistoryScoringJob();
+
+  // Scores the candidates from |begin| up to |end|, keeping the best
+  // |max_matches_| in |matches|, best first. Returns false if the job was
+  // cancelled meanwhile.
+  bool ScoreCandidates(size_t begin,
+                       size_t end,
+                       ScoredHistoryMatches* matches) const;
+
+  // Runs on the pool. Scores the |piece|th piece of the candidates, then lets
+  // the starting thread know.
+  void ScorePiece(size_t piece, size_t begin, size_t end);
+
+  // Runs on the starting thread as each piece is scored, and runs the
+  // callback with the merged matches once they all are.
+  void OnPieceScored();
+
+  // Keeps the best |max_matches_| of |matches|, and sorts them.
+  void TrimMatches(ScoredHistoryMatches* matches) const;
+
+  const string16 lower_string_;
+  const String16Vector lower_terms_;
+  const base::Time now_;
+  BookmarkService* bookmark_service_;
+  const size_t max_matches_;
+  scoped_refptr<const URLIndexPrivateData> index_data_;
+
+  std::vector<Candidate> candidates_;
+
+  // The candidates added by AddCandidateCopy(). A deque, so that adding one
+  // doesn't move the others.
+  std::deque<URLRow> copied_rows_;
+  std::deque<RowWordStarts> copied_word_starts_;
+
+  // The matches of each piece. Each is only written by the task scoring its
+  // piece, and only read once every piece has been scored.
+  std::vector<ScoredHistoryMatches> piece_matches_;
+
+  // The pieces not yet scored. Only used on the starting thread.
+  size_t pending_pieces_;
+
+  scoped_refptr<base::MessageLoopProxy> origin_loop_;
+  ScoringCallback callback_;
+  base::CancellationFlag canceled_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistoryScoringJob);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_HISTORY_SCORING_JOB_H_
@@ -0,0 +1,136 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/bind.h"
+#include "base/message_loop.h"
+#include "base/stringprintf.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/history_scoring_job.h"
+#include "content/public/test/test_browser_thread.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+const size_t kMaxMatches = 10;
+
+void SaveMatches(ScoredHistoryMatches* saved_matches,
+                 bool* called,
+                 const ScoredHistoryMatches& matches) {
+  *saved_matches = matches;
+  *called = true;
+  MessageLoop::current()->Quit();
+}
+
+}  // namespace
+
+class HistoryScoringJobTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    pool_ = new base::SequencedWorkerPool(4, "HistoryScoringJobTest");
+  }
+
+  virtual void TearDown() OVERRIDE {
+    pool_->Shutdown();
+  }
+
+  // Makes a job searching for "foo" in |count| items, many of which tie.
+  scoped_refptr<HistoryScoringJob> MakeJob(size_t count) {
+    string16 lower_string(ASCIIToUTF16("foo"));
+    String16Vector lower_terms(1, lower_string);
+    base::Time now = base::Time::Now();
+    scoped_refptr<HistoryScoringJob> job(new HistoryScoringJob(
+        lower_string, lower_terms, now, NULL, kMaxMatches, NULL));
+    for (size_t i = 0; i < count; ++i) {
+      std::string url = i % 4 ? base::StringPrintf("http://foo%d.com/", i % 9) :
+                                "http://bar.com/";
+      URLRow row(GURL(url), i + 1);
+      row.set_title(ASCIIToUTF16(i % 2 ? "Foo" : "Bar"));
+      row.set_visit_count(1 + i % 5);
+      row.set_typed_count(i % 3 ? 0 : 1);
+      row.set_last_visit(now - base::TimeDelta::FromDays(i % 7));
+      RowWordStarts word_starts;
+      String16SetFromString16(ASCIIToUTF16(url),
+                              &word_starts.url_word_starts_);
+      String16SetFromString16(row.title(), &word_starts.title_word_starts_);
+      job->AddCandidateCopy(row, word_starts);
+    }
+    return job;
+  }
+
+  MessageLoop message_loop_;
+  scoped_refptr<base::SequencedWorkerPool> pool_;
+};
+
+TEST_F(HistoryScoringJobTest, Score) {
+  ScoredHistoryMatches matches = MakeJob(300)->Score();
+  ASSERT_EQ(kMaxMatches, matches.size());
+  for (size_t i = 1; i < matches.size(); ++i) {
+    EXPECT_TRUE(HistoryScoringJob::MatchGreater(matches[i - 1], matches[i]));
+    EXPECT_GE(matches[i - 1].raw_score, matches[i].raw_score);
+  }
+  EXPECT_TRUE(MakeJob(0)->Score().empty());
+}
+
+TEST_F(HistoryScoringJobTest, ParallelScoreMatchesSerialScore) {
+  ScoredHistoryMatches expected_matches = MakeJob(300)->Score();
+  const size_t kTaskCounts[] = { 1, 2, 3, 7, 500 };
+  for (size_t i = 0; i < arraysize(kTaskCounts); ++i) {
+    ScoredHistoryMatches matches;
+    bool called = false;
+    scoped_refptr<HistoryScoringJob> job(MakeJob(300));
+    job->Start(pool_, kTaskCounts[i],
+               base::Bind(&SaveMatches, &matches, &called));
+    MessageLoop::current()->Run();
+    ASSERT_TRUE(called);
+    ASSERT_EQ(expected_matches.size(), matches.size()) << kTaskCounts[i];
+    for (size_t j = 0; j < matches.size(); ++j) {
+      EXPECT_EQ(expected_matches[j].url_info.id(), matches[j].url_info.id());
+      EXPECT_EQ(expected_matches[j].raw_score, matches[j].raw_score);
+    }
+  }
+}
+
+// In the browser the UI thread is registered, and the pool's workers must be
+// able to score without being on it.
+TEST_F(HistoryScoringJobTest, ScoreWithUIThread) {
+  content::TestBrowserThread ui_thread(content::BrowserThread::UI,
+                                       &message_loop_);
+  ScoredHistoryMatches expected_matches = MakeJob(300)->Score();
+  ScoredHistoryMatches matches;
+  bool called = false;
+  MakeJob(300)->Start(pool_, 4, base::Bind(&SaveMatches, &matches, &called));
+  MessageLoop::current()->Run();
+  ASSERT_TRUE(called);
+  ASSERT_EQ(expected_matches.size(), matches.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    EXPECT_EQ(expected_matches[i].url_info.id(), matches[i].url_info.id());
+    EXPECT_EQ(expected_matches[i].raw_score, matches[i].raw_score);
+  }
+}
+
+TEST_F(HistoryScoringJobTest, NoCandidates) {
+  ScoredHistoryMatches matches(1);
+  bool called = false;
+  MakeJob(0)->Start(pool_, 4, base::Bind(&SaveMatches, &matches, &called));
+  MessageLoop::current()->Run();
+  EXPECT_TRUE(called);
+  EXPECT_TRUE(matches.empty());
+}
+
+TEST_F(HistoryScoringJobTest, Cancel) {
+  ScoredHistoryMatches matches;
+  bool called = false;
+  scoped_refptr<HistoryScoringJob> job(MakeJob(300));
+  job->Start(pool_, 4, base::Bind(&SaveMatches, &matches, &called));
+  job->Cancel();
+  pool_->FlushForTesting();
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_FALSE(called);
+}
+
+}  // namespace history
@@ -354,6 +354,7 @@ class QueryCursor {
   friend class HistoryBackend;
   friend struct QueryOptions;
   friend class TextDatabase;
+  friend class TextIndex;
   friend class VisitDatabase;
 
   int64 rowid_;
@@ -30,6 +30,7 @@
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_vector.h"
 #include "base/message_loop.h"
 #include "base/path_service.h"
@@ -378,6 +379,14 @@ class HistoryTest : public testing::Test {
     MessageLoop::current()->Quit();
   }
 
+  // Callback for HistoryService favicon requests.
+  void SaveFaviconResultsAndQuit(
+      const std::vector<history::FaviconBitmapResult>& results,
+      const history::IconURLSizesMap& icon_url_sizes) {
+    favicon_results_ = results;
+    MessageLoop::current()->Quit();
+  }
+
   // Fills in saved_redirects_ with the redirect information for the given URL,
   // returning true on success. False means the URL was not found.
   bool QueryRedirectsFrom(HistoryService* history, const GURL& url) {
@@ -429,6 +438,9 @@ class HistoryTest : public testing::Test {
   history::RedirectList saved_redirects_;
   bool redirect_query_success_;
 
+  // Set by the favicon callback.
+  std::vector<history::FaviconBitmapResult> favicon_results_;
+
   // For history requests.
   CancelableRequestConsumer consumer_;
 
@@ -535,6 +547,53 @@ TEST_F(HistoryTest, AddRedirect) {
   EXPECT_EQ(second_visit, query_url_visits_[0].referring_visit);
 }
 
+// Favicon requests must not overtake the pages added before them, which are
+// sent to the backend in batches: UpdateFaviconMappingsAndFetch() maps the
+// favicon to every page of the redirect chain the backend last saw.
+TEST_F(HistoryTest, FaviconMappingsFollowPendingRedirects) {
+  ASSERT_TRUE(history_service_.get());
+  // Keep the added page pending until something else is sent.
+  history_service_->set_max_add_page_batch_size_for_testing(100);
+
+  const GURL icon_url("http://icon.page.com/favicon.ico");
+  std::vector<unsigned char> data(1, 'a');
+  history_service_->MergeFavicon(GURL("http://icon.page.com/"), icon_url,
+                                 history::FAVICON,
+                                 new base::RefCountedBytes(data),
+                                 gfx::Size(16, 16));
+
+  history::RedirectList redirects;
+  redirects.push_back(GURL("http://first.page.com/"));
+  redirects.push_back(GURL("http://second.page.com/"));
+  history_service_->AddPage(
+      redirects.back(), base::Time::Now(), MakeFakeHost(1),
+      0, GURL(), redirects, content::PAGE_TRANSITION_LINK,
+      history::SOURCE_BROWSED, true);
+
+  CancelableTaskTracker tracker;
+  const std::vector<ui::ScaleFactor> scale_factors(1, ui::SCALE_FACTOR_100P);
+  history_service_->UpdateFaviconMappingsAndFetch(
+      redirects.back(), std::vector<GURL>(1, icon_url), history::FAVICON, 16,
+      scale_factors,
+      base::Bind(&HistoryTest::SaveFaviconResultsAndQuit,
+                 base::Unretained(this)),
+      &tracker);
+  MessageLoop::current()->Run();
+  ASSERT_EQ(1U, favicon_results_.size());
+  EXPECT_EQ(icon_url, favicon_results_[0].icon_url);
+
+  // The start of the redirect chain was mapped to the favicon too.
+  favicon_results_.clear();
+  history_service_->GetFaviconsForURL(
+      redirects.front(), history::FAVICON, 16, scale_factors,
+      base::Bind(&HistoryTest::SaveFaviconResultsAndQuit,
+                 base::Unretained(this)),
+      &tracker);
+  MessageLoop::current()->Run();
+  ASSERT_EQ(1U, favicon_results_.size());
+  EXPECT_EQ(icon_url, favicon_results_[0].icon_url);
+}
+
 TEST_F(HistoryTest, MakeIntranetURLsTyped) {
   ASSERT_TRUE(history_service_.get());
 
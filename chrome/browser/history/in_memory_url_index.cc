@@ -25,11 +25,13 @@ using in_memory_url_index::InMemoryURLIndexCacheItem;
 
 namespace history {
 
-// Called by DoSaveToCacheFile to delete any old cache file at |path| when
-// there is no private data to save. Runs on the FILE thread.
+// Called by DoSaveToCacheFile to delete any old cache file at |path|, and the
+// one it was last restored from, when there is no private data to save. Runs
+// on the FILE thread.
 void DeleteCacheFile(const FilePath& path) {
   DCHECK(!content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
   file_util::Delete(path, false);
+  file_util::Delete(URLIndexPrivateData::GetRestoredCacheFilePath(path), false);
 }
 
 // Initializes a whitelist of URL schemes.
@@ -144,7 +146,12 @@ void InMemoryURLIndex::ShutDown() {
 }
 
 void InMemoryURLIndex::ClearPrivateData() {
-  private_data_->Clear();
+  CancelRecompaction();
+  // A scoring job may still be reading the old data.
+  if (private_data_->HasOneRef())
+    private_data_->Clear();
+  else
+    private_data_ = new URLIndexPrivateData;
 }
 
 bool InMemoryURLIndex::GetCacheFilePath(FilePath* file_path) {
@@ -162,10 +169,20 @@ ScoredHistoryMatches InMemoryURLIndex::HistoryItemsForTerms(
     term_string, BookmarkModelFactory::GetForProfile(profile_));
 }
 
+scoped_refptr<HistoryScoringJob> InMemoryURLIndex::ScoringJobForTerms(
+    const string16& term_string) {
+  return private_data_->ScoringJobForTerms(
+      term_string, BookmarkModelFactory::GetForProfile(profile_));
+}
+
+void InMemoryURLIndex::RecordScoredItemCount(size_t count) {
+  private_data_->RecordScoredItemCount(count);
+}
+
 // Updating --------------------------------------------------------------------
 
 void InMemoryURLIndex::DeleteURL(const GURL& url) {
-  private_data_->DeleteURL(url);
+  DeleteURLFromPrivateData(url);
 }
 
 void InMemoryURLIndex::Observe(int notification_type,
@@ -196,15 +213,15 @@ void InMemoryURLIndex::Observe(int notification_type,
 }
 
 void InMemoryURLIndex::OnURLVisited(const URLVisitedDetails* details) {
-  needs_to_be_cached_ |=
-      private_data_->UpdateURL(details->row, languages_, scheme_whitelist_);
+  needs_to_be_cached_ |= UpdateURLInPrivateData(details->row);
+  MaybeScheduleRecompaction();
 }
 
 void InMemoryURLIndex::OnURLsModified(const URLsModifiedDetails* details) {
   for (URLRows::const_iterator row = details->changed_urls.begin();
        row != details->changed_urls.end(); ++row)
-    needs_to_be_cached_ |=
-        private_data_->UpdateURL(*row, languages_, scheme_whitelist_);
+    needs_to_be_cached_ |= UpdateURLInPrivateData(*row);
+  MaybeScheduleRecompaction();
 }
 
 void InMemoryURLIndex::OnURLsDeleted(const URLsDeletedDetails* details) {
@@ -214,10 +231,36 @@ void InMemoryURLIndex::OnURLsDeleted(const URLsDeletedDetails* details) {
   } else {
     for (URLRows::const_iterator row = details->rows.begin();
          row != details->rows.end(); ++row)
-      needs_to_be_cached_ |= private_data_->DeleteURL(row->url());
+      needs_to_be_cached_ |= DeleteURLFromPrivateData(row->url());
+    MaybeScheduleRecompaction();
   }
 }
 
+void InMemoryURLIndex::UnsharePrivateData() {
+  if (!private_data_->HasOneRef())
+    private_data_ = private_data_->Duplicate();
+}
+
+bool InMemoryURLIndex::UpdateURLInPrivateData(const URLRow& row) {
+  UnsharePrivateData();
+  if (!private_data_->UpdateURL(row, languages_, scheme_whitelist_))
+    return false;
+  if (recompacting_data_.get())
+    updates_since_recompaction_.push_back(IndexUpdate(row, false));
+  return true;
+}
+
+bool InMemoryURLIndex::DeleteURLFromPrivateData(const GURL& url) {
+  UnsharePrivateData();
+  if (!private_data_->DeleteURL(url))
+    return false;
+  if (recompacting_data_.get()) {
+    URLRow row(url);
+    updates_since_recompaction_.push_back(IndexUpdate(row, true));
+  }
+  return true;
+}
+
 // Restoring from Cache --------------------------------------------------------
 
 void InMemoryURLIndex::PostRestoreFromCacheFileTask() {
@@ -231,19 +274,17 @@ void InMemoryURLIndex::PostRestoreFromCacheFileTask() {
     return;
   }
 
-  scoped_refptr<URLIndexPrivateData> restored_private_data =
-      new URLIndexPrivateData;
-  content::BrowserThread::PostTaskAndReply(
+  content::BrowserThread::PostTaskAndReplyWithResult<
+      scoped_refptr<URLIndexPrivateData> >(
       content::BrowserThread::FILE, FROM_HERE,
-      base::Bind(&URLIndexPrivateData::RestoreFromFileTask, path,
-          restored_private_data, languages_),
-      base::Bind(&InMemoryURLIndex::OnCacheLoadDone, AsWeakPtr(),
-          restored_private_data));
+      base::Bind(&URLIndexPrivateData::RestoreFromFile, path, languages_),
+      base::Bind(&InMemoryURLIndex::OnCacheLoadDone, AsWeakPtr()));
 }
 
 void InMemoryURLIndex::OnCacheLoadDone(
     scoped_refptr<URLIndexPrivateData> private_data) {
   if (private_data.get() && !private_data->Empty()) {
+    CancelRecompaction();
     private_data_ = private_data;
     restored_ = true;
     if (restore_cache_observer_)
@@ -285,10 +326,11 @@ void InMemoryURLIndex::DoneRebuidingPrivateDataFromHistoryDB(
     scoped_refptr<URLIndexPrivateData> private_data) {
   DCHECK(content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
   if (succeeded) {
+    CancelRecompaction();
     private_data_ = private_data;
     PostSaveToCacheFileTask();  // Cache the newly rebuilt index.
   } else {
-    private_data_->Clear();  // Dump the old private data.
+    ClearPrivateData();  // Dump the old private data.
     // There is no need to do anything with the cache file as it was deleted
     // when the rebuild from the history operation was kicked off.
   }
@@ -298,6 +340,7 @@ void InMemoryURLIndex::DoneRebuidingPrivateDataFromHistoryDB(
 }
 
 void InMemoryURLIndex::RebuildFromHistory(HistoryDatabase* history_db) {
+  CancelRecompaction();
   private_data_ = URLIndexPrivateData::RebuildFromHistory(history_db,
                                                           languages_,
                                                           scheme_whitelist_);
@@ -316,11 +359,19 @@ void InMemoryURLIndex::PostSaveToCacheFileTask() {
     // completion closure below.
     scoped_refptr<URLIndexPrivateData> private_data_copy =
         private_data_->Duplicate();
+    // Saving a compact index compacts the copy first. If the index is due to
+    // be compacted again, the saved copy replaces it, so that this thread
+    // never runs Compact() itself.
+    if (private_data_->NeedsRecompaction()) {
+      CancelRecompaction();
+      recompacting_data_ = private_data_copy;
+    }
     content::BrowserThread::PostTaskAndReplyWithResult<bool>(
         content::BrowserThread::FILE, FROM_HERE,
         base::Bind(&URLIndexPrivateData::WritePrivateDataToCacheFileTask,
                    private_data_copy, path),
-        base::Bind(&InMemoryURLIndex::OnCacheSaveDone, AsWeakPtr()));
+        base::Bind(&InMemoryURLIndex::OnCacheSaveDone, AsWeakPtr(),
+                   private_data_copy));
   } else {
     // If there is no data in our index then delete any existing cache file.
     content::BrowserThread::PostBlockingPoolTask(
@@ -329,9 +380,35 @@ void InMemoryURLIndex::PostSaveToCacheFileTask() {
   }
 }
 
-void InMemoryURLIndex::OnCacheSaveDone(bool succeeded) {
+void InMemoryURLIndex::OnCacheSaveDone(
+    scoped_refptr<URLIndexPrivateData> saved_data,
+    bool succeeded) {
+  // The copy was compacted whether or not it could be written.
+  if (recompacting_data_.get() &&
+      saved_data.get() == recompacting_data_.get()) {
+    for (std::vector<IndexUpdate>::const_iterator it =
+             updates_since_recompaction_.begin();
+         it != updates_since_recompaction_.end(); ++it) {
+      if (it->second)
+        saved_data->DeleteURL(it->first.url());
+      else
+        saved_data->UpdateURL(it->first, languages_, scheme_whitelist_);
+    }
+    CancelRecompaction();
+    private_data_ = saved_data;
+  }
   if (save_cache_observer_)
     save_cache_observer_->OnCacheSaveFinished(succeeded);
 }
 
+void InMemoryURLIndex::MaybeScheduleRecompaction() {
+  if (!recompacting_data_.get() && private_data_->NeedsRecompaction())
+    PostSaveToCacheFileTask();
+}
+
+void InMemoryURLIndex::CancelRecompaction() {
+  recompacting_data_ = NULL;
+  updates_since_recompaction_.clear();
+}
+
 }  // namespace history
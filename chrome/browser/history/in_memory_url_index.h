@@ -21,6 +21,7 @@
 #include "chrome/browser/autocomplete/history_provider_util.h"
 #include "chrome/browser/common/cancelable_request.h"
 #include "chrome/browser/history/history.h"
+#include "chrome/browser/history/history_scoring_job.h"
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/history/in_memory_url_index_types.h"
 #include "chrome/browser/history/scored_history_match.h"
@@ -120,6 +121,15 @@ class InMemoryURLIndex : public content::NotificationObserver,
   // refer to that class.
   ScoredHistoryMatches HistoryItemsForTerms(const string16& term_string);
 
+  // Finds the history items matching |term_string|, and returns a job which
+  // scores them, on this thread or on a worker pool, or NULL if there is
+  // nothing to search. See URLIndexPrivateData::ScoringJobForTerms.
+  scoped_refptr<HistoryScoringJob> ScoringJobForTerms(
+      const string16& term_string);
+
+  // Records how many matches a job from ScoringJobForTerms() returned.
+  void RecordScoredItemCount(size_t count);
+
   // Deletes the index entry, if any, for the given |url|.
   void DeleteURL(const GURL& url);
 
@@ -224,8 +234,29 @@ class InMemoryURLIndex : public content::NotificationObserver,
   void DoSaveToCacheFile(const FilePath& path);
 
   // Notifies the observer, if any, of the success of the private data caching.
-  // |succeeded| is true on a successful save.
-  void OnCacheSaveDone(bool succeeded);
+  // |succeeded| is true on a successful save. |saved_data| is the copy of the
+  // private data that was saved, which replaces |private_data_| if it was
+  // saved to recompact it.
+  void OnCacheSaveDone(scoped_refptr<URLIndexPrivateData> saved_data,
+                       bool succeeded);
+
+  // Saves the cache, which compacts a copy of the private data away from this
+  // thread, if enough of the compact index has been updated since it was
+  // compacted.
+  void MaybeScheduleRecompaction();
+
+  // Forgets any copy of the private data being recompacted, for when
+  // |private_data_| is replaced.
+  void CancelRecompaction();
+
+  // Copies |private_data_| if anything else, such as a scoring job, holds it,
+  // so that it may be changed.
+  void UnsharePrivateData();
+
+  // Update |private_data_|, remembering each update to make it again to a
+  // copy being recompacted. Both return true if the index was updated.
+  bool UpdateURLInPrivateData(const URLRow& row);
+  bool DeleteURLFromPrivateData(const GURL& url);
 
   // Handles notifications of history changes.
   virtual void Observe(int notification_type,
@@ -264,6 +295,13 @@ class InMemoryURLIndex : public content::NotificationObserver,
   // The index's durable private data.
   scoped_refptr<URLIndexPrivateData> private_data_;
 
+  // A copy of |private_data_| being saved and recompacted on the file thread,
+  // and the updates made to |private_data_| since it was copied: the row, and
+  // whether its URL was deleted.
+  typedef std::pair<URLRow, bool> IndexUpdate;
+  scoped_refptr<URLIndexPrivateData> recompacting_data_;
+  std::vector<IndexUpdate> updates_since_recompaction_;
+
   // Observers to notify upon restoral or save of the private data cache.
   RestoreCacheObserver* restore_cache_observer_;
   SaveCacheObserver* save_cache_observer_;
@@ -117,6 +117,7 @@ typedef std::map<string16, WordID> WordMap;
 
 // A map from character to the word_ids of words containing that character.
 typedef std::set<WordID> WordIDSet;  // An index into the WordList.
+typedef std::vector<WordID> WordIDVector;
 typedef std::map<char16, WordIDSet> CharWordIDMap;
 
 // A map from word (by word_id) to history items containing that word.
@@ -12,6 +12,7 @@
 #include "base/path_service.h"
 #include "base/string16.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autocomplete/autocomplete_provider.h"
 #include "chrome/browser/history/history.h"
@@ -906,6 +907,147 @@ TEST_F(InMemoryURLIndexTest, CacheSaveRestore) {
   ExpectPrivateDataEqual(*old_data, new_data);
 }
 
+TEST_F(InMemoryURLIndexTest, CompactIndex) {
+  const char* kTerms[] = {
+    "b", "drudge", "DrudgeReport", "view.atdmt", "www.cnn.com", "ABRA",
+    "MORTGAGE RATE DROPS", "z y x",
+  };
+  std::vector<ScoredHistoryMatches> expected_matches;
+  for (size_t i = 0; i < arraysize(kTerms); ++i) {
+    expected_matches.push_back(
+        url_index_->HistoryItemsForTerms(ASCIIToUTF16(kTerms[i])));
+  }
+
+  URLIndexPrivateData& private_data(*GetPrivateData());
+  size_t item_count = private_data.history_info_map_.size();
+  private_data.Compact();
+  EXPECT_TRUE(private_data.IsCompact());
+  EXPECT_FALSE(private_data.Empty());
+  EXPECT_TRUE(private_data.history_info_map_.empty());
+  EXPECT_TRUE(private_data.word_map_.empty());
+
+  // The compact index finds the same items, with the same scores.
+  for (size_t i = 0; i < arraysize(kTerms); ++i) {
+    ScoredHistoryMatches matches =
+        url_index_->HistoryItemsForTerms(ASCIIToUTF16(kTerms[i]));
+    ASSERT_EQ(expected_matches[i].size(), matches.size()) << kTerms[i];
+    for (size_t j = 0; j < matches.size(); ++j) {
+      EXPECT_EQ(expected_matches[i][j].url_info.id(),
+                matches[j].url_info.id());
+      EXPECT_EQ(expected_matches[i][j].raw_score, matches[j].raw_score);
+    }
+  }
+
+  // New items are found alongside the compacted ones.
+  URLRow new_row(GURL("http://www.compactindextest.com/"), 5000);
+  new_row.set_last_visit(base::Time::Now());
+  EXPECT_TRUE(UpdateURL(new_row));
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("compactindextest")).size());
+
+  // Compacted items can be updated.
+  ScoredHistoryMatches matches =
+      url_index_->HistoryItemsForTerms(ASCIIToUTF16("DrudgeReport"));
+  ASSERT_EQ(1U, matches.size());
+  URLRow drudge_row(matches[0].url_info);
+  drudge_row.set_title(ASCIIToUTF16("Zymurgy"));
+  EXPECT_TRUE(UpdateURL(drudge_row));
+  matches = url_index_->HistoryItemsForTerms(ASCIIToUTF16("zymurgy"));
+  ASSERT_EQ(1U, matches.size());
+  EXPECT_EQ(drudge_row.id(), matches[0].url_info.id());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("DrudgeReport")).size());
+
+  // And deleted, whether or not they have been updated.
+  EXPECT_TRUE(DeleteURL(drudge_row.url()));
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("DrudgeReport")).empty());
+  matches = url_index_->HistoryItemsForTerms(ASCIIToUTF16("www.cnn.com"));
+  ASSERT_FALSE(matches.empty());
+  EXPECT_TRUE(DeleteURL(matches[0].url_info.url()));
+  EXPECT_FALSE(DeleteURL(matches[0].url_info.url()));
+  EXPECT_EQ(matches.size() - 1, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("www.cnn.com")).size());
+
+  // What is saved to the cache holds everything, in maps.
+  scoped_refptr<URLIndexPrivateData> data_copy(private_data.Duplicate());
+  data_copy->ExpandCompactIndex();
+  EXPECT_FALSE(data_copy->IsCompact());
+  EXPECT_EQ(item_count - 1, data_copy->history_info_map_.size());
+  EXPECT_EQ(item_count - 1, data_copy->word_starts_map_.size());
+  EXPECT_EQ(data_copy->history_info_map_.size(),
+            data_copy->history_id_word_map_.size());
+
+  // Compacting again folds in the updates.
+  private_data.Compact();
+  EXPECT_TRUE(private_data.history_info_map_.empty());
+  EXPECT_TRUE(private_data.compact_hidden_ids_.empty());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("compactindextest")).size());
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("zymurgy")).empty());
+
+  // A compact index is saved as it is, and mapped back in. Without
+  // --enable-compact-history-index it is then moved into the maps.
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("HistoryCache");
+  ASSERT_TRUE(URLIndexPrivateData::WritePrivateDataToCacheFileTask(
+      private_data.Duplicate(), path));
+  EXPECT_TRUE(CompactURLIndex::CreateFromFile(path));
+  scoped_refptr<URLIndexPrivateData> restored_data(
+      URLIndexPrivateData::RestoreFromFile(path, "en"));
+  ASSERT_TRUE(restored_data);
+  EXPECT_FALSE(restored_data->IsCompact());
+  EXPECT_EQ(item_count - 1, restored_data->history_info_map_.size());
+  EXPECT_EQ(item_count - 1, restored_data->word_starts_map_.size());
+}
+
+TEST_F(InMemoryURLIndexTest, RecompactOnFileThread) {
+  base::ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  set_history_dir(temp_directory.path());
+  GetPrivateData()->Compact();
+
+  // Enough updates to recompact. Updating leaves them in the maps, and saves
+  // the cache, which compacts a copy on the file thread.
+  URLsModifiedDetails modified_details;
+  for (int i = 0; i < 2000; ++i) {
+    URLRow row(GURL(base::StringPrintf("http://recompact%d.com/", i)),
+               10000 + i);
+    row.set_last_visit(base::Time::Now());
+    modified_details.changed_urls.push_back(row);
+  }
+  Observe(chrome::NOTIFICATION_HISTORY_URLS_MODIFIED,
+          content::Source<InMemoryURLIndexTest>(this),
+          content::Details<history::HistoryDetails>(&modified_details));
+  scoped_refptr<URLIndexPrivateData> old_data(GetPrivateData());
+  EXPECT_EQ(2000U, old_data->history_info_map_.size());
+
+  // Updates made while the copy is being compacted are made to it as well.
+  URLsModifiedDetails late_details;
+  URLRow late_row(GURL("http://www.recompactlate.com/"), 20000);
+  late_row.set_last_visit(base::Time::Now());
+  late_details.changed_urls.push_back(late_row);
+  Observe(chrome::NOTIFICATION_HISTORY_URLS_MODIFIED,
+          content::Source<InMemoryURLIndexTest>(this),
+          content::Details<history::HistoryDetails>(&late_details));
+
+  CacheFileSaverObserver save_observer(&message_loop_);
+  url_index_->set_save_cache_observer(&save_observer);
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+
+  URLIndexPrivateData* new_data = GetPrivateData();
+  EXPECT_NE(old_data.get(), new_data);
+  EXPECT_TRUE(new_data->IsCompact());
+  EXPECT_EQ(1U, new_data->history_info_map_.size());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("recompact1999")).size());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("recompactlate")).size());
+}
+
 class InMemoryURLIndexCacheTest : public testing::Test {
  public:
   InMemoryURLIndexCacheTest() {}
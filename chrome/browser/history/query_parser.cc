@@ -394,6 +394,12 @@ bool QueryParser::ParseQueryImpl(const string16& query, QueryNodeList* root) {
   return true;
 }
 
+// static
+void QueryParser::SortAndCoalesceMatchPositions(
+    Snippet::MatchPositions* matches) {
+  CoalseAndSortMatchPositions(matches);
+}
+
 void QueryParser::ExtractQueryWords(const string16& text,
                                     std::vector<QueryWord>* words) {
   base::i18n::BreakIterator iter(text, base::i18n::BreakIterator::BREAK_WORD);
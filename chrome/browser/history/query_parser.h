@@ -87,14 +87,18 @@ class QueryParser {
                       const std::vector<QueryNode*>& nodes,
                       Snippet::MatchPositions* match_positions);
 
+  // Extracts the words from |text|, placing each word into |words|.
+  void ExtractQueryWords(const string16& text, std::vector<QueryWord>* words);
+
+  // Sorts the match positions in |matches| by their first index, then
+  // coalesces any match positions that intersect each other.
+  static void SortAndCoalesceMatchPositions(Snippet::MatchPositions* matches);
+
  private:
   // Does the work of parsing |query|; creates nodes in |root| as appropriate.
   // This is invoked from both of the ParseQuery methods.
   bool ParseQueryImpl(const string16& query, QueryNodeList* root);
 
-  // Extracts the words from |text|, placing each word into |words|.
-  void ExtractQueryWords(const string16& text, std::vector<QueryWord>* words);
-
   DISALLOW_COPY_AND_ASSIGN(QueryParser);
 };
 
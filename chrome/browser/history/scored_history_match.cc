@@ -47,12 +47,7 @@ bool ScoredHistoryMatch::also_do_hup_like_scoring = false;
 ScoredHistoryMatch::ScoredHistoryMatch()
     : raw_score(0),
       can_inline(false) {
-  if (!initialized_) {
-    InitializeNewScoringField();
-    InitializeOnlyCountMatchesAtWordBoundariesField();
-    InitializeAlsoDoHUPLikeScoringField();
-    initialized_ = true;
-  }
+  Init();
 }
 
 ScoredHistoryMatch::ScoredHistoryMatch(const URLRow& row,
@@ -64,12 +59,7 @@ ScoredHistoryMatch::ScoredHistoryMatch(const URLRow& row,
     : HistoryMatch(row, 0, false, false),
       raw_score(0),
       can_inline(false) {
-  if (!initialized_) {
-    InitializeNewScoringField();
-    InitializeOnlyCountMatchesAtWordBoundariesField();
-    InitializeAlsoDoHUPLikeScoringField();
-    initialized_ = true;
-  }
+  Init();
 
   GURL gurl = row.url();
   if (!gurl.is_valid())
@@ -263,6 +253,20 @@ ScoredHistoryMatch::ScoredHistoryMatch(const URLRow& row,
 
 ScoredHistoryMatch::~ScoredHistoryMatch() {}
 
+// static
+void ScoredHistoryMatch::Init() {
+  if (initialized_)
+    return;
+  InitializeNewScoringField();
+  InitializeOnlyCountMatchesAtWordBoundariesField();
+  InitializeAlsoDoHUPLikeScoringField();
+  raw_term_score_to_topicality_score = new float[kMaxRawTermScore];
+  FillInTermScoreToTopicalityScoreArray();
+  days_ago_to_recency_score = new float[kDaysToPrecomputeRecencyScoresFor];
+  FillInDaysAgoToRecencyScoreArray();
+  initialized_ = true;
+}
+
 // std::accumulate helper function to add up TermMatches' lengths as used in
 // ScoreComponentForMatches
 int AccumulateMatchLength(int total, const TermMatch& match) {
@@ -432,19 +436,7 @@ float ScoredHistoryMatch::GetTopicalityScore(
     const TermMatches& url_matches,
     const TermMatches& title_matches,
     const RowWordStarts& word_starts) {
-  // Because the below thread is not thread safe, we check that we're
-  // only calling it from one thread: the UI thread.  Specifically,
-  // we check "if we've heard of the UI thread then we'd better
-  // be on it."  The first part is necessary so unit tests pass.  (Many
-  // unit tests don't set up the threading naming system; hence
-  // CurrentlyOn(UI thread) will fail.)
-  DCHECK(
-      !content::BrowserThread::IsWellKnownThread(content::BrowserThread::UI) ||
-      content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
-  if (raw_term_score_to_topicality_score == NULL) {
-    raw_term_score_to_topicality_score = new float[kMaxRawTermScore];
-    FillInTermScoreToTopicalityScoreArray();
-  }
+  DCHECK(initialized_);
   // A vector that accumulates per-term scores.  The strongest match--a
   // match in the hostname at a word boundary--is worth 10 points.
   // Everything else is less.  In general, a match that's not at a word
@@ -569,19 +561,7 @@ float* ScoredHistoryMatch::days_ago_to_recency_score = NULL;
 
 // static
 float ScoredHistoryMatch::GetRecencyScore(int last_visit_days_ago) {
-  // Because the below thread is not thread safe, we check that we're
-  // only calling it from one thread: the UI thread.  Specifically,
-  // we check "if we've heard of the UI thread then we'd better
-  // be on it."  The first part is necessary so unit tests pass.  (Many
-  // unit tests don't set up the threading naming system; hence
-  // CurrentlyOn(UI thread) will fail.)
-  DCHECK(
-      !content::BrowserThread::IsWellKnownThread(content::BrowserThread::UI) ||
-      content::BrowserThread::CurrentlyOn(content::BrowserThread::UI));
-  if (days_ago_to_recency_score == NULL) {
-    days_ago_to_recency_score = new float[kDaysToPrecomputeRecencyScoresFor];
-    FillInDaysAgoToRecencyScoreArray();
-  }
+  DCHECK(initialized_);
   // Lookup the score in days_ago_to_recency_score, treating
   // everything older than what we've precomputed as the oldest thing
   // we've precomputed.  The std::max is to protect against corruption
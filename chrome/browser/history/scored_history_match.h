@@ -38,6 +38,13 @@ struct ScoredHistoryMatch : public history::HistoryMatch {
                      BookmarkService* bookmark_service);
   ~ScoredHistoryMatch();
 
+  // Reads the field trials which choose how matches are scored and fills in
+  // the score tables, unless that has been done already. Matches made before
+  // then do it, but as field trials may only be read on the main thread, and
+  // the tables are then only read, this must be called there before matches
+  // are made on any other.
+  static void Init();
+
   // Calculates a component score based on position, ordering, word
   // boundaries, and total substring match size using metrics recorded
   // in |matches| and |word_starts|. |max_length| is the length of
@@ -144,8 +151,8 @@ struct ScoredHistoryMatch : public history::HistoryMatch {
   // |days_ago_to_recency_score| is a simple array mapping how long
   // ago a page was visited (in days) to the recency score we should
   // assign it.  This allows easy lookups of scores without requiring
-  // math.  This is initialized upon first use of GetRecencyScore(),
-  // which calls FillInDaysAgoToRecencyScoreArray(),
+  // math.  This is initialized by Init(), which calls
+  // FillInDaysAgoToRecencyScoreArray().
   static const int kDaysToPrecomputeRecencyScoresFor = 366;
   static float* days_ago_to_recency_score;
 
@@ -155,8 +162,8 @@ struct ScoredHistoryMatch : public history::HistoryMatch {
   // hits for the term, weighted by how important the hit is:
   // hostname, path, etc.) to the topicality score we should assign
   // it.  This allows easy lookups of scores without requiring math.
-  // This is initialized upon first use of GetTopicalityScore(),
-  // which calls FillInTermScoreToTopicalityScoreArray().
+  // This is initialized by Init(), which calls
+  // FillInTermScoreToTopicalityScoreArray().
   static const int kMaxRawTermScore = 30;
   static float* raw_term_score_to_topicality_score;
 
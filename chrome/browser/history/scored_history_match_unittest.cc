@@ -73,6 +73,7 @@ float ScoredHistoryMatchTest::GetTopicalityScoreOfTermAgainstURLAndTitle(
   RowWordStarts word_starts;
   String16SetFromString16(url, &word_starts.url_word_starts_);
   String16SetFromString16(title, &word_starts.title_word_starts_);
+  ScoredHistoryMatch::Init();
   return ScoredHistoryMatch::GetTopicalityScore(
       1, url, url_matches, title_matches, word_starts);
 }
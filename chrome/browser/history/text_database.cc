@@ -62,6 +62,10 @@ TextDatabase::Match::Match() {}
 
 TextDatabase::Match::~Match() {}
 
+TextDatabase::PageData::PageData() {}
+
+TextDatabase::PageData::~PageData() {}
+
 TextDatabase::TextDatabase(const FilePath& path,
                            DBIdent id,
                            bool allow_create)
@@ -370,4 +374,19 @@ bool TextDatabase::GetTextMatches(const std::string& query,
   return result_count > options.max_count;
 }
 
+void TextDatabase::GetAllPageData(std::vector<PageData>* pages) {
+  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+      "SELECT time, url, title, body FROM pages "
+      "JOIN info ON pages.rowid = info.rowid "
+      "ORDER BY time, info.rowid"));
+  while (statement.Step()) {
+    pages->resize(pages->size() + 1);
+    PageData& page = pages->back();
+    page.time = base::Time::FromInternalValue(statement.ColumnInt64(0));
+    page.url = statement.ColumnString(1);
+    page.title = statement.ColumnString(2);
+    page.body = statement.ColumnString(3);
+  }
+}
+
 }  // namespace history
@@ -6,6 +6,7 @@
 #define CHROME_BROWSER_HISTORY_TEXT_DATABASE_H_
 
 #include <set>
+#include <string>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -52,6 +53,17 @@ class TextDatabase {
     Snippet snippet;
   };
 
+  // The data of a page, as it was passed to AddPageData().
+  struct PageData {
+    PageData();
+    ~PageData();
+
+    base::Time time;
+    std::string url;
+    std::string title;
+    std::string body;
+  };
+
   // Note: You must call init which must succeed before using this class.
   //
   // Computes the matches for the query, returning results in decreasing order
@@ -140,6 +152,10 @@ class TextDatabase {
                       std::vector<Match>* results,
                       URLSet* unique_urls);
 
+  // Appends the data of every page in the database to |pages|, oldest first.
+  // This is for moving the data to another index.
+  void GetAllPageData(std::vector<PageData>* pages);
+
   // Converts the given database identifier to a filename. This does not include
   // the path, just the file and extension.
   static FilePath IDToFileName(DBIdent id);
@@ -12,6 +12,7 @@
 #include "base/file_util.h"
 #include "base/metrics/histogram.h"
 #include "base/logging.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop.h"
 #include "base/string_util.h"
 #include "base/utf_string_conversions.h"
@@ -38,6 +39,10 @@ std::string ConvertStringForIndexer(const string16& input) {
 // haven't gotten a title and/or body.
 const int kExpirationSeconds = 20;
 
+// The file holding the text index, when one is used.
+const FilePath::CharType kTextIndexFileName[] =
+    FILE_PATH_LITERAL("History Text Index");
+
 }  // namespace
 
 // TextDatabaseManager::ChangeSet ----------------------------------------------
@@ -89,6 +94,7 @@ TextDatabaseManager::TextDatabaseManager(const FilePath& dir,
       transaction_nesting_(0),
       db_cache_(DBCache::NO_AUTO_EVICT),
       present_databases_loaded_(false),
+      use_text_index_(false),
       ALLOW_THIS_IN_INITIALIZER_LIST(weak_factory_(this)),
       history_publisher_(NULL) {
 }
@@ -96,6 +102,8 @@ TextDatabaseManager::TextDatabaseManager(const FilePath& dir,
 TextDatabaseManager::~TextDatabaseManager() {
   if (transaction_nesting_)
     CommitTransaction();
+  if (text_index_.get())
+    text_index_->Flush();
 }
 
 // static
@@ -120,6 +128,11 @@ Time TextDatabaseManager::IDToTime(TextDatabase::DBIdent id) {
 bool TextDatabaseManager::Init(const HistoryPublisher* history_publisher) {
   history_publisher_ = history_publisher;
 
+  if (use_text_index_)
+    InitTextIndex();
+  else if (TextIndex::IndexExists(GetTextIndexPath()))
+    MoveTextIndexToDatabases();
+
   // Start checking recent changes and committing them.
   ScheduleFlushOldChanges();
   return true;
@@ -149,6 +162,9 @@ void TextDatabaseManager::CommitTransaction() {
 
   // Now that the transaction is over, we can expire old connections.
   db_cache_.ShrinkToSize(kCacheDBSize);
+
+  if (text_index_.get())
+    text_index_->Flush();
 }
 
 void TextDatabaseManager::InitDBList() {
@@ -275,9 +291,12 @@ bool TextDatabaseManager::AddPageData(const GURL& url,
                                       Time visit_time,
                                       const string16& title,
                                       const string16& body) {
-  TextDatabase* db = GetDBForTime(visit_time, true);
-  if (!db)
-    return false;
+  TextDatabase* db = NULL;
+  if (!text_index_.get()) {
+    db = GetDBForTime(visit_time, true);
+    if (!db)
+      return false;
+  }
 
   TimeTicks beginning_time = TimeTicks::Now();
 
@@ -314,9 +333,16 @@ bool TextDatabaseManager::AddPageData(const GURL& url,
 
   // Now index the data.
   std::string url_str = URLDatabase::GURLToDatabaseURL(url);
-  bool success = db->AddPageData(visit_time, url_str,
-                                 ConvertStringForIndexer(title),
-                                 ConvertStringForIndexer(body));
+  bool success = true;
+  if (text_index_.get()) {
+    success = text_index_->AddPageData(visit_time, url_str,
+                                       ConvertStringForIndexer(title),
+                                       ConvertStringForIndexer(body));
+  } else {
+    success = db->AddPageData(visit_time, url_str,
+                              ConvertStringForIndexer(title),
+                              ConvertStringForIndexer(body));
+  }
 
   UMA_HISTOGRAM_TIMES("History.AddFTSData",
                       TimeTicks::Now() - beginning_time);
@@ -331,6 +357,16 @@ void TextDatabaseManager::DeletePageData(Time time, const GURL& url,
                                          ChangeSet* change_set) {
   TextDatabase::DBIdent db_ident = TimeToID(time);
 
+  if (text_index_.get()) {
+    text_index_->DeletePageData(time, URLDatabase::GURLToDatabaseURL(url));
+    if (change_set)
+      change_set->Add(db_ident);
+    // The databases the index was made from are kept until it is read back,
+    // and must lose the page too.
+    if (present_databases_.empty())
+      return;
+  }
+
   // We want to open the database for writing, but only if it exists. To
   // achieve this, we check whether it exists by saying we're not going to
   // write to it (avoiding the autocreation code normally called when writing)
@@ -399,27 +435,39 @@ void TextDatabaseManager::DeleteFromUncommittedForTimes(
   }
 }
 
+void TextDatabaseManager::DeleteIndexedDataBefore(Time time) {
+  if (!text_index_.get())
+    return;
+  size_t page_count = text_index_->page_count();
+  text_index_->DeletePageDataBetween(Time(), time);
+  if (text_index_->page_count() == page_count)
+    return;  // Nothing was deleted.
+  text_index_->Compact();
+}
+
 void TextDatabaseManager::DeleteAll() {
   DCHECK_EQ(0, transaction_nesting_) << "Calling deleteAll in a transaction.";
 
-  InitDBList();
+  if (text_index_.get())
+    text_index_->Clear();
 
   // Delete uncommitted entries.
   recent_changes_.Clear();
 
-  // Close all open databases.
-  db_cache_.Clear();
-
-  // Now go through and delete all the files.
-  for (DBIdentSet::iterator i = present_databases_.begin();
-       i != present_databases_.end(); ++i) {
-    FilePath file_name = dir_.Append(TextDatabase::IDToFileName(*i));
-    file_util::Delete(file_name, false);
-  }
+  DeleteDatabaseFiles();
 }
 
 void TextDatabaseManager::OptimizeChangedDatabases(
     const ChangeSet& change_set) {
+  if (text_index_.get()) {
+    // Make sure the deleted pages are gone from the posting lists and from
+    // the pages file.
+    if (!change_set.changed_databases_.empty())
+      text_index_->Compact();
+    if (present_databases_.empty())
+      return;
+  }
+
   for (ChangeSet::DBSet::const_iterator i =
            change_set.changed_databases_.begin();
        i != change_set.changed_databases_.end(); ++i) {
@@ -446,6 +494,20 @@ void TextDatabaseManager::GetTextMatches(
 
   *first_time_searched = options.begin_time;
 
+  if (text_index_.get()) {
+    ScopedVector<QueryNode> query_nodes;
+    query_parser_.ParseQueryNodes(query, &query_nodes.get());
+    TextDatabase::URLSet found_urls;
+    bool has_more_results = text_index_->GetTextMatches(
+        query_nodes.get(), options, results, &found_urls);
+    if (!results->empty() &&
+        (has_more_results ||
+         static_cast<int>(results->size()) == options.EffectiveMaxCount())) {
+      *first_time_searched = results->back().time;
+    }
+    return;
+  }
+
   InitDBList();
   if (present_databases_.empty())
     return;  // Nothing to search.
@@ -557,6 +619,86 @@ TextDatabase* TextDatabaseManager::GetDBForTime(Time time,
   return GetDB(TimeToID(time), create_if_necessary);
 }
 
+FilePath TextDatabaseManager::GetTextIndexPath() const {
+  return dir_.Append(kTextIndexFileName);
+}
+
+void TextDatabaseManager::InitTextIndex() {
+  FilePath path = GetTextIndexPath();
+  text_index_.reset(new TextIndex);
+  if (TextIndex::IndexExists(path)) {
+    if (text_index_->Init(path)) {
+      // The index has been read back, so the databases it was made from are
+      // no longer needed.
+      DeleteDatabaseFiles();
+      return;
+    }
+    TextIndex::DeleteIndex(path);
+    text_index_.reset(new TextIndex);
+  }
+  if (!text_index_->Init(path)) {
+    text_index_.reset();  // Keep using the databases.
+    return;
+  }
+
+  // Copy the data of the per-month databases into the new index, oldest
+  // first. They are kept until the index is read back at the next start, so
+  // that they aren't lost if it couldn't be written.
+  InitDBList();
+  for (DBIdentSet::const_iterator i = present_databases_.begin();
+       i != present_databases_.end(); ++i) {
+    TextDatabase db(dir_, *i, false);
+    if (!db.Init())
+      continue;
+    std::vector<TextDatabase::PageData> pages;
+    db.GetAllPageData(&pages);
+    for (size_t j = 0; j < pages.size(); ++j) {
+      text_index_->AddPageData(pages[j].time, pages[j].url, pages[j].title,
+                               pages[j].body);
+    }
+  }
+  text_index_->Flush();
+}
+
+void TextDatabaseManager::MoveTextIndexToDatabases() {
+  FilePath path = GetTextIndexPath();
+  TextIndex text_index;
+  if (text_index.Init(path)) {
+    // The index has everything the databases have, and what was added since,
+    // so they are made again from it.
+    DeleteDatabaseFiles();
+    std::vector<TextDatabase::PageData> pages;
+    text_index.GetAllPageData(&pages);
+    BeginTransaction();
+    for (size_t i = 0; i < pages.size(); ++i) {
+      TextDatabase* db = GetDBForTime(pages[i].time, true);
+      if (!db || !db->AddPageData(pages[i].time, pages[i].url,
+                                  pages[i].title, pages[i].body)) {
+        // Keep the index, to try again at the next start.
+        CommitTransaction();
+        return;
+      }
+    }
+    CommitTransaction();
+  }
+  TextIndex::DeleteIndex(path);
+}
+
+void TextDatabaseManager::DeleteDatabaseFiles() {
+  InitDBList();
+
+  // Close all open databases.
+  db_cache_.Clear();
+
+  // Now go through and delete all the files.
+  for (DBIdentSet::iterator i = present_databases_.begin();
+       i != present_databases_.end(); ++i) {
+    FilePath file_name = dir_.Append(TextDatabase::IDToFileName(*i));
+    file_util::Delete(file_name, false);
+  }
+  present_databases_.clear();
+}
+
 void TextDatabaseManager::ScheduleFlushOldChanges() {
   weak_factory_.InvalidateWeakPtrs();
   MessageLoop::current()->PostDelayedTask(
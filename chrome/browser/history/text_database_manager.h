@@ -13,10 +13,13 @@
 #include "base/containers/mru_cache.h"
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
 #include "base/string16.h"
+#include "base/time.h"
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/history/text_database.h"
+#include "chrome/browser/history/text_index.h"
 #include "chrome/browser/history/query_parser.h"
 #include "chrome/browser/history/url_database.h"
 
@@ -40,6 +43,12 @@ class VisitDatabase;
 // Note: be careful to delete the relevant entries from this uncommitted list
 // when clearing history or this information may get added to the database soon
 // after the clear.
+//
+// When asked to, the manager keeps the indexed data in a single TextIndex
+// instead of in the per-month databases. The databases found when the index is
+// first made are copied into it, and deleted once it has been read back at a
+// later start. Without the index, any index found is moved back into the
+// databases, so that nothing is lost by turning it on and off.
 class TextDatabaseManager {
  public:
   // Tracks a set of changes (only deletes need to be supported now) to the
@@ -79,6 +88,12 @@ class TextDatabaseManager {
                       VisitDatabase* visit_database);
   ~TextDatabaseManager();
 
+  // Makes the manager use a TextIndex rather than per-month TextDatabases.
+  // Must be called before Init().
+  void set_use_text_index(bool use_text_index) {
+    use_text_index_ = use_text_index;
+  }
+
   // Must call before using other functions. If it returns false, no other
   // functions should be called.
   bool Init(const HistoryPublisher* history_publisher);
@@ -141,6 +156,11 @@ class TextDatabaseManager {
   // times, which must be in reverse chronological order.
   void DeleteFromUncommittedForTimes(const std::vector<base::Time>& times);
 
+  // Deletes the indexed data of pages visited before |time| from the text
+  // index, if one is used. The per-month databases are expired by deleting
+  // their files instead.
+  void DeleteIndexedDataBefore(base::Time time);
+
   // Deletes all full text search data by removing the files from the disk.
   // This must be called OUTSIDE of a transaction since it actually deletes the
   // files rather than messing with the database.
@@ -243,6 +263,19 @@ class TextDatabaseManager {
   // call it whenever you want to ensure the present_databases_ set is filled.
   void InitDBList();
 
+  // Returns the file holding the text index.
+  FilePath GetTextIndexPath() const;
+
+  // Reads the text index from its files, or makes it from the per-month
+  // databases if there is none.
+  void InitTextIndex();
+
+  // Makes the per-month databases again from the text index, then deletes it.
+  void MoveTextIndexToDatabases();
+
+  // Closes and deletes the per-month databases.
+  void DeleteDatabaseFiles();
+
   // Schedules a call to ExpireRecentChanges in the future.
   void ScheduleFlushOldChanges();
 
@@ -303,6 +336,15 @@ class TextDatabaseManager {
 
   QueryParser query_parser_;
 
+  // Set when the indexed data is kept in |text_index_| instead of in the
+  // databases. The index writes each change as it is made, and is flushed,
+  // which may write a snapshot of it, when the outermost transaction is
+  // committed and when the manager is destroyed. The text of deleted pages is
+  // dropped from its files when they are optimized, by
+  // OptimizeChangedDatabases().
+  bool use_text_index_;
+  scoped_ptr<TextIndex> text_index_;
+
   // Generates tasks for our periodic checking of expired "recent changes".
   base::WeakPtrFactory<TextDatabaseManager> weak_factory_;
 
@@ -0,0 +1,229 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/text_database_manager.h"
+#include "chrome/browser/history/visit_database.h"
+#include "googleurl/src/gurl.h"
+#include "sql/connection.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Time;
+using base::TimeDelta;
+
+namespace history {
+
+namespace {
+
+// The shape of the synthetic history: a year of pages, with bodies drawn from
+// a vocabulary where a few words are very common and most are rare.
+const int kPageCount = 20000;
+const int kVocabularySize = 50000;
+const int kTitleWordCount = 6;
+const int kBodyWordCount = 300;
+const int kDays = 365;
+
+// Each query is run this many times, and the mean time is logged.
+const int kQueryRepeatCount = 20;
+
+// The text database manager updates the visit database as it indexes pages.
+class InMemDB : public URLDatabase, public VisitDatabase {
+ public:
+  InMemDB() {
+    EXPECT_TRUE(db_.OpenInMemory());
+    CreateURLTable(false);
+    InitVisitTable();
+  }
+  virtual ~InMemDB() {}
+
+ private:
+  virtual sql::Connection& GetDB() OVERRIDE { return db_; }
+
+  sql::Connection db_;
+
+  DISALLOW_COPY_AND_ASSIGN(InMemDB);
+};
+
+// A page of the synthetic history.
+struct TestPage {
+  GURL url;
+  Time time;
+  string16 title;
+  string16 body;
+};
+
+// Generates the same pages on every run.
+class PageGenerator {
+ public:
+  PageGenerator() : seed_(1) {
+    for (int i = 0; i < kVocabularySize; ++i) {
+      std::string word;
+      int length = 3 + Next() % 8;
+      for (int j = 0; j < length; ++j)
+        word.push_back('a' + Next() % 26);
+      vocabulary_.push_back(word);
+    }
+  }
+
+  const std::string& word(int rank) const { return vocabulary_[rank]; }
+
+  void Generate(std::vector<TestPage>* pages) {
+    Time start = Time::Now() - TimeDelta::FromDays(kDays);
+    for (int i = 0; i < kPageCount; ++i) {
+      TestPage page;
+      page.url = GURL(base::StringPrintf("http://www.%s.com/%s/%d",
+                                         RandomWord().c_str(),
+                                         RandomWord().c_str(), i));
+      page.time = start + TimeDelta::FromDays(kDays) * i / kPageCount;
+      page.title = UTF8ToUTF16(RandomText(kTitleWordCount));
+      page.body = UTF8ToUTF16(RandomText(kBodyWordCount));
+      pages->push_back(page);
+    }
+  }
+
+ private:
+  uint32 Next() {
+    seed_ = seed_ * 1103515245 + 12345;
+    return seed_ >> 8;
+  }
+
+  // Returns a word, with ranks spread roughly as in natural text: each
+  // doubling of the rank halves how often a word is used.
+  const std::string& RandomWord() {
+    double u = (Next() % 1000000) / 1000000.0;
+    int rank = static_cast<int>(pow(static_cast<double>(kVocabularySize), u));
+    return vocabulary_[rank - 1];
+  }
+
+  std::string RandomText(int word_count) {
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+      if (i)
+        text.push_back(' ');
+      text.append(RandomWord());
+    }
+    return text;
+  }
+
+  uint32 seed_;
+  std::vector<std::string> vocabulary_;
+};
+
+// Returns the total size of the files in |dir|.
+int64 GetDirectorySize(const FilePath& dir) {
+  int64 size = 0;
+  file_util::FileEnumerator enumerator(dir, false,
+                                       file_util::FileEnumerator::FILES);
+  for (FilePath file = enumerator.Next(); !file.empty();
+       file = enumerator.Next()) {
+    int64 file_size = 0;
+    if (file_util::GetFileSize(file, &file_size))
+      size += file_size;
+  }
+  return size;
+}
+
+class TextDatabaseManagerPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    generator_.Generate(&pages_);
+  }
+
+  // Indexes the pages with the databases or with the text index, and logs the
+  // size of the files and the time taken by queries, under |name|.
+  void IndexAndQuery(const std::string& name, bool use_text_index) {
+    FilePath dir(temp_dir_.path().AppendASCII(name));
+    ASSERT_TRUE(file_util::CreateDirectory(dir));
+    InMemDB visit_db;
+
+    {
+      TextDatabaseManager manager(dir, &visit_db, &visit_db);
+      manager.set_use_text_index(use_text_index);
+      ASSERT_TRUE(manager.Init(NULL));
+      PerfTimeLogger add_timer(
+          base::StringPrintf("History_text_%s_add_time", name.c_str())
+              .c_str());
+      manager.BeginTransaction();
+      for (size_t i = 0; i < pages_.size(); ++i) {
+        manager.AddPageData(pages_[i].url, 0, 0, pages_[i].time,
+                            pages_[i].title, pages_[i].body);
+      }
+      manager.CommitTransaction();
+    }
+    LogPerfResult(
+        base::StringPrintf("History_text_%s_size", name.c_str()).c_str(),
+        GetDirectorySize(dir) / 1024.0, "kb");
+
+    TextDatabaseManager manager(dir, &visit_db, &visit_db);
+    manager.set_use_text_index(use_text_index);
+    {
+      PerfTimeLogger init_timer(
+          base::StringPrintf("History_text_%s_init_time", name.c_str())
+              .c_str());
+      ASSERT_TRUE(manager.Init(NULL));
+    }
+
+    // Words of several frequencies, a prefix, several words and a phrase.
+    struct {
+      const char* name;
+      std::string text;
+    } queries[] = {
+      { "common", generator_.word(0) },
+      { "frequent", generator_.word(20) },
+      { "rare", generator_.word(5000) },
+      { "prefix", generator_.word(50).substr(0, 3) },
+      { "two_words", generator_.word(10) + " " + generator_.word(300) },
+      { "phrase", "\"" + UTF16ToUTF8(pages_[kPageCount / 2].title) + "\"" },
+    };
+    for (size_t i = 0; i < arraysize(queries); ++i) {
+      // As the history page does, fetch a page of results.
+      QueryOptions options;
+      options.max_count = 100;
+      std::vector<TextDatabase::Match> results;
+      Time first_time_searched;
+      PerfTimer timer;
+      for (int j = 0; j < kQueryRepeatCount; ++j) {
+        manager.GetTextMatches(UTF8ToUTF16(queries[i].text), options,
+                               &results, &first_time_searched);
+      }
+      LogPerfResult(base::StringPrintf("History_text_%s_query_%s_time",
+                                       name.c_str(), queries[i].name).c_str(),
+                    timer.Elapsed().InMillisecondsF() / kQueryRepeatCount,
+                    "ms");
+      LogPerfResult(base::StringPrintf("History_text_%s_query_%s_results",
+                                       name.c_str(), queries[i].name).c_str(),
+                    results.size(), "results");
+    }
+  }
+
+  MessageLoop message_loop_;
+  base::ScopedTempDir temp_dir_;
+  PageGenerator generator_;
+  std::vector<TestPage> pages_;
+};
+
+}  // namespace
+
+// Compares a year of history indexed in the per-month FTS databases with the
+// same history in a single text index: the size on disk, the time to add the
+// pages and to load them, and the time taken by queries of various kinds.
+TEST_F(TextDatabaseManagerPerfTest, IndexSizeAndQueryTime) {
+  IndexAndQuery("fts", false);
+  IndexAndQuery("index", true);
+}
+
+}  // namespace history
@@ -9,6 +9,7 @@
 #include "base/message_loop.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/history/text_database_manager.h"
+#include "chrome/browser/history/text_index.h"
 #include "chrome/browser/history/visit_database.h"
 #include "sql/connection.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -595,4 +596,85 @@ TEST_F(TextDatabaseManagerTest, DeleteUncommittedForTimes) {
   EXPECT_EQ(3u, manager.GetUncommittedEntryCountForTest());
 }
 
+// Tests that a text index takes over the data of the databases, answers
+// queries as they did, and gives its data back to them when it is turned off.
+TEST_F(TextDatabaseManagerTest, TextIndex) {
+  ASSERT_TRUE(Init());
+  InMemDB visit_db;
+  std::vector<Time> times;
+  {
+    TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+    ASSERT_TRUE(manager.Init(NULL));
+    AddAllPages(manager, &visit_db, &times);
+  }
+  FilePath january_file = dir_.Append(TextDatabase::IDToFileName(200801));
+  ASSERT_TRUE(file_util::PathExists(january_file));
+
+  string16 foo = UTF8ToUTF16("FOO");
+  QueryOptions options;
+  std::vector<TextDatabase::Match> results;
+  Time first_time_searched;
+  {
+    TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+    manager.set_use_text_index(true);
+    ASSERT_TRUE(manager.Init(NULL));
+
+    // The databases were copied into the index, and are kept until it has
+    // been read back.
+    EXPECT_TRUE(file_util::PathExists(january_file));
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(6U, results.size());
+
+    options.max_count = 2;
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(2U, results.size());
+    EXPECT_TRUE(first_time_searched <= times[4]);
+    EXPECT_TRUE(ResultsHaveURL(results, kURL5));
+    EXPECT_TRUE(ResultsHaveURL(results, kURL1));
+
+    // Query the previous two from where that left off.
+    options.end_time = first_time_searched;
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(2U, results.size());
+    EXPECT_TRUE(ResultsHaveURL(results, kURL3));
+    EXPECT_TRUE(ResultsHaveURL(results, kURL4));
+
+    TextDatabaseManager::ChangeSet change_set;
+    manager.DeletePageData(times[5], GURL(kURL1), &change_set);
+    manager.OptimizeChangedDatabases(change_set);
+    options = QueryOptions();
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(5U, results.size());
+  }
+
+  // The index was saved, and the databases are deleted once it is read back.
+  {
+    TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+    manager.set_use_text_index(true);
+    ASSERT_TRUE(manager.Init(NULL));
+    EXPECT_FALSE(file_util::PathExists(january_file));
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(5U, results.size());
+  }
+
+  // Without the index, its data is moved back into the databases.
+  FilePath index_file = dir_.Append(FILE_PATH_LITERAL("History Text Index"));
+  ASSERT_TRUE(TextIndex::IndexExists(index_file));
+  {
+    TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+    ASSERT_TRUE(manager.Init(NULL));
+    EXPECT_FALSE(TextIndex::IndexExists(index_file));
+    EXPECT_TRUE(file_util::PathExists(january_file));
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(5U, results.size());
+  }
+  {
+    TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+    manager.set_use_text_index(true);
+    ASSERT_TRUE(manager.Init(NULL));
+    manager.GetTextMatches(foo, options, &results, &first_time_searched);
+    EXPECT_EQ(5U, results.size());
+  }
+}
+
 }  // namespace history
@@ -0,0 +1,862 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/text_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/i18n/case_conversion.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/platform_file.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/varint.h"
+#include "googleurl/src/gurl.h"
+
+namespace history {
+
+namespace {
+
+const uint32 kIndexMagic = 0x48545849;  // "HTXI"
+
+// Bump this when the format of either file changes. Files of other versions
+// are ignored.
+const uint32 kIndexVersion = 2;
+
+// The records of the pages file, after its header. Each is a Pickle starting
+// with the type and the ID of the page.
+enum RecordType {
+  // Followed by the time, URL, title and body of a page.
+  RECORD_ADD_PAGE = 1,
+  RECORD_DELETE_PAGE = 2,
+};
+
+// Longer records are taken for damage.
+const uint32 kMaxRecordSize = 64 * 1024 * 1024;
+
+// A snapshot is written once this much has been added to the pages file since
+// the last.
+const int64 kSnapshotIntervalBytes = 4 * 1024 * 1024;
+
+// Returns the header of a pages file of |generation|.
+Pickle MakeHeader(uint64 generation) {
+  Pickle header;
+  header.WriteUInt32(kIndexMagic);
+  header.WriteUInt32(kIndexVersion);
+  header.WriteUInt64(generation);
+  return header;
+}
+
+// Returns a generation after |generation|.
+uint64 NewGeneration(uint64 generation) {
+  return std::max(generation + 1,
+                  static_cast<uint64>(base::Time::Now().ToInternalValue()));
+}
+
+// Writes |pickle| at |offset| in |file|. Returns true if all of it was
+// written.
+bool WritePickle(base::PlatformFile file, int64 offset, const Pickle& pickle) {
+  int size = static_cast<int>(pickle.size());
+  return base::WritePlatformFile(file, offset,
+                                 static_cast<const char*>(pickle.data()),
+                                 size) == size;
+}
+
+// Reads the pickle at |offset| in |file|, which is |file_size| long, into
+// |data|. Returns its size, or 0 if there isn't a whole one.
+uint32 ReadPickle(base::PlatformFile file,
+                  int64 offset,
+                  int64 file_size,
+                  std::string* data) {
+  // A pickle starts with the size of its payload.
+  uint32 payload_size;
+  if (file_size - offset < static_cast<int64>(sizeof(payload_size)) ||
+      base::ReadPlatformFile(file, offset,
+                             reinterpret_cast<char*>(&payload_size),
+                             sizeof(payload_size)) != sizeof(payload_size) ||
+      payload_size > kMaxRecordSize)
+    return 0;
+  uint32 size = sizeof(payload_size) + payload_size;
+  if (file_size - offset < size)
+    return 0;
+  data->resize(size);
+  if (base::ReadPlatformFile(file, offset, &(*data)[0], size) !=
+          static_cast<int>(size))
+    return 0;
+  return size;
+}
+
+// Appends the IDs in the posting list |data| to |page_ids|.
+void AppendPageIDs(const std::string& data,
+                   std::vector<TextIndex::PageID>* page_ids) {
+  TextIndex::PageID page_id = 0;
+  std::string::const_iterator it = data.begin();
+  while (it != data.end()) {
+    page_id += static_cast<TextIndex::PageID>(ReadVarint(&it, data.end()));
+    page_ids->push_back(page_id);
+  }
+}
+
+// Keeps only the IDs of |page_ids| which are also in |other|. Both are
+// ascending.
+void IntersectPageIDs(const std::vector<TextIndex::PageID>& other,
+                      std::vector<TextIndex::PageID>* page_ids) {
+  std::vector<TextIndex::PageID> intersection;
+  std::set_intersection(page_ids->begin(), page_ids->end(),
+                        other.begin(), other.end(),
+                        std::back_inserter(intersection));
+  page_ids->swap(intersection);
+}
+
+// Lower cases |text| and splits it into words, returning the lower cased text.
+string16 ExtractWords(QueryParser* query_parser,
+                      const string16& text,
+                      std::vector<QueryWord>* words) {
+  string16 lower_text = base::i18n::ToLower(text);
+  query_parser->ExtractQueryWords(lower_text, words);
+  return lower_text;
+}
+
+bool CompareMatchPosition(const Snippet::MatchPosition& mp1,
+                          const Snippet::MatchPosition& mp2) {
+  return mp1.first < mp2.first;
+}
+
+// Sorts |matches| and merges those which overlap, as
+// QueryParser::DoesQueryMatch() does.
+void SortAndCoalesceMatchPositions(Snippet::MatchPositions* matches) {
+  std::sort(matches->begin(), matches->end(), &CompareMatchPosition);
+  Snippet::MatchPositions coalesced;
+  for (size_t i = 0; i < matches->size(); ++i) {
+    const Snippet::MatchPosition& match = (*matches)[i];
+    if (!coalesced.empty() && match.first <= coalesced.back().second)
+      coalesced.back().second = std::max(coalesced.back().second, match.second);
+    else
+      coalesced.push_back(match);
+  }
+  matches->swap(coalesced);
+}
+
+// Converts |matches|, which are sorted positions in |text|, to byte positions
+// in the UTF-8 form of |text|, which is what Snippet::ComputeSnippet() takes.
+void ConvertMatchPositionsToUTF8(const string16& text,
+                                 Snippet::MatchPositions* matches) {
+  size_t utf16_offset = 0;
+  size_t utf8_offset = 0;
+  for (size_t i = 0; i < matches->size(); ++i) {
+    size_t* positions[] = { &(*matches)[i].first, &(*matches)[i].second };
+    for (size_t j = 0; j < arraysize(positions); ++j) {
+      size_t end = std::min(*positions[j], text.size());
+      while (utf16_offset < end) {
+        char16 c = text[utf16_offset++];
+        if (c < 0x80) {
+          utf8_offset += 1;
+        } else if (c < 0x800) {
+          utf8_offset += 2;
+        } else if (c >= 0xD800 && c <= 0xDBFF && utf16_offset < text.size()) {
+          // A surrogate pair is one four byte character.
+          ++utf16_offset;
+          utf8_offset += 4;
+        } else {
+          utf8_offset += 3;
+        }
+      }
+      *positions[j] = utf8_offset;
+    }
+  }
+}
+
+}  // namespace
+
+TextIndex::Page::Page() : time(0), offset(0), size(0), word_count(0) {}
+
+TextIndex::Page::~Page() {}
+
+TextIndex::PostingList::PostingList() : last_page_id(0) {}
+
+TextIndex::PostingList::~PostingList() {}
+
+TextIndex::TextIndex()
+    : pages_file_(base::kInvalidPlatformFileValue),
+      generation_(0),
+      pages_file_size_(0),
+      snapshot_pages_file_size_(0),
+      deleted_bytes_(0),
+      needs_rewrite_(false),
+      next_page_id_(1),
+      posting_count_(0),
+      deleted_posting_count_(0) {
+}
+
+TextIndex::~TextIndex() {
+  if (pages_file_ != base::kInvalidPlatformFileValue)
+    base::ClosePlatformFile(pages_file_);
+}
+
+// static
+FilePath TextIndex::GetPagesFilePath(const FilePath& file_path) {
+  return file_path.AddExtension(FILE_PATH_LITERAL("pages"));
+}
+
+// static
+bool TextIndex::IndexExists(const FilePath& file_path) {
+  return file_util::PathExists(GetPagesFilePath(file_path));
+}
+
+// static
+void TextIndex::DeleteIndex(const FilePath& file_path) {
+  file_util::Delete(GetPagesFilePath(file_path), false);
+  file_util::Delete(file_path, false);
+}
+
+bool TextIndex::Init(const FilePath& file_path) {
+  DCHECK_EQ(base::kInvalidPlatformFileValue, pages_file_);
+  file_path_ = file_path;
+  pages_file_ = base::CreatePlatformFile(
+      GetPagesFilePath(file_path),
+      base::PLATFORM_FILE_OPEN_ALWAYS | base::PLATFORM_FILE_READ |
+          base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (pages_file_ == base::kInvalidPlatformFileValue)
+    return false;
+
+  base::PlatformFileInfo info;
+  if (!base::GetPlatformFileInfo(pages_file_, &info)) {
+    base::ClosePlatformFile(pages_file_);
+    pages_file_ = base::kInvalidPlatformFileValue;
+    return false;
+  }
+  if (!info.size)
+    return StartPagesFile();
+
+  std::string data;
+  uint32 size = ReadPickle(pages_file_, 0, info.size, &data);
+  uint32 magic, version;
+  uint64 generation;
+  if (size) {
+    Pickle header(data.data(), size);
+    PickleIterator iter(header);
+    if (!header.ReadUInt32(&iter, &magic) || magic != kIndexMagic ||
+        !header.ReadUInt32(&iter, &version) || version != kIndexVersion ||
+        !header.ReadUInt64(&iter, &generation))
+      size = 0;
+  }
+  if (!size) {
+    base::ClosePlatformFile(pages_file_);
+    pages_file_ = base::kInvalidPlatformFileValue;
+    return false;
+  }
+
+  generation_ = generation;
+  pages_file_size_ = size;
+  snapshot_pages_file_size_ = size;
+  ReadSnapshot(info.size);
+  ReadPagesFile(info.size);
+  return true;
+}
+
+bool TextIndex::Flush() {
+  if (needs_rewrite_)
+    return RewritePagesFile();
+  if (pages_file_size_ - snapshot_pages_file_size_ >= kSnapshotIntervalBytes)
+    return WriteSnapshot();
+  return true;
+}
+
+bool TextIndex::AddPageData(base::Time time,
+                            const std::string& url,
+                            const std::string& title,
+                            const std::string& contents) {
+  PageID page_id = next_page_id_;
+  Pickle record;
+  record.WriteUInt32(RECORD_ADD_PAGE);
+  record.WriteUInt32(page_id);
+  record.WriteInt64(time.ToInternalValue());
+  record.WriteString(url);
+  record.WriteString(title);
+  record.WriteString(contents);
+  int64 offset = pages_file_size_;
+  if (!AppendRecord(record))
+    return false;
+
+  ++next_page_id_;
+  IndexPage(page_id, time.ToInternalValue(), url, title, contents, offset,
+            static_cast<uint32>(record.size()));
+  return true;
+}
+
+void TextIndex::DeletePageData(base::Time time, const std::string& url) {
+  std::pair<PageTimeMap::iterator, PageTimeMap::iterator> range =
+      page_times_.equal_range(time.ToInternalValue());
+  for (PageTimeMap::iterator it = range.first; it != range.second; ) {
+    if (pages_[it->second].url == url)
+      DeletePage(it++);
+    else
+      ++it;
+  }
+  CompactIfNecessary();
+}
+
+void TextIndex::DeletePageDataBetween(base::Time begin, base::Time end) {
+  PageTimeMap::iterator it = begin.is_null() ? page_times_.begin() :
+      page_times_.lower_bound(begin.ToInternalValue());
+  PageTimeMap::iterator end_it = end.is_null() ? page_times_.end() :
+      page_times_.lower_bound(end.ToInternalValue());
+  while (it != end_it)
+    DeletePage(it++);
+  CompactIfNecessary();
+}
+
+void TextIndex::Clear() {
+  Reset();
+  if (pages_file_ != base::kInvalidPlatformFileValue)
+    StartPagesFile();
+}
+
+void TextIndex::Compact() {
+  CompactPostings();
+  if (deleted_bytes_ || needs_rewrite_)
+    RewritePagesFile();
+}
+
+bool TextIndex::GetTextMatches(const std::vector<QueryNode*>& query_nodes,
+                               const QueryOptions& options,
+                               std::vector<TextDatabase::Match>* results,
+                               TextDatabase::URLSet* found_urls) {
+  if (query_nodes.empty())
+    return false;
+
+  std::vector<PageID> page_ids;
+  GetCandidates(*query_nodes[0], &page_ids);
+  for (size_t i = 1; i < query_nodes.size() && !page_ids.empty(); ++i) {
+    std::vector<PageID> node_page_ids;
+    GetCandidates(*query_nodes[i], &node_page_ids);
+    IntersectPageIDs(node_page_ids, &page_ids);
+  }
+
+  // Order the candidates in the time range as TextDatabase does: most recent
+  // first, then by descending ID, as times may not be unique.
+  int64 begin_time = options.EffectiveBeginTime();
+  int64 end_time = options.EffectiveEndTime();
+  std::vector<std::pair<int64, PageID> > candidates;
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    PageMap::const_iterator page = pages_.find(page_ids[i]);
+    if (page == pages_.end())
+      continue;  // Deleted.
+    int64 time = page->second.time;
+    if (time < begin_time)
+      continue;
+    if (time < end_time ||
+        (!options.cursor.empty() && time == end_time &&
+         page_ids[i] < options.cursor.rowid_)) {
+      candidates.push_back(std::make_pair(time, page_ids[i]));
+    }
+  }
+  std::sort(candidates.rbegin(), candidates.rend());
+
+  // |results| may not be initially empty, so keep track of how many were added
+  // by this call.
+  int result_count = 0;
+
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const Page& page = pages_[candidates[i].second];
+    GURL url(page.url);
+    if (found_urls->find(url) != found_urls->end())
+      continue;  // Don't add this duplicate.
+
+    // Only the candidates which get this far are read from disk.
+    std::string title;
+    std::string body;
+    if (!ReadPageText(page, &title, &body))
+      continue;
+
+    TextDatabase::Match match;
+    if (!MatchPage(page, title, body, query_nodes, options.body_only, &match))
+      continue;
+
+    if (options.max_count > 0 && ++result_count > options.max_count)
+      break;
+
+    match.rowid = candidates[i].second;
+    match.url.Swap(&url);
+    match.time = base::Time::FromInternalValue(page.time);
+    results->push_back(match);
+  }
+  return result_count > options.max_count;
+}
+
+void TextIndex::GetAllPageData(std::vector<TextDatabase::PageData>* pages) {
+  for (PageTimeMap::const_iterator it = page_times_.begin();
+       it != page_times_.end(); ++it) {
+    const Page& page = pages_[it->second];
+    TextDatabase::PageData data;
+    if (!ReadPageText(page, &data.title, &data.body))
+      continue;
+    data.time = base::Time::FromInternalValue(page.time);
+    data.url = page.url;
+    pages->push_back(data);
+  }
+}
+
+size_t TextIndex::GetPostingsSize() const {
+  size_t size = 0;
+  for (WordMap::const_iterator it = words_.begin(); it != words_.end(); ++it)
+    size += it->second.data.size();
+  return size;
+}
+
+void TextIndex::Reset() {
+  pages_.clear();
+  page_times_.clear();
+  words_.clear();
+  next_page_id_ = 1;
+  posting_count_ = 0;
+  deleted_posting_count_ = 0;
+  deleted_bytes_ = 0;
+  needs_rewrite_ = false;
+}
+
+bool TextIndex::StartPagesFile() {
+  generation_ = NewGeneration(generation_);
+  Pickle header = MakeHeader(generation_);
+  bool written = base::TruncatePlatformFile(pages_file_, 0) &&
+      WritePickle(pages_file_, 0, header);
+  pages_file_size_ = written ? static_cast<int64>(header.size()) : 0;
+  snapshot_pages_file_size_ = pages_file_size_;
+  file_util::Delete(file_path_, false);
+  return written;
+}
+
+void TextIndex::ReadSnapshot(int64 file_size) {
+  std::string contents;
+  if (!file_util::ReadFileToString(file_path_, &contents))
+    return;
+
+  Pickle pickle(contents.data(), static_cast<int>(contents.size()));
+  PickleIterator iter(pickle);
+  uint32 magic, version, next_page_id, page_count, word_count;
+  uint64 generation, posting_count, deleted_posting_count;
+  int64 pages_file_size, deleted_bytes;
+  if (!pickle.ReadUInt32(&iter, &magic) || magic != kIndexMagic ||
+      !pickle.ReadUInt32(&iter, &version) || version != kIndexVersion ||
+      !pickle.ReadUInt64(&iter, &generation) || generation != generation_ ||
+      !pickle.ReadInt64(&iter, &pages_file_size) ||
+      pages_file_size < pages_file_size_ || pages_file_size > file_size ||
+      !pickle.ReadUInt32(&iter, &next_page_id) ||
+      !pickle.ReadUInt64(&iter, &posting_count) ||
+      !pickle.ReadUInt64(&iter, &deleted_posting_count) ||
+      !pickle.ReadInt64(&iter, &deleted_bytes) ||
+      !pickle.ReadUInt32(&iter, &page_count))
+    return;
+
+  PageMap pages;
+  PageTimeMap page_times;
+  for (uint32 i = 0; i < page_count; ++i) {
+    PageID page_id;
+    Page page;
+    if (!pickle.ReadUInt32(&iter, &page_id) || page_id >= next_page_id ||
+        !pickle.ReadInt64(&iter, &page.time) ||
+        !pickle.ReadString(&iter, &page.url) ||
+        !pickle.ReadInt64(&iter, &page.offset) ||
+        !pickle.ReadUInt32(&iter, &page.size) ||
+        page.offset < pages_file_size_ ||
+        page.offset + page.size > pages_file_size ||
+        !pickle.ReadUInt32(&iter, &page.word_count))
+      return;
+    pages[page_id] = page;
+    page_times.insert(std::make_pair(page.time, page_id));
+  }
+
+  if (!pickle.ReadUInt32(&iter, &word_count))
+    return;
+  WordMap words;
+  for (uint32 i = 0; i < word_count; ++i) {
+    std::string word;
+    PostingList list;
+    if (!pickle.ReadString(&iter, &word) ||
+        !pickle.ReadUInt32(&iter, &list.last_page_id) ||
+        list.last_page_id >= next_page_id ||
+        !pickle.ReadString(&iter, &list.data))
+      return;
+    words[word].data.swap(list.data);
+    words[word].last_page_id = list.last_page_id;
+  }
+
+  pages_.swap(pages);
+  page_times_.swap(page_times);
+  words_.swap(words);
+  next_page_id_ = next_page_id;
+  posting_count_ = static_cast<size_t>(posting_count);
+  deleted_posting_count_ = static_cast<size_t>(deleted_posting_count);
+  deleted_bytes_ = deleted_bytes;
+  pages_file_size_ = pages_file_size;
+  snapshot_pages_file_size_ = pages_file_size;
+}
+
+void TextIndex::ReadPagesFile(int64 file_size) {
+  std::string data;
+  while (pages_file_size_ < file_size) {
+    uint32 size = ReadPickle(pages_file_, pages_file_size_, file_size, &data);
+    if (!size || !ReadRecord(data, size))
+      break;
+    pages_file_size_ += size;
+  }
+  if (pages_file_size_ < file_size) {
+    // Later records are appended after the last whole one. Should the rest
+    // stay, it is cut off the next time the index is read.
+    DLOG(WARNING) << "Cutting off a torn text index record";
+    base::TruncatePlatformFile(pages_file_, pages_file_size_);
+  }
+  CompactIfNecessary();
+}
+
+bool TextIndex::ReadRecord(const std::string& data, uint32 size) {
+  Pickle record(data.data(), size);
+  PickleIterator iter(record);
+  uint32 type;
+  PageID page_id;
+  if (!record.ReadUInt32(&iter, &type) ||
+      !record.ReadUInt32(&iter, &page_id))
+    return false;
+
+  if (type == RECORD_ADD_PAGE) {
+    int64 time;
+    std::string url, title, body;
+    if (page_id < next_page_id_ ||
+        !record.ReadInt64(&iter, &time) ||
+        !record.ReadString(&iter, &url) ||
+        !record.ReadString(&iter, &title) ||
+        !record.ReadString(&iter, &body))
+      return false;
+    next_page_id_ = page_id + 1;
+    IndexPage(page_id, time, url, title, body, pages_file_size_, size);
+    return true;
+  }
+
+  if (type == RECORD_DELETE_PAGE) {
+    PageMap::iterator page = pages_.find(page_id);
+    if (page != pages_.end()) {
+      std::pair<PageTimeMap::iterator, PageTimeMap::iterator> range =
+          page_times_.equal_range(page->second.time);
+      for (PageTimeMap::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == page_id) {
+          ForgetPage(it);
+          break;
+        }
+      }
+    }
+    deleted_bytes_ += size;
+    return true;
+  }
+
+  return false;
+}
+
+bool TextIndex::WriteSnapshot() {
+  Pickle pickle;
+  pickle.WriteUInt32(kIndexMagic);
+  pickle.WriteUInt32(kIndexVersion);
+  pickle.WriteUInt64(generation_);
+  pickle.WriteInt64(pages_file_size_);
+  pickle.WriteUInt32(next_page_id_);
+  pickle.WriteUInt64(posting_count_);
+  pickle.WriteUInt64(deleted_posting_count_);
+  pickle.WriteInt64(deleted_bytes_);
+
+  pickle.WriteUInt32(static_cast<uint32>(pages_.size()));
+  for (PageMap::const_iterator it = pages_.begin(); it != pages_.end(); ++it) {
+    pickle.WriteUInt32(it->first);
+    pickle.WriteInt64(it->second.time);
+    pickle.WriteString(it->second.url);
+    pickle.WriteInt64(it->second.offset);
+    pickle.WriteUInt32(it->second.size);
+    pickle.WriteUInt32(it->second.word_count);
+  }
+
+  pickle.WriteUInt32(static_cast<uint32>(words_.size()));
+  for (WordMap::const_iterator it = words_.begin(); it != words_.end(); ++it) {
+    pickle.WriteString(it->first);
+    pickle.WriteUInt32(it->second.last_page_id);
+    pickle.WriteString(it->second.data);
+  }
+
+  if (!base::ImportantFileWriter::WriteFileAtomically(
+          file_path_,
+          std::string(static_cast<const char*>(pickle.data()), pickle.size())))
+    return false;
+  snapshot_pages_file_size_ = pages_file_size_;
+  return true;
+}
+
+bool TextIndex::RewritePagesFile() {
+  FilePath pages_path = GetPagesFilePath(file_path_);
+  FilePath new_pages_path = pages_path.AddExtension(FILE_PATH_LITERAL("new"));
+  base::PlatformFile new_pages_file = base::CreatePlatformFile(
+      new_pages_path,
+      base::PLATFORM_FILE_CREATE_ALWAYS | base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (new_pages_file == base::kInvalidPlatformFileValue)
+    return false;
+
+  uint64 generation = NewGeneration(generation_);
+  Pickle header = MakeHeader(generation);
+  bool written = WritePickle(new_pages_file, 0, header);
+  int64 new_size = header.size();
+  std::vector<int64> new_offsets;
+  std::string data;
+  for (PageMap::const_iterator it = pages_.begin();
+       written && it != pages_.end(); ++it) {
+    const Page& page = it->second;
+    written =
+        ReadPickle(pages_file_, page.offset, pages_file_size_, &data) ==
+            page.size &&
+        base::WritePlatformFile(new_pages_file, new_size, data.data(),
+                                page.size) == static_cast<int>(page.size);
+    new_offsets.push_back(new_size);
+    new_size += page.size;
+  }
+  base::ClosePlatformFile(new_pages_file);
+
+  // The pages file can't be replaced while it is open on Windows.
+  bool replaced = false;
+  if (written) {
+    base::ClosePlatformFile(pages_file_);
+    replaced = file_util::ReplaceFile(new_pages_path, pages_path);
+    pages_file_ = base::CreatePlatformFile(
+        pages_path,
+        base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_READ |
+            base::PLATFORM_FILE_WRITE,
+        NULL, NULL);
+  }
+  if (!replaced) {
+    file_util::Delete(new_pages_path, false);
+    return false;
+  }
+
+  size_t i = 0;
+  for (PageMap::iterator it = pages_.begin(); it != pages_.end(); ++it)
+    it->second.offset = new_offsets[i++];
+  generation_ = generation;
+  pages_file_size_ = new_size;
+  deleted_bytes_ = 0;
+  needs_rewrite_ = false;
+  return WriteSnapshot();
+}
+
+bool TextIndex::AppendRecord(const Pickle& record) {
+  if (!WritePickle(pages_file_, pages_file_size_, record))
+    return false;
+  pages_file_size_ += record.size();
+  return true;
+}
+
+void TextIndex::IndexPage(PageID page_id,
+                          int64 time,
+                          const std::string& url,
+                          const std::string& title,
+                          const std::string& body,
+                          int64 offset,
+                          uint32 size) {
+  Page& page = pages_[page_id];
+  page.time = time;
+  page.url = url;
+  page.offset = offset;
+  page.size = size;
+  page_times_.insert(std::make_pair(time, page_id));
+
+  std::set<std::string> page_words;
+  const std::string* fields[] = { &url, &title, &body };
+  for (size_t i = 0; i < arraysize(fields); ++i) {
+    std::vector<QueryWord> words;
+    ExtractWords(&query_parser_, UTF8ToUTF16(*fields[i]), &words);
+    for (size_t j = 0; j < words.size(); ++j)
+      page_words.insert(UTF16ToUTF8(words[j].word));
+  }
+
+  for (std::set<std::string>::const_iterator it = page_words.begin();
+       it != page_words.end(); ++it) {
+    PostingList& list = words_[*it];
+    AppendVarint(page_id - list.last_page_id, &list.data);
+    list.last_page_id = page_id;
+  }
+  page.word_count = static_cast<uint32>(page_words.size());
+  posting_count_ += page_words.size();
+}
+
+bool TextIndex::ReadPageText(const Page& page,
+                             std::string* title,
+                             std::string* body) const {
+  std::string data;
+  if (ReadPickle(pages_file_, page.offset, pages_file_size_, &data) !=
+          page.size)
+    return false;
+  Pickle record(data.data(), page.size);
+  PickleIterator iter(record);
+  uint32 type;
+  PageID page_id;
+  int64 time;
+  std::string url;
+  return record.ReadUInt32(&iter, &type) && type == RECORD_ADD_PAGE &&
+      record.ReadUInt32(&iter, &page_id) &&
+      record.ReadInt64(&iter, &time) &&
+      record.ReadString(&iter, &url) &&
+      record.ReadString(&iter, title) &&
+      record.ReadString(&iter, body);
+}
+
+void TextIndex::DeletePage(PageTimeMap::iterator page_time) {
+  Pickle record;
+  record.WriteUInt32(RECORD_DELETE_PAGE);
+  record.WriteUInt32(page_time->second);
+  ForgetPage(page_time);
+  if (AppendRecord(record))
+    deleted_bytes_ += record.size();
+  else
+    needs_rewrite_ = true;  // Or the page would come back when it is read.
+}
+
+void TextIndex::ForgetPage(PageTimeMap::iterator page_time) {
+  PageMap::iterator page = pages_.find(page_time->second);
+  DCHECK(page != pages_.end());
+  deleted_posting_count_ += page->second.word_count;
+  deleted_bytes_ += page->second.size;
+  pages_.erase(page);
+  page_times_.erase(page_time);
+}
+
+void TextIndex::CompactPostings() {
+  if (!deleted_posting_count_)
+    return;
+
+  std::vector<PageID> page_ids;
+  size_t posting_count = 0;
+  for (WordMap::iterator it = words_.begin(); it != words_.end(); ) {
+    page_ids.clear();
+    AppendPageIDs(it->second.data, &page_ids);
+    PostingList list;
+    for (size_t i = 0; i < page_ids.size(); ++i) {
+      if (pages_.find(page_ids[i]) == pages_.end())
+        continue;
+      AppendVarint(page_ids[i] - list.last_page_id, &list.data);
+      list.last_page_id = page_ids[i];
+      ++posting_count;
+    }
+    if (list.data.empty()) {
+      words_.erase(it++);
+    } else {
+      it->second.data.swap(list.data);
+      it->second.last_page_id = list.last_page_id;
+      ++it;
+    }
+  }
+  posting_count_ = posting_count;
+  deleted_posting_count_ = 0;
+}
+
+void TextIndex::CompactIfNecessary() {
+  if (deleted_posting_count_ > posting_count_ / 4)
+    CompactPostings();
+}
+
+void TextIndex::GetCandidates(const QueryNode& node,
+                              std::vector<PageID>* page_ids) const {
+  page_ids->clear();
+  std::vector<string16> node_words;
+  node.AppendWords(&node_words);
+  if (node_words.empty())
+    return;
+
+  if (node.IsWord() &&
+      QueryParser::IsWordLongEnoughForPrefixSearch(node_words[0])) {
+    // The pages with any word starting with this one.
+    std::string prefix = UTF16ToUTF8(node_words[0]);
+    for (WordMap::const_iterator it = words_.lower_bound(prefix);
+         it != words_.end() &&
+             it->first.compare(0, prefix.size(), prefix) == 0;
+         ++it) {
+      AppendPageIDs(it->second.data, page_ids);
+    }
+    std::sort(page_ids->begin(), page_ids->end());
+    page_ids->erase(std::unique(page_ids->begin(), page_ids->end()),
+                    page_ids->end());
+    return;
+  }
+
+  // The pages with every word, exactly. For a phrase, MatchPage() checks
+  // that they are together.
+  for (size_t i = 0; i < node_words.size(); ++i) {
+    WordMap::const_iterator it = words_.find(UTF16ToUTF8(node_words[i]));
+    if (it == words_.end()) {
+      page_ids->clear();
+      return;
+    }
+    if (i == 0) {
+      AppendPageIDs(it->second.data, page_ids);
+    } else {
+      std::vector<PageID> word_page_ids;
+      AppendPageIDs(it->second.data, &word_page_ids);
+      IntersectPageIDs(word_page_ids, page_ids);
+    }
+  }
+}
+
+bool TextIndex::MatchPage(const Page& page,
+                          const std::string& page_title,
+                          const std::string& page_body,
+                          const std::vector<QueryNode*>& query_nodes,
+                          bool body_only,
+                          TextDatabase::Match* match) {
+  string16 title = UTF8ToUTF16(page_title);
+  string16 body = UTF8ToUTF16(page_body);
+  std::vector<QueryWord> url_words;
+  std::vector<QueryWord> title_words;
+  std::vector<QueryWord> body_words;
+  string16 lower_title;
+  string16 lower_body = ExtractWords(&query_parser_, body, &body_words);
+  if (!body_only) {
+    ExtractWords(&query_parser_, UTF8ToUTF16(page.url), &url_words);
+    lower_title = ExtractWords(&query_parser_, title, &title_words);
+  }
+
+  // As in an FTS table, each node must match within one of the columns.
+  Snippet::MatchPositions url_positions;
+  Snippet::MatchPositions title_positions;
+  Snippet::MatchPositions body_positions;
+  for (size_t i = 0; i < query_nodes.size(); ++i) {
+    bool matched = query_nodes[i]->HasMatchIn(body_words, &body_positions);
+    if (!body_only) {
+      if (query_nodes[i]->HasMatchIn(title_words, &title_positions))
+        matched = true;
+      if (query_nodes[i]->HasMatchIn(url_words, &url_positions))
+        matched = true;
+    }
+    if (!matched)
+      return false;
+  }
+
+  // The positions are meaningless in text which changed length when it was
+  // lower cased.
+  if (lower_title.length() == title.length())
+    SortAndCoalesceMatchPositions(&title_positions);
+  else
+    title_positions.clear();
+  if (lower_body.length() == body.length()) {
+    SortAndCoalesceMatchPositions(&body_positions);
+    ConvertMatchPositionsToUTF8(body, &body_positions);
+  } else {
+    body_positions.clear();
+  }
+
+  match->title.swap(title);
+  match->title_match_positions.swap(title_positions);
+  match->snippet.ComputeSnippet(body_positions, page_body);
+  return true;
+}
+
+}  // namespace history
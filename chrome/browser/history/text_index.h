@@ -0,0 +1,276 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_TEXT_INDEX_H_
+#define CHROME_BROWSER_HISTORY_TEXT_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/platform_file.h"
+#include "base/time.h"
+#include "chrome/browser/history/history_types.h"
+#include "chrome/browser/history/query_parser.h"
+#include "chrome/browser/history/text_database.h"
+
+class Pickle;
+
+namespace history {
+
+// A full-text index of the pages in history. TextDatabaseManager may use it in
+// place of the per-month TextDatabases, so that a search is one lookup rather
+// than a query of each month's FTS table.
+//
+// Pages are given ascending IDs as they are added. Every distinct word of the
+// URL, title and body of a page, lower cased and split as QueryParser splits
+// them, has a posting list of the IDs of the pages it occurs in, held as
+// variable length encoded deltas. As a new page has the highest ID yet, adding
+// it only appends to the posting lists of its words. The words are sorted, so
+// the words starting with a prefix are found with one lookup.
+//
+// Only the posting lists and the time, URL and place on disk of each page are
+// kept in memory. The text of the pages is appended to a pages file, a record
+// for each page added and each page deleted, and is read back from there when
+// a page is a candidate for a query. Now and then the posting lists and pages
+// are written to the index file, as a snapshot of the records so far, so that
+// only the records after it need to be indexed again when the index is read.
+//
+// A deleted page is dropped from memory at once, but its ID stays in the
+// posting lists, where it is skipped, until they are compacted. That happens
+// by itself once a quarter of the IDs in the lists are of deleted pages. Its
+// text stays in the pages file until Compact() rewrites it with only the pages
+// which are left.
+//
+// A query intersects the posting lists of its words, then checks the
+// candidates from the most recent back against the QueryNodes themselves, so
+// that phrases and body only queries match as they would in an FTS table, and
+// to find the match positions in the title and body.
+class TextIndex {
+ public:
+  typedef uint32 PageID;
+
+  TextIndex();
+  ~TextIndex();
+
+  // Returns the pages file kept beside the index file |file_path|.
+  static FilePath GetPagesFilePath(const FilePath& file_path);
+
+  // Returns true if there is an index at |file_path|.
+  static bool IndexExists(const FilePath& file_path);
+
+  // Deletes the index at |file_path|.
+  static void DeleteIndex(const FilePath& file_path);
+
+  // Opens the index at |file_path|, making a new one if there is none, and
+  // reads it. A torn record at the end of the pages file, such as one being
+  // written when the browser crashed, is cut off. Returns false, leaving the
+  // index empty, if the pages file can't be opened or isn't of the current
+  // version. Must be called before anything else.
+  bool Init(const FilePath& file_path);
+
+  // Writes a snapshot if enough has been added to the pages file since the
+  // last, or rewrites the pages file if a deletion couldn't be written. Each
+  // change is written to the pages file as it is made, so this needn't be
+  // called for them to be kept. Returns false if a write failed.
+  bool Flush();
+
+  // Changing operations -------------------------------------------------------
+
+  // Adds the given data to the index. As for TextDatabase::AddPageData(), the
+  // strings should already be converted to UTF-8. Returns false, adding
+  // nothing, if the page couldn't be written.
+  bool AddPageData(base::Time time,
+                   const std::string& url,
+                   const std::string& title,
+                   const std::string& contents);
+
+  // Deletes the indexed data exactly matching the given URL/time pair.
+  void DeletePageData(base::Time time, const std::string& url);
+
+  // Deletes the data of the pages visited in [begin, end). Either time may be
+  // null to be unbounded in that direction.
+  void DeletePageDataBetween(base::Time begin, base::Time end);
+
+  // Deletes everything.
+  void Clear();
+
+  // Removes the IDs of deleted pages from the posting lists, and the words
+  // which no longer occur in any page, then rewrites the pages file without
+  // the text of the deleted pages.
+  void Compact();
+
+  // Querying ------------------------------------------------------------------
+
+  // Finds the pages matching |query_nodes|, which should come from
+  // QueryParser::ParseQueryNodes(). Otherwise this is as
+  // TextDatabase::GetTextMatches(), and the rowid of each match is the ID of
+  // the page.
+  bool GetTextMatches(const std::vector<QueryNode*>& query_nodes,
+                      const QueryOptions& options,
+                      std::vector<TextDatabase::Match>* results,
+                      TextDatabase::URLSet* found_urls);
+
+  // Adds the data of every page to |pages|, oldest first.
+  void GetAllPageData(std::vector<TextDatabase::PageData>* pages);
+
+  size_t page_count() const { return pages_.size(); }
+  size_t word_count() const { return words_.size(); }
+
+  // Returns the number of bytes taken by the posting lists.
+  size_t GetPostingsSize() const;
+
+ private:
+  struct Page {
+    Page();
+    ~Page();
+
+    int64 time;
+    std::string url;
+
+    // Where the record of the page is in the pages file.
+    int64 offset;
+    uint32 size;
+
+    // The number of distinct words of the page, which is the number of
+    // posting lists it is in.
+    uint32 word_count;
+  };
+
+  struct PostingList {
+    PostingList();
+    ~PostingList();
+
+    // The deltas between ascending page IDs.
+    std::string data;
+
+    // The last ID in the list, which the next is a delta from.
+    PageID last_page_id;
+  };
+
+  typedef std::map<PageID, Page> PageMap;
+  typedef std::multimap<int64, PageID> PageTimeMap;
+  typedef std::map<std::string, PostingList> WordMap;
+
+  // Empties the index, without changing its files.
+  void Reset();
+
+  // Empties the pages file and writes its header, with a new generation, and
+  // deletes the snapshot, which no longer matches it.
+  bool StartPagesFile();
+
+  // Reads the snapshot into the index if it is of the pages file as it is,
+  // which is |file_size| long.
+  void ReadSnapshot(int64 file_size);
+
+  // Indexes the records of the pages file after the snapshot, up to
+  // |file_size|, and cuts off any which are torn.
+  void ReadPagesFile(int64 file_size);
+
+  // Indexes the record of |size| bytes in |data|, which is at the end of the
+  // pages file. Returns false if it isn't valid.
+  bool ReadRecord(const std::string& data, uint32 size);
+
+  // Writes the snapshot. Returns true on success.
+  bool WriteSnapshot();
+
+  // Writes the pages which are left to a new pages file, with a new
+  // generation, replaces the old one with it and writes a snapshot. Returns
+  // true on success.
+  bool RewritePagesFile();
+
+  // Appends |record| to the pages file. Returns true on success.
+  bool AppendRecord(const Pickle& record);
+
+  // Adds the page with |page_id|, whose record of |size| bytes is at |offset|
+  // in the pages file, to the posting lists of its words.
+  void IndexPage(PageID page_id,
+                 int64 time,
+                 const std::string& url,
+                 const std::string& title,
+                 const std::string& body,
+                 int64 offset,
+                 uint32 size);
+
+  // Reads the title and body of |page| from the pages file. Returns false if
+  // they can't be read.
+  bool ReadPageText(const Page& page,
+                    std::string* title,
+                    std::string* body) const;
+
+  // Removes the page |page_time| refers to, and writes a record of its
+  // deletion.
+  void DeletePage(PageTimeMap::iterator page_time);
+
+  // Removes the page |page_time| refers to from |pages_| and |page_times_|.
+  void ForgetPage(PageTimeMap::iterator page_time);
+
+  // Removes the IDs of deleted pages from the posting lists.
+  void CompactPostings();
+
+  // Compacts the posting lists if enough of the IDs in them are of deleted
+  // pages.
+  void CompactIfNecessary();
+
+  // Sets |page_ids| to the ascending IDs of the pages which have the words of
+  // |node|. Any of those pages may still not match |node|, such as when the
+  // words of a phrase are not together.
+  void GetCandidates(const QueryNode& node,
+                     std::vector<PageID>* page_ids) const;
+
+  // Returns true if |page|, with the given title and body, matches every one
+  // of |query_nodes|, filling in the title match positions and snippet of
+  // |match| if so.
+  bool MatchPage(const Page& page,
+                 const std::string& page_title,
+                 const std::string& page_body,
+                 const std::vector<QueryNode*>& query_nodes,
+                 bool body_only,
+                 TextDatabase::Match* match);
+
+  // The index file, which holds the snapshot.
+  FilePath file_path_;
+
+  base::PlatformFile pages_file_;
+
+  // Changes each time the pages file is started or rewritten, so that a
+  // snapshot of an older one is ignored.
+  uint64 generation_;
+
+  // The length of the pages file, and the length of it which the snapshot
+  // covers.
+  int64 pages_file_size_;
+  int64 snapshot_pages_file_size_;
+
+  // The bytes of the pages file which are of deleted pages.
+  int64 deleted_bytes_;
+
+  // Set when a deletion couldn't be written, so that the pages file must be
+  // rewritten.
+  bool needs_rewrite_;
+
+  PageMap pages_;
+
+  // The IDs of the pages by the time they were visited.
+  PageTimeMap page_times_;
+
+  WordMap words_;
+
+  PageID next_page_id_;
+
+  // The number of entries in the posting lists, and of those which are of
+  // deleted pages.
+  size_t posting_count_;
+  size_t deleted_posting_count_;
+
+  QueryParser query_parser_;
+
+  DISALLOW_COPY_AND_ASSIGN(TextIndex);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_TEXT_INDEX_H_
@@ -0,0 +1,312 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/text_index.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Time;
+
+namespace history {
+
+namespace {
+
+const char kURL1[] = "http://www.google.com/";
+const int kTime1 = 1000;
+const char kTitle1[] = "Google";
+const char kBody1[] =
+    "COUNTTAG Web Images Maps News Shopping Gmail more My Account | "
+    "Sign out Advanced Search Preferences Language Tools Advertising Programs "
+    "- Business Solutions - About Google, 2008 Google";
+
+const char kURL2[] = "http://images.google.com/";
+const int kTime2 = 2000;
+const char kTitle2[] = "Google Image Search";
+const char kBody2[] =
+    "COUNTTAG Web Images Maps News Shopping Gmail more My Account | "
+    "Sign out Advanced Image Search Preferences The most comprehensive image "
+    "search on the web. Want to help improve Google Image Search? Try Google "
+    "Image Labeler. Advertising Programs - Business Solutions - About Google "
+    "2008 Google";
+
+const char kURL3[] = "http://slashdot.org/";
+const int kTime3 = 3000;
+const char kTitle3[] = "Slashdot: News for nerds, stuff that matters";
+const char kBody3[] =
+    "COUNTTAG Slashdot Log In Create Account Subscribe Firehose Why "
+    "Log In? Why Subscribe? Nickname Password Public Terminal Sections "
+    "Main Apple AskSlashdot Backslash Books Developers Games Hardware "
+    "Interviews IT Linux Mobile Politics Science YRO";
+
+void AddAllTestData(TextIndex* index) {
+  index->AddPageData(Time::FromInternalValue(kTime1), kURL1, kTitle1, kBody1);
+  index->AddPageData(Time::FromInternalValue(kTime2), kURL2, kTitle2, kBody2);
+  index->AddPageData(Time::FromInternalValue(kTime3), kURL3, kTitle3, kBody3);
+}
+
+// Returns the URLs matching |query|, most recent first.
+std::vector<std::string> Query(TextIndex* index,
+                               const std::string& query,
+                               const QueryOptions& options) {
+  QueryParser parser;
+  ScopedVector<QueryNode> query_nodes;
+  parser.ParseQueryNodes(UTF8ToUTF16(query), &query_nodes.get());
+  std::vector<TextDatabase::Match> results;
+  TextDatabase::URLSet unique_urls;
+  index->GetTextMatches(query_nodes.get(), options, &results, &unique_urls);
+  std::vector<std::string> urls;
+  for (size_t i = 0; i < results.size(); ++i)
+    urls.push_back(results[i].url.spec());
+  return urls;
+}
+
+std::vector<std::string> Query(TextIndex* index, const std::string& query) {
+  return Query(index, query, QueryOptions());
+}
+
+std::vector<std::string> URLs(const char* url1,
+                              const char* url2 = NULL,
+                              const char* url3 = NULL) {
+  std::vector<std::string> urls(1, GURL(url1).spec());
+  if (url2)
+    urls.push_back(GURL(url2).spec());
+  if (url3)
+    urls.push_back(GURL(url3).spec());
+  return urls;
+}
+
+}  // namespace
+
+class TextIndexTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    file_path_ = temp_dir_.path().AppendASCII("index");
+    Reopen();
+  }
+
+  // Makes a new index of the files of the old one.
+  void Reopen() {
+    index_.reset(new TextIndex);
+    ASSERT_TRUE(index_->Init(file_path_));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  FilePath file_path_;
+  scoped_ptr<TextIndex> index_;
+};
+
+TEST_F(TextIndexTest, Query) {
+  AddAllTestData(index_.get());
+  EXPECT_EQ(3U, index_->page_count());
+
+  // Every page, most recent first.
+  EXPECT_EQ(URLs(kURL3, kURL2, kURL1), Query(index_.get(), "COUNTTAG"));
+
+  // Every word must match, in any column.
+  EXPECT_EQ(URLs(kURL2, kURL1), Query(index_.get(), "google shopping"));
+  EXPECT_EQ(URLs(kURL3), Query(index_.get(), "slashdot nerds"));
+  EXPECT_TRUE(Query(index_.get(), "slashdot shopping").empty());
+  EXPECT_TRUE(Query(index_.get(), "nonexistent").empty());
+  EXPECT_TRUE(Query(index_.get(), "").empty());
+
+  // Long enough words match as prefixes, short ones don't.
+  EXPECT_EQ(URLs(kURL2), Query(index_.get(), "compreh"));
+  EXPECT_EQ(URLs(kURL3), Query(index_.get(), "askslash"));
+  EXPECT_TRUE(Query(index_.get(), "m").empty());
+  EXPECT_EQ(URLs(kURL3), Query(index_.get(), "in"));
+
+  // The words of a phrase must be together, and exact.
+  EXPECT_EQ(URLs(kURL2), Query(index_.get(), "\"image search\""));
+  EXPECT_EQ(URLs(kURL3), Query(index_.get(), "\"log in\""));
+  EXPECT_TRUE(Query(index_.get(), "\"search image\"").empty());
+  EXPECT_TRUE(Query(index_.get(), "\"imag search\"").empty());
+}
+
+TEST_F(TextIndexTest, QueryOptions) {
+  AddAllTestData(index_.get());
+
+  // Time range, with the end excluded.
+  QueryOptions options;
+  options.begin_time = Time::FromInternalValue(kTime1 + 1);
+  options.end_time = Time::FromInternalValue(kTime3);
+  EXPECT_EQ(URLs(kURL2), Query(index_.get(), "COUNTTAG", options));
+
+  // Maximum count.
+  options = QueryOptions();
+  options.max_count = 2;
+  EXPECT_EQ(URLs(kURL3, kURL2), Query(index_.get(), "COUNTTAG", options));
+
+  // "Nerds" is only in the title of the third page, "Slashdot" is in its URL,
+  // title and body.
+  options = QueryOptions();
+  options.body_only = true;
+  EXPECT_EQ(URLs(kURL3), Query(index_.get(), "slashdot", options));
+  EXPECT_TRUE(Query(index_.get(), "nerds", options).empty());
+  options.body_only = false;
+  EXPECT_EQ(URLs(kURL3), Query(index_.get(), "nerds", options));
+}
+
+TEST_F(TextIndexTest, MatchPositions) {
+  index_->AddPageData(Time::FromInternalValue(kTime1), kURL1,
+                    "Title with \xC3\xA9t\xC3\xA9 here",
+                    "Body with \xE2\x82\xAC and \xC3\xA9t\xC3\xA9 in it");
+
+  QueryParser parser;
+  ScopedVector<QueryNode> query_nodes;
+  parser.ParseQueryNodes(UTF8ToUTF16("\xC3\xA9t\xC3\xA9"), &query_nodes.get());
+  std::vector<TextDatabase::Match> results;
+  TextDatabase::URLSet unique_urls;
+  index_->GetTextMatches(query_nodes.get(), QueryOptions(), &results,
+                       &unique_urls);
+  ASSERT_EQ(1U, results.size());
+  EXPECT_EQ(Time::FromInternalValue(kTime1), results[0].time);
+
+  // Title positions are in UTF-16.
+  ASSERT_EQ(1U, results[0].title_match_positions.size());
+  EXPECT_EQ(11U, results[0].title_match_positions[0].first);
+  EXPECT_EQ(14U, results[0].title_match_positions[0].second);
+
+  // The snippet has the whole body, with the word marked.
+  EXPECT_EQ(UTF8ToUTF16("Body with \xE2\x82\xAC and \xC3\xA9t\xC3\xA9 in it"),
+            results[0].snippet.text());
+  ASSERT_EQ(1U, results[0].snippet.matches().size());
+  EXPECT_EQ(16U, results[0].snippet.matches()[0].first);
+  EXPECT_EQ(19U, results[0].snippet.matches()[0].second);
+}
+
+TEST_F(TextIndexTest, Delete) {
+  AddAllTestData(index_.get());
+  size_t word_count = index_->word_count();
+
+  // Only the exact URL and time pair is deleted.
+  index_->DeletePageData(Time::FromInternalValue(kTime1), kURL2);
+  index_->DeletePageData(Time::FromInternalValue(kTime2), kURL1);
+  EXPECT_EQ(3U, index_->page_count());
+  index_->DeletePageData(Time::FromInternalValue(kTime2), kURL2);
+  EXPECT_EQ(2U, index_->page_count());
+  EXPECT_EQ(URLs(kURL3, kURL1), Query(index_.get(), "COUNTTAG"));
+  EXPECT_TRUE(Query(index_.get(), "comprehensive").empty());
+
+  // Compacting drops the words only the deleted page had.
+  index_->Compact();
+  EXPECT_GT(word_count, index_->word_count());
+  EXPECT_EQ(URLs(kURL3, kURL1), Query(index_.get(), "COUNTTAG"));
+  EXPECT_TRUE(Query(index_.get(), "comprehensive").empty());
+
+  // Pages added later are still found.
+  index_->AddPageData(Time::FromInternalValue(kTime2), kURL2, kTitle2, kBody2);
+  EXPECT_EQ(URLs(kURL3, kURL2, kURL1), Query(index_.get(), "COUNTTAG"));
+
+  // Time ranges.
+  index_->DeletePageDataBetween(Time::FromInternalValue(kTime2), Time());
+  EXPECT_EQ(URLs(kURL1), Query(index_.get(), "COUNTTAG"));
+  index_->DeletePageDataBetween(Time(), Time::FromInternalValue(kTime1));
+  EXPECT_EQ(URLs(kURL1), Query(index_.get(), "COUNTTAG"));
+  index_->DeletePageDataBetween(Time(), Time::FromInternalValue(kTime1 + 1));
+  EXPECT_TRUE(Query(index_.get(), "COUNTTAG").empty());
+  EXPECT_EQ(0U, index_->page_count());
+  EXPECT_EQ(0U, index_->word_count());
+}
+
+TEST_F(TextIndexTest, Reopen) {
+  AddAllTestData(index_.get());
+  index_->DeletePageData(Time::FromInternalValue(kTime2), kURL2);
+
+  // The changes were written as they were made.
+  Reopen();
+  EXPECT_EQ(2U, index_->page_count());
+  EXPECT_EQ(URLs(kURL3, kURL1), Query(index_.get(), "COUNTTAG"));
+  EXPECT_TRUE(Query(index_.get(), "comprehensive").empty());
+  index_->AddPageData(Time::FromInternalValue(kTime2), kURL2, kTitle2, kBody2);
+  EXPECT_EQ(URLs(kURL3, kURL2, kURL1), Query(index_.get(), "COUNTTAG"));
+
+  std::vector<TextDatabase::PageData> pages;
+  index_->GetAllPageData(&pages);
+  ASSERT_EQ(3U, pages.size());
+  EXPECT_EQ(Time::FromInternalValue(kTime1), pages[0].time);
+  EXPECT_EQ(kURL1, pages[0].url);
+  EXPECT_EQ(kTitle1, pages[0].title);
+  EXPECT_EQ(kBody1, pages[0].body);
+  EXPECT_EQ(kURL2, pages[1].url);
+  EXPECT_EQ(kURL3, pages[2].url);
+
+  // Everything is gone for good once cleared.
+  index_->Clear();
+  EXPECT_EQ(0U, index_->page_count());
+  Reopen();
+  EXPECT_EQ(0U, index_->page_count());
+  EXPECT_TRUE(Query(index_.get(), "COUNTTAG").empty());
+}
+
+// Compacting drops the text of deleted pages from the pages file, and writes
+// a snapshot, after which later records are still read.
+TEST_F(TextIndexTest, Compact) {
+  AddAllTestData(index_.get());
+  FilePath pages_path = TextIndex::GetPagesFilePath(file_path_);
+  int64 pages_size;
+  ASSERT_TRUE(file_util::GetFileSize(pages_path, &pages_size));
+  EXPECT_FALSE(file_util::PathExists(file_path_));
+
+  index_->DeletePageData(Time::FromInternalValue(kTime2), kURL2);
+  index_->Compact();
+  int64 compact_pages_size;
+  ASSERT_TRUE(file_util::GetFileSize(pages_path, &compact_pages_size));
+  EXPECT_GT(pages_size - static_cast<int64>(sizeof(kBody2) - 1),
+            compact_pages_size);
+  EXPECT_TRUE(file_util::PathExists(file_path_));
+  index_->AddPageData(Time::FromInternalValue(kTime2), kURL2, kTitle2, kBody2);
+
+  Reopen();
+  EXPECT_EQ(3U, index_->page_count());
+  EXPECT_EQ(URLs(kURL3, kURL2, kURL1), Query(index_.get(), "COUNTTAG"));
+  EXPECT_EQ(URLs(kURL2), Query(index_.get(), "comprehensive"));
+}
+
+// A record torn by a crash is cut off, and the records after it are appended
+// in its place.
+TEST_F(TextIndexTest, TornRecord) {
+  AddAllTestData(index_.get());
+  index_.reset();
+
+  FilePath pages_path = TextIndex::GetPagesFilePath(file_path_);
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(pages_path, &contents));
+  contents.resize(contents.size() - 3);
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            file_util::WriteFile(pages_path, contents.data(),
+                                 static_cast<int>(contents.size())));
+
+  Reopen();
+  EXPECT_EQ(URLs(kURL2, kURL1), Query(index_.get(), "COUNTTAG"));
+  index_->AddPageData(Time::FromInternalValue(kTime3), kURL3, kTitle3, kBody3);
+  Reopen();
+  EXPECT_EQ(URLs(kURL3, kURL2, kURL1), Query(index_.get(), "COUNTTAG"));
+}
+
+TEST_F(TextIndexTest, DamagedHeader) {
+  AddAllTestData(index_.get());
+  index_.reset();
+
+  FilePath pages_path = TextIndex::GetPagesFilePath(file_path_);
+  ASSERT_EQ(3, file_util::WriteFile(pages_path, "bad", 3));
+  TextIndex index;
+  EXPECT_FALSE(index.Init(file_path_));
+  EXPECT_EQ(0U, index.page_count());
+
+  EXPECT_TRUE(TextIndex::IndexExists(file_path_));
+  TextIndex::DeleteIndex(file_path_);
+  EXPECT_FALSE(TextIndex::IndexExists(file_path_));
+}
+
+}  // namespace history
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/command_line.h"
 #include "base/file_util.h"
 #include "base/i18n/case_conversion.h"
 #include "base/metrics/histogram.h"
@@ -23,6 +24,7 @@
 #include "chrome/browser/autocomplete/url_prefix.h"
 #include "chrome/browser/history/history_database.h"
 #include "chrome/browser/history/in_memory_url_index.h"
+#include "chrome/common/chrome_switches.h"
 #include "content/public/browser/browser_thread.h"
 #include "content/public/browser/notification_details.h"
 #include "content/public/browser/notification_service.h"
@@ -61,6 +63,34 @@ typedef imui::InMemoryURLIndexCacheItem_WordStartsMapItem_WordStartsMapEntry
 
 // Algorithm Functions ---------------------------------------------------------
 
+namespace {
+
+// The compact index is rebuilt once the items updated since it was built are
+// more than this, and more than a quarter of those in it.
+const size_t kMinRecompactionCount = 1000;
+
+// Approximates the heap used by a node of a std::map or std::set holding a
+// value of |value_size| bytes: the value, three links and a color, rounded up
+// the way malloc does.
+size_t TreeNodeSize(size_t value_size) {
+  return (value_size + 4 * sizeof(void*) + 15) & ~static_cast<size_t>(15);
+}
+
+// Approximates the heap used by |map|, whose values are sets of IDs.
+template<typename MapType>
+size_t MapOfSetsMemoryUsage(const MapType& map) {
+  typedef typename MapType::mapped_type::value_type ID;
+  size_t usage = 0;
+  for (typename MapType::const_iterator it = map.begin(); it != map.end();
+       ++it) {
+    usage += TreeNodeSize(sizeof(typename MapType::value_type));
+    usage += it->second.size() * TreeNodeSize(sizeof(ID));
+  }
+  return usage;
+}
+
+}  // namespace
+
 // Comparison function for sorting search terms by descending length.
 bool LengthGreater(const string16& string_a, const string16& string_b) {
   return string_a.length() > string_b.length();
@@ -79,6 +109,18 @@ URLIndexPrivateData::URLIndexPrivateData()
 ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
     const string16& search_string,
     BookmarkService* bookmark_service) {
+  scoped_refptr<HistoryScoringJob> scoring_job(
+      ScoringJobForTerms(search_string, bookmark_service));
+  if (!scoring_job.get())
+    return ScoredHistoryMatches();
+  ScoredHistoryMatches scored_items = scoring_job->Score();
+  RecordScoredItemCount(scored_items.size());
+  return scored_items;
+}
+
+scoped_refptr<HistoryScoringJob> URLIndexPrivateData::ScoringJobForTerms(
+    const string16& search_string,
+    BookmarkService* bookmark_service) {
   pre_filter_item_count_ = 0;
   post_filter_item_count_ = 0;
   post_scoring_item_count_ = 0;
@@ -95,13 +137,12 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // four 'words': "colspec", "id", "mstone" and "release".
   String16Vector lower_words(
       history::String16VectorFromString16(lower_unescaped_string, false, NULL));
-  ScoredHistoryMatches scored_items;
 
   // Do nothing if we have indexed no words (probably because we've not been
   // initialized yet) or the search string has no words.
-  if (word_list_.empty() || lower_words.empty()) {
+  if (Empty() || lower_words.empty()) {
     search_term_cache_.clear();  // Invalidate the term cache.
-    return scored_items;
+    return NULL;
   }
 
   // Reset used_ flags for search_term_cache_. We use a basic mark-and-sweep
@@ -126,8 +167,7 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
               std::back_inserter(history_ids));
     // Trim down the set by sorting by typed-count, visit-count, and last
     // visit.
-    HistoryItemFactorGreater
-        item_factor_functor(history_info_map_);
+    HistoryItemFactorGreater item_factor_functor(*this);
     std::partial_sort(history_ids.begin(),
                       history_ids.begin() + kItemsToScoreLimit,
                       history_ids.end(),
@@ -138,8 +178,8 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
     post_filter_item_count_ = history_id_set.size();
   }
 
-  // Pass over all of the candidates filtering out any without a proper
-  // substring match, inserting those which pass in order by score. Note that
+  // The candidates are scored by the job, which filters out any without a
+  // proper substring match and keeps the top kMaxMatches by score. Note that
   // in this step we are using the raw search string complete with escaped
   // URL elements. When the user has specifically typed something akin to
   // "sort=pri&colspec=ID%20Mstone%20Release" we want to make sure that that
@@ -151,23 +191,11 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // get two 'terms': "colspec=id%20mstone" and "release".
   history::String16Vector lower_raw_terms;
   Tokenize(lower_raw_string, kWhitespaceUTF16, &lower_raw_terms);
-  scored_items = std::for_each(history_id_set.begin(), history_id_set.end(),
-      AddHistoryMatch(*this, bookmark_service, lower_raw_string,
-                      lower_raw_terms, base::Time::Now())).ScoredMatches();
-
-  // Select and sort only the top kMaxMatches results.
-  if (scored_items.size() > AutocompleteProvider::kMaxMatches) {
-    std::partial_sort(scored_items.begin(),
-                      scored_items.begin() +
-                          AutocompleteProvider::kMaxMatches,
-                      scored_items.end(),
-                      ScoredHistoryMatch::MatchScoreGreater);
-      scored_items.resize(AutocompleteProvider::kMaxMatches);
-  } else {
-    std::sort(scored_items.begin(), scored_items.end(),
-              ScoredHistoryMatch::MatchScoreGreater);
-  }
-  post_scoring_item_count_ = scored_items.size();
+  scoped_refptr<HistoryScoringJob> scoring_job(new HistoryScoringJob(
+      lower_raw_string, lower_raw_terms, base::Time::Now(), bookmark_service,
+      AutocompleteProvider::kMaxMatches, this));
+  std::for_each(history_id_set.begin(), history_id_set.end(),
+                AddHistoryMatch(*this, scoring_job));
 
   if (was_trimmed) {
     search_term_cache_.clear();  // Invalidate the term cache.
@@ -182,7 +210,11 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
     }
   }
 
-  return scored_items;
+  return scoring_job;
+}
+
+void URLIndexPrivateData::RecordScoredItemCount(size_t count) {
+  post_scoring_item_count_ = count;
 }
 
 bool URLIndexPrivateData::UpdateURL(
@@ -196,6 +228,10 @@ bool URLIndexPrivateData::UpdateURL(
   bool row_was_updated = false;
   URLID row_id = row.id();
   HistoryInfoMap::iterator row_pos = history_info_map_.find(row_id);
+  if (row_pos == history_info_map_.end() && IsInCompactIndex(row_id)) {
+    MoveCompactRowToMaps(row_id, languages);
+    row_pos = history_info_map_.find(row_id);
+  }
   if (row_pos == history_info_map_.end()) {
     // This new row should be indexed if it qualifies.
     URLRow new_row(row);
@@ -257,21 +293,26 @@ bool URLIndexPrivateData::DeleteURL(const GURL& url) {
       history_info_map_.begin(),
       history_info_map_.end(),
       HistoryInfoMapItemHasURL(url));
-  if (pos == history_info_map_.end())
-    return false;
-  RemoveRowFromIndex(pos->second);
+  if (pos != history_info_map_.end()) {
+    RemoveRowFromIndex(pos->second);
+  } else {
+    // Look for the item among those compacted, which is only hidden there.
+    HistoryID history_id = 0;
+    size_t row_count = compact_index_.get() ? compact_index_->row_count() : 0;
+    const std::string& spec = url.spec();
+    for (size_t i = 0; i < row_count && !history_id; ++i) {
+      if (compact_index_->url_spec_at(i) == spec &&
+          IsInCompactIndex(compact_index_->history_id_at(i)))
+        history_id = compact_index_->history_id_at(i);
+    }
+    if (!history_id)
+      return false;
+    compact_hidden_ids_.insert(history_id);
+  }
   search_term_cache_.clear();  // This invalidates the cache.
   return true;
 }
 
-// static
-void URLIndexPrivateData::RestoreFromFileTask(
-    const FilePath& file_path,
-    scoped_refptr<URLIndexPrivateData> private_data,
-    const std::string& languages) {
-  private_data = URLIndexPrivateData::RestoreFromFile(file_path, languages);
-}
-
 // static
 scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::RebuildFromHistory(
     HistoryDatabase* history_db,
@@ -298,6 +339,9 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::RebuildFromHistory(
                              rebuilt_data->word_map_.size());
   UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLChars",
                              rebuilt_data->char_word_map_.size());
+  if (CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableCompactHistoryIndex))
+    rebuilt_data->Compact();
   return rebuilt_data;
 }
 
@@ -320,6 +364,9 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::Duplicate() const {
   data_copy->history_id_word_map_ = history_id_word_map_;
   data_copy->history_info_map_ = history_info_map_;
   data_copy->word_starts_map_ = word_starts_map_;
+  // The compact index is immutable, so the copy can share it.
+  data_copy->compact_index_ = compact_index_;
+  data_copy->compact_hidden_ids_ = compact_hidden_ids_;
   return data_copy;
   // Not copied:
   //    search_term_cache_
@@ -329,7 +376,9 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::Duplicate() const {
 };
 
 bool URLIndexPrivateData::Empty() const {
-  return history_info_map_.empty();
+  return history_info_map_.empty() &&
+      (!compact_index_.get() ||
+       compact_index_->row_count() == compact_hidden_ids_.size());
 }
 
 void URLIndexPrivateData::Clear() {
@@ -341,6 +390,65 @@ void URLIndexPrivateData::Clear() {
   history_id_word_map_.clear();
   history_info_map_.clear();
   word_starts_map_.clear();
+  compact_index_ = NULL;
+  compact_hidden_ids_.clear();
+}
+
+size_t URLIndexPrivateData::EstimateMemoryUsage() const {
+  size_t usage = word_list_.capacity() * sizeof(string16);
+  for (String16Vector::const_iterator it = word_list_.begin();
+       it != word_list_.end(); ++it)
+    usage += it->capacity() * sizeof(char16);
+  usage += available_words_.size() * TreeNodeSize(sizeof(WordID));
+  for (WordMap::const_iterator it = word_map_.begin(); it != word_map_.end();
+       ++it) {
+    usage += TreeNodeSize(sizeof(WordMap::value_type)) +
+        it->first.capacity() * sizeof(char16);
+  }
+  usage += MapOfSetsMemoryUsage(char_word_map_);
+  usage += MapOfSetsMemoryUsage(word_id_history_map_);
+  usage += MapOfSetsMemoryUsage(history_id_word_map_);
+  usage += history_info_map_.size() *
+      TreeNodeSize(sizeof(HistoryInfoMap::value_type));
+  for (WordStartsMap::const_iterator it = word_starts_map_.begin();
+       it != word_starts_map_.end(); ++it) {
+    usage += TreeNodeSize(sizeof(WordStartsMap::value_type)) +
+        it->second.url_word_starts_.capacity() * sizeof(size_t) +
+        it->second.title_word_starts_.capacity() * sizeof(size_t);
+  }
+  if (compact_index_.get())
+    usage += compact_index_->size();
+  usage += compact_hidden_ids_.size() * TreeNodeSize(sizeof(HistoryID));
+  return usage;
+}
+
+void URLIndexPrivateData::Compact() {
+  CompactURLIndex::Builder builder;
+  if (compact_index_.get())
+    builder.AddIndex(*compact_index_, compact_hidden_ids_);
+  for (WordIDHistoryMap::const_iterator it = word_id_history_map_.begin();
+       it != word_id_history_map_.end(); ++it) {
+    const string16& word = word_list_[it->first];
+    for (HistoryIDSet::const_iterator id = it->second.begin();
+         id != it->second.end(); ++id)
+      builder.AddWord(word, *id);
+  }
+  for (HistoryInfoMap::const_iterator it = history_info_map_.begin();
+       it != history_info_map_.end(); ++it)
+    builder.AddRow(it->second, word_starts_map_[it->first]);
+
+  scoped_refptr<CompactURLIndex> compact_index(builder.Build());
+  Clear();
+  compact_index_ = compact_index;
+  search_term_cache_.clear();  // The cached word IDs are no longer valid.
+}
+
+bool URLIndexPrivateData::NeedsRecompaction() const {
+  if (!compact_index_.get())
+    return false;
+  size_t updated_count = history_info_map_.size() + compact_hidden_ids_.size();
+  return updated_count > kMinRecompactionCount &&
+      updated_count > compact_index_->row_count() / 4;
 }
 
 // Private ---------------------------------------------------------------------
@@ -351,8 +459,10 @@ URLIndexPrivateData::~URLIndexPrivateData() {}
 
 URLIndexPrivateData::SearchTermCacheItem::SearchTermCacheItem(
     const WordIDSet& word_id_set,
+    const WordIDVector& compact_word_ids,
     const HistoryIDSet& history_id_set)
     : word_id_set_(word_id_set),
+      compact_word_ids_(compact_word_ids),
       history_id_set_(history_id_set),
       used_(true) {}
 
@@ -365,39 +475,41 @@ URLIndexPrivateData::SearchTermCacheItem::~SearchTermCacheItem() {}
 
 URLIndexPrivateData::AddHistoryMatch::AddHistoryMatch(
     const URLIndexPrivateData& private_data,
-    BookmarkService* bookmark_service,
-    const string16& lower_string,
-    const String16Vector& lower_terms,
-    const base::Time now)
+    HistoryScoringJob* scoring_job)
   : private_data_(private_data),
-    bookmark_service_(bookmark_service),
-    lower_string_(lower_string),
-    lower_terms_(lower_terms),
-    now_(now) {}
+    scoring_job_(scoring_job) {}
 
 URLIndexPrivateData::AddHistoryMatch::~AddHistoryMatch() {}
 
 void URLIndexPrivateData::AddHistoryMatch::operator()(
     const HistoryID history_id) {
-  HistoryInfoMap::const_iterator hist_pos =
+  // Rows in the maps are pointed to; the job keeps them from changing.
+  HistoryInfoMap::const_iterator row =
       private_data_.history_info_map_.find(history_id);
-  if (hist_pos != private_data_.history_info_map_.end()) {
-    const URLRow& hist_item = hist_pos->second;
-    WordStartsMap::const_iterator starts_pos =
+  if (row != private_data_.history_info_map_.end()) {
+    WordStartsMap::const_iterator word_starts =
         private_data_.word_starts_map_.find(history_id);
-    DCHECK(starts_pos != private_data_.word_starts_map_.end());
-    ScoredHistoryMatch match(hist_item, lower_string_, lower_terms_,
-                             starts_pos->second, now_, bookmark_service_);
-    if (match.raw_score > 0)
-      scored_matches_.push_back(match);
+    DCHECK(word_starts != private_data_.word_starts_map_.end());
+    scoring_job_->AddCandidate(&row->second, &word_starts->second);
+    return;
+  }
+  // Rows in the compact index are only read on demand, so must be copied.
+  URLRow hist_item;
+  if (private_data_.IsInCompactIndex(history_id) &&
+      private_data_.compact_index_->GetRow(history_id, &hist_item)) {
+    RowWordStarts word_starts;
+    bool has_word_starts =
+        private_data_.compact_index_->GetWordStarts(history_id, &word_starts);
+    DCHECK(has_word_starts);
+    scoring_job_->AddCandidateCopy(hist_item, word_starts);
   }
 }
 
 // URLIndexPrivateData::HistoryItemFactorGreater -------------------------------
 
 URLIndexPrivateData::HistoryItemFactorGreater::HistoryItemFactorGreater(
-    const HistoryInfoMap& history_info_map)
-    : history_info_map_(history_info_map) {
+    const URLIndexPrivateData& private_data)
+    : private_data_(private_data) {
 }
 
 URLIndexPrivateData::HistoryItemFactorGreater::~HistoryItemFactorGreater() {}
@@ -405,23 +517,23 @@ URLIndexPrivateData::HistoryItemFactorGreater::~HistoryItemFactorGreater() {}
 bool URLIndexPrivateData::HistoryItemFactorGreater::operator()(
     const HistoryID h1,
     const HistoryID h2) {
-  HistoryInfoMap::const_iterator entry1(history_info_map_.find(h1));
-  if (entry1 == history_info_map_.end())
+  int typed_count1, visit_count1, typed_count2, visit_count2;
+  base::Time last_visit1, last_visit2;
+  if (!private_data_.GetRowFactors(h1, &typed_count1, &visit_count1,
+                                   &last_visit1))
     return false;
-  HistoryInfoMap::const_iterator entry2(history_info_map_.find(h2));
-  if (entry2 == history_info_map_.end())
+  if (!private_data_.GetRowFactors(h2, &typed_count2, &visit_count2,
+                                   &last_visit2))
     return true;
-  const URLRow& r1(entry1->second);
-  const URLRow& r2(entry2->second);
   // First cut: typed count, visit count, recency.
   // TODO(mrossetti): This is too simplistic. Consider an approach which ranks
   // recently visited (within the last 12/24 hours) as highly important. Get
   // input from mpearson.
-  if (r1.typed_count() != r2.typed_count())
-    return (r1.typed_count() > r2.typed_count());
-  if (r1.visit_count() != r2.visit_count())
-    return (r1.visit_count() > r2.visit_count());
-  return (r1.last_visit() > r2.last_visit());
+  if (typed_count1 != typed_count2)
+    return (typed_count1 > typed_count2);
+  if (visit_count1 != visit_count2)
+    return (visit_count1 > visit_count2);
+  return (last_visit1 > last_visit2);
 }
 
 // Index Searching -------------------------------------------------------------
@@ -472,6 +584,7 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
 
   size_t term_length = term.length();
   WordIDSet word_id_set;
+  WordIDVector compact_word_ids;
   if (term_length > 1) {
     // See if this term or a prefix thereof is present in the cache.
     SearchTermCacheMap::iterator best_prefix(search_term_cache_.end());
@@ -504,6 +617,7 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
         return HistoryIDSet();
       }
       word_id_set = best_prefix->second.word_id_set_;
+      compact_word_ids = best_prefix->second.compact_word_ids_;
       prefix_chars = Char16SetFromString16(best_prefix->first);
       leftovers = term.substr(prefix_length);
     }
@@ -518,14 +632,18 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
     // Reduce the word set with any leftover, unprocessed characters.
     if (!unique_chars.empty()) {
       WordIDSet leftover_set(WordIDSetForTermChars(unique_chars));
+      WordIDVector compact_leftovers;
+      if (compact_index_.get())
+        compact_index_->GetWordIDsForChars(unique_chars, &compact_leftovers);
       // We might come up empty on the leftovers.
-      if (leftover_set.empty()) {
+      if (leftover_set.empty() && compact_leftovers.empty()) {
         search_term_cache_[term] = SearchTermCacheItem();
         return HistoryIDSet();
       }
       // Or there may not have been a prefix from which to start.
       if (prefix_chars.empty()) {
         word_id_set.swap(leftover_set);
+        compact_word_ids.swap(compact_leftovers);
       } else {
         WordIDSet new_word_id_set;
         std::set_intersection(word_id_set.begin(), word_id_set.end(),
@@ -533,6 +651,12 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
                               std::inserter(new_word_id_set,
                                             new_word_id_set.begin()));
         word_id_set.swap(new_word_id_set);
+        WordIDVector new_compact_word_ids;
+        std::set_intersection(compact_word_ids.begin(), compact_word_ids.end(),
+                              compact_leftovers.begin(),
+                              compact_leftovers.end(),
+                              std::back_inserter(new_compact_word_ids));
+        compact_word_ids.swap(new_compact_word_ids);
       }
     }
 
@@ -545,8 +669,18 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
       else
         ++word_set_iter;
     }
+    WordIDVector::iterator compact_end = compact_word_ids.begin();
+    for (WordIDVector::iterator word_iter = compact_word_ids.begin();
+         word_iter != compact_word_ids.end(); ++word_iter) {
+      if (compact_index_->WordContains(*word_iter, term))
+        *compact_end++ = *word_iter;
+    }
+    compact_word_ids.erase(compact_end, compact_word_ids.end());
   } else {
-    word_id_set = WordIDSetForTermChars(Char16SetFromString16(term));
+    Char16Set term_chars = Char16SetFromString16(term);
+    word_id_set = WordIDSetForTermChars(term_chars);
+    if (compact_index_.get())
+      compact_index_->GetWordIDsForChars(term_chars, &compact_word_ids);
   }
 
   // If any words resulted then we can compose a set of history IDs by unioning
@@ -564,11 +698,18 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
       }
     }
   }
+  if (!compact_word_ids.empty()) {
+    compact_index_->AddHistoryIDsForWords(compact_word_ids,
+                                          compact_hidden_ids_,
+                                          &history_id_set);
+  }
 
   // Record a new cache entry for this word if the term is longer than
   // a single character.
-  if (term_length > 1)
-    search_term_cache_[term] = SearchTermCacheItem(word_id_set, history_id_set);
+  if (term_length > 1) {
+    search_term_cache_[term] =
+        SearchTermCacheItem(word_id_set, compact_word_ids, history_id_set);
+  }
 
   return history_id_set;
 }
@@ -786,10 +927,86 @@ void URLIndexPrivateData::ResetSearchTermCache() {
     iter->second.used_ = false;
 }
 
+// Compact Index Support -------------------------------------------------------
+
+bool URLIndexPrivateData::GetRowFactors(HistoryID history_id,
+                                        int* typed_count,
+                                        int* visit_count,
+                                        base::Time* last_visit) const {
+  HistoryInfoMap::const_iterator pos = history_info_map_.find(history_id);
+  if (pos != history_info_map_.end()) {
+    *typed_count = pos->second.typed_count();
+    *visit_count = pos->second.visit_count();
+    *last_visit = pos->second.last_visit();
+    return true;
+  }
+  return IsInCompactIndex(history_id) &&
+      compact_index_->GetRowFactors(history_id, typed_count, visit_count,
+                                    last_visit);
+}
+
+bool URLIndexPrivateData::IsInCompactIndex(HistoryID history_id) const {
+  return compact_index_.get() &&
+      compact_hidden_ids_.find(history_id) == compact_hidden_ids_.end() &&
+      compact_index_->HasRow(history_id);
+}
+
+void URLIndexPrivateData::MoveCompactRowToMaps(HistoryID history_id,
+                                               const std::string& languages) {
+  DCHECK(IsInCompactIndex(history_id));
+  URLRow& row = history_info_map_[history_id];
+  compact_index_->GetRow(history_id, &row);
+  compact_index_->GetWordStarts(history_id, &word_starts_map_[history_id]);
+  // The word starts are already known; only the words need indexing.
+  AddRowWordsToIndex(row, NULL, languages);
+  compact_hidden_ids_.insert(history_id);
+}
+
+
+void URLIndexPrivateData::ExpandCompactIndex() {
+  if (!compact_index_.get())
+    return;
+  for (WordID word_id = 0; word_id < compact_index_->word_count(); ++word_id) {
+    string16 word = compact_index_->GetWord(word_id);
+    HistoryIDVector history_ids;
+    compact_index_->GetHistoryIDs(word_id, &history_ids);
+    for (HistoryIDVector::const_iterator it = history_ids.begin();
+         it != history_ids.end(); ++it) {
+      if (compact_hidden_ids_.find(*it) == compact_hidden_ids_.end())
+        AddWordToIndex(word, *it);
+    }
+  }
+  for (size_t i = 0; i < compact_index_->row_count(); ++i) {
+    HistoryID history_id = compact_index_->history_id_at(i);
+    if (compact_hidden_ids_.find(history_id) != compact_hidden_ids_.end())
+      continue;
+    history_info_map_[history_id] = compact_index_->GetRowAt(i);
+    word_starts_map_[history_id] = compact_index_->GetWordStartsAt(i);
+  }
+  compact_index_ = NULL;
+  compact_hidden_ids_.clear();
+  search_term_cache_.clear();
+}
+
 // Cache Saving ----------------------------------------------------------------
 
 bool URLIndexPrivateData::SaveToFile(const FilePath& file_path) {
   base::TimeTicks beginning_time = base::TimeTicks::Now();
+  // A compact index is saved as it is laid out in memory, so that it can be
+  // mapped back in without being parsed. This runs on a copy of the index, on
+  // the file thread, so folding in the recent updates first costs the main
+  // thread nothing.
+  if (IsCompact()) {
+    Compact();
+    if (!compact_index_->WriteToFile(file_path)) {
+      LOG(WARNING) << "Failed to write " << file_path.value();
+      return false;
+    }
+    UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexSaveCacheTime",
+                        base::TimeTicks::Now() - beginning_time);
+    return true;
+  }
+
   InMemoryURLIndexCacheItem index_cache;
   SavePrivateData(&index_cache);
   std::string data;
@@ -940,19 +1157,55 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::RestoreFromFile(
     const FilePath& file_path,
     const std::string& languages) {
   base::TimeTicks beginning_time = base::TimeTicks::Now();
-  if (!file_util::PathExists(file_path))
+
+  // The cache file holds either a compact index, which is mapped and searched
+  // in place, or the protobuf of the maps. Windows can't replace a file which
+  // is mapped, so the cache is moved to a file of its own first, and later
+  // saves write |file_path| again. Without a newer save, the file that was
+  // restored last time is restored again.
+  FilePath restored_path = GetRestoredCacheFilePath(file_path);
+  if (file_util::PathExists(file_path) &&
+      !file_util::Move(file_path, restored_path)) {
+    LOG(WARNING) << "Failed to move " << file_path.value();
     return NULL;
+  }
+  if (!file_util::PathExists(restored_path))
+    return NULL;
+
+  scoped_refptr<CompactURLIndex> compact_index(
+      CompactURLIndex::CreateFromFile(restored_path));
+  if (compact_index.get()) {
+    scoped_refptr<URLIndexPrivateData> restored_data(new URLIndexPrivateData);
+    restored_data->compact_index_ = compact_index;
+    UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexRestoreCacheTime",
+                        base::TimeTicks::Now() - beginning_time);
+    UMA_HISTOGRAM_COUNTS("History.InMemoryURLHistoryItems",
+                         compact_index->row_count());
+    UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize",
+                         compact_index->size());
+    UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords",
+                               compact_index->word_count());
+    if (restored_data->Empty())
+      return NULL;
+    // Without the switch the index is held in the maps, as it was before the
+    // compact index was saved.
+    if (!CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kEnableCompactHistoryIndex))
+      restored_data->ExpandCompactIndex();
+    return restored_data;
+  }
+
   std::string data;
   // If there is no cache file then simply give up. This will cause us to
   // attempt to rebuild from the history database.
-  if (!file_util::ReadFileToString(file_path, &data))
+  if (!file_util::ReadFileToString(restored_path, &data))
     return NULL;
 
   scoped_refptr<URLIndexPrivateData> restored_data(new URLIndexPrivateData);
   InMemoryURLIndexCacheItem index_cache;
   if (!index_cache.ParseFromArray(data.c_str(), data.size())) {
     LOG(WARNING) << "Failed to parse URLIndexPrivateData cache data read from "
-                 << file_path.value();
+                 << restored_path.value();
     return restored_data;
   }
 
@@ -970,9 +1223,18 @@ scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::RestoreFromFile(
                              restored_data->char_word_map_.size());
   if (restored_data->Empty())
     return NULL;  // 'No data' is the same as a failed reload.
+  if (CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableCompactHistoryIndex))
+    restored_data->Compact();
   return restored_data;
 }
 
+// static
+FilePath URLIndexPrivateData::GetRestoredCacheFilePath(
+    const FilePath& file_path) {
+  return file_path.AddExtension(FILE_PATH_LITERAL("restored"));
+}
+
 bool URLIndexPrivateData::RestorePrivateData(
     const InMemoryURLIndexCacheItem& cache,
     const std::string& languages) {
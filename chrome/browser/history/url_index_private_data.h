@@ -11,6 +11,8 @@
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
+#include "chrome/browser/history/compact_url_index.h"
+#include "chrome/browser/history/history_scoring_job.h"
 #include "chrome/browser/history/in_memory_url_index_types.h"
 #include "chrome/browser/history/in_memory_url_index_cache.pb.h"
 #include "chrome/browser/history/scored_history_match.h"
@@ -65,6 +67,17 @@ class URLIndexPrivateData
   ScoredHistoryMatches HistoryItemsForTerms(const string16& term_string,
                                             BookmarkService* bookmark_service);
 
+  // Finds the candidates for |term_string| as HistoryItemsForTerms() does,
+  // and returns a job which scores them, either on this thread or on a worker
+  // pool, or NULL if there is nothing to search.
+  scoped_refptr<HistoryScoringJob> ScoringJobForTerms(
+      const string16& term_string,
+      BookmarkService* bookmark_service);
+
+  // Records how many matches the job from ScoringJobForTerms() returned, as
+  // HistoryItemsForTerms() does for its own.
+  void RecordScoredItemCount(size_t count);
+
   // Adds the history item in |row| to the index if it does not already already
   // exist and it meets the minimum 'quick' criteria. If the row already exists
   // in the index then the index will be updated if the row still meets the
@@ -82,14 +95,19 @@ class URLIndexPrivateData
   // was actually updated.
   bool DeleteURL(const GURL& url);
 
-  // Creates a new URLIndexPrivateData object, populates it from the contents
-  // of the cache file stored in |file_path|, and assigns it to |private_data|.
-  // |languages| will be used to break URLs and page titles into words.
-  static void RestoreFromFileTask(
+  // Constructs a new object by restoring its contents from the cache file at
+  // |file_path|, which holds either a compact index, which is mapped rather
+  // than read, or the protobuf of the maps. Returns the restored data, or NULL
+  // upon failure. |languages| will be used to break URLs and page titles into
+  // words.
+  static scoped_refptr<URLIndexPrivateData> RestoreFromFile(
       const FilePath& file_path,
-      scoped_refptr<URLIndexPrivateData> private_data,
       const std::string& languages);
 
+  // Returns the path of the file RestoreFromFile() moves the cache file at
+  // |file_path| to, and restores it from.
+  static FilePath GetRestoredCacheFilePath(const FilePath& file_path);
+
   // Constructs a new object by rebuilding its contents from the history
   // database in |history_db|. Returns the new URLIndexPrivateData which on
   // success will contain the rebuilt data but upon failure will be empty.
@@ -115,6 +133,26 @@ class URLIndexPrivateData
   // from the cache or a complete rebuild from the history database.
   void Clear();
 
+  // Moves everything indexed into a CompactURLIndex, which takes a fraction of
+  // the memory of the maps and is quicker to search. Later updates go to the
+  // maps, which are searched along with the compact index and folded into it
+  // again once they grow large. Can be called on any thread, as long as no
+  // other is using this object.
+  void Compact();
+
+  // Returns true if the index data is held in a CompactURLIndex.
+  bool IsCompact() const { return compact_index_.get() != NULL; }
+
+  // Returns true if enough of a compact index has been updated since it was
+  // compacted for Compact() to be worth running again. The caller runs it on
+  // a copy, away from the main thread.
+  bool NeedsRecompaction() const;
+
+  // Returns an estimate of the number of bytes used by the index, including a
+  // compact index mapped from a file, but leaving out what the URLRows point
+  // to.
+  size_t EstimateMemoryUsage() const;
+
  private:
   friend class base::RefCountedThreadSafe<URLIndexPrivateData>;
   ~URLIndexPrivateData();
@@ -123,6 +161,7 @@ class URLIndexPrivateData
   friend class ::HistoryQuickProviderTest;
   friend class InMemoryURLIndexTest;
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheSaveRestore);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CompactIndex);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, HugeResultSet);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Scoring);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, TitleSearch);
@@ -149,6 +188,7 @@ class URLIndexPrivateData
   // not mark the item as being |used_|.
   struct SearchTermCacheItem {
     SearchTermCacheItem(const WordIDSet& word_id_set,
+                        const WordIDVector& compact_word_ids,
                         const HistoryIDSet& history_id_set);
     // Creates a cache item for a term which has no results.
     SearchTermCacheItem();
@@ -156,33 +196,25 @@ class URLIndexPrivateData
     ~SearchTermCacheItem();
 
     WordIDSet word_id_set_;
+    WordIDVector compact_word_ids_;  // The words of the term in compact_index_.
     HistoryIDSet history_id_set_;
     bool used_;  // True if this item has been used for the current term search.
   };
   typedef std::map<string16, SearchTermCacheItem> SearchTermCacheMap;
 
-  // A helper class which performs the final filter on each candidate
-  // history URL match, inserting accepted matches into |scored_matches_|.
+  // A helper class which adds each candidate history URL match, with its word
+  // starts, to |scoring_job_|, which performs the final filter.
   class AddHistoryMatch : public std::unary_function<HistoryID, void> {
    public:
     AddHistoryMatch(const URLIndexPrivateData& private_data,
-                    BookmarkService* bookmark_service,
-                    const string16& lower_string,
-                    const String16Vector& lower_terms,
-                    const base::Time now);
+                    HistoryScoringJob* scoring_job);
     ~AddHistoryMatch();
 
     void operator()(const HistoryID history_id);
 
-    ScoredHistoryMatches ScoredMatches() const { return scored_matches_; }
-
    private:
     const URLIndexPrivateData& private_data_;
-    BookmarkService* bookmark_service_;
-    ScoredHistoryMatches scored_matches_;
-    const string16& lower_string_;
-    const String16Vector& lower_terms_;
-    const base::Time now_;
+    HistoryScoringJob* scoring_job_;
   };
 
   // A helper predicate class used to filter excess history items when the
@@ -190,13 +222,13 @@ class URLIndexPrivateData
   class HistoryItemFactorGreater
       : public std::binary_function<HistoryID, HistoryID, void> {
    public:
-    explicit HistoryItemFactorGreater(const HistoryInfoMap& history_info_map);
+    explicit HistoryItemFactorGreater(const URLIndexPrivateData& private_data);
     ~HistoryItemFactorGreater();
 
     bool operator()(const HistoryID h1, const HistoryID h2);
 
    private:
-    const history::HistoryInfoMap& history_info_map_;
+    const URLIndexPrivateData& private_data_;
   };
 
   // URL History indexing support functions.
@@ -253,8 +285,28 @@ class URLIndexPrivateData
   // Clears |used_| for each item in the search term cache.
   void ResetSearchTermCache();
 
+  // Gets what HistoryItemFactorGreater ranks the item with |history_id| by,
+  // without copying its row. Returns false if there is no such item.
+  bool GetRowFactors(HistoryID history_id,
+                     int* typed_count,
+                     int* visit_count,
+                     base::Time* last_visit) const;
+
+  // Returns true if the item with |history_id| is held in compact_index_ and
+  // has not been superseded since.
+  bool IsInCompactIndex(HistoryID history_id) const;
+
+  // Copies the item with |history_id| from compact_index_ into the maps and
+  // hides it in the compact index, so that it can be updated.
+  void MoveCompactRowToMaps(HistoryID history_id,
+                            const std::string& languages);
+
+  // Moves everything in compact_index_ back into the maps.
+  void ExpandCompactIndex();
+
   // Caches the index private data and writes the cache file to the profile
-  // directory.  Called by WritePrivateDataToCacheFileTask.
+  // directory. A compact index is written in its own format rather than as a
+  // protobuf. Called by WritePrivateDataToCacheFileTask.
   bool SaveToFile(const FilePath& file_path);
 
   // Encode a data structure into the protobuf |cache|.
@@ -266,14 +318,6 @@ class URLIndexPrivateData
   void SaveHistoryInfoMap(imui::InMemoryURLIndexCacheItem* cache) const;
   void SaveWordStartsMap(imui::InMemoryURLIndexCacheItem* cache) const;
 
-  // Constructs a new object by restoring its contents from the file at |path|.
-  // Returns the new URLIndexPrivateData which on success will contain the
-  // restored data but upon failure will be empty.  |languages| will be used to
-  // break URLs and page titles into words
-  static scoped_refptr<URLIndexPrivateData> RestoreFromFile(
-      const FilePath& path,
-      const std::string& languages);
-
   // Decode a data structure from the protobuf |cache|. Return false if there
   // is any kind of failure. |languages| will be used to break URLs and page
   // titles into words
@@ -341,6 +385,14 @@ class URLIndexPrivateData
   // item's URL and page title.
   WordStartsMap word_starts_map_;
 
+  // Once the index has been compacted, holds the items indexed up to then,
+  // while the maps above hold those added or updated since.
+  scoped_refptr<CompactURLIndex> compact_index_;
+
+  // The items in |compact_index_| which have since been deleted, or moved to
+  // the maps to be updated.
+  HistoryIDSet compact_hidden_ids_;
+
   // End of data members that are cached ---------------------------------------
 
   // For unit testing only. Specifies the version of the cache file to be saved.
@@ -0,0 +1,225 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/url_index_private_data.h"
+#include "chrome/common/chrome_switches.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+// The size of the history, which is about that of a heavy user's.
+const int kURLCount = 200000;
+const int kHostCount = 4000;
+
+// The vocabulary of the synthetic history.
+const char* const kSyllables[] = {
+  "ba", "ko", "ri", "tem", "lo", "sa", "ven", "di", "mar", "nu", "pe", "ga",
+  "zo", "fli", "ter", "ca", "mon", "ex", "ple", "ad", "ro", "ti", "sun", "que",
+};
+
+// What the user types, a keystroke at a time.
+const char* const kQueries[] = {
+  "ba", "google", "kori temlo", "sa ven", "mar", "news", "kosa.com/di",
+  "flitermon", "exple adro", "tisun que", "w", "http://www.bako",
+};
+
+// A linear congruential generator, so the history is the same on every run.
+class Random {
+ public:
+  Random() : state_(42) {}
+  int Next(int limit) {
+    state_ = state_ * 1103515245 + 12345;
+    return static_cast<int>((state_ >> 16) % limit);
+  }
+  // Leans towards small values, like the popularity of hosts and words.
+  int NextSkewed(int limit) {
+    return std::min(Next(limit), Next(limit));
+  }
+
+ private:
+  uint32 state_;
+};
+
+std::string MakeWord(Random* random, int index) {
+  std::string word;
+  const int kSyllableCount = arraysize(kSyllables);
+  do {
+    word += kSyllables[index % kSyllableCount];
+    index /= kSyllableCount;
+  } while (index);
+  if (random->Next(4) == 0)
+    word += kSyllables[random->Next(kSyllableCount)];
+  return word;
+}
+
+void MakeHistory(std::vector<URLRow>* rows) {
+  Random random;
+  const char* const kTLDs[] = { "com", "org", "net", "de", "co.uk" };
+  base::Time now = base::Time::Now();
+  for (int i = 0; i < kURLCount; ++i) {
+    int host = random.NextSkewed(kHostCount);
+    std::string url = base::StringPrintf(
+        "http://www.%s.%s/%s/%s?id=%d",
+        MakeWord(&random, host).c_str(),
+        kTLDs[host % arraysize(kTLDs)],
+        MakeWord(&random, random.NextSkewed(2000)).c_str(),
+        MakeWord(&random, random.NextSkewed(20000)).c_str(), i);
+    std::string title;
+    for (int words = 2 + random.Next(5); words; --words) {
+      title += MakeWord(&random, random.NextSkewed(5000));
+      title += ' ';
+    }
+    URLRow row(GURL(url), i + 1);
+    row.set_title(UTF8ToUTF16(title));
+    row.set_visit_count(1 + random.NextSkewed(50));
+    row.set_typed_count(random.Next(3) ? 0 : 1 + random.Next(5));
+    row.set_last_visit(now - base::TimeDelta::FromHours(random.Next(24 * 90)));
+    rows->push_back(row);
+  }
+}
+
+// Types each query a keystroke at a time, and logs the average and the
+// slowest keystroke.
+void TypeQueries(URLIndexPrivateData* data, const char* name) {
+  base::TimeDelta total;
+  base::TimeDelta slowest;
+  int keystrokes = 0;
+  size_t matches = 0;
+  for (size_t i = 0; i < arraysize(kQueries); ++i) {
+    string16 query = ASCIIToUTF16(kQueries[i]);
+    for (size_t length = 1; length <= query.length(); ++length) {
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      matches += data->HistoryItemsForTerms(query.substr(0, length), NULL)
+          .size();
+      base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+      total += elapsed;
+      slowest = std::max(slowest, elapsed);
+      ++keystrokes;
+    }
+  }
+  EXPECT_GT(matches, 0U);
+  LogPerfResult(base::StringPrintf("HQP_Keystroke_%s", name).c_str(),
+                total.InMillisecondsF() / keystrokes, "ms");
+  LogPerfResult(base::StringPrintf("HQP_SlowestKeystroke_%s", name).c_str(),
+                slowest.InMillisecondsF(), "ms");
+}
+
+// Builds the index of a large synthetic history, in maps.
+scoped_refptr<URLIndexPrivateData> MakeIndex() {
+  std::vector<URLRow> rows;
+  MakeHistory(&rows);
+  std::set<std::string> scheme_whitelist;
+  scheme_whitelist.insert("http");
+  scheme_whitelist.insert("https");
+  scoped_refptr<URLIndexPrivateData> data(new URLIndexPrivateData);
+  for (size_t i = 0; i < rows.size(); ++i)
+    data->UpdateURL(rows[i], "en", scheme_whitelist);
+  return data;
+}
+
+// Restores the index from the cache file at |path|, and logs how long that
+// took, and how long until the first search was answered.
+void RestoreFromCache(const FilePath& path, const char* name) {
+  int64 file_size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path, &file_size));
+  LogPerfResult(base::StringPrintf("HQP_CacheSize_%s", name).c_str(),
+                file_size / 1024, "KB");
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  scoped_refptr<URLIndexPrivateData> data(
+      URLIndexPrivateData::RestoreFromFile(path, "en"));
+  base::TimeDelta restore_time = base::TimeTicks::HighResNow() - start;
+  ASSERT_TRUE(data.get());
+  EXPECT_FALSE(data->HistoryItemsForTerms(ASCIIToUTF16("kori"),
+                                          NULL).empty());
+  base::TimeDelta first_search_time = base::TimeTicks::HighResNow() - start;
+  LogPerfResult(base::StringPrintf("HQP_Restore_%s", name).c_str(),
+                restore_time.InMillisecondsF(), "ms");
+  LogPerfResult(base::StringPrintf("HQP_RestoreToFirstSearch_%s", name).c_str(),
+                first_search_time.InMillisecondsF(), "ms");
+}
+
+}  // namespace
+
+// Measures the memory used by the index of a large synthetic history and the
+// time taken to search it as the user types, with the index held in maps and
+// then compacted.
+TEST(URLIndexPrivateDataPerfTest, CompactIndex) {
+  std::vector<URLRow> rows;
+  MakeHistory(&rows);
+  std::set<std::string> scheme_whitelist;
+  scheme_whitelist.insert("http");
+  scheme_whitelist.insert("https");
+
+  scoped_refptr<URLIndexPrivateData> data(new URLIndexPrivateData);
+  {
+    PerfTimeLogger timer("HQP_Index_maps");
+    for (size_t i = 0; i < rows.size(); ++i)
+      data->UpdateURL(rows[i], "en", scheme_whitelist);
+  }
+  LogPerfResult("HQP_Memory_maps", data->EstimateMemoryUsage() / 1024, "KB");
+  TypeQueries(data, "maps");
+
+  {
+    PerfTimeLogger timer("HQP_Compact");
+    data->Compact();
+  }
+  ASSERT_TRUE(data->IsCompact());
+  LogPerfResult("HQP_Memory_compact", data->EstimateMemoryUsage() / 1024,
+                "KB");
+  TypeQueries(data, "compact");
+
+  // An index whose recent updates have not been folded in yet.
+  for (size_t i = 0; i < rows.size(); i += rows.size() / 500) {
+    rows[i].set_visit_count(rows[i].visit_count() + 1);
+    rows[i].set_title(rows[i].title() + ASCIIToUTF16(" updated"));
+    data->UpdateURL(rows[i], "en", scheme_whitelist);
+  }
+  ASSERT_TRUE(data->IsCompact());
+  TypeQueries(data, "compact_updated");
+}
+
+// Measures how long it takes at startup to restore the index of a large
+// synthetic history from its cache file, saved as a protobuf of the maps or
+// as a compact index. Both files are read right after being written, so this
+// leaves out the disk, which favors the protobuf, as it has to read all of
+// its file while the compact index only touches the pages it searches.
+TEST(URLIndexPrivateDataPerfTest, RestoreFromCache) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath protobuf_path = temp_dir.path().AppendASCII("protobuf");
+  FilePath compact_path = temp_dir.path().AppendASCII("compact");
+
+  scoped_refptr<URLIndexPrivateData> data(MakeIndex());
+  ASSERT_TRUE(URLIndexPrivateData::WritePrivateDataToCacheFileTask(
+      data, protobuf_path));
+  data->Compact();
+  ASSERT_TRUE(URLIndexPrivateData::WritePrivateDataToCacheFileTask(
+      data, compact_path));
+  data = NULL;
+
+  RestoreFromCache(protobuf_path, "protobuf");
+  // A compact index is only kept as it is with the switch.
+  CommandLine::ForCurrentProcess()->AppendSwitch(
+      switches::kEnableCompactHistoryIndex);
+  RestoreFromCache(compact_path, "compact");
+}
+
+}  // namespace history
@@ -0,0 +1,47 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_VARINT_H_
+#define CHROME_BROWSER_HISTORY_VARINT_H_
+
+#include "base/basictypes.h"
+
+// Variable length integers, as used by the posting lists of the history
+// indexes: seven bits a byte, least significant first, with the top bit of
+// each byte set when more follow.
+
+namespace history {
+
+// Appends |value| to |out|, a std::string or a std::vector<uint8>.
+template<typename Container>
+void AppendVarint(uint64 value, Container* out) {
+  while (value >= 0x80) {
+    out->push_back(
+        static_cast<typename Container::value_type>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<typename Container::value_type>(value));
+}
+
+// Reads a value from |*it|, which must not be |end|, and advances |*it| past
+// it. A value cut short by |end| is returned as far as it goes, and bits above
+// the 64th are dropped.
+template<typename Iterator>
+uint64 ReadVarint(Iterator* it, Iterator end) {
+  uint64 value = 0;
+  int shift = 0;
+  uint8 byte;
+  do {
+    byte = static_cast<uint8>(**it);
+    ++*it;
+    if (shift < 64)
+      value |= static_cast<uint64>(byte & 0x7F) << shift;
+    shift += 7;
+  } while ((byte & 0x80) && *it != end);
+  return value;
+}
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_VARINT_H_
@@ -0,0 +1,48 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "chrome/browser/history/varint.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+TEST(VarintTest, RoundTrip) {
+  const uint64 kValues[] = {
+    0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0xFFFFFFFF, kuint64max
+  };
+  std::string data;
+  std::vector<uint8> bytes;
+  for (size_t i = 0; i < arraysize(kValues); ++i) {
+    AppendVarint(kValues[i], &data);
+    AppendVarint(kValues[i], &bytes);
+  }
+  ASSERT_EQ(data.size(), bytes.size());
+  EXPECT_EQ(1U + 1 + 1 + 2 + 2 + 3 + 5 + 10, data.size());
+
+  const std::string::const_iterator end = data.end();
+  std::string::const_iterator it = data.begin();
+  const uint8* byte = &bytes[0];
+  const uint8* bytes_end = byte + bytes.size();
+  for (size_t i = 0; i < arraysize(kValues); ++i) {
+    ASSERT_TRUE(it != end);
+    EXPECT_EQ(kValues[i], ReadVarint(&it, end));
+    EXPECT_EQ(kValues[i], ReadVarint(&byte, bytes_end));
+  }
+  EXPECT_TRUE(it == end);
+}
+
+TEST(VarintTest, CutShort) {
+  std::string data;
+  AppendVarint(0x4000, &data);
+  data.resize(2);
+  const std::string::const_iterator end = data.end();
+  std::string::const_iterator it = data.begin();
+  EXPECT_EQ(0U, ReadVarint(&it, end));
+  EXPECT_TRUE(it == end);
+}
+
+}  // namespace history
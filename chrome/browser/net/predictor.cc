@@ -8,6 +8,7 @@
 #include <cmath>
 #include <set>
 #include <sstream>
+#include <utility>
 
 #include "base/bind.h"
 #include "base/command_line.h"
@@ -63,6 +64,11 @@ const int64 Predictor::kDurationBetweenTrimmingsHours = 1;
 const int64 Predictor::kDurationBetweenTrimmingIncrementsSeconds = 15;
 const size_t Predictor::kUrlsTrimmedPerIncrement = 5u;
 const size_t Predictor::kMaxSpeculativeParallelResolves = 3;
+const size_t Predictor::kMaxReferrers = 1000;
+// When there are more than kMaxReferrers, enough are discarded to leave this
+// many, so that discarding isn't done on every new referrer.
+static const size_t kReferrersKeptWhenDiscarding =
+    Predictor::kMaxReferrers * 9 / 10;
 // To control our congestion avoidance system, which discards a queue when
 // resolutions are "taking too long," we need an expected resolution time.
 // Common average is in the range of 300-500ms.
@@ -91,6 +97,11 @@ class Predictor::LookupRequest {
         resolver_(host_resolver) {
   }
 
+  // How long since the lookup was started.
+  base::TimeDelta GetElapsedTime() const {
+    return base::TimeTicks::Now() - start_time_;
+  }
+
   // Return underlying network resolver status.
   // net::OK ==> Host was found synchronously.
   // net:ERR_IO_PENDING ==> Network will callback later with result.
@@ -103,6 +114,7 @@ class Predictor::LookupRequest {
     // to separate it from real navigations in the observer's callback, and
     // lets the HostResolver know it can de-prioritize it.
     resolve_info.set_is_speculative(true);
+    start_time_ = base::TimeTicks::Now();
     return resolver_.Resolve(
         resolve_info, &addresses_,
         base::Bind(&LookupRequest::OnLookupFinished, base::Unretained(this)),
@@ -117,6 +129,7 @@ class Predictor::LookupRequest {
   Predictor* predictor_;  // The predictor which started us.
 
   const GURL url_;  // Hostname to resolve.
+  base::TimeTicks start_time_;  // When Start() was called.
   net::SingleRequestHostResolver resolver_;
   net::AddressList addresses_;
 
@@ -130,6 +143,7 @@ Predictor::Predictor(bool preconnect_enabled)
       peak_pending_lookups_(0),
       shutdown_(false),
       max_concurrent_dns_lookups_(g_max_parallel_resolves),
+      dns_lookup_limit_(g_max_parallel_resolves),
       max_dns_queue_delay_(
           TimeDelta::FromMilliseconds(g_max_queueing_delay_ms)),
       host_resolver_(NULL),
@@ -423,7 +437,7 @@ void Predictor::ResolveList(const UrlList& urls,
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   for (UrlList::const_iterator it = urls.begin(); it < urls.end(); ++it) {
-    AppendToResolutionQueue(*it, motivation);
+    AppendToResolutionQueue(*it, motivation, 1.0);
   }
 }
 
@@ -434,7 +448,7 @@ void Predictor::Resolve(const GURL& url,
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   if (!url.has_host())
     return;
-  AppendToResolutionQueue(url, motivation);
+  AppendToResolutionQueue(url, motivation, 1.0);
 }
 
 void Predictor::LearnFromNavigation(const GURL& referring_url,
@@ -448,6 +462,7 @@ void Predictor::LearnFromNavigation(const GURL& referring_url,
   DCHECK_NE(target_url, GURL::EmptyGURL());
 
   referrers_[referring_url].SuggestHost(target_url);
+  DiscardLeastUsefulReferrers();
   // Possibly do some referrer trimming.
   TrimReferrers();
 }
@@ -641,6 +656,7 @@ void Predictor::DeserializeReferrers(const base::ListValue& referral_list) {
 
       referrers_[GURL(motivating_url_spec)].Deserialize(*subresource_list);
     }
+    DiscardLeastUsefulReferrers();
   }
 }
 
@@ -891,7 +907,8 @@ void Predictor::PrepareFrameSubresources(const GURL& url) {
       evalution = PRERESOLUTION;
       future_url->second.preresolution_increment();
       UrlInfo* queued_info = AppendToResolutionQueue(future_url->first,
-                                                     motivation);
+                                                     motivation,
+                                                     connection_expectation);
       if (queued_info)
         queued_info->SetReferringHostname(url);
     }
@@ -905,6 +922,7 @@ void Predictor::OnLookupFinished(LookupRequest* request, const GURL& url,
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   LookupFinished(request, url, found);
+  AdjustLookupLimit(request->GetElapsedTime());
   pending_lookups_.erase(request);
   delete request;
 
@@ -928,7 +946,8 @@ void Predictor::LookupFinished(LookupRequest* request, const GURL& url,
 
 UrlInfo* Predictor::AppendToResolutionQueue(
     const GURL& url,
-    UrlInfo::ResolutionMotivation motivation) {
+    UrlInfo::ResolutionMotivation motivation,
+    double expected_use) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   DCHECK(url.has_host());
 
@@ -947,8 +966,14 @@ UrlInfo* Predictor::AppendToResolutionQueue(
     return NULL;
   }
 
+  // Rank the name by the lookup time it is expected to save, which is how
+  // long a lookup takes times how often the host is expected to be needed.
+  const TimeDelta expected_duration = info->ExpectedResolveDuration(
+      TimeDelta::FromMilliseconds(kExpectedResolutionTimeMs));
+  const double benefit = expected_use * expected_duration.InMillisecondsF();
+
   info->SetQueuedState(motivation);
-  work_queue_.Push(url, motivation);
+  work_queue_.Push(url, motivation, benefit);
   StartSomeQueuedResolutions();
   return info;
 }
@@ -975,7 +1000,7 @@ void Predictor::StartSomeQueuedResolutions() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   while (!work_queue_.IsEmpty() &&
-         pending_lookups_.size() < max_concurrent_dns_lookups_) {
+         pending_lookups_.size() < dns_lookup_limit_) {
     const GURL url(work_queue_.Pop());
     UrlInfo* info = &results_[url];
     DCHECK(info->HasUrl(url));
@@ -1003,6 +1028,46 @@ void Predictor::StartSomeQueuedResolutions() {
   }
 }
 
+void Predictor::AdjustLookupLimit(TimeDelta lookup_duration) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  // A slow lookup suggests the resolver, or the network behind it, is busy,
+  // so halve the number of lookups we add to its load.  Otherwise allow one
+  // more, back up to the maximum.
+  if (lookup_duration > TimeDelta::FromMilliseconds(kExpectedResolutionTimeMs))
+    dns_lookup_limit_ = std::max<size_t>(1, dns_lookup_limit_ / 2);
+  else if (dns_lookup_limit_ < max_concurrent_dns_lookups_)
+    ++dns_lookup_limit_;
+}
+
+void Predictor::DiscardLeastUsefulReferrers() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  if (referrers_.size() <= kMaxReferrers)
+    return;
+
+  // A referrer is worth the number of connections its subresources are
+  // expected to need each time it is visited.
+  typedef std::pair<double, GURL> ReferrerUsefulness;
+  std::vector<ReferrerUsefulness> usefulness;
+  usefulness.reserve(referrers_.size());
+  for (Referrers::const_iterator it = referrers_.begin();
+       it != referrers_.end(); ++it) {
+    double expected_connections = 0.0;
+    for (Referrer::const_iterator future_url = it->second.begin();
+         future_url != it->second.end(); ++future_url) {
+      expected_connections += future_url->second.subresource_use_rate();
+    }
+    usefulness.push_back(ReferrerUsefulness(expected_connections, it->first));
+  }
+
+  const size_t discard_count = usefulness.size() - kReferrersKeptWhenDiscarding;
+  std::nth_element(usefulness.begin(), usefulness.begin() + discard_count,
+                   usefulness.end());
+  for (size_t i = 0; i < discard_count; ++i)
+    referrers_.erase(usefulness[i].second);
+  UMA_HISTOGRAM_COUNTS("Net.PredictorReferrersDiscarded",
+                       static_cast<int>(discard_count));
+}
+
 void Predictor::TrimReferrers() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   if (!urls_being_trimmed_.empty())
@@ -1057,7 +1122,7 @@ void Predictor::IncrementalTrimReferrers(bool trim_all_now) {
 
 //-----------------------------------------------------------------------------
 
-Predictor::HostNameQueue::HostNameQueue() {
+Predictor::HostNameQueue::HostNameQueue() : next_sequence_number_(0) {
 }
 
 Predictor::HostNameQueue::~HostNameQueue() {
@@ -1065,15 +1130,22 @@ Predictor::HostNameQueue::~HostNameQueue() {
 
 void Predictor::HostNameQueue::Push(const GURL& url,
     UrlInfo::ResolutionMotivation motivation) {
+  Push(url, motivation, 0.0);
+}
+
+void Predictor::HostNameQueue::Push(const GURL& url,
+    UrlInfo::ResolutionMotivation motivation,
+    double benefit) {
+  const Entry entry(url, benefit, next_sequence_number_++);
   switch (motivation) {
     case UrlInfo::STATIC_REFERAL_MOTIVATED:
     case UrlInfo::LEARNED_REFERAL_MOTIVATED:
     case UrlInfo::MOUSE_OVER_MOTIVATED:
-      rush_queue_.push(url);
+      rush_queue_.push(entry);
       break;
 
     default:
-      background_queue_.push(url);
+      background_queue_.push(entry);
       break;
   }
 }
@@ -1084,9 +1156,9 @@ bool Predictor::HostNameQueue::IsEmpty() const {
 
 GURL Predictor::HostNameQueue::Pop() {
   DCHECK(!IsEmpty());
-  std::queue<GURL> *queue(rush_queue_.empty() ? &background_queue_
-                                              : &rush_queue_);
-  GURL url(queue->front());
+  std::priority_queue<Entry>* queue(rush_queue_.empty() ? &background_queue_
+                                                        : &rush_queue_);
+  GURL url(queue->top().url);
   queue->pop();
   return url;
 }
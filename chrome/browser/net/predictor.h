@@ -71,10 +71,17 @@ class Predictor {
   // Given that the underlying Chromium resolver defaults to a total maximum of
   // 8 paralell resolutions, we will avoid any chance of starving navigational
   // resolutions by limiting the number of paralell speculative resolutions.
+  // Within this limit, fewer are made while lookups are slow (see
+  // AdjustLookupLimit()).
   // This is used in the field trials and testing.
   // TODO(jar): Move this limitation into the resolver.
   static const size_t kMaxSpeculativeParallelResolves;
 
+  // The most referrers whose subresources are learned.  Each lists at most
+  // ten subresources, so this bounds the memory used by |referrers_|.  When
+  // there are more, the least useful are discarded.
+  static const size_t kMaxReferrers;
+
   // To control the congestion avoidance system, we need an estimate of how
   // many speculative requests may arrive at once.  Since we currently only
   // keep 8 subresource names for each frame, we'll use that as our basis.
@@ -243,6 +250,10 @@ class Predictor {
     return max_concurrent_dns_lookups_;
   }
   // Used for testing.
+  size_t dns_lookup_limit() const {
+    return dns_lookup_limit_;
+  }
+  // Used for testing.
   void SetShutdown(bool shutdown) {
     shutdown_ = shutdown;
   }
@@ -266,7 +277,11 @@ class Predictor {
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, MassiveConcurrentLookupTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueuePushPopTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueueReorderTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueueBenefitTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, LookupLimitTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReferrerSerializationTrimTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReferrerEvictionTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorPerfTest, ReplayNavigationLog);
   friend class WaitForResolutionHelper;  // For testing.
 
   class LookupRequest;
@@ -277,23 +292,47 @@ class Predictor {
   // actual sub-resource is fetched.  In contrast, a name that was speculatively
   // noted in a page has to be resolved before the user "gets around to"
   // clicking on a link.  By tagging (with a motivation) each push we make into
-  // this FIFO queue, the queue can re-order the more important names to service
+  // this queue, the queue can re-order the more important names to service
   // them sooner (relative to some low priority background resolutions).
+  // Among names of the same priority, those with the most expected |benefit|
+  // are serviced first, and otherwise the queue is FIFO.
   class HostNameQueue {
    public:
     HostNameQueue();
     ~HostNameQueue();
     void Push(const GURL& url,
               UrlInfo::ResolutionMotivation motivation);
+    void Push(const GURL& url,
+              UrlInfo::ResolutionMotivation motivation,
+              double benefit);
     bool IsEmpty() const;
     GURL Pop();
 
    private:
+    struct Entry {
+      Entry(const GURL& url, double benefit, int64 sequence_number)
+          : url(url), benefit(benefit), sequence_number(sequence_number) {}
+
+      // The greatest entry, which std::priority_queue pops first, is the one
+      // with the most benefit, and then the one pushed first.
+      bool operator<(const Entry& other) const {
+        if (benefit != other.benefit)
+          return benefit < other.benefit;
+        return sequence_number > other.sequence_number;
+      }
+
+      GURL url;
+      double benefit;
+      int64 sequence_number;
+    };
+
     // The names in the queue that should be serviced (popped) ASAP.
-    std::queue<GURL> rush_queue_;
+    std::priority_queue<Entry> rush_queue_;
     // The names in the queue that should only be serviced when rush_queue is
     // empty.
-    std::queue<GURL> background_queue_;
+    std::priority_queue<Entry> background_queue_;
+    // The sequence number of the next name pushed.
+    int64 next_sequence_number_;
 
   DISALLOW_COPY_AND_ASSIGN(HostNameQueue);
   };
@@ -392,9 +431,12 @@ class Predictor {
                       const GURL& url, bool found);
 
   // Queue hostname for resolution.  If queueing was done, return the pointer
-  // to the queued instance, otherwise return NULL.
+  // to the queued instance, otherwise return NULL.  |expected_use| is the
+  // number of connections the host is expected to be needed for, which ranks
+  // it in the queue.
   UrlInfo* AppendToResolutionQueue(const GURL& url,
-      UrlInfo::ResolutionMotivation motivation);
+      UrlInfo::ResolutionMotivation motivation,
+      double expected_use);
 
   // Check to see if too much queuing delay has been noted for the given info,
   // which indicates that there is "congestion" or growing delay in handling the
@@ -414,6 +456,14 @@ class Predictor {
   // asynchronously, provided we don't exceed concurrent resolution limit.
   void StartSomeQueuedResolutions();
 
+  // Updates |dns_lookup_limit_| for a lookup which took |lookup_duration| to
+  // come back from the resolver.
+  void AdjustLookupLimit(base::TimeDelta lookup_duration);
+
+  // Discards the referrers expected to save the fewest connections when
+  // there are more than kMaxReferrers.
+  void DiscardLeastUsefulReferrers();
+
   // Performs trimming similar to TrimReferrersNow(), except it does it as a
   // series of short tasks by posting continuations again an again until done.
   void TrimReferrers();
@@ -461,6 +511,11 @@ class Predictor {
   // sub-resource speculation, and retard resolutions suggested by page scans.
   const size_t max_concurrent_dns_lookups_;
 
+  // The number of concurrent speculative lookups allowed now, at most
+  // |max_concurrent_dns_lookups_|.  It is lowered while lookups are slow, to
+  // leave the resolver to navigations, and raised again when they speed up.
+  size_t dns_lookup_limit_;
+
   // The maximum queueing delay that is acceptable before we enter congestion
   // reduction mode, and discard all queued (but not yet assigned) resolutions.
   const base::TimeDelta max_dns_queue_delay_;
@@ -0,0 +1,203 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a log of navigations through the Predictor, offline, and reports
+// how many of the hosts each page needed were pre-resolved and how many
+// lookups were wasted on hosts it didn't need.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "base/string_split.h"
+#include "base/time.h"
+#include "chrome/browser/net/predictor.h"
+#include "chrome/browser/net/url_info.h"
+#include "content/public/test/test_browser_thread.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using content::BrowserThread;
+
+namespace chrome_browser_net {
+
+namespace {
+
+// Replays the log at this path instead of a synthetic one.  Each line of the
+// log is the URL of a page, followed by the URLs of the hosts it loaded
+// subresources from, separated by whitespace.
+const char kNavigationLogSwitch[] = "navigation-log";
+
+// The synthetic log visits this many sites, more of them than the Predictor
+// keeps referrers for.
+const int kSyntheticSites = 2000;
+const int kSyntheticNavigations = 20000;
+
+struct Navigation {
+  GURL page;
+  std::vector<GURL> subresources;
+};
+
+// Returns a number in [0, 65536) from |*state|, the same sequence on every
+// run so that the synthetic log is too.
+int NextRandom(uint32* state) {
+  *state = *state * 1103515245 + 12345;
+  return static_cast<int>(*state >> 16);
+}
+
+// Fills |log| with navigations to sites picked with a skew towards popular
+// ones.  Each site loads subresources from its own static host, one of a few
+// shared CDNs, a shared analytics host, and sometimes a random ad host.
+void MakeSyntheticLog(std::vector<Navigation>* log) {
+  uint32 state = 1;
+  for (int i = 0; i < kSyntheticNavigations; ++i) {
+    const double u = NextRandom(&state) / 65536.0;
+    const int site = static_cast<int>(kSyntheticSites * u * u * u);
+    const std::string site_number = base::IntToString(site);
+
+    Navigation navigation;
+    navigation.page = GURL("http://site" + site_number + ".example");
+    navigation.subresources.push_back(
+        GURL("http://static" + site_number + ".example"));
+    navigation.subresources.push_back(
+        GURL("http://cdn" + base::IntToString(site % 20) + ".example"));
+    navigation.subresources.push_back(GURL("http://analytics.example"));
+    if (NextRandom(&state) % 10 < 3) {
+      navigation.subresources.push_back(GURL(
+          "http://ad" + base::IntToString(NextRandom(&state) % 1000) +
+          ".example"));
+    }
+    log->push_back(navigation);
+  }
+}
+
+// Reads the log at |path| into |log|.  Returns false if it can't be read.
+bool ReadLog(const FilePath& path, std::vector<Navigation>* log) {
+  std::string contents;
+  if (!file_util::ReadFileToString(path, &contents))
+    return false;
+
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::vector<std::string> urls;
+    base::SplitStringAlongWhitespace(lines[i], &urls);
+    if (urls.empty())
+      continue;
+    Navigation navigation;
+    navigation.page = GURL(urls[0]);
+    for (size_t j = 1; j < urls.size(); ++j)
+      navigation.subresources.push_back(GURL(urls[j]));
+    log->push_back(navigation);
+  }
+  return true;
+}
+
+}  // namespace
+
+class PredictorPerfTest : public testing::Test {
+ public:
+  PredictorPerfTest()
+      : ui_thread_(BrowserThread::UI, &loop_),
+        io_thread_(BrowserThread::IO, &loop_) {
+  }
+
+ private:
+  MessageLoopForUI loop_;
+  content::TestBrowserThread ui_thread_;
+  content::TestBrowserThread io_thread_;
+};
+
+// For each navigation in the log, predicts the page's subresource hosts as
+// the Predictor would, counts the lookups which the page needed and those it
+// didn't, and then teaches the Predictor the hosts the page really loaded.
+// Lookups are taken from the Predictor's queue in the order it would start
+// them, rather than being made, so the replay needs no resolver or network.
+TEST_F(PredictorPerfTest, ReplayNavigationLog) {
+  std::vector<Navigation> log;
+  const FilePath log_path =
+      CommandLine::ForCurrentProcess()->GetSwitchValuePath(
+          kNavigationLogSwitch);
+  if (log_path.empty())
+    MakeSyntheticLog(&log);
+  else
+    ASSERT_TRUE(ReadLog(log_path, &log)) << log_path.value();
+
+  // Keep every lookup in the queue, and let hosts be looked up again on each
+  // visit rather than being taken for cached.
+  Predictor::set_max_parallel_resolves(0);
+  const base::TimeDelta cache_expiration = UrlInfo::get_cache_expiration();
+  UrlInfo::set_cache_expiration(base::TimeDelta());
+
+  // Without preconnection, every prediction is a lookup.
+  Predictor predictor(false);
+
+  size_t needed_hosts = 0;
+  size_t hits = 0;
+  size_t first_hits = 0;
+  size_t wasted_lookups = 0;
+  PerfTimeLogger timer("Predictor_Replay");
+  for (size_t i = 0; i < log.size(); ++i) {
+    const GURL page = Predictor::CanonicalizeUrl(log[i].page);
+    if (page.is_empty())
+      continue;
+    std::set<GURL> subresources;
+    for (size_t j = 0; j < log[i].subresources.size(); ++j) {
+      const GURL subresource =
+          Predictor::CanonicalizeUrl(log[i].subresources[j]);
+      if (!subresource.is_empty() && subresource != page)
+        subresources.insert(subresource);
+    }
+
+    predictor.PredictFrameSubresources(page);
+    for (size_t rank = 0; !predictor.work_queue_.IsEmpty(); ++rank) {
+      const GURL host = predictor.work_queue_.Pop();
+      UrlInfo* info = &predictor.results_[host];
+      info->SetAssignedState();
+      info->SetFoundState();
+      if (subresources.count(host)) {
+        ++hits;
+        // Those which would have been started at once.
+        if (rank < Predictor::kMaxSpeculativeParallelResolves)
+          ++first_hits;
+      } else {
+        ++wasted_lookups;
+      }
+    }
+
+    for (std::set<GURL>::const_iterator it = subresources.begin();
+         it != subresources.end(); ++it) {
+      predictor.LearnFromNavigation(page, *it);
+    }
+    needed_hosts += subresources.size();
+  }
+  timer.Done();
+
+  ASSERT_LT(0U, needed_hosts);
+  LogPerfResult("Predictor_HitRate", 100.0 * hits / needed_hosts, "%");
+  LogPerfResult("Predictor_FirstHitRate", 100.0 * first_hits / needed_hosts,
+                "%");
+  LogPerfResult("Predictor_WastedLookups",
+                static_cast<double>(wasted_lookups), "lookups");
+  const size_t lookups = std::max<size_t>(1, hits + wasted_lookups);
+  LogPerfResult("Predictor_WastedLookupRate", 100.0 * wasted_lookups / lookups,
+                "%");
+  LogPerfResult("Predictor_Referrers",
+                static_cast<double>(predictor.referrers_.size()), "referrers");
+  EXPECT_GE(Predictor::kMaxReferrers, predictor.referrers_.size());
+
+  predictor.Shutdown();
+  UrlInfo::set_cache_expiration(cache_expiration);
+  Predictor::set_max_parallel_resolves(
+      Predictor::kMaxSpeculativeParallelResolves);
+}
+
+}  // namespace chrome_browser_net
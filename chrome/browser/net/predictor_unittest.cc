@@ -622,6 +622,84 @@ TEST_F(PredictorTest, PriorityQueueReorderTest) {
   EXPECT_TRUE(queue.IsEmpty());
 }
 
+TEST_F(PredictorTest, PriorityQueueBenefitTest) {
+  Predictor::HostNameQueue queue;
+
+  GURL low("http://low:80"),
+      hi1("http://hi1:80"),
+      hi2("http://hi2:80"),
+      hi3("http://hi3:80"),
+      hi4("http://hi4:80");
+
+  // A low priority name waits for all high priority ones, whatever its
+  // benefit.
+  queue.Push(low, UrlInfo::PAGE_SCAN_MOTIVATED, 100.0);
+  queue.Push(hi1, UrlInfo::LEARNED_REFERAL_MOTIVATED, 1.0);
+  queue.Push(hi2, UrlInfo::LEARNED_REFERAL_MOTIVATED, 3.0);
+  queue.Push(hi3, UrlInfo::MOUSE_OVER_MOTIVATED, 2.0);
+  queue.Push(hi4, UrlInfo::LEARNED_REFERAL_MOTIVATED, 3.0);
+
+  // High priority names come out by benefit, and in FIFO order for the same
+  // benefit.
+  EXPECT_EQ(queue.Pop(), hi2);
+  EXPECT_EQ(queue.Pop(), hi4);
+  EXPECT_EQ(queue.Pop(), hi3);
+  EXPECT_EQ(queue.Pop(), hi1);
+  EXPECT_EQ(queue.Pop(), low);
+
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST_F(PredictorTest, LookupLimitTest) {
+  Predictor predictor(true);
+  const size_t max_lookups = predictor.max_concurrent_dns_lookups();
+  ASSERT_LT(1U, max_lookups);
+  EXPECT_EQ(max_lookups, predictor.dns_lookup_limit());
+
+  const TimeDelta fast = TimeDelta::FromMilliseconds(10);
+  const TimeDelta slow = TimeDelta::FromSeconds(5);
+
+  // A slow lookup halves the limit, down to one.
+  predictor.AdjustLookupLimit(slow);
+  EXPECT_EQ(max_lookups / 2, predictor.dns_lookup_limit());
+  for (size_t i = 0; i < max_lookups; ++i)
+    predictor.AdjustLookupLimit(slow);
+  EXPECT_EQ(1U, predictor.dns_lookup_limit());
+
+  // Fast lookups raise it one at a time, up to the maximum.
+  predictor.AdjustLookupLimit(fast);
+  EXPECT_EQ(2U, predictor.dns_lookup_limit());
+  for (size_t i = 0; i < max_lookups; ++i)
+    predictor.AdjustLookupLimit(fast);
+  EXPECT_EQ(max_lookups, predictor.dns_lookup_limit());
+
+  predictor.Shutdown();
+}
+
+// Test that the number of referrers learned is bounded, and that the most
+// useful are kept.
+TEST_F(PredictorTest, ReferrerEvictionTest) {
+  Predictor predictor(true);
+  predictor.SetHostResolver(host_resolver_.get());
+
+  GURL useful("http://useful");
+  for (int i = 0; i < 5; ++i) {
+    predictor.LearnFromNavigation(
+        useful, GURL("http://sub" + base::IntToString(i)));
+  }
+  for (size_t i = 0; i < Predictor::kMaxReferrers; ++i) {
+    predictor.LearnFromNavigation(
+        GURL("http://referrer" + base::Uint64ToString(i)), GURL("http://sub"));
+    EXPECT_GE(Predictor::kMaxReferrers, predictor.referrers_.size());
+  }
+
+  // Referrers are discarded in a batch, not one for each new referrer.
+  EXPECT_GT(Predictor::kMaxReferrers, predictor.referrers_.size());
+  EXPECT_EQ(1U, predictor.referrers_.count(useful));
+
+  predictor.Shutdown();
+}
+
 TEST_F(PredictorTest, CanonicalizeUrl) {
   // Base case, only handles HTTP and HTTPS.
   EXPECT_EQ(GURL(), Predictor::CanonicalizeUrl(GURL("ftp://anything")));
@@ -60,6 +60,11 @@ using content::BrowserThread;
 // AddCookie, UpdateCookieAccessTime, and DeleteCookie. These are flushed to
 // disk on the DB thread every 30 seconds, 512 operations, or call to Flush(),
 // whichever occurs first.
+//
+// Operations on a cookie which is still waiting to be flushed are folded into
+// its pending operation, so that a cookie which a site sets over and over is
+// written once per flush.  A cookie which is added and deleted again before a
+// flush is never written at all.
 class SQLitePersistentCookieStore::Backend
     : public base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend> {
  public:
@@ -156,6 +161,7 @@ class SQLitePersistentCookieStore::Backend
         : op_(op), cc_(cc) { }
 
     OperationType op() const { return op_; }
+    void set_op(OperationType op) { op_ = op; }
     const net::CanonicalCookie& cc() const { return cc_; }
 
    private:
@@ -230,9 +236,15 @@ class SQLitePersistentCookieStore::Backend
   typedef std::list<PendingOperation*> PendingOperationsList;
   PendingOperationsList pending_;
   PendingOperationsList::size_type num_pending_;
+  // The last operation in |pending_| on each cookie, by creation time, which
+  // is the cookie's primary key in the database.
+  typedef std::map<int64, PendingOperationsList::iterator>
+      PendingOperationsMap;
+  PendingOperationsMap last_pending_;
   // True if the persistent store should skip delete on exit rules.
   bool force_keep_session_state_;
-  // Guard |cookies_|, |pending_|, |num_pending_|, |force_keep_session_state_|
+  // Guard |cookies_|, |pending_|, |num_pending_|, |last_pending_|,
+  // |force_keep_session_state_|
   base::Lock lock_;
 
   // Temporary buffer for cookies loaded from DB. Accumulates cookies to reduce
@@ -844,11 +856,38 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
 
   // We do a full copy of the cookie here, and hopefully just here.
   scoped_ptr<PendingOperation> po(new PendingOperation(op, cc));
+  // An operation which |po| makes redundant, freed outside the lock.
+  scoped_ptr<PendingOperation> superseded;
 
   PendingOperationsList::size_type num_pending;
   {
     base::AutoLock locked(lock_);
-    pending_.push_back(po.release());
+
+    // Fold an update or deletion into the cookie's pending addition or
+    // update.  A pending deletion is left alone, as the cookie may be added
+    // again with the same creation time.
+    PendingOperationsMap::iterator last =
+        last_pending_.find(cc.CreationDate().ToInternalValue());
+    if (op != PendingOperation::COOKIE_ADD && last != last_pending_.end() &&
+        (*last->second)->op() != PendingOperation::COOKIE_DELETE) {
+      superseded.reset(*last->second);
+      if (superseded->op() == PendingOperation::COOKIE_ADD) {
+        if (op == PendingOperation::COOKIE_DELETE) {
+          // The cookie never reached the database.
+          pending_.erase(last->second);
+          last_pending_.erase(last);
+          --num_pending_;
+          return;
+        }
+        // The cookie is still to be inserted, with the new access time.
+        po->set_op(PendingOperation::COOKIE_ADD);
+      }
+      *last->second = po.release();
+      return;
+    }
+
+    last_pending_[cc.CreationDate().ToInternalValue()] =
+        pending_.insert(pending_.end(), po.release());
     num_pending = ++num_pending_;
   }
 
@@ -874,6 +913,7 @@ void SQLitePersistentCookieStore::Backend::Commit() {
     base::AutoLock locked(lock_);
     pending_.swap(ops);
     num_pending_ = 0;
+    last_pending_.clear();
   }
 
   // Maybe an old timer fired or we are already Close()'ed.
@@ -2,10 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <vector>
+
 #include "base/bind.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/message_loop.h"
 #include "base/perftimer.h"
+#include "base/stl_util.h"
 #include "base/stringprintf.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/test/thread_test_helper.h"
@@ -67,6 +70,7 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
                 t, t, t, false, false));
       }
     }
+    last_creation_time_ = t;
     // Replace the store effectively destroying the current one and forcing it
     // to write its data to disk.
     store_ = NULL;
@@ -86,6 +90,9 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
   base::WaitableEvent loaded_event_;
   base::WaitableEvent key_loaded_event_;
   std::vector<net::CanonicalCookie*> cookies_;
+  // The creation time of the last cookie SetUp() added. Creation times are
+  // the cookies' keys, so later cookies must be created after it.
+  base::Time last_creation_time_;
   base::ScopedTempDir temp_dir_;
   scoped_refptr<SQLitePersistentCookieStore> store_;
 };
@@ -114,3 +121,69 @@ TEST_F(SQLitePersistentCookieStorePerfTest, TestLoadPerformance) {
 
   ASSERT_EQ(15000U, cookies_.size());
 }
+
+// Test the performance of writing cookie churn like that of a few
+// cookie-heavy sites being used for a while.  Each visit to a site overwrites
+// some of its cookies, which deletes the old cookie and adds a new one, and
+// updates the access time of the rest.
+TEST_F(SQLitePersistentCookieStorePerfTest, TestChurnPerformance) {
+  static const int kSites = 10;
+  static const int kVisits = 1000;
+  static const int kOverwriteInterval = 5;
+
+  Load();
+  ASSERT_EQ(15000U, cookies_.size());
+  std::vector<net::CanonicalCookie*> loaded;
+  loaded.swap(cookies_);
+
+  // The cookies of the first |kSites| domains, which the visits churn.
+  std::vector<std::vector<net::CanonicalCookie> > site_cookies(kSites);
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    for (int site = 0; site < kSites; ++site) {
+      if (loaded[i]->Domain() == base::StringPrintf(".domain_%d.com", site))
+        site_cookies[site].push_back(*loaded[i]);
+    }
+  }
+  STLDeleteElements(&loaded);
+
+  PerfTimeLogger timer("Write cookie churn");
+  base::Time t = last_creation_time_;
+  for (int visit = 0; visit < kVisits; ++visit) {
+    std::vector<net::CanonicalCookie>& cookies = site_cookies[visit % kSites];
+    for (size_t i = 0; i < cookies.size(); ++i) {
+      t += base::TimeDelta::FromInternalValue(10);
+      const net::CanonicalCookie& old_cookie = cookies[i];
+      if (i % kOverwriteInterval == 0) {
+        net::CanonicalCookie new_cookie(
+            GURL(), old_cookie.Name(), base::StringPrintf("%d", visit),
+            old_cookie.Domain(), old_cookie.Path(), std::string(),
+            std::string(), t, t + base::TimeDelta::FromDays(365), t,
+            false, false);
+        store_->DeleteCookie(old_cookie);
+        store_->AddCookie(new_cookie);
+        cookies[i] = new_cookie;
+      } else {
+        net::CanonicalCookie accessed_cookie(
+            GURL(), old_cookie.Name(), old_cookie.Value(),
+            old_cookie.Domain(), old_cookie.Path(), std::string(),
+            std::string(), old_cookie.CreationDate(),
+            old_cookie.ExpiryDate(), t, false, false);
+        store_->UpdateCookieAccessTime(accessed_cookie);
+        cookies[i] = accessed_cookie;
+      }
+    }
+  }
+  store_->Flush(base::Closure());
+  scoped_refptr<base::ThreadTestHelper> helper(
+      new base::ThreadTestHelper(
+          BrowserThread::GetMessageLoopProxyForThread(BrowserThread::DB)));
+  ASSERT_TRUE(helper->Run());
+  timer.Done();
+
+  // Every cookie is still there, once.
+  store_ = new SQLitePersistentCookieStore(
+      temp_dir_.path().Append(chrome::kCookieFilename), false, NULL);
+  Load();
+  ASSERT_EQ(15000U, cookies_.size());
+  STLDeleteElements(&cookies_);
+}
@@ -186,6 +186,57 @@ TEST_F(SQLitePersistentCookieStoreTest, TestPersistance) {
   ASSERT_EQ(0U, cookies.size());
 }
 
+// Test that operations on cookies which haven't been written yet are folded
+// together with the same result as writing each of them.
+TEST_F(SQLitePersistentCookieStoreTest, TestCoalescePendingOperations) {
+  InitializeStore(false);
+  const base::Time t = base::Time::Now();
+  const base::Time later = t + base::TimeDelta::FromMinutes(1);
+
+  // An added cookie whose access time is updated is added with the new time.
+  AddCookie("A", "B", "foo.bar", "/", t);
+  store_->UpdateCookieAccessTime(
+      net::CanonicalCookie(GURL(), "A", "B", "foo.bar", "/", std::string(),
+                           std::string(), t, t, later, false, false));
+  // An added cookie which is deleted again is never written.
+  const base::Time t2 = t + base::TimeDelta::FromInternalValue(10);
+  AddCookie("C", "D", "foo.bar", "/", t2);
+  store_->DeleteCookie(
+      net::CanonicalCookie(GURL(), "C", "D", "foo.bar", "/", std::string(),
+                           std::string(), t2, t2, t2, false, false));
+  const base::Time t3 = t2 + base::TimeDelta::FromInternalValue(10);
+  AddCookie("E", "F", "foo.bar", "/", t3);
+  DestroyStore();
+
+  CanonicalCookieVector cookies;
+  CreateAndLoad(false, &cookies);
+  ASSERT_EQ(2U, cookies.size());
+  std::map<std::string, net::CanonicalCookie*> cookie_map;
+  for (CanonicalCookieVector::const_iterator it = cookies.begin();
+       it != cookies.end(); ++it) {
+    cookie_map[(*it)->Name()] = *it;
+  }
+  ASSERT_TRUE(cookie_map.find("A") != cookie_map.end());
+  EXPECT_EQ(later, cookie_map["A"]->LastAccessDate());
+  ASSERT_TRUE(cookie_map.find("E") != cookie_map.end());
+
+  // A stored cookie whose access time is updated and which is then deleted
+  // is deleted.
+  store_->UpdateCookieAccessTime(
+      net::CanonicalCookie(GURL(), "A", "B", "foo.bar", "/", std::string(),
+                           std::string(), t, t,
+                           later + base::TimeDelta::FromMinutes(1),
+                           false, false));
+  store_->DeleteCookie(*cookie_map["A"]);
+  DestroyStore();
+  STLDeleteElements(&cookies);
+
+  CreateAndLoad(false, &cookies);
+  ASSERT_EQ(1U, cookies.size());
+  EXPECT_EQ("E", cookies[0]->Name());
+  STLDeleteElements(&cookies);
+}
+
 // Test that priority load of cookies for a specfic domain key could be
 // completed before the entire store is loaded
 TEST_F(SQLitePersistentCookieStoreTest, TestLoadCookiesForKey) {
@@ -176,6 +176,14 @@ void UrlInfo::SetNoSuchNameState() {
   DLogResultsStats("DNS PrefetchNotFound");
 }
 
+TimeDelta UrlInfo::ExpectedResolveDuration(TimeDelta default_duration) const {
+  // A quicker lookup was answered from a cache, which has expired since if
+  // the host is being looked up again.
+  if (resolve_duration_ < MaxNonNetworkDnsLookupDuration())
+    return default_duration;
+  return resolve_duration_;
+}
+
 void UrlInfo::SetUrl(const GURL& url) {
   if (url_.is_empty())  // Not yet initialized.
     url_ = url;
@@ -119,6 +119,12 @@ class UrlInfo {
   base::TimeDelta resolve_duration() const { return resolve_duration_;}
   base::TimeDelta queue_duration() const { return queue_duration_;}
 
+  // How long a new lookup of this host is expected to take: as long as its
+  // last lookup if that went to the network, and |default_duration| if it
+  // didn't or there was none.  Only meaningful before the host is queued.
+  base::TimeDelta ExpectedResolveDuration(
+      base::TimeDelta default_duration) const;
+
   void DLogResultsStats(const char* message) const;
 
   static void GetHtmlTable(const UrlInfoTable& host_infos,
@@ -0,0 +1,158 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/safe_browsing/bucketed_prefix_set.h"
+
+#include <algorithm>
+
+#include "base/cpu.h"
+#include "base/logging.h"
+
+#if defined(ARCH_CPU_HAS_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The number of buckets, one for each value of the high 16 bits.
+const size_t kBucketCount = 1 << 16;
+
+// The number of prefixes whose buckets |ExistsMany()| finds before
+// scanning any of them.
+const size_t kBatchSize = 32;
+
+uint32 BucketOf(SBPrefix prefix) {
+  return static_cast<uint32>(prefix) >> 16;
+}
+
+uint16 LowOf(SBPrefix prefix) {
+  return static_cast<uint16>(prefix);
+}
+
+}  // namespace
+
+namespace safe_browsing {
+
+BucketedPrefixSet::BucketedPrefixSet(
+    const std::vector<SBPrefix>& sorted_prefixes) {
+  if (sorted_prefixes.empty())
+    return;
+
+  // Count the distinct prefixes in each bucket.  |bucket_starts_| is
+  // filled with the counts shifted up by one, so that summing them in
+  // place leaves the start of each bucket.
+  bucket_starts_.resize(kBucketCount + 1, 0);
+  size_t unique_count = 0;
+  for (size_t i = 0; i < sorted_prefixes.size(); ++i) {
+    // Skip duplicates.
+    if (i > 0 && sorted_prefixes[i] == sorted_prefixes[i - 1])
+      continue;
+    DCHECK(i == 0 || sorted_prefixes[i] > sorted_prefixes[i - 1]);
+    ++bucket_starts_[BucketOf(sorted_prefixes[i]) + 1];
+    ++unique_count;
+  }
+  for (size_t i = 1; i <= kBucketCount; ++i)
+    bucket_starts_[i] += bucket_starts_[i - 1];
+
+  // Prefixes sharing their high bits also share their sign, so the
+  // sorted input leaves the low halves of each bucket in order.
+  lows_.resize(unique_count + kLanes - 1, 0);
+  std::vector<uint32> cursors(bucket_starts_.begin(),
+                              bucket_starts_.end() - 1);
+  for (size_t i = 0; i < sorted_prefixes.size(); ++i) {
+    if (i > 0 && sorted_prefixes[i] == sorted_prefixes[i - 1])
+      continue;
+    lows_[cursors[BucketOf(sorted_prefixes[i])]++] =
+        LowOf(sorted_prefixes[i]);
+  }
+}
+
+BucketedPrefixSet::~BucketedPrefixSet() {}
+
+bool BucketedPrefixSet::Exists(SBPrefix prefix) const {
+  if (bucket_starts_.empty())
+    return false;
+
+  const uint32 bucket = BucketOf(prefix);
+  return BucketContains(bucket_starts_[bucket], bucket_starts_[bucket + 1],
+                        LowOf(prefix));
+}
+
+void BucketedPrefixSet::ExistsMany(const std::vector<SBPrefix>& prefixes,
+                                   std::vector<SBPrefix>* hits) const {
+  if (bucket_starts_.empty())
+    return;
+
+  // Find the buckets of a batch of prefixes before scanning any of
+  // them.  The reads of |bucket_starts_| don't depend on one another,
+  // so the processor can have their cache misses outstanding at once.
+  uint32 begins[kBatchSize];
+  uint32 ends[kBatchSize];
+  for (size_t batch = 0; batch < prefixes.size(); batch += kBatchSize) {
+    const size_t count = std::min(kBatchSize, prefixes.size() - batch);
+    for (size_t i = 0; i < count; ++i) {
+      const uint32 bucket = BucketOf(prefixes[batch + i]);
+      begins[i] = bucket_starts_[bucket];
+      ends[i] = bucket_starts_[bucket + 1];
+    }
+    for (size_t i = 0; i < count; ++i) {
+      const SBPrefix prefix = prefixes[batch + i];
+      if (BucketContains(begins[i], ends[i], LowOf(prefix)))
+        hits->push_back(prefix);
+    }
+  }
+}
+
+void BucketedPrefixSet::GetPrefixes(std::vector<SBPrefix>* prefixes) const {
+  if (bucket_starts_.empty())
+    return;
+
+  prefixes->reserve(prefixes->size() + bucket_starts_.back());
+
+  // The buckets of negative prefixes, whose high bit is set, come
+  // first in sorted order.
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    const uint32 bucket = static_cast<uint32>((i + kBucketCount / 2) %
+                                              kBucketCount);
+    for (uint32 j = bucket_starts_[bucket]; j < bucket_starts_[bucket + 1];
+         ++j) {
+      prefixes->push_back(static_cast<SBPrefix>((bucket << 16) | lows_[j]));
+    }
+  }
+}
+
+size_t BucketedPrefixSet::memory_usage() const {
+  return bucket_starts_.size() * sizeof(bucket_starts_[0]) +
+      lows_.size() * sizeof(lows_[0]);
+}
+
+bool BucketedPrefixSet::BucketContains(uint32 begin,
+                                       uint32 end,
+                                       uint16 low) const {
+#if defined(ARCH_CPU_HAS_SSE2)
+  // Compare |kLanes| low halves at a time.  The padding after |lows_|
+  // keeps the last read in bounds, and lanes past |end| are masked off.
+  const __m128i needle = _mm_set1_epi16(static_cast<short>(low));
+  for (uint32 i = begin; i < end; i += kLanes) {
+    const __m128i lanes = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(&lows_[i]));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(lanes, needle));
+    if (end - i < kLanes)
+      mask &= (1 << (2 * (end - i))) - 1;
+    if (mask)
+      return true;
+  }
+  return false;
+#else
+  // The low halves of a bucket are in order, so stop at the first one
+  // which isn't below |low|.
+  for (uint32 i = begin; i < end; ++i) {
+    if (lows_[i] >= low)
+      return lows_[i] == low;
+  }
+  return false;
+#endif
+}
+
+}  // namespace safe_browsing
@@ -0,0 +1,125 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/safe_browsing/bucketed_prefix_set.h"
+
+#include <algorithm>
+#include <set>
+
+#include "base/rand_util.h"
+#include "chrome/browser/safe_browsing/prefix_set.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Checks that |prefix_set| holds |prefixes| and nothing either side of
+// them, and that |ExistsMany()| agrees with |Exists()|.
+void CheckPrefixes(const safe_browsing::BucketedPrefixSet& prefix_set,
+                   const std::vector<SBPrefix>& prefixes) {
+  std::set<SBPrefix> check(prefixes.begin(), prefixes.end());
+  std::vector<SBPrefix> prefixes_copy;
+  prefix_set.GetPrefixes(&prefixes_copy);
+  ASSERT_EQ(check.size(), prefixes_copy.size());
+  EXPECT_TRUE(std::equal(check.begin(), check.end(), prefixes_copy.begin()));
+
+  std::vector<SBPrefix> probes;
+  std::vector<SBPrefix> expected_hits;
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    const SBPrefix siblings[] = {
+      prefixes[i] - 1, prefixes[i], prefixes[i] + 1,
+    };
+    for (size_t j = 0; j < arraysize(siblings); ++j) {
+      const bool expected = check.count(siblings[j]) > 0;
+      EXPECT_EQ(expected, prefix_set.Exists(siblings[j]));
+      probes.push_back(siblings[j]);
+      if (expected)
+        expected_hits.push_back(siblings[j]);
+    }
+  }
+
+  std::vector<SBPrefix> hits;
+  prefix_set.ExistsMany(probes, &hits);
+  ASSERT_EQ(expected_hits.size(), hits.size());
+  EXPECT_TRUE(std::equal(expected_hits.begin(), expected_hits.end(),
+                         hits.begin()));
+}
+
+// Test that a random input gives the same answers as PrefixSet.
+TEST(BucketedPrefixSetTest, MatchesPrefixSet) {
+  std::vector<SBPrefix> prefixes;
+  for (size_t i = 0; i < 50000; ++i)
+    prefixes.push_back(static_cast<SBPrefix>(base::RandUint64()));
+  std::sort(prefixes.begin(), prefixes.end());
+
+  safe_browsing::BucketedPrefixSet prefix_set(prefixes);
+  CheckPrefixes(prefix_set, prefixes);
+
+  safe_browsing::PrefixSet reference(prefixes);
+  for (size_t i = 0; i < 50000; ++i) {
+    const SBPrefix prefix = static_cast<SBPrefix>(base::RandUint64());
+    EXPECT_EQ(reference.Exists(prefix), prefix_set.Exists(prefix));
+  }
+}
+
+// Test that the empty set doesn't appear to have anything in it.
+TEST(BucketedPrefixSetTest, Empty) {
+  const std::vector<SBPrefix> empty;
+  safe_browsing::BucketedPrefixSet prefix_set(empty);
+  EXPECT_FALSE(prefix_set.Exists(0));
+  EXPECT_FALSE(prefix_set.Exists(-1));
+
+  std::vector<SBPrefix> probes(1, 0);
+  std::vector<SBPrefix> hits;
+  prefix_set.ExistsMany(probes, &hits);
+  EXPECT_TRUE(hits.empty());
+
+  prefix_set.GetPrefixes(&hits);
+  EXPECT_TRUE(hits.empty());
+}
+
+// Duplicates are stored once.
+TEST(BucketedPrefixSetTest, OneElement) {
+  const std::vector<SBPrefix> prefixes(100, 0);
+  safe_browsing::BucketedPrefixSet prefix_set(prefixes);
+  CheckPrefixes(prefix_set, prefixes);
+}
+
+// Edges of the 32-bit integer range, and of the buckets.
+TEST(BucketedPrefixSetTest, IntMinMax) {
+  std::vector<SBPrefix> prefixes;
+
+  // Using bit patterns rather than portable constants because this
+  // really is testing how the entire 32-bit integer range is handled.
+  prefixes.push_back(0x00000000);
+  prefixes.push_back(0x0000FFFF);
+  prefixes.push_back(0x7FFF0000);
+  prefixes.push_back(0x7FFFFFFF);
+  prefixes.push_back(0x80000000);
+  prefixes.push_back(0x8000FFFF);
+  prefixes.push_back(0xFFFF0000);
+  prefixes.push_back(0xFFFFFFFF);
+
+  std::sort(prefixes.begin(), prefixes.end());
+  safe_browsing::BucketedPrefixSet prefix_set(prefixes);
+  CheckPrefixes(prefix_set, prefixes);
+}
+
+// Buckets holding more low halves than are compared at once, some of
+// them in the last bucket, next to the padding.
+TEST(BucketedPrefixSetTest, FullBuckets) {
+  std::vector<SBPrefix> prefixes;
+  for (int i = 0; i < 1000; ++i) {
+    prefixes.push_back(0x12340000 + i * 3);
+    prefixes.push_back(0x12350000 + i * 65);
+    prefixes.push_back(0xFFFF0000 + i * 7);
+  }
+  for (int i = 0; i < 21; ++i)
+    prefixes.push_back(0x00020000 + i);
+
+  std::sort(prefixes.begin(), prefixes.end());
+  safe_browsing::BucketedPrefixSet prefix_set(prefixes);
+  CheckPrefixes(prefix_set, prefixes);
+}
+
+}  // namespace
@@ -20,7 +20,11 @@ namespace {
 static uint32 kMagic = 0x864088dd;
 
 // Current version the code writes out.
-static uint32 kVersion = 0x1;
+static uint32 kVersion = 0x2;
+
+// Version 1 stored |size_t| offsets in the index.  It can be read, but
+// not mapped.
+static uint32 kVersion1 = 0x1;
 
 typedef struct {
   uint32 magic;
@@ -30,16 +34,29 @@ typedef struct {
 } FileHeader;
 
 // For |std::upper_bound()| to find a prefix w/in a vector of pairs.
-bool PrefixLess(const std::pair<SBPrefix,size_t>& a,
-                const std::pair<SBPrefix,size_t>& b) {
+bool PrefixLess(const std::pair<SBPrefix,uint32>& a,
+                const std::pair<SBPrefix,uint32>& b) {
   return a.first < b.first;
 }
 
+// The bytes of a version 2 file with |index_size| index pairs and
+// |deltas_size| deltas.  64-bit so that bogus sizes can't overflow.
+uint64 FileSizeForCounts(uint32 index_size, uint32 deltas_size) {
+  return sizeof(FileHeader) +
+      static_cast<uint64>(index_size) * sizeof(std::pair<SBPrefix,uint32>) +
+      static_cast<uint64>(deltas_size) * sizeof(uint16) +
+      sizeof(base::MD5Digest);
+}
+
 }  // namespace
 
 namespace safe_browsing {
 
-PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
+PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes)
+    : index_data_(NULL),
+      index_size_(0),
+      deltas_data_(NULL),
+      deltas_size_(0) {
   if (sorted_prefixes.size()) {
     // Estimate the resulting vector sizes.  There will be strictly
     // more than |min_runs| entries in |index_|, but there generally
@@ -51,7 +68,8 @@ PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
     // Lead with the first prefix.
     SBPrefix prev_prefix = sorted_prefixes[0];
     size_t run_length = 0;
-    index_.push_back(std::make_pair(prev_prefix, deltas_.size()));
+    index_.push_back(
+        IndexPair(prev_prefix, static_cast<uint32>(deltas_.size())));
 
     for (size_t i = 1; i < sorted_prefixes.size(); ++i) {
       // Skip duplicates.
@@ -67,7 +85,8 @@ PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
       // New index ref if the delta doesn't fit, or if too many
       // consecutive deltas have been encoded.
       if (delta != static_cast<unsigned>(delta16) || run_length >= kMaxRun) {
-        index_.push_back(std::make_pair(sorted_prefixes[i], deltas_.size()));
+        index_.push_back(IndexPair(sorted_prefixes[i],
+                                   static_cast<uint32>(deltas_.size())));
         run_length = 0;
       } else {
         // Continue the run of deltas.
@@ -89,33 +108,56 @@ PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
                               bits_used / unique_prefixes,
                               kMaxBitsPerPrefix);
   }
+  UseVectors();
 }
 
-PrefixSet::PrefixSet(std::vector<std::pair<SBPrefix,size_t> > *index,
+PrefixSet::PrefixSet(std::vector<IndexPair> *index,
                      std::vector<uint16> *deltas) {
   DCHECK(index && deltas);
   index_.swap(*index);
   deltas_.swap(*deltas);
+  UseVectors();
+}
+
+PrefixSet::PrefixSet(file_util::MemoryMappedFile* file,
+                     size_t index_size,
+                     size_t deltas_size)
+    : file_(file),
+      index_data_(reinterpret_cast<const IndexPair*>(
+          file->data() + sizeof(FileHeader))),
+      index_size_(index_size),
+      deltas_data_(reinterpret_cast<const uint16*>(
+          file->data() + sizeof(FileHeader) + index_size * sizeof(IndexPair))),
+      deltas_size_(deltas_size) {
 }
 
 PrefixSet::~PrefixSet() {}
 
+void PrefixSet::UseVectors() {
+  index_data_ = index_.empty() ? NULL : &index_[0];
+  index_size_ = index_.size();
+  deltas_data_ = deltas_.empty() ? NULL : &deltas_[0];
+  deltas_size_ = deltas_.size();
+}
+
 bool PrefixSet::Exists(SBPrefix prefix) const {
-  if (index_.empty())
+  if (!index_size_)
     return false;
 
-  // Find the first position after |prefix| in |index_|.
-  std::vector<std::pair<SBPrefix,size_t> >::const_iterator
-      iter = std::upper_bound(index_.begin(), index_.end(),
-                              std::pair<SBPrefix,size_t>(prefix, 0),
-                              PrefixLess);
+  // Find the first position after |prefix| in the index.
+  const IndexPair* index_end = index_data_ + index_size_;
+  const IndexPair* iter = std::upper_bound(index_data_, index_end,
+                                           IndexPair(prefix, 0), PrefixLess);
 
   // |prefix| comes before anything that's in the set.
-  if (iter == index_.begin())
+  if (iter == index_data_)
     return false;
 
-  // Capture the upper bound of our target entry's deltas.
-  const size_t bound = (iter == index_.end() ? deltas_.size() : iter->second);
+  // Capture the upper bound of our target entry's deltas.  A mapped
+  // file hasn't necessarily been checked, so don't trust it to stay
+  // within the deltas.
+  const size_t bound = (iter == index_end) ? deltas_size_ :
+      std::min(static_cast<size_t>(iter->second), deltas_size_);
 
   // Back up to the entry our target is in.
   --iter;
@@ -127,30 +169,37 @@ bool PrefixSet::Exists(SBPrefix prefix) const {
 
   // Scan forward accumulating deltas while a match is possible.
   for (size_t di = iter->second; di < bound && current < prefix; ++di) {
-    current += deltas_[di];
+    current += deltas_data_[di];
   }
 
   return current == prefix;
 }
 
 void PrefixSet::GetPrefixes(std::vector<SBPrefix>* prefixes) const {
-  prefixes->reserve(index_.size() + deltas_.size());
+  prefixes->reserve(index_size_ + deltas_size_);
 
-  for (size_t ii = 0; ii < index_.size(); ++ii) {
-    // The deltas for this |index_| entry run to the next index entry,
+  for (size_t ii = 0; ii < index_size_; ++ii) {
+    // The deltas for this index entry run to the next index entry,
     // or the end of the deltas.
-    const size_t deltas_end =
-        (ii + 1 < index_.size()) ? index_[ii + 1].second : deltas_.size();
+    const size_t deltas_end = (ii + 1 < index_size_) ?
+        std::min(static_cast<size_t>(index_data_[ii + 1].second),
+                 deltas_size_) :
+        deltas_size_;
 
-    SBPrefix current = index_[ii].first;
+    SBPrefix current = index_data_[ii].first;
     prefixes->push_back(current);
-    for (size_t di = index_[ii].second; di < deltas_end; ++di) {
-      current += deltas_[di];
+    for (size_t di = index_data_[ii].second; di < deltas_end; ++di) {
+      current += deltas_data_[di];
       prefixes->push_back(current);
     }
   }
 }
 
+size_t PrefixSet::memory_usage() const {
+  return index_.size() * sizeof(index_[0]) +
+      deltas_.size() * sizeof(deltas_[0]);
+}
+
 // static
 PrefixSet* PrefixSet::LoadFile(const FilePath& filter_name) {
   int64 size_64;
@@ -169,11 +218,17 @@ PrefixSet* PrefixSet::LoadFile(const FilePath& filter_name) {
   if (read != 1)
     return NULL;
 
-  if (header.magic != kMagic || header.version != kVersion)
+  if (header.magic != kMagic ||
+      (header.version != kVersion && header.version != kVersion1))
     return NULL;
 
-  std::vector<std::pair<SBPrefix,size_t> > index;
-  const size_t index_bytes = sizeof(index[0]) * header.index_size;
+  // Version 1 files are read into |index_v1| and converted after the
+  // digest is checked.
+  std::vector<IndexPair> index;
+  std::vector<std::pair<SBPrefix,size_t> > index_v1;
+  const size_t index_pair_size = (header.version == kVersion1) ?
+      sizeof(index_v1[0]) : sizeof(index[0]);
+  const size_t index_bytes = index_pair_size * header.index_size;
 
   std::vector<uint16> deltas;
   const size_t deltas_bytes = sizeof(deltas[0]) * header.deltas_size;
@@ -193,7 +248,16 @@ PrefixSet* PrefixSet::LoadFile(const FilePath& filter_name) {
   // Read the index vector.  Herb Sutter indicates that vectors are
   // guaranteed to be contiuguous, so reading to where element 0 lives
   // is valid.
-  if (header.index_size) {
+  if (header.index_size && header.version == kVersion1) {
+    index_v1.resize(header.index_size);
+    read = fread(&(index_v1[0]), sizeof(index_v1[0]), index_v1.size(),
+                 file.get());
+    if (read != index_v1.size())
+      return NULL;
+    base::MD5Update(&context,
+                    base::StringPiece(reinterpret_cast<char*>(&(index_v1[0])),
+                                      index_bytes));
+  } else if (header.index_size) {
     index.resize(header.index_size);
     read = fread(&(index[0]), sizeof(index[0]), index.size(), file.get());
     if (read != index.size())
@@ -225,20 +289,63 @@ PrefixSet* PrefixSet::LoadFile(const FilePath& filter_name) {
   if (0 != memcmp(&file_digest, &calculated_digest, sizeof(file_digest)))
     return NULL;
 
+  if (!index_v1.empty()) {
+    index.reserve(index_v1.size());
+    for (size_t i = 0; i < index_v1.size(); ++i) {
+      index.push_back(IndexPair(index_v1[i].first,
+                                static_cast<uint32>(index_v1[i].second)));
+    }
+  }
+
   // Steals contents of |index| and |deltas| via swap().
   return new PrefixSet(&index, &deltas);
 }
 
+// static
+PrefixSet* PrefixSet::MapFile(const FilePath& filter_name) {
+  COMPILE_ASSERT(sizeof(IndexPair) == 2 * sizeof(uint32),
+                 index_pair_is_not_packed);
+
+  scoped_ptr<file_util::MemoryMappedFile> file(
+      new file_util::MemoryMappedFile);
+  if (!file->Initialize(filter_name))
+    return NULL;
+
+  FileHeader header;
+  if (file->length() < sizeof(header) + sizeof(base::MD5Digest))
+    return NULL;
+  memcpy(&header, file->data(), sizeof(header));
+  if (header.magic != kMagic || header.version != kVersion)
+    return NULL;
+
+  if (FileSizeForCounts(header.index_size, header.deltas_size) !=
+      file->length())
+    return NULL;
+
+  return new PrefixSet(file.release(), header.index_size, header.deltas_size);
+}
+
+bool PrefixSet::VerifyChecksum() const {
+  if (!is_mapped())
+    return true;
+
+  const size_t payload_bytes = file_->length() - sizeof(base::MD5Digest);
+  base::MD5Digest calculated_digest;
+  base::MD5Sum(file_->data(), payload_bytes, &calculated_digest);
+  return 0 == memcmp(file_->data() + payload_bytes, &calculated_digest,
+                     sizeof(calculated_digest));
+}
+
 bool PrefixSet::WriteFile(const FilePath& filter_name) const {
   FileHeader header;
   header.magic = kMagic;
   header.version = kVersion;
-  header.index_size = static_cast<uint32>(index_.size());
-  header.deltas_size = static_cast<uint32>(deltas_.size());
+  header.index_size = static_cast<uint32>(index_size_);
+  header.deltas_size = static_cast<uint32>(deltas_size_);
 
   // Sanity check that the 32-bit values never mess things up.
-  if (static_cast<size_t>(header.index_size) != index_.size() ||
-      static_cast<size_t>(header.deltas_size) != deltas_.size()) {
+  if (static_cast<size_t>(header.index_size) != index_size_ ||
+      static_cast<size_t>(header.deltas_size) != deltas_size_) {
     NOTREACHED();
     return false;
   }
@@ -260,27 +367,27 @@ bool PrefixSet::WriteFile(const FilePath& filter_name) const {
 
   // As for reads, the standard guarantees the ability to access the
   // contents of the vector by a pointer to an element.
-  if (index_.size()) {
-    const size_t index_bytes = sizeof(index_[0]) * index_.size();
-    written = fwrite(&(index_[0]), sizeof(index_[0]), index_.size(),
+  if (index_size_) {
+    const size_t index_bytes = sizeof(index_data_[0]) * index_size_;
+    written = fwrite(index_data_, sizeof(index_data_[0]), index_size_,
                      file.get());
-    if (written != index_.size())
+    if (written != index_size_)
       return false;
     base::MD5Update(&context,
                     base::StringPiece(
-                        reinterpret_cast<const char*>(&(index_[0])),
+                        reinterpret_cast<const char*>(index_data_),
                         index_bytes));
   }
 
-  if (deltas_.size()) {
-    const size_t deltas_bytes = sizeof(deltas_[0]) * deltas_.size();
-    written = fwrite(&(deltas_[0]), sizeof(deltas_[0]), deltas_.size(),
+  if (deltas_size_) {
+    const size_t deltas_bytes = sizeof(deltas_data_[0]) * deltas_size_;
+    written = fwrite(deltas_data_, sizeof(deltas_data_[0]), deltas_size_,
                      file.get());
-    if (written != deltas_.size())
+    if (written != deltas_size_)
       return false;
     base::MD5Update(&context,
                     base::StringPiece(
-                        reinterpret_cast<const char*>(&(deltas_[0])),
+                        reinterpret_cast<const char*>(deltas_data_),
                         deltas_bytes));
   }
 
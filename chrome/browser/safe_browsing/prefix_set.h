@@ -45,16 +45,27 @@
 //     n * 8 byte |&index_[0]..&index_[n]|
 //     m * 2 byte |&deltas_[0]..&deltas_[m]|
 //        16 byte digest
+//
+// Each |index_| entry is a 4-byte prefix and a 4-byte offset into
+// |deltas_|, the same on disk as in memory, so that a mapped file can
+// be queried in place.  Version 1 files stored the offset as a
+// |size_t|, which is 8 bytes on 64-bit builds; |LoadFile()| still
+// reads them.
 
 #ifndef CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
 #define CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
 
 #include <vector>
 
+#include "base/memory/scoped_ptr.h"
 #include "chrome/browser/safe_browsing/safe_browsing_util.h"
 
 class FilePath;
 
+namespace file_util {
+class MemoryMappedFile;
+}
+
 namespace safe_browsing {
 
 class PrefixSet {
@@ -65,36 +76,79 @@ class PrefixSet {
   // |true| if |prefix| was in |prefixes| passed to the constructor.
   bool Exists(SBPrefix prefix) const;
 
-  // Persist the set on disk.
+  // Persist the set on disk.  |LoadFile()| reads all of the file and
+  // checks its digest before returning.
   static PrefixSet* LoadFile(const FilePath& filter_name);
   bool WriteFile(const FilePath& filter_name) const;
 
+  // Maps |filter_name| and returns a set which is queried in place,
+  // having checked only the header and the file's size.  Returns NULL
+  // if the file can't be mapped or isn't in the current format, in
+  // which case |LoadFile()| may still read it.  Until
+  // |VerifyChecksum()| passes, lookups may give wrong answers, though
+  // they stay within the mapping.  The file must not be written while
+  // the set is alive.
+  static PrefixSet* MapFile(const FilePath& filter_name);
+
+  // |true| if the set was returned by |MapFile()|.
+  bool is_mapped() const { return file_.get() != NULL; }
+
+  // Checks the digest of a mapped set's file.  Sets which aren't
+  // mapped were checked when they were read, and always pass.
+  bool VerifyChecksum() const;
+
   // Regenerate the vector of prefixes passed to the constructor into
   // |prefixes|.  Prefixes will be added in sorted order.
   void GetPrefixes(std::vector<SBPrefix>* prefixes) const;
 
+  // The bytes of heap used by the set.  A mapped set's data is in the
+  // pages of its file, and isn't counted.
+  size_t memory_usage() const;
+
  private:
   // Maximum number of consecutive deltas to encode before generating
   // a new index entry.  This helps keep the worst-case performance
   // for |Exists()| under control.
   static const size_t kMaxRun = 100;
 
+  typedef std::pair<SBPrefix,uint32> IndexPair;
+
   // Helper for |LoadFile()|.  Steals the contents of |index| and
   // |deltas| using |swap()|.
-  PrefixSet(std::vector<std::pair<SBPrefix,size_t> > *index,
-            std::vector<uint16> *deltas);
+  PrefixSet(std::vector<IndexPair> *index, std::vector<uint16> *deltas);
+
+  // Helper for |MapFile()|.  Takes ownership of |file|, which holds
+  // |index_size| index pairs and |deltas_size| deltas after the
+  // header.
+  PrefixSet(file_util::MemoryMappedFile* file,
+            size_t index_size,
+            size_t deltas_size);
+
+  // Points |index_data_| and |deltas_data_| at |index_| and |deltas_|.
+  void UseVectors();
 
   // Top-level index of prefix to offset in |deltas_|.  Each pair
   // indicates a base prefix and where the deltas from that prefix
   // begin in |deltas_|.  The deltas for a pair end at the next pair's
   // index into |deltas_|.
-  std::vector<std::pair<SBPrefix,size_t> > index_;
+  std::vector<IndexPair> index_;
 
   // Deltas which are added to the prefix in |index_| to generate
   // prefixes.  Deltas are only valid between consecutive items from
   // |index_|, or the end of |deltas_| for the last |index_| pair.
   std::vector<uint16> deltas_;
 
+  // The file a mapped set's index and deltas are in, in which case
+  // |index_| and |deltas_| are empty.
+  scoped_ptr<file_util::MemoryMappedFile> file_;
+
+  // Where lookups find the index and deltas, either in |index_| and
+  // |deltas_| or in |file_|.
+  const IndexPair* index_data_;
+  size_t index_size_;
+  const uint16* deltas_data_;
+  size_t deltas_size_;
+
   DISALLOW_COPY_AND_ASSIGN(PrefixSet);
 };
 
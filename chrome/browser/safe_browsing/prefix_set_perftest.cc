@@ -0,0 +1,138 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/rand_util.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "chrome/browser/safe_browsing/bucketed_prefix_set.h"
+#include "chrome/browser/safe_browsing/prefix_set.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// A browse list somewhat larger than today's.
+const size_t kPrefixCount = 1000 * 1000;
+
+// The lookups timed, in groups of the prefixes checked for one URL: a
+// few hosts times a few paths.
+const size_t kLookupCount = 3 * 1000 * 1000;
+const size_t kPrefixesPerURL = 30;
+
+// One lookup in this many is of a prefix in the set.
+const size_t kHitInterval = 100;
+
+// Logs the rate of |kLookupCount| lookups taking |elapsed|.
+void LogLookupRate(const char* name, base::TimeDelta elapsed) {
+  LogPerfResult(base::StringPrintf("SB2_Lookups_%s", name).c_str(),
+                kLookupCount / elapsed.InSecondsF(), "lookups/s");
+}
+
+}  // namespace
+
+// Compares the memory used by PrefixSet and BucketedPrefixSet for a
+// large random set, and the rate of lookups on each, one at a time and
+// a URL's worth at once.
+TEST(PrefixSetPerfTest, BucketedAgainstPrefixSet) {
+  std::vector<SBPrefix> prefixes;
+  prefixes.reserve(kPrefixCount);
+  for (size_t i = 0; i < kPrefixCount; ++i)
+    prefixes.push_back(static_cast<SBPrefix>(base::RandUint64()));
+  std::sort(prefixes.begin(), prefixes.end());
+
+  std::vector<SBPrefix> probes;
+  probes.reserve(kLookupCount);
+  for (size_t i = 0; i < kLookupCount; ++i) {
+    if (i % kHitInterval == 0)
+      probes.push_back(prefixes[base::RandGenerator(prefixes.size())]);
+    else
+      probes.push_back(static_cast<SBPrefix>(base::RandUint64()));
+  }
+
+  safe_browsing::PrefixSet prefix_set(prefixes);
+  safe_browsing::BucketedPrefixSet bucketed_prefix_set(prefixes);
+  LogPerfResult("SB2_Memory_prefix_set", prefix_set.memory_usage() / 1024,
+                "kb");
+  LogPerfResult("SB2_Memory_bucketed",
+                bucketed_prefix_set.memory_usage() / 1024, "kb");
+
+  size_t prefix_set_hits = 0;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (size_t i = 0; i < probes.size(); ++i) {
+    if (prefix_set.Exists(probes[i]))
+      ++prefix_set_hits;
+  }
+  LogLookupRate("prefix_set", base::TimeTicks::HighResNow() - start);
+
+  size_t bucketed_hits = 0;
+  start = base::TimeTicks::HighResNow();
+  for (size_t i = 0; i < probes.size(); ++i) {
+    if (bucketed_prefix_set.Exists(probes[i]))
+      ++bucketed_hits;
+  }
+  LogLookupRate("bucketed", base::TimeTicks::HighResNow() - start);
+  EXPECT_EQ(prefix_set_hits, bucketed_hits);
+
+  std::vector<SBPrefix> url_prefixes;
+  std::vector<SBPrefix> hits;
+  start = base::TimeTicks::HighResNow();
+  for (size_t i = 0; i < probes.size(); i += kPrefixesPerURL) {
+    url_prefixes.assign(
+        probes.begin() + i,
+        probes.begin() + std::min(i + kPrefixesPerURL, probes.size()));
+    bucketed_prefix_set.ExistsMany(url_prefixes, &hits);
+  }
+  LogLookupRate("bucketed_many", base::TimeTicks::HighResNow() - start);
+  EXPECT_EQ(bucketed_hits, hits.size());
+}
+
+// Compares the time from opening a large prefix set file to the first
+// lookup when the file is read and when it is mapped, and logs how long
+// the deferred check of a mapped file takes.
+TEST(PrefixSetPerfTest, MapAgainstLoadFile) {
+  std::vector<SBPrefix> prefixes;
+  prefixes.reserve(kPrefixCount);
+  for (size_t i = 0; i < kPrefixCount; ++i)
+    prefixes.push_back(static_cast<SBPrefix>(base::RandUint64()));
+  std::sort(prefixes.begin(), prefixes.end());
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const FilePath filename = temp_dir.path().AppendASCII("PrefixSet");
+  {
+    safe_browsing::PrefixSet prefix_set(prefixes);
+    ASSERT_TRUE(prefix_set.WriteFile(filename));
+  }
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  scoped_ptr<safe_browsing::PrefixSet> loaded(
+      safe_browsing::PrefixSet::LoadFile(filename));
+  ASSERT_TRUE(loaded.get());
+  EXPECT_TRUE(loaded->Exists(prefixes[0]));
+  LogPerfResult("SB2_FirstLookup_load",
+                (base::TimeTicks::HighResNow() - start).InMillisecondsF(),
+                "ms");
+  loaded.reset();
+
+  start = base::TimeTicks::HighResNow();
+  scoped_ptr<safe_browsing::PrefixSet> mapped(
+      safe_browsing::PrefixSet::MapFile(filename));
+  ASSERT_TRUE(mapped.get());
+  EXPECT_TRUE(mapped->Exists(prefixes[0]));
+  LogPerfResult("SB2_FirstLookup_map",
+                (base::TimeTicks::HighResNow() - start).InMillisecondsF(),
+                "ms");
+
+  start = base::TimeTicks::HighResNow();
+  EXPECT_TRUE(mapped->VerifyChecksum());
+  LogPerfResult("SB2_VerifyChecksum",
+                (base::TimeTicks::HighResNow() - start).InMillisecondsF(),
+                "ms");
+}
@@ -464,4 +464,136 @@ TEST_F(PrefixSetTest, CorruptionExcess) {
   ASSERT_FALSE(prefix_set.get());
 }
 
+// Test that a mapped file gives the same answers as the set written.
+TEST_F(PrefixSetTest, MapFile) {
+  FilePath filename;
+  ASSERT_TRUE(GetPrefixSetFile(&filename));
+
+  scoped_ptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::MapFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+  EXPECT_TRUE(prefix_set->is_mapped());
+  EXPECT_TRUE(prefix_set->VerifyChecksum());
+  EXPECT_EQ(0U, prefix_set->memory_usage());
+  CheckPrefixes(*prefix_set, shared_prefixes_);
+
+  // A mapped set can be written elsewhere.
+  const FilePath written_filename =
+      filename.DirName().AppendASCII("PrefixSetTestCopy");
+  ASSERT_TRUE(prefix_set->WriteFile(written_filename));
+  prefix_set.reset(safe_browsing::PrefixSet::LoadFile(written_filename));
+  ASSERT_TRUE(prefix_set.get());
+  EXPECT_FALSE(prefix_set->is_mapped());
+  EXPECT_TRUE(prefix_set->VerifyChecksum());
+  CheckPrefixes(*prefix_set, shared_prefixes_);
+
+  // The empty set.
+  const std::vector<SBPrefix> empty;
+  ASSERT_TRUE(safe_browsing::PrefixSet(empty).WriteFile(filename));
+  prefix_set.reset(safe_browsing::PrefixSet::MapFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+  EXPECT_TRUE(prefix_set->VerifyChecksum());
+  CheckPrefixes(*prefix_set, empty);
+}
+
+// Test that corruption in the payload is only caught by the checksum,
+// and that lookups in the corrupt set stay within the file.
+TEST_F(PrefixSetTest, MapFileCorruptPayload) {
+  FilePath filename;
+  ASSERT_TRUE(GetPrefixSetFile(&filename));
+
+  // Make the second index pair point past the end of the deltas.
+  file_util::ScopedFILE file(file_util::OpenFile(filename, "r+b"));
+  ASSERT_NO_FATAL_FAILURE(IncrementIntAt(
+      file.get(), kPayloadOffset + 3 * sizeof(uint32), 1000 * 1000));
+  file.reset();
+
+  scoped_ptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::MapFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+  EXPECT_FALSE(prefix_set->VerifyChecksum());
+  for (size_t i = 0; i < shared_prefixes_.size(); ++i)
+    prefix_set->Exists(shared_prefixes_[i]);
+  std::vector<SBPrefix> prefixes;
+  prefix_set->GetPrefixes(&prefixes);
+
+  // The reading path doesn't accept the file either.
+  prefix_set.reset(safe_browsing::PrefixSet::LoadFile(filename));
+  EXPECT_FALSE(prefix_set.get());
+}
+
+// Test that a file whose sizes don't match its header isn't mapped.
+TEST_F(PrefixSetTest, MapFileCorruptSizes) {
+  FilePath filename;
+  ASSERT_TRUE(GetPrefixSetFile(&filename));
+
+  ASSERT_NO_FATAL_FAILURE(
+      ModifyAndCleanChecksum(filename, kDeltasSizeOffset, 1));
+  scoped_ptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::MapFile(filename));
+  EXPECT_FALSE(prefix_set.get());
+
+  ASSERT_TRUE(GetPrefixSetFile(&filename));
+  ASSERT_NO_FATAL_FAILURE(
+      ModifyAndCleanChecksum(filename, kIndexSizeOffset, -1));
+  prefix_set.reset(safe_browsing::PrefixSet::MapFile(filename));
+  EXPECT_FALSE(prefix_set.get());
+
+  // Missing files aren't mapped, either.
+  prefix_set.reset(safe_browsing::PrefixSet::MapFile(
+      filename.DirName().AppendASCII("Missing")));
+  EXPECT_FALSE(prefix_set.get());
+}
+
+// Test that version 1 files, with |size_t| offsets in the index, are
+// read but not mapped.
+TEST_F(PrefixSetTest, Version1) {
+  ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  const FilePath filename = temp_dir_.path().AppendASCII("PrefixSetTest");
+
+  // The example from prefix_set.h.
+  std::vector<SBPrefix> prefixes;
+  prefixes.push_back(20);
+  prefixes.push_back(25);
+  prefixes.push_back(41);
+  prefixes.push_back(65432);
+  prefixes.push_back(150000);
+  prefixes.push_back(160000);
+  const std::pair<SBPrefix,size_t> index[] = {
+    std::pair<SBPrefix,size_t>(20, 0),
+    std::pair<SBPrefix,size_t>(150000, 3),
+  };
+  const uint16 deltas[] = { 5, 16, 65391, 10000 };
+
+  const uint32 kMagic = 0x864088dd;
+  const uint32 kVersion1 = 0x1;
+  const uint32 header[] = {
+    kMagic, kVersion1, arraysize(index), arraysize(deltas),
+  };
+  const base::MD5Digest digest = base::MD5Digest();
+
+  file_util::ScopedFILE file(file_util::OpenFile(filename, "w+b"));
+  ASSERT_EQ(1U, fwrite(header, sizeof(header), 1, file.get()));
+  ASSERT_EQ(1U, fwrite(index, sizeof(index), 1, file.get()));
+  ASSERT_EQ(1U, fwrite(deltas, sizeof(deltas), 1, file.get()));
+  ASSERT_EQ(1U, fwrite(&digest, sizeof(digest), 1, file.get()));
+  ASSERT_NO_FATAL_FAILURE(CleanChecksum(file.get()));
+  file.reset();
+
+  scoped_ptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::MapFile(filename));
+  EXPECT_FALSE(prefix_set.get());
+
+  prefix_set.reset(safe_browsing::PrefixSet::LoadFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+  CheckPrefixes(*prefix_set, prefixes);
+
+  // Writing it out again upgrades it.
+  ASSERT_TRUE(prefix_set->WriteFile(filename));
+  prefix_set.reset(safe_browsing::PrefixSet::MapFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+  EXPECT_TRUE(prefix_set->VerifyChecksum());
+  CheckPrefixes(*prefix_set, prefixes);
+}
+
 }  // namespace
@@ -8,14 +8,17 @@
 #include <iterator>
 
 #include "base/bind.h"
+#include "base/command_line.h"
 #include "base/file_util.h"
 #include "base/message_loop.h"
 #include "base/metrics/histogram.h"
 #include "base/metrics/stats_counters.h"
 #include "base/process_util.h"
 #include "base/time.h"
+#include "chrome/browser/safe_browsing/bucketed_prefix_set.h"
 #include "chrome/browser/safe_browsing/prefix_set.h"
 #include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
+#include "chrome/common/chrome_switches.h"
 #include "content/public/browser/browser_thread.h"
 #include "crypto/sha2.h"
 #include "googleurl/src/gurl.h"
@@ -51,6 +54,10 @@ const FilePath::CharType kBrowseDBFile[] = FILE_PATH_LITERAL(" Bloom");
 // The maximum staleness for a cached entry.
 const int kMaxStalenessMinutes = 45;
 
+// How long after startup a mapped prefix set's checksum is verified,
+// to keep its reads out of the way of the rest of startup.
+const int kPrefixSetVerifyDelaySeconds = 10;
+
 // Maximum number of entries we allow in any of the whitelists.
 // If a whitelist on disk contains more entries then all lookups to
 // the whitelist will be considered a match.
@@ -272,6 +279,11 @@ int64 GetFileSizeOrZero(const FilePath& file_path) {
   return size_64;
 }
 
+bool UseBucketedPrefixSet() {
+  return CommandLine::ForCurrentProcess()->HasSwitch(
+      switches::kEnableBucketedPrefixSet);
+}
+
 }  // namespace
 
 // The default SafeBrowsingDatabaseFactory.
@@ -379,7 +391,8 @@ SafeBrowsingDatabaseNew::SafeBrowsingDatabaseNew()
       download_store_(NULL),
       csd_whitelist_store_(NULL),
       download_whitelist_store_(NULL),
-      ALLOW_THIS_IN_INITIALIZER_LIST(reset_factory_(this)) {
+      ALLOW_THIS_IN_INITIALIZER_LIST(reset_factory_(this)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(verify_factory_(this)) {
   DCHECK(browse_store_.get());
   DCHECK(!download_store_.get());
   DCHECK(!csd_whitelist_store_.get());
@@ -397,6 +410,7 @@ SafeBrowsingDatabaseNew::SafeBrowsingDatabaseNew(
       csd_whitelist_store_(csd_whitelist_store),
       download_whitelist_store_(download_whitelist_store),
       ALLOW_THIS_IN_INITIALIZER_LIST(reset_factory_(this)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(verify_factory_(this)),
       corruption_detected_(false) {
   DCHECK(browse_store_.get());
 }
@@ -481,6 +495,13 @@ void SafeBrowsingDatabaseNew::Init(const FilePath& filename_base) {
 bool SafeBrowsingDatabaseNew::ResetDatabase() {
   DCHECK_EQ(creation_loop_, MessageLoop::current());
 
+  // A mapped prefix set holds its file open, which on Windows keeps it
+  // from being deleted.
+  if (prefix_set_.get() && prefix_set_->is_mapped()) {
+    base::AutoLock locked(lookup_lock_);
+    prefix_set_.reset();
+  }
+
   // Delete files on disk.
   // TODO(shess): Hard to see where one might want to delete without a
   // reset.  Perhaps inline |Delete()|?
@@ -494,6 +515,7 @@ bool SafeBrowsingDatabaseNew::ResetDatabase() {
     pending_browse_hashes_.clear();
     prefix_miss_cache_.clear();
     prefix_set_.reset();
+    bucketed_prefix_set_.reset();
   }
   // Wants to acquire the lock itself.
   WhitelistEverything(&csd_whitelist_);
@@ -523,20 +545,29 @@ bool SafeBrowsingDatabaseNew::ContainsBrowseUrl(
   // filter and caches.
   base::AutoLock locked(lookup_lock_);
 
-  // |prefix_set_| is empty until it is either read from disk, or the
-  // first update populates it.  Bail out without a hit if not yet
-  // available.
-  if (!prefix_set_.get())
+  // |prefix_set_| or |bucketed_prefix_set_| is empty until it is
+  // either read from disk, or the first update populates it.  Bail out
+  // without a hit if not yet available.
+  if (bucketed_prefix_set_.get()) {
+    std::vector<SBPrefix> prefixes;
+    prefixes.reserve(full_hashes.size());
+    for (size_t i = 0; i < full_hashes.size(); ++i)
+      prefixes.push_back(full_hashes[i].prefix);
+    bucketed_prefix_set_->ExistsMany(prefixes, prefix_hits);
+  } else if (prefix_set_.get()) {
+    for (size_t i = 0; i < full_hashes.size(); ++i) {
+      const SBPrefix prefix = full_hashes[i].prefix;
+      if (prefix_set_->Exists(prefix))
+        prefix_hits->push_back(prefix);
+    }
+  } else {
     return false;
+  }
 
   size_t miss_count = 0;
-  for (size_t i = 0; i < full_hashes.size(); ++i) {
-    const SBPrefix prefix = full_hashes[i].prefix;
-    if (prefix_set_->Exists(prefix)) {
-      prefix_hits->push_back(prefix);
-      if (prefix_miss_cache_.count(prefix) > 0)
-        ++miss_count;
-    }
+  for (size_t i = 0; i < prefix_hits->size(); ++i) {
+    if (prefix_miss_cache_.count((*prefix_hits)[i]) > 0)
+      ++miss_count;
   }
 
   // If all the prefixes are cached as 'misses', don't issue a GetHash.
@@ -1134,6 +1165,9 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
   std::sort(prefixes.begin(), prefixes.end());
   scoped_ptr<safe_browsing::PrefixSet>
       prefix_set(new safe_browsing::PrefixSet(prefixes));
+  scoped_ptr<safe_browsing::BucketedPrefixSet> bucketed_prefix_set;
+  if (UseBucketedPrefixSet())
+    bucketed_prefix_set.reset(new safe_browsing::BucketedPrefixSet(prefixes));
 
   // This needs to be in sorted order by prefix for efficient access.
   std::sort(add_full_hashes.begin(), add_full_hashes.end(),
@@ -1151,7 +1185,10 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
     // hash will be fetched again).
     pending_browse_hashes_.clear();
     prefix_miss_cache_.clear();
-    prefix_set_.swap(prefix_set);
+    if (bucketed_prefix_set.get())
+      bucketed_prefix_set_.swap(bucketed_prefix_set);
+    else
+      prefix_set_.swap(prefix_set);
   }
 
   DVLOG(1) << "SafeBrowsingDatabaseImpl built prefix set in "
@@ -1160,8 +1197,16 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
   UMA_HISTOGRAM_LONG_TIMES("SB2.BuildFilter", base::TimeTicks::Now() - before);
 
   // Persist the prefix set to disk.  Since only this thread changes
-  // |prefix_set_|, there is no need to lock.
-  WritePrefixSet();
+  // |prefix_set_|, there is no need to lock.  When the bucketed set
+  // answers lookups, |prefix_set| was built only to be written.
+  // Otherwise it holds the old set, which may be mapped from the file
+  // about to be written, so release it first.
+  if (bucketed_prefix_set_.get()) {
+    WritePrefixSet(*prefix_set);
+  } else {
+    prefix_set.reset();
+    WritePrefixSet(*prefix_set_);
+  }
 
   // Gather statistics.
   if (got_counters && metric->GetIOCounters(&io_after)) {
@@ -1225,14 +1270,80 @@ void SafeBrowsingDatabaseNew::LoadPrefixSet() {
   FilePath bloom_filter_filename = BloomFilterForFilename(browse_filename_);
   file_util::Delete(bloom_filter_filename, false);
 
+  // Rather than reading and checking all of the file before the first
+  // lookup, map it and check it later.  The bucketed set copies the
+  // prefixes out, so it reads the file as before.  Files which can't
+  // be mapped may still be readable.
   const base::TimeTicks before = base::TimeTicks::Now();
-  prefix_set_.reset(safe_browsing::PrefixSet::LoadFile(prefix_set_filename_));
+  if (!UseBucketedPrefixSet())
+    prefix_set_.reset(safe_browsing::PrefixSet::MapFile(prefix_set_filename_));
+  if (!prefix_set_.get()) {
+    prefix_set_.reset(
+        safe_browsing::PrefixSet::LoadFile(prefix_set_filename_));
+  }
   DVLOG(1) << "SafeBrowsingDatabaseNew read prefix set in "
            << (base::TimeTicks::Now() - before).InMilliseconds() << " ms";
   UMA_HISTOGRAM_TIMES("SB2.PrefixSetLoad", base::TimeTicks::Now() - before);
 
-  if (!prefix_set_.get())
+  if (!prefix_set_.get()) {
     RecordFailure(FAILURE_DATABASE_PREFIX_SET_READ);
+    return;
+  }
+
+  if (prefix_set_->is_mapped()) {
+    // Without a message loop, as in some tests, check it right away.
+    if (!MessageLoop::current()) {
+      VerifyPrefixSet();
+      return;
+    }
+    MessageLoop::current()->PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&SafeBrowsingDatabaseNew::VerifyPrefixSet,
+                   verify_factory_.GetWeakPtr()),
+        base::TimeDelta::FromSeconds(kPrefixSetVerifyDelaySeconds));
+    return;
+  }
+
+  if (UseBucketedPrefixSet()) {
+    std::vector<SBPrefix> prefixes;
+    prefix_set_->GetPrefixes(&prefixes);
+    bucketed_prefix_set_.reset(new safe_browsing::BucketedPrefixSet(prefixes));
+    prefix_set_.reset();
+  }
+}
+
+void SafeBrowsingDatabaseNew::VerifyPrefixSet() {
+  DCHECK_EQ(creation_loop_, MessageLoop::current());
+
+  // An update may have replaced the mapped set since this was posted.
+  // Since only this thread changes |prefix_set_|, there is no need to
+  // lock to look at it.
+  if (!prefix_set_.get() || !prefix_set_->is_mapped())
+    return;
+
+  const base::TimeTicks before = base::TimeTicks::Now();
+  const bool checksum_ok = prefix_set_->VerifyChecksum();
+  UMA_HISTOGRAM_TIMES("SB2.PrefixSetVerify", base::TimeTicks::Now() - before);
+  if (checksum_ok)
+    return;
+
+  // Fall back to reading the file, which checks it as it goes.  This
+  // most likely fails too, leaving no set until the next update, as
+  // when a corrupt file is found at startup.
+  RecordFailure(FAILURE_DATABASE_PREFIX_SET_CHECKSUM);
+  {
+    base::AutoLock locked(lookup_lock_);
+    prefix_set_.reset();
+  }
+  scoped_ptr<safe_browsing::PrefixSet> prefix_set(
+      safe_browsing::PrefixSet::LoadFile(prefix_set_filename_));
+  if (!prefix_set.get()) {
+    RecordFailure(FAILURE_DATABASE_PREFIX_SET_READ);
+    return;
+  }
+
+  base::AutoLock locked(lookup_lock_);
+  prefix_set_.swap(prefix_set);
 }
 
 bool SafeBrowsingDatabaseNew::Delete() {
@@ -1267,14 +1378,12 @@ bool SafeBrowsingDatabaseNew::Delete() {
   return r1 && r2 && r3 && r4 && r5 && r6;
 }
 
-void SafeBrowsingDatabaseNew::WritePrefixSet() {
+void SafeBrowsingDatabaseNew::WritePrefixSet(
+    const safe_browsing::PrefixSet& prefix_set) {
   DCHECK_EQ(creation_loop_, MessageLoop::current());
 
-  if (!prefix_set_.get())
-    return;
-
   const base::TimeTicks before = base::TimeTicks::Now();
-  const bool write_ok = prefix_set_->WriteFile(prefix_set_filename_);
+  const bool write_ok = prefix_set.WriteFile(prefix_set_filename_);
   DVLOG(1) << "SafeBrowsingDatabaseNew wrote prefix set in "
            << (base::TimeTicks::Now() - before).InMilliseconds() << " ms";
   UMA_HISTOGRAM_TIMES("SB2.PrefixSetWrite", base::TimeTicks::Now() - before);
@@ -20,6 +20,7 @@ namespace base {
 }
 
 namespace safe_browsing {
+class BucketedPrefixSet;
 class PrefixSet;
 }
 
@@ -196,6 +197,7 @@ class SafeBrowsingDatabase {
     FAILURE_DATABASE_PREFIX_SET_READ,
     FAILURE_DATABASE_PREFIX_SET_WRITE,
     FAILURE_DATABASE_PREFIX_SET_DELETE,
+    FAILURE_DATABASE_PREFIX_SET_CHECKSUM,
 
     // Memory space for histograms is determined by the max.  ALWAYS
     // ADD NEW VALUES BEFORE THIS ONE.
@@ -278,8 +280,12 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   // Load the prefix set off disk, if available.
   void LoadPrefixSet();
 
-  // Writes the current prefix set to disk.
-  void WritePrefixSet();
+  // Checks the digest of a prefix set mapped by |LoadPrefixSet()|,
+  // reading the file instead if it doesn't match.
+  void VerifyPrefixSet();
+
+  // Writes |prefix_set| to disk.
+  void WritePrefixSet(const safe_browsing::PrefixSet& prefix_set);
 
   // Loads the given full-length hashes to the given whitelist.  If the number
   // of hashes is too large or if the kill switch URL is on the whitelist
@@ -327,9 +333,9 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   MessageLoop* creation_loop_;
 
   // Lock for protecting access to variables that may be used on the
-  // IO thread.  This includes |prefix_set_|, |full_browse_hashes_|,
-  // |pending_browse_hashes_|, |prefix_miss_cache_|, |csd_whitelist_|,
-  // and |csd_whitelist_all_urls_|.
+  // IO thread.  This includes |prefix_set_|, |bucketed_prefix_set_|,
+  // |full_browse_hashes_|, |pending_browse_hashes_|, |prefix_miss_cache_|,
+  // |csd_whitelist_|, and |csd_whitelist_all_urls_|.
   base::Lock lookup_lock_;
 
   // Underlying persistent store for chunk data.
@@ -370,6 +376,9 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   // Used to schedule resetting the database because of corruption.
   base::WeakPtrFactory<SafeBrowsingDatabaseNew> reset_factory_;
 
+  // Used to schedule |VerifyPrefixSet()|.
+  base::WeakPtrFactory<SafeBrowsingDatabaseNew> verify_factory_;
+
   // Set if corruption is detected during the course of an update.
   // Causes the update functions to fail with no side effects, until
   // the next call to |UpdateStarted()|.
@@ -379,9 +388,14 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   // Used to optimize away database update.
   bool change_detected_;
 
-  // Used to check if a prefix was in the database.
+  // Used to check if a prefix was in the database.  With
+  // --enable-bucketed-prefix-set, |bucketed_prefix_set_| is used
+  // instead of |prefix_set_|, which is left empty.  The file is
+  // written as a PrefixSet either way.  |prefix_set_| may be mapped
+  // from the file, until the next update replaces it.
   FilePath prefix_set_filename_;
   scoped_ptr<safe_browsing::PrefixSet> prefix_set_;
+  scoped_ptr<safe_browsing::BucketedPrefixSet> bucketed_prefix_set_;
 };
 
 #endif  // CHROME_BROWSER_SAFE_BROWSING_SAFE_BROWSING_DATABASE_H_
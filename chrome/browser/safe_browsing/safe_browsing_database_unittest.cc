@@ -265,6 +265,11 @@ class SafeBrowsingDatabaseTest : public PlatformTest {
   // Utility function for setting up the database for the caching test.
   void PopulateDatabaseForCacheTest();
 
+  // Runs the check |database_| posts after mapping its prefix set.
+  void VerifyPrefixSet() {
+    database_->VerifyPrefixSet();
+  }
+
   scoped_ptr<SafeBrowsingDatabaseNew> database_;
   FilePath database_filename_;
   base::ScopedTempDir temp_dir_;
@@ -1645,3 +1650,56 @@ TEST_F(SafeBrowsingDatabaseTest, FilterFile) {
       GURL("http://www.good.com/goodware.html"),
       &matching_list, &prefix_hits, &full_hashes, now));
 }
+
+// Checks that a filter file which is mapped at startup is checked
+// later, and dropped if it is corrupt.
+TEST_F(SafeBrowsingDatabaseTest, FilterFileChecksum) {
+  // Create a database with trivial example data and write it out.
+  {
+    SBChunkList chunks;
+    SBChunk chunk;
+
+    std::vector<SBListChunkRanges> lists;
+    EXPECT_TRUE(database_->UpdateStarted(&lists));
+
+    InsertAddChunkHostPrefixUrl(&chunk, 1, "www.evil.com/",
+                                "www.evil.com/malware.html");
+    chunks.clear();
+    chunks.push_back(chunk);
+    database_->InsertChunks(safe_browsing_util::kMalwareList, chunks);
+    database_->UpdateFinished(true);
+  }
+  database_.reset();
+
+  // Corrupt the filter's checksum, which leaves its data intact.
+  FilePath filter_file = SafeBrowsingDatabase::PrefixSetForFilename(
+      SafeBrowsingDatabase::BrowseDBFilename(database_filename_));
+  int64 size_64;
+  ASSERT_TRUE(file_util::GetFileSize(filter_file, &size_64));
+  {
+    file_util::ScopedFILE file(file_util::OpenFile(filter_file, "r+b"));
+    ASSERT_EQ(0, fseek(file.get(), static_cast<long>(size_64 - 1), SEEK_SET));
+    ASSERT_NE(EOF, fputc('x', file.get()));
+  }
+
+  // The filter is used until it is checked.
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT);
+  database_.reset(new SafeBrowsingDatabaseNew);
+  database_->Init(database_filename_);
+  const Time now = Time::Now();
+  std::vector<SBFullHashResult> full_hashes;
+  std::vector<SBPrefix> prefix_hits;
+  std::string matching_list;
+  EXPECT_TRUE(database_->ContainsBrowseUrl(
+      GURL("http://www.evil.com/malware.html"),
+      &matching_list, &prefix_hits, &full_hashes, now));
+
+  // Reading the file fails too, so there is no filter until the next
+  // update.
+  VerifyPrefixSet();
+  EXPECT_FALSE(database_->ContainsBrowseUrl(
+      GURL("http://www.evil.com/malware.html"),
+      &matching_list, &prefix_hits, &full_hashes, now));
+
+  database_.reset();
+}
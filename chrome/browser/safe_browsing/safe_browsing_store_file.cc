@@ -4,8 +4,13 @@
 
 #include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
 
+#include <algorithm>
+
+#include "base/command_line.h"
 #include "base/md5.h"
 #include "base/metrics/histogram.h"
+#include "base/stl_util.h"
+#include "chrome/common/chrome_switches.h"
 
 namespace {
 
@@ -28,6 +33,15 @@ struct ChunkHeader {
   uint32 add_hash_count, sub_hash_count;
 };
 
+// For streaming updates, the chunks collected are written out in
+// sorted runs of about this many bytes.
+const size_t kRunBytes = 1024 * 1024;
+
+// The bytes read at a time from each run while merging them, and the
+// bytes of sub prefixes spilled at a time.
+const size_t kReadBlockBytes = 16 * 1024;
+const size_t kSpillBlockBytes = 64 * 1024;
+
 // Rewind the file.  Using fseek(2) because rewind(3) errors are
 // weird.
 bool FileRewind(FILE* fp) {
@@ -118,6 +132,184 @@ bool WriteContainer(const CT& values, FILE* fp,
   return true;
 }
 
+// Fold the next |bytes| of |fp| into the checksum in |context|.
+// Returns true on success.
+bool ReadToChecksum(size_t bytes, FILE* fp, base::MD5Context* context) {
+  while (bytes > 0) {
+    char buf[4096];
+    const size_t c = std::min(sizeof(buf), bytes);
+    const size_t ret = fread(buf, 1, c, fp);
+    if (ret != c)
+      return false;
+    base::MD5Update(context, base::StringPiece(buf, c));
+    bytes -= c;
+  }
+  return true;
+}
+
+// Reads a sorted run of |count| items of type T at |offset| in |fp|,
+// a block at a time, so that many runs can be merged from one file
+// without reading them into memory.  The position of |fp| is not
+// kept between blocks.
+template <class T>
+class RunReader {
+ public:
+  RunReader(FILE* fp, long offset, size_t count)
+      : fp_(fp), offset_(offset), remaining_(count), pos_(0) {}
+
+  // A run of |items|, which are swapped out.
+  explicit RunReader(std::vector<T>* items)
+      : fp_(NULL), offset_(0), remaining_(0), pos_(0) {
+    block_.swap(*items);
+  }
+
+  bool empty() const { return pos_ == block_.size(); }
+  const T& front() const { return block_[pos_]; }
+
+  // Moves to the next item, reading the next block if needed.
+  // Returns false on error.
+  bool Advance() {
+    ++pos_;
+    return pos_ < block_.size() || !remaining_ || ReadBlock();
+  }
+
+  // Reads the first block.  Returns false on error.
+  bool Start() {
+    return !remaining_ || ReadBlock();
+  }
+
+ private:
+  bool ReadBlock() {
+    const size_t count = std::min(remaining_,
+                                  std::max(kReadBlockBytes / sizeof(T),
+                                           static_cast<size_t>(1)));
+    block_.resize(count);
+    pos_ = 0;
+    if (fseek(fp_, offset_, SEEK_SET) != 0 ||
+        fread(&block_[0], sizeof(T), count, fp_) != count) {
+      block_.clear();
+      return false;
+    }
+    offset_ += static_cast<long>(count * sizeof(T));
+    remaining_ -= count;
+    return true;
+  }
+
+  FILE* fp_;
+  long offset_;
+  size_t remaining_;
+  std::vector<T> block_;
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunReader);
+};
+
+// Merges sorted runs of type T into one sorted sequence.  A run which
+// turns out not to be sorted is noticed as the merged sequence going
+// backwards.
+template <class T>
+class RunMerger {
+ public:
+  typedef bool (*LessFunction)(const T&, const T&);
+
+  explicit RunMerger(LessFunction less)
+      : less_(less), failed_(false), sorted_(true) {}
+  ~RunMerger() {
+    STLDeleteElements(&heap_);
+  }
+
+  // Adds |run|, taking ownership.  Returns false on error.
+  bool AddRun(RunReader<T>* run) {
+    if (!run->Start()) {
+      delete run;
+      failed_ = true;
+      return false;
+    }
+    if (run->empty()) {
+      delete run;
+      return true;
+    }
+    heap_.push_back(run);
+    std::push_heap(heap_.begin(), heap_.end(), FrontGreater(less_));
+    return true;
+  }
+
+  bool empty() const { return heap_.empty(); }
+  const T& front() const { return heap_.front()->front(); }
+
+  // Moves to the next item.  Returns false on error, or if the runs
+  // aren't sorted.
+  bool Advance() {
+    const T last = front();
+    std::pop_heap(heap_.begin(), heap_.end(), FrontGreater(less_));
+    RunReader<T>* run = heap_.back();
+    if (!run->Advance()) {
+      failed_ = true;
+      return false;
+    }
+    if (run->empty()) {
+      heap_.pop_back();
+      delete run;
+    } else {
+      std::push_heap(heap_.begin(), heap_.end(), FrontGreater(less_));
+    }
+    if (!heap_.empty() && less_(front(), last)) {
+      sorted_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  bool failed() const { return failed_; }
+  bool sorted() const { return sorted_; }
+
+ private:
+  // Orders the runs for a heap with the smallest front on top.
+  class FrontGreater {
+   public:
+    explicit FrontGreater(LessFunction less) : less_(less) {}
+    bool operator()(const RunReader<T>* a, const RunReader<T>* b) const {
+      return less_(b->front(), a->front());
+    }
+
+   private:
+    LessFunction less_;
+  };
+
+  LessFunction less_;
+  std::vector<RunReader<T>*> heap_;
+  bool failed_;
+  bool sorted_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunMerger);
+};
+
+// Lowers |key| to the add chunk and prefix at the front of |merger|,
+// if that is smaller.
+template <class T>
+void LowerKey(const RunMerger<T>& merger, bool* has_key, SBAddPrefix* key) {
+  if (merger.empty())
+    return;
+  if (!*has_key || SBAddPrefixLess(merger.front(), *key)) {
+    *key = SBAddPrefix(merger.front().GetAddChunkId(),
+                       merger.front().GetAddPrefix());
+    *has_key = true;
+  }
+}
+
+// Moves the items for the add chunk and prefix of |key| from the
+// front of |merger| to |items|.  |key| must not be above the front of
+// |merger|.  Returns false if |merger| fails.
+template <class T, class CT>
+bool TakeKey(const SBAddPrefix& key, RunMerger<T>* merger, CT* items) {
+  while (!merger->empty() && !SBAddPrefixLess(key, merger->front())) {
+    items->push_back(merger->front());
+    if (!merger->Advance())
+      return false;
+  }
+  return true;
+}
+
 // Delete the chunks in |deleted| from |chunks|.
 void DeleteChunksFromSet(const base::hash_set<int32>& deleted,
                          std::set<int32>* chunks) {
@@ -204,6 +396,8 @@ SafeBrowsingStoreFile::SafeBrowsingStoreFile()
     : chunks_written_(0),
       file_(NULL),
       empty_(false),
+      streaming_update_(CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableStreamingSafeBrowsingUpdate)),
       corruption_seen_(false) {
 }
 
@@ -232,6 +426,13 @@ bool SafeBrowsingStoreFile::Delete() {
     return false;
   }
 
+  const FilePath merge_filename = MergeFileForFilename(filename_);
+  if (!file_util::Delete(merge_filename, false) &&
+      file_util::PathExists(merge_filename)) {
+    NOTREACHED();
+    return false;
+  }
+
   // With SQLite support gone, one way to get to this code is if the
   // existing file is a SQLite file.  Make sure the journal file is
   // also removed.
@@ -268,18 +469,10 @@ bool SafeBrowsingStoreFile::CheckValidity() {
     return OnCorruptDatabase();
   bytes_left -= sizeof(base::MD5Digest);
 
-  // Fold the contents of the file into the checksum.
-  while (bytes_left > 0) {
-    char buf[4096];
-    const size_t c = std::min(sizeof(buf), bytes_left);
-    const size_t ret = fread(buf, 1, c, file_.get());
-
-    // The file's size changed while reading, give up.
-    if (ret != c)
-      return OnCorruptDatabase();
-    base::MD5Update(&context, base::StringPiece(buf, c));
-    bytes_left -= c;
-  }
+  // Fold the contents of the file into the checksum.  If the file's
+  // size changed while reading, give up.
+  if (!ReadToChecksum(bytes_left, file_.get(), &context))
+    return OnCorruptDatabase();
 
   // Calculate the digest to this point.
   base::MD5Digest calculated_digest;
@@ -306,6 +499,10 @@ void SafeBrowsingStoreFile::Init(
 }
 
 bool SafeBrowsingStoreFile::BeginChunk() {
+  // For streaming updates, chunks are collected into a run, which
+  // |FinishChunk()| writes out once it is big enough.
+  if (streaming_update_)
+    return true;
   return ClearChunkBuffers();
 }
 
@@ -479,6 +676,35 @@ bool SafeBrowsingStoreFile::FinishChunk() {
       !add_hashes_.size() && !sub_hashes_.size())
     return true;
 
+  if (streaming_update_) {
+    const size_t run_bytes =
+        add_prefixes_.size() * sizeof(SBAddPrefix) +
+        sub_prefixes_.size() * sizeof(SBSubPrefix) +
+        add_hashes_.size() * sizeof(SBAddFullHash) +
+        sub_hashes_.size() * sizeof(SBSubFullHash);
+    if (run_bytes < kRunBytes)
+      return true;
+  }
+  return WriteChunkBuffers();
+}
+
+bool SafeBrowsingStoreFile::WriteChunkBuffers() {
+  if (!add_prefixes_.size() && !sub_prefixes_.size() &&
+      !add_hashes_.size() && !sub_hashes_.size())
+    return true;
+
+  // Streaming updates merge the runs, so they must be sorted.
+  if (streaming_update_) {
+    std::sort(add_prefixes_.begin(), add_prefixes_.end(),
+              SBAddPrefixLess<SBAddPrefix, SBAddPrefix>);
+    std::sort(sub_prefixes_.begin(), sub_prefixes_.end(),
+              SBAddPrefixLess<SBSubPrefix, SBSubPrefix>);
+    std::sort(add_hashes_.begin(), add_hashes_.end(),
+              SBAddPrefixHashLess<SBAddFullHash, SBAddFullHash>);
+    std::sort(sub_hashes_.begin(), sub_hashes_.end(),
+              SBAddPrefixHashLess<SBSubFullHash, SBSubFullHash>);
+  }
+
   ChunkHeader header;
   header.add_prefix_count = add_prefixes_.size();
   header.sub_prefix_count = sub_prefixes_.size();
@@ -509,6 +735,26 @@ bool SafeBrowsingStoreFile::DoUpdate(
   CHECK(add_prefixes_result);
   CHECK(add_full_hashes_result);
 
+  if (streaming_update_) {
+    // Write out the last run.
+    if (!WriteChunkBuffers())
+      return false;
+
+    bool runs_sorted = true;
+    if (DoStreamingUpdate(pending_adds, prefix_misses, add_prefixes_result,
+                          add_full_hashes_result, &runs_sorted)) {
+      return true;
+    }
+
+    // A file which passed its checksum but isn't sorted could only
+    // have been written by something else, but the update can still
+    // be done in memory.
+    if (runs_sorted)
+      return false;
+    DCHECK(add_prefixes_result->empty());
+    DCHECK(add_full_hashes_result->empty());
+  }
+
   SBAddPrefixes add_prefixes;
   std::vector<SBSubPrefix> sub_prefixes;
   std::vector<SBAddFullHash> add_full_hashes;
@@ -698,6 +944,311 @@ bool SafeBrowsingStoreFile::DoUpdate(
   return true;
 }
 
+bool SafeBrowsingStoreFile::DoStreamingUpdate(
+    const std::vector<SBAddFullHash>& pending_adds,
+    const std::set<SBPrefix>& prefix_misses,
+    SBAddPrefixes* add_prefixes_result,
+    std::vector<SBAddFullHash>* add_full_hashes_result,
+    bool* runs_sorted) {
+  RunMerger<SBAddPrefix> add_prefixes(
+      SBAddPrefixLess<SBAddPrefix, SBAddPrefix>);
+  RunMerger<SBSubPrefix> sub_prefixes(
+      SBAddPrefixLess<SBSubPrefix, SBSubPrefix>);
+  RunMerger<SBAddFullHash> add_full_hashes(
+      SBAddPrefixHashLess<SBAddFullHash, SBAddFullHash>);
+  RunMerger<SBSubFullHash> sub_full_hashes(
+      SBAddPrefixHashLess<SBSubFullHash, SBSubFullHash>);
+
+  // Check the original file, then add each of its lists as a run.
+  if (!empty_) {
+    DCHECK(file_.get());
+
+    if (!FileRewind(file_.get()))
+      return OnCorruptDatabase();
+
+    base::MD5Context context;
+    base::MD5Init(&context);
+
+    // Read the file header and make sure it looks right.  That
+    // includes checking the file's size against the header.
+    FileHeader header;
+    if (!ReadAndVerifyHeader(filename_, file_.get(), &header, &context))
+      return OnCorruptDatabase();
+
+    long offset = sizeof(header) +
+        header.add_chunk_count * sizeof(int32) +
+        header.sub_chunk_count * sizeof(int32);
+    const long add_prefix_offset = offset;
+    offset += header.add_prefix_count * sizeof(SBAddPrefix);
+    const long sub_prefix_offset = offset;
+    offset += header.sub_prefix_count * sizeof(SBSubPrefix);
+    const long add_hash_offset = offset;
+    offset += header.add_hash_count * sizeof(SBAddFullHash);
+    const long sub_hash_offset = offset;
+    offset += header.sub_hash_count * sizeof(SBSubFullHash);
+
+    // The lists are read out of order, so the checksum is calculated
+    // in a pass of its own.
+    if (!ReadToChecksum(offset - sizeof(header), file_.get(), &context))
+      return OnCorruptDatabase();
+
+    base::MD5Digest calculated_digest;
+    base::MD5Final(&calculated_digest, &context);
+
+    base::MD5Digest file_digest;
+    if (!ReadItem(&file_digest, file_.get(), NULL))
+      return OnCorruptDatabase();
+
+    if (0 != memcmp(&file_digest, &calculated_digest, sizeof(file_digest))) {
+      RecordFormatEvent(FORMAT_EVENT_UPDATE_CHECKSUM_FAILURE);
+      return OnCorruptDatabase();
+    }
+
+    if (!add_prefixes.AddRun(new RunReader<SBAddPrefix>(
+            file_.get(), add_prefix_offset, header.add_prefix_count)) ||
+        !sub_prefixes.AddRun(new RunReader<SBSubPrefix>(
+            file_.get(), sub_prefix_offset, header.sub_prefix_count)) ||
+        !add_full_hashes.AddRun(new RunReader<SBAddFullHash>(
+            file_.get(), add_hash_offset, header.add_hash_count)) ||
+        !sub_full_hashes.AddRun(new RunReader<SBSubFullHash>(
+            file_.get(), sub_hash_offset, header.sub_hash_count)))
+      return OnCorruptDatabase();
+  }
+
+  // Rewind the temporary storage, which also flushes the last run.
+  if (!FileRewind(new_file_.get()))
+    return false;
+
+  // Get chunk file's size for validating counts.
+  int64 size = 0;
+  if (!file_util::GetFileSize(TemporaryFileForFilename(filename_), &size))
+    return OnCorruptDatabase();
+
+  // Track update size to answer questions at http://crbug.com/72216 .
+  // Log small updates as 1k so that the 0 (underflow) bucket can be
+  // used for "empty" in SafeBrowsingDatabase.
+  UMA_HISTOGRAM_COUNTS("SB2.DatabaseUpdateKilobytes",
+                       std::max(static_cast<int>(size / 1024), 1));
+
+  // Add the lists of each run in the temporary storage.
+  long offset = 0;
+  for (int i = 0; i < chunks_written_; ++i) {
+    ChunkHeader header;
+    if (fseek(new_file_.get(), offset, SEEK_SET) != 0 ||
+        !ReadItem(&header, new_file_.get(), NULL))
+      return false;
+
+    // As a safety measure, make sure that the header describes a sane
+    // run, given the remaining file size.
+    int64 expected_size = offset + sizeof(ChunkHeader);
+    expected_size += header.add_prefix_count * sizeof(SBAddPrefix);
+    expected_size += header.sub_prefix_count * sizeof(SBSubPrefix);
+    expected_size += header.add_hash_count * sizeof(SBAddFullHash);
+    expected_size += header.sub_hash_count * sizeof(SBSubFullHash);
+    if (expected_size > size)
+      return false;
+
+    offset += sizeof(ChunkHeader);
+    if (!add_prefixes.AddRun(new RunReader<SBAddPrefix>(
+            new_file_.get(), offset, header.add_prefix_count)))
+      return false;
+    offset += header.add_prefix_count * sizeof(SBAddPrefix);
+    if (!sub_prefixes.AddRun(new RunReader<SBSubPrefix>(
+            new_file_.get(), offset, header.sub_prefix_count)))
+      return false;
+    offset += header.sub_prefix_count * sizeof(SBSubPrefix);
+    if (!add_full_hashes.AddRun(new RunReader<SBAddFullHash>(
+            new_file_.get(), offset, header.add_hash_count)))
+      return false;
+    offset += header.add_hash_count * sizeof(SBAddFullHash);
+    if (!sub_full_hashes.AddRun(new RunReader<SBSubFullHash>(
+            new_file_.get(), offset, header.sub_hash_count)))
+      return false;
+    offset += header.sub_hash_count * sizeof(SBSubFullHash);
+  }
+
+  // |pending_adds| are a run of their own.
+  std::vector<SBAddFullHash> pending_run(pending_adds);
+  std::sort(pending_run.begin(), pending_run.end(),
+            SBAddPrefixHashLess<SBAddFullHash, SBAddFullHash>);
+  add_full_hashes.AddRun(new RunReader<SBAddFullHash>(&pending_run));
+
+  // Everything |SBProcessSubs()| does is between items for the same add
+  // chunk and prefix, so the merged runs are processed an add chunk and
+  // prefix at a time.  The add prefixes and full hashes which are kept
+  // are returned to the caller, so they are kept in memory, but the sub
+  // prefixes are spilled after the runs in the temporary storage.
+  SBAddPrefixes kept_add_prefixes;
+  std::vector<SBAddFullHash> kept_add_full_hashes;
+  std::vector<SBSubFullHash> kept_sub_full_hashes;
+  const long spill_offset = offset;
+  size_t sub_prefix_count = 0;
+  std::vector<SBSubPrefix> spill;
+
+  // The adds of prefixes in |prefix_misses|, for |SBCheckPrefixMisses()|.
+  SBAddPrefixes missed_add_prefixes;
+
+  SBAddPrefixes adds;
+  std::vector<SBSubPrefix> subs;
+  std::vector<SBAddFullHash> add_hashes;
+  std::vector<SBSubFullHash> sub_hashes;
+  while (true) {
+    bool has_key = false;
+    SBAddPrefix key;
+    LowerKey(add_prefixes, &has_key, &key);
+    LowerKey(sub_prefixes, &has_key, &key);
+    LowerKey(add_full_hashes, &has_key, &key);
+    LowerKey(sub_full_hashes, &has_key, &key);
+    if (!has_key)
+      break;
+
+    adds.clear();
+    subs.clear();
+    add_hashes.clear();
+    sub_hashes.clear();
+    if (!TakeKey(key, &add_prefixes, &adds) ||
+        !TakeKey(key, &sub_prefixes, &subs) ||
+        !TakeKey(key, &add_full_hashes, &add_hashes) ||
+        !TakeKey(key, &sub_full_hashes, &sub_hashes))
+      break;
+
+    if (prefix_misses.count(key.prefix) > 0) {
+      missed_add_prefixes.insert(missed_add_prefixes.end(),
+                                 adds.begin(), adds.end());
+    }
+
+    if (subs.empty() && add_hashes.empty() && sub_hashes.empty()) {
+      // Nothing can be knocked out, which is the usual case.
+      if (add_del_cache_.count(key.chunk_id) == 0) {
+        kept_add_prefixes.insert(kept_add_prefixes.end(),
+                                 adds.begin(), adds.end());
+      }
+      continue;
+    }
+
+    SBProcessSubs(&adds, &subs, &add_hashes, &sub_hashes,
+                  add_del_cache_, sub_del_cache_);
+    kept_add_prefixes.insert(kept_add_prefixes.end(), adds.begin(), adds.end());
+    kept_add_full_hashes.insert(kept_add_full_hashes.end(),
+                                add_hashes.begin(), add_hashes.end());
+    kept_sub_full_hashes.insert(kept_sub_full_hashes.end(),
+                                sub_hashes.begin(), sub_hashes.end());
+
+    spill.insert(spill.end(), subs.begin(), subs.end());
+    if (spill.size() * sizeof(SBSubPrefix) >= kSpillBlockBytes) {
+      const long spill_end = spill_offset +
+          static_cast<long>(sub_prefix_count * sizeof(SBSubPrefix));
+      if (fseek(new_file_.get(), spill_end, SEEK_SET) != 0 ||
+          !WriteContainer(spill, new_file_.get(), NULL))
+        return false;
+      sub_prefix_count += spill.size();
+      spill.clear();
+    }
+  }
+
+  if (add_prefixes.failed() || sub_prefixes.failed() ||
+      add_full_hashes.failed() || sub_full_hashes.failed())
+    return false;
+
+  if (!add_prefixes.sorted() || !sub_prefixes.sorted() ||
+      !add_full_hashes.sorted() || !sub_full_hashes.sorted()) {
+    *runs_sorted = false;
+    return false;
+  }
+
+  if (!spill.empty()) {
+    const long spill_end = spill_offset +
+        static_cast<long>(sub_prefix_count * sizeof(SBSubPrefix));
+    if (fseek(new_file_.get(), spill_end, SEEK_SET) != 0 ||
+        !WriteContainer(spill, new_file_.get(), NULL))
+      return false;
+    sub_prefix_count += spill.size();
+    std::vector<SBSubPrefix>().swap(spill);
+  }
+
+  // Check how often a prefix was checked which wasn't in the
+  // database.
+  SBCheckPrefixMisses(missed_add_prefixes, prefix_misses);
+
+  // We no longer need to track deleted chunks.
+  DeleteChunksFromSet(add_del_cache_, &add_chunks_cache_);
+  DeleteChunksFromSet(sub_del_cache_, &sub_chunks_cache_);
+
+  // Write the new data to a file of its own, as the temporary storage
+  // holds the spilled sub prefixes.
+  const FilePath merge_filename = MergeFileForFilename(filename_);
+  file_util::ScopedFILE merge_file(file_util::OpenFile(merge_filename, "wb"));
+  if (merge_file.get() == NULL)
+    return false;
+
+  base::MD5Context context;
+  base::MD5Init(&context);
+
+  // Write a file header.
+  FileHeader header;
+  header.magic = kFileMagic;
+  header.version = kFileVersion;
+  header.add_chunk_count = add_chunks_cache_.size();
+  header.sub_chunk_count = sub_chunks_cache_.size();
+  header.add_prefix_count = kept_add_prefixes.size();
+  header.sub_prefix_count = sub_prefix_count;
+  header.add_hash_count = kept_add_full_hashes.size();
+  header.sub_hash_count = kept_sub_full_hashes.size();
+  if (!WriteItem(header, merge_file.get(), &context))
+    return false;
+
+  if (!WriteContainer(add_chunks_cache_, merge_file.get(), &context) ||
+      !WriteContainer(sub_chunks_cache_, merge_file.get(), &context) ||
+      !WriteContainer(kept_add_prefixes, merge_file.get(), &context))
+    return false;
+
+  // Copy the spilled sub prefixes.
+  RunReader<SBSubPrefix> spilled(new_file_.get(), spill_offset,
+                                 sub_prefix_count);
+  if (!spilled.Start())
+    return false;
+  while (!spilled.empty()) {
+    if (!WriteItem(spilled.front(), merge_file.get(), &context) ||
+        !spilled.Advance())
+      return false;
+  }
+
+  if (!WriteContainer(kept_add_full_hashes, merge_file.get(), &context) ||
+      !WriteContainer(kept_sub_full_hashes, merge_file.get(), &context))
+    return false;
+
+  // Write the checksum at the end.
+  base::MD5Digest digest;
+  base::MD5Final(&digest, &context);
+  if (!WriteItem(digest, merge_file.get(), NULL))
+    return false;
+
+  // Close the file handles and swizzle the new file into place.
+  merge_file.reset();
+  file_.reset();
+  new_file_.reset();
+  if (!file_util::Delete(filename_, false) &&
+      file_util::PathExists(filename_))
+    return false;
+
+  if (!file_util::Move(merge_filename, filename_))
+    return false;
+
+  // The temporary storage is recreated by the next update if this
+  // fails.
+  file_util::Delete(TemporaryFileForFilename(filename_), false);
+
+  // Record counts before swapping to caller.
+  UMA_HISTOGRAM_COUNTS("SB2.AddPrefixes", kept_add_prefixes.size());
+  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", sub_prefix_count);
+
+  // Pass the resulting data off to the caller.
+  add_prefixes_result->swap(kept_add_prefixes);
+  add_full_hashes_result->swap(kept_add_full_hashes);
+
+  return true;
+}
+
 bool SafeBrowsingStoreFile::FinishUpdate(
     const std::vector<SBAddFullHash>& pending_adds,
     const std::set<SBPrefix>& prefix_misses,
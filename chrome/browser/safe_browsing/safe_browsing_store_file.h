@@ -59,6 +59,11 @@
 // transaction.  The format of this file is like the main file, with
 // the list of chunks seen omitted, as that data is tracked in-memory:
 //
+// When --enable-streaming-safe-browsing-update is given, chunks are
+// collected in memory and written out as runs of about a megabyte,
+// each list sorted the way |SBProcessSubs()| sorts it.  Each run is
+// laid out as a chunk is:
+//
 // array[] {
 //   uint32 add_prefix_count;
 //   uint32 sub_prefix_count;
@@ -96,6 +101,20 @@
 //   - Rewind and write the buffers out to temp file.
 //   - Delete original file.
 //   - Rename temp file to original filename.
+//
+// A streaming update instead finishes like this:
+//   - Verify the original file's checksum.
+//   - Merge the original file's lists with the runs in the temp file,
+//     a block of each at a time.  Each add chunk and prefix is
+//     processed for deletions and subs as it comes out of the merge.
+//   - Spill the sub prefixes which survive to the end of the temp
+//     file, keeping the rest of the results in memory.
+//   - Write the results to a merge file.
+//   - Delete original file and temp file.
+//   - Rename merge file to original filename.
+// Only the add prefixes and full hashes passed back to the caller are
+// held in memory in full.  If the runs turn out not to be sorted, the
+// update falls back to the in-memory merge.
 
 // TODO(shess): By using a checksum, this code can avoid doing an
 // fsync(), at the possible cost of more frequently retrieving the
@@ -162,6 +181,18 @@ class SafeBrowsingStoreFile : public SafeBrowsingStore {
     return FilePath(filename.value() + FILE_PATH_LITERAL("_new"));
   }
 
+  // Returns the name of the file a streaming update writes the new
+  // data for |filename| to.  Exported for unit tests.
+  static const FilePath MergeFileForFilename(const FilePath& filename) {
+    return FilePath(filename.value() + FILE_PATH_LITERAL("_merge"));
+  }
+
+  // Overrides --enable-streaming-safe-browsing-update.  Must be called
+  // outside of an update.  Exported for tests.
+  void set_streaming_update(bool streaming_update) {
+    streaming_update_ = streaming_update;
+  }
+
  private:
   // Update store file with pending full hashes.
   virtual bool DoUpdate(const std::vector<SBAddFullHash>& pending_adds,
@@ -169,6 +200,16 @@ class SafeBrowsingStoreFile : public SafeBrowsingStore {
                         SBAddPrefixes* add_prefixes_result,
                         std::vector<SBAddFullHash>* add_full_hashes_result);
 
+  // |DoUpdate()| for a streaming update, merging the sorted runs in
+  // |new_file_| with the lists of |file_|.  Sets |*runs_sorted| to
+  // false and returns false without touching either file if the runs
+  // turn out not to be sorted.
+  bool DoStreamingUpdate(const std::vector<SBAddFullHash>& pending_adds,
+                         const std::set<SBPrefix>& prefix_misses,
+                         SBAddPrefixes* add_prefixes_result,
+                         std::vector<SBAddFullHash>* add_full_hashes_result,
+                         bool* runs_sorted);
+
   // Enumerate different format-change events for histogramming
   // purposes.  DO NOT CHANGE THE ORDERING OF THESE VALUES.
   // TODO(shess): Remove this once the format change is complete.
@@ -226,6 +267,10 @@ class SafeBrowsingStoreFile : public SafeBrowsingStore {
   // TODO(shess): Remove after migration.
   void HandleCorruptDatabase();
 
+  // Write the buffers collected since the last call to |new_file_| as
+  // a chunk, or a run when |streaming_update_|, and clear them.
+  bool WriteChunkBuffers();
+
   // Clear temporary buffers used to accumulate chunk data.
   bool ClearChunkBuffers() {
     // NOTE: .clear() doesn't release memory.
@@ -250,7 +295,7 @@ class SafeBrowsingStoreFile : public SafeBrowsingStore {
   }
 
   // Buffers for collecting data between BeginChunk() and
-  // FinishChunk().
+  // FinishChunk(), or for the whole run when |streaming_update_|.
   SBAddPrefixes add_prefixes_;
   std::vector<SBSubPrefix> sub_prefixes_;
   std::vector<SBAddFullHash> add_hashes_;
@@ -268,6 +313,10 @@ class SafeBrowsingStoreFile : public SafeBrowsingStore {
   file_util::ScopedFILE new_file_;
   bool empty_;
 
+  // Whether updates are written as sorted runs and merged a block at
+  // a time.
+  bool streaming_update_;
+
   // Cache of chunks which have been seen.  Loaded from the database
   // on BeginUpdate() so that it can be queried during the
   // transaction.
@@ -0,0 +1,160 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <set>
+#include <vector>
+
+#include "base/allocator/allocator_extension.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/process_util.h"
+#include "base/rand_util.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// A database about the size of today's browse list.
+const int32 kAddChunks = 6500;
+const int32 kSubChunks = 1000;
+const size_t kPrefixesPerChunk = 100;
+
+// An update adds and subs this many chunks of the same size, and
+// deletes a few old add chunks.
+const int32 kUpdateAddChunks = 200;
+const int32 kUpdateSubChunks = 50;
+const int32 kUpdateDeletedChunks = 20;
+const size_t kPendingAdds = 100;
+
+SBFullHash RandomFullHash() {
+  SBFullHash full_hash;
+  for (size_t i = 0; i < arraysize(full_hash.full_hash); ++i)
+    full_hash.full_hash[i] = static_cast<char>(base::RandInt(0, 255));
+  return full_hash;
+}
+
+// Writes add chunks |first_add_chunk| to |last_add_chunk| and sub
+// chunks |first_sub_chunk| to |last_sub_chunk| of |kPrefixesPerChunk|
+// prefixes each.  Subs are of random prefixes of earlier add chunks, so
+// few of them knock anything out.
+void WriteChunks(SafeBrowsingStore* store,
+                 int32 first_add_chunk, int32 last_add_chunk,
+                 int32 first_sub_chunk, int32 last_sub_chunk) {
+  for (int32 chunk_id = first_add_chunk; chunk_id <= last_add_chunk;
+       ++chunk_id) {
+    ASSERT_TRUE(store->BeginChunk());
+    store->SetAddChunk(chunk_id);
+    for (size_t i = 0; i < kPrefixesPerChunk; ++i) {
+      ASSERT_TRUE(store->WriteAddPrefix(
+          chunk_id, static_cast<SBPrefix>(base::RandUint64())));
+    }
+    if (chunk_id % 10 == 0) {
+      ASSERT_TRUE(store->WriteAddHash(chunk_id, base::Time::Now(),
+                                      RandomFullHash()));
+    }
+    ASSERT_TRUE(store->FinishChunk());
+  }
+  for (int32 chunk_id = first_sub_chunk; chunk_id <= last_sub_chunk;
+       ++chunk_id) {
+    ASSERT_TRUE(store->BeginChunk());
+    store->SetSubChunk(chunk_id);
+    for (size_t i = 0; i < kPrefixesPerChunk; ++i) {
+      ASSERT_TRUE(store->WriteSubPrefix(
+          chunk_id, base::RandInt(1, last_add_chunk),
+          static_cast<SBPrefix>(base::RandUint64())));
+    }
+    ASSERT_TRUE(store->FinishChunk());
+  }
+}
+
+// Resets the peak resident memory of the process where that can be
+// done, and returns it.  Free memory is released first, so that the
+// update's buffers have to be paged in again.
+size_t ResetPeakWorkingSetSize(base::ProcessMetrics* metrics) {
+  base::allocator::ReleaseFreeMemory();
+#if defined(OS_LINUX)
+  file_util::WriteFile(FilePath("/proc/self/clear_refs"), "5", 1);
+#endif
+  return metrics->GetPeakWorkingSetSize();
+}
+
+}  // namespace
+
+// Applies the same update to a copy of a large store with the streaming
+// merge and with the in-memory merge, logging the time taken and how
+// far the process's resident memory rose.
+TEST(SafeBrowsingStoreFilePerfTest, StreamingAgainstInMemoryUpdate) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const FilePath base_filename = temp_dir.path().AppendASCII("Base");
+
+  {
+    SafeBrowsingStoreFile store;
+    store.Init(base_filename, base::Closure());
+    ASSERT_TRUE(store.BeginUpdate());
+    WriteChunks(&store, 1, kAddChunks, 1, kSubChunks);
+    const std::vector<SBAddFullHash> pending_adds;
+    const std::set<SBPrefix> prefix_misses;
+    SBAddPrefixes add_prefixes;
+    std::vector<SBAddFullHash> add_hashes;
+    ASSERT_TRUE(store.FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  }
+  int64 base_size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(base_filename, &base_size));
+  LogPerfResult("SB2_StoreFile_Size", base_size / 1024, "kb");
+
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+
+  // Streaming first, in case the peak can't be reset.
+  for (int streaming = 1; streaming >= 0; --streaming) {
+    const char* name = streaming ? "streaming" : "in_memory";
+    const FilePath filename = temp_dir.path().AppendASCII(name);
+    ASSERT_TRUE(file_util::CopyFile(base_filename, filename));
+
+    SafeBrowsingStoreFile store;
+    store.Init(filename, base::Closure());
+    store.set_streaming_update(streaming != 0);
+
+    std::vector<SBAddFullHash> pending_adds;
+    for (size_t i = 0; i < kPendingAdds; ++i) {
+      pending_adds.push_back(SBAddFullHash(
+          base::RandInt(1, kAddChunks), base::Time::Now(), RandomFullHash()));
+    }
+    const std::set<SBPrefix> prefix_misses;
+    SBAddPrefixes add_prefixes;
+    std::vector<SBAddFullHash> add_hashes;
+
+    const size_t start_size = ResetPeakWorkingSetSize(metrics.get());
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    ASSERT_TRUE(store.BeginUpdate());
+    WriteChunks(&store, kAddChunks + 1, kAddChunks + kUpdateAddChunks,
+                kSubChunks + 1, kSubChunks + kUpdateSubChunks);
+    for (int32 i = 1; i <= kUpdateDeletedChunks; ++i)
+      store.DeleteAddChunk(i);
+    ASSERT_TRUE(store.FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+    const base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+    const size_t peak_size = metrics->GetPeakWorkingSetSize();
+
+    LogPerfResult(base::StringPrintf("SB2_Update_%s", name).c_str(),
+                  elapsed.InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("SB2_UpdatePeakMemory_%s", name).c_str(),
+                  (peak_size - start_size) / 1024, "kb");
+
+    // The odd add may have been knocked out by a random sub.
+    const size_t expected_size =
+        (kAddChunks + kUpdateAddChunks - kUpdateDeletedChunks) *
+        kPrefixesPerChunk;
+    EXPECT_LE(add_prefixes.size(), expected_size);
+    EXPECT_GT(add_prefixes.size(), expected_size - kPrefixesPerChunk);
+  }
+}
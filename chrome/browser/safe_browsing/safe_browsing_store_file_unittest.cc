@@ -4,9 +4,12 @@
 
 #include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/md5.h"
+#include "base/rand_util.h"
 #include "chrome/browser/safe_browsing/safe_browsing_store_unittest_helper.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
@@ -193,4 +196,227 @@ TEST_F(SafeBrowsingStoreFileTest, CheckValidityChecksum) {
   EXPECT_TRUE(store_->CancelUpdate());
 }
 
+class SafeBrowsingStoreFileStreamingTest : public SafeBrowsingStoreFileTest {
+ public:
+  virtual void SetUp() {
+    SafeBrowsingStoreFileTest::SetUp();
+    store_->set_streaming_update(true);
+  }
+};
+
+TEST_STORE(SafeBrowsingStoreFileStreamingTest, store_.get(), filename_);
+
+// The data written by one update, in chunks of |kItemsPerChunk| items.
+struct TestUpdate {
+  static const size_t kItemsPerChunk = 1000;
+
+  std::vector<SBAddPrefix> add_prefixes;
+  std::vector<SBSubPrefix> sub_prefixes;
+  std::vector<SBAddFullHash> add_hashes;
+  std::vector<SBSubFullHash> sub_hashes;
+  std::vector<int32> deleted_add_chunks;
+  std::vector<SBAddFullHash> pending_adds;
+};
+
+// Random prefixes are drawn from a small range, so that subs and
+// adds often match.
+SBPrefix RandomPrefix() {
+  return base::RandInt(-2500, 2500);
+}
+
+SBFullHash RandomFullHash() {
+  SBFullHash full_hash = SBFullHashFromString("random");
+  full_hash.prefix = RandomPrefix();
+  return full_hash;
+}
+
+// Makes an update adding |kAddChunks| add chunks after |*add_chunk_id|,
+// with subs of earlier and later chunks and deletions of earlier ones.
+TestUpdate MakeRandomUpdate(int32* add_chunk_id, int32* sub_chunk_id) {
+  const int32 kAddChunks = 200;
+  const int32 first_add_chunk_id = *add_chunk_id + 1;
+
+  TestUpdate update;
+  for (int32 i = 0; i < kAddChunks; ++i) {
+    ++*add_chunk_id;
+    for (size_t j = 0; j < TestUpdate::kItemsPerChunk; ++j) {
+      update.add_prefixes.push_back(
+          SBAddPrefix(*add_chunk_id, RandomPrefix()));
+    }
+  }
+  for (size_t i = 0; i < 3 * TestUpdate::kItemsPerChunk; ++i) {
+    if (i % TestUpdate::kItemsPerChunk == 0)
+      ++*sub_chunk_id;
+    const int32 add_id = base::RandInt(1, *add_chunk_id + kAddChunks);
+    update.sub_prefixes.push_back(
+        SBSubPrefix(*sub_chunk_id, add_id, RandomPrefix()));
+    const int32 hash_add_id = base::RandInt(1, *add_chunk_id + kAddChunks);
+    update.sub_hashes.push_back(
+        SBSubFullHash(*sub_chunk_id, hash_add_id, RandomFullHash()));
+  }
+  for (size_t i = 0; i < TestUpdate::kItemsPerChunk; ++i) {
+    const int32 add_id = base::RandInt(first_add_chunk_id, *add_chunk_id);
+    update.add_hashes.push_back(
+        SBAddFullHash(add_id, base::RandInt(0, 1000), RandomFullHash()));
+    update.pending_adds.push_back(
+        SBAddFullHash(add_id, base::RandInt(0, 1000), RandomFullHash()));
+  }
+  // Sub chunks aren't deleted.  Which of several matching subs knocks
+  // out an add isn't defined, so the deleted sub could differ.
+  for (int i = 0; i < 5; ++i)
+    update.deleted_add_chunks.push_back(base::RandInt(1, *add_chunk_id));
+  return update;
+}
+
+// Writes |items| to |store| with |write|, starting a new chunk every
+// |kItemsPerChunk| items.
+template <class T>
+bool WriteChunks(SafeBrowsingStore* store,
+                 const std::vector<T>& items,
+                 bool (*write)(SafeBrowsingStore*, const T&)) {
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (i % TestUpdate::kItemsPerChunk == 0 && !store->BeginChunk())
+      return false;
+    if (!write(store, items[i]))
+      return false;
+    if ((i + 1) % TestUpdate::kItemsPerChunk == 0 || i + 1 == items.size()) {
+      if (!store->FinishChunk())
+        return false;
+    }
+  }
+  return true;
+}
+
+bool WriteAddPrefix(SafeBrowsingStore* store, const SBAddPrefix& item) {
+  store->SetAddChunk(item.chunk_id);
+  return store->WriteAddPrefix(item.chunk_id, item.prefix);
+}
+
+bool WriteSubPrefix(SafeBrowsingStore* store, const SBSubPrefix& item) {
+  store->SetSubChunk(item.chunk_id);
+  return store->WriteSubPrefix(item.chunk_id, item.add_chunk_id,
+                               item.add_prefix);
+}
+
+bool WriteAddHash(SafeBrowsingStore* store, const SBAddFullHash& item) {
+  return store->WriteAddHash(item.chunk_id,
+                             base::Time::FromTimeT(item.received),
+                             item.full_hash);
+}
+
+bool WriteSubHash(SafeBrowsingStore* store, const SBSubFullHash& item) {
+  return store->WriteSubHash(item.chunk_id, item.add_chunk_id,
+                             item.full_hash);
+}
+
+// Orders full hashes which only differ in when they were received.
+bool AddHashLess(const SBAddFullHash& a, const SBAddFullHash& b) {
+  if (SBAddPrefixHashLess(a, b))
+    return true;
+  if (SBAddPrefixHashLess(b, a))
+    return false;
+  return a.received < b.received;
+}
+
+// Applies |update| to |store|, returning the results in
+// |add_prefixes| and |add_hashes| in a canonical order.
+bool ApplyUpdate(SafeBrowsingStore* store,
+                 const TestUpdate& update,
+                 SBAddPrefixes* add_prefixes,
+                 std::vector<SBAddFullHash>* add_hashes) {
+  if (!store->BeginUpdate() ||
+      !WriteChunks(store, update.add_prefixes, &WriteAddPrefix) ||
+      !WriteChunks(store, update.sub_prefixes, &WriteSubPrefix) ||
+      !WriteChunks(store, update.add_hashes, &WriteAddHash) ||
+      !WriteChunks(store, update.sub_hashes, &WriteSubHash))
+    return false;
+  for (size_t i = 0; i < update.deleted_add_chunks.size(); ++i)
+    store->DeleteAddChunk(update.deleted_add_chunks[i]);
+
+  const std::set<SBPrefix> prefix_misses;
+  if (!store->FinishUpdate(update.pending_adds, prefix_misses,
+                           add_prefixes, add_hashes))
+    return false;
+
+  std::sort(add_prefixes->begin(), add_prefixes->end(),
+            SBAddPrefixLess<SBAddPrefix, SBAddPrefix>);
+  std::sort(add_hashes->begin(), add_hashes->end(), AddHashLess);
+  return true;
+}
+
+// Test that a streaming update leaves the same data as the in-memory
+// update, over several updates which each take more than one run.
+TEST_F(SafeBrowsingStoreFileStreamingTest, MatchesInMemoryUpdate) {
+  const FilePath in_memory_filename =
+      temp_dir_.path().AppendASCII("SafeBrowsingTestStoreInMemory");
+  SafeBrowsingStoreFile in_memory_store;
+  in_memory_store.Init(in_memory_filename, base::Closure());
+  in_memory_store.set_streaming_update(false);
+
+  int32 add_chunk_id = 0;
+  int32 sub_chunk_id = 0;
+  for (int i = 0; i < 3; ++i) {
+    const TestUpdate update = MakeRandomUpdate(&add_chunk_id, &sub_chunk_id);
+
+    SBAddPrefixes add_prefixes;
+    std::vector<SBAddFullHash> add_hashes;
+    ASSERT_TRUE(ApplyUpdate(store_.get(), update, &add_prefixes,
+                            &add_hashes));
+    EXPECT_FALSE(file_util::PathExists(
+        SafeBrowsingStoreFile::MergeFileForFilename(filename_)));
+
+    SBAddPrefixes expected_add_prefixes;
+    std::vector<SBAddFullHash> expected_add_hashes;
+    ASSERT_TRUE(ApplyUpdate(&in_memory_store, update, &expected_add_prefixes,
+                            &expected_add_hashes));
+
+    ASSERT_EQ(expected_add_prefixes.size(), add_prefixes.size());
+    for (size_t j = 0; j < add_prefixes.size(); ++j) {
+      EXPECT_EQ(expected_add_prefixes[j].chunk_id, add_prefixes[j].chunk_id);
+      EXPECT_EQ(expected_add_prefixes[j].prefix, add_prefixes[j].prefix);
+    }
+    ASSERT_EQ(expected_add_hashes.size(), add_hashes.size());
+    for (size_t j = 0; j < add_hashes.size(); ++j) {
+      EXPECT_EQ(expected_add_hashes[j].chunk_id, add_hashes[j].chunk_id);
+      EXPECT_EQ(expected_add_hashes[j].received, add_hashes[j].received);
+      EXPECT_TRUE(SBFullHashEq(expected_add_hashes[j].full_hash,
+                               add_hashes[j].full_hash));
+    }
+
+    // Both files hold the same number of bytes of sub prefixes and
+    // everything else.
+    int64 size = 0;
+    int64 expected_size = 0;
+    ASSERT_TRUE(file_util::GetFileSize(filename_, &size));
+    ASSERT_TRUE(file_util::GetFileSize(in_memory_filename, &expected_size));
+    EXPECT_EQ(expected_size, size);
+  }
+
+  EXPECT_TRUE(in_memory_store.Delete());
+}
+
+// Test that a streaming update checks the file's checksum.
+TEST_F(SafeBrowsingStoreFileStreamingTest, DetectsCorruption) {
+  SafeBrowsingStoreTestStorePrefix(store_.get());
+
+  // Corrupt the payload.
+  {
+    file_util::ScopedFILE file(file_util::OpenFile(filename_, "rb+"));
+    const long kOffset = 60;
+    EXPECT_EQ(0, fseek(file.get(), kOffset, SEEK_SET));
+    EXPECT_GE(fputs("hello", file.get()), 0);
+  }
+
+  std::vector<SBAddFullHash> pending_adds;
+  std::set<SBPrefix> prefix_misses;
+  SBAddPrefixes add_prefixes;
+  std::vector<SBAddFullHash> add_hashes;
+  EXPECT_TRUE(store_->BeginUpdate());
+  EXPECT_FALSE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                    &add_prefixes, &add_hashes));
+  EXPECT_TRUE(corruption_detected_);
+  EXPECT_EQ(0U, add_prefixes.size());
+  EXPECT_EQ(0U, add_hashes.size());
+}
+
 }  // namespace
@@ -108,6 +108,14 @@ void BaseSessionService::ScheduleCommand(SessionCommand* command) {
   StartSaveTimer();
 }
 
+void BaseSessionService::ScheduleCompaction(
+    const CompactCommandsCallback& compact) {
+  commands_since_reset_ = 0;
+  RunTaskOnBackendThread(
+      FROM_HERE,
+      base::Bind(&SessionBackend::CompactCurrentSession, backend(), compact));
+}
+
 void BaseSessionService::StartSaveTimer() {
   // Don't start a timer when testing (profile == NULL or
   // MessageLoop::current() is NULL).
@@ -53,6 +53,11 @@ class BaseSessionService : public CancelableRequestProvider {
   typedef base::Callback<void(ScopedVector<SessionCommand>)>
       InternalGetCommandsCallback;
 
+  // Replaces the commands read from the current session file with fewer
+  // commands that restore the same session. Run on the backend thread.
+  typedef base::Callback<void(std::vector<SessionCommand*>*)>
+      CompactCommandsCallback;
+
  protected:
   virtual ~BaseSessionService();
 
@@ -70,7 +75,8 @@ class BaseSessionService : public CancelableRequestProvider {
   void set_pending_reset(bool value) { pending_reset_ = value; }
   bool pending_reset() const { return pending_reset_; }
 
-  // Returns the number of commands sent down since the last reset.
+  // Returns the number of commands sent down since the last reset or
+  // compaction.
   int commands_since_reset() const { return commands_since_reset_; }
 
   // Schedules a command. This adds |command| to pending_commands_ and
@@ -78,6 +84,11 @@ class BaseSessionService : public CancelableRequestProvider {
   // time.
   virtual void ScheduleCommand(SessionCommand* command);
 
+  // Has the backend rewrite the current session file as the commands
+  // |compact| leaves of those in it. Unlike a reset this doesn't need the
+  // state of the browser, and runs on the backend thread.
+  void ScheduleCompaction(const CompactCommandsCallback& compact);
+
   // Starts the timer that invokes Save (if timer isn't already running).
   void StartSaveTimer();
 
@@ -305,6 +305,48 @@ bool SessionBackend::ReadCurrentSessionCommandsImpl(
   return file_reader.Read(type_, commands);
 }
 
+void SessionBackend::CompactCurrentSession(
+    const BaseSessionService::CompactCommandsCallback& compact) {
+  Init();
+  if (!current_session_file_.get() || !current_session_file_->IsOpen())
+    return;
+
+  // The file is opened for exclusive access, so it has to be closed to be
+  // read back.
+  current_session_file_.reset(NULL);
+
+  TimeTicks start_time = TimeTicks::Now();
+  const FilePath current_session_path = GetCurrentSessionPath();
+  ScopedVector<SessionCommand> commands;
+  if (SessionFileReader(current_session_path).Read(type_,
+                                                   &(commands.get()))) {
+    compact.Run(&(commands.get()));
+
+    const FilePath compacted_session_path = GetCompactedSessionPath();
+    scoped_ptr<net::FileStream> compacted_file(
+        OpenAndWriteHeader(compacted_session_path));
+    bool wrote = compacted_file.get() &&
+        AppendCommandsToFile(compacted_file.get(), commands.get());
+    compacted_file.reset(NULL);
+    if (wrote &&
+        file_util::Move(compacted_session_path, current_session_path)) {
+      empty_file_ = commands.empty();
+      if (type_ == BaseSessionService::TAB_RESTORE) {
+        UMA_HISTOGRAM_TIMES("TabRestore.compact_session_file_time",
+                            TimeTicks::Now() - start_time);
+      } else {
+        UMA_HISTOGRAM_TIMES("SessionRestore.compact_session_file_time",
+                            TimeTicks::Now() - start_time);
+      }
+    } else {
+      file_util::Delete(compacted_session_path, false);
+    }
+  }
+
+  // If this fails the next commands appended reset the file.
+  current_session_file_.reset(OpenForAppend(current_session_path));
+}
+
 bool SessionBackend::AppendCommandsToFile(net::FileStream* file,
     const std::vector<SessionCommand*>& commands) {
   for (std::vector<SessionCommand*>::const_iterator i = commands.begin();
@@ -384,6 +426,19 @@ net::FileStream* SessionBackend::OpenAndWriteHeader(const FilePath& path) {
   return file.release();
 }
 
+net::FileStream* SessionBackend::OpenForAppend(const FilePath& path) {
+  DCHECK(!path.empty());
+  scoped_ptr<net::FileStream> file(new net::FileStream(NULL));
+  if (file->OpenSync(path, base::PLATFORM_FILE_OPEN |
+      base::PLATFORM_FILE_WRITE | base::PLATFORM_FILE_EXCLUSIVE_WRITE |
+      base::PLATFORM_FILE_EXCLUSIVE_READ) != net::OK)
+    return NULL;
+  const int64 header_size = static_cast<int64>(sizeof(FileHeader));
+  if (file->SeekSync(net::FROM_END, 0) < header_size)
+    return NULL;
+  return file.release();
+}
+
 FilePath SessionBackend::GetLastSessionPath() {
   FilePath path = path_to_dir_;
   if (type_ == BaseSessionService::TAB_RESTORE)
@@ -401,3 +456,7 @@ FilePath SessionBackend::GetCurrentSessionPath() {
     path = path.AppendASCII(kCurrentSessionFileName);
   return path;
 }
+
+FilePath SessionBackend::GetCompactedSessionPath() {
+  return GetCurrentSessionPath().AddExtension(FILE_PATH_LITERAL("compact"));
+}
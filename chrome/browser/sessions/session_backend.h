@@ -90,6 +90,13 @@ class SessionBackend : public base::RefCountedThreadSafe<SessionBackend> {
   // caller to delete the commands.
   bool ReadCurrentSessionCommandsImpl(std::vector<SessionCommand*>* commands);
 
+  // Rewrites the current file as the commands |compact| leaves of those read
+  // from it. The rewritten file is written alongside and moved over the
+  // current one, so the current file is left as it was if rewriting fails.
+  // Commands appended afterwards follow the compacted ones.
+  void CompactCurrentSession(
+      const BaseSessionService::CompactCommandsCallback& compact);
+
  private:
   friend class base::RefCountedThreadSafe<SessionBackend>;
 
@@ -107,6 +114,10 @@ class SessionBackend : public base::RefCountedThreadSafe<SessionBackend> {
   // the file is returned.
   net::FileStream* OpenAndWriteHeader(const FilePath& path);
 
+  // Opens the file at |path| for appending commands to it. On success a handle
+  // to the file is returned.
+  net::FileStream* OpenForAppend(const FilePath& path);
+
   // Appends the specified commands to the specified file.
   bool AppendCommandsToFile(net::FileStream* file,
                             const std::vector<SessionCommand*>& commands);
@@ -119,6 +130,9 @@ class SessionBackend : public base::RefCountedThreadSafe<SessionBackend> {
   // Returns the path to the current file.
   FilePath GetCurrentSessionPath();
 
+  // Returns the path the current file is compacted to before replacing it.
+  FilePath GetCompactedSessionPath();
+
   // Directory files are relative to.
   const FilePath path_to_dir_;
 
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/bind.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/stl_util.h"
@@ -28,6 +29,15 @@ SessionCommand* CreateCommandFromData(const TestData& data) {
   return command;
 }
 
+// Stands in for the compaction of SessionService, keeping only the last
+// command.
+void KeepLastCommand(std::vector<SessionCommand*>* commands) {
+  if (commands->size() > 1) {
+    STLDeleteContainerPointers(commands->begin(), commands->end() - 1);
+    commands->erase(commands->begin(), commands->end() - 1);
+  }
+}
+
 }  // namespace
 
 class SessionBackendTest : public testing::Test {
@@ -207,3 +217,38 @@ TEST_F(SessionBackendTest, Truncate) {
 
   STLDeleteElements(&commands);
 }
+
+// Compacts the current file, then appends another command, making sure the
+// command follows the compacted ones.
+TEST_F(SessionBackendTest, Compact) {
+  struct TestData data[] = {
+    { 1,  "a" },
+    { 2,  "ab" },
+    { 3,  "abc" },
+    { 4,  "abcd" },
+  };
+
+  scoped_refptr<SessionBackend> backend(
+      new SessionBackend(BaseSessionService::SESSION_RESTORE, path_));
+  std::vector<SessionCommand*> commands;
+  for (size_t i = 0; i < 3; ++i)
+    commands.push_back(CreateCommandFromData(data[i]));
+  backend->AppendCommands(new SessionCommands(commands), false);
+  commands.clear();
+
+  backend->CompactCurrentSession(base::Bind(&KeepLastCommand));
+
+  commands.push_back(CreateCommandFromData(data[3]));
+  backend->AppendCommands(new SessionCommands(commands), false);
+  commands.clear();
+
+  // Read it back in.
+  backend = NULL;
+  backend = new SessionBackend(BaseSessionService::SESSION_RESTORE, path_);
+  backend->ReadLastSessionCommandsImpl(&commands);
+
+  ASSERT_EQ(2U, commands.size());
+  AssertCommandEqualsData(data[2], commands[0]);
+  AssertCommandEqualsData(data[3], commands[1]);
+  STLDeleteElements(&commands);
+}
@@ -5,6 +5,7 @@
 #include "chrome/browser/sessions/session_service.h"
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -16,6 +17,7 @@
 #include "base/message_loop.h"
 #include "base/metrics/histogram.h"
 #include "base/pickle.h"
+#include "base/stl_util.h"
 #include "base/threading/thread.h"
 #include "chrome/browser/extensions/tab_helper.h"
 #include "chrome/browser/prefs/session_startup_pref.h"
@@ -31,6 +33,7 @@
 #include "chrome/browser/ui/startup/startup_browser_creator.h"
 #include "chrome/browser/ui/tabs/tab_strip_model.h"
 #include "chrome/common/chrome_notification_types.h"
+#include "chrome/common/chrome_switches.h"
 #include "chrome/common/extensions/extension.h"
 #include "content/public/browser/navigation_details.h"
 #include "content/public/browser/navigation_entry.h"
@@ -171,6 +174,517 @@ bool MigrateClosedPayload(const SessionCommand& command,
 #endif
 }
 
+
+// SessionCommandCompactor ----------------------------------------------------
+
+// Compacts the commands of a session file down to those needed to restore the
+// latest state of each tab and window, as CreateTabsAndWindows would build it.
+// Commands are kept or dropped whole rather than rebuilt, so no SessionTab or
+// SessionWindow (whose ids are handed out on the UI thread) is created, and
+// compacting can run on the backend thread.
+//
+// The commands kept for each tab are written together, as a checkpoint of the
+// tab, with the tabs of each window in the order they are shown.
+class SessionCommandCompactor {
+ public:
+  SessionCommandCompactor();
+  ~SessionCommandCompactor();
+
+  // Replaces |commands| with those needed to restore the same session,
+  // deleting the others.
+  void Compact(std::vector<SessionCommand*>* commands);
+
+ private:
+  typedef std::map<int, SessionCommand*> IndexToNavigation;
+
+  // The navigations written for a tab up to the next time its navigations were
+  // pruned from the front, by the index they were written with, along with the
+  // prune.
+  struct NavigationRun {
+    NavigationRun();
+    ~NavigationRun();
+
+    bool empty() const {
+      return navigations.empty() && !selected_navigation_index;
+    }
+
+    IndexToNavigation navigations;
+    SessionCommand* selected_navigation_index;
+    SessionCommand* pruned_from_front;
+    int pruned_count;
+  };
+
+  // The latest command of each kind written for a tab, and its navigations.
+  struct TabCheckpoint {
+    TabCheckpoint();
+    ~TabCheckpoint();
+
+    SessionID::id_type window_id;
+    int visual_index;
+    SessionCommand* tab_window;
+    SessionCommand* tab_index_in_window;
+    SessionCommand* pinned_state;
+    SessionCommand* extension_app_id;
+    SessionCommand* user_agent_override;
+    SessionCommand* session_storage_associated;
+    // Never empty; navigations are written to the last run.
+    ScopedVector<NavigationRun> runs;
+  };
+
+  // The latest command of each kind written for a window.
+  struct WindowCheckpoint {
+    WindowCheckpoint();
+    ~WindowCheckpoint();
+
+    SessionCommand* bounds;
+    SessionCommand* type;
+    SessionCommand* selected_tab_in_index;
+    SessionCommand* app_name;
+  };
+
+  typedef std::map<SessionID::id_type, TabCheckpoint*> IdToTabCheckpoint;
+  typedef std::map<SessionID::id_type, WindowCheckpoint*>
+      IdToWindowCheckpoint;
+
+  // Takes ownership of |command|, keeping it if it is needed. Returns false if
+  // the command can't be read, in which case restore stops at it.
+  bool Add(SessionCommand* command);
+
+  // Records that the navigations of |tab| were pruned, which drops those that
+  // are no longer needed.
+  void PruneFromBack(TabCheckpoint* tab, int count);
+  void PruneFromFront(TabCheckpoint* tab,
+                      int count,
+                      SessionCommand* command);
+
+  // Adds the navigation with |index| to |tab|, replacing any written with the
+  // same index before.
+  void UpdateNavigation(TabCheckpoint* tab,
+                        int index,
+                        SessionCommand* command);
+
+  // Sets the selected navigation index of |tab|.
+  void SetSelectedNavigationIndex(TabCheckpoint* tab,
+                                  SessionCommand* command);
+
+  // Drops the runs at the front of |tab| that have nothing left to prune.
+  void DropEmptyRuns(TabCheckpoint* tab);
+
+  // Moves the commands of |tab| to the end of |commands|.
+  void ReleaseTab(TabCheckpoint* tab, std::vector<SessionCommand*>* commands);
+
+  TabCheckpoint* GetTab(SessionID::id_type tab_id);
+  WindowCheckpoint* GetWindow(SessionID::id_type window_id);
+
+  IdToTabCheckpoint tabs_;
+  IdToWindowCheckpoint windows_;
+  SessionCommand* active_window_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionCommandCompactor);
+};
+
+// Replaces the command in |slot| with |command|.
+void ReplaceCommand(SessionCommand** slot, SessionCommand* command) {
+  delete *slot;
+  *slot = command;
+}
+
+// Moves the command in |slot|, if any, to the end of |commands|.
+void ReleaseCommand(SessionCommand** slot,
+                    std::vector<SessionCommand*>* commands) {
+  if (*slot)
+    commands->push_back(*slot);
+  *slot = NULL;
+}
+
+// Reads the id written at the start of a pickled command, and the string
+// following it.
+bool ReadIdAndString(const SessionCommand& command,
+                     SessionID::id_type* id,
+                     std::string* value) {
+  scoped_ptr<Pickle> pickle(command.PayloadAsPickle());
+  PickleIterator iterator(*pickle);
+  return pickle->ReadInt(&iterator, id) &&
+      pickle->ReadString(&iterator, value);
+}
+
+SessionCommandCompactor::NavigationRun::NavigationRun()
+    : selected_navigation_index(NULL),
+      pruned_from_front(NULL),
+      pruned_count(0) {
+}
+
+SessionCommandCompactor::NavigationRun::~NavigationRun() {
+  STLDeleteValues(&navigations);
+  delete selected_navigation_index;
+  delete pruned_from_front;
+}
+
+SessionCommandCompactor::TabCheckpoint::TabCheckpoint()
+    : window_id(0),
+      visual_index(-1),
+      tab_window(NULL),
+      tab_index_in_window(NULL),
+      pinned_state(NULL),
+      extension_app_id(NULL),
+      user_agent_override(NULL),
+      session_storage_associated(NULL) {
+  runs.push_back(new NavigationRun());
+}
+
+SessionCommandCompactor::TabCheckpoint::~TabCheckpoint() {
+  delete tab_window;
+  delete tab_index_in_window;
+  delete pinned_state;
+  delete extension_app_id;
+  delete user_agent_override;
+  delete session_storage_associated;
+}
+
+SessionCommandCompactor::WindowCheckpoint::WindowCheckpoint()
+    : bounds(NULL),
+      type(NULL),
+      selected_tab_in_index(NULL),
+      app_name(NULL) {
+}
+
+SessionCommandCompactor::WindowCheckpoint::~WindowCheckpoint() {
+  delete bounds;
+  delete type;
+  delete selected_tab_in_index;
+  delete app_name;
+}
+
+SessionCommandCompactor::SessionCommandCompactor() : active_window_(NULL) {
+}
+
+SessionCommandCompactor::~SessionCommandCompactor() {
+  STLDeleteValues(&tabs_);
+  STLDeleteValues(&windows_);
+  delete active_window_;
+}
+
+void SessionCommandCompactor::Compact(std::vector<SessionCommand*>* commands) {
+  std::vector<SessionCommand*>::iterator i = commands->begin();
+  while (i != commands->end() && Add(*i))
+    ++i;
+  // Restore stops at a command it can't read, so the rest are never applied.
+  if (i != commands->end())
+    STLDeleteContainerPointers(i + 1, commands->end());
+  commands->clear();
+
+  for (IdToWindowCheckpoint::iterator j = windows_.begin();
+       j != windows_.end(); ++j) {
+    ReleaseCommand(&j->second->type, commands);
+    ReleaseCommand(&j->second->bounds, commands);
+    ReleaseCommand(&j->second->app_name, commands);
+    ReleaseCommand(&j->second->selected_tab_in_index, commands);
+  }
+
+  // The tabs of each window in the order they are shown.
+  std::vector<std::pair<std::pair<SessionID::id_type, int>, TabCheckpoint*> >
+      tabs;
+  for (IdToTabCheckpoint::iterator j = tabs_.begin(); j != tabs_.end(); ++j) {
+    tabs.push_back(std::make_pair(
+        std::make_pair(j->second->window_id, j->second->visual_index),
+        j->second));
+  }
+  std::stable_sort(tabs.begin(), tabs.end());
+  for (size_t j = 0; j < tabs.size(); ++j)
+    ReleaseTab(tabs[j].second, commands);
+
+  ReleaseCommand(&active_window_, commands);
+}
+
+bool SessionCommandCompactor::Add(SessionCommand* command) {
+  const SessionCommand::id_type kCommandSetWindowBounds2 = 10;
+  scoped_ptr<SessionCommand> owned_command(command);
+
+  switch (command->id()) {
+    case kCommandSetTabWindow: {
+      SessionID::id_type payload[2];
+      if (!command->GetPayload(payload, sizeof(payload)))
+        return false;
+      TabCheckpoint* tab = GetTab(payload[1]);
+      tab->window_id = payload[0];
+      ReplaceCommand(&tab->tab_window, owned_command.release());
+      return true;
+    }
+
+    case kCommandSetWindowBounds2: {
+      WindowBoundsPayload2 payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      ReplaceCommand(&GetWindow(payload.window_id)->bounds,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSetWindowBounds3: {
+      WindowBoundsPayload3 payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      ReplaceCommand(&GetWindow(payload.window_id)->bounds,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSetTabIndexInWindow: {
+      TabIndexInWindowPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      TabCheckpoint* tab = GetTab(payload.id);
+      tab->visual_index = payload.index;
+      ReplaceCommand(&tab->tab_index_in_window, owned_command.release());
+      return true;
+    }
+
+    case kCommandTabClosedObsolete:
+    case kCommandWindowClosedObsolete:
+    case kCommandTabClosed:
+    case kCommandWindowClosed: {
+      ClosedPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)) &&
+          !MigrateClosedPayload(*command, &payload)) {
+        return false;
+      }
+      // Whatever was written for the tab or window before is forgotten.
+      if (command->id() == kCommandTabClosed ||
+          command->id() == kCommandTabClosedObsolete) {
+        delete tabs_[payload.id];
+        tabs_.erase(payload.id);
+      } else {
+        delete windows_[payload.id];
+        windows_.erase(payload.id);
+      }
+      return true;
+    }
+
+    case kCommandTabNavigationPathPrunedFromBack: {
+      TabNavigationPathPrunedFromBackPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      PruneFromBack(GetTab(payload.id), payload.index);
+      return true;
+    }
+
+    case kCommandTabNavigationPathPrunedFromFront: {
+      TabNavigationPathPrunedFromFrontPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)) ||
+          payload.index <= 0) {
+        return false;
+      }
+      PruneFromFront(GetTab(payload.id), payload.index,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandUpdateTabNavigation: {
+      scoped_ptr<Pickle> pickle(command->PayloadAsPickle());
+      PickleIterator iterator(*pickle);
+      SessionID::id_type tab_id;
+      TabNavigation navigation;
+      if (!pickle->ReadInt(&iterator, &tab_id) ||
+          !navigation.ReadFromPickle(&iterator)) {
+        return false;
+      }
+      UpdateNavigation(GetTab(tab_id), navigation.index(),
+                       owned_command.release());
+      return true;
+    }
+
+    case kCommandSetSelectedNavigationIndex: {
+      SelectedNavigationIndexPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      SetSelectedNavigationIndex(GetTab(payload.id), owned_command.release());
+      return true;
+    }
+
+    case kCommandSetSelectedTabInIndex: {
+      SelectedTabInIndexPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      ReplaceCommand(&GetWindow(payload.id)->selected_tab_in_index,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSetWindowType: {
+      WindowTypePayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      ReplaceCommand(&GetWindow(payload.id)->type, owned_command.release());
+      return true;
+    }
+
+    case kCommandSetPinnedState: {
+      PinnedStatePayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      ReplaceCommand(&GetTab(payload.tab_id)->pinned_state,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSetWindowAppName: {
+      SessionID::id_type window_id;
+      std::string app_name;
+      if (!ReadIdAndString(*command, &window_id, &app_name))
+        return false;
+      ReplaceCommand(&GetWindow(window_id)->app_name, owned_command.release());
+      return true;
+    }
+
+    case kCommandSetExtensionAppID: {
+      SessionID::id_type tab_id;
+      std::string extension_app_id;
+      if (!ReadIdAndString(*command, &tab_id, &extension_app_id))
+        return false;
+      ReplaceCommand(&GetTab(tab_id)->extension_app_id,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSetTabUserAgentOverride: {
+      SessionID::id_type tab_id;
+      std::string user_agent_override;
+      if (!ReadIdAndString(*command, &tab_id, &user_agent_override))
+        return false;
+      ReplaceCommand(&GetTab(tab_id)->user_agent_override,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSessionStorageAssociated: {
+      SessionID::id_type tab_id;
+      std::string session_storage_persistent_id;
+      if (!ReadIdAndString(*command, &tab_id, &session_storage_persistent_id))
+        return false;
+      ReplaceCommand(&GetTab(tab_id)->session_storage_associated,
+                     owned_command.release());
+      return true;
+    }
+
+    case kCommandSetActiveWindow: {
+      ActiveWindowPayload payload;
+      if (!command->GetPayload(&payload, sizeof(payload)))
+        return false;
+      ReplaceCommand(&active_window_, owned_command.release());
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+void SessionCommandCompactor::PruneFromBack(TabCheckpoint* tab, int count) {
+  // A navigation written before the last prune from the front has since
+  // moved down by the number of navigations pruned.
+  int shift = 0;
+  for (size_t i = tab->runs.size(); i-- > 0;) {
+    NavigationRun* run = tab->runs[i];
+    shift += run->pruned_count;
+    IndexToNavigation::iterator first_pruned =
+        run->navigations.lower_bound(count + shift);
+    STLDeleteContainerPairSecondPointers(first_pruned, run->navigations.end());
+    run->navigations.erase(first_pruned, run->navigations.end());
+  }
+  DropEmptyRuns(tab);
+}
+
+void SessionCommandCompactor::PruneFromFront(TabCheckpoint* tab,
+                                             int count,
+                                             SessionCommand* command) {
+  int shift = 0;
+  for (size_t i = tab->runs.size(); i-- > 0;) {
+    NavigationRun* run = tab->runs[i];
+    shift += run->pruned_count;
+    IndexToNavigation::iterator first_kept =
+        run->navigations.lower_bound(count + shift);
+    STLDeleteContainerPairSecondPointers(run->navigations.begin(), first_kept);
+    run->navigations.erase(run->navigations.begin(), first_kept);
+  }
+  // The prune moves down the indices of the navigations and the selected
+  // navigation index written before it, so it is kept after them.
+  NavigationRun* run = tab->runs.back();
+  run->pruned_from_front = command;
+  run->pruned_count = count;
+  tab->runs.push_back(new NavigationRun());
+  DropEmptyRuns(tab);
+}
+
+void SessionCommandCompactor::UpdateNavigation(TabCheckpoint* tab,
+                                               int index,
+                                               SessionCommand* command) {
+  int shift = 0;
+  for (size_t i = tab->runs.size() - 1; i-- > 0;) {
+    NavigationRun* run = tab->runs[i];
+    shift += run->pruned_count;
+    IndexToNavigation::iterator replaced =
+        run->navigations.find(index + shift);
+    if (replaced != run->navigations.end()) {
+      delete replaced->second;
+      run->navigations.erase(replaced);
+    }
+  }
+  ReplaceCommand(&tab->runs.back()->navigations[index], command);
+  DropEmptyRuns(tab);
+}
+
+void SessionCommandCompactor::SetSelectedNavigationIndex(
+    TabCheckpoint* tab,
+    SessionCommand* command) {
+  for (size_t i = 0; i < tab->runs.size(); ++i)
+    ReplaceCommand(&tab->runs[i]->selected_navigation_index, NULL);
+  tab->runs.back()->selected_navigation_index = command;
+  DropEmptyRuns(tab);
+}
+
+void SessionCommandCompactor::DropEmptyRuns(TabCheckpoint* tab) {
+  // A prune from the front with nothing written before it has no effect.
+  while (tab->runs.size() > 1 && tab->runs.front()->empty())
+    tab->runs.erase(tab->runs.begin());
+}
+
+void SessionCommandCompactor::ReleaseTab(
+    TabCheckpoint* tab,
+    std::vector<SessionCommand*>* commands) {
+  ReleaseCommand(&tab->tab_window, commands);
+  ReleaseCommand(&tab->tab_index_in_window, commands);
+  ReleaseCommand(&tab->pinned_state, commands);
+  ReleaseCommand(&tab->extension_app_id, commands);
+  ReleaseCommand(&tab->user_agent_override, commands);
+  ReleaseCommand(&tab->session_storage_associated, commands);
+  for (size_t i = 0; i < tab->runs.size(); ++i) {
+    NavigationRun* run = tab->runs[i];
+    for (IndexToNavigation::iterator j = run->navigations.begin();
+         j != run->navigations.end(); ++j) {
+      commands->push_back(j->second);
+    }
+    run->navigations.clear();
+    ReleaseCommand(&run->selected_navigation_index, commands);
+    ReleaseCommand(&run->pruned_from_front, commands);
+  }
+}
+
+SessionCommandCompactor::TabCheckpoint* SessionCommandCompactor::GetTab(
+    SessionID::id_type tab_id) {
+  TabCheckpoint*& tab = tabs_[tab_id];
+  if (!tab)
+    tab = new TabCheckpoint();
+  return tab;
+}
+
+SessionCommandCompactor::WindowCheckpoint* SessionCommandCompactor::GetWindow(
+    SessionID::id_type window_id) {
+  WindowCheckpoint*& window = windows_[window_id];
+  if (!window)
+    window = new WindowCheckpoint();
+  return window;
+}
+
 }  // namespace
 
 // SessionService -------------------------------------------------------------
@@ -1412,6 +1926,11 @@ void SessionService::ScheduleReset() {
   StartSaveTimer();
 }
 
+// static
+void SessionService::CompactCommands(std::vector<SessionCommand*>* commands) {
+  SessionCommandCompactor().Compact(commands);
+}
+
 bool SessionService::ReplacePendingCommand(SessionCommand* command) {
   // We optimize page navigations, which can happen quite frequently and
   // are expensive. And activation is like Highlander, there can only be one!
@@ -1478,7 +1997,12 @@ void SessionService::ScheduleCommand(SessionCommand* command) {
       commands_since_reset() >= kWritesPerReset &&
       (command->id() != kCommandTabClosed &&
        command->id() != kCommandWindowClosed)) {
-    ScheduleReset();
+    if (CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kEnableSessionLogCompaction)) {
+      ScheduleCompaction(base::Bind(&SessionService::CompactCommands));
+    } else {
+      ScheduleReset();
+    }
   }
 }
 
@@ -53,11 +53,14 @@ class WebContents;
 // SessionWindow, SessionTab and TabNavigation). The commands are periodically
 // flushed to SessionBackend and written to a file. Every so often
 // SessionService rebuilds the contents of the file from the open state
-// of the browser.
+// of the browser. With --enable-session-log-compaction the file is instead
+// compacted on the backend thread, down to the commands for the latest state
+// of each tab and window.
 class SessionService : public BaseSessionService,
                        public ProfileKeyedService,
                        public content::NotificationObserver,
                        public chrome::BrowserListObserver {
+  friend class SessionServicePerfTest;
   friend class SessionServiceTestHelper;
  public:
   // Used to distinguish an application window from a normal one.
@@ -196,6 +199,12 @@ class SessionService : public BaseSessionService,
   // session update activities.
   virtual void Save() OVERRIDE;
 
+  // Replaces |commands|, read from the current session file, with the
+  // commands needed to restore the latest state of each tab and window. This
+  // is used in place of a reset if --enable-session-log-compaction is given,
+  // and runs on the backend thread.
+  static void CompactCommands(std::vector<SessionCommand*>* commands);
+
  private:
   // Allow tests to access our innards for testing purposes.
   FRIEND_TEST_ALL_PREFIXES(SessionServiceTest, RestoreActivation1);
@@ -0,0 +1,191 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/sessions/session_backend.h"
+#include "chrome/browser/sessions/session_command.h"
+#include "chrome/browser/sessions/session_id.h"
+#include "chrome/browser/sessions/session_service.h"
+#include "chrome/browser/sessions/session_types.h"
+#include "chrome/browser/ui/browser.h"
+#include "content/public/browser/navigation_entry.h"
+#include "content/public/browser/notification_service.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// The shape of a large session.
+const int kWindowCount = 5;
+const int kTabsPerWindow = 100;
+
+// The pages visited in each tab, and the tabs opened and closed again in each
+// window while browsing.
+const int kNavigationsPerTab = 30;
+const int kClosedTabsPerWindow = 20;
+
+// The size of the page state saved with each navigation.
+const size_t kContentStateSize = 1024;
+
+}  // namespace
+
+// Writes the commands of a long-running session with hundreds of tabs, and
+// compares the appended log with the log compacted by SessionService for its
+// size and the time taken to restore it.
+class SessionServicePerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    notification_service_.reset(content::NotificationService::Create());
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    service_.reset(new SessionService(temp_dir_.path()));
+    // The commands are taken rather than saved, so keep SessionService from
+    // resetting the file from the open browsers, of which there are none.
+    service_->set_pending_reset(true);
+  }
+
+  virtual void TearDown() OVERRIDE {
+    service_.reset();
+  }
+
+  // Makes the commands written for the session: each tab is navigated, with
+  // the navigation written again when its title arrives, and now and then goes
+  // back and navigates elsewhere, pruning the navigations after it.
+  void BuildSession(std::vector<SessionCommand*>* commands) {
+    for (int i = 0; i < kWindowCount; ++i) {
+      SessionID window_id;
+      service_->SetWindowType(window_id, Browser::TYPE_TABBED,
+                              SessionService::TYPE_NORMAL);
+      service_->SetWindowBounds(window_id, gfx::Rect(0, 0, 1024, 768),
+                                ui::SHOW_STATE_NORMAL);
+      for (int j = 0; j < kTabsPerWindow + kClosedTabsPerWindow; ++j) {
+        SessionID tab_id;
+        service_->SetTabWindow(window_id, tab_id);
+        service_->SetTabIndexInWindow(window_id, tab_id, j);
+        service_->SetSelectedTabInWindow(window_id, j);
+        BuildNavigations(window_id, tab_id, commands);
+        if (j >= kTabsPerWindow)
+          service_->TabClosed(window_id, tab_id, false);
+        TakeCommands(commands);
+      }
+    }
+  }
+
+  // Restores the session from |commands|, checking every tab is there.
+  void Restore(const std::vector<SessionCommand*>& commands) {
+    ScopedVector<SessionWindow> windows;
+    SessionID::id_type active_window_id = 0;
+    service_->RestoreSessionFromCommands(commands, &(windows.get()),
+                                         &active_window_id);
+    ASSERT_EQ(static_cast<size_t>(kWindowCount), windows.size());
+    for (size_t i = 0; i < windows.size(); ++i) {
+      EXPECT_EQ(static_cast<size_t>(kTabsPerWindow), windows[i]->tabs.size());
+    }
+  }
+
+  static void CompactCommands(size_t* command_count,
+                              std::vector<SessionCommand*>* commands) {
+    SessionService::CompactCommands(commands);
+    *command_count = commands->size();
+  }
+
+  const FilePath& path() const { return temp_dir_.path(); }
+
+ private:
+  void BuildNavigations(const SessionID& window_id,
+                        const SessionID& tab_id,
+                        std::vector<SessionCommand*>* commands) {
+    int index = 0;
+    for (int i = 0; i < kNavigationsPerTab; ++i) {
+      scoped_ptr<content::NavigationEntry> entry(
+          content::NavigationEntry::Create());
+      GURL url(base::StringPrintf("http://www.site%d.com/page%d.html",
+                                  tab_id.id(), i));
+      entry->SetURL(url);
+      entry->SetVirtualURL(url);
+      entry->SetContentState(std::string(kContentStateSize, 'x'));
+      service_->UpdateTabNavigation(
+          window_id, tab_id, TabNavigation::FromNavigationEntry(index, *entry));
+      service_->SetSelectedNavigationIndex(window_id, tab_id, index);
+      TakeCommands(commands);
+
+      entry->SetTitle(ASCIIToUTF16(base::StringPrintf("Page %d", i)));
+      service_->UpdateTabNavigation(
+          window_id, tab_id, TabNavigation::FromNavigationEntry(index, *entry));
+      TakeCommands(commands);
+
+      // Every fifth page, go back two pages; the next navigation prunes the
+      // ones after.
+      if (i % 5 == 4) {
+        index -= 2;
+        service_->SetSelectedNavigationIndex(window_id, tab_id, index);
+        service_->TabNavigationPathPrunedFromBack(window_id, tab_id,
+                                                  index + 1);
+      }
+      ++index;
+    }
+  }
+
+  // Takes the commands scheduled by SessionService, before it replaces any
+  // of them, as they would have been saved.
+  void TakeCommands(std::vector<SessionCommand*>* commands) {
+    std::vector<SessionCommand*>& pending_commands =
+        service_->pending_commands();
+    commands->insert(commands->end(), pending_commands.begin(),
+                     pending_commands.end());
+    pending_commands.clear();
+  }
+
+  scoped_ptr<content::NotificationService> notification_service_;
+  base::ScopedTempDir temp_dir_;
+  scoped_ptr<SessionService> service_;
+};
+
+TEST_F(SessionServicePerfTest, CompactedAgainstAppendedLog) {
+  for (int compact = 0; compact < 2; ++compact) {
+    const char* name = compact ? "compacted" : "log";
+    FilePath dir = path().AppendASCII(name);
+    scoped_refptr<SessionBackend> backend(
+        new SessionBackend(BaseSessionService::SESSION_RESTORE, dir));
+    backend->Init();
+
+    std::vector<SessionCommand*>* commands = new std::vector<SessionCommand*>;
+    BuildSession(commands);
+    size_t command_count = commands->size();
+    backend->AppendCommands(commands, false);
+    if (compact) {
+      PerfTimeLogger timer("Session_Compact");
+      backend->CompactCurrentSession(
+          base::Bind(&SessionServicePerfTest::CompactCommands,
+                     &command_count));
+    }
+    LogPerfResult(base::StringPrintf("Session_Commands_%s", name).c_str(),
+                  command_count, "commands");
+
+    backend->MoveCurrentSessionToLastSession();
+    int64 file_size = 0;
+    ASSERT_TRUE(file_util::GetFileSize(dir.AppendASCII("Last Session"),
+                                       &file_size));
+    LogPerfResult(base::StringPrintf("Session_FileSize_%s", name).c_str(),
+                  file_size / 1024, "kb");
+
+    PerfTimeLogger timer(base::StringPrintf("Session_Restore_%s",
+                                            name).c_str());
+    ScopedVector<SessionCommand> read_commands;
+    ASSERT_TRUE(backend->ReadLastSessionCommandsImpl(&(read_commands.get())));
+    Restore(read_commands.get());
+    timer.Done();
+  }
+}
@@ -4,6 +4,7 @@
 
 #include "chrome/browser/sessions/session_service_test_helper.h"
 
+#include "base/bind.h"
 #include "base/memory/scoped_vector.h"
 #include "chrome/browser/sessions/session_backend.h"
 #include "chrome/browser/sessions/session_id.h"
@@ -14,6 +15,18 @@
 
 using base::Time;
 
+namespace {
+
+void CountAndCompactCommands(size_t* command_count_before,
+                             size_t* command_count_after,
+                             std::vector<SessionCommand*>* commands) {
+  *command_count_before = commands->size();
+  SessionService::CompactCommands(commands);
+  *command_count_after = commands->size();
+}
+
+}  // namespace
+
 SessionServiceTestHelper::SessionServiceTestHelper() {}
 
 SessionServiceTestHelper::SessionServiceTestHelper(SessionService* service)
@@ -51,6 +64,16 @@ void SessionServiceTestHelper::SetForceBrowserNotAliveWithNoWindows(
       force_browser_not_alive_with_no_windows;
 }
 
+void SessionServiceTestHelper::CompactCurrentSession(
+    size_t* command_count_before,
+    size_t* command_count_after) {
+  *command_count_before = *command_count_after = 0;
+  service()->Save();
+  backend()->CompactCurrentSession(
+      base::Bind(&CountAndCompactCommands, command_count_before,
+                 command_count_after));
+}
+
 // Be sure and null out service to force closing the file.
 void SessionServiceTestHelper::ReadWindows(
     std::vector<SessionWindow*>* windows,
@@ -43,6 +43,12 @@ class SessionServiceTestHelper {
   void SetForceBrowserNotAliveWithNoWindows(
       bool force_browser_not_alive_with_no_windows);
 
+  // Saves the pending commands and compacts the current session as
+  // SessionService does with --enable-session-log-compaction, setting the
+  // number of commands in the file before and after.
+  void CompactCurrentSession(size_t* command_count_before,
+                             size_t* command_count_after);
+
   // Reads the contents of the last session.
   void ReadWindows(std::vector<SessionWindow*>* windows,
                    SessionID::id_type* active_window_id);
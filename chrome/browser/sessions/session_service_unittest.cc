@@ -928,6 +928,101 @@ TEST_F(SessionServiceTest, ReplacePendingNavigationAndPrune) {
             windows[0]->tabs[0]->navigations[0].virtual_url());
 }
 
+// Makes sure compacting the session keeps the latest state of each tab.
+TEST_F(SessionServiceTest, CompactKeepsLatestState) {
+  const std::string base_url("http://google.com/");
+  SessionID tab_id;
+  SessionID tab2_id;
+  SessionID tab3_id;
+
+  // Navigate the first tab five times, rewriting each navigation, then prune
+  // the last two.
+  helper_.PrepareTabInWindow(window_id, tab_id, 0, true);
+  for (int i = 0; i < 10; ++i) {
+    TabNavigation nav =
+        SessionTypesTestHelper::CreateNavigation(
+            base_url + base::IntToString(i), "a");
+    nav.set_index(i / 2);
+    UpdateNavigation(window_id, tab_id, nav, true);
+  }
+  service()->TabNavigationPathPrunedFromBack(window_id, tab_id, 3);
+
+  // Close the second tab.
+  TabNavigation nav2 =
+      SessionTypesTestHelper::CreateNavigation("http://google2.com", "b");
+  helper_.PrepareTabInWindow(window_id, tab2_id, 1, false);
+  UpdateNavigation(window_id, tab2_id, nav2, true);
+  service()->TabClosed(window_id, tab2_id, false);
+
+  // Pin the third tab, and prune its first navigation from the front.
+  helper_.PrepareTabInWindow(window_id, tab3_id, 1, false);
+  for (int i = 0; i < 3; ++i) {
+    TabNavigation nav =
+        SessionTypesTestHelper::CreateNavigation(
+            base_url + "3/" + base::IntToString(i), "c");
+    nav.set_index(i);
+    UpdateNavigation(window_id, tab3_id, nav, (i == 1));
+  }
+  service()->SetPinnedState(window_id, tab3_id, true);
+  service()->SetPinnedState(window_id, tab3_id, false);
+  service()->SetPinnedState(window_id, tab3_id, true);
+  service()->TabNavigationPathPrunedFromFront(window_id, tab3_id, 1);
+
+  size_t command_count_before;
+  size_t command_count_after;
+  helper_.CompactCurrentSession(&command_count_before, &command_count_after);
+  EXPECT_LT(command_count_after, command_count_before);
+
+  ScopedVector<SessionWindow> windows;
+  ReadWindows(&(windows.get()), NULL);
+
+  ASSERT_EQ(1U, windows.size());
+  EXPECT_TRUE(window_bounds == windows[0]->bounds);
+  EXPECT_EQ(0, windows[0]->selected_tab_index);
+  ASSERT_EQ(2U, windows[0]->tabs.size());
+
+  SessionTab* tab = windows[0]->tabs[0];
+  helper_.AssertTabEquals(window_id, tab_id, 0, 2, 3, *tab);
+  EXPECT_EQ(GURL(base_url + "1"), tab->navigations[0].virtual_url());
+  EXPECT_EQ(GURL(base_url + "3"), tab->navigations[1].virtual_url());
+  EXPECT_EQ(GURL(base_url + "5"), tab->navigations[2].virtual_url());
+
+  tab = windows[0]->tabs[1];
+  helper_.AssertTabEquals(window_id, tab3_id, 1, 0, 2, *tab);
+  EXPECT_TRUE(tab->pinned);
+  EXPECT_EQ(GURL(base_url + "3/1"), tab->navigations[0].virtual_url());
+  EXPECT_EQ(GURL(base_url + "3/2"), tab->navigations[1].virtual_url());
+}
+
+// Makes sure commands written after the session is compacted are kept.
+TEST_F(SessionServiceTest, AppendAfterCompact) {
+  SessionID tab_id;
+  TabNavigation nav1 =
+      SessionTypesTestHelper::CreateNavigation("http://google.com", "abc");
+  TabNavigation nav2 =
+      SessionTypesTestHelper::CreateNavigation("http://google2.com", "abcd");
+  nav2.set_index(1);
+
+  helper_.PrepareTabInWindow(window_id, tab_id, 0, true);
+  UpdateNavigation(window_id, tab_id, nav1, true);
+
+  size_t command_count_before;
+  size_t command_count_after;
+  helper_.CompactCurrentSession(&command_count_before, &command_count_after);
+  EXPECT_EQ(command_count_before, command_count_after);
+
+  UpdateNavigation(window_id, tab_id, nav2, true);
+
+  ScopedVector<SessionWindow> windows;
+  ReadWindows(&(windows.get()), NULL);
+
+  helper_.AssertSingleWindowWithSingleTab(windows.get(), 2);
+  SessionTab* tab = windows[0]->tabs[0];
+  helper_.AssertTabEquals(window_id, tab_id, 0, 1, 2, *tab);
+  helper_.AssertNavigationEquals(nav1, tab->navigations[0]);
+  helper_.AssertNavigationEquals(nav2, tab->navigations[1]);
+}
+
 TEST_F(SessionServiceTest, RestoreActivation1) {
   SessionID window2_id;
   SessionID tab1_id;
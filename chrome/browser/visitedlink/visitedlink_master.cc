@@ -54,6 +54,9 @@ const unsigned VisitedLinkMaster::kDefaultTableSize = 16381;
 
 const size_t VisitedLinkMaster::kBigDeleteThreshold = 64;
 
+// Moving this many entries takes well under a millisecond.
+const int32 VisitedLinkMaster::kResizeChunkSize = 32768;
+
 namespace {
 
 // Fills the given salt structure with some quasi-random values
@@ -179,7 +182,8 @@ class VisitedLinkMaster::TableBuilder
 // VisitedLinkMaster ----------------------------------------------------------
 
 VisitedLinkMaster::VisitedLinkMaster(Profile* profile)
-    : profile_(profile) {
+    : profile_(profile),
+      ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
   listener_.reset(new VisitedLinkEventListener(profile));
   DCHECK(listener_.get());
   InitMembers();
@@ -190,7 +194,8 @@ VisitedLinkMaster::VisitedLinkMaster(Listener* listener,
                                      bool suppress_rebuild,
                                      const FilePath& filename,
                                      int32 default_table_size)
-    : profile_(NULL) {
+    : profile_(NULL),
+      ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
   listener_.reset(listener);
   DCHECK(listener_.get());
   InitMembers();
@@ -219,6 +224,11 @@ void VisitedLinkMaster::InitMembers() {
   shared_memory_ = NULL;
   shared_memory_serial_ = 0;
   used_items_ = 0;
+  resize_shared_memory_ = NULL;
+  resize_hash_table_ = NULL;
+  resize_table_length_ = 0;
+  resize_next_entry_ = 0;
+  resize_chunk_size_ = kResizeChunkSize;
   table_size_override_ = 0;
   history_service_override_ = NULL;
   suppress_rebuild_ = false;
@@ -307,14 +317,17 @@ void VisitedLinkMaster::DeleteAllURLs() {
   // Any pending modifications are invalid.
   added_since_rebuild_.clear();
   deleted_since_rebuild_.clear();
+  CancelTableResize();
 
   // Clear the hash table.
   used_items_ = 0;
   memset(hash_table_, 0, this->table_length_ * sizeof(Fingerprint));
 
   // Resize it if it is now too empty. Resize may write the new table out for
-  // us, otherwise, schedule writing the new table to disk ourselves.
-  if (!ResizeTableIfNecessary())
+  // us, otherwise, schedule writing the new table to disk ourselves. A resize
+  // in progress only writes the new table once it is done, and the cleared
+  // one must be on disk now.
+  if (!ResizeTableIfNecessary() || resize_shared_memory_)
     WriteFullTable();
 
   listener_->Reset();
@@ -326,6 +339,9 @@ void VisitedLinkMaster::DeleteURLs(const history::URLRows& rows) {
   if (rows.empty())
     return;
 
+  // Fingerprints are only deleted from the current table.
+  FinishTableResize();
+
   listener_->Reset();
 
   if (table_builder_) {
@@ -388,6 +404,12 @@ VisitedLinkMaster::Hash VisitedLinkMaster::AddFingerprint(
       // End of probe sequence found, insert here.
       hash_table_[cur_hash] = fingerprint;
       used_items_++;
+      // The table being resized into must get it too, in case its entry in
+      // the current table has already been moved.
+      if (resize_hash_table_) {
+        AddFingerprintToTable(fingerprint, resize_hash_table_,
+                              resize_table_length_);
+      }
       // If allowed, notify listener that a new visited link was added.
       if (send_notifications)
         listener_->Add(fingerprint);
@@ -416,7 +438,7 @@ void VisitedLinkMaster::DeleteFingerprintsFromCurrentTable(
     DeleteFingerprint(*i, !bulk_write);
 
   // These deleted fingerprints may make us shrink the table.
-  if (ResizeTableIfNecessary())
+  if (ResizeTableIfNecessary() && !resize_shared_memory_)
     return;  // The resize function wrote the new table to disk for us.
 
   // Nobody wrote this out for us, write the full file to disk.
@@ -649,38 +671,63 @@ bool VisitedLinkMaster::GetDatabaseFileName(FilePath* filename) {
   return true;
 }
 
-// Initializes the shared memory structure. The salt should already be filled
-// in so that it can be written to the shared memory
-bool VisitedLinkMaster::CreateURLTable(int32 num_entries, bool init_to_empty) {
+// static
+bool VisitedLinkMaster::AddFingerprintToTable(Fingerprint fingerprint,
+                                              Fingerprint* hash_table,
+                                              int32 table_length) {
+  Hash first_hash = HashFingerprint(fingerprint, table_length);
+  Hash cur_hash = first_hash;
+  while (hash_table[cur_hash] != null_fingerprint_) {
+    if (hash_table[cur_hash] == fingerprint)
+      return false;
+    cur_hash = cur_hash >= table_length - 1 ? 0 : cur_hash + 1;
+    if (cur_hash == first_hash) {
+      NOTREACHED();  // The table is full.
+      return false;
+    }
+  }
+  hash_table[cur_hash] = fingerprint;
+  return true;
+}
+
+// The salt should already be filled in so that it can be written to the
+// shared memory.
+base::SharedMemory* VisitedLinkMaster::CreateSharedTable(
+    int32 num_entries,
+    Fingerprint** hash_table) {
   // The table is the size of the table followed by the entries.
   uint32 alloc_size = num_entries * sizeof(Fingerprint) + sizeof(SharedHeader);
 
   // Create the shared memory object.
-  shared_memory_ = new base::SharedMemory();
-  if (!shared_memory_)
-    return false;
+  base::SharedMemory* shared_memory = new base::SharedMemory();
+  if (!shared_memory->CreateAndMapAnonymous(alloc_size)) {
+    delete shared_memory;
+    return NULL;
+  }
 
-  if (!shared_memory_->CreateAndMapAnonymous(alloc_size)) {
-    delete shared_memory_;
-    shared_memory_ = NULL;
+  // Save the header for other processes to read.
+  SharedHeader* header = static_cast<SharedHeader*>(shared_memory->memory());
+  header->length = num_entries;
+  memcpy(header->salt, salt_, LINK_SALT_LENGTH);
+
+  // The table is just the data immediately following the header.
+  *hash_table = reinterpret_cast<Fingerprint*>(
+      static_cast<char*>(shared_memory->memory()) + sizeof(SharedHeader));
+  return shared_memory;
+}
+
+// Initializes the shared memory structure. The salt should already be filled
+// in so that it can be written to the shared memory
+bool VisitedLinkMaster::CreateURLTable(int32 num_entries, bool init_to_empty) {
+  shared_memory_ = CreateSharedTable(num_entries, &hash_table_);
+  if (!shared_memory_)
     return false;
-  }
 
   if (init_to_empty) {
-    memset(shared_memory_->memory(), 0, alloc_size);
+    memset(hash_table_, 0, num_entries * sizeof(Fingerprint));
     used_items_ = 0;
   }
   table_length_ = num_entries;
-
-  // Save the header for other processes to read.
-  SharedHeader* header = static_cast<SharedHeader*>(shared_memory_->memory());
-  header->length = table_length_;
-  memcpy(header->salt, salt_, LINK_SALT_LENGTH);
-
-  // Our table pointer is just the data immediately following the size.
-  hash_table_ = reinterpret_cast<Fingerprint*>(
-      static_cast<char*>(shared_memory_->memory()) + sizeof(SharedHeader));
-
   return true;
 }
 
@@ -704,6 +751,7 @@ bool VisitedLinkMaster::BeginReplaceURLTable(int32 num_entries) {
 }
 
 void VisitedLinkMaster::FreeURLTable() {
+  CancelTableResize();
   if (shared_memory_) {
     delete shared_memory_;
     shared_memory_ = NULL;
@@ -718,6 +766,18 @@ void VisitedLinkMaster::FreeURLTable() {
 bool VisitedLinkMaster::ResizeTableIfNecessary() {
   DCHECK(table_length_ > 0) << "Must have a table";
 
+  // While a resize is in progress both tables keep getting new fingerprints,
+  // which they have room for until the smaller is this full. The new table
+  // was sized for the count when the resize started, so a growing one is
+  // still only about half full at this point.
+  const float max_resizing_table_load = 0.75f;
+  if (resize_shared_memory_) {
+    int32 smaller_length = std::min(table_length_, resize_table_length_);
+    if (used_items_ < max_resizing_table_load * smaller_length)
+      return false;
+    FinishTableResize();
+  }
+
   // Load limits for good performance/space. We are pretty conservative about
   // keeping the table not very full. This is because we use linear probing
   // which increases the likelihood of clumps of entries which will reduce
@@ -741,29 +801,86 @@ bool VisitedLinkMaster::ResizeTableIfNecessary() {
 
 void VisitedLinkMaster::ResizeTable(int32 new_size) {
   DCHECK(shared_memory_ && shared_memory_->memory() && hash_table_);
+  DCHECK(!resize_shared_memory_);
   shared_memory_serial_++;
 
 #ifndef NDEBUG
   DebugValidate();
 #endif
 
-  base::SharedMemory* old_shared_memory = shared_memory_;
-  Fingerprint* old_hash_table = hash_table_;
-  int32 old_table_length = table_length_;
-  if (!BeginReplaceURLTable(new_size))
+  // Until the new table is complete, we keep using the current one, so
+  // failing to make it just means the current one stays.
+  resize_shared_memory_ = CreateSharedTable(new_size, &resize_hash_table_);
+  if (!resize_shared_memory_)
+    return;
+  memset(resize_hash_table_, 0, new_size * sizeof(Fingerprint));
+  resize_table_length_ = new_size;
+  resize_next_entry_ = 0;
+
+  if (table_length_ <= resize_chunk_size_ || !MessageLoop::current()) {
+    FinishTableResize();
+    return;
+  }
+  MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&VisitedLinkMaster::ContinueTableResize,
+                            weak_ptr_factory_.GetWeakPtr()));
+}
+
+void VisitedLinkMaster::ContinueTableResize() {
+  DCHECK(resize_shared_memory_);
+  MoveFingerprintsToNewTable(
+      std::min(table_length_, resize_next_entry_ + resize_chunk_size_));
+  if (resize_next_entry_ < table_length_) {
+    MessageLoop::current()->PostTask(
+        FROM_HERE, base::Bind(&VisitedLinkMaster::ContinueTableResize,
+                              weak_ptr_factory_.GetWeakPtr()));
     return;
+  }
+  SwitchToNewTable();
+}
+
+void VisitedLinkMaster::FinishTableResize() {
+  if (!resize_shared_memory_)
+    return;
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  MoveFingerprintsToNewTable(table_length_);
+  SwitchToNewTable();
+}
 
-  // Now we have two tables, our local copy which is the old one, and the new
-  // one loaded into this object where we need to copy the data.
-  for (int32 i = 0; i < old_table_length; i++) {
-    Fingerprint cur = old_hash_table[i];
+void VisitedLinkMaster::CancelTableResize() {
+  if (!resize_shared_memory_)
+    return;
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  delete resize_shared_memory_;
+  resize_shared_memory_ = NULL;
+  resize_hash_table_ = NULL;
+  resize_table_length_ = 0;
+  resize_next_entry_ = 0;
+}
+
+void VisitedLinkMaster::MoveFingerprintsToNewTable(int32 end) {
+  // The fingerprints added since the resize started are already in the new
+  // table, so AddFingerprintToTable() skips them.
+  for (; resize_next_entry_ < end; resize_next_entry_++) {
+    Fingerprint cur = hash_table_[resize_next_entry_];
     if (cur)
-      AddFingerprint(cur, false);
+      AddFingerprintToTable(cur, resize_hash_table_, resize_table_length_);
   }
+}
+
+void VisitedLinkMaster::SwitchToNewTable() {
+  DCHECK_EQ(table_length_, resize_next_entry_);
 
   // On error unmapping, just forget about it since we can't do anything
   // else to release it.
-  delete old_shared_memory;
+  delete shared_memory_;
+  shared_memory_ = resize_shared_memory_;
+  hash_table_ = resize_hash_table_;
+  table_length_ = resize_table_length_;
+  resize_shared_memory_ = NULL;
+  resize_hash_table_ = NULL;
+  resize_table_length_ = 0;
+  resize_next_entry_ = 0;
 
   // Send an update notification to all child processes so they read the new
   // table.
@@ -843,6 +960,10 @@ void VisitedLinkMaster::OnTableRebuildComplete(
     bool success,
     const std::vector<Fingerprint>& fingerprints) {
   if (success) {
+    // The rebuilt table replaces the current one, so any resize of it is of
+    // no use.
+    CancelTableResize();
+
     // Replace the old table with a new blank one.
     shared_memory_serial_++;
 
@@ -15,6 +15,7 @@
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
 #include "base/shared_memory.h"
 #include "base/threading/sequenced_worker_pool.h"
 #include "chrome/browser/history/history.h"
@@ -31,6 +32,13 @@ class Profile;
 // This class will defer writing operations to the file thread. This means that
 // class destruction, the file may still be open since operations are pending on
 // another thread.
+//
+// When the table needs to grow, the fingerprints are moved to the new table a
+// chunk at a time, in tasks posted to the current message loop, so that a
+// large table doesn't stall the thread. Until the move is done, the old table
+// remains the one that is read, written to disk and shared with the child
+// processes, and new fingerprints are added to both. The children are only
+// sent the new table once it is complete.
 class VisitedLinkMaster : public VisitedLinkCommon,
                           public ProfileKeyedService  {
  public:
@@ -128,6 +136,17 @@ class VisitedLinkMaster : public VisitedLinkCommon,
   void RewriteFile() {
     WriteFullTable();
   }
+
+  // Returns true while the table is being resized in the background.
+  bool IsResizingTable() const {
+    return resize_shared_memory_ != NULL;
+  }
+
+  // Sets how many entries of the old table are moved by each task of a
+  // resize. Tables no larger than this are resized at once.
+  void set_resize_chunk_size(int32 resize_chunk_size) {
+    resize_chunk_size_ = resize_chunk_size;
+  }
 #endif
 
  private:
@@ -157,6 +176,10 @@ class VisitedLinkMaster : public VisitedLinkCommon,
   // When creating a fresh new table, we use this many entries.
   static const unsigned kDefaultTableSize;
 
+  // The number of entries of the old table each task of a resize moves to the
+  // new one.
+  static const int32 kResizeChunkSize;
+
   // When the user is deleting a boatload of URLs, we don't really want to do
   // individual writes for each of them. When the count exceeds this threshold,
   // we will write the whole table to disk at once instead of individual items.
@@ -243,6 +266,18 @@ class VisitedLinkMaster : public VisitedLinkCommon,
   // database and for unit tests.
   bool InitFromScratch(bool suppress_rebuild);
 
+  // Adds |fingerprint| to the |table_length| entries of |hash_table|, unless
+  // it is already there. Returns true if it was added.
+  static bool AddFingerprintToTable(Fingerprint fingerprint,
+                                    Fingerprint* hash_table,
+                                    int32 table_length);
+
+  // Allocates shared memory for a table of |num_entries| and fills in its
+  // header. Returns NULL on failure, otherwise sets |hash_table| to the first
+  // entry. The entries are not initialized.
+  base::SharedMemory* CreateSharedTable(int32 num_entries,
+                                        Fingerprint** hash_table);
+
   // Allocates the Fingerprint structure and length. When init_to_empty is set,
   // the table will be filled with 0s and used_items_ will be set to 0 as well.
   // If the flag is not set, these things are untouched and it is the
@@ -270,9 +305,31 @@ class VisitedLinkMaster : public VisitedLinkCommon,
   bool ResizeTableIfNecessary();
 
   // Resizes the table (growing or shrinking) as necessary to accomodate the
-  // current count.
+  // current count. A table larger than |resize_chunk_size_| is moved to the
+  // new one by ContinueTableResize() tasks, when there is a message loop to
+  // post them to; any other is moved at once.
   void ResizeTable(int32 new_size);
 
+  // Moves the next chunk of the old table to the new one, then either posts
+  // itself again or switches to the new table.
+  void ContinueTableResize();
+
+  // Moves what is left of the old table to the new one at once, and switches
+  // to the new table. Does nothing unless a resize is in progress. Called
+  // before anything which can't be done to both tables, such as deleting.
+  void FinishTableResize();
+
+  // Drops the new table of a resize in progress, such as when the old table
+  // has just been cleared.
+  void CancelTableResize();
+
+  // Moves the entries of the old table up to |end| to the new one.
+  void MoveFingerprintsToNewTable(int32 end);
+
+  // Makes the completely filled new table of a resize the current one, frees
+  // the old one, and sends the new one to the listener and to disk.
+  void SwitchToNewTable();
+
   // Returns the desired table size for |item_count| URLs.
   uint32 NewTableSizeForCount(int32 item_count) const;
 
@@ -366,6 +423,19 @@ class VisitedLinkMaster : public VisitedLinkCommon,
   // Number of non-empty items in the table, used to compute fullness.
   int32 used_items_;
 
+  // While the table is being resized, the shared memory holding the new table,
+  // and its entries. They are NULL the rest of the time.
+  base::SharedMemory* resize_shared_memory_;
+  Fingerprint* resize_hash_table_;
+  int32 resize_table_length_;
+
+  // The first entry of the old table not yet moved to the new one.
+  int32 resize_next_entry_;
+
+  // The number of entries moved by each task of a resize, normally
+  // kResizeChunkSize.
+  int32 resize_chunk_size_;
+
   // Testing values -----------------------------------------------------------
   //
   // The following fields exist for testing purposes. They are not used in
@@ -393,6 +463,10 @@ class VisitedLinkMaster : public VisitedLinkCommon,
   // will be false in production.
   bool suppress_rebuild_;
 
+  // Used to post the tasks of a resize. Invalidated when a resize is finished
+  // or cancelled early.
+  base::WeakPtrFactory<VisitedLinkMaster> weak_ptr_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(VisitedLinkMaster);
 };
 
@@ -8,6 +8,7 @@
 
 #include "base/file_path.h"
 #include "base/file_util.h"
+#include "base/message_loop.h"
 #include "base/perftimer.h"
 #include "base/shared_memory.h"
 #include "base/stringprintf.h"
@@ -16,6 +17,7 @@
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::TimeDelta;
+using base::TimeTicks;
 
 namespace {
 
@@ -45,6 +47,43 @@ class DummyVisitedLinkEventListener : public VisitedLinkMaster::Listener {
 };
 
 
+// Keeps the longest and the total of a number of pauses.
+class PauseStats {
+ public:
+  PauseStats() {}
+
+  void Add(TimeDelta pause) {
+    longest_ = std::max(longest_, pause);
+    total_ += pause;
+  }
+
+  TimeDelta longest() const { return longest_; }
+  TimeDelta total() const { return total_; }
+
+ private:
+  TimeDelta longest_;
+  TimeDelta total_;
+};
+
+// Times each task run by the message loop it observes.
+class TaskPauseObserver : public MessageLoop::TaskObserver {
+ public:
+  TaskPauseObserver() {}
+
+  virtual void WillProcessTask(TimeTicks time_posted) OVERRIDE {
+    task_start_ = TimeTicks::HighResNow();
+  }
+  virtual void DidProcessTask(TimeTicks time_posted) OVERRIDE {
+    pauses_.Add(TimeTicks::HighResNow() - task_start_);
+  }
+
+  const PauseStats& pauses() const { return pauses_; }
+
+ private:
+  TimeTicks task_start_;
+  PauseStats pauses_;
+};
+
 // this checks IsVisited for the URLs starting with the given prefix and
 // within the given range
 void CheckVisited(VisitedLinkMaster& master, const char* prefix,
@@ -195,3 +234,39 @@ TEST_F(VisitedLink, TestLoad) {
   LogPerfResult("Visited_link_hot_load_time",
                 hot_sum / hot_load_times.size(), "ms");
 }
+
+// Tests how long the thread adding URLs is kept busy at a time while the table
+// is resized as it grows. Each addition, and each task a resize posts to move
+// part of the table, is a pause; the longest of them is what the user may
+// notice.
+TEST_F(VisitedLink, TestResizePauses) {
+  MessageLoop message_loop;
+  TaskPauseObserver task_observer;
+  message_loop.AddTaskObserver(&task_observer);
+
+  VisitedLinkMaster master(DummyVisitedLinkEventListener::GetInstance(),
+                           NULL, true, db_path_, 0);
+  ASSERT_TRUE(master.Init());
+
+  PauseStats add_pauses;
+  for (int i = 0; i < load_test_add_count; i++) {
+    TimeTicks add_start = TimeTicks::HighResNow();
+    master.AddURL(TestURL(added_prefix, i));
+    add_pauses.Add(TimeTicks::HighResNow() - add_start);
+
+    // Let the thread get to the resize tasks now and then, as it would
+    // between visits in the browser.
+    if (i % 100 == 0)
+      message_loop.RunUntilIdle();
+  }
+  message_loop.RunUntilIdle();
+  message_loop.RemoveTaskObserver(&task_observer);
+  ASSERT_FALSE(master.IsResizingTable());
+
+  LogPerfResult("Visited_link_resize_max_add_pause",
+                add_pauses.longest().InMillisecondsF(), "ms");
+  LogPerfResult("Visited_link_resize_max_task_pause",
+                task_observer.pauses().longest().InMillisecondsF(), "ms");
+  LogPerfResult("Visited_link_resize_total_task_time",
+                task_observer.pauses().total().InMillisecondsF(), "ms");
+}
@@ -380,6 +380,62 @@ TEST_F(VisitedLinkTest, Resizing) {
   Reload();
 }
 
+// This tests that when the table is resized a chunk at a time, the slaves keep
+// seeing every URL in the old table until they are given the new one.
+TEST_F(VisitedLinkTest, IncrementalResizing) {
+  ASSERT_TRUE(InitHistory());
+  ASSERT_TRUE(InitVisited(17, true));
+  master_->set_resize_chunk_size(4);
+
+  VisitedLinkSlave slave;
+  base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
+  master_->shared_memory()->ShareToProcess(
+      base::GetCurrentProcessHandle(), &new_handle);
+  slave.OnUpdateVisitedLinks(new_handle);
+  g_slaves.push_back(&slave);
+
+  bool resized = false;
+  for (int i = 0; i < g_test_count; i++) {
+    master_->AddURL(TestURL(i));
+    ASSERT_EQ(i + 1, master_->GetUsedCount());
+    resized |= master_->IsResizingTable();
+    for (int j = 0; j <= i; j++) {
+      ASSERT_TRUE(master_->IsVisited(TestURL(j))) << i << " " << j;
+      ASSERT_TRUE(slave.IsVisited(TestURL(j))) << i << " " << j;
+    }
+
+    // Let the resizes in progress finish after some of the additions only.
+    if (i % 2)
+      MessageLoop::current()->RunUntilIdle();
+  }
+  EXPECT_TRUE(resized);
+  MessageLoop::current()->RunUntilIdle();
+  EXPECT_FALSE(master_->IsResizingTable());
+  master_->DebugValidate();
+
+  // The slave must have been given the final table.
+  int32 table_size;
+  VisitedLinkCommon::Fingerprint* table;
+  master_->GetUsageStatistics(&table_size, &table);
+  int32 child_table_size;
+  VisitedLinkCommon::Fingerprint* child_table;
+  slave.GetUsageStatistics(&child_table_size, &child_table);
+  ASSERT_EQ(table_size, child_table_size);
+  for (int32 i = 0; i < table_size; i++)
+    ASSERT_EQ(table[i], child_table[i]);
+
+  // Deleting finishes a resize in progress first.
+  master_->AddURL(TestURL(g_test_count));
+  history::URLRows deleted_urls;
+  deleted_urls.push_back(history::URLRow(TestURL(g_test_count)));
+  master_->DeleteURLs(deleted_urls);
+  EXPECT_FALSE(master_->IsResizingTable());
+  EXPECT_FALSE(master_->IsVisited(TestURL(g_test_count)));
+  g_slaves.clear();
+
+  Reload();
+}
+
 // Tests that if the database doesn't exist, it will be rebuilt from history.
 TEST_F(VisitedLinkTest, Rebuild) {
   ASSERT_TRUE(InitHistory());
@@ -472,6 +472,18 @@ const char kEnableAutologin[]               = "enable-autologin";
 // Enables the benchmarking extensions.
 const char kEnableBenchmarking[]            = "enable-benchmarking";
 
+// Appends the changes made to bookmarks to a journal, rather than rewriting
+// the whole bookmarks file after each.
+const char kEnableBookmarkJournal[]         = "enable-bookmark-journal";
+
+// Indexes the titles of bookmarks by their n-grams, so that the omnibox finds
+// bookmarks by words in the middle of the words of their titles.
+const char kEnableBookmarkNGramIndex[]      = "enable-bookmark-ngram-index";
+
+// Looks up Safe Browsing prefixes in a set bucketed by their high bits,
+// instead of the delta-coded PrefixSet.
+const char kEnableBucketedPrefixSet[]       = "enable-bucketed-prefix-set";
+
 // Enables the bundled PPAPI version of Flash.
 const char kEnableBundledPpapiFlash[]       = "enable-bundled-ppapi-flash";
 
@@ -479,6 +491,10 @@ const char kEnableBundledPpapiFlash[]       = "enable-bundled-ppapi-flash";
 // Print Proxy component within the service process.
 const char kEnableCloudPrintProxy[]         = "enable-cloud-print-proxy";
 
+// Keeps the index of the HistoryQuickProvider in compact, flat arrays instead
+// of maps of sets, once it has been built or restored.
+const char kEnableCompactHistoryIndex[]     = "enable-compact-history-index";
+
 // Enables fetching the user's contacts from Google and showing them in the
 // Chrome OS apps list.
 const char kEnableContacts[]                = "enable-contacts";
@@ -527,6 +543,10 @@ const char kEnableFileCookies[]             = "enable-file-cookies";
 // Enables Google Now integration.
 const char kEnableGoogleNowIntegration[] = "enable-google-now-integration";
 
+// Keeps the full-text index of history in a single index, with the page text
+// on disk, instead of in a SQLite database per month.
+const char kEnableHistoryTextIndex[]        = "enable-history-text-index";
+
 // Enable HTTP pipelining. Attempt to pipeline HTTP connections. Heuristics will
 // try to figure out if pipelining can be used for a given host and request.
 // Without this flag, pipelining will never be used.
@@ -606,6 +626,11 @@ const char kEnableNpnHttpOnly[]             = "enable-npn-http";
 // Enables panels (always on-top docked pop-up windows).
 const char kEnablePanels[]                  = "enable-panels";
 
+// Scores the candidates of the HistoryQuickProvider on a pool of worker
+// threads, instead of on the UI thread, when there are many of them.
+const char kEnableParallelHistoryQuickScoring[] =
+    "enable-parallel-history-quick-scoring";
+
 // Enables password generation when we detect that the user is going through
 // account creation.
 const char kEnablePasswordGeneration[]      = "enable-password-generation";
@@ -635,6 +660,11 @@ const char kEnableProfiling[]               = "enable-profiling";
 // supported server-side for searches on google.com.
 const char kEnableSdch[]                    = "enable-sdch";
 
+// Compacts the current session file in the background, keeping the latest
+// state of each tab and window, rather than rebuilding it from the open
+// browsers.
+const char kEnableSessionLogCompaction[]    = "enable-session-log-compaction";
+
 // Enable SPDY/3. This is a temporary testing flag.
 const char kEnableSpdy3[]                   = "enable-spdy3";
 
@@ -647,6 +677,11 @@ const char kEnableSpellingAutoCorrect[]    = "enable-spelling-auto-correct";
 // Enables the stacked tabstrip.
 const char kEnableStackedTabStrip[]         = "enable-stacked-tab-strip";
 
+// Writes Safe Browsing updates as sorted runs and merges them with the
+// database a block at a time, rather than reading all of it into memory.
+const char kEnableStreamingSafeBrowsingUpdate[] =
+    "enable-streaming-safe-browsing-update";
+
 // Enables experimental suggestions pane in New Tab page.
 const char kEnableSuggestionsTabPage[]      = "enable-suggestions-ntp";
 
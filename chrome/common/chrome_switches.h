@@ -138,8 +138,12 @@ extern const char kEnableAsyncDns[];
 extern const char kEnableAuthNegotiatePort[];
 extern const char kEnableAutologin[];
 extern const char kEnableBenchmarking[];
+extern const char kEnableBookmarkJournal[];
+extern const char kEnableBookmarkNGramIndex[];
+extern const char kEnableBucketedPrefixSet[];
 extern const char kEnableBundledPpapiFlash[];
 extern const char kEnableCloudPrintProxy[];
+extern const char kEnableCompactHistoryIndex[];
 extern const char kEnableContacts[];
 extern const char kEnableCrxlessWebApps[];
 extern const char kEnableDesktopGuestMode[];
@@ -150,6 +154,7 @@ extern const char kEnableExtensionActivityLogging[];
 extern const char kEnableExtensionActivityUI[];
 extern const char kEnableFileCookies[];
 extern const char kEnableGoogleNowIntegration[];
+extern const char kEnableHistoryTextIndex[];
 extern const char kEnableHttpPipelining[];
 extern const char kEnableInstantExtendedAPI[];
 extern const char kEnableInteractiveAutocomplete[];
@@ -170,16 +175,19 @@ extern const char kEnableNewAutofillUi[];
 extern const char kEnableNpn[];
 extern const char kEnableNpnHttpOnly[];
 extern const char kEnablePanels[];
+extern const char kEnableParallelHistoryQuickScoring[];
 extern const char kEnablePasswordGeneration[];
 extern const char kEnablePnacl[];
 extern const char kEnableProfiling[];
 extern const char kEnableResourceContentSettings[];
 extern const char kEnableRichNotifications[];
 extern const char kEnableSdch[];
+extern const char kEnableSessionLogCompaction[];
 extern const char kEnableSpdy3[];
 extern const char kEnableSpdyCredentialFrames[];
 extern const char kEnableSpellingAutoCorrect[];
 extern const char kEnableStackedTabStrip[];
+extern const char kEnableStreamingSafeBrowsingUpdate[];
 extern const char kEnableSuggestionsTabPage[];
 extern const char kEnableTabGroupsContextMenu[];
 extern const char kEnableWatchdog[];
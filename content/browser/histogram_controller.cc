@@ -6,6 +6,7 @@
 
 #include "base/bind.h"
 #include "base/metrics/histogram.h"
+#include "base/metrics/histogram_shared_memory.h"
 #include "content/browser/histogram_subscriber.h"
 #include "content/common/child_process_messages.h"
 #include "content/public/browser/browser_child_process_host_iterator.h"
@@ -65,6 +66,21 @@ void HistogramController::Unregister(
   subscriber_ = NULL;
 }
 
+void HistogramController::RegisterHistogramMemory(
+    base::HistogramSharedMemory* memory) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  base::AutoLock auto_lock(histogram_memory_lock_);
+  histogram_memory_.insert(memory);
+}
+
+void HistogramController::UnregisterHistogramMemory(
+    base::HistogramSharedMemory* memory) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  base::AutoLock auto_lock(histogram_memory_lock_);
+  if (histogram_memory_.erase(memory))
+    memory->MergeDeltas();
+}
+
 void HistogramController::GetHistogramDataFromChildProcesses(
     int sequence_number) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -93,6 +109,17 @@ void HistogramController::GetHistogramDataFromChildProcesses(
 void HistogramController::GetHistogramData(int sequence_number) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
 
+  // Reading shared memory needs no reply, so it is done here rather than along
+  // with the requests below.
+  {
+    base::AutoLock auto_lock(histogram_memory_lock_);
+    for (std::set<base::HistogramSharedMemory*>::const_iterator it =
+             histogram_memory_.begin();
+         it != histogram_memory_.end(); ++it) {
+      (*it)->MergeDeltas();
+    }
+  }
+
   int pending_processes = 0;
   for (RenderProcessHost::iterator it(RenderProcessHost::AllHostsIterator());
        !it.IsAtEnd(); it.Advance()) {
@@ -5,10 +5,16 @@
 #ifndef CONTENT_BROWSER_HISTOGRAM_CONTROLLER_H_
 #define CONTENT_BROWSER_HISTOGRAM_CONTROLLER_H_
 
+#include <set>
 #include <string>
 #include <vector>
 
 #include "base/memory/singleton.h"
+#include "base/synchronization/lock.h"
+
+namespace base {
+class HistogramSharedMemory;
+}
 
 namespace content {
 
@@ -38,9 +44,18 @@ class HistogramController {
   // Safe to call even if caller is not the current subscriber.
   void Unregister(const HistogramSubscriber* subscriber);
 
-  // Contact all processes and get their histogram data.
+  // Contact all processes and get their histogram data. The histograms child
+  // processes keep in shared memory are merged first.
   void GetHistogramData(int sequence_number);
 
+  // Has GetHistogramData() merge the histograms a child process keeps in
+  // |memory|. Called on the IO thread.
+  void RegisterHistogramMemory(base::HistogramSharedMemory* memory);
+
+  // Merges what is left in |memory|, which is about to be destroyed, and stops
+  // merging it. Called on the IO thread.
+  void UnregisterHistogramMemory(base::HistogramSharedMemory* memory);
+
   // Notify the |subscriber_| that it should expect at least |pending_processes|
   // additional calls to OnHistogramDataCollected().  OnPendingProcess() may be
   // called repeatedly; the last call will have |end| set to true, indicating
@@ -64,6 +79,11 @@ class HistogramController {
 
   HistogramSubscriber* subscriber_;
 
+  // The shared memory of child processes, which is registered on the IO thread
+  // and merged on the UI thread.
+  base::Lock histogram_memory_lock_;
+  std::set<base::HistogramSharedMemory*> histogram_memory_;
+
   DISALLOW_COPY_AND_ASSIGN(HistogramController);
 };
 
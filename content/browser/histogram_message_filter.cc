@@ -4,17 +4,56 @@
 
 #include "content/browser/histogram_message_filter.h"
 
+#include "base/command_line.h"
+#include "base/metrics/histogram_shared_memory.h"
 #include "base/process_util.h"
 #include "content/browser/histogram_controller.h"
 #include "content/browser/tcmalloc_internals_request_job.h"
 #include "content/common/child_process_messages.h"
+#include "content/public/common/content_switches.h"
 
 namespace content {
 
+namespace {
+
+// Enough for the histograms of a long-lived renderer. Only the pages which are
+// written to are committed.
+const size_t kHistogramMemorySize = 1024 * 1024;
+
+}  // namespace
+
 HistogramMessageFilter::HistogramMessageFilter() {}
 
 void HistogramMessageFilter::OnChannelConnected(int32 peer_pid) {
   BrowserMessageFilter::OnChannelConnected(peer_pid);
+
+  // A child running in the browser process shares its histograms already.
+  if (!CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableSharedMemoryHistograms) ||
+      static_cast<base::ProcessId>(peer_pid) == base::GetCurrentProcId()) {
+    return;
+  }
+
+  histogram_memory_.reset(
+      base::HistogramSharedMemory::Create(kHistogramMemorySize));
+  base::SharedMemoryHandle handle;
+  if (!histogram_memory_.get() ||
+      !histogram_memory_->ShareToProcess(peer_handle(), &handle)) {
+    histogram_memory_.reset();
+    return;
+  }
+  HistogramController::GetInstance()->RegisterHistogramMemory(
+      histogram_memory_.get());
+  Send(new ChildProcessMsg_SetHistogramMemory(handle,
+                                              histogram_memory_->size()));
+}
+
+void HistogramMessageFilter::OnChannelClosing() {
+  BrowserMessageFilter::OnChannelClosing();
+  if (histogram_memory_.get()) {
+    HistogramController::GetInstance()->UnregisterHistogramMemory(
+        histogram_memory_.get());
+  }
 }
 
 bool HistogramMessageFilter::OnMessageReceived(const IPC::Message& message,
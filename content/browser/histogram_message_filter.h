@@ -8,9 +8,14 @@
 #include <string>
 #include <vector>
 
+#include "base/memory/scoped_ptr.h"
 #include "content/public/browser/browser_message_filter.h"
 #include "content/public/common/process_type.h"
 
+namespace base {
+class HistogramSharedMemory;
+}
+
 namespace content {
 
 // This class sends and receives histogram messages in the browser process.
@@ -20,6 +25,7 @@ class HistogramMessageFilter : public BrowserMessageFilter {
 
   // BrowserMessageFilter implementation.
   virtual void OnChannelConnected(int32 peer_pid) OVERRIDE;
+  virtual void OnChannelClosing() OVERRIDE;
 
   // BrowserMessageFilter implementation.
   virtual bool OnMessageReceived(const IPC::Message& message,
@@ -32,6 +38,10 @@ class HistogramMessageFilter : public BrowserMessageFilter {
   void OnChildHistogramData(int sequence_number,
                             const std::vector<std::string>& pickled_histograms);
 
+  // The memory the child records its histograms into, with
+  // --enable-shared-memory-histograms.
+  scoped_ptr<base::HistogramSharedMemory> histogram_memory_;
+
   DISALLOW_COPY_AND_ASSIGN(HistogramMessageFilter);
 };
 
@@ -25,8 +25,8 @@ base::LazyInstance<TraceControllerImpl>::Leaky g_controller =
 
 class AutoStopTraceSubscriberStdio : public TraceSubscriberStdio {
  public:
-  AutoStopTraceSubscriberStdio(const FilePath& file_path)
-      : TraceSubscriberStdio(file_path) {}
+  AutoStopTraceSubscriberStdio(const FilePath& file_path, Format format)
+      : TraceSubscriberStdio(file_path, format) {}
 
   static void EndStartupTrace(TraceSubscriberStdio* subscriber) {
     if (!TraceControllerImpl::GetInstance()->EndTracingAsync(subscriber))
@@ -54,7 +54,8 @@ TraceControllerImpl::TraceControllerImpl() :
     pending_bpf_ack_count_(0),
     maximum_bpf_(0.0f),
     is_tracing_(false),
-    is_get_categories_(false) {
+    is_get_categories_(false),
+    flush_as_binary_(false) {
   TraceLog::GetInstance()->SetNotificationCallback(
       base::Bind(&TraceControllerImpl::OnTraceNotification,
                  base::Unretained(this)));
@@ -84,8 +85,18 @@ void TraceControllerImpl::InitStartupTracing(const CommandLine& command_line) {
     // Default to saving the startup trace into the current dir.
     trace_file = FilePath().AppendASCII("chrometrace.log");
   }
+  TraceSubscriberStdio::Format format = TraceSubscriberStdio::FORMAT_JSON;
+  std::string format_str = command_line.GetSwitchValueASCII(
+      switches::kTraceStartupFormat);
+  if (format_str == "binary") {
+    format = TraceSubscriberStdio::FORMAT_BINARY;
+  } else if (!format_str.empty() && format_str != "json") {
+    DLOG(WARNING) << "Unknown --" << switches::kTraceStartupFormat << "="
+        << format_str << " defaulting to json";
+  }
+
   scoped_ptr<AutoStopTraceSubscriberStdio> subscriber(
-      new AutoStopTraceSubscriberStdio(trace_file));
+      new AutoStopTraceSubscriberStdio(trace_file, format));
   DCHECK(can_begin_tracing(subscriber.get()));
 
   std::string delay_str = command_line.GetSwitchValueASCII(
@@ -98,6 +109,7 @@ void TraceControllerImpl::InitStartupTracing(const CommandLine& command_line) {
   }
 
   OnTracingBegan(subscriber.get());
+  flush_as_binary_ = format == TraceSubscriberStdio::FORMAT_BINARY;
   BrowserThread::PostDelayedTask(
       BrowserThread::UI,
       FROM_HERE,
@@ -245,6 +257,7 @@ void TraceControllerImpl::CancelSubscriber(TraceSubscriber* subscriber) {
 
   if (subscriber == subscriber_) {
     subscriber_ = NULL;
+    flush_as_binary_ = false;
     // End tracing if necessary.
     if (is_tracing_ && pending_end_ack_count_ == 0)
       EndTracingAsync(NULL);
@@ -317,9 +330,14 @@ void TraceControllerImpl::OnEndTracingAck(
     // called with the last of the local trace data. Since we are on the UI
     // thread, the call to OnTraceDataCollected will be synchronous, so we can
     // immediately call OnEndTracingComplete below.
-    TraceLog::GetInstance()->Flush(
+    TraceLog::OutputCallback output_callback =
         base::Bind(&TraceControllerImpl::OnTraceDataCollected,
-                   base::Unretained(this)));
+                   base::Unretained(this));
+    if (flush_as_binary_ && !is_get_categories_)
+      TraceLog::GetInstance()->FlushAsBinary(output_callback);
+    else
+      TraceLog::GetInstance()->Flush(output_callback);
+    flush_as_binary_ = false;
 
     // Trigger callback if one is set.
     if (subscriber_) {
@@ -101,6 +101,9 @@ class TraceControllerImpl : public TraceController {
   float maximum_bpf_;
   bool is_tracing_;
   bool is_get_categories_;
+  // Whether the local trace is flushed with TraceLog::FlushAsBinary() rather
+  // than as JSON; set for binary startup traces.
+  bool flush_as_binary_;
   std::set<std::string> known_categories_;
   std::vector<std::string> included_categories_;
   std::vector<std::string> excluded_categories_;
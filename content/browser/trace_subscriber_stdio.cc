@@ -6,7 +6,9 @@
 
 #include "base/bind.h"
 #include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/threading/sequenced_worker_pool.h"
 #include "content/public/browser/browser_thread.h"
 
@@ -16,29 +18,50 @@ namespace content {
 class TraceSubscriberStdioImpl
     : public base::RefCountedThreadSafe<TraceSubscriberStdioImpl> {
  public:
-  explicit TraceSubscriberStdioImpl(const FilePath& path)
+  TraceSubscriberStdioImpl(const FilePath& path,
+                           TraceSubscriberStdio::Format format)
       : path_(path),
+        format_(format),
         file_(0) {}
 
   void OnStart() {
     DCHECK(!file_);
     trace_buffer_.SetOutputCallback(
         base::Bind(&TraceSubscriberStdioImpl::Write, this));
+    if (format_ == TraceSubscriberStdio::FORMAT_BINARY) {
+      json_wrapper_.reset(new base::debug::TraceBinaryWriter(
+          0, base::Bind(&TraceSubscriberStdioImpl::WriteChunk, this)));
+    }
     file_ = file_util::OpenFile(path_, "w+");
     if (IsValid()) {
       LOG(INFO) << "Logging performance trace to file: " << path_.value();
-      trace_buffer_.Start();
+      if (format_ == TraceSubscriberStdio::FORMAT_JSON)
+        trace_buffer_.Start();
     } else {
       LOG(ERROR) << "Failed to open performance trace file: " << path_.value();
     }
   }
 
   void OnData(const scoped_refptr<base::RefCountedString>& data_ptr) {
-    trace_buffer_.AddFragment(data_ptr->data());
+    if (format_ == TraceSubscriberStdio::FORMAT_JSON) {
+      trace_buffer_.AddFragment(data_ptr->data());
+      return;
+    }
+    // Binary chunks of a flush arrive in order and are written as they come.
+    // JSON fragments are lists of objects, while binary chunks start with a
+    // record type, which is a small number.
+    const std::string& data = data_ptr->data();
+    if (!data.empty() && data[0] == '{') {
+      json_wrapper_->AddJSONFragment(data);
+      json_wrapper_->Flush();
+    } else {
+      Write(data);
+    }
   }
 
   void OnEnd() {
-    trace_buffer_.Finish();
+    if (format_ == TraceSubscriberStdio::FORMAT_JSON)
+      trace_buffer_.Finish();
     CloseFile();
   }
 
@@ -61,6 +84,11 @@ class TraceSubscriberStdioImpl
     // This is important, as it breaks a reference cycle.
     trace_buffer_.SetOutputCallback(
         base::debug::TraceResultBuffer::OutputCallback());
+    json_wrapper_.reset();
+  }
+
+  void WriteChunk(const scoped_refptr<base::RefCountedString>& chunk) {
+    Write(chunk->data());
   }
 
   void Write(const std::string& output_str) {
@@ -74,12 +102,23 @@ class TraceSubscriberStdioImpl
   }
 
   FilePath path_;
+  const TraceSubscriberStdio::Format format_;
   FILE* file_;
   base::debug::TraceResultBuffer trace_buffer_;
+
+  // FORMAT_BINARY only: wraps JSON data into binary trace records.
+  scoped_ptr<base::debug::TraceBinaryWriter> json_wrapper_;
 };
 
 TraceSubscriberStdio::TraceSubscriberStdio(const FilePath& path)
-    : impl_(new TraceSubscriberStdioImpl(path)) {
+    : impl_(new TraceSubscriberStdioImpl(path, FORMAT_JSON)) {
+  BrowserThread::PostBlockingPoolSequencedTask(
+      __FILE__, FROM_HERE,
+      base::Bind(&TraceSubscriberStdioImpl::OnStart, impl_));
+}
+
+TraceSubscriberStdio::TraceSubscriberStdio(const FilePath& path, Format format)
+    : impl_(new TraceSubscriberStdioImpl(path, format)) {
   BrowserThread::PostBlockingPoolSequencedTask(
       __FILE__, FROM_HERE,
       base::Bind(&TraceSubscriberStdioImpl::OnStart, impl_));
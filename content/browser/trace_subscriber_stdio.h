@@ -20,8 +20,18 @@ class TraceSubscriberStdioImpl;
 class CONTENT_EXPORT TraceSubscriberStdio
     : NON_EXPORTED_BASE(public TraceSubscriber) {
  public:
+  enum Format {
+    // A JSON array of events, which about:tracing can load.
+    FORMAT_JSON,
+    // The binary trace format of base/debug/trace_event_binary.h. Data which
+    // arrives as JSON (e.g. from child processes) is embedded as is. Convert
+    // the file with the trace_converter tool to load it in about:tracing.
+    FORMAT_BINARY
+  };
+
   // Creates or overwrites the specified file. Check IsValid() for success.
   explicit TraceSubscriberStdio(const FilePath& path);
+  TraceSubscriberStdio(const FilePath& path, Format format);
   virtual ~TraceSubscriberStdio();
 
   // Implementation of TraceSubscriber
@@ -4,6 +4,8 @@
 
 #include "content/browser/trace_subscriber_stdio.h"
 
+#include "base/bind.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/threading/sequenced_worker_pool.h"
 #include "content/public/browser/browser_thread.h"
@@ -11,6 +13,16 @@
 
 namespace content {
 
+namespace {
+
+void AppendFragment(std::string* out, const std::string& fragment) {
+  if (!out->empty())
+    out->append(",");
+  out->append(fragment);
+}
+
+}  // namespace
+
 class TraceSubscriberStdioTest : public ::testing::Test {};
 
 TEST_F(TraceSubscriberStdioTest, CanWriteDataToFile) {
@@ -36,4 +48,31 @@ TEST_F(TraceSubscriberStdioTest, CanWriteDataToFile) {
   EXPECT_EQ("[foo,bar]", result);
 }
 
+TEST_F(TraceSubscriberStdioTest, CanWriteBinaryDataToFile) {
+  base::ScopedTempDir trace_dir;
+  ASSERT_TRUE(trace_dir.CreateUniqueTempDir());
+  FilePath trace_file(trace_dir.path().AppendASCII("trace.bin"));
+  {
+    TraceSubscriberStdio subscriber(trace_file,
+                                    TraceSubscriberStdio::FORMAT_BINARY);
+
+    // JSON from a child process is embedded.
+    std::string foo("{\"name\":\"foo\"}");
+    subscriber.OnTraceDataCollected(
+        make_scoped_refptr(base::RefCountedString::TakeString(&foo)));
+
+    subscriber.OnEndTracingComplete();
+  }
+  BrowserThread::GetBlockingPool()->FlushForTesting();
+  std::string result;
+  EXPECT_TRUE(file_util::ReadFileToString(trace_file, &result));
+  EXPECT_NE(std::string::npos, result.find("{\"name\":\"foo\"}"));
+
+  std::string json;
+  base::debug::TraceBinaryReader reader(base::Bind(&AppendFragment, &json));
+  EXPECT_TRUE(reader.Append(result));
+  EXPECT_TRUE(reader.Finish());
+  EXPECT_EQ("{\"name\":\"foo\"}", json);
+}
+
 }  // namespace content
@@ -8,6 +8,7 @@
 
 #include "base/bind.h"
 #include "base/message_loop.h"
+#include "base/metrics/histogram_shared_memory.h"
 #include "base/metrics/statistics_recorder.h"
 #include "content/common/child_process.h"
 #include "content/common/child_process_messages.h"
@@ -34,6 +35,8 @@ bool ChildHistogramMessageFilter::OnMessageReceived(
     const IPC::Message& message) {
   bool handled = true;
   IPC_BEGIN_MESSAGE_MAP(ChildHistogramMessageFilter, message)
+    IPC_MESSAGE_HANDLER(ChildProcessMsg_SetHistogramMemory,
+                        OnSetHistogramMemory)
     IPC_MESSAGE_HANDLER(ChildProcessMsg_GetChildHistogramData,
                         OnGetChildHistogramData)
     IPC_MESSAGE_UNHANDLED(handled = false)
@@ -47,6 +50,22 @@ void ChildHistogramMessageFilter::SendHistograms(int sequence_number) {
                             this, sequence_number));
 }
 
+void ChildHistogramMessageFilter::OnSetHistogramMemory(
+    base::SharedMemoryHandle handle,
+    uint32 size) {
+  if (base::HistogramSharedMemory::GetForCurrentProcess()) {
+    NOTREACHED();
+    return;
+  }
+  base::HistogramSharedMemory* segment =
+      base::HistogramSharedMemory::Attach(handle, size);
+  if (!segment)
+    return;
+  // The histograms created from now on keep their samples in the segment, and
+  // are leaked, so the segment is too.
+  base::HistogramSharedMemory::SetForCurrentProcess(segment);
+}
+
 void ChildHistogramMessageFilter::OnGetChildHistogramData(int sequence_number) {
   UploadAllHistograms(sequence_number);
 }
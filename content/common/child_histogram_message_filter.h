@@ -12,6 +12,7 @@
 #include "base/metrics/histogram.h"
 #include "base/metrics/histogram_flattener.h"
 #include "base/metrics/histogram_snapshot_manager.h"
+#include "base/shared_memory.h"
 #include "ipc/ipc_channel_proxy.h"
 
 class MessageLoop;
@@ -49,6 +50,8 @@ class ChildHistogramMessageFilter : public base::HistogramFlattener,
   virtual ~ChildHistogramMessageFilter();
 
   // Message handlers.
+  virtual void OnSetHistogramMemory(base::SharedMemoryHandle handle,
+                                    uint32 size);
   virtual void OnGetChildHistogramData(int sequence_number);
 
   // Extract snapshot data and then send it off the the Browser process.
@@ -85,6 +85,13 @@ IPC_MESSAGE_CONTROL1(ChildProcessMsg_GetChildProfilerData,
 IPC_MESSAGE_CONTROL1(ChildProcessMsg_GetChildHistogramData,
                      int /* sequence_number */)
 
+// Sent to a child process, before any other histogram message, to have it
+// record the samples of its histograms into a block of shared memory the
+// browser reads. See base/metrics/histogram_shared_memory.h.
+IPC_MESSAGE_CONTROL2(ChildProcessMsg_SetHistogramMemory,
+                     base::SharedMemoryHandle /* handle */,
+                     uint32 /* size */)
+
 // Sent to child processes to dump their handle table.
 IPC_MESSAGE_CONTROL0(ChildProcessMsg_DumpHandles)
 
@@ -7,11 +7,13 @@
 
 #include "base/memory/scoped_ptr.h"
 #include "base/values.h"
+#include "content/common/content_param_traits.h"
 #include "content/public/common/common_param_traits.h"
 #include "googleurl/src/gurl.h"
 #include "ipc/ipc_message.h"
 #include "ipc/ipc_message_utils.h"
 #include "net/base/host_port_pair.h"
+#include "net/base/ip_endpoint.h"
 #include "printing/backend/print_backend.h"
 #include "printing/page_range.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -192,3 +194,39 @@ TEST(IPCMessageTest, HostPortPair) {
   EXPECT_EQ(input.host(), output.host());
   EXPECT_EQ(input.port(), output.port());
 }
+
+// Tests net::IPEndPoint serialization
+TEST(IPCMessageTest, IPEndPoint) {
+  net::IPAddressNumber address;
+  address.push_back(192);
+  address.push_back(168);
+  address.push_back(0);
+  address.push_back(1);
+  net::IPEndPoint input(address, 8080);
+
+  IPC::Message msg(1, 2, IPC::Message::PRIORITY_NORMAL);
+  IPC::ParamTraits<net::IPEndPoint>::Write(&msg, input);
+
+  net::IPEndPoint output;
+  PickleIterator iter(msg);
+  EXPECT_TRUE(IPC::ParamTraits<net::IPEndPoint>::Read(&msg, &iter, &output));
+  EXPECT_EQ(input.address(), output.address());
+  EXPECT_EQ(input.port(), output.port());
+}
+
+// Tests content::NPVariant_Param serialization of strings
+TEST(IPCMessageTest, NPVariantString) {
+  content::NPVariant_Param input;
+  input.type = content::NPVARIANT_PARAM_STRING;
+  input.string_value = "some string";
+
+  IPC::Message msg(1, 2, IPC::Message::PRIORITY_NORMAL);
+  IPC::ParamTraits<content::NPVariant_Param>::Write(&msg, input);
+
+  content::NPVariant_Param output;
+  PickleIterator iter(msg);
+  EXPECT_TRUE(IPC::ParamTraits<content::NPVariant_Param>::Read(
+      &msg, &iter, &output));
+  EXPECT_EQ(content::NPVARIANT_PARAM_STRING, output.type);
+  EXPECT_EQ(input.string_value, output.string_value);
+}
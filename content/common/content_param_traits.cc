@@ -5,6 +5,7 @@
 #include "content/common/content_param_traits.h"
 
 #include "base/string_number_conversions.h"
+#include "base/string_piece.h"
 #include "net/base/ip_endpoint.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebBindings.h"
 #include "webkit/glue/npruntime_util.h"
@@ -64,10 +65,13 @@ void ParamTraits<net::IPEndPoint>::Write(Message* m, const param_type& p) {
 
 bool ParamTraits<net::IPEndPoint>::Read(const Message* m, PickleIterator* iter,
                                         param_type* p) {
-  net::IPAddressNumber address;
+  // The address is written as a data blob; build it straight from the
+  // message instead of going through a zero-filled vector.
+  base::StringPiece address_bytes;
   int port;
-  if (!ReadParam(m, iter, &address) || !ReadParam(m, iter, &port))
+  if (!iter->ReadStringPiece(&address_bytes) || !ReadParam(m, iter, &port))
     return false;
+  net::IPAddressNumber address(address_bytes.begin(), address_bytes.end());
   *p = net::IPEndPoint(address, port);
   return true;
 }
@@ -85,7 +89,7 @@ void ParamTraits<NPVariant_Param>::Write(Message* m, const param_type& p) {
   } else if (p.type == content::NPVARIANT_PARAM_DOUBLE) {
     WriteParam(m, p.double_value);
   } else if (p.type == content::NPVARIANT_PARAM_STRING) {
-    WriteParam(m, p.string_value);
+    m->WriteStringPiece(p.string_value);
   } else if (p.type == content::NPVARIANT_PARAM_SENDER_OBJECT_ROUTING_ID ||
              p.type == content::NPVARIANT_PARAM_RECEIVER_OBJECT_ROUTING_ID) {
     // This is the routing id used to connect NPObjectProxy in the other
@@ -114,7 +118,10 @@ bool ParamTraits<NPVariant_Param>::Read(const Message* m,
   } else if (r->type == content::NPVARIANT_PARAM_DOUBLE) {
     result = ReadParam(m, iter, &r->double_value);
   } else if (r->type == content::NPVARIANT_PARAM_STRING) {
-    result = ReadParam(m, iter, &r->string_value);
+    base::StringPiece string_value;
+    result = iter->ReadStringPiece(&string_value);
+    if (result)
+      string_value.CopyToString(&r->string_value);
   } else if (r->type == content::NPVARIANT_PARAM_SENDER_OBJECT_ROUTING_ID ||
              r->type == content::NPVARIANT_PARAM_RECEIVER_OBJECT_ROUTING_ID) {
     result = ReadParam(m, iter, &r->npobject_routing_id);
@@ -169,6 +176,7 @@ void ParamTraits<NPIdentifier_Param>::Log(const param_type& p, std::string* l) {
 }
 
 void ParamTraits<ui::Range>::Write(Message* m, const ui::Range& r) {
+  m->Reserve(2 * sizeof(uint64));
   m->WriteUInt64(r.start());
   m->WriteUInt64(r.end());
 }
@@ -195,12 +203,14 @@ void ParamTraits<WebInputEventPointer>::Write(Message* m, const param_type& p) {
 bool ParamTraits<WebInputEventPointer>::Read(const Message* m,
                                              PickleIterator* iter,
                                              param_type* r) {
-  const char* data;
-  int data_length;
-  if (!m->ReadData(iter, &data, &data_length)) {
+  // The event is not copied; it points into the message.
+  base::StringPiece event_bytes;
+  if (!iter->ReadStringPiece(&event_bytes)) {
     NOTREACHED();
     return false;
   }
+  const char* data = event_bytes.data();
+  int data_length = static_cast<int>(event_bytes.size());
   if (data_length < static_cast<int>(sizeof(WebKit::WebInputEvent))) {
     NOTREACHED();
     return false;
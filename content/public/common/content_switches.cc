@@ -345,6 +345,11 @@ const char kEnableSandboxLogging[]          = "enable-sandbox-logging";
 // Enable the seccomp sandbox (Linux only)
 const char kEnableSeccompSandbox[]          = "enable-seccomp-sandbox";
 
+// Has child processes record the samples of their histograms into memory
+// shared with the browser, which reads them when it takes a snapshot, instead
+// of serializing them for every snapshot.
+const char kEnableSharedMemoryHistograms[]  = "enable-shared-memory-histograms";
+
 // On platforms that support it, enables smooth scroll animation.
 const char kEnableSmoothScrolling[]         = "enable-smooth-scrolling";
 
@@ -661,6 +666,11 @@ const char kTraceStartup[]                  = "trace-startup";
 // all events since startup.
 const char kTraceStartupFile[]              = "trace-startup-file";
 
+// Sets the format of the file written by --trace-startup. Either "json" (the
+// default) or "binary", which is much smaller and faster to write for large
+// traces; convert binary traces to JSON with the trace_converter tool.
+const char kTraceStartupFormat[]            = "trace-startup-format";
+
 // Sets the time in seconds until startup tracing ends. If omitted a default of
 // 5 seconds is used. Has no effect without --trace-startup, or if
 // --startup-trace-file=none was supplied.